@@ -189,6 +189,7 @@ EXE2_REAL_LIBS=$(addprefix -l,$(EXE2_LIBS))
 EXE3_REAL_LIBS=$(addprefix -l,$(EXE3_LIBS))
 EXE4_REAL_LIBS=$(addprefix -l,$(EXE4_LIBS))
 EXE5_REAL_LIBS=$(addprefix -l,$(EXE5_LIBS))
+EXE_REAL_LIBS_OF=$(addprefix -l,$($(1)_LIBS))
 
 DLL_REAL_LIBS=$(addprefix -l,$(DLL_LIBS))
 DLL1_REAL_LIBS=$(addprefix -l,$(DLL1_LIBS))
@@ -204,3 +205,4 @@ EXE2_REAL_LIBDIRS=$(addprefix -L,$(EXE2_LIBDIRS))
 EXE3_REAL_LIBDIRS=$(addprefix -L,$(EXE3_LIBDIRS))
 EXE4_REAL_LIBDIRS=$(addprefix -L,$(EXE4_LIBDIRS))
 EXE5_REAL_LIBDIRS=$(addprefix -L,$(EXE5_LIBDIRS))
+EXE_REAL_LIBDIRS_OF=$(addprefix -L,$($(1)_LIBDIRS))
@@ -224,6 +224,31 @@ endif
 endif
 endif # EXE5_TARGET
 
+#
+# EXES lists further executables by name; each one links <name>_OBJS
+# (default: <name>) with [ <name>_EXTRA ], [ <name>_LIBS ],
+# [ <name>_LIBDIRS ] and [ <name>_NONPARSED_OBJS ] into $(OBJDIR)/<name>.
+#
+
+define EXE_template
+_$(1)_OBJS:=$$(addprefix $$(OBJDIR)/,$$(addsuffix .$$(OBJ),$$(or $$($(1)_OBJS),$(1)))) $$($(1)_NONPARSED_OBJS)
+_$(1)_OUTPUT_FILE:=$$(OBJDIR)/$(1)$$(EXE)
+$$(_$(1)_OUTPUT_FILE): $$(_$(1)_OBJS)
+	$$(PRELINK) $$(CC) \
+		\
+		$$(LD_DASH_O)$$(_$(1)_OUTPUT_FILE) \
+		\
+		$$(_$(1)_OBJS) $$($(1)_EXTRA) $$(PRELIB) $$(LD_FLAGS) \
+		$$(call EXE_REAL_LIBDIRS_OF,$(1)) $$(call EXE_REAL_LIBS_OF,$(1)) $$(LD_LIBS) $$(LD_RPATHS) $$(SYSTEM_LINK_LIBS)
+ifeq ($$(BUILD_VARIANT), OPTIMIZED)
+ifdef STRIP
+	$$(STRIP) $$(_$(1)_OUTPUT_FILE)
+endif
+endif
+endef
+
+$(foreach exe,$(EXES),$(eval $(call EXE_template,$(exe))))
+
 #
 # DLL[n]_TARGET, DLL[n]_OBJS, [ DLL[n]_EXTRA ], [ DLL[n]_LIBS ]
 #
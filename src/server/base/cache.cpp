@@ -71,6 +71,7 @@
 #include "base/daemon.h"  /* daemon_atrestart */
 #include "nsassert.h"
 #include "base/dbtbase.h"
+#include "xp/xpatomic.h"
 #ifdef IRIX
 #include "time/nstime.h"
 #endif
@@ -85,8 +86,43 @@ static CRITICAL cache_crit = NULL;
 #define NSCACHESTATUS_OK             0 
 #define NSCACHESTATUS_DELETEPENDING  1 
 
+/* Upper bound on the number of lock stripes per cache, and the minimum
+ * number of entries each stripe should be able to hold.  Small caches get
+ * fewer stripes so that each stripe's LRU list stays meaningful.
+ */
+#define CACHE_MAX_STRIPES            16
+#define CACHE_MIN_STRIPE_ENTRIES     8
+
+#define CACHE_LINE_SIZE              64
+
+/* cache_stripe_t
+ * A lock stripe.  Everything in here is protected by lock.
+ */
+struct cache_stripe_t {
+	CRITICAL		lock;
+	cache_entry_t		*lru_head;	/* least-recently-used list */
+	cache_entry_t		*mru_head;	/* most-recently-used list */
+	unsigned int		cache_size;	/* current size of stripe */
+	unsigned int		max_size;	/* max size of stripe */
+	int			cache_hits;	/* num cache hits */
+	int			cache_lookups;	/* num cache lookups */
+	unsigned int		insert_ok;	/* num successful inserts */
+	unsigned int		insert_fail;	/* num failed inserts */
+	unsigned int		deletes;	/* num deletes */
+	char			pad[CACHE_LINE_SIZE]; /* avoid false sharing */
+};
+
+#define ACCESS_COUNT(entry) ((volatile XPUint32 *)&(entry)->access_count)
+
+#define CACHE_STRIPE(cache, bucket) (&(cache)->stripes[(bucket) % (cache)->nstripes])
+
 static
 cache_entry_t * _cache_entry_lookup(cache_t *cache, void *key, int *rcs);
+static
+int _cache_remove_mru(cache_stripe_t *stripe, cache_entry_t *entry);
+static
+void _cache_delete_locked(cache_t *cache, cache_stripe_t *stripe,
+	unsigned int bucket, cache_entry_t *entry);
 
 NSAPI_PUBLIC cache_t *
 cache_create(unsigned int cache_max, unsigned int hash_size,
@@ -94,6 +130,7 @@ cache_create(unsigned int cache_max, unsigned int hash_size,
 {
 	cache_t *newentry;
 	unsigned int index;
+	unsigned int nstripes;
 
 SOLARIS_PROBE(cache_create_start, "cache");
 
@@ -106,29 +143,59 @@ SOLARIS_PROBE(cache_create_end, "cache");
 		return NULL;
 	}
 
+	nstripes = cache_max / CACHE_MIN_STRIPE_ENTRIES;
+	if (nstripes > CACHE_MAX_STRIPES)
+		nstripes = CACHE_MAX_STRIPES;
+	if (nstripes > hash_size)
+		nstripes = hash_size;
+	if (nstripes < 1)
+		nstripes = 1;
+
 #ifdef CACHE_DEBUG
 	newentry->magic = CACHE_MAGIC;
 #endif
-	newentry->cache_size	= 0;
 	newentry->hash_size	= hash_size;
 	newentry->max_size	= cache_max;
-    newentry->insert_ok = 0;
-    newentry->insert_fail = 0;
-    newentry->deletes = 0;
-	newentry->cache_hits	= 0;
-	newentry->cache_lookups = 0;
-	newentry->lock 	= crit_init();
 	newentry->virtual_fn	= fnlist;
+	newentry->nstripes	= nstripes;
+	newentry->cache_size	= 0;
+	newentry->cache_hits	= 0;
+	newentry->cache_lookups	= 0;
+	newentry->insert_ok	= 0;
+	newentry->insert_fail	= 0;
+	newentry->deletes	= 0;
 	if ( (newentry->table = (cache_entry_t **)
 		PERM_MALLOC((sizeof(cache_entry_t *)) * (newentry->hash_size)))
 		== NULL) {
 		ereport(LOG_FAILURE, XP_GetAdminStr(DBT_insufficientMemoryToCreateHashTa_1));
+		PERM_FREE(newentry);
 SOLARIS_PROBE(cache_create_end, "cache");
 		return NULL;
 	}
 	for (index=0; index<newentry->hash_size; index++) 
 		newentry->table[index] = NULL;
-	newentry->mru_head = newentry->lru_head = NULL;
+
+	if ( (newentry->stripes = (cache_stripe_t *)
+		PERM_MALLOC(sizeof(cache_stripe_t) * nstripes)) == NULL) {
+		ereport(LOG_FAILURE, XP_GetAdminStr(DBT_insufficientMemoryToCreateHashTa_1));
+		PERM_FREE(newentry->table);
+		PERM_FREE(newentry);
+SOLARIS_PROBE(cache_create_end, "cache");
+		return NULL;
+	}
+	for (index = 0; index < nstripes; index++) {
+		cache_stripe_t *stripe = &newentry->stripes[index];
+		stripe->lock = crit_init();
+		stripe->lru_head = stripe->mru_head = NULL;
+		stripe->cache_size = 0;
+		/* Round up so the stripes together hold at least cache_max */
+		stripe->max_size = (cache_max + nstripes - 1) / nstripes;
+		stripe->cache_hits = 0;
+		stripe->cache_lookups = 0;
+		stripe->insert_ok = 0;
+		stripe->insert_fail = 0;
+		stripe->deletes = 0;
+	}
 
 #ifdef IRIX
 	newentry->fast_mode = 0;
@@ -154,6 +221,7 @@ cache_destroy(void *cache_ptr)
 	cache_t *cache = (cache_t *)cache_ptr;
 	cache_t *search, *last;
 	cache_entry_t *ptr;
+	unsigned int index;
 SOLARIS_PROBE(cache_destroy_start, "cache");
 
 #ifdef IRIX
@@ -167,16 +235,17 @@ SOLARIS_PROBE(cache_destroy_start, "cache");
 #endif
 
 	crit_enter(cache_crit);
-	crit_enter(cache->lock);
-
-	ptr = cache->lru_head;
-	while(ptr) {
-		/* Caller MUST bump the access_count before calling delete
-		 * We can do this since we hold the cache lock.  
-		 */
-		cache_use_increment(cache, ptr);
-		cache_delete(cache, ptr, 0);
-		ptr = cache->lru_head;
+	cache_lock(cache);
+
+	for (index = 0; index < cache->nstripes; index++) {
+		cache_stripe_t *stripe = &cache->stripes[index];
+		while ((ptr = stripe->lru_head) != NULL) {
+			NS_ASSERT(ptr->access_count == 0);
+			(void)_cache_remove_mru(stripe, ptr);
+			_cache_delete_locked(cache, stripe,
+				cache->virtual_fn->hash_fn(cache->hash_size, ptr->key),
+				ptr);
+		}
 	}
 
 	PERM_FREE(cache->table);
@@ -199,45 +268,46 @@ SOLARIS_PROBE(cache_destroy_start, "cache");
 		ereport(LOG_WARN, XP_GetAdminStr(DBT_cacheDestroyCacheTablesAppearCor_));
 	}
 	crit_exit(cache_crit);
-	crit_exit(cache->lock);
+	cache_unlock(cache);
 
-	crit_terminate(cache->lock);
+	for (index = 0; index < cache->nstripes; index++)
+		crit_terminate(cache->stripes[index].lock);
 
+	PERM_FREE(cache->stripes);
 	PERM_FREE(cache);
 SOLARIS_PROBE(cache_destroy_end, "cache");
 }
 
 /* _cache_make_mru
  * Put this element at the MRU element.
- * Caller must hold cache lock.
+ * Caller must hold the stripe lock.
  */
 static int
-_cache_make_mru(cache_t *cache, cache_entry_t *entry) 
+_cache_make_mru(cache_stripe_t *stripe, cache_entry_t *entry) 
 {
 SOLARIS_PROBE(cache_make_mru_start, "cache");
-	NS_ASSERT(cache);
+	NS_ASSERT(stripe);
 	NS_ASSERT(entry);
 #ifdef CACHE_DEBUG
-	NS_ASSERT(cache->magic == CACHE_MAGIC);
 	NS_ASSERT(entry->magic == CACHE_ENTRY_MAGIC);
 #endif
 
-	if (cache->mru_head == NULL)
-		cache->mru_head = cache->lru_head = entry;
+	if (stripe->mru_head == NULL)
+		stripe->mru_head = stripe->lru_head = entry;
 	else {
-		if (cache->mru_head != entry) {
-			if (cache->lru_head == entry)
-				cache->lru_head = entry->mru;
+		if (stripe->mru_head != entry) {
+			if (stripe->lru_head == entry)
+				stripe->lru_head = entry->mru;
 			/* only check entry->lru if we aren't the lru_head */
 			else if (entry->lru) 
 				entry->lru->mru = entry->mru;
 			if (entry->mru)
 				entry->mru->lru = entry->lru;
-			entry->lru = cache->mru_head;
+			entry->lru = stripe->mru_head;
 			entry->mru = NULL;
-			/* cache->mru_head cannot be NULL here */
-			cache->mru_head->mru = entry;
-			cache->mru_head = entry;
+			/* stripe->mru_head cannot be NULL here */
+			stripe->mru_head->mru = entry;
+			stripe->mru_head = entry;
 		}
 	}
 
@@ -247,32 +317,31 @@ SOLARIS_PROBE(cache_make_mru_end, "cache");
 
 /* _cache_remove_mru()
  * Remove an entry from the MRU list. 
- * Caller MUST hold the cache->lock in order to call this routine.
+ * Caller MUST hold the stripe lock in order to call this routine.
  * Caller MUST be on the MRU list; otherwise this routine will segfault.
  */
 static int
-_cache_remove_mru(cache_t *cache, cache_entry_t *entry)
+_cache_remove_mru(cache_stripe_t *stripe, cache_entry_t *entry)
 {
 
 SOLARIS_PROBE(cache_remove_mru_start, "cache");
-	NS_ASSERT(cache);
-	NS_ASSERT(cache->mru_head);
-	NS_ASSERT(cache->lru_head);
+	NS_ASSERT(stripe);
+	NS_ASSERT(stripe->mru_head);
+	NS_ASSERT(stripe->lru_head);
 	NS_ASSERT(entry);
-	NS_ASSERT((cache->mru_head == cache->lru_head) || 
+	NS_ASSERT((stripe->mru_head == stripe->lru_head) || 
 		(entry->mru || entry->lru));
 #ifdef CACHE_DEBUG
-	NS_ASSERT(cache->magic == CACHE_MAGIC);
 	NS_ASSERT(entry->magic == CACHE_ENTRY_MAGIC);
 #endif
 
-	if (cache->mru_head == entry) 
-		cache->mru_head = entry->lru;
+	if (stripe->mru_head == entry) 
+		stripe->mru_head = entry->lru;
 	else 
 		/* if we are not the mru_head, entry->mru cannot be NULL */
 		entry->mru->lru = entry->lru;
-	if (cache->lru_head == entry) 
-		cache->lru_head = entry->mru;
+	if (stripe->lru_head == entry) 
+		stripe->lru_head = entry->mru;
 	else 
 		/* if we are not the lru_head, entry->lru cannot be NULL */
 		entry->lru->mru = entry->mru;
@@ -282,9 +351,9 @@ SOLARIS_PROBE(cache_remove_mru_start, "cache");
 #ifdef CACHE_CHECK_LIST
 	{
 		cache_entry_t *ptr;
-		for (ptr = cache->mru_head; ptr; ptr = ptr->lru)
+		for (ptr = stripe->mru_head; ptr; ptr = ptr->lru)
 			NS_ASSERT(ptr != entry);
-		for (ptr = cache->lru_head; ptr; ptr = ptr->mru)
+		for (ptr = stripe->lru_head; ptr; ptr = ptr->mru)
 			NS_ASSERT(ptr != entry);
 	}
 #endif /* CACHE_CHECK_LIST */
@@ -293,6 +362,37 @@ SOLARIS_PROBE(cache_remove_mru_end, "cache");
 	return 0;
 }
 
+/* _cache_delete_locked()
+ * Unlink an entry from its hash bucket and free it.  Caller MUST hold the
+ * stripe lock and the entry MUST NOT be on the LRU list.
+ */
+static void
+_cache_delete_locked(cache_t *cache, cache_stripe_t *stripe,
+	unsigned int bucket, cache_entry_t *entry)
+{
+	cache_entry_t *ptr, *last;
+
+SOLARIS_PROBE(cache_delete_start, "cache");
+	for (last = NULL, ptr = cache->table[bucket]; ptr; 
+		last = ptr, ptr= ptr->next)
+		if (entry == ptr)
+			break;
+	NS_ASSERT(ptr);
+	if (ptr) {
+		if (last)
+			last->next = ptr->next;
+		else
+			cache->table[bucket] = ptr->next;
+	}
+	stripe->cache_size--;
+	stripe->deletes++;
+
+	entry->fn_list->cleanup_fn(entry->data);
+
+	PERM_FREE(entry);
+SOLARIS_PROBE(cache_delete_end, "cache");
+}
+
 NSAPI_PUBLIC int 
 cache_touch(cache_t *cache, cache_entry_t *entry)
 {
@@ -359,57 +459,18 @@ cache_insert_p(cache_t *cache, cache_entry_t *entry, void *key, void *data,
 	cache_entry_functions_t *fn)
 {
 	cache_entry_t *tmp;
-	int bucket;
-	cache_entry_t *delete_ptr;
-        int rcs = NSCACHESTATUS_OK;
+	cache_stripe_t *stripe;
+	unsigned int bucket;
 
 SOLARIS_PROBE(cache_insert_p_start, "cache");
 	NS_ASSERT(cache_crit);
 	NS_ASSERT(cache);
 	NS_ASSERT(entry);
-	NS_ASSERT((cache->mru_head && cache->lru_head) || 
-		(!cache->mru_head && !cache->lru_head));
 #ifdef CACHE_DEBUG
 	NS_ASSERT(cache->magic == CACHE_MAGIC);
 	NS_ASSERT(entry->magic == CACHE_ENTRY_MAGIC);
 #endif
 
-	crit_enter(cache->lock);
-	/* Reserve a space in the cache if possible; if not; try to delete
-	 * the oldest guy...  Note that since we increment to reserve
-	 * space; it is possible that we have maxed the cache when there
-	 * are no entries yet added; so we need to check the lru_head ptr
-	 * to see if the list is empty.  If the list is empty, there is 
-	 * nothing we can delete, so just fail the insert request.  This
-	 * condition should go away momentarily.
-	 */
-	if (cache->cache_size >= cache->max_size) {
-
-		if (!cache->lru_head) {
-			/* No space in the cache */
-            cache->insert_fail++;
-			crit_exit(cache->lock);
-SOLARIS_PROBE(cache_insert_p_end, "cache");
-			return -1;
-		}
-
-		/* Caller MUST bump the access_count before calling delete
-		 * We can do this since we hold the cache lock.
-		 */
-		delete_ptr = cache->lru_head;
-		cache_use_increment(cache, delete_ptr);
-		if ( cache_delete(cache, delete_ptr, 0) < 0 ) {
-			cache_use_decrement(cache, delete_ptr);
-			NS_ASSERT(delete_ptr->access_count > 0);
-            cache->insert_fail++;
-			crit_exit(cache->lock);
-SOLARIS_PROBE(cache_insert_p_end, "cache");
-			return -1;
-		}
-	}
-	cache->cache_size++;
-	crit_exit(cache->lock);
-
 	entry->key = key;
 	entry->data = data;
 	entry->access_count = 1;
@@ -418,39 +479,69 @@ SOLARIS_PROBE(cache_insert_p_end, "cache");
 	entry->next = NULL;
 	entry->lru = NULL;
 	entry->mru = NULL;
-	bucket = cache->virtual_fn->hash_fn(cache->hash_size, key);
 
 #ifdef IRIX
 	entry->next_deleted = NULL;
 #endif
 
-	crit_enter(cache->lock);
-	/* Don't add duplicate entries in the cache */
-	if ( (tmp = _cache_entry_lookup(cache, key, &rcs)) ) {
-                /* Try to delete original element */
-                if ( cache_delete(cache, tmp, 0) < 0) {
-			cache->cache_size--;
-			cache_use_decrement(cache, tmp);
-			NS_ASSERT(tmp->access_count > 0);
-            cache->insert_fail++;
-			crit_exit(cache->lock);
+	bucket = cache->virtual_fn->hash_fn(cache->hash_size, key);
+	stripe = CACHE_STRIPE(cache, bucket);
+
+	crit_enter(stripe->lock);
+	NS_ASSERT((stripe->mru_head && stripe->lru_head) || 
+		(!stripe->mru_head && !stripe->lru_head));
+
+	/* Don't add duplicate entries in the cache.  An unused duplicate is
+	 * replaced; one that is in use is marked delete_pending and the
+	 * insert fails.
+	 */
+	for (tmp = cache->table[bucket]; tmp; tmp = tmp->next) {
+		if (!tmp->fn_list->key_cmp_fn(key, tmp->key))
+			break;
+	}
+	if (tmp) {
+		if (!tmp->delete_pending && tmp->access_count == 0) {
+			(void)_cache_remove_mru(stripe, tmp);
+			_cache_delete_locked(cache, stripe, bucket, tmp);
+		} else {
+			tmp->delete_pending = 1;
+			stripe->insert_fail++;
+			crit_exit(stripe->lock);
 SOLARIS_PROBE(cache_insert_p_end, "cache");
 			return -1;
 		}
 	}
-        else if (rcs == NSCACHESTATUS_DELETEPENDING) {
-            cache->cache_size--;
-            cache->insert_fail++;
-            crit_exit(cache->lock);
-            return -1;
-        }
+
+	/* Make room in the stripe if possible by evicting its oldest unused
+	 * entry.  If every entry in the stripe is in use, there is nothing we
+	 * can delete, so just fail the insert request.  This condition should
+	 * go away momentarily.
+	 */
+	if (stripe->cache_size >= stripe->max_size) {
+		cache_entry_t *delete_ptr = stripe->lru_head;
+
+		if (!delete_ptr) {
+			/* No space in the stripe */
+			stripe->insert_fail++;
+			crit_exit(stripe->lock);
+SOLARIS_PROBE(cache_insert_p_end, "cache");
+			return -1;
+		}
+
+		NS_ASSERT(delete_ptr->access_count == 0);
+		(void)_cache_remove_mru(stripe, delete_ptr);
+		_cache_delete_locked(cache, stripe,
+			cache->virtual_fn->hash_fn(cache->hash_size, delete_ptr->key),
+			delete_ptr);
+	}
 
 	/* Insert in hash table */
 	entry->next = cache->table[bucket];
 	cache->table[bucket] = entry;
+	stripe->cache_size++;
 
-    cache->insert_ok++;
-	crit_exit(cache->lock);
+	stripe->insert_ok++;
+	crit_exit(stripe->lock);
 
 SOLARIS_PROBE(cache_insert_p_end, "cache");
 	return 0;
@@ -496,8 +587,8 @@ SOLARIS_PROBE(cache_insert_end, "cache");
 NSAPI_PUBLIC int
 cache_delete(cache_t *cache, cache_entry_t *entry, int dec_hits)
 {
-	int bucket;
-	cache_entry_t *ptr, *last;
+	unsigned int bucket;
+	cache_stripe_t *stripe;
 
 SOLARIS_PROBE(cache_delete_try_start, "cache");
 	NS_ASSERT(cache);
@@ -513,55 +604,34 @@ SOLARIS_PROBE(cache_delete_try_start, "cache");
 	 */
 	NS_ASSERT(entry->access_count >= 1);
 
-	crit_enter(cache->lock);
+	bucket = cache->virtual_fn->hash_fn(cache->hash_size, entry->key);
+	stripe = CACHE_STRIPE(cache, bucket);
+
+	crit_enter(stripe->lock);
 
 	entry->delete_pending = 1;
         if (dec_hits) {
-            NS_ASSERT(cache->cache_hits > 0);
-            cache->cache_hits--;
+            NS_ASSERT(stripe->cache_hits > 0);
+            stripe->cache_hits--;
         }
 
-	/* Check the access_count now that we have the lock.  If
-	 * we got context switched just after we checked, it is possible
-	 * that someone else is now using the entry.
+	/* Check the access_count now that we have the lock.  Other users
+	 * may still be releasing their references without the lock; the
+	 * last of them will finish the delete in cache_use_decrement().
 	 */
-	if (entry->access_count > 1) {
-		crit_exit(cache->lock);
+	if (XP_AtomicLoad32(ACCESS_COUNT(entry)) > 1) {
+		crit_exit(stripe->lock);
 SOLARIS_PROBE(cache_delete_try_end, "cache");
 		return -1;
 	}
 
-SOLARIS_PROBE(cache_delete_start, "cache");
-	/* Delete from the hash table */
-	bucket = cache->virtual_fn->hash_fn(cache->hash_size, entry->key);
-	for (last = NULL, ptr = cache->table[bucket]; ptr; 
-		last = ptr, ptr= ptr->next)
-		if (entry == ptr)
-			break;
-	NS_ASSERT(ptr);
-	if (ptr) {
-		if (last)
-			last->next = ptr->next;
-		else
-			cache->table[bucket] = ptr->next;
-	}
-	cache->cache_size--;
-
 	/* don't need to remove from the MRU/LRU list because
 	 * the access count is > 0 in order to call delete 
 	 */
+	_cache_delete_locked(cache, stripe, bucket, entry);
 
-	/* Technically, someone else could kill the whole cache
-	 * right now, and we would be left with a bum pointer.   XXXMB
-	 */
-	entry->fn_list->cleanup_fn(entry->data);
+	crit_exit(stripe->lock);
 
-    cache->deletes++;
-	crit_exit(cache->lock);
-
-	PERM_FREE(entry);
-
-SOLARIS_PROBE(cache_delete_end, "cache");
 	return 0;
 }
 
@@ -593,6 +663,10 @@ SOLARIS_PROBE(cache_use_increment_end, "cache");
 NSAPI_PUBLIC int
 cache_use_decrement(cache_t *cache, cache_entry_t *entry)
 {
+	cache_stripe_t *stripe;
+	XPUint32 count;
+	int res = 0;
+
 SOLARIS_PROBE(cache_use_decrement_start, "cache");
 	NS_ASSERT(cache_crit);
 	NS_ASSERT(cache);
@@ -603,27 +677,40 @@ SOLARIS_PROBE(cache_use_decrement_start, "cache");
 	NS_ASSERT(entry->magic == CACHE_ENTRY_MAGIC);
 #endif
 
-	crit_enter(cache->lock);
-	/* If we are the last user of this entry and the delete
-	 * is pending, cleanup now!
+	/* Fast path: if we are not the last user of this entry, just drop
+	 * our reference without touching the stripe lock.
 	 */
-    int res = 0;
-	if ((entry->access_count == 1) && (entry->delete_pending)) {
-		if (cache_delete(cache, entry, 0) < 0) {
-			/* can't delete right now; should never happen
-			 * since we have the cache lock and we know the
-			 * access count is 1
-			 */
-			entry->access_count--;
-			(void)_cache_make_mru(cache, entry);
+	count = XP_AtomicLoad32(ACCESS_COUNT(entry));
+	while (count > 1) {
+		XPUint32 old = XP_AtomicCompareAndSwap32(ACCESS_COUNT(entry),
+			count, count - 1);
+		if (old == count) {
+SOLARIS_PROBE(cache_use_decrement_end, "cache");
+			return 0;
 		}
-        res = -1;
-	} else {
-		if (entry->access_count == 1)
-			(void)_cache_make_mru(cache, entry);
-		entry->access_count--;
+		count = old;
 	}
-	crit_exit(cache->lock);
+
+	/* We may be the last user.  Nobody else can take a reference while
+	 * we hold the stripe lock, so the count can only drop to 0 in here.
+	 */
+	stripe = CACHE_STRIPE(cache,
+		cache->virtual_fn->hash_fn(cache->hash_size, entry->key));
+	crit_enter(stripe->lock);
+	if (XP_AtomicDecrement32(ACCESS_COUNT(entry)) == 0) {
+		/* If we are the last user of this entry and the delete
+		 * is pending, cleanup now!
+		 */
+		if (entry->delete_pending) {
+			_cache_delete_locked(cache, stripe,
+				cache->virtual_fn->hash_fn(cache->hash_size, entry->key),
+				entry);
+			res = -1;
+		} else {
+			(void)_cache_make_mru(stripe, entry);
+		}
+	}
+	crit_exit(stripe->lock);
 
 SOLARIS_PROBE(cache_use_decrement_end, "cache");
 	return res;
@@ -632,13 +719,11 @@ SOLARIS_PROBE(cache_use_decrement_end, "cache");
 static cache_entry_t *
 _cache_entry_lookup(cache_t *cache, void *key, int *rcs)
 {
-	int bucket;
+	unsigned int bucket;
+	cache_stripe_t *stripe;
 	cache_entry_t *ptr;
         *rcs = NSCACHESTATUS_OK;
 
-#if 0
-TNF_PROBE_0(cache_entry_lookup_start, "", "cache");
-#endif
 	NS_ASSERT(cache_crit);
 	NS_ASSERT(cache);
 #ifdef CACHE_DEBUG
@@ -647,31 +732,22 @@ TNF_PROBE_0(cache_entry_lookup_start, "", "cache");
 
 	/* move outside the crit section */
 	bucket = cache->virtual_fn->hash_fn(cache->hash_size, key);
-#if 0
-TNF_PROBE_0(cache_hash_end, "", "cache_hash_end");
-#endif
-
-	crit_enter(cache->lock);
-	cache->cache_lookups++;
+	stripe = CACHE_STRIPE(cache, bucket);
 
-#if 0
-TNF_PROBE_0(cache_crit_enter_end, "", "cache_crit_enter_end");
-#endif
+	crit_enter(stripe->lock);
+	stripe->cache_lookups++;
 
 	for (ptr = cache->table[bucket]; ptr; ptr = ptr->next) {
           if (!ptr->fn_list->key_cmp_fn(key, ptr->key))
 	    break;
 	}
-#if 0
-TNF_PROBE_0(cache_search_end, "", "cache_hash_end");
-#endif
 
 	if (ptr) {
 	   if (!ptr->delete_pending) {
-		cache->cache_hits++;
-		if (ptr->access_count == 0) 
-			(void)_cache_remove_mru(cache, ptr);
-		ptr->access_count++;
+		stripe->cache_hits++;
+		/* An unused entry sits on the LRU list; take it off */
+		if (XP_AtomicIncrement32(ACCESS_COUNT(ptr)) == 1) 
+			(void)_cache_remove_mru(stripe, ptr);
            }
            else {
                NS_ASSERT(ptr->access_count > 0);
@@ -679,11 +755,7 @@ TNF_PROBE_0(cache_search_end, "", "cache_hash_end");
                *rcs = NSCACHESTATUS_DELETEPENDING;
            }
         }
-	crit_exit(cache->lock);
-
-#if 0
-TNF_PROBE_0(cache_entry_lookup_end, "", "cache_entry_lookup_end");
-#endif
+	crit_exit(stripe->lock);
 
 SOLARIS_PROBE(cache_entry_lookup_end, "cache");
 	return ptr;
@@ -726,33 +798,62 @@ cache_valid(cache_t *cache, cache_entry_t *entry)
 NSAPI_PUBLIC void
 cache_lock(cache_t *cache)
 {
+	unsigned int index;
+
 SOLARIS_PROBE(cache_lock_start, "cache");
-	crit_enter(cache->lock);
+	for (index = 0; index < cache->nstripes; index++)
+		crit_enter(cache->stripes[index].lock);
 SOLARIS_PROBE(cache_lock_end, "cache");
 }
 
 NSAPI_PUBLIC void
 cache_unlock(cache_t *cache)
 {
+	unsigned int index;
+
 SOLARIS_PROBE(cache_unlock_start, "cache");
-	crit_exit(cache->lock);
+	for (index = cache->nstripes; index > 0; index--)
+		crit_exit(cache->stripes[index - 1].lock);
 SOLARIS_PROBE(cache_unlock_end, "cache");
 }
 
 NSAPI_PUBLIC unsigned int
 cache_get_use_count(cache_t *cache, cache_entry_t *entry)
 {
-	unsigned int result;
+	return XP_AtomicLoad32(ACCESS_COUNT(entry));
+}
 
-#ifdef IRIX
-	result = entry->access_count;
-#else
-	crit_enter(cache->lock);
-	result = entry->access_count;
-	crit_exit(cache->lock);
-#endif
+NSAPI_PUBLIC void
+cache_get_stats(cache_t *cache, cache_stats_t *stats)
+{
+	unsigned int index;
+
+	NS_ASSERT(cache);
+	NS_ASSERT(stats);
+
+	memset(stats, 0, sizeof(*stats));
+	stats->max_size = cache->max_size;
+	stats->hash_size = cache->hash_size;
+	stats->nstripes = cache->nstripes;
+
+	for (index = 0; index < cache->nstripes; index++) {
+		cache_stripe_t *stripe = &cache->stripes[index];
+		crit_enter(stripe->lock);
+		stats->cache_size += stripe->cache_size;
+		stats->cache_hits += stripe->cache_hits;
+		stats->cache_lookups += stripe->cache_lookups;
+		stats->insert_ok += stripe->insert_ok;
+		stats->insert_fail += stripe->insert_fail;
+		stats->deletes += stripe->deletes;
+		crit_exit(stripe->lock);
+	}
 
-	return result;
+	cache->cache_size = stats->cache_size;
+	cache->cache_hits = stats->cache_hits;
+	cache->cache_lookups = stats->cache_lookups;
+	cache->insert_ok = stats->insert_ok;
+	cache->insert_fail = stats->insert_fail;
+	cache->deletes = stats->deletes;
 }
 
 
@@ -822,23 +923,31 @@ cache_dump(cache_t *cache, char *cache_name, SYS_NETFD fd)
 	if (!cache_crit)
 		return -1;
 
-	crit_enter(cache->lock);
+	cache_stats_t stats;
+	unsigned int stripe;
+
+	cache_get_stats(cache, &stats);
+
+	cache_lock(cache);
 	len = util_sprintf(buf, XP_GetClientStr(DBT_H2SCacheH2N_), cache_name);
 	net_write(fd, buf, len);
 	len = util_sprintf(buf, XP_GetClientStr(DBT_cacheHitRatioDDFPNPN_),
-		cache->cache_hits, cache->cache_lookups, 
-		(cache->cache_lookups > 0)?
-		((cache->cache_hits)/(cache->cache_lookups)):0.0);
+		stats.cache_hits, stats.cache_lookups, 
+		(stats.cache_lookups > 0)?
+		((stats.cache_hits)/(stats.cache_lookups)):0.0);
 	net_write(fd, buf, len);
 	len = util_sprintf(buf, XP_GetClientStr(DBT_cacheSizeDDPNPN_),
-		cache->cache_size, cache->max_size);
+		stats.cache_size, stats.max_size);
 	net_write(fd, buf, len);
 	len = util_sprintf(buf, XP_GetClientStr(DBT_hashTableSizeDPNPN_),
 		cache->hash_size);
 	net_write(fd, buf, len);
-	len = util_sprintf(buf, XP_GetClientStr(DBT_mruDPNlruDPN_),
-                cache->mru_head, cache->lru_head);
-        net_write(fd, buf, len);
+	for (stripe = 0; stripe < cache->nstripes; stripe++) {
+		len = util_sprintf(buf, XP_GetClientStr(DBT_mruDPNlruDPN_),
+			cache->stripes[stripe].mru_head,
+			cache->stripes[stripe].lru_head);
+		net_write(fd, buf, len);
+	}
 
 	/* Create an HTML table */
 	len = util_sprintf(buf, XP_GetClientStr(DBT_UlTableBorder4ThBucketThThAddres_));
@@ -875,7 +984,7 @@ cache_dump(cache_t *cache, char *cache_name, SYS_NETFD fd)
 
 	len = util_sprintf(buf, "</TABLE></UL>\n");
 	net_write(fd, buf, len);
-	crit_exit(cache->lock);
+	cache_unlock(cache);
 	
 #endif
 	return REQ_PROCEED;
@@ -906,7 +1015,7 @@ cache_collect_garbage(cache_t *cache)
   if(now - cache->gc_time < GC_INTERVAL)
     return;
 
-  crit_enter(cache->lock);
+  cache_lock(cache);
 
   last = NULL;
   ptr = cache->garbage_list_head;
@@ -929,7 +1038,7 @@ cache_collect_garbage(cache_t *cache)
     }
   }
 
-  crit_exit(cache->lock);
+  cache_unlock(cache);
   cache->gc_time = now;
 }
 
@@ -96,7 +96,8 @@ typedef struct cache_entry_t {
 #endif
 	void	*key;			/* key for doing lookups */
 	void	*data;			/* data in the cache */
-	int	access_count;		/* use count for this entry */
+	int	access_count;		/* use count for this entry; only
+					 * ever modified atomically */
 	int	delete_pending;		/* 0 normally, 1 if a this 
 					 * request is pending delete.
 					 * requests pending delete are
@@ -123,14 +124,27 @@ typedef struct public_cache_functions_t {
 	debug_function		debug_fn;
 } public_cache_functions_t;
 
+/* cache_stripe_t
+ * One lock stripe of a cache.  Private to cache.cpp.
+ */
+typedef struct cache_stripe_t cache_stripe_t;
+
 /* cache_t
  * An instance of a cache.  
  *
- * About locking:  Currently each cache gets one lock.  The lock protects
- * all reads/writes to the cache_t structure, and also protects the
- * access_count field of every instance in the cache_entry_t.  It does not
- * protect other fields in the cache_entry_t as they are READ ONLY after
- * they are created.
+ * About locking:  The hash table is divided into stripes; hash bucket b
+ * belongs to stripe (b % nstripes).  Each stripe has its own lock, its own
+ * LRU/MRU list and its own share of max_size, so lookups and inserts of keys
+ * that hash to different stripes never contend.  A stripe lock protects the
+ * buckets and list of that stripe.  The access_count of an entry is
+ * maintained atomically: it may be decremented without any lock as long as
+ * it does not drop to 0, but it is only ever incremented, and only ever
+ * drops to 0, while the entry's stripe lock is held.  The other fields of
+ * cache_entry_t are READ ONLY after they are created.
+ *
+ * The counters are kept per stripe.  cache_size, cache_hits,
+ * cache_lookups, insert_ok, insert_fail and deletes hold their sums as of
+ * the last call to cache_get_stats() (or cache_dump()).
  */
 typedef struct cache_t {
 #ifdef CACHE_DEBUG
@@ -148,13 +162,9 @@ typedef struct cache_t {
 	public_cache_functions_t *virtual_fn;
 
 	/* PRIVATE */
-	CRITICAL		lock;		/* Must be held to make any
-						 * changes to this cache_t
-						 * structure.
-						 */
 	cache_entry_t		**table;	/* hash table for this cache */
-	cache_entry_t		*lru_head;	/* least-recently-used list */
-	cache_entry_t		*mru_head;	/* most-recently-used list */
+	cache_stripe_t		*stripes;	/* lock stripes */
+	unsigned int		nstripes;	/* number of lock stripes */
 	struct cache_t		*next;		/* next cache - for debugging */
 
     unsigned int         insert_ok;   /* num successful inserts */
@@ -169,6 +179,21 @@ typedef struct cache_t {
 
 } cache_t;
 
+/* cache_stats_t
+ * A snapshot of a cache's statistics, summed across its stripes.
+ */
+typedef struct cache_stats_t {
+	unsigned int		cache_size;	/* current size of cache */
+	unsigned int		max_size;	/* max size of cache */
+	unsigned int		hash_size;	/* size of hash table */
+	unsigned int		nstripes;	/* number of lock stripes */
+	int			cache_hits;	/* num cache hits */
+	int			cache_lookups;	/* num cache lookups */
+	unsigned int		insert_ok;	/* num successful inserts */
+	unsigned int		insert_fail;	/* num failed inserts */
+	unsigned int		deletes;	/* num deletes */
+} cache_stats_t;
+
 
 /* cache_create()
  * Creates/initializes the cache.  Must be initialized before use.
@@ -278,8 +303,9 @@ NSAPI_PUBLIC int cache_touch(cache_t *cache, cache_entry_t *entry);
 NSAPI_PUBLIC int cache_valid(cache_t *cache, cache_entry_t *entry);
 
 /* cache_lock
- * Locks the entire cache.  May be called recursively.  No changes can
- * be made to the cache while it is locked.
+ * Locks the entire cache by entering every stripe lock in order.  May be
+ * called recursively.  No changes can be made to the cache while it is
+ * locked.
  */
 NSAPI_PUBLIC void cache_lock(cache_t *cache);
 
@@ -293,6 +319,12 @@ NSAPI_PUBLIC void cache_unlock(cache_t *cache);
  */
 NSAPI_PUBLIC unsigned int cache_get_use_count(cache_t *cache, cache_entry_t *entry);
 
+/* cache_get_stats
+ * Fills in stats with a snapshot of the cache's statistics and copies the
+ * totals into the statistics fields of cache_t.
+ */
+NSAPI_PUBLIC void cache_get_stats(cache_t *cache, cache_stats_t *stats);
+
 /* cache_dump
  * Dumps an HTTP-format document containing info about the cache
  * to the file.
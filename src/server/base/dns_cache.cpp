@@ -295,15 +295,18 @@ GetDNSCacheInfo(DNSCacheInfo *info)
     info->enabled = (dns_cache == NULL)?PR_FALSE:PR_TRUE;
 
     if (info->enabled) {
-        info->maxCacheEntries = dns_cache->max_size;
-        info->numCacheEntries = dns_cache->cache_size;
+        cache_stats_t stats;
+        cache_get_stats(dns_cache, &stats);
 
-        info->numCacheHits = dns_cache->cache_hits;
-        info->numCacheMisses = dns_cache->cache_lookups - dns_cache->cache_hits;
+        info->maxCacheEntries = stats.max_size;
+        info->numCacheEntries = stats.cache_size;
 
-        info->numCacheInsertsOk = dns_cache->insert_ok;
-        info->numCacheInsertsFail = dns_cache->insert_fail;
-        info->numCacheDeletes = dns_cache->deletes;
+        info->numCacheHits = stats.cache_hits;
+        info->numCacheMisses = stats.cache_lookups - stats.cache_hits;
+
+        info->numCacheInsertsOk = stats.insert_ok;
+        info->numCacheInsertsFail = stats.insert_fail;
+        info->numCacheDeletes = stats.deletes;
     }
 
     return PR_TRUE;
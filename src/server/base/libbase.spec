@@ -450,6 +450,11 @@ arch            all
 version         SUNWprivate
 end
 
+function        cache_get_stats
+arch            all
+version         SUNWprivate
+end
+
 function        cache_insert
 arch            all
 version         SUNWprivate
@@ -4565,6 +4570,11 @@ arch            all
 version         SUNWprivate
 end
 
+function        GetSSLSessionInfo
+arch            all
+version         SUNWprivate
+end
+
 function        GetMagnusSecurityOptions
 arch            all
 version         SUNWprivate
@@ -4935,6 +4945,11 @@ arch            all
 version         SUNWprivate
 end
 
+function        http_match_if_range
+arch            all
+version         SUNWprivate
+end
+
 function        http_check_preconditions
 arch            all
 version         SUNWprivate
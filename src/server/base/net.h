@@ -165,6 +165,8 @@ NSAPI_PUBLIC PRIntervalTime INTnet_nsapi_timeout_to_nspr_interval(int timeout);
 NSAPI_PUBLIC int INTnet_nspr_interval_to_nsapi_timeout(PRIntervalTime interval);
 NSAPI_PUBLIC int INTnet_peek(SYS_NETFD sd, void *buf, int sz, int timeout);
 NSAPI_PUBLIC int INTnet_buffer_input(SYS_NETFD sd, int sz);
+NSAPI_PUBLIC int INTnet_batch_output(SYS_NETFD sd, int sz);
+NSAPI_PUBLIC int INTnet_batch_flush(SYS_NETFD sd);
 
 NSPR_END_EXTERN_C
 
@@ -199,6 +201,8 @@ NSPR_END_EXTERN_C
 #define net_nspr_interval_to_nsapi_timeout INTnet_nspr_interval_to_nsapi_timeout
 #define net_peek INTnet_peek
 #define net_buffer_input INTnet_buffer_input
+#define net_batch_output INTnet_batch_output
+#define net_batch_flush INTnet_batch_flush
 
 /* Obsolete */
 
@@ -47,6 +47,20 @@ struct NetLayer {
     char *inbuf;
 };
 
+/*
+ * NetBatch holds back small writes so that the responses to pipelined
+ * requests can go out in a single writev() or sendfile().  Writes are
+ * deferred only while maxsize is nonzero; pending data is sent ahead of the
+ * next write that doesn't fit, before any read, and on shutdown and close.
+ */
+struct NetBatch {
+    int used;
+    int maxsize;
+    int size;
+    char *outbuf;
+    PRIntervalTime timeout;
+};
+
 extern "C" {
 PRInt32 _netlayer_method_recv(PRFileDesc *fd, void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout);
 PRInt32 _netlayer_method_read(PRFileDesc *fd, void *buf, PRInt32 amount);
@@ -58,11 +72,23 @@ PRInt32 _netlayer_method_recvfrom(PRFileDesc *fd, void *buf, PRInt32 amount, PRI
 PRInt16 _netlayer_method_poll(PRFileDesc *fd, PRInt16 in_flags, PRInt16 *out_flags);
 PRInt32 _netlayer_method_acceptread(PRFileDesc *fd, PRFileDesc **nd, PRNetAddr **raddr, void *buf, PRInt32 amount, PRIntervalTime t);
 PRStatus _netlayer_method_close(PRFileDesc *fd);
+PRInt32 _netbatch_method_write(PRFileDesc *fd, const void *buf, PRInt32 amount);
+PRInt32 _netbatch_method_writev(PRFileDesc *fd, const PRIOVec *iov, PRInt32 iov_size, PRIntervalTime timeout);
+PRInt32 _netbatch_method_send(PRFileDesc *fd, const void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout);
+PRInt32 _netbatch_method_sendfile(PRFileDesc *fd, PRSendFileData *sfd, PRTransmitFileFlags flags, PRIntervalTime timeout);
+PRInt32 _netbatch_method_transmitfile(PRFileDesc *sd, PRFileDesc *fd, const void *headers, PRInt32 hlen, PRTransmitFileFlags flags, PRIntervalTime timeout);
+PRInt32 _netbatch_method_recv(PRFileDesc *fd, void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout);
+PRInt32 _netbatch_method_read(PRFileDesc *fd, void *buf, PRInt32 amount);
+PRInt16 _netbatch_method_poll(PRFileDesc *fd, PRInt16 in_flags, PRInt16 *out_flags);
+PRStatus _netbatch_method_shutdown(PRFileDesc *fd, PRIntn how);
+PRStatus _netbatch_method_close(PRFileDesc *fd);
 }
 
 static PRDescIdentity _netlayer_identity = PR_INVALID_IO_LAYER;
 static PRIOMethods _netlayer_methods;
 static PRCloseFN _netlayer_default_close_method;
+static PRDescIdentity _netbatch_identity = PR_INVALID_IO_LAYER;
+static PRIOMethods _netbatch_methods;
 
 
 /* -------------------------- _netlayer_retrieve -------------------------- */
@@ -333,6 +359,318 @@ NSAPI_PUBLIC int INTnet_buffer_input(SYS_NETFD sd, int sz)
 }
 
 
+/* ------------------------ _netbatch_send_pending ------------------------ */
+
+static inline PRInt32 _netbatch_send_pending(PRFileDesc *fd, PRIntervalTime timeout)
+{
+    NetBatch *nb = (NetBatch *) fd->secret;
+
+    if (nb->used == 0)
+        return 0;
+
+    PRInt32 rv = fd->lower->methods->send(fd->lower, nb->outbuf, nb->used, 0, timeout);
+
+    // Pending data is sent at most once, even if sending fails
+    nb->used = 0;
+
+    return rv;
+}
+
+
+/* ----------------------- _netbatch_method_writev ------------------------ */
+
+PRInt32 _netbatch_method_writev(PRFileDesc *fd, const PRIOVec *iov, PRInt32 iov_size, PRIntervalTime timeout)
+{
+    NetBatch *nb = (NetBatch *) fd->secret;
+
+    PRInt32 amount = 0;
+    for (int i = 0; i < iov_size; i++)
+        amount += iov[i].iov_len;
+
+    // Hold the data back if we're batching and it fits
+    if (amount <= nb->maxsize - nb->used) {
+        for (int i = 0; i < iov_size; i++) {
+            memcpy(nb->outbuf + nb->used, iov[i].iov_base, iov[i].iov_len);
+            nb->used += iov[i].iov_len;
+        }
+        nb->timeout = timeout;
+        return amount;
+    }
+
+    if (nb->used == 0)
+        return fd->lower->methods->writev(fd->lower, iov, iov_size, timeout);
+
+    // Send the pending data ahead of the new data, in one writev if possible
+    if (iov_size >= PR_MAX_IOVECTOR_SIZE) {
+        if (_netbatch_send_pending(fd, timeout) == -1)
+            return -1;
+        return fd->lower->methods->writev(fd->lower, iov, iov_size, timeout);
+    }
+
+    PRIOVec batch[PR_MAX_IOVECTOR_SIZE];
+    batch[0].iov_base = nb->outbuf;
+    batch[0].iov_len = nb->used;
+    memcpy(&batch[1], iov, iov_size * sizeof(iov[0]));
+
+    PRInt32 pending = nb->used;
+    nb->used = 0;
+
+    PRInt32 rv = fd->lower->methods->writev(fd->lower, batch, iov_size + 1, timeout);
+    if (rv == -1)
+        return -1;
+
+    rv -= pending;
+    if (rv < 0)
+        rv = 0;
+
+    return rv;
+}
+
+
+/* ------------------------ _netbatch_method_write ------------------------ */
+
+PRInt32 _netbatch_method_write(PRFileDesc *fd, const void *buf, PRInt32 amount)
+{
+    PRIOVec iov;
+    iov.iov_base = (char *) buf;
+    iov.iov_len = amount;
+
+    return _netbatch_method_writev(fd, &iov, 1, PR_INTERVAL_NO_TIMEOUT);
+}
+
+
+/* ------------------------ _netbatch_method_send ------------------------- */
+
+PRInt32 _netbatch_method_send(PRFileDesc *fd, const void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout)
+{
+    if (flags != 0) {
+        if (_netbatch_send_pending(fd, timeout) == -1)
+            return -1;
+        return fd->lower->methods->send(fd->lower, buf, amount, flags, timeout);
+    }
+
+    PRIOVec iov;
+    iov.iov_base = (char *) buf;
+    iov.iov_len = amount;
+
+    return _netbatch_method_writev(fd, &iov, 1, timeout);
+}
+
+
+/* ---------------------- _netbatch_method_sendfile ----------------------- */
+
+PRInt32 _netbatch_method_sendfile(PRFileDesc *fd, PRSendFileData *sfd, PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+    NetBatch *nb = (NetBatch *) fd->secret;
+
+    if (nb->used == 0)
+        return fd->lower->methods->sendfile(fd->lower, sfd, flags, timeout);
+
+    // If the sendfile header fits, send the pending data as its header
+    if (sfd->hlen > nb->size - nb->used) {
+        if (_netbatch_send_pending(fd, timeout) == -1)
+            return -1;
+        return fd->lower->methods->sendfile(fd->lower, sfd, flags, timeout);
+    }
+
+    if (sfd->hlen > 0)
+        memcpy(nb->outbuf + nb->used, sfd->header, sfd->hlen);
+
+    PRSendFileData batch = *sfd;
+    batch.header = nb->outbuf;
+    batch.hlen = nb->used + sfd->hlen;
+
+    PRInt32 pending = nb->used;
+    nb->used = 0;
+
+    PRInt32 rv = fd->lower->methods->sendfile(fd->lower, &batch, flags, timeout);
+    if (rv == -1)
+        return -1;
+
+    rv -= pending;
+    if (rv < 0)
+        rv = 0;
+
+    return rv;
+}
+
+
+/* -------------------- _netbatch_method_transmitfile --------------------- */
+
+PRInt32 _netbatch_method_transmitfile(PRFileDesc *sd, PRFileDesc *fd, const void *headers, PRInt32 hlen, PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+    PRSendFileData sfd;
+    sfd.fd = fd;
+    sfd.file_offset = 0;
+    sfd.file_nbytes = 0;
+    sfd.header = headers;
+    sfd.hlen = hlen;
+    sfd.trailer = NULL;
+    sfd.tlen = 0;
+
+    return _netbatch_method_sendfile(sd, &sfd, flags, timeout);
+}
+
+
+/* ------------------------ _netbatch_method_recv ------------------------- */
+
+PRInt32 _netbatch_method_recv(PRFileDesc *fd, void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout)
+{
+    // The client may be waiting for the pending data before it sends more
+    if (_netbatch_send_pending(fd, timeout) == -1)
+        return -1;
+
+    return fd->lower->methods->recv(fd->lower, buf, amount, flags, timeout);
+}
+
+
+/* ------------------------ _netbatch_method_read ------------------------- */
+
+PRInt32 _netbatch_method_read(PRFileDesc *fd, void *buf, PRInt32 amount)
+{
+    if (_netbatch_send_pending(fd, PR_INTERVAL_NO_TIMEOUT) == -1)
+        return -1;
+
+    return fd->lower->methods->read(fd->lower, buf, amount);
+}
+
+
+/* ------------------------ _netbatch_method_poll ------------------------- */
+
+PRInt16 _netbatch_method_poll(PRFileDesc *fd, PRInt16 in_flags, PRInt16 *out_flags)
+{
+    NetBatch *nb = (NetBatch *) fd->secret;
+
+    if (nb->used)
+        _netbatch_send_pending(fd, nb->timeout);
+
+    return fd->lower->methods->poll(fd->lower, in_flags, out_flags);
+}
+
+
+/* ---------------------- _netbatch_method_shutdown ----------------------- */
+
+PRStatus _netbatch_method_shutdown(PRFileDesc *fd, PRIntn how)
+{
+    NetBatch *nb = (NetBatch *) fd->secret;
+
+    if (nb->used && how != PR_SHUTDOWN_RCV)
+        _netbatch_send_pending(fd, nb->timeout);
+
+    return fd->lower->methods->shutdown(fd->lower, how);
+}
+
+
+/* ------------------------ _netbatch_method_close ------------------------ */
+
+PRStatus _netbatch_method_close(PRFileDesc *fd)
+{
+    NetBatch *nb = (NetBatch *) fd->secret;
+
+    if (nb->used)
+        _netbatch_send_pending(fd, nb->timeout);
+
+    fd->secret = NULL;
+
+    PRStatus rv = _netlayer_default_close_method(fd);
+
+    PERM_FREE(nb->outbuf);
+    PERM_FREE(nb);
+
+    return rv;
+}
+
+
+/* ---------------------------- _netbatch_find ---------------------------- */
+
+static NetBatch *_netbatch_find(PRFileDesc *fd)
+{
+    while (fd) {
+        if (fd->identity == _netbatch_identity)
+            return (NetBatch *) fd->secret;
+        fd = fd->lower;
+    }
+
+    return NULL;
+}
+
+
+/* --------------------------- net_batch_output --------------------------- */
+
+NSAPI_PUBLIC int INTnet_batch_output(SYS_NETFD sd, int sz)
+{
+    NetBatch *nb = _netbatch_find(sd);
+    if (nb) {
+        if (sz > nb->size) {
+            // Keep any pending data
+            void *outbuf = PERM_REALLOC(nb->outbuf, sz);
+            if (!outbuf)
+                return -1;
+
+            nb->outbuf = (char *) outbuf;
+            nb->size = sz;
+        }
+
+        nb->maxsize = sz;
+
+        return 0;
+    }
+
+    // There's nothing to do if batching was never enabled
+    if (sz < 1)
+        return 0;
+
+    nb = (NetBatch *) PERM_MALLOC(sizeof(NetBatch));
+    if (!nb)
+        return -1;
+
+    nb->used = 0;
+    nb->maxsize = sz;
+    nb->size = sz;
+    nb->timeout = PR_INTERVAL_NO_TIMEOUT;
+    nb->outbuf = (char *) PERM_MALLOC(sz);
+    if (!nb->outbuf) {
+        PERM_FREE(nb);
+        return -1;
+    }
+
+    PRFileDesc *layer = PR_CreateIOLayerStub(_netbatch_identity, &_netbatch_methods);
+    if (!layer) {
+        PERM_FREE(nb->outbuf);
+        PERM_FREE(nb);
+        return -1;
+    }
+
+    layer->secret = (PRFilePrivate *) nb;
+
+    PRStatus rv = PR_PushIOLayer(sd, PR_NSPR_IO_LAYER, layer);
+    if (rv != PR_SUCCESS) {
+        PR_Close(layer);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* --------------------------- net_batch_flush ---------------------------- */
+
+NSAPI_PUBLIC int INTnet_batch_flush(SYS_NETFD sd)
+{
+    while (sd) {
+        if (sd->identity == _netbatch_identity) {
+            NetBatch *nb = (NetBatch *) sd->secret;
+            if (_netbatch_send_pending(sd, nb->timeout) == -1)
+                return -1;
+            return 0;
+        }
+        sd = sd->lower;
+    }
+
+    return 0;
+}
+
+
 /* ------------------------------- net_peek ------------------------------- */
 
 NSAPI_PUBLIC int INTnet_peek(SYS_NETFD sd, void *buf, int sz, int timeout)
@@ -364,5 +702,19 @@ NSAPI_PUBLIC int net_init(int security_on)
 
     _netlayer_default_close_method = default_methods->close;
 
+    _netbatch_identity = PR_GetUniqueIdentity("netbatch/" PRODUCT_FULL_VERSION_ID);
+
+    _netbatch_methods = *default_methods;
+    _netbatch_methods.write = _netbatch_method_write;
+    _netbatch_methods.writev = _netbatch_method_writev;
+    _netbatch_methods.send = _netbatch_method_send;
+    _netbatch_methods.sendfile = _netbatch_method_sendfile;
+    _netbatch_methods.transmitfile = _netbatch_method_transmitfile;
+    _netbatch_methods.recv = _netbatch_method_recv;
+    _netbatch_methods.read = _netbatch_method_read;
+    _netbatch_methods.poll = _netbatch_method_poll;
+    _netbatch_methods.shutdown = _netbatch_method_shutdown;
+    _netbatch_methods.close = _netbatch_method_close;
+
     return 0;
 }
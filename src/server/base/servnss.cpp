@@ -58,6 +58,7 @@
 #include "httpdaemon/configurationmanager.h"
 #include "httpdaemon/WatchdogClient.h"
 #include "httpdaemon/updatecrl.h"
+#include "httpdaemon/internalstats.h"
 
 using ServerXMLSchema::Pkcs11;
 using ServerXMLSchema::Token;
@@ -104,6 +105,7 @@ static const char *servssl_prompt;
 static PRFileDesc *servssl_console;
 static PRBool servssl_init_early_called;
 static PRBool servssl_init_late_called;
+static PRInt32 servssl_handshakes;
 
 #ifdef XP_UNIX
 
@@ -496,7 +498,50 @@ static SECStatus _nss_InitTokens(const Pkcs11& pkcs11)
 
 void PR_CALLBACK servssl_handshake_callback(PRFileDesc *socket, void *arg)
 {
-    // do nothing
+    // Count completed handshakes, full and resumed alike.  NSS counts the
+    // resumptions, so GetSSLSessionInfo() can work out the full handshakes.
+    PR_AtomicIncrement(&servssl_handshakes);
+}
+
+
+//
+// Report SSL/TLS handshake and session resumption statistics for this process
+//
+PRBool GetSSLSessionInfo(SSLSessionInfo *info)
+{
+    if (!info)
+        return PR_FALSE;
+
+    memset(info, 0, sizeof(SSLSessionInfo));
+
+    if (!servssl_init_late_called)
+        return PR_TRUE;
+
+    conf_global_vars_s *globals = conf_get_true_globals();
+
+    info->flagCacheEnabled = (globals->Vssl_cache_entries > 0);
+#ifdef SSL_ENABLE_SESSION_TICKETS
+    info->flagTicketsSupported = PR_TRUE;
+#endif
+
+    SSL3Statistics *stats = SSL_GetStatistics();
+    if (stats) {
+        info->numCacheResumptions = stats->sch_sid_cache_hits;
+        info->numCacheMisses = stats->sch_sid_cache_misses +
+                               stats->sch_sid_cache_not_ok;
+#ifdef SSL_ENABLE_SESSION_TICKETS
+        info->numTicketResumptions = stats->sch_sid_stateless_resumes;
+#endif
+    }
+
+    info->numHandshakes = servssl_handshakes;
+
+    PRUint32 resumptions = info->numCacheResumptions +
+                           info->numTicketResumptions;
+    if (info->numHandshakes > resumptions)
+        info->numFullHandshakes = info->numHandshakes - resumptions;
+
+    return PR_TRUE;
 }
 
 
@@ -537,6 +582,10 @@ PRStatus servssl_init_early(const Pkcs11& pkcs11,
                     globals->Vssl_cache_entries,
                     globals->Vsecurity_session_timeout,
                     globals->Vssl3_session_timeout);
+
+            // NSS keeps the session ticket keys in this shared cache, so
+            // the keys generated here are used by every child process and
+            // a ticket issued by one process can be resumed by any other.
         }
     }
 
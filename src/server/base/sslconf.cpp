@@ -709,6 +709,32 @@ void SSLSocketConfiguration :: enableSSL(PRFileDesc* sock,
         stat = SSL_OptionSet(sock, SSL_NO_CACHE, PR_TRUE);
     }
 
+#ifdef SSL_ENABLE_SESSION_TICKETS
+    // Session tickets let clients resume without the server keeping any
+    // per-session state.  The ticket keys live in the session cache (the
+    // shared one when there are multiple processes), so every process can
+    // decrypt tickets issued by any other.
+    if (stat == SECSuccess) {
+        PRBool tickets = (PR_TRUE == sessionTickets) &&
+                         (globals->Vssl_cache_entries > 0);
+        ereport(LOG_VERBOSE, "TLS session tickets are %s",
+                tickets ? "enabled" : "disabled");
+        stat = SSL_OptionSet(sock, SSL_ENABLE_SESSION_TICKETS, tickets);
+    }
+#endif
+
+#ifdef SSL_ENABLE_ALPN
+    // Offer HTTP/2 with ALPN.  NSS moves the first protocol in the list to
+    // the end, so h2 is preferred and http/1.1 is the fallback.
+    if (stat == SECSuccess && PR_TRUE == http2) {
+        static const unsigned char protocols[] = "\010http/1.1\002h2";
+        ereport(LOG_VERBOSE, "HTTP/2 is enabled");
+        stat = SSL_OptionSet(sock, SSL_ENABLE_ALPN, PR_TRUE);
+        if (stat == SECSuccess)
+            stat = SSL_SetNextProtoNego(sock, protocols, sizeof(protocols) - 1);
+    }
+#endif
+
     // If the configuration wants bypass AND the keypairs live in
     // tokens which can allow bypass, do it, otherwise don't.
 
@@ -42,6 +42,10 @@
 #include "frame/conf_api.h"
 #include "support/stringvalue.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #ifdef XP_WIN32
 static PRBool _getfullpathname = -1;
 #endif /* XP_WIN32 */
@@ -73,6 +77,15 @@ NSAPI_PUBLIC int util_uri_is_evil_internal(const char *t, int allow_tilde, int a
     register int x;
 
     for (x = 0; t[x]; ++x) {
+#ifndef XP_WIN32
+        /* Only a '/' can start an evil sequence; skip straight to the next */
+        if (t[x] != '/') {
+            const char *slash = strchr(t + x, '/');
+            if (!slash)
+                break;
+            x = slash - t;
+        }
+#endif
         if (t[x] == '/') {
             if (flagEmptySegment)
                 return 1; // "/;a/b"
@@ -479,6 +492,236 @@ done:
 }
 
 
+/* -------------------- util_canonicalize_uri_unescape -------------------- */
+
+/*
+ * Copy bytes from *pin to *pout up to the first '/' or '%' or end, and
+ * advance both.  SSE2 builds copy and test 16 bytes at a time and only use
+ * the byte loop for the tail.  The output never runs ahead of the input,
+ * so a full 16 byte store is safe whenever 16 bytes of input remain.
+ */
+static inline void uri_copy_plain(const char **pin, const char *end, char **pout)
+{
+    const char *in = *pin;
+    char *out = *pout;
+
+#if defined(__SSE2__)
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i percent = _mm_set1_epi8('%');
+
+    while (end - in >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        _mm_storeu_si128((__m128i *)out, v);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, slash),
+                                                  _mm_cmpeq_epi8(v, percent)));
+        if (mask) {
+#if defined(__GNUC__)
+            int n = __builtin_ctz(mask);
+#else
+            int n = 0;
+            while (!(mask & (1 << n)))
+                n++;
+#endif
+            *pin = in + n;
+            *pout = out + n;
+            return;
+        }
+        in += 16;
+        out += 16;
+    }
+#endif
+
+    while (in < end && *in != '/' && *in != '%')
+        *out++ = *in++;
+
+    *pin = in;
+    *pout = out;
+}
+
+static inline int uri_hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c &= 0xdf; /* [a-f] -> [A-F] */
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static int uri_canonicalize_unescape_2pass(pool_handle_t *pool, const char *uri, int len, char **pcanon, int *pcanonlen)
+{
+    char *canonPath = util_canonicalize_uri(pool, uri, len, NULL);
+    if (!canonPath)
+        return -1;
+
+    if (!util_uri_unescape_strict(canonPath)) {
+        pool_free(pool, canonPath);
+        return 0;
+    }
+
+    *pcanon = canonPath;
+    if (pcanonlen)
+        *pcanonlen = strlen(canonPath);
+
+    return 1;
+}
+
+/*
+ * Produces the same result as util_canonicalize_uri followed by
+ * util_uri_unescape_strict, but in a single pass over the request line.
+ * The rewrite rules are applied to the escaped input, exactly as
+ * util_canonicalize_uri does, while runs between '/'s are copied and
+ * decoded.  A malformed escape only fails the request if it survives
+ * canonicalization.  An escaped '/' would change what a later ".."
+ * removes once decoded, so such URIs, and the unusual ones that don't
+ * start with '/', take the two pass route.
+ *
+ * Returns 1 on success, 0 if the URI contains an invalid escape, or -1 if
+ * the URI points outside the document root.
+ */
+NSAPI_PUBLIC int util_canonicalize_uri_unescape(pool_handle_t *pool, const char *uri, int len, char **pcanon, int *pcanonlen)
+{
+    const char *in_ptr = uri;
+    const char *in_end = uri + len;
+    char *badEscape = NULL;
+    PRBool embeddedNul = PR_FALSE;
+
+    PR_ASSERT(uri != NULL);
+
+    *pcanon = NULL;
+
+    /*
+     * Without a leading '/', backing out of the first segment leaves its
+     * first byte in place, still escaped
+     */
+    if (len > 0 && uri[0] != '/')
+        return uri_canonicalize_unescape_2pass(pool, uri, len, pcanon, pcanonlen);
+
+    char *canonPath = (char *)pool_malloc(pool, len + 1);
+    char *out_ptr = canonPath;
+
+    if (!canonPath)
+        return -1;
+
+    while (in_ptr < in_end) {
+        /* Copy everything up to the next '/' or '%' as is */
+        uri_copy_plain(&in_ptr, in_end, &out_ptr);
+        if (in_ptr == in_end)
+            break;
+
+        if (in_ptr[0] == '%') {
+            int hi = -1;
+            int lo = -1;
+            if (in_end - in_ptr >= 3) {
+                hi = uri_hex_value(in_ptr[1]);
+                lo = uri_hex_value(in_ptr[2]);
+            }
+
+            if (hi < 0 || lo < 0) {
+                /* remember the first malformed escape in the output */
+                if (!badEscape)
+                    badEscape = out_ptr;
+                *out_ptr++ = *in_ptr++;
+                continue;
+            }
+
+            char c = (char)(hi * 16 + lo);
+            if (c == '/') {
+                pool_free(pool, canonPath);
+                return uri_canonicalize_unescape_2pass(pool, uri, len, pcanon, pcanonlen);
+            }
+            if (c == '\0')
+                embeddedNul = PR_TRUE;
+
+            *out_ptr++ = c;
+            in_ptr += 3;
+            continue;
+        }
+
+        /* found '/' and reached end of the input, done */
+        if (in_ptr + 1 >= in_end) {
+            *out_ptr++ = *in_ptr++;
+            break;
+        }
+
+        /* the rewrite rules, as in util_canonicalize_uri */
+        switch (in_ptr[1]) {
+        case '/':
+            /*  '//' => '/'  */
+            in_ptr++;
+            break;
+
+        case '.':
+            if (in_ptr + 2 >= in_end) {
+                /* "/." at the end; keep the '/' */
+                *out_ptr++ = *in_ptr;
+                in_ptr = in_end;
+                break;
+            }
+
+            if (in_ptr[2] == '/') {
+                /* "/./" => "/" */
+                in_ptr += 2;
+                break;
+            }
+
+            if (in_ptr[2] != '.') {
+                /* "/.x" where x is not '.'; copy as is */
+                *out_ptr++ = *in_ptr++;
+                break;
+            }
+
+            if (in_ptr + 3 < in_end && in_ptr[3] != '/' && in_ptr[3] != ';') {
+                /* "/..x"; copy as is */
+                *out_ptr++ = *in_ptr++;
+                break;
+            }
+
+            /* "foo/../" or "foo/.." at the end */
+            if (out_ptr == canonPath) {
+                pool_free(pool, canonPath);
+                return -1;
+            }
+
+            /* remove the previous segment in the output */
+            for (out_ptr--;
+                 out_ptr != canonPath && out_ptr[0] != '/';
+                 out_ptr--); /* Empty Loop */
+
+            if (in_ptr + 3 == in_end)
+                out_ptr++;
+
+            in_ptr += 3;
+
+            /* a malformed escape in the removed segment doesn't count */
+            if (badEscape && badEscape >= out_ptr)
+                badEscape = NULL;
+            break;
+
+        default:
+            /* If we already have '/' at out_ptr we donot need to copy */
+            if (out_ptr == canonPath || *(out_ptr-1) != '/')
+                *out_ptr++ = *in_ptr;
+            in_ptr++;
+            break;
+        }
+    }
+
+    *out_ptr = '\0';
+
+    if (badEscape) {
+        pool_free(pool, canonPath);
+        return 0;
+    }
+
+    *pcanon = canonPath;
+    if (pcanonlen)
+        *pcanonlen = embeddedNul ? strlen(canonPath) : out_ptr - canonPath;
+
+    return 1;
+}
+
+
 /* ---------------------- util_canonicalize_redirect ---------------------- */
 
 NSAPI_PUBLIC char* util_canonicalize_redirect(pool_handle_t *pool, const char *baseUri, const char *newUri)
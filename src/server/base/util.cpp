@@ -807,6 +807,11 @@ NSAPI_PUBLIC void util_uri_unescape(char *s)
 {
     char *t, *u;
 
+    /* Nothing before the first '%' moves */
+    s = strchr(s, '%');
+    if (!s)
+        return;
+
     for(t = s, u = s; *t; ++t, ++u) {
         if((*t == '%') && t[1] && t[2]) {
             *u = ((t[1] >= 'A' ? ((t[1] & 0xdf) - 'A')+10 : (t[1] - '0'))*16) +
@@ -828,8 +833,19 @@ NSAPI_PUBLIC int util_uri_unescape_strict(char *s)
     char *t, *u, t1, t2;
     int rv = 1;
 
+    /* Nothing before the first '%' moves */
+    s = strchr(s, '%');
+    if (!s)
+        return rv;
+
     for(t = s, u = s; *t; ++t, ++u) {
-        if (*t == '%') {
+        if (*t == '%' && (!t[1] || !t[2])) {
+            /* truncated escape; don't read past the end of the string */
+            rv = 0;
+            if (u != t)
+                *u = *t;
+        }
+        else if (*t == '%') {
             t1 = t[1] & 0xdf; /* [a-f] -> [A-F] */
             if ((t1 < 'A' || t1 > 'F') && (t[1] < '0' || t[1] > '9'))
                 rv = 0;
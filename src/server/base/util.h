@@ -134,6 +134,8 @@ NSAPI_PUBLIC char *INTutil_uri_strip_params(char *uri);
 
 NSAPI_PUBLIC char* util_canonicalize_uri(pool_handle_t *pool, const char *uri, int len, int *pcanonlen);
 
+NSAPI_PUBLIC int util_canonicalize_uri_unescape(pool_handle_t *pool, const char *uri, int len, char **pcanon, int *pcanonlen);
+
 NSAPI_PUBLIC char* util_canonicalize_redirect(pool_handle_t *pool, const char *baseUri, const char *newUri);
 
 NSAPI_PUBLIC char *INTutil_url_escape(char *d, const char *s);
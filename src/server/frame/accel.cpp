@@ -70,11 +70,40 @@
 #define CONNECTION_CLOSE "Connection: close\r\n"
 #define CONNECTION_CLOSE_LEN (sizeof(CONNECTION_CLOSE) - 1)
 #define MAX_CONNECTION_HEADER_LEN CONNECTION_KEEP_ALIVE_LEN
+#define STATUS_PARTIAL_CONTENT "206 Partial Content"
+#define STATUS_RANGE_NOT_SATISFIABLE "416 Requested range not satisfiable"
+#define MIME_SEPARATOR_SIZE 35 /* see util_mime_separator() */
+#define MAX_RANGE_HEADERS_LEN (sizeof("Content-range: bytes -/\r\nContent-length: \r\n") + 4 * UTIL_I64TOA_SIZE)
+
+/*
+ * ACCEL_MAX_RANGES is the maximum number of ranges in a Range: header that
+ * the accelerator cache will handle.  Requests for more ranges are processed
+ * by the unaccelerated path.
+ */
+#define ACCEL_MAX_RANGES 16
 
 class AcceleratorGeneration;
 class AcceleratorSet;
 class AcceleratorResource;
 
+/*
+ * AcceleratorRangeStatus is the result of evaluating a Range: header against
+ * a cached 200 response.
+ */
+enum AcceleratorRangeStatus {
+    ACCEL_RANGE_NONE = 0,   /* send the full 200 response */
+    ACCEL_RANGE_DECLINE,    /* use the unaccelerated path */
+    ACCEL_RANGE_PARTIAL     /* send a 206 or 416 response */
+};
+
+/*
+ * AcceleratorByteRange is a satisfiable byte range from a Range: header.
+ */
+struct AcceleratorByteRange {
+    PROffset64 start;
+    PROffset64 end;
+};
+
 typedef UriMap<AcceleratorResource *> AcceleratorMap;
 typedef UriMapper<AcceleratorResource *> AcceleratorMapper;
 
@@ -173,6 +202,20 @@ struct AcceleratorData {
         char *p;
         int len;
     } headers;
+    struct {
+        PROffset64 size;
+        char *last_modified;
+        char *content_type;
+        char separator[MIME_SEPARATOR_SIZE];
+        struct {
+            char *p;
+            int len;
+        } headers206;
+        struct {
+            char *p;
+            int len;
+        } headers416;
+    } range;
     struct {
         FlexLog *log;
     } flex;
@@ -342,6 +385,8 @@ volatile PRUint64 accel_gens_destroyed;
 volatile PRUint64 accel_handles_created;
 volatile PRUint64 accel_process_http_success;
 volatile PRUint64 accel_async_service_success;
+volatile PRUint64 accel_range_success;
+volatile PRUint64 accel_range_declined;
 
 
 /* ------------------------ accel_get_http_entries ------------------------ */
@@ -795,9 +840,7 @@ PRBool accel_is_eligible(Connection *connection)
                            (size_t) httpHeader.GetPragma() |
                            (size_t) httpHeader.GetCacheControl() |
                            (size_t) httpHeader.GetIfMatch() |
-                           (size_t) httpHeader.GetIfRange() |
                            (size_t) httpHeader.GetIfUnmodifiedSince() |
-                           (size_t) httpHeader.GetRange() |
                            (size_t) httpHeader.GetContentLength() |
                            (size_t) httpHeader.GetTransferEncoding();
  
@@ -819,15 +862,17 @@ static inline void accel_finish_headers(pool_handle_t *pool,
                                         const char *prefix, int plen,
                                         int protv_num,
                                         PRBool keep_alive,
-                                        char **p, int *sz)
+                                        char **p, int *sz,
+                                        int extra)
 {
     char *buf = NULL;
     int pos = 0;
 
-    // HTTP/1.0 and higher responses have headers
+    // HTTP/1.0 and higher responses have headers.  The caller may ask for
+    // extra bytes at the end of the buffer for data that follows the headers.
     if (protv_num >= PROTOCOL_VERSION_HTTP10) {
         int maxsz = plen + DATE_HEADER_VALUE_SIZE + 2 + MAX_CONNECTION_HEADER_LEN + 2;
-        buf = (char *) pool_malloc(pool, maxsz);
+        buf = (char *) pool_malloc(pool, maxsz + extra);
 
         memcpy(buf, prefix, plen);
         pos += plen;
@@ -962,6 +1007,292 @@ static inline const AcceleratorData *accel_lookup_http(AcceleratorGeneration *ge
 }
 
 
+/* -------------------------- accel_parse_ranges -------------------------- */
+
+static int accel_parse_ranges(const char *p,
+                              PROffset64 size,
+                              AcceleratorByteRange *ranges,
+                              PRBool *unsatisfiable)
+{
+    // Returns the number of satisfiable ranges, -1 if the Range: header
+    // should be ignored, or -2 if the unaccelerated path should handle it.
+    // This mirrors the semantics of _ranges_parse() in safs/service.cpp.
+    int n = 0;
+
+    *unsatisfiable = PR_FALSE;
+
+    if (strncmp(p, "bytes=", 6))
+        return -1;
+    p += 6;
+
+    if (strchr(p, ';'))
+        return -2;
+
+    while (p) {
+        const char *comma = strchr(p, ',');
+        const char *limit = comma ? comma : p + strlen(p);
+        const char *next = (comma && comma[1]) ? comma + 1 : NULL;
+
+        const char *dash = (const char *) memchr(p, '-', limit - p);
+        if (!dash)
+            return -1;
+        if (memchr(dash + 1, '-', limit - dash - 1))
+            return -1;
+
+        while (isspace(*p))
+            p++;
+
+        PROffset64 start;
+        if (*p == '-') {
+            start = -1;
+        } else if (isdigit(*p)) {
+            start = util_atoi64(p);
+        } else {
+            return -1;
+        }
+
+        p = dash + 1;
+        while (p < limit && isspace(*p))
+            p++;
+
+        PROffset64 end;
+        if (p == limit) {
+            if (start == -1)
+                return -1;
+            end = size - 1;
+        } else if (isdigit(*p)) {
+            end = util_atoi64(p);
+        } else {
+            return -1;
+        }
+
+        // Range: bytes=-500 (last 500 bytes)
+        if (start == -1) {
+            start = size - end;
+            if (start < 0 && size != 0)
+                start = 0;
+            end = size - 1;
+        }
+        if (end == -1 || end >= size)
+            end = size - 1;
+
+        if (start >= size) {
+            *unsatisfiable = PR_TRUE;
+        } else if (start < 0 || end < 0 || end < start) {
+            return -1;
+        } else {
+            if (n == ACCEL_MAX_RANGES)
+                return -2;
+            ranges[n].start = start;
+            ranges[n].end = end;
+            n++;
+        }
+
+        p = next;
+    }
+
+    return n;
+}
+
+
+/* ------------------------- accel_prepare_range -------------------------- */
+
+static AcceleratorRangeStatus accel_prepare_range(pool_handle_t *pool,
+                                                  Connection *connection,
+                                                  const AcceleratorData *data,
+                                                  int *status_num,
+                                                  char **headers, int *hlen,
+                                                  NSFCRange **ranges,
+                                                  int *nranges)
+{
+    const HttpHeader &httpHeader = connection->httpHeader;
+
+    // Only 200 responses can be turned into 206 responses
+    if (data->status_num != 200 || !httpHeader.GetRange())
+        return ACCEL_RANGE_NONE;
+
+    int protv_num = httpHeader.GetNegotiatedProtocolVersion();
+    if (protv_num < PROTOCOL_VERSION_HTTP10)
+        return ACCEL_RANGE_NONE;
+
+    if (!data->range.headers206.p)
+        return ACCEL_RANGE_DECLINE;
+
+    // Ignore Range: if the client's copy is out of date
+    AcceleratorHHString ir(httpHeader.GetIfRange());
+    if (ir && !http_match_if_range(ir, data->etag, data->range.last_modified))
+        return ACCEL_RANGE_NONE;
+
+    PROffset64 size = data->range.size;
+    AcceleratorByteRange br[ACCEL_MAX_RANGES];
+    PRBool unsatisfiable;
+    int n;
+    {
+        AcceleratorHHString range(httpHeader.GetRange());
+        n = accel_parse_ranges(range, size, br, &unsatisfiable);
+    }
+    if (n == -2) {
+        accel_range_declined++;
+        return ACCEL_RANGE_DECLINE;
+    }
+    if (n == 0 && (!unsatisfiable || ir || protv_num < PROTOCOL_VERSION_HTTP11))
+        return ACCEL_RANGE_NONE;
+    if (n < 0)
+        return ACCEL_RANGE_NONE;
+
+    const char *ct = data->range.content_type;
+    int ctlen = ct ? strlen(ct) : 0;
+    char *prefix;
+    int plen = 0;
+    int psz;
+    int i;
+
+    if (n == 0) {
+        // 416 Requested range not satisfiable
+        psz = data->range.headers416.len + MAX_RANGE_HEADERS_LEN + DATE_HEADER_NAME_LEN;
+        prefix = (char *) pool_malloc(pool, psz);
+        memcpy(prefix, data->range.headers416.p, data->range.headers416.len);
+        plen += data->range.headers416.len;
+        plen += util_snprintf(prefix + plen, psz - plen,
+                              "Content-range: bytes */%lld\r\n"
+                              "Content-length: 0\r\n",
+                              size);
+        memcpy(prefix + plen, DATE_HEADER_NAME, DATE_HEADER_NAME_LEN);
+        plen += DATE_HEADER_NAME_LEN;
+
+        accel_finish_headers(pool, prefix, plen, protv_num,
+                             connection->fKeepAliveReservation,
+                             headers, hlen, 0);
+        pool_free(pool, prefix);
+
+        // 416 responses consist of headers alone
+        *status_num = PROTOCOL_REQUESTED_RANGE_NOT_SATISFIABLE;
+        *ranges = NULL;
+        *nranges = 0;
+
+        return ACCEL_RANGE_PARTIAL;
+    }
+
+    psz = data->range.headers206.len + ctlen + MIME_SEPARATOR_SIZE +
+          MAX_RANGE_HEADERS_LEN + 64 + DATE_HEADER_NAME_LEN;
+    prefix = (char *) pool_malloc(pool, psz);
+    memcpy(prefix, data->range.headers206.p, data->range.headers206.len);
+    plen += data->range.headers206.len;
+
+    char *parts = NULL;
+    int partslen = 0;
+    int partlen[ACCEL_MAX_RANGES + 1];
+
+    if (n == 1) {
+        // Single part 206 Partial Content
+        if (ct)
+            plen += util_snprintf(prefix + plen, psz - plen,
+                                  "Content-type: %s\r\n", ct);
+        plen += util_snprintf(prefix + plen, psz - plen,
+                              "Content-range: bytes %lld-%lld/%lld\r\n"
+                              "Content-length: %lld\r\n",
+                              br[0].start, br[0].end, size,
+                              br[0].end - br[0].start + 1);
+    } else {
+        // Multipart 206 Partial Content.  Each part begins with a separator
+        // and part headers; the last part is followed by a closing separator.
+        const char *sep = data->range.separator;
+        int seplen = strlen(sep);
+        int partsz = n * (seplen + 2 + ctlen + 16 + MAX_RANGE_HEADERS_LEN) + seplen + 4;
+        parts = (char *) pool_malloc(pool, partsz);
+
+        PROffset64 cl = 0;
+        for (i = 0; i < n; i++) {
+            int pos = partslen;
+            memcpy(parts + partslen, sep, seplen);
+            partslen += seplen;
+            if (ct)
+                partslen += util_snprintf(parts + partslen, partsz - partslen,
+                                          "\r\nContent-type: %s", ct);
+            partslen += util_snprintf(parts + partslen, partsz - partslen,
+                                      "\r\n%s: bytes %lld-%lld/%lld\r\n\r\n",
+                                      protv_num >= PROTOCOL_VERSION_HTTP11 ? "Content-range" : "Range",
+                                      br[i].start, br[i].end, size);
+            partlen[i] = partslen - pos;
+            cl += partlen[i] + br[i].end - br[i].start + 1;
+        }
+        memcpy(parts + partslen, sep, seplen);
+        memcpy(parts + partslen + seplen, "--\r\n", 4);
+        partlen[n] = seplen + 4;
+        partslen += partlen[n];
+        cl += partlen[n];
+        PR_ASSERT(partslen <= partsz);
+
+        plen += util_snprintf(prefix + plen, psz - plen,
+                              "Content-type: multipart/%sbyteranges; boundary=%s\r\n"
+                              "Content-length: %lld\r\n",
+                              protv_num >= PROTOCOL_VERSION_HTTP11 ? "" : "x-",
+                              sep + 4, cl);
+    }
+
+    memcpy(prefix + plen, DATE_HEADER_NAME, DATE_HEADER_NAME_LEN);
+    plen += DATE_HEADER_NAME_LEN;
+    PR_ASSERT(plen <= psz);
+
+    // Format the response headers, leaving room for any part headers
+    char *buf;
+    int len;
+    accel_finish_headers(pool, prefix, plen, protv_num,
+                         connection->fKeepAliveReservation,
+                         &buf, &len, partslen);
+    pool_free(pool, prefix);
+
+    NSFCRange *r = (NSFCRange *) pool_malloc(pool, (n + 1) * sizeof(NSFCRange));
+    if (n == 1) {
+        r[0].header = buf;
+        r[0].hdrlen = len;
+        r[0].offset = br[0].start;
+        r[0].length = br[0].end - br[0].start + 1;
+    } else {
+        // Lay the part headers out after the response headers so the whole
+        // response preamble is a single contiguous buffer
+        memcpy(buf + len, parts, partslen);
+        pool_free(pool, parts);
+
+        const char *h = buf + len;
+        for (i = 0; i < n; i++) {
+            r[i].header = h;
+            r[i].hdrlen = partlen[i];
+            r[i].offset = br[i].start;
+            r[i].length = br[i].end - br[i].start + 1;
+            h += partlen[i];
+        }
+        r[0].header = buf;
+        r[0].hdrlen += len;
+        r[n].header = h;
+        r[n].hdrlen = partlen[n];
+        r[n].offset = 0;
+        r[n].length = 0;
+    }
+
+    *status_num = PROTOCOL_PARTIAL_CONTENT;
+    *headers = buf;
+    *hlen = len;
+    *ranges = r;
+    *nranges = (n == 1) ? 1 : n + 1;
+
+    return ACCEL_RANGE_PARTIAL;
+}
+
+
+/* ------------------------ accel_range_text_length ------------------------ */
+
+static inline int accel_range_text_length(const NSFCRange *ranges, int nranges)
+{
+    // Returns the length of the contiguous buffer that holds the response
+    // headers and any part headers
+    int len = 0;
+    for (int i = 0; i < nranges; i++)
+        len += ranges[i].hdrlen;
+    return len;
+}
+
+
 /* ------------------ accel_handle_ssl_unclean_shutdown ------------------- */
 
 static inline void accel_handle_ssl_unclean_shutdown(const AcceleratorData *data, Connection *connection)
@@ -979,12 +1310,29 @@ static inline void accel_handle_ssl_unclean_shutdown(const AcceleratorData *data
 }
 
 
+/* ------------------------- accel_status_string -------------------------- */
+
+static inline const char *accel_status_string(const AcceleratorData *data,
+                                              int status_num)
+{
+    switch (status_num) {
+    case PROTOCOL_PARTIAL_CONTENT:
+        return "206";
+    case PROTOCOL_REQUESTED_RANGE_NOT_SATISFIABLE:
+        return "416";
+    default:
+        return data->status;
+    }
+}
+
+
 /* ------------------------------ accel_log ------------------------------- */
 
 static inline void accel_log(pool_handle_t *pool,
                              Connection *connection,
                              int hlen,
                              const AcceleratorData *data,
+                             int status_num,
                              PRInt64 transmitted)
 {
     if (data->flex.log) {
@@ -998,7 +1346,7 @@ static inline void accel_log(pool_handle_t *pool,
         flex_log_accel(data->flex.log,
                        pool,
                        connection,
-                       data->status, 3,
+                       accel_status_string(data, status_num), 3,
                        data->vsid.p, data->vsid.len,
                        cl);
     }
@@ -1008,6 +1356,7 @@ static inline void accel_log_async(pool_handle_t *pool,
                                    Connection *connection,
                                    int hlen,
                                    const AcceleratorData *data,
+                                   int status_num,
                                    PRInt64 transmitted,
                                    LogBuffer **handle)
 {
@@ -1022,7 +1371,7 @@ static inline void accel_log_async(pool_handle_t *pool,
         flex_log_accel_async(data->flex.log,
                              pool,
                              connection,
-                             data->status, 3,
+                             accel_status_string(data, status_num), 3,
                              data->vsid.p, data->vsid.len,
                              cl, handle);
     }
@@ -1042,20 +1391,51 @@ PRBool accel_process_http(AcceleratorHandle *handle,
     AcceleratorGeneration *gen = accel_begin(handle);
     if (gen) {
         const AcceleratorData *data = accel_lookup_http(gen, connection, vs);
+
+        // Figure out whether to send a 206 or 416 response instead
+        int rstatus_num = 0;
+        char *headers;
+        int hlen;
+        NSFCRange *ranges;
+        int nranges = 0;
         if (data) {
-            char *headers;
-            int hlen;
-            accel_finish_headers(pool,
-                                 data->headers.p, data->headers.len,
-                                 connection->httpHeader.GetNegotiatedProtocolVersion(),
-                                 connection->fKeepAliveReservation,
-                                 &headers, &hlen);
+            switch (accel_prepare_range(pool, connection, data,
+                                        &rstatus_num, &headers, &hlen,
+                                        &ranges, &nranges)) {
+            case ACCEL_RANGE_DECLINE:
+                data = NULL;
+                break;
+
+            case ACCEL_RANGE_NONE:
+                accel_finish_headers(pool,
+                                     data->headers.p, data->headers.len,
+                                     connection->httpHeader.GetNegotiatedProtocolVersion(),
+                                     connection->fKeepAliveReservation,
+                                     &headers, &hlen,
+                                     0);
+                rstatus_num = data->status_num;
+                break;
+
+            case ACCEL_RANGE_PARTIAL:
+                break;
+            }
+        }
 
+        if (data) {
             PRInt64 nbytes;
-            if (data->status_num == 304) {
-                // Send a 304 response
+            if (rstatus_num == 304 || rstatus_num == 416) {
+                // Send a 304 or 416 response
                 PRFileDesc *csd = connection->fd;
                 nbytes = csd->methods->write(csd, headers, hlen);
+            } else if (rstatus_num == 206) {
+                // Send a 206 response
+                NSFCStatusInfo si;
+                nbytes = NSFC_TransmitEntryRanges(connection->fd,
+                                                  data->entry,
+                                                  ranges, nranges,
+                                                  PR_INTERVAL_NO_TIMEOUT,
+                                                  accel_nsfc_cache,
+                                                  &si);
             } else {
                 // Send a 200 response
                 NSFCStatusInfo si;
@@ -1072,11 +1452,13 @@ PRBool accel_process_http(AcceleratorHandle *handle,
 
             accel_handle_ssl_unclean_shutdown(data, connection);
 
-            accel_log(pool, connection, hlen, data, nbytes);
+            accel_log(pool, connection, hlen, data, rstatus_num, nbytes);
 
             accel_process_http_success++;
+            if (rstatus_num != data->status_num)
+                accel_range_success++;
 
-            *status_num = data->status_num;
+            *status_num = rstatus_num;
             *transmitted = nbytes;
 
             rv = PR_TRUE;
@@ -1130,15 +1512,18 @@ void accel_async_end(AcceleratorAsync *async)
         // If we get here, an async operation should be in progress
         PR_ASSERT(connection->async.accel.data);
 
-        // The headers were allocated from the pool, and the pool can be
-        // recycled after accel_async_end() returns.  Don't leave dangling
-        // pointers into the pool.
-        const char *old_headers_p = connection->async.accel.headers.p;
-        connection->async.accel.headers.p = NULL;
-
         // If this is the first time we've had to resume this response on this
         // connection...
         if (!connection->async.accel.gen) {
+            // The headers were allocated from the pool, and the pool can be
+            // recycled after accel_async_end() returns.  Don't leave dangling
+            // pointers into the pool.  (On later resumptions, any headers and
+            // ranges are already copies on the permanent heap.)
+            const char *old_headers_p = connection->async.accel.headers.p;
+            const NSFCRange *old_ranges_p = connection->async.accel.ranges.p;
+            connection->async.accel.headers.p = NULL;
+            connection->async.accel.ranges.p = NULL;
+
             // Give the connection a reference to the generation that contains
             // the in-progress cached response
             async->gen->ref();
@@ -1148,8 +1533,27 @@ void accel_async_end(AcceleratorAsync *async)
             // will need a copy allocated from the permanent heap.  (This is
             // inefficient, but it should rarely happen in practice; typically,
             // we'll always be able to send the complete headers on the first
-            // accel_async_http().)
-            if (connection->async.accel.offset < connection->async.accel.headers.len) {
+            // accel_async_http().)  A 206 response always needs a copy as
+            // its part headers are interleaved with the file content.
+            int n = connection->async.accel.ranges.n;
+            if (n) {
+                int len = accel_range_text_length(old_ranges_p, n);
+                char *p = (char *) PERM_MALLOC(len);
+                NSFCRange *ranges = (NSFCRange *) PERM_MALLOC(n * sizeof(NSFCRange));
+                if (p && ranges) {
+                    memcpy(p, old_headers_p, len);
+                    for (int i = 0; i < n; i++) {
+                        ranges[i] = old_ranges_p[i];
+                        ranges[i].header = p + ((const char *) old_ranges_p[i].header - old_headers_p);
+                    }
+                    connection->async.accel.headers.p = p;
+                    connection->async.accel.ranges.p = ranges;
+                } else {
+                    PERM_FREE(p);
+                    PERM_FREE(ranges);
+                    connection->async.accel.ranges.n = 0;
+                }
+            } else if (connection->async.accel.offset < connection->async.accel.headers.len) {
                 char *p = (char *) PERM_MALLOC(connection->async.accel.headers.len);
                 if (p) {
                     memcpy(p, old_headers_p, connection->async.accel.headers.len);
@@ -1186,6 +1590,7 @@ void accel_async_end(AcceleratorAsync *async)
                         connection,
                         connection->async.accel.headers.len,
                         connection->async.accel.data,
+                        connection->async.accel.status_num,
                         connection->async.accel.offset,
                         &handle);
 
@@ -1199,15 +1604,19 @@ void accel_async_end(AcceleratorAsync *async)
             connection->async.accel.gen->unref();
             connection->async.accel.gen = NULL;
 
-            // Free the copy of the headers that we previously placed on the
-            // permanent heap
+            // Free the copy of the headers and ranges that we previously
+            // placed on the permanent heap
             PERM_FREE(connection->async.accel.headers.p);
+            PERM_FREE(connection->async.accel.ranges.p);
         }
 
         // Indicate that no async operation is in progress
         connection->async.accel.data = NULL;
         connection->async.accel.headers.p = NULL;
         connection->async.accel.headers.len = 0;
+        connection->async.accel.ranges.p = NULL;
+        connection->async.accel.ranges.n = 0;
+        connection->async.accel.status_num = 0;
         connection->async.accel.offset = 0;
     }
 
@@ -1258,8 +1667,9 @@ static inline AcceleratorAsyncStatus accel_async_transmit(Connection *connection
 {
     AcceleratorAsyncStatus rv;
 
-    if (connection->async.accel.data->status_num == 304) {
-        // Send a 304 response
+    if (connection->async.accel.status_num == 304 ||
+        connection->async.accel.status_num == 416) {
+        // Send a 304 or 416 response
         ssize_t written = write(connection->async.fd,
                                 connection->async.accel.headers.p + connection->async.accel.offset,
                                 connection->async.accel.headers.len - connection->async.accel.offset);
@@ -1279,13 +1689,24 @@ static inline AcceleratorAsyncStatus accel_async_transmit(Connection *connection
             }
         }
     } else {
-        // Send a 200 response
-        NSFCAsyncStatus nas = NSFC_TransmitAsync(connection->async.fd,
-                                                 connection->async.accel.data->entry,
-                                                 connection->async.accel.headers.p,
-                                                 connection->async.accel.headers.len,
-                                                 &connection->async.accel.offset,
-                                                 accel_nsfc_cache);
+        NSFCAsyncStatus nas;
+        if (connection->async.accel.ranges.n) {
+            // Send a 206 response
+            nas = NSFC_TransmitAsyncRanges(connection->async.fd,
+                                           connection->async.accel.data->entry,
+                                           connection->async.accel.ranges.p,
+                                           connection->async.accel.ranges.n,
+                                           &connection->async.accel.offset,
+                                           accel_nsfc_cache);
+        } else {
+            // Send a 200 response
+            nas = NSFC_TransmitAsync(connection->async.fd,
+                                     connection->async.accel.data->entry,
+                                     connection->async.accel.headers.p,
+                                     connection->async.accel.headers.len,
+                                     &connection->async.accel.offset,
+                                     accel_nsfc_cache);
+        }
         if (nas == NSFC_ASYNCSTATUS_AGAIN) {
             rv = ACCEL_ASYNC_AGAIN;
             ereport(LOG_VERBOSE, "Accelerator Cache ACCEL_ASYNC_AGAIN, offset = %lld", (long long) connection->async.accel.offset);
@@ -1325,13 +1746,31 @@ AcceleratorAsyncStatus accel_async_service(AcceleratorAsync *async,
         // Format headers for the response.  We start off allocating them from
         // the pool in hopes that we can send them in a single try.  If we
         // can't, accel_async_end() will create a copy on the permanent heap.
-        accel_finish_headers(async->pool,
-                             connection->async.accel.data->headers.p,
-                             connection->async.accel.data->headers.len,
-                             connection->httpHeader.GetNegotiatedProtocolVersion(),
-                             connection->fKeepAliveReservation,
-                             &connection->async.accel.headers.p,
-                             &connection->async.accel.headers.len);
+        const AcceleratorData *data = connection->async.accel.data;
+        AcceleratorRangeStatus rs;
+        rs = accel_prepare_range(async->pool, connection, data,
+                                 &connection->async.accel.status_num,
+                                 &connection->async.accel.headers.p,
+                                 &connection->async.accel.headers.len,
+                                 &connection->async.accel.ranges.p,
+                                 &connection->async.accel.ranges.n);
+        if (rs == ACCEL_RANGE_DECLINE) {
+            // Indicate that no async operation is in progress
+            connection->async.accel.data = NULL;
+            return ACCEL_ASYNC_FALSE;
+        }
+
+        if (rs == ACCEL_RANGE_NONE) {
+            accel_finish_headers(async->pool,
+                                 data->headers.p,
+                                 data->headers.len,
+                                 connection->httpHeader.GetNegotiatedProtocolVersion(),
+                                 connection->fKeepAliveReservation,
+                                 &connection->async.accel.headers.p,
+                                 &connection->async.accel.headers.len,
+                                 0);
+            connection->async.accel.status_num = data->status_num;
+        }
     }
 
 
@@ -1360,8 +1799,11 @@ AcceleratorAsyncStatus accel_async_service(AcceleratorAsync *async,
         // do async operations on SSL-enabled sockets
         PR_ASSERT(!connection->fSSLEnabled);
 
+        if (connection->async.accel.status_num != connection->async.accel.data->status_num)
+            accel_range_success++;
+
         // Report status back to the caller
-        *status_num =  connection->async.accel.data->status_num;
+        *status_num = connection->async.accel.status_num;
         *transmitted = connection->async.accel.offset;
         break;
 
@@ -1375,6 +1817,9 @@ AcceleratorAsyncStatus accel_async_service(AcceleratorAsync *async,
         connection->async.accel.data = NULL;
         connection->async.accel.headers.p = NULL;
         connection->async.accel.headers.len = 0;
+        connection->async.accel.ranges.p = NULL;
+        connection->async.accel.ranges.n = 0;
+        connection->async.accel.status_num = 0;
         connection->async.accel.offset = 0;
         break;
     }
@@ -1461,6 +1906,58 @@ static inline void accel_store_entity_headers(Session *sn,
 }
 
 
+/* ---------------------- accel_store_range_headers ----------------------- */
+
+static inline void accel_store_range_headers(Session *sn,
+                                             Request *rq,
+                                             AcceleratorData *data)
+{
+    // Remove the header fields that describe the full entity or a particular
+    // connection.  accel_prepare_range() will generate its own.
+    pb_param *connection = pblock_removekey(pb_key_connection, rq->srvhdrs);
+    pb_param *content_length = pblock_removekey(pb_key_content_length, rq->srvhdrs);
+    pb_param *content_type = pblock_removekey(pb_key_content_type, rq->srvhdrs);
+    pb_param *status = pblock_removekey(pb_key_status, rq->srvhdrs);
+
+    data->range.content_type = content_type ? PERM_STRDUP(content_type->value) : NULL;
+
+    // Format the 206 headers
+    pblock_kvinsert(pb_key_status, STATUS_PARTIAL_CONTENT, sizeof(STATUS_PARTIAL_CONTENT) - 1, rq->srvhdrs);
+    char *buf = (char *) pool_malloc(sn->pool, REQ_MAX_LINE);
+    int pos = 0;
+    pos += http_format_status(sn, rq, buf + pos, REQ_MAX_LINE - pos);
+    pos += http_format_server(sn, rq, buf + pos, REQ_MAX_LINE - pos);
+    buf = http_dump822_with_slack(rq->srvhdrs, buf, &pos, REQ_MAX_LINE, 0);
+    data->range.headers206.p = (char *) PERM_MALLOC(pos);
+    memcpy(data->range.headers206.p, buf, pos);
+    data->range.headers206.len = pos;
+    param_free(pblock_removekey(pb_key_status, rq->srvhdrs));
+
+    // Format the 416 status line
+    pblock_kvinsert(pb_key_status, STATUS_RANGE_NOT_SATISFIABLE, sizeof(STATUS_RANGE_NOT_SATISFIABLE) - 1, rq->srvhdrs);
+    pos = 0;
+    pos += http_format_status(sn, rq, buf + pos, REQ_MAX_LINE - pos);
+    pos += http_format_server(sn, rq, buf + pos, REQ_MAX_LINE - pos);
+    data->range.headers416.p = (char *) PERM_MALLOC(pos);
+    memcpy(data->range.headers416.p, buf, pos);
+    data->range.headers416.len = pos;
+    param_free(pblock_removekey(pb_key_status, rq->srvhdrs));
+
+    // Each cached response gets its own multipart/byteranges boundary
+    util_mime_separator(data->range.separator);
+
+    // Restore the original header fields
+    if (status)
+        pblock_kpinsert(pb_key_status, status, rq->srvhdrs);
+    if (content_type)
+        pblock_kpinsert(pb_key_content_type, content_type, rq->srvhdrs);
+    if (content_length)
+        pblock_kpinsert(pb_key_content_length, content_length, rq->srvhdrs);
+    if (connection)
+        pblock_kpinsert(pb_key_connection, connection, rq->srvhdrs);
+}
+
+
 /* -------------------------- accel_data_create --------------------------- */
 
 static AcceleratorData *accel_data_create(Session *sn,
@@ -1510,6 +2007,21 @@ static AcceleratorData *accel_data_create(Session *sn,
         data->flex.log = nrq->accel_flex_log;
         data->internal = PR_FALSE;
     }
+    data->range.size = finfo->pr.size;
+    data->range.last_modified = NULL;
+    data->range.content_type = NULL;
+    data->range.separator[0] = '\0';
+    data->range.headers206.p = NULL;
+    data->range.headers206.len = 0;
+    data->range.headers416.p = NULL;
+    data->range.headers416.len = 0;
+    if (data->status_num == 200 && !data->internal) {
+        // Remember what we need to turn this into a 206 or 416 response
+        const char *lm = pblock_findkeyval(pb_key_last_modified, rq->srvhdrs);
+        if (lm)
+            data->range.last_modified = PERM_STRDUP(lm);
+        accel_store_range_headers(sn, rq, data);
+    }
     if (nrq->accel_ssl_unclean_shutdown_browser) {
         data->ssl_unclean_shutdown_browser = PERM_STRDUP(nrq->accel_ssl_unclean_shutdown_browser);
     } else {
@@ -1533,6 +2045,10 @@ static void accel_data_free(AcceleratorData *data)
         PERM_FREE(data->uri);
         PERM_FREE(data->etag);
         PERM_FREE(data->headers.p);
+        PERM_FREE(data->range.last_modified);
+        PERM_FREE(data->range.content_type);
+        PERM_FREE(data->range.headers206.p);
+        PERM_FREE(data->range.headers416.p);
         PERM_FREE(data->ssl_unclean_shutdown_browser);
         PERM_FREE(data);
     }
@@ -1726,6 +2242,9 @@ void accel_init_connection(Connection *connection)
     connection->async.accel.data = NULL;
     connection->async.accel.headers.p = NULL;
     connection->async.accel.headers.len = 0;
+    connection->async.accel.ranges.p = NULL;
+    connection->async.accel.ranges.n = 0;
+    connection->async.accel.status_num = 0;
     connection->async.accel.offset = 0;
 }
 
@@ -84,6 +84,11 @@ typedef struct AcceleratorConnectionAsyncState {
         char *p;
         int len;
     } headers;
+    struct {
+        struct NSFCRange *p;
+        int n;
+    } ranges;
+    int status_num;
     PRInt64 offset;
 } AcceleratorConnectionAsyncState;
 
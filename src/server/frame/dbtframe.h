@@ -189,4 +189,5 @@ BEGIN_STR(frame)
     ResDef(DBT_confFileXLineYDirectiveZJavaDeprecated, 304, "CONF2304: File %s, line %d: the %s directive is deprecated for Java Enabled Server")
      ResDef(DBT_ProtocolDefault4xxMsg_2, 305, "The server is unable to process your request.")
      ResDef(DBT_ProtocolDefault5xxMsg_2, 306, "The server encountered an error that prevents it from fulfilling your request.")
+     ResDef(DBT_ErrorReadingRequestBody, 307, "Premature end of request message body")
 END_STR(frame)
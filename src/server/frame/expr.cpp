@@ -58,6 +58,7 @@
 #include "expr_parse.h"
 #include "expr_yy.h"
 #include "expr_pvt.h"
+#include "expr_code_pvt.h"
 
 
 /*
@@ -456,6 +457,141 @@ void Expression::setConstString(const char *s)
 }
 
 
+/* --------------------- warn_of_non_numeric_operands --------------------- */
+
+static void warn_of_non_numeric_operands(Context& context, const char *fn, const Result& l, const Result& r)
+{
+    if (ereport_can_log(LOG_VERBOSE)) {
+        const char *operand;
+
+        operand = l.getConstString();
+        if (strcspn(operand, NUMERIC_CHARSET)) {
+            log_error(LOG_VERBOSE, fn, context.sn, context.rq,
+                      "Numeric operator operand \"%s\" contains non-numeric characters",
+                      operand);
+        }
+
+        operand = r.getConstString();
+        if (strcspn(operand, NUMERIC_CHARSET)) {
+            log_error(LOG_VERBOSE, fn, context.sn, context.rq,
+                      "Numeric operator operand \"%s\" contains non-numeric characters",
+                      operand);
+        }
+    }
+}
+
+
+/* ------------------------- expr_op_numeric_cmp -------------------------- */
+
+Result expr_op_numeric_cmp(Context& context, const char *fn, int yychar, const Result& l, const Result& r)
+{
+    if (l.isString() || r.isString())
+        warn_of_non_numeric_operands(context, fn, l, r);
+
+    PRInt64 cmp = l.getInteger() - r.getInteger();
+
+    PRBool result;
+    switch (yychar) {
+    case EXPR_TOKEN_EQUALS_EQUALS: result = (cmp == 0); break;
+    case EXPR_TOKEN_BANG_EQUALS: result = (cmp != 0); break;
+    case EXPR_TOKEN_LEFTANGLE: result = (cmp < 0); break;
+    case EXPR_TOKEN_LEFTANGLE_EQUALS: result = (cmp <= 0); break;
+    case EXPR_TOKEN_RIGHTANGLE: result = (cmp > 0); break;
+    case EXPR_TOKEN_RIGHTANGLE_EQUALS: result = (cmp >= 0); break;
+    default: PR_ASSERT(0);
+    }
+
+    return context.createBooleanResult(result);
+}
+
+
+/* -------------------------- expr_op_string_cmp -------------------------- */
+
+Result expr_op_string_cmp(Context& context, int yychar, const Result& l, const Result& r)
+{
+    int cmp = strcmp(l.getConstString(), r.getConstString());
+
+    PRBool result;
+    switch (yychar) {
+    case EXPR_TOKEN_E_Q: result = (cmp == 0); break;
+    case EXPR_TOKEN_N_E: result = (cmp != 0); break;
+    case EXPR_TOKEN_L_T: result = (cmp < 0); break;
+    case EXPR_TOKEN_L_E: result = (cmp <= 0); break;
+    case EXPR_TOKEN_G_T: result = (cmp > 0); break;
+    case EXPR_TOKEN_G_E: result = (cmp >= 0); break;
+    default: PR_ASSERT(0);
+    }
+
+    return context.createBooleanResult(result);
+}
+
+
+/* -------------------------- expr_op_arithmetic -------------------------- */
+
+Result expr_op_arithmetic(Context& context, char op, const Result& l, const Result& r)
+{
+    if (l.isString() || r.isString()) {
+        char fn[2] = { op, '\0' };
+        warn_of_non_numeric_operands(context, fn, l, r);
+    }
+
+    PRInt64 result;
+    switch (op) {
+    case '+': result = l.getInteger() + r.getInteger(); break;
+    case '-': result = l.getInteger() - r.getInteger(); break;
+    case '*': result = l.getInteger() * r.getInteger(); break;
+    case '/': result = l.getInteger() / r.getInteger(); break;
+    case '%': result = l.getInteger() % r.getInteger(); break;
+    default: PR_ASSERT(0);
+    }
+
+    return context.createIntegerResult(result);
+}
+
+
+/* ---------------------------- expr_op_concat ---------------------------- */
+
+Result expr_op_concat(Context& context, const Result& l, const Result& r)
+{
+    int len = l.getStringLength() + r.getStringLength();
+
+    char *p = (char *) pool_malloc(context.pool, len + 1);
+    if (p == NULL)
+        return context.createOutOfMemoryErrorResult();
+
+    memcpy(p, l.getConstString(), l.getStringLength());
+    memcpy(p + l.getStringLength(), r.getConstString(), r.getStringLength());
+    p[len] = '\0';
+
+    return context.createPooledStringResult(p, len);
+}
+
+
+/* --------------------------- expr_op_wildcard --------------------------- */
+
+Result expr_op_wildcard(Context& context, const Result& l, const Result& r)
+{
+    // <Client> tag compatibility: if the left operand is a boolean and the
+    // right operand is a string that contains a boolean, do a simple boolean
+    // equality test.  For example, <Client security="on">.
+    if (l.isBoolean() && r.isBoolean()) {
+        return context.createBooleanResult(l.getBoolean() == r.getBoolean());
+    } else if (l.isBoolean() && r.isString()) {
+        int rb = util_getboolean(r.getConstString(), -1);
+        if (rb != -1)
+            return context.createBooleanResult(l.getBoolean() == rb);
+    } else if (r.isBoolean() && l.isString()) {
+        int lb = util_getboolean(l.getConstString(), -1);
+        if (lb != -1)
+            return context.createBooleanResult(r.getBoolean() == lb);
+    }
+
+    int cmp = shexp_match(l.getConstString(), r.getConstString());
+
+    return context.createBooleanResult(cmp == 0);
+}
+
+
 /* --------------------------- ExpressionUnary ---------------------------- */
 
 /*
@@ -520,6 +656,7 @@ public:
 
 protected:
     void formatBinaryOperator(NSString& formatted, Precedence parent, Precedence us, const char *op) const;
+    void compileBinaryOperator(ExpressionCompiler& compiler, int dst, Opcode op, int c = 0, const char *name = NULL) const;
 
     Expression *operands[2];
 };
@@ -563,6 +700,21 @@ void ExpressionBinary::formatBinaryOperator(NSString& formatted, Precedence pare
         formatted.append(')');
 }
 
+void ExpressionBinary::compileBinaryOperator(ExpressionCompiler& compiler, int dst, Opcode op, int c, const char *name) const
+{
+    // The right operand isn't evaluated if the left operand is an error
+    int done = compiler.createLabel();
+    operands[0]->compile(compiler, dst);
+    compiler.emitJump(OP_JUMP_IF_ERROR, dst, dst, done);
+
+    int r = compiler.allocRegister();
+    operands[1]->compile(compiler, r);
+    compiler.emit(op, dst, dst, r, c, name);
+    compiler.releaseRegister(r);
+
+    compiler.bindLabel(done);
+}
+
 
 /* -------------------------- ExpressionTernary --------------------------- */
 
@@ -575,6 +727,7 @@ public:
     void deleteChildren();
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
     int getExpressionNodeCount() const;
 
@@ -612,6 +765,20 @@ Result ExpressionTernary::evaluate(Context& context) const
     return operands[i]->evaluate(context);
 }
 
+void ExpressionTernary::compile(ExpressionCompiler& compiler, int dst) const
+{
+    int otherwise = compiler.createLabel();
+    int done = compiler.createLabel();
+
+    operands[0]->compile(compiler, dst);
+    compiler.emitJump(OP_JUMP_UNLESS, dst, dst, otherwise);
+    operands[1]->compile(compiler, dst);
+    compiler.emitJump(OP_JUMP, dst, dst, done);
+    compiler.bindLabel(otherwise);
+    operands[2]->compile(compiler, dst);
+    compiler.bindLabel(done);
+}
+
 void ExpressionTernary::format(NSString& formatted, Precedence parent) const
 {
     if (parent > EXPR_PRECEDENCE_TERNARY)
@@ -646,6 +813,7 @@ public:
     ExpressionBoolean(PRBool v);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -666,6 +834,11 @@ Result ExpressionBoolean::evaluate(Context& context) const
     return context.createBooleanResult(value);
 }
 
+void ExpressionBoolean::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compiler.emitConstant(dst, compiler.getContext().createBooleanResult(value));
+}
+
 void ExpressionBoolean::format(NSString& formatted, Precedence parent) const
 {
     formatted.append(value ? "true" : "false");
@@ -682,6 +855,7 @@ public:
     ExpressionInteger(PRInt64 v);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -702,6 +876,11 @@ Result ExpressionInteger::evaluate(Context& context) const
     return context.createIntegerResult(value);
 }
 
+void ExpressionInteger::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compiler.emitConstant(dst, compiler.getContext().createIntegerResult(value));
+}
+
 void ExpressionInteger::format(NSString& formatted, Precedence parent) const
 {
     formatted.printf("%lld", value);
@@ -719,6 +898,7 @@ public:
     ~ExpressionString();
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -748,6 +928,11 @@ Result ExpressionString::evaluate(Context& context) const
     return context.createStringConstantResult(p, len);
 }
 
+void ExpressionString::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compiler.emitConstant(dst, compiler.getContext().createStringConstantResult(p, len));
+}
+
 void ExpressionString::format(NSString& formatted, Precedence parent) const
 {
     formatted.append('\'');
@@ -770,6 +955,7 @@ public:
     ExpressionOr(const OperatorStruct& op, Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -804,6 +990,19 @@ Result ExpressionOr::evaluate(Context& context) const
     return context.createBooleanResult(PR_FALSE);
 }
 
+void ExpressionOr::compile(ExpressionCompiler& compiler, int dst) const
+{
+    int done = compiler.createLabel();
+
+    operands[0]->compile(compiler, dst);
+    compiler.emitJump(OP_JUMP_IF_ERROR, dst, dst, done);
+    compiler.emitJump(OP_JUMP_IF_TRUE, dst, dst, done);
+    operands[1]->compile(compiler, dst);
+    compiler.emit(OP_BOOLEAN, dst, dst);
+
+    compiler.bindLabel(done);
+}
+
 void ExpressionOr::format(NSString& formatted, Precedence parent) const
 {
     formatBinaryOperator(formatted, parent, op.precedence, op.string);
@@ -820,6 +1019,7 @@ public:
     ExpressionXor(const OperatorStruct& op, Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -848,6 +1048,11 @@ Result ExpressionXor::evaluate(Context& context) const
     return context.createBooleanResult(l.getBoolean() ^ r.getBoolean());
 }
 
+void ExpressionXor::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_XOR);
+}
+
 void ExpressionXor::format(NSString& formatted, Precedence parent) const
 {
     formatBinaryOperator(formatted, parent, op.precedence, op.string);
@@ -864,6 +1069,7 @@ public:
     ExpressionAnd(const OperatorStruct& op, Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -898,6 +1104,19 @@ Result ExpressionAnd::evaluate(Context& context) const
     return context.createBooleanResult(PR_TRUE);
 }
 
+void ExpressionAnd::compile(ExpressionCompiler& compiler, int dst) const
+{
+    int done = compiler.createLabel();
+
+    operands[0]->compile(compiler, dst);
+    compiler.emitJump(OP_JUMP_IF_ERROR, dst, dst, done);
+    compiler.emitJump(OP_JUMP_IF_FALSE, dst, dst, done);
+    operands[1]->compile(compiler, dst);
+    compiler.emit(OP_BOOLEAN, dst, dst);
+
+    compiler.bindLabel(done);
+}
+
 void ExpressionAnd::format(NSString& formatted, Precedence parent) const
 {
     formatBinaryOperator(formatted, parent, op.precedence, op.string);
@@ -914,6 +1133,7 @@ public:
     ExpressionNot(const OperatorStruct& op, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -938,6 +1158,12 @@ Result ExpressionNot::evaluate(Context& context) const
     return context.createBooleanResult(!r.getBoolean());
 }
 
+void ExpressionNot::compile(ExpressionCompiler& compiler, int dst) const
+{
+    operand->compile(compiler, dst);
+    compiler.emit(OP_NOT, dst, dst);
+}
+
 void ExpressionNot::format(NSString& formatted, Precedence parent) const
 {
     formatUnaryOperator(formatted, parent, op.precedence, op.string);
@@ -953,36 +1179,12 @@ void ExpressionNot::format(NSString& formatted, Precedence parent) const
 class ExpressionNumericOp : public ExpressionBinary {
 public:
     ExpressionNumericOp(Expression *l, Expression *r);
-
-protected:
-    void warnOfNonNumericOperands(Context& context, const char *fn, Result& l, Result& r) const;
 };
 
 ExpressionNumericOp::ExpressionNumericOp(Expression *l, Expression *r)
 : ExpressionBinary(l, r)
 { }
 
-void ExpressionNumericOp::warnOfNonNumericOperands(Context& context, const char *fn, Result& l, Result& r) const
-{
-    if (ereport_can_log(LOG_VERBOSE)) {
-        const char *operand;
-
-        operand = l.getConstString();
-        if (strcspn(operand, NUMERIC_CHARSET)) {
-            log_error(LOG_VERBOSE, fn, context.sn, context.rq,
-                      "Numeric operator operand \"%s\" contains non-numeric characters",
-                      operand);
-        }
-
-        operand = r.getConstString();
-        if (strcspn(operand, NUMERIC_CHARSET)) {
-            log_error(LOG_VERBOSE, fn, context.sn, context.rq,
-                      "Numeric operator operand \"%s\" contains non-numeric characters",
-                      operand);
-        }
-    }
-}
-
 
 /* ------------------------- ExpressionNumericCmp ------------------------- */
 
@@ -994,6 +1196,7 @@ public:
     ExpressionNumericCmp(const OperatorStruct& op, Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -1020,23 +1223,12 @@ Result ExpressionNumericCmp::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    if (l.isString() || r.isString())
-        warnOfNonNumericOperands(context, op.string, l, r);
-
-    PRInt64 cmp = l.getInteger() - r.getInteger();
-
-    PRBool result;
-    switch (yychar) {
-    case EXPR_TOKEN_EQUALS_EQUALS: result = (cmp == 0); break;
-    case EXPR_TOKEN_BANG_EQUALS: result = (cmp != 0); break;
-    case EXPR_TOKEN_LEFTANGLE: result = (cmp < 0); break;
-    case EXPR_TOKEN_LEFTANGLE_EQUALS: result = (cmp <= 0); break;
-    case EXPR_TOKEN_RIGHTANGLE: result = (cmp > 0); break;
-    case EXPR_TOKEN_RIGHTANGLE_EQUALS: result = (cmp >= 0); break;
-    default: PR_ASSERT(0);
-    }
+    return expr_op_numeric_cmp(context, op.string, yychar, l, r);
+}
 
-    return context.createBooleanResult(result);
+void ExpressionNumericCmp::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_NUMERIC_CMP, yychar, op.string);
 }
 
 void ExpressionNumericCmp::format(NSString& formatted, Precedence parent) const
@@ -1055,6 +1247,7 @@ public:
     ExpressionStringCmp(const OperatorStruct& op, Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -1081,20 +1274,12 @@ Result ExpressionStringCmp::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    int cmp = strcmp(l.getConstString(), r.getConstString());
-
-    PRBool result;
-    switch (yychar) {
-    case EXPR_TOKEN_E_Q: result = (cmp == 0); break;
-    case EXPR_TOKEN_N_E: result = (cmp != 0); break;
-    case EXPR_TOKEN_L_T: result = (cmp < 0); break;
-    case EXPR_TOKEN_L_E: result = (cmp <= 0); break;
-    case EXPR_TOKEN_G_T: result = (cmp > 0); break;
-    case EXPR_TOKEN_G_E: result = (cmp >= 0); break;
-    default: PR_ASSERT(0);
-    }
+    return expr_op_string_cmp(context, yychar, l, r);
+}
 
-    return context.createBooleanResult(result);
+void ExpressionStringCmp::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_STRING_CMP, yychar);
 }
 
 void ExpressionStringCmp::format(NSString& formatted, Precedence parent) const
@@ -1113,6 +1298,7 @@ public:
     ExpressionAdd(Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 };
 
@@ -1135,10 +1321,12 @@ Result ExpressionAdd::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    if (l.isString() || r.isString())
-        warnOfNonNumericOperands(context, "+", l, r);
+    return expr_op_arithmetic(context, '+', l, r);
+}
 
-    return context.createIntegerResult(l.getInteger() + r.getInteger());
+void ExpressionAdd::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_ARITHMETIC, '+');
 }
 
 void ExpressionAdd::format(NSString& formatted, Precedence parent) const
@@ -1157,6 +1345,7 @@ public:
     ExpressionSubtract(Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 };
 
@@ -1179,10 +1368,12 @@ Result ExpressionSubtract::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    if (l.isString() || r.isString())
-        warnOfNonNumericOperands(context, "-", l, r);
+    return expr_op_arithmetic(context, '-', l, r);
+}
 
-    return context.createIntegerResult(l.getInteger() - r.getInteger());
+void ExpressionSubtract::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_ARITHMETIC, '-');
 }
 
 void ExpressionSubtract::format(NSString& formatted, Precedence parent) const
@@ -1201,6 +1392,7 @@ public:
     ExpressionConcat(Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 };
 
@@ -1223,17 +1415,12 @@ Result ExpressionConcat::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    int len = l.getStringLength() + r.getStringLength();
-
-    char *p = (char *) pool_malloc(context.pool, len + 1);
-    if (p == NULL)
-        return context.createOutOfMemoryErrorResult();
-
-    memcpy(p, l.getConstString(), l.getStringLength());
-    memcpy(p + l.getStringLength(), r.getConstString(), r.getStringLength());
-    p[len] = '\0';
+    return expr_op_concat(context, l, r);
+}
 
-    return context.createPooledStringResult(p, len);
+void ExpressionConcat::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_CONCAT);
 }
 
 void ExpressionConcat::format(NSString& formatted, Precedence parent) const
@@ -1252,6 +1439,7 @@ public:
     ExpressionMultiply(Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 };
 
@@ -1274,10 +1462,12 @@ Result ExpressionMultiply::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    if (l.isString() || r.isString())
-        warnOfNonNumericOperands(context, "*", l, r);
+    return expr_op_arithmetic(context, '*', l, r);
+}
 
-    return context.createIntegerResult(l.getInteger() * r.getInteger());
+void ExpressionMultiply::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_ARITHMETIC, '*');
 }
 
 void ExpressionMultiply::format(NSString& formatted, Precedence parent) const
@@ -1296,6 +1486,7 @@ public:
     ExpressionDivide(Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 };
 
@@ -1318,10 +1509,12 @@ Result ExpressionDivide::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    if (l.isString() || r.isString())
-        warnOfNonNumericOperands(context, "/", l, r);
+    return expr_op_arithmetic(context, '/', l, r);
+}
 
-    return context.createIntegerResult(l.getInteger() / r.getInteger());
+void ExpressionDivide::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_ARITHMETIC, '/');
 }
 
 void ExpressionDivide::format(NSString& formatted, Precedence parent) const
@@ -1340,6 +1533,7 @@ public:
     ExpressionModulo(Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 };
 
@@ -1362,10 +1556,12 @@ Result ExpressionModulo::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    if (l.isString() || r.isString())
-        warnOfNonNumericOperands(context, "%", l, r);
+    return expr_op_arithmetic(context, '%', l, r);
+}
 
-    return context.createIntegerResult(l.getInteger() % r.getInteger());
+void ExpressionModulo::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_ARITHMETIC, '%');
 }
 
 void ExpressionModulo::format(NSString& formatted, Precedence parent) const
@@ -1385,6 +1581,7 @@ public:
     ExpressionWildcard(Expression *l, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 };
 
@@ -1407,24 +1604,12 @@ Result ExpressionWildcard::evaluate(Context& context) const
     if (r.isError())
         return r;
 
-    // <Client> tag compatibility: if the left operand is a boolean and the
-    // right operand is a string that contains a boolean, do a simple boolean
-    // equality test.  For example, <Client security="on">.
-    if (l.isBoolean() && r.isBoolean()) {
-        return context.createBooleanResult(l.getBoolean() == r.getBoolean());
-    } else if (l.isBoolean() && r.isString()) {
-        int rb = util_getboolean(r.getConstString(), -1);
-        if (rb != -1)
-            return context.createBooleanResult(l.getBoolean() == rb);
-    } else if (r.isBoolean() && l.isString()) {
-        int lb = util_getboolean(l.getConstString(), -1);
-        if (lb != -1)
-            return context.createBooleanResult(r.getBoolean() == lb);
-    }
-
-    int cmp = shexp_match(l.getConstString(), r.getConstString());
+    return expr_op_wildcard(context, l, r);
+}
 
-    return context.createBooleanResult(cmp == 0);
+void ExpressionWildcard::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compileBinaryOperator(compiler, dst, OP_WILDCARD);
 }
 
 void ExpressionWildcard::format(NSString& formatted, Precedence parent) const
@@ -1669,6 +1854,7 @@ public:
     ExpressionSigned(int sign, Expression *r);
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -1693,6 +1879,12 @@ Result ExpressionSigned::evaluate(Context& context) const
     return context.createIntegerResult(sign * r.getInteger());
 }
 
+void ExpressionSigned::compile(ExpressionCompiler& compiler, int dst) const
+{
+    operand->compile(compiler, dst);
+    compiler.emit(OP_SIGN, dst, dst, 0, sign);
+}
+
 void ExpressionSigned::format(NSString& formatted, Precedence parent) const
 {
     formatUnaryOperator(formatted, parent, EXPR_PRECEDENCE_SIGN, (sign > 0) ? "+" : "-");
@@ -1918,6 +2110,7 @@ public:
     ~ExpressionVarGet();
     Expression *dup() const;
     Result evaluate(Context& context) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
     void format(NSString& formatted, Precedence parent) const;
 
 private:
@@ -1981,6 +2174,11 @@ Result ExpressionVarGet::evaluate(Context& context) const
     return context.createErrorResultf(XP_GetAdminStr(DBT_noVarX), name);
 }
 
+void ExpressionVarGet::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compiler.emitVariable(dst, this, name);
+}
+
 void ExpressionVarGet::format(NSString& formatted, Precedence parent) const
 {
     formatted.append(name);
@@ -2007,7 +2205,11 @@ Expression *expr_dup(const Expression *expr)
     if (expr == NULL)
         return NULL;
 
-    return expr->dup();
+    Expression *dup = expr->dup();
+    if (expr->isCompiled())
+        dup->compileProgram();
+
+    return dup;
 }
 
 
@@ -2036,7 +2238,7 @@ int expr_evaluate(const Expression *expr, Session *sn, Request *rq)
 
     Context context(sn, rq, request_pool(rq));
 
-    Result result = expr->evaluate(context);
+    Result result = expr->execute(context);
     if (result.isError()) {
         result.setNsprError();
         return REQ_ABORTED;
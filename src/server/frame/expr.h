@@ -173,6 +173,14 @@ NSAPI_PUBLIC const char *INTexpr_const_string(const Expression *expr);
  */
 NSAPI_PUBLIC const pb_key *INTexpr_const_pb_key(const Expression *expr);
 
+/*
+ * expr_compile lowers an expression into bytecode that subsequent calls to
+ * expr_evaluate will execute.  Constant subexpressions are folded and
+ * repeated variable references share a single lookup.  Expressions that
+ * cannot be compiled continue to be evaluated as expression trees.
+ */
+NSAPI_PUBLIC void INTexpr_compile(Expression *expr);
+
 /*
  * expr_format formats the expression as a string.  The caller should free the
  * returned string using FREE().
@@ -249,6 +257,7 @@ PR_END_EXTERN_C
 #define expr_set_backrefs INTexpr_set_backrefs
 #define expr_const_string INTexpr_const_string
 #define expr_const_pb_key INTexpr_const_pb_key
+#define expr_compile INTexpr_compile
 #define expr_format INTexpr_format
 #define expr_dup INTexpr_dup
 #define expr_free INTexpr_free
@@ -0,0 +1,733 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * expr_code.cpp: NSAPI expression bytecode compilation and execution
+ *
+ * Expression trees parsed from obj.conf are lowered into a flat sequence of
+ * register-based instructions at configuration time.  Constant
+ * subexpressions are folded during compilation and repeated references to a
+ * variable share a single lookup, so request-time evaluation is a simple
+ * loop over an Instruction array instead of a recursive walk of virtual
+ * evaluate() calls.  Nodes that cannot be lowered (e.g. calls to control
+ * functions) are evaluated as expression trees by an OP_EVAL instruction.
+ */
+
+#include "netsite.h"
+#include "base/pool.h"
+#include "frame/expr.h"
+#include "expr_pvt.h"
+#include "expr_code_pvt.h"
+
+
+/* ------------------------------ expr_apply ------------------------------ */
+
+static inline Result expr_apply(Context& context, const Instruction& insn, const Result& a, const Result& b)
+{
+    if (a.isError())
+        return a;
+
+    switch (insn.op) {
+    case OP_BOOLEAN:
+        return context.createBooleanResult(a.getBoolean());
+
+    case OP_NOT:
+        return context.createBooleanResult(!a.getBoolean());
+
+    case OP_SIGN:
+        return context.createIntegerResult(insn.c * a.getInteger());
+
+    default:
+        break;
+    }
+
+    if (b.isError())
+        return b;
+
+    switch (insn.op) {
+    case OP_XOR:
+        return context.createBooleanResult(a.getBoolean() ^ b.getBoolean());
+
+    case OP_NUMERIC_CMP:
+        return expr_op_numeric_cmp(context, insn.name, insn.c, a, b);
+
+    case OP_STRING_CMP:
+        return expr_op_string_cmp(context, insn.c, a, b);
+
+    case OP_ARITHMETIC:
+        return expr_op_arithmetic(context, insn.c, a, b);
+
+    case OP_CONCAT:
+        return expr_op_concat(context, a, b);
+
+    case OP_WILDCARD:
+        return expr_op_wildcard(context, a, b);
+
+    default:
+        PR_ASSERT(0);
+        return context.createOutOfMemoryErrorResult();
+    }
+}
+
+
+/* --------------------------- expr_interpolate --------------------------- */
+
+static inline Result expr_interpolate(Context& context, const Result *fragments, int count)
+{
+    // Like ModelString::evaluate, the first error is the result of an
+    // interpolation that includes errors
+    int len = 0;
+    for (int i = 0; i < count; i++) {
+        if (fragments[i].isError())
+            return fragments[i];
+        len += fragments[i].getStringLength();
+    }
+
+    if (count == 1 && fragments[0].isString())
+        return fragments[0];
+
+    char *p = (char *) pool_malloc(context.pool, len + 1);
+    if (p == NULL)
+        return context.createOutOfMemoryErrorResult();
+
+    int pos = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(p + pos, fragments[i].getConstString(), fragments[i].getStringLength());
+        pos += fragments[i].getStringLength();
+    }
+    p[pos] = '\0';
+
+    return context.createPooledStringResult(p, len);
+}
+
+
+/* ------------------------ Expression::~Expression ----------------------- */
+
+Expression::~Expression()
+{
+    delete program;
+}
+
+
+/* ------------------------- Expression::compile -------------------------- */
+
+void Expression::compile(ExpressionCompiler& compiler, int dst) const
+{
+    compiler.emitEvaluate(dst, this);
+}
+
+
+/* ---------------------- Expression::compileProgram ---------------------- */
+
+void Expression::compileProgram()
+{
+    delete program;
+    program = NULL;
+
+    ExpressionCompiler compiler;
+    int dst = compiler.allocRegister();
+    compile(compiler, dst);
+    program = compiler.createProgram(dst);
+}
+
+
+/* ------------------------- Expression::execute -------------------------- */
+
+Result Expression::execute(Context& context) const
+{
+    if (program == NULL)
+        return evaluate(context);
+
+    Result registers[EXPR_CODE_MAX_REGISTERS];
+
+    return program->execute(context, registers);
+}
+
+
+/* ---------------- ExpressionProgram::ExpressionProgram ------------------ */
+
+ExpressionProgram::ExpressionProgram()
+: instructions(NULL),
+  ninstructions(0),
+  constants(NULL),
+  nconstants(0),
+  strings(NULL),
+  nstrings(0),
+  result(-1),
+  first(-1),
+  count(0)
+{ }
+
+
+/* ---------------- ExpressionProgram::~ExpressionProgram ----------------- */
+
+ExpressionProgram::~ExpressionProgram()
+{
+    for (int i = 0; i < nstrings; i++)
+        PERM_FREE(strings[i]);
+    PERM_FREE(strings);
+    delete [] constants;
+    PERM_FREE(instructions);
+}
+
+
+/* ---------------------- ExpressionProgram::execute ---------------------- */
+
+Result ExpressionProgram::execute(Context& context, Result *r) const
+{
+    const Instruction *code = instructions;
+    int n = ninstructions;
+    int pc = 0;
+
+    while (pc < n) {
+        const Instruction& insn = code[pc++];
+
+        switch (insn.op) {
+        case OP_CONST:
+            r[insn.dst] = constants[insn.a];
+            break;
+
+        case OP_MOVE:
+            r[insn.dst] = r[insn.a];
+            break;
+
+        case OP_EVAL:
+            r[insn.dst] = insn.node->evaluate(context);
+            break;
+
+        case OP_JUMP:
+            pc = insn.c;
+            break;
+
+        case OP_JUMP_IF_ERROR:
+            if (r[insn.a].isError()) {
+                r[insn.dst] = r[insn.a];
+                pc = insn.c;
+            }
+            break;
+
+        case OP_JUMP_IF_TRUE:
+            if (r[insn.a].getBoolean()) {
+                r[insn.dst] = context.createBooleanResult(PR_TRUE);
+                pc = insn.c;
+            }
+            break;
+
+        case OP_JUMP_IF_FALSE:
+            if (!r[insn.a].getBoolean()) {
+                r[insn.dst] = context.createBooleanResult(PR_FALSE);
+                pc = insn.c;
+            }
+            break;
+
+        case OP_JUMP_UNLESS:
+            if (!r[insn.a].getBoolean())
+                pc = insn.c;
+            break;
+
+        case OP_INTERPOLATE:
+            r[insn.dst] = expr_interpolate(context, &r[insn.a], insn.b);
+            break;
+
+        default:
+            r[insn.dst] = expr_apply(context, insn, r[insn.a], r[insn.b]);
+            break;
+        }
+    }
+
+    if (result == -1)
+        return context.createBooleanResult(PR_TRUE);
+
+    return r[result];
+}
+
+
+/* --------------- ExpressionCompiler::ExpressionCompiler ----------------- */
+
+ExpressionCompiler::ExpressionCompiler()
+: pool(pool_create()),
+  context(NULL, NULL, pool),
+  failed(PR_FALSE),
+  instructions(NULL),
+  ninstructions(0),
+  size(0),
+  labels(NULL),
+  references(NULL),
+  nlabels(0),
+  unresolved(0),
+  temporaries(0),
+  cached(0),
+  nvariables(0)
+{
+    for (int i = 0; i < EXPR_CODE_MAX_REGISTERS; i++) {
+        constant[i] = -1;
+        load[i] = -1;
+    }
+}
+
+
+/* --------------- ExpressionCompiler::~ExpressionCompiler ---------------- */
+
+ExpressionCompiler::~ExpressionCompiler()
+{
+    while (Result *result = constants.pop())
+        delete result;
+    while (char *s = strings.pop())
+        PERM_FREE(s);
+    PERM_FREE(instructions);
+    PERM_FREE(labels);
+    PERM_FREE(references);
+    if (pool != NULL)
+        pool_destroy(pool);
+}
+
+
+/* -------------------- ExpressionCompiler::allocRegister -------------------- */
+
+int ExpressionCompiler::allocRegister()
+{
+    // Temporaries grow up from the bottom of the register file; cached
+    // variables grow down from the top
+    if (temporaries + cached >= EXPR_CODE_MAX_REGISTERS) {
+        failed = PR_TRUE;
+        return 0;
+    }
+
+    int reg = temporaries++;
+    constant[reg] = -1;
+
+    return reg;
+}
+
+
+/* ------------------- ExpressionCompiler::releaseRegister ------------------- */
+
+void ExpressionCompiler::releaseRegister(int reg)
+{
+    if (failed)
+        return;
+
+    PR_ASSERT(reg == temporaries - 1);
+    temporaries--;
+}
+
+
+/* --------------------- ExpressionCompiler::createLabel ---------------------- */
+
+int ExpressionCompiler::createLabel()
+{
+    int *nl = (int *) PERM_REALLOC(labels, (nlabels + 1) * sizeof(int));
+    if (nl != NULL)
+        labels = nl;
+    int *nr = (int *) PERM_REALLOC(references, (nlabels + 1) * sizeof(int));
+    if (nr != NULL)
+        references = nr;
+    if (nl == NULL || nr == NULL) {
+        failed = PR_TRUE;
+        return 0;
+    }
+
+    labels[nlabels] = -1;
+    references[nlabels] = 0;
+
+    return nlabels++;
+}
+
+
+/* ---------------------- ExpressionCompiler::bindLabel ----------------------- */
+
+void ExpressionCompiler::bindLabel(int label)
+{
+    if (failed)
+        return;
+
+    labels[label] = ninstructions;
+
+    // If anything jumps here, we no longer know what the registers contain
+    if (references[label] > 0) {
+        unresolved -= references[label];
+        references[label] = 0;
+        forgetConstants();
+    }
+}
+
+
+/* ----------------------- ExpressionCompiler::append ------------------------ */
+
+Instruction *ExpressionCompiler::append(Opcode op, int dst, int a, int b, int c)
+{
+    if (failed)
+        return NULL;
+
+    if (ninstructions == size) {
+        int nsize = size ? size * 2 : 16;
+        Instruction *ni = (Instruction *) PERM_REALLOC(instructions, nsize * sizeof(Instruction));
+        if (ni == NULL) {
+            failed = PR_TRUE;
+            return NULL;
+        }
+        instructions = ni;
+        size = nsize;
+    }
+
+    Instruction *insn = &instructions[ninstructions++];
+    insn->op = op;
+    insn->dst = dst;
+    insn->a = a;
+    insn->b = b;
+    insn->c = c;
+    insn->name = NULL;
+    insn->node = NULL;
+
+    constant[dst] = -1;
+
+    return insn;
+}
+
+
+/* ----------------- ExpressionCompiler::discardConstantLoad ------------------ */
+
+void ExpressionCompiler::discardConstantLoad(int reg)
+{
+    // If reg's value was loaded by the most recent instruction and has since
+    // been folded into another constant, the load is dead code
+    if (load[reg] != -1 && load[reg] == ninstructions - 1) {
+        PR_ASSERT(instructions[load[reg]].op == OP_CONST);
+        PR_ASSERT(instructions[load[reg]].dst == reg);
+        ninstructions--;
+        load[reg] = -1;
+        constant[reg] = -1;
+    }
+}
+
+
+/* ------------------- ExpressionCompiler::forgetConstants -------------------- */
+
+void ExpressionCompiler::forgetConstants()
+{
+    for (int i = 0; i < EXPR_CODE_MAX_REGISTERS; i++) {
+        constant[i] = -1;
+        load[i] = -1;
+    }
+}
+
+
+/* -------------------- ExpressionCompiler::emitConstant ---------------------- */
+
+void ExpressionCompiler::emitConstant(int dst, const Result& result)
+{
+    if (failed)
+        return;
+
+    // Constants must outlive the compiler's pool, so take a private copy of
+    // the Result's string
+    char *s = (char *) PERM_MALLOC(result.len + 1);
+    if (s == NULL) {
+        failed = PR_TRUE;
+        return;
+    }
+    memcpy(s, result.s, result.len);
+    s[result.len] = '\0';
+    strings.append(s);
+
+    // The six argument Result constructor is inline in result.cpp, so copy
+    // the Result and point the copy at our string instead
+    Result *copy = new Result(result);
+    copy->pool = NULL;
+    copy->s = s;
+    constants.append(copy);
+
+    Instruction *insn = append(OP_CONST, dst, constants.length() - 1, 0, 0);
+    if (insn == NULL)
+        return;
+
+    constant[dst] = constants.length() - 1;
+    load[dst] = ninstructions - 1;
+}
+
+
+/* ---------------------- ExpressionCompiler::emitMove ------------------------ */
+
+void ExpressionCompiler::emitMove(int dst, int src)
+{
+    if (dst == src)
+        return;
+
+    if (!failed && constant[src] != -1) {
+        emitConstant(dst, *constants[constant[src]]);
+        return;
+    }
+
+    append(OP_MOVE, dst, src, 0, 0);
+}
+
+
+/* -------------------- ExpressionCompiler::emitEvaluate ---------------------- */
+
+void ExpressionCompiler::emitEvaluate(int dst, const Expression *node, PRBool opaque)
+{
+    Instruction *insn = append(OP_EVAL, dst, 0, 0, 0);
+    if (insn == NULL)
+        return;
+
+    insn->node = node;
+
+    // Opaque nodes may have side effects that change variable values
+    if (opaque)
+        nvariables = 0;
+}
+
+
+/* -------------------- ExpressionCompiler::emitVariable ---------------------- */
+
+void ExpressionCompiler::emitVariable(int dst, const Expression *node, const char *name)
+{
+    if (failed)
+        return;
+
+    for (int i = 0; i < nvariables; i++) {
+        if (!strcmp(variables[i].name, name)) {
+            emitMove(dst, variables[i].reg);
+            return;
+        }
+    }
+
+    // Only a lookup that is always executed may be shared by subsequent
+    // references
+    if (isConditional() || temporaries + cached >= EXPR_CODE_MAX_REGISTERS) {
+        emitEvaluate(dst, node, PR_FALSE);
+        return;
+    }
+
+    cached++;
+    int reg = EXPR_CODE_MAX_REGISTERS - cached;
+    variables[nvariables].name = name;
+    variables[nvariables].reg = reg;
+    nvariables++;
+
+    emitEvaluate(reg, node, PR_FALSE);
+    emitMove(dst, reg);
+}
+
+
+/* ---------------------- ExpressionCompiler::emitJump ------------------------ */
+
+void ExpressionCompiler::emitJump(Opcode op, int dst, int a, int label)
+{
+    if (failed)
+        return;
+
+    // Resolve conditional jumps on constants at compile time
+    if (op != OP_JUMP && constant[a] != -1) {
+        const Result *value = constants[constant[a]];
+        switch (op) {
+        case OP_JUMP_IF_ERROR:
+            if (!value->isError())
+                return;
+            break;
+        case OP_JUMP_IF_TRUE:
+            if (!value->getBoolean())
+                return;
+            emitConstant(dst, context.createBooleanResult(PR_TRUE));
+            op = OP_JUMP;
+            break;
+        case OP_JUMP_IF_FALSE:
+            if (value->getBoolean())
+                return;
+            emitConstant(dst, context.createBooleanResult(PR_FALSE));
+            op = OP_JUMP;
+            break;
+        case OP_JUMP_UNLESS:
+            if (value->getBoolean())
+                return;
+            op = OP_JUMP;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Jumps that may write dst invalidate what we know about dst
+    int saved = constant[dst];
+    Instruction *insn = append(op, dst, a, 0, label);
+    if (insn == NULL)
+        return;
+    if (op == OP_JUMP || op == OP_JUMP_UNLESS)
+        constant[dst] = saved;
+
+    references[label]++;
+    unresolved++;
+}
+
+
+/* ------------------------ ExpressionCompiler::emit -------------------------- */
+
+void ExpressionCompiler::emit(Opcode op, int dst, int a, int b, int c, const char *name)
+{
+    if (failed)
+        return;
+
+    PRBool unary = (op == OP_BOOLEAN || op == OP_NOT || op == OP_SIGN);
+
+    // Fold operations on constants.  Division by zero and errors are left
+    // for request time.
+    if (constant[a] != -1 && (unary || constant[b] != -1)) {
+        const Result& l = *constants[constant[a]];
+        const Result& r = unary ? l : *constants[constant[b]];
+        PRBool foldable = PR_TRUE;
+        if (op == OP_ARITHMETIC && (c == '/' || c == '%') && r.getInteger() == 0)
+            foldable = PR_FALSE;
+        if (foldable) {
+            Instruction insn;
+            insn.op = op;
+            insn.dst = dst;
+            insn.a = a;
+            insn.b = b;
+            insn.c = c;
+            insn.name = name;
+            insn.node = NULL;
+            Result folded = expr_apply(context, insn, l, r);
+            if (!folded.isError()) {
+                if (!unary)
+                    discardConstantLoad(b);
+                discardConstantLoad(a);
+                emitConstant(dst, folded);
+                return;
+            }
+        }
+    }
+
+    Instruction *insn = append(op, dst, a, b, c);
+    if (insn != NULL)
+        insn->name = name;
+}
+
+
+/* -------------------- ExpressionCompiler::emitInterpolate ------------------- */
+
+void ExpressionCompiler::emitInterpolate(int dst, int first, int count)
+{
+    if (failed)
+        return;
+
+    int i;
+    for (i = 0; i < count; i++) {
+        if (constant[first + i] == -1)
+            break;
+    }
+
+    // Fold interpolations of constant fragments
+    if (i == count) {
+        Result *fragments = new Result[count];
+        for (i = 0; i < count; i++)
+            fragments[i] = *constants[constant[first + i]];
+        Result folded = expr_interpolate(context, fragments, count);
+        delete [] fragments;
+        if (!folded.isError()) {
+            emitConstant(dst, folded);
+            return;
+        }
+    }
+
+    append(OP_INTERPOLATE, dst, first, count, 0);
+}
+
+
+/* -------------------- ExpressionCompiler::createProgram --------------------- */
+
+ExpressionProgram *ExpressionCompiler::createProgram(int result)
+{
+    return createProgram(result, -1, 0);
+}
+
+ExpressionProgram *ExpressionCompiler::createInterpolationProgram(int first, int count)
+{
+    return createProgram(-1, first, count);
+}
+
+ExpressionProgram *ExpressionCompiler::createProgram(int result, int first, int count)
+{
+    if (failed)
+        return NULL;
+
+    PR_ASSERT(unresolved == 0);
+
+    // Patch jump targets
+    for (int i = 0; i < ninstructions; i++) {
+        Instruction& insn = instructions[i];
+        if (insn.op == OP_JUMP ||
+            insn.op == OP_JUMP_IF_ERROR ||
+            insn.op == OP_JUMP_IF_TRUE ||
+            insn.op == OP_JUMP_IF_FALSE ||
+            insn.op == OP_JUMP_UNLESS)
+        {
+            PR_ASSERT(labels[insn.c] != -1);
+            insn.c = labels[insn.c];
+        }
+    }
+
+    // The program assumes ownership of the instructions and constants
+    ExpressionProgram *program = new ExpressionProgram();
+
+    program->instructions = instructions;
+    program->ninstructions = ninstructions;
+    instructions = NULL;
+    ninstructions = 0;
+    size = 0;
+
+    program->nconstants = constants.length();
+    program->constants = new Result[program->nconstants];
+    for (int ci = 0; ci < program->nconstants; ci++)
+        program->constants[ci] = *constants[ci];
+
+    program->nstrings = strings.length();
+    program->strings = (char **) PERM_MALLOC((program->nstrings + 1) * sizeof(char *));
+    for (int si = 0; si < program->nstrings; si++)
+        program->strings[si] = strings[si];
+    while (strings.pop());
+
+    program->result = result;
+    program->first = first;
+    program->count = count;
+
+    return program;
+}
+
+
+/* ----------------------------- expr_compile ----------------------------- */
+
+void expr_compile(Expression *expr)
+{
+    if (expr != NULL)
+        expr->compileProgram();
+}
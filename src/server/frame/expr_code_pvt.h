@@ -0,0 +1,268 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FRAME_EXPR_CODE_PVT_H
+#define FRAME_EXPR_CODE_PVT_H
+
+/*
+ * expr_code_pvt.h: NSAPI expression bytecode private declarations
+ */
+
+#include "support/GenericVector.h"
+
+#ifndef FRAME_EXPR_PVT_H
+#include "expr_pvt.h"
+#endif
+
+/*
+ * EXPR_CODE_MAX_REGISTERS is the size of the register file an
+ * ExpressionProgram executes against.  Expressions that require more
+ * registers are left to be evaluated as expression trees.
+ */
+#define EXPR_CODE_MAX_REGISTERS 32
+
+/*
+ * Opcode identifies the operation performed by an Instruction.
+ */
+enum Opcode {
+    OP_CONST,           // r[dst] = constants[a]
+    OP_MOVE,            // r[dst] = r[a]
+    OP_EVAL,            // r[dst] = node->evaluate()
+    OP_JUMP,            // goto c
+    OP_JUMP_IF_ERROR,   // if r[a] is an error, r[dst] = r[a] and goto c
+    OP_JUMP_IF_TRUE,    // if r[a] is true, r[dst] = true and goto c
+    OP_JUMP_IF_FALSE,   // if r[a] is false, r[dst] = false and goto c
+    OP_JUMP_UNLESS,     // if r[a] is false, goto c
+    OP_INTERPOLATE,     // r[dst] = r[a] . r[a + 1] ... r[a + b - 1]
+    OP_BOOLEAN,         // r[dst] = r[a] ? true : false
+    OP_NOT,             // r[dst] = !r[a]
+    OP_SIGN,            // r[dst] = c * r[a]
+    OP_XOR,             // r[dst] = r[a] ^ r[b]
+    OP_NUMERIC_CMP,     // r[dst] = r[a] <c> r[b]
+    OP_STRING_CMP,      // r[dst] = r[a] <c> r[b]
+    OP_ARITHMETIC,      // r[dst] = r[a] <c> r[b]
+    OP_CONCAT,          // r[dst] = r[a] . r[b]
+    OP_WILDCARD         // r[dst] = r[a] = r[b]
+};
+
+/*
+ * Instruction is a single ExpressionProgram operation.  Operands a and b
+ * typically name registers; c is an opcode-specific modifier or jump target.
+ */
+struct Instruction {
+    Opcode op;
+    int dst;
+    int a;
+    int b;
+    int c;
+    const char *name;
+    const Expression *node;
+};
+
+/*
+ * ExpressionProgram is an expression tree that has been lowered into a flat
+ * sequence of register-based instructions.
+ */
+class ExpressionProgram {
+public:
+    /*
+     * Destroy the program, its instructions, and its constants.
+     */
+    ~ExpressionProgram();
+
+    /*
+     * Execute the program in a particular context using the caller-supplied
+     * register file.  Returns the value of the result register.
+     */
+    Result execute(Context& context, Result *registers) const;
+
+    /*
+     * Return the first of the registers that hold the fragments of an
+     * interpolation program.
+     */
+    int getFirstFragment() const { return first; }
+
+    /*
+     * Return the number of fragments computed by an interpolation program.
+     */
+    int getFragmentCount() const { return count; }
+
+private:
+    ExpressionProgram();
+    ExpressionProgram(const ExpressionProgram&);
+    ExpressionProgram& operator=(const ExpressionProgram&);
+
+    Instruction *instructions;
+    int ninstructions;
+    Result *constants;
+    int nconstants;
+    char **strings;
+    int nstrings;
+    int result;
+    int first;
+    int count;
+
+friend class ExpressionCompiler;
+};
+
+/*
+ * ExpressionCompiler lowers expression trees into ExpressionPrograms,
+ * folding constant subexpressions and caching the values of variables that
+ * are referenced more than once.
+ */
+class ExpressionCompiler {
+public:
+    ExpressionCompiler();
+    ~ExpressionCompiler();
+
+    /*
+     * Allocate a temporary register.  Temporary registers must be released
+     * in the reverse order of their allocation.
+     */
+    int allocRegister();
+
+    /*
+     * Release the most recently allocated temporary register.
+     */
+    void releaseRegister(int reg);
+
+    /*
+     * Create a label that forward jumps may target.
+     */
+    int createLabel();
+
+    /*
+     * Set the target of all jumps to label to the next emitted instruction.
+     */
+    void bindLabel(int label);
+
+    /*
+     * Emit an instruction that stores a copy of result in dst.
+     */
+    void emitConstant(int dst, const Result& result);
+
+    /*
+     * Emit an instruction that copies register src to dst.
+     */
+    void emitMove(int dst, int src);
+
+    /*
+     * Emit an instruction that evaluates the expression tree rooted at node.
+     * Opaque nodes (e.g. calls to ExpressionFuncs) may have side effects.
+     */
+    void emitEvaluate(int dst, const Expression *node, PRBool opaque = PR_TRUE);
+
+    /*
+     * Emit instructions that retrieve the value of the named variable.
+     * Repeated references to the same variable share a single lookup.
+     */
+    void emitVariable(int dst, const Expression *node, const char *name);
+
+    /*
+     * Emit a conditional or unconditional jump to label.
+     */
+    void emitJump(Opcode op, int dst, int a, int label);
+
+    /*
+     * Emit an operation on one or two registers.
+     */
+    void emit(Opcode op, int dst, int a, int b = 0, int c = 0, const char *name = NULL);
+
+    /*
+     * Emit an instruction that concatenates count registers beginning at
+     * first.
+     */
+    void emitInterpolate(int dst, int first, int count);
+
+    /*
+     * Return the Context used to construct constant Results.
+     */
+    Context& getContext() { return context; }
+
+    /*
+     * Create a program whose value is that of register result.  Returns NULL
+     * if the expression could not be compiled.
+     */
+    ExpressionProgram *createProgram(int result);
+
+    /*
+     * Create a program that computes count interpolation fragments beginning
+     * at register first.  Returns NULL if the expression could not be
+     * compiled.
+     */
+    ExpressionProgram *createInterpolationProgram(int first, int count);
+
+private:
+    ExpressionCompiler(const ExpressionCompiler&);
+    ExpressionCompiler& operator=(const ExpressionCompiler&);
+
+    Instruction *append(Opcode op, int dst, int a, int b, int c);
+    void discardConstantLoad(int reg);
+    void forgetConstants();
+    PRBool isConditional() const { return unresolved > 0; }
+    ExpressionProgram *createProgram(int result, int first, int count);
+
+    pool_handle_t *pool;
+    Context context;
+    PRBool failed;
+    Instruction *instructions;
+    int ninstructions;
+    int size;
+    PtrVector<Result> constants;
+    PtrVector<char> strings;
+    int *labels;
+    int *references;
+    int nlabels;
+    int unresolved;
+    int temporaries;
+    int cached;
+    int constant[EXPR_CODE_MAX_REGISTERS];
+    int load[EXPR_CODE_MAX_REGISTERS];
+    struct {
+        const char *name;
+        int reg;
+    } variables[EXPR_CODE_MAX_REGISTERS];
+    int nvariables;
+};
+
+/*
+ * expr_op_* implement the operators shared by expression trees and
+ * ExpressionPrograms.  The passed operands must not be errors.
+ */
+Result expr_op_numeric_cmp(Context& context, const char *fn, int yychar, const Result& l, const Result& r);
+Result expr_op_string_cmp(Context& context, int yychar, const Result& l, const Result& r);
+Result expr_op_arithmetic(Context& context, char op, const Result& l, const Result& r);
+Result expr_op_concat(Context& context, const Result& l, const Result& r);
+Result expr_op_wildcard(Context& context, const Result& l, const Result& r);
+
+#endif /* FRAME_EXPR_CODE_PVT_H */
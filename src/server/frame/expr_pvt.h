@@ -70,6 +70,17 @@ enum Precedence {
     EXPR_PRECEDENCE_DOLLAR
 };
 
+/*
+ * ExpressionCompiler lowers expression trees into ExpressionPrograms.
+ */
+class ExpressionCompiler;
+
+/*
+ * ExpressionProgram is an expression tree that has been lowered into
+ * bytecode.
+ */
+class ExpressionProgram;
+
 /*
  * Expression is the abstract base class for nodes in an expression tree.
  */
@@ -82,7 +93,7 @@ public:
      * destroyed.  To destroy an entire expression tree, root->deleteChildren()
      * then delete root.
      */
-    virtual ~Expression() { }
+    virtual ~Expression();
 
     /*
      * Recursively destroy all descendant expression nodes.
@@ -100,6 +111,31 @@ public:
      */
     virtual Result evaluate(Context& context) const = 0;
 
+    /*
+     * Emit instructions that store the value of the expression in register
+     * dst.  By default, the expression tree rooted at this node is evaluated
+     * by a single opaque instruction.
+     */
+    virtual void compile(ExpressionCompiler& compiler, int dst) const;
+
+    /*
+     * Lower the expression tree rooted at this node into an
+     * ExpressionProgram for use by subsequent calls to execute.
+     */
+    virtual void compileProgram();
+
+    /*
+     * Return PR_TRUE if compileProgram was called and successfully lowered
+     * the expression tree.
+     */
+    virtual PRBool isCompiled() const { return program != NULL; }
+
+    /*
+     * Evaluate the expression in a particular context, executing the
+     * expression's ExpressionProgram if it was compiled.
+     */
+    Result execute(Context& context) const;
+
     /*
      * Append a string version of the expression to the passed buffer.
      * precedence specifies the precedence of the parent operator; if it is
@@ -130,7 +166,7 @@ protected:
     /*
      * Construct an expression node.
      */
-    Expression() : string(NULL), key(NULL) { }
+    Expression() : string(NULL), key(NULL), program(NULL) { }
 
     /*
      * Indicate that the expression will always evaluate to a particular
@@ -144,6 +180,7 @@ private:
 
     const char *string;
     const pb_key *key;
+    ExpressionProgram *program;
 };
 
 /*
@@ -1011,6 +1011,35 @@ NSAPI_PUBLIC FilterLayer *filter_layer(SYS_NETFD fd, const Filter *filter)
 }
 
 
+/* ----------------------- filter_read_transparent ------------------------ */
+
+NSAPI_PUBLIC PRBool filter_read_transparent(SYS_NETFD fd, const Filter *filter)
+{
+    if (!fd || !filter)
+        return PR_FALSE;
+
+    if (fd->identity == PR_IO_LAYER_HEAD)
+        fd = fd->lower;
+
+    while (fd) {
+        if (fd->methods == &filter->priomethods)
+            return PR_TRUE;
+
+        // Layers without a read filter method simply pass reads through, as
+        // does the callback filter
+        if (fd->identity != _filter_identity)
+            return PR_FALSE;
+        const Filter *above = ((FilterLayer *)fd)->filter;
+        if (above->read && above != _filter_callback)
+            return PR_FALSE;
+
+        fd = fd->lower;
+    }
+
+    return PR_FALSE;
+}
+
+
 /* ---------------------------- filter_insert ----------------------------- */
 
 NSAPI_PUBLIC int filter_insert(SYS_NETFD fd, pblock *pb, Session *sn, Request *rq, void *data, const Filter *filter)
@@ -121,6 +121,13 @@ NSAPI_PUBLIC int filter_finish_request(Session *sn, Request *rq, const Filter *a
  */
 NSAPI_PUBLIC void filter_finish_response(Session *sn);
 
+/*
+ * filter_read_transparent returns PR_TRUE if none of the filters above the
+ * specified filter in fd's filter stack alter data that is read, i.e. reading
+ * from fd would return exactly what reading from the filter's layer returns.
+ */
+NSAPI_PUBLIC PRBool filter_read_transparent(SYS_NETFD fd, const Filter *filter);
+
 /*
  * filter_emulate_writev implements FilterWritevFunc using the layer's write
  * filter method.
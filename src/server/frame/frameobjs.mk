@@ -46,6 +46,7 @@ FRAMEOBJS+=log
 FRAMEOBJS+=nsapi30
 FRAMEOBJS+=object
 FRAMEOBJS+=objset
+FRAMEOBJS+=objsnap
 FRAMEOBJS+=aclframe
 FRAMEOBJS+=req
 FRAMEOBJS+=domain
@@ -56,6 +57,7 @@ FRAMEOBJS+=filter
 FRAMEOBJS+=httpfilter
 FRAMEOBJS+=expr
 FRAMEOBJS+=expr.tab
+FRAMEOBJS+=expr_code
 FRAMEOBJS+=args
 FRAMEOBJS+=model
 FRAMEOBJS+=result
@@ -165,6 +165,7 @@ func_init (struct FuncStruct *func_standard)
     unsigned queueSize  = 0;
     unsigned minThreads = 0;
     unsigned maxThreads = 0;
+    PRBool cpuAffinity  = PR_FALSE;
 
     const char *envStr;
 
@@ -189,9 +190,12 @@ func_init (struct FuncStruct *func_standard)
     if ((envStr = conf_findGlobal ("NativePoolMinThreads"))!= NULL)
 	minThreads = atoi (envStr);
 
+    if ((envStr = conf_findGlobal ("NativePoolCPUAffinity"))!= NULL)
+	cpuAffinity = util_getboolean (envStr, PR_FALSE);
+
     memset (poolTable, 0, sizeof (poolTable));
 
-    rv = func_addPool ("NativePool", minThreads, maxThreads, queueSize, stackSize, PR_FALSE);
+    rv = func_addPool2 ("NativePool", minThreads, maxThreads, queueSize, stackSize, cpuAffinity, PR_FALSE);
 
     NS_ASSERT (rv == REQ_PROCEED);
 
@@ -443,6 +447,12 @@ static	unsigned poolIndex;
 
 NSAPI_PUBLIC int
 func_addPool (const char *poolName, unsigned minThreads, unsigned maxThreads, unsigned queueSize, unsigned stackSize, PRBool startPool)
+{
+    return func_addPool2 (poolName, minThreads, maxThreads, queueSize, stackSize, PR_FALSE, startPool);
+}
+
+NSAPI_PUBLIC int
+func_addPool2 (const char *poolName, unsigned minThreads, unsigned maxThreads, unsigned queueSize, unsigned stackSize, PRBool cpuAffinity, PRBool startPool)
 {
     int i = 0;
     for ( ; i < FUNC_MAXPOOLS; i++)
@@ -477,6 +487,7 @@ func_addPool (const char *poolName, unsigned minThreads, unsigned maxThreads, un
     poolTable[i].config.stackSize  = stackSize;
     poolTable[i].config.version	   = NSTP_API_VERSION;
     poolTable[i].config.defTimeout = PR_INTERVAL_NO_TIMEOUT;
+    poolTable[i].config.cpuAffinity = cpuAffinity;
     poolTable[i].pool              = NULL;
 
     if (startPool)
@@ -75,6 +75,7 @@ typedef enum NSFuncFlags {
 /* -------------------------Native Pool Functions-------------------------- */
 NSAPI_PUBLIC PRInt32 func_native_pool_init ();
 NSAPI_PUBLIC int func_addPool (const char *poolName, unsigned minThreads, unsigned maxThreads, unsigned queueSize, unsigned stackSize, PRBool startPool);
+NSAPI_PUBLIC int func_addPool2 (const char *poolName, unsigned minThreads, unsigned maxThreads, unsigned queueSize, unsigned stackSize, PRBool cpuAffinity, PRBool startPool);
 NSAPI_PUBLIC PRBool func_is_native_thread ();
 NSAPI_PUBLIC NSTPPool func_get_native_pool ();
 NSAPI_PUBLIC PRInt32 func_native_pool_wait_work (FuncPtr fn, unsigned poolID, pblock *pb, Session *sn, Request *rq);
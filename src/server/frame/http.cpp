@@ -631,6 +631,25 @@ NSAPI_PUBLIC int http_match_etag(const char *header, const char *etag, int stron
 }
 
 
+/* -------------------------- http_match_if_range ------------------------- */
+
+NSAPI_PUBLIC int http_match_if_range(const char *header, const char *etag, const char *last_modified)
+{
+    /* An If-range: entity tag must match using the strong validator */
+    if (header[0] == '"' || (header[0] == 'W' && header[1] == '/')) {
+        if (!etag || (etag[0] == 'W' && etag[1] == '/') || strcmp(header, etag))
+            return 0; /* mismatch */
+        return 1; /* match */
+    }
+
+    /* An If-range: HTTP-date must exactly match the Last-modified: date */
+    if (!last_modified || strcmp(header, last_modified))
+        return 0; /* mismatch */
+
+    return 1; /* match */
+}
+
+
 /* ----------------------- http_check_preconditions ----------------------- */
 
 NSAPI_PUBLIC int http_check_preconditions(Session *sn, Request *rq, struct tm *mtm, const char *etag)
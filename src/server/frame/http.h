@@ -171,6 +171,13 @@ NSAPI_PUBLIC void http_weaken_etag(Session *sn, Request *rq);
  */
 NSAPI_PUBLIC int http_match_etag(const char *header, const char *etag, int strong);
 
+/*
+ * http_match_if_range indicates whether an If-range: header value matches the
+ * specified Etag or Last-modified: date.  Returns 0 if a Range: header should
+ * be ignored.
+ */
+NSAPI_PUBLIC int http_match_if_range(const char *header, const char *etag, const char *last_modified);
+
 /*
  * Takes the given pblock and prints headers into the given buffer at 
  * position pos. Returns the buffer, reallocated if needed. Modifies pos.
@@ -78,6 +78,7 @@
 
 #include "frame/dbtframe.h"
 #include "ares/arapi.h"
+#include "libproxy/host_dns_cache.h"
 
 #define ACL_HTTP_RIGHT_PREFIX "http_"
 #define ACL_HTTP_RIGHT_PREFIX_LEN (sizeof(ACL_HTTP_RIGHT_PREFIX) - 1)
@@ -1255,63 +1256,6 @@ int servact_dns(Session *sn, Request *rq)
 }
 
 
-PRHostEnt *optimized_gethostbyname(const char *host, Session *sn, Request *rq)
-{
-    if (!host || !*host)
-        return NULL;
-
-    PRNetAddr addr; 
-    int cnt = 0;
-    int dots = 1;
-    int len = 0;
-    char*tmp;
-
-    log_error(LOG_VERBOSE, NULL, sn, rq, "attempting to resolve %s", host);
-
-    // XXX
-    PRHostEnt* he = (PRHostEnt*) pool_malloc(sn->pool, sizeof(PRHostEnt));
-    if (!he)
-        return NULL;
-
-    // XXX
-    char* hostbuf = (char*) pool_malloc(sn->pool, PR_NETDB_BUF_SIZE);
-    if (!hostbuf)
-        return NULL;
-
-    if (!rq->vars || !(tmp = pblock_findval("local-domain-levels", rq->vars)) ||
-        (dots = atoi(tmp)) < 0 || PR_StringToNetAddr(host, &addr) == PR_SUCCESS) { /* off by default in Proxy 3.51 */
-        if (PR_GetHostByName(host, hostbuf, PR_NETDB_BUF_SIZE, he) != PR_SUCCESS)
-            return NULL;
-        return he;
-    }
-
-    const char* p;
-    for(p=host; *p; p++) {
-        if (*p == '.')
-            cnt++;
-    }
-
-    len = (int)(p - host);
-    if (cnt > dots && host[len-1] != '.') {
-        char *dothost = (char *)pool_malloc(sn->pool, len + 2);
-        strcpy(dothost, host);
-        dothost[len] = '.';
-        dothost[len+1] = '\0';
-        if (PR_GetHostByName(dothost, hostbuf, PR_NETDB_BUF_SIZE, he) != PR_SUCCESS)
-        {
-            pool_free(sn->pool, dothost);
-            return NULL;
-        }
-        pool_free(sn->pool, dothost);
-    } else {
-        if (PR_GetHostByName(host, hostbuf, PR_NETDB_BUF_SIZE, he) != PR_SUCCESS)
-            return NULL;
-    }
-
-    return he;
-}
-
-
 PRHostEnt *servact_gethostbyname(const char *host, Session *sn, Request *rq)
 {
 #ifdef XXX_MCC_PROXY
@@ -1323,10 +1267,8 @@ PRHostEnt *servact_gethostbyname(const char *host, Session *sn, Request *rq)
     PRHostEnt* rv = NULL;
 
     if (host) {
-#ifdef MCC_PROXY
-        if ((rv = host_dns_cache_lookup(host, sn, rq)))
+        if (sn && (rv = host_dns_cache_lookup(host, sn, rq)))
             return rv;
-#endif
 
         if (sn && rq) {
 #ifdef XXX_MCC_PROXY
@@ -1344,7 +1286,8 @@ PRHostEnt *servact_gethostbyname(const char *host, Session *sn, Request *rq)
                 break;
 
               case REQ_NOACTION:
-                rv = optimized_gethostbyname(host, sn, rq);
+                // Concurrent misses for the same host share a DNS query
+                rv = host_dns_cache_resolve(host, sn, rq);
                 break;
 
               default:
@@ -1354,8 +1297,8 @@ PRHostEnt *servact_gethostbyname(const char *host, Session *sn, Request *rq)
 #ifdef XXX_MCC_PROXY
             rq->host = pushed;
 #endif
-        } else {
-            rv = optimized_gethostbyname(host, sn, rq);
+        } else if (sn) {
+            rv = host_dns_cache_resolve(host, sn, rq);
         }
 
 #ifdef XXX_MCC_PROXY
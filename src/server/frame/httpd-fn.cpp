@@ -80,6 +80,7 @@
 #include "libproxy/channel.h"
 #include "libproxy/httpclient.h"
 #include "libproxy/proxyerror.h"
+#include "libproxy/host_dns_cache.h"
 #include "shtml/ShtmlSaf.h"
 #ifdef FEAT_SECRULE
 #include "libsecrule/sec_filter.h"
@@ -248,6 +249,7 @@ struct FuncStruct func_standard[] = {
     {"set-virtual-index", pcheck_set_virtual_index, NULL, 0 },
     {"set-default-type", otype_setdefaulttype, NULL, 0 },
     {"stats-xml", stats_xml, NULL, 0 },
+    {"stats-prometheus", stats_prometheus, NULL, 0 },
     {"service-reconfig", service_reconfig, NULL, 0 },
     {"service-debug", service_debug, NULL, 0 },
     {"service-unit-tests", service_unit_tests, NULL, 0 },
@@ -297,6 +299,7 @@ struct FuncStruct func_standard[] = {
     {"forward-user-dn", httpclient_forward_user_dn, NULL, 0},
     {"forward-via", httpclient_forward_via, NULL, 0},
     {"http-client-config", httpclient_http_client_config, NULL, 0},
+    {"init-proxy-dns-cache", host_dns_cache_init, NULL, 0},
     {"service-http", httpclient_service_http, NULL, 0},
     {"proxy-retrieve", httpclient_service_http, NULL, 0},
     {"magnus-internal/send-proxy-error", proxyerror_magnus_internal_send_proxy_error, NULL, 0},
@@ -38,6 +38,16 @@
  */
 
 #include <limits.h>
+#if defined(LINUX)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "private/pprio.h"
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
+#endif
+#endif
 
 #include "netsite.h"
 #include "base/util.h"
@@ -85,6 +95,9 @@
 
 #define MAX_SECONDS_IN_PR_INTERVAL 21600
 
+// Size of the pipe request bodies are spliced through
+#define HTTPFILTER_SPLICE_PIPE_SIZE (1024 * 1024)
+
 static const Filter *_httpfilter_filter;
 static int _ticksPerSecond = PR_SecondsToInterval(1);
 static char _garbage[65536];
@@ -233,6 +246,19 @@ public:
      */
     inline int read(PRFileDesc *lower, void *buf, int amount, PRIntervalTime timeout);
 
+    /**
+     * Return PR_TRUE if request entity body data can be moved from lower
+     * straight into a file with splice().
+     */
+    inline PRBool canSplice(PRFileDesc *lower);
+
+    /**
+     * Move up to amount bytes of request entity body data from lower into the
+     * file fd at its current position without copying the data through user
+     * space.  Returns the number of bytes written to fd or -1 on error.
+     */
+    PRInt64 splice(PRFileDesc *lower, PRFileDesc *fd, PRInt64 amount);
+
     /**
      * Indicate that there is no request message body, regardless of what the
      * request headers indicate.
@@ -342,6 +368,12 @@ private:
      */
     inline int readRawLower(PRFileDesc *lower, void *buf, int amount, PRIntervalTime timeout);
 
+    /**
+     * Splice unbuffered request message body data directly from the lower
+     * layer into the pipe pipefd.  Like readRawLower, but for splice().
+     */
+    inline int spliceRawLower(PRFileDesc *lower, int pipefd, int amount);
+
     /**
      * Read a request message (not entity) body character into buf.
      */
@@ -1139,6 +1171,199 @@ inline int HttpFilterContext::readRawLower(PRFileDesc *lower, void *buf, int amo
 }
 
 
+/* --------------------- HttpFilterContext::canSplice --------------------- */
+
+inline PRBool HttpFilterContext::canSplice(PRFileDesc *lower)
+{
+#if defined(LINUX)
+    // Only identity-encoded bodies that arrive on a plain socket can be
+    // spliced; chunked bodies need unchunking and SSL needs decrypting
+    return _request.state == STATE_ENTITY &&
+           lower->identity == PR_NSPR_IO_LAYER &&
+           !_request.flagErrorReceiving;
+#else
+    return PR_FALSE;
+#endif
+}
+
+
+/* ---------------------- HttpFilterContext::splice ----------------------- */
+
+PRInt64 HttpFilterContext::splice(PRFileDesc *lower, PRFileDesc *fd, PRInt64 amount)
+{
+#if defined(LINUX)
+    PR_ASSERT(canSplice(lower));
+
+    // If the client wanted a 100 Continue response...
+    if (_request.flagExpect100Continue) {
+        if (send100Continue(lower) != PR_SUCCESS)
+            return -1;
+    }
+
+    // Enforce content-length
+    if (_request.contentLimit != -1 && _request.contentReceived + amount > _request.contentLimit)
+        amount = _request.contentLimit - _request.contentReceived;
+
+    PRInt64 total = 0;
+
+    // Start with whatever is sitting in our buffer
+    int available = _request.inbuf.cursize - _request.inbuf.pos;
+    if (available > amount)
+        available = amount;
+    if (available > 0) {
+        if (PR_Write(fd, _request.inbuf.inbuf + _request.inbuf.pos, available) != available) {
+            KEEP_ALIVE(_rq) = PR_FALSE;
+            return -1;
+        }
+        _request.inbuf.pos += available;
+        _request.contentReceived += available;
+        ((NSAPISession *)_sn)->received += available;
+        updateStats(available);
+        total += available;
+    }
+
+    if (total == amount)
+        return total;
+
+    // Move the rest socket -> pipe -> file
+    int pipefd[2];
+    if (pipe(pipefd) == -1) {
+        NsprError::mapUnixErrno();
+        return -1;
+    }
+    fcntl(pipefd[0], F_SETPIPE_SZ, HTTPFILTER_SPLICE_PIPE_SIZE);
+    int size = fcntl(pipefd[0], F_GETPIPE_SZ);
+    if (size <= 0)
+        size = HTTPFILTER_SPLICE_PIPE_SIZE;
+
+    int filefd = PR_FileDesc2NativeHandle(fd);
+
+    while (total < amount) {
+        int rv = spliceRawLower(lower, pipefd[1], (amount - total < size) ? (int)(amount - total) : size);
+        if (rv < 1) {
+            if (rv == 0)
+                NsprError::setError(PR_END_OF_FILE_ERROR, XP_GetAdminStr(DBT_ErrorReadingRequestBody));
+            total = -1;
+            break;
+        }
+
+        _request.contentReceived += rv;
+        ((NSAPISession *)_sn)->received += rv;
+        updateStats(rv);
+
+        // Drain the pipe into the file
+        while (rv > 0) {
+            ssize_t written = ::splice(pipefd[0], NULL, filefd, NULL, rv, SPLICE_F_MOVE);
+            if (written == -1 && errno == EINTR)
+                continue;
+            if (written < 1) {
+                // Whatever the client still sends is not read; don't try to
+                // parse it as the next request
+                if (written == 0)
+                    errno = EIO;
+                NsprError::mapUnixErrno();
+                KEEP_ALIVE(_rq) = PR_FALSE;
+                total = -1;
+                break;
+            }
+            rv -= written;
+            total += written;
+        }
+        if (total == -1)
+            break;
+    }
+
+    close(pipefd[0]);
+    close(pipefd[1]);
+
+    return total;
+#else
+    PR_SetError(PR_NOT_IMPLEMENTED_ERROR, 0);
+    return -1;
+#endif
+}
+
+
+/* ----------------- HttpFilterContext::spliceRawLower ------------------ */
+
+inline int HttpFilterContext::spliceRawLower(PRFileDesc *lower, int pipefd, int amount)
+{
+#if defined(LINUX)
+    // If we previously timed out, etc., we'll fail this read
+    if (_request.flagErrorReceiving) {
+        _request.errorReceiving.restore();
+        return -1;
+    }
+
+    // No single wait lasts longer than the IO timeout or, in total, the
+    // request body timeout
+    PRIntervalTime timeout = _request.ioTimeout;
+    PRIntervalTime rqBodyTimeoutInterval = PR_INTERVAL_NO_TIMEOUT;
+    if ((_request.bodyTimeout != (PRUint64)-1) &&
+        (_request.bodyTimeout < MAX_SECONDS_IN_PR_INTERVAL)) {
+        rqBodyTimeoutInterval = PR_SecondsToInterval(_request.bodyTimeout);
+        if (timeout > rqBodyTimeoutInterval)
+            timeout = rqBodyTimeoutInterval;
+    }
+
+    PRIntervalTime epoch = PR_IntervalNow();
+
+    int sockfd = PR_FileDesc2NativeHandle(lower);
+    int rv;
+    for (;;) {
+        rv = ::splice(sockfd, NULL, pipefd, NULL, amount, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (rv >= 0)
+            break;
+
+        if (errno == EINTR)
+            continue;
+
+        if (errno != EAGAIN) {
+            NsprError::mapUnixErrno();
+            break;
+        }
+
+        // Wait for the client
+        struct pollfd pfd;
+        pfd.fd = sockfd;
+        pfd.events = POLLIN;
+        int ms = (timeout == PR_INTERVAL_NO_TIMEOUT) ? -1 : PR_IntervalToMilliseconds(timeout);
+        int prv = poll(&pfd, 1, ms);
+        if (prv == -1 && errno != EINTR) {
+            NsprError::mapUnixErrno();
+            break;
+        }
+        if (prv == 0) {
+            PR_SetError(PR_IO_TIMEOUT_ERROR, 0);
+            break;
+        }
+    }
+
+    // Remember failures
+    if (rv == -1) {
+        _request.errorReceiving.save();
+        _request.flagErrorReceiving = PR_TRUE;
+    }
+
+    // If we're enforcing a request body timeout...
+    if (_request.bodyTimeout != (PRUint64)-1) {
+        PRIntervalTime elapsed = PR_IntervalNow() - epoch;
+        PRUint64 secondsElapsed = PR_IntervalToSeconds(elapsed);
+        if (_request.bodyTimeout > secondsElapsed) {
+            _request.bodyTimeout -= secondsElapsed;
+        } else {
+            _request.bodyTimeout = 0;
+        }
+    }
+
+    return rv;
+#else
+    PR_SetError(PR_NOT_IMPLEMENTED_ERROR, 0);
+    return -1;
+#endif
+}
+
+
 /* ---------------------- HttpFilterContext::getcRaw ---------------------- */
 
 int HttpFilterContext::getcRaw(PRFileDesc *lower, PRIntervalTime timeout)
@@ -2474,6 +2699,50 @@ void httpfilter_buffer_output(Session *sn, Request *rq, PRBool enabled)
 }
 
 
+/* ---------------- httpfilter_can_splice_request_body -------------------- */
+
+PRBool httpfilter_can_splice_request_body(Session *sn, Request *rq)
+{
+    HttpFilterContext *httpfilter = session_get_httpfilter_context(sn);
+    if (!httpfilter)
+        return PR_FALSE;
+
+    filter_generic_callback(sn);
+
+    // Input filters above us would never see the data
+    if (!filter_read_transparent(sn->csd, _httpfilter_filter))
+        return PR_FALSE;
+
+    FilterLayer *layer = filter_layer(sn->csd, _httpfilter_filter);
+    if (!layer)
+        return PR_FALSE;
+
+    return httpfilter->canSplice(layer->lower);
+}
+
+
+/* ------------------ httpfilter_splice_request_body --------------------- */
+
+PRInt64 httpfilter_splice_request_body(Session *sn, Request *rq, PRFileDesc *fd, PRInt64 amount)
+{
+    HttpFilterContext *httpfilter = session_get_httpfilter_context(sn);
+    if (!httpfilter) {
+        PR_SetError(PR_INVALID_STATE_ERROR, 0);
+        return -1;
+    }
+
+    filter_read_callback(sn);
+
+    FilterLayer *layer = filter_layer(sn->csd, _httpfilter_filter);
+    if (!layer || !httpfilter->canSplice(layer->lower)) {
+        PR_SetError(PR_INVALID_STATE_ERROR, 0);
+        return -1;
+    }
+
+    return httpfilter->splice(layer->lower, fd, amount);
+}
+
+
 /* ------------------ httpfilter_set_request_body_limit ------------------- */
 
 int httpfilter_set_request_body_limit(Session *sn, Request *rq, int size)
@@ -117,6 +117,22 @@ NSAPI_PUBLIC void httpfilter_buffer_output(Session *sn, Request *rq, PRBool enab
  */
 NSAPI_PUBLIC int httpfilter_set_request_body_limit(Session *sn, Request *rq, int size);
 
+/*
+ * httpfilter_can_splice_request_body returns PR_TRUE if the request entity
+ * body can be moved straight from the network into a file with
+ * httpfilter_splice_request_body.  This is not the case for SSL connections,
+ * chunked request bodies, if an Input filter was inserted, or on platforms
+ * without splice().
+ */
+NSAPI_PUBLIC PRBool httpfilter_can_splice_request_body(Session *sn, Request *rq);
+
+/*
+ * httpfilter_splice_request_body writes up to amount bytes of request entity
+ * body to the file fd at its current position without copying the data
+ * through user space.  Returns the number of bytes written or -1 on error.
+ */
+NSAPI_PUBLIC PRInt64 httpfilter_splice_request_body(Session *sn, Request *rq, PRFileDesc *fd, PRInt64 amount);
+
 /*
  * httpfilter_suppress_flush advises the HTTP filter whether it should send
  * response data on to the lower layers of the filter stack (i.e. out on the
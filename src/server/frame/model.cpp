@@ -45,6 +45,7 @@
 #include "frame/dbtframe.h"
 #include "expr_parse.h"
 #include "expr_pvt.h"
+#include "expr_code_pvt.h"
 #include "model_pvt.h"
 
 
@@ -155,6 +156,7 @@ public:
     virtual ~Fragment() { }
     virtual Fragment *dup() const = 0;
     virtual PRStatus interpolate(Interpolator& interpolator) const = 0;
+    virtual void compile(ExpressionCompiler& compiler, int dst) const = 0;
 
 private:
     Fragment(const Fragment&);
@@ -407,6 +409,29 @@ char *Interpolator::terminate()
 }
 
 
+/* -------------------------- interpolate_result -------------------------- */
+
+static inline PRStatus interpolate_result(Interpolator& interpolator, const Result& result)
+{
+    if (result.isError()) {
+        result.setNsprError();
+        return PR_FAILURE;
+    }
+
+    const char *s = result.getConstString();
+    int len = result.getStringLength();
+
+    char *p = interpolator.require(len);
+    if (p == NULL)
+        return PR_FAILURE;
+
+    memcpy(p, s, len);
+    interpolator.advance(len);
+
+    return PR_SUCCESS;
+}
+
+
 /* -------------------------- FragmentInvariant --------------------------- */
 
 /*
@@ -417,6 +442,7 @@ public:
     FragmentInvariant(const NSString& s);
     Fragment *dup() const;
     PRStatus interpolate(Interpolator& interpolator) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
 
 private:
     NSString s;
@@ -445,6 +471,12 @@ PRStatus FragmentInvariant::interpolate(Interpolator& interpolator) const
     return PR_SUCCESS;
 }
 
+void FragmentInvariant::compile(ExpressionCompiler& compiler, int dst) const
+{
+    Context& context = compiler.getContext();
+    compiler.emitConstant(dst, context.createStringConstantResult(s.data(), s.length()));
+}
+
 
 /* -------------------------- FragmentExpression -------------------------- */
 
@@ -458,6 +490,7 @@ public:
     ~FragmentExpression();
     Fragment *dup() const;
     PRStatus interpolate(Interpolator& interpolator) const;
+    void compile(ExpressionCompiler& compiler, int dst) const;
 
 private:
     Expression *e;
@@ -480,22 +513,13 @@ Fragment *FragmentExpression::dup() const
 PRStatus FragmentExpression::interpolate(Interpolator& interpolator) const
 {
     Result result = e->evaluate(interpolator.context);
-    if (result.isError()) {
-        result.setNsprError();
-        return PR_FAILURE;
-    }
-        
-    const char *s = result.getConstString();
-    int len = result.getStringLength();
-
-    char *p = interpolator.require(len);
-    if (p == NULL)
-        return PR_FAILURE;
 
-    memcpy(p, s, len);
-    interpolator.advance(len);
+    return interpolate_result(interpolator, result);
+}
 
-    return PR_SUCCESS;
+void FragmentExpression::compile(ExpressionCompiler& compiler, int dst) const
+{
+    e->compile(compiler, dst);
 }
 
 
@@ -504,7 +528,8 @@ PRStatus FragmentExpression::interpolate(Interpolator& interpolator) const
 ModelString::ModelString()
 : invariant(PR_TRUE),
   interpolative(PR_FALSE),
-  estimate(0)
+  estimate(0),
+  code(NULL)
 {
     unescaped.setGrowthSize(NSString::SMALL_STRING);
     uninterpolated.setGrowthSize(NSString::SMALL_STRING);
@@ -517,6 +542,7 @@ ModelString::~ModelString()
 {
     for (int i = 0; i < fragments.length(); i++)
         delete fragments[i];
+    delete code;
 }
 
 
@@ -545,6 +571,9 @@ ModelString *ModelString::dupModelString() const
 
     model->complete();
 
+    if (code != NULL)
+        model->compileProgram();
+
     return model;
 }
 
@@ -607,6 +636,16 @@ PRStatus ModelString::interpolate(Context& context, const char **pp, int *plen,
         return PR_SUCCESS;
     }
 
+    // If the string model was compiled, compute the values of all the
+    // fragments up front
+    Result registers[EXPR_CODE_MAX_REGISTERS];
+    const Result *computed = NULL;
+    if (code != NULL) {
+        code->execute(context, registers);
+        computed = &registers[code->getFirstFragment()];
+        PR_ASSERT(code->getFragmentCount() == fragments.length());
+    }
+
     // We need to actually interpolate things.  Start with a buffer we think
     // will be big enough.
     Interpolator interpolator(context);
@@ -617,7 +656,13 @@ PRStatus ModelString::interpolate(Context& context, const char **pp, int *plen,
     int nerrors = 0;
     int nfragments = fragments.length();
     for (int i = 0; i < nfragments; i++) {
-        if (fragments[i]->interpolate(interpolator) == PR_FAILURE) {
+        PRStatus rv;
+        if (computed != NULL) {
+            rv = interpolate_result(interpolator, computed[i]);
+        } else {
+            rv = fragments[i]->interpolate(interpolator);
+        }
+        if (rv == PR_FAILURE) {
             // Record the error but keep on trucking
             if (nerrors == 0)
                 error.save();
@@ -664,6 +709,61 @@ PRStatus ModelString::interpolate(Context& context, const char **pp, int *plen,
 }
 
 
+/* ---------------------- ModelString::compileFragments -------------------- */
+
+int ModelString::compileFragments(ExpressionCompiler& compiler) const
+{
+    // Allocate a register for each fragment's value, then compute them
+    int nfragments = fragments.length();
+    int first = -1;
+    for (int i = 0; i < nfragments; i++) {
+        int reg = compiler.allocRegister();
+        if (i == 0)
+            first = reg;
+    }
+
+    for (int i = 0; i < nfragments; i++)
+        fragments[i]->compile(compiler, first + i);
+
+    return first;
+}
+
+
+/* ------------------------- ModelString::compile ------------------------- */
+
+void ModelString::compile(ExpressionCompiler& compiler, int dst) const
+{
+    if (invariant) {
+        Context& context = compiler.getContext();
+        compiler.emitConstant(dst, context.createStringConstantResult(unescaped.data(), unescaped.length()));
+        return;
+    }
+
+    int nfragments = fragments.length();
+    int first = compileFragments(compiler);
+    compiler.emitInterpolate(dst, first, nfragments);
+    for (int i = nfragments - 1; i >= 0; i--)
+        compiler.releaseRegister(first + i);
+}
+
+
+/* --------------------- ModelString::compileProgram ---------------------- */
+
+void ModelString::compileProgram()
+{
+    delete code;
+    code = NULL;
+
+    // Invariant string models don't require interpolation
+    if (invariant)
+        return;
+
+    ExpressionCompiler compiler;
+    int first = compileFragments(compiler);
+    code = compiler.createInterpolationProgram(first, fragments.length());
+}
+
+
 /* ------------------------ ModelString::evaluate ------------------------- */
 
 Result ModelString::evaluate(Context& context) const
@@ -1069,6 +1169,15 @@ ModelString *model_str_dup(const ModelString *model)
 }
 
 
+/* -------------------------- model_str_compile --------------------------- */
+
+void model_str_compile(ModelString *model)
+{
+    if (model != NULL)
+        model->compileProgram();
+}
+
+
 /* ---------------------------- model_str_free ---------------------------- */
 
 void model_str_free(ModelString *model)
@@ -1219,6 +1328,8 @@ ModelPblock *model_pb_create(const pblock *pb)
                     return NULL;
                 }
 
+                model_str_compile(value);
+
                 model->addParameter(p->param->name, value);
             }
         }
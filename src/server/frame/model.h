@@ -109,6 +109,13 @@ NSAPI_PUBLIC ModelString *INTmodel_str_create(const char *s);
  */
 NSAPI_PUBLIC ModelString *INTmodel_str_dup(const ModelString *model);
 
+/*
+ * model_str_compile lowers a string model into bytecode that subsequent
+ * calls to model_str_interpolate will use.  String models that cannot be
+ * compiled continue to be interpolated fragment by fragment.
+ */
+NSAPI_PUBLIC void INTmodel_str_compile(ModelString *model);
+
 /*
  * model_str_free destroys a string model.
  */
@@ -166,6 +173,7 @@ PR_END_EXTERN_C
 #define model_fragment_is_var_ref INTmodel_fragment_is_var_ref
 #define model_str_create INTmodel_str_create
 #define model_str_dup INTmodel_str_dup
+#define model_str_compile INTmodel_str_compile
 #define model_str_free INTmodel_str_free
 #define model_str_interpolate INTmodel_str_interpolate
 #define model_pb_create INTmodel_pb_create
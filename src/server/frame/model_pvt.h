@@ -115,6 +115,22 @@ public:
      */
     Result evaluate(Context& context) const;
 
+    /*
+     * Emit instructions that store the synthetic string in register dst.
+     */
+    void compile(ExpressionCompiler& compiler, int dst) const;
+
+    /*
+     * Lower the string model's fragments into an ExpressionProgram for use
+     * by subsequent calls to interpolate.
+     */
+    void compileProgram();
+
+    /*
+     * Indicate whether compileProgram successfully lowered the string model.
+     */
+    PRBool isCompiled() const { return code != NULL; }
+
     /*
      * Append a quoted, escaped, uninterpolated version of the string model to
      * the passed buffer.
@@ -125,12 +141,15 @@ private:
     ModelString(const ModelString&);
     ModelString& operator=(const ModelString&);
 
+    int compileFragments(ExpressionCompiler& compiler) const;
+
     PRBool invariant;
     PRBool interpolative;
     NSString unescaped;
     NSString uninterpolated;
     mutable int estimate;
     PtrVector<Fragment> fragments;
+    ExpressionProgram *code;
 };
 
 #endif /* FRAME_MODEL_PVT_H */
@@ -501,6 +501,10 @@ static Expression *parse_container_expr(const TokenContent& name, TokenizerCharS
         throw ObjsetException(firstLine, 0 /* don't include col */, error);
     }
 
+    // Lower the expression into bytecode now so that requests don't have to
+    // walk the expression tree
+    expr_compile(expr);
+
     return expr;
 }
 
@@ -185,6 +185,17 @@ NSAPI_PUBLIC PRStatus objset_save(const char *filename, httpd_objset *os);
 
 NSAPI_PUBLIC httpd_objset *objset_dup(const httpd_objset *src);
 
+/*
+ * objset_load_snapshot creates an object set from the file named filename.
+ * If the directory snapdir holds a binary snapshot of the file's current
+ * contents, the object set is built from the snapshot instead of parsing the
+ * file. Otherwise the file is parsed with objset_load and a new snapshot is
+ * written to snapdir, which is created if it does not exist. Logs an error
+ * and returns NULL on failure.
+ */
+NSAPI_PUBLIC httpd_objset *objset_load_snapshot(const char *filename,
+                                                const char *snapdir);
+
 httpd_objset *objset_create_pool(pool_handle_t *pool);
 
 /*
@@ -0,0 +1,559 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * objsnap.cpp: Binary snapshots of parsed obj.conf files
+ *
+ * Tokenizing obj.conf is the bulk of the work objset_load does.  For a
+ * configuration with thousands of virtual servers, each with its own
+ * obj.conf, that work dominates server startup.  objset_load_snapshot keeps
+ * a binary image of every object set it loads.  The image is a flat list of
+ * records that replays the calls the parser made to build the object set,
+ * so loading it skips the tokenizer entirely.
+ *
+ * A snapshot records the MD5 of the file it was built from.  A missing,
+ * stale or damaged snapshot is ignored: the file is parsed with objset_load
+ * and a new snapshot replaces the old one.
+ *
+ * See objset.h for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "netsite.h"
+#include "hasht.h"
+#include "support/NSString.h"
+#include "base/daemon.h"
+#include "base/ereport.h"
+#include "base/plist.h"
+#include "base/util.h"
+#include "frame/expr.h"
+#include "frame/object.h"
+#include "frame/httpdir.h"
+#include "frame/objset.h"
+
+
+/*
+ * OBJSNAP_VERSION must be incremented whenever the record layout below, or
+ * the way the parser builds an object set, changes.
+ */
+#define OBJSNAP_MAGIC 0x4f534e50 /* 'OSNP' */
+#define OBJSNAP_VERSION 1
+
+/*
+ * ObjsnapHeader begins every snapshot file.  It is followed by the records:
+ *
+ *   count of objects, then for each object:
+ *     name pblock
+ *     count of <Client> pblocks, then each pblock
+ *     count of conditions, then for each condition:
+ *       expression text (empty for <Else>), inside index, follows index
+ *     count of directive tables, then for each table:
+ *       directive name, count of directives, then for each directive:
+ *         client index, condition index, param pblock
+ *
+ * Counts and indexes are 32-bit integers in native byte order; an index of
+ * -1 means none.  Strings are a 32-bit length followed by the characters and
+ * a terminating NUL, so they can be used in place in the mapped file.  A
+ * pblock is a count of parameters followed by each name and value.
+ */
+struct ObjsnapHeader {
+    PRUint32 magic;
+    PRUint32 version;
+    PRUint32 size; /* size of the snapshot file including the header */
+    unsigned char md5[MD5_LENGTH]; /* MD5 of the obj.conf file */
+};
+
+/*
+ * ObjsnapFormatException is thrown when a snapshot can't be decoded.
+ */
+class ObjsnapFormatException { };
+
+
+/* ---------------------------- ObjsnapWriter ----------------------------- */
+
+class ObjsnapWriter {
+public:
+    void putInt(PRInt32 i)
+    {
+        buffer.append((const char *)&i, sizeof(i));
+    }
+
+    void putString(const char *s)
+    {
+        int len = strlen(s);
+        putInt(len);
+        buffer.append(s, len + 1);
+    }
+
+    void putPblock(const pblock *pb)
+    {
+        PRInt32 n = 0;
+        PListEnumerate((PList_t)pb, &count_param, &n);
+        putInt(n);
+        PListEnumerate((PList_t)pb, &put_param, this);
+    }
+
+    NSString buffer;
+
+private:
+    static void count_param(char *name, const void *value, void *data)
+    {
+        (*(PRInt32 *)data)++;
+    }
+
+    static void put_param(char *name, const void *value, void *data)
+    {
+        ObjsnapWriter *writer = (ObjsnapWriter *)data;
+        writer->putString(name);
+        writer->putString((const char *)value);
+    }
+};
+
+
+/* ---------------------------- ObjsnapReader ----------------------------- */
+
+class ObjsnapReader {
+public:
+    ObjsnapReader(const char *data, PRUint32 size)
+    : p(data), end(data + size)
+    { }
+
+    PRInt32 getInt()
+    {
+        PRInt32 i;
+        if (end - p < (int)sizeof(i))
+            throw ObjsnapFormatException();
+        memcpy(&i, p, sizeof(i)); // the record may not be aligned
+        p += sizeof(i);
+        return i;
+    }
+
+    PRInt32 getCount()
+    {
+        PRInt32 n = getInt();
+        if (n < 0 || n > end - p)
+            throw ObjsnapFormatException();
+        return n;
+    }
+
+    PRInt32 getIndex(int limit)
+    {
+        PRInt32 i = getInt();
+        if (i < -1 || i >= limit)
+            throw ObjsnapFormatException();
+        return i;
+    }
+
+    const char *getString(int& len)
+    {
+        len = getInt();
+        if (len < 0 || len >= end - p || p[len] != '\0')
+            throw ObjsnapFormatException();
+        const char *s = p;
+        p += len + 1;
+        return s;
+    }
+
+    pblock *getPblock()
+    {
+        pblock *pb = pblock_create(1);
+        if (!pb)
+            throw ObjsnapFormatException();
+
+        try {
+            int n = getCount();
+            for (int i = 0; i < n; i++) {
+                int namelen;
+                const char *name = getString(namelen);
+                int valuelen;
+                const char *value = getString(valuelen);
+                if (const pb_key *key = pblock_key(name)) {
+                    pblock_kvinsert(key, value, valuelen, pb);
+                } else {
+                    pblock_nvinsert(name, value, pb);
+                }
+            }
+        }
+        catch (const ObjsnapFormatException&) {
+            pblock_free(pb);
+            throw;
+        }
+
+        return pb;
+    }
+
+    PRBool done() const { return p == end; }
+
+private:
+    const char *p;
+    const char *end;
+};
+
+
+/* ------------------------------ hash_file ------------------------------- */
+
+static PRStatus hash_file(const char *filename, unsigned char *md5)
+{
+    PRFileDesc *fd = PR_Open(filename, PR_RDONLY, 0);
+    if (!fd)
+        return PR_FAILURE;
+
+    void *hctx = nsapi_md5hash_create();
+    if (!hctx) {
+        PR_Close(fd);
+        return PR_FAILURE;
+    }
+
+    nsapi_md5hash_begin(hctx);
+
+    PRInt32 rv;
+    for (;;) {
+        unsigned char buf[FILE_BUFFERSIZE];
+        rv = PR_Read(fd, buf, sizeof(buf));
+        if (rv < 1)
+            break;
+        nsapi_md5hash_update(hctx, buf, rv);
+    }
+
+    nsapi_md5hash_end(hctx, md5);
+    nsapi_md5hash_destroy(hctx);
+    PR_Close(fd);
+
+    return (rv < 0) ? PR_FAILURE : PR_SUCCESS;
+}
+
+
+/* ---------------------------- snapshot_path ----------------------------- */
+
+static void snapshot_path(const char *filename, const char *snapdir, NSString& path)
+{
+    // Name the snapshot after the obj.conf path, not its contents, so each
+    // obj.conf file has exactly one snapshot
+    unsigned char md5[MD5_LENGTH];
+    nsapi_md5hash_data(md5, (unsigned char *)filename, strlen(filename));
+
+    path.append(snapdir);
+    path.append("/objset-");
+    for (int i = 0; i < (int)sizeof(md5); i++)
+        path.printf("%02x", md5[i]);
+    path.append(".snap");
+}
+
+
+/* ---------------------------- find_condition ---------------------------- */
+
+static int find_condition(const Condition *cond)
+{
+    return cond ? cond->i : -1;
+}
+
+
+/* ------------------------------ find_client ----------------------------- */
+
+static int find_client(const httpd_object *obj, const pblock *client)
+{
+    if (client) {
+        for (int i = 0; i < obj->np; i++) {
+            if (obj->pb[i] == client)
+                return i;
+        }
+    }
+    return -1;
+}
+
+
+/* ---------------------------- encode_objset ----------------------------- */
+
+static void encode_objset(const httpd_objset *os, ObjsnapWriter& writer)
+{
+    writer.putInt(os->pos);
+    for (int x = 0; x < os->pos; x++) {
+        const httpd_object *obj = os->obj[x];
+
+        writer.putPblock(obj->name);
+
+        writer.putInt(obj->np);
+        for (int i = 0; i < obj->np; i++)
+            writer.putPblock(obj->pb[i]);
+
+        writer.putInt(obj->nc);
+        for (int i = 0; i < obj->nc; i++) {
+            const Condition *cond = obj->cond[i];
+            if (cond->expr) {
+                char *s = expr_format(cond->expr);
+                writer.putString(s);
+                FREE(s);
+            } else {
+                writer.putString("");
+            }
+            writer.putInt(find_condition(cond->inside));
+            writer.putInt(find_condition(cond->follows));
+        }
+
+        int ntables = 0;
+        for (int dc = 0; dc < obj->nd; dc++) {
+            if (obj->dt[dc].ni)
+                ntables++;
+        }
+        writer.putInt(ntables);
+        for (int dc = 0; dc < obj->nd; dc++) {
+            const dtable *dt = &obj->dt[dc];
+            if (!dt->ni)
+                continue;
+            writer.putString(directive_num2name(dc));
+            writer.putInt(dt->ni);
+            for (int i = 0; i < dt->ni; i++) {
+                writer.putInt(find_client(obj, dt->inst[i].client.pb));
+                writer.putInt(find_condition(dt->inst[i].cond));
+                writer.putPblock(dt->inst[i].param.pb);
+            }
+        }
+    }
+}
+
+
+/* ---------------------------- decode_object ----------------------------- */
+
+static void decode_object(ObjsnapReader& reader, httpd_object *obj)
+{
+    int nclients = reader.getCount();
+    for (int i = 0; i < nclients; i++) {
+        pblock *client = reader.getPblock();
+        if (object_add_client(client, obj) != PR_SUCCESS) {
+            pblock_free(client);
+            throw ObjsnapFormatException();
+        }
+    }
+
+    int nconds = reader.getCount();
+    for (int i = 0; i < nconds; i++) {
+        int len;
+        const char *s = reader.getString(len);
+        int inside = reader.getIndex(i);
+        int follows = reader.getIndex(i);
+
+        // The <If>/<ElseIf> expression was valid when the snapshot was taken,
+        // but don't assume the current expression functions agree
+        Expression *expr = NULL;
+        if (len) {
+            expr = expr_create(s);
+            if (!expr)
+                throw ObjsnapFormatException();
+            expr_compile(expr);
+        }
+
+        if (!object_add_condition(expr,
+                                  (inside != -1) ? obj->cond[inside] : NULL,
+                                  (follows != -1) ? obj->cond[follows] : NULL,
+                                  obj))
+        {
+            expr_free(expr);
+            throw ObjsnapFormatException();
+        }
+    }
+
+    int ntables = reader.getCount();
+    for (int t = 0; t < ntables; t++) {
+        int len;
+        int dc = directive_name2num(reader.getString(len));
+        if (dc < 0 || dc >= obj->nd)
+            throw ObjsnapFormatException();
+
+        int ni = reader.getCount();
+        for (int i = 0; i < ni; i++) {
+            int client = reader.getIndex(obj->np);
+            int cond = reader.getIndex(obj->nc);
+            pblock *param = reader.getPblock();
+            if (object_append_directive(dc,
+                                        param,
+                                        (client != -1) ? obj->pb[client] : NULL,
+                                        (cond != -1) ? obj->cond[cond] : NULL,
+                                        obj) != PR_SUCCESS)
+            {
+                pblock_free(param);
+                throw ObjsnapFormatException();
+            }
+        }
+    }
+}
+
+
+/* ---------------------------- decode_objset ----------------------------- */
+
+static httpd_objset *decode_objset(const char *data, PRUint32 size)
+{
+    httpd_objset *os = objset_create();
+    if (!os)
+        return NULL;
+
+    try {
+        ObjsnapReader reader(data, size);
+
+        int nobjs = reader.getCount();
+        for (int x = 0; x < nobjs; x++) {
+            pblock *name = reader.getPblock();
+            httpd_object *obj = objset_new_object(name, os);
+            decode_object(reader, obj);
+        }
+
+        if (!reader.done())
+            throw ObjsnapFormatException();
+    }
+    catch (const ObjsnapFormatException&) {
+        objset_free(os);
+        os = NULL;
+    }
+
+    return os;
+}
+
+
+/* ---------------------------- read_snapshot ----------------------------- */
+
+static httpd_objset *read_snapshot(const char *path, const unsigned char *md5)
+{
+    PRFileDesc *fd = PR_Open(path, PR_RDONLY, 0);
+    if (!fd)
+        return NULL;
+
+    httpd_objset *os = NULL;
+
+    PRFileInfo64 finfo;
+    if (PR_GetOpenFileInfo64(fd, &finfo) == PR_SUCCESS &&
+        finfo.size > (PRInt64)sizeof(ObjsnapHeader) &&
+        finfo.size <= PR_INT32_MAX)
+    {
+        PRUint32 size = finfo.size;
+        PRFileMap *map = PR_CreateFileMap(fd, size, PR_PROT_READONLY);
+        if (map) {
+            const char *data = (const char *)PR_MemMap(map, 0, size);
+            if (data) {
+                ObjsnapHeader header;
+                memcpy(&header, data, sizeof(header));
+                if (header.magic == OBJSNAP_MAGIC &&
+                    header.version == OBJSNAP_VERSION &&
+                    header.size == size &&
+                    !memcmp(header.md5, md5, sizeof(header.md5)))
+                {
+                    os = decode_objset(data + sizeof(header),
+                                       size - sizeof(header));
+                }
+                PR_MemUnmap((void *)data, size);
+            }
+            PR_CloseFileMap(map);
+        }
+    }
+
+    PR_Close(fd);
+
+    return os;
+}
+
+
+/* ---------------------------- write_snapshot ---------------------------- */
+
+static PRStatus write_snapshot(const char *path, const unsigned char *md5, const httpd_objset *os)
+{
+    ObjsnapWriter writer;
+    encode_objset(os, writer);
+
+    ObjsnapHeader header;
+    header.magic = OBJSNAP_MAGIC;
+    header.version = OBJSNAP_VERSION;
+    header.size = sizeof(header) + writer.buffer.length();
+    memcpy(header.md5, md5, sizeof(header.md5));
+
+    // Write a private file and rename it into place so that other processes
+    // never see a partially written snapshot
+    NSString temp;
+    temp.printf("%s.%d", path, (int)getpid());
+
+    PRFileDesc *fd = PR_Open(temp, PR_WRONLY | PR_CREATE_FILE | PR_TRUNCATE, 0600);
+    if (!fd)
+        return PR_FAILURE;
+
+    PRStatus rv = PR_SUCCESS;
+    if (PR_Write(fd, &header, sizeof(header)) != sizeof(header))
+        rv = PR_FAILURE;
+    if (PR_Write(fd, writer.buffer.data(), writer.buffer.length()) != (PRInt32)writer.buffer.length())
+        rv = PR_FAILURE;
+    if (PR_Close(fd) != PR_SUCCESS)
+        rv = PR_FAILURE;
+
+    if (rv == PR_SUCCESS) {
+#ifdef XP_WIN32
+        PR_Delete(path);
+#endif
+        if (rename(temp, path))
+            rv = PR_FAILURE;
+    }
+
+    if (rv != PR_SUCCESS)
+        PR_Delete(temp);
+
+    return rv;
+}
+
+
+/* ------------------------- objset_load_snapshot ------------------------- */
+
+NSAPI_PUBLIC httpd_objset *objset_load_snapshot(const char *filename, const char *snapdir)
+{
+    unsigned char md5[MD5_LENGTH];
+    if (hash_file(filename, md5) != PR_SUCCESS)
+        return objset_load(filename, NULL);
+
+    NSString path;
+    snapshot_path(filename, snapdir, path);
+
+    httpd_objset *os = read_snapshot(path, md5);
+    if (os)
+        return os;
+
+    os = objset_load(filename, NULL);
+    if (os) {
+        // The first snapshot creates the directory
+        if (PR_Access(snapdir, PR_ACCESS_EXISTS) != PR_SUCCESS)
+            PR_MkDir(snapdir, 0700);
+
+        if (write_snapshot(path, md5, os) != PR_SUCCESS) {
+            ereport(LOG_VERBOSE, "Unable to write snapshot %s of %s (%s)",
+                    path.data(), filename, system_errmsg());
+        }
+    }
+
+    return os;
+}
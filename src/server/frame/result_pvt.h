@@ -66,6 +66,12 @@ enum ResultType {
  */
 class Result {
 public:
+    /*
+     * Construct an empty error Result, e.g. an ExpressionProgram register
+     * that has yet to be written.
+     */
+    Result() : type(RESULT_ERROR), b(PR_FALSE), i(0), pool(NULL), s(""), len(0) { }
+
     PRBool isError() const { return type == RESULT_ERROR; }
     PRBool isBoolean() const { return type == RESULT_BOOLEAN; }
     PRBool isInteger() const { return type == RESULT_INTEGER; }
@@ -91,6 +97,7 @@ private:
     int len;
 
 friend class Context;
+friend class ExpressionCompiler;
 };
 
 /*
@@ -43,6 +43,7 @@
 #include "base/net.h"
 #include "httpdaemon/WebServer.h"
 #include "httpdaemon/ListenSocketConfig.h"   // ListenSocketConfig class
+#include "httpdaemon/statscounters.h"        // StatsCounters
 #include "httpdaemon/dbthttpdaemon.h"
 
 ListenSocketConfig::ListenSocketConfig(ServerXMLSchema::HttpListener& config, ServerXMLSchema::Pkcs11& pkcs11, ConfigurationObject* parent)
@@ -56,7 +57,8 @@ ListenSocketConfig::ListenSocketConfig(ServerXMLSchema::HttpListener& config, Se
     multipleVS_(PR_FALSE),
     vsHash_(7),
     sslparams_(NULL),
-    ipConfigHash_(NULL)
+    ipConfigHash_(NULL),
+    latencyHistogram_(NULL)
 {
     vsHash_.setMixCase();
     vsHostPatternList_.setAutoDestroy(PR_TRUE);
@@ -97,6 +99,12 @@ ListenSocketConfig::cleanup(void)
         delete ipConfigHash_;
         ipConfigHash_ = NULL;
     }
+
+    if (latencyHistogram_)
+    {
+        StatsCounters::releaseNamedHistogram(latencyHistogram_);
+        latencyHistogram_ = NULL;
+    }
 }
 
 int
@@ -46,6 +46,7 @@
 
 class VirtualServer;
 class VirtualServerHostPattern;
+struct StatsHistogram;
 
 /**
  * Represents the configuration/parameters that are used to create/initialize
@@ -132,6 +133,21 @@ class ListenSocketConfig : public ServerXMLSchema::HttpListenerWrapper, public C
          */
         PRBool isNoDelaySupported(void) const;
 
+        /**
+         * Sets the histogram that records the latency of requests received
+         * on this listen socket.  The reference taken by
+         * <code>StatsCounters::getNamedHistogram</code> is released when the
+         * configuration is destroyed.
+         */
+        void setLatencyHistogram(StatsHistogram* histogram);
+
+        /**
+         * Returns the histogram that records the latency of requests
+         * received on this listen socket, or <code>NULL</code> if there is
+         * none.
+         */
+        StatsHistogram* getLatencyHistogram(void) const;
+
         /**
          * Adds an entry in the hash table associating a given host header
          * with a virtual server.
@@ -285,6 +301,11 @@ class ListenSocketConfig : public ServerXMLSchema::HttpListenerWrapper, public C
          */
         ListenSocketConfigHash *ipConfigHash_;
 
+        /**
+         * Optional request latency histogram shared by every process.
+         */
+        StatsHistogram* latencyHistogram_;
+
         /**
          * Frees dynamically allocated memory.  Called by the destructor and in
          * the event of an exception during construction.
@@ -381,6 +402,20 @@ ListenSocketConfig::isNoDelaySupported(void) const
     return this->bNoDelaySupported_;
 }
 
+inline
+void
+ListenSocketConfig::setLatencyHistogram(StatsHistogram* histogram)
+{
+    this->latencyHistogram_ = histogram;
+}
+
+inline
+StatsHistogram*
+ListenSocketConfig::getLatencyHistogram(void) const
+{
+    return this->latencyHistogram_;
+}
+
 inline
 VirtualServer *
 ListenSocketConfig::findVS(const char* host) const
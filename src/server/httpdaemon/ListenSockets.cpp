@@ -53,6 +53,7 @@ using namespace std;
 #include "frame/conf.h"                      // conf_getboolean
 #include "httpdaemon/dbthttpdaemon.h"        // DBT_LS* message strings
 #include "httpdaemon/statsmanager.h"         // StatsManager class
+#include "httpdaemon/statscounters.h"        // StatsCounters class
 #include "httpdaemon/configuration.h"        // Configuration class
 #include "httpdaemon/daemonsession.h"        // DaemonSession::GetConnQueue()
 #include "httpdaemon/ListenSocket.h"         // ListenSocket class
@@ -341,6 +342,10 @@ ListenSockets::addNewSockets(Configuration& newConfig, PRBool* lsExists,
             statsLSS->mode = STATS_LISTEN_ACTIVE;
         }
 
+        // Request latency for this LSC is shared by every process
+        newLSC->setLatencyHistogram(StatsCounters::getNamedHistogram(
+                                    STATS_HISTOGRAM_LISTENER, newLSC->name));
+
         PRBool found = PR_FALSE;
         for (int n = 0; n < lsList_.length(); n++)
         {
@@ -64,6 +64,8 @@ ParentAdmin::ParentAdmin(const PRInt32 nChildren)
 
     admHandle_ = -1;
     admFD_ = NULL;
+    admDev_ = 0;
+    admIno_ = 0;
     wdFD_ = NULL;
     nPollItems_ = 0;
     maxPollItems_ = nChildren_ * 2 + 18;
@@ -176,6 +178,13 @@ ParentAdmin::init(void)
 void
 ParentAdmin::unlinkAdminChannel(void)
 {
+    // Leave the path alone if a newer server generation has replaced our
+    // socket with its own
+    struct stat finfo;
+    if (stat(channelName_, &finfo) == 0 &&
+        (finfo.st_dev != admDev_ || finfo.st_ino != admIno_))
+        return;
+
     unlink(channelName_);
 }
 
@@ -243,6 +252,13 @@ ParentAdmin::createAdminChannel(void)
         umask(oldmask);
 #endif
 
+    // Remember which socket file is ours for unlinkAdminChannel
+    struct stat finfo;
+    if (stat(channelName_, &finfo) == 0) {
+        admDev_ = finfo.st_dev;
+        admIno_ = finfo.st_ino;
+    }
+
     status = listen(fd, nChildren_ * 2 + 18);
     if (status < 0)
     {
@@ -37,6 +37,7 @@
 #ifdef XP_UNIX
 
 #include <limits.h>                     // PATH_MAX
+#include <sys/types.h>                  // dev_t, ino_t
 #include "nspr.h"
 
 // Pre declaration of class.
@@ -81,7 +82,10 @@ class ParentAdmin
         virtual void initLate(void);
 
         /**
-         * Unlinks the admin channel Unix domain socket.
+         * Unlinks the admin channel Unix domain socket if it is still the
+         * one this process created.  During a hot upgrade the next server
+         * generation binds its own socket at the same path, and the
+         * retiring generation must not remove it.
          */
         void unlinkAdminChannel(void);
 
@@ -169,6 +173,13 @@ class ParentAdmin
          */
         PRFileDesc* admFD_;
 
+        /**
+         * Device and inode of the Unix domain socket file created by
+         * <code>createAdminChannel</code>.
+         */
+        dev_t admDev_;
+        ino_t admIno_;
+
         /**
          * <code>PRFileDesc*</code> equivalent of the handle corresponding
          * to the socket connection to the Watchdog (for use in 
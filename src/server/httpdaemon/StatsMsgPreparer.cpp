@@ -182,11 +182,9 @@ PRBool StatsMsgPreparer::prepareThreadSlotStats(StatsMsgBuff& msgbuff,
             continue;
         }
         if (nCurIndex == nIndex) {
-            // N.B. we must serialize access to the StatsThreadNode as the
-            // DaemonSession can update the requestBucket in realtime
-            threadNode->lock();
+            // N.B. getNodeData takes a consistent copy as the DaemonSession
+            // can update the requestBucket in realtime
             fSuccess = threadNode->getNodeData(msgbuff);
-            threadNode->unlock();
             break;
         }
         threadNode = threadNode->next;
@@ -2503,12 +2503,21 @@ WebServer::Reconfigure(void)
 
     WebServer::state_ = WebServer::WS_RECONFIGURING;
 
-    // Attempt to parse a new configuration
+    Configuration *outgoing = ConfigurationManager::getConfiguration();
+    PR_ASSERT(outgoing != NULL);
+
+    // Attempt to parse a new configuration, reusing whatever the outgoing
+    // configuration parsed from files that haven't changed since
+    PRIntervalTime epoch = PR_IntervalNow();
+    PRIntervalTime tparse = 0;
+    PRIntervalTime tbuild = 0;
     Configuration *incoming = NULL;
     try {
         ServerXML *incomingServerXML = ServerXML::parse(globals->vs_config_file);
+        tparse = PR_IntervalNow() - epoch;
         if (CheckNSS(incomingServerXML))
-            incoming = Configuration::create(incomingServerXML, PR_TRUE);
+            incoming = Configuration::create(incomingServerXML, PR_TRUE, outgoing);
+        tbuild = PR_IntervalNow() - epoch - tparse;
     } catch (const EreportableException& e) {
         ereport_exception(e);
     }
@@ -2517,17 +2526,26 @@ WebServer::Reconfigure(void)
 
     // Attempt to install the new configuration
     if (incoming != NULL) {
-        Configuration *outgoing = ConfigurationManager::getConfiguration();
-        PR_ASSERT(outgoing != NULL);
+        PRIntervalTime tinstall = PR_IntervalNow();
 
         rv = ConfigurationManager::setConfiguration(incoming);
         if (rv == PR_SUCCESS)
             ProcessConfiguration(incoming, outgoing);
 
-        outgoing->unref();
+        tinstall = PR_IntervalNow() - tinstall;
+
+        ereport(LOG_VERBOSE, "Reconfiguration took %u ms "
+                "(server.xml %u ms, build %u ms, install %u ms)",
+                PR_IntervalToMilliseconds(PR_IntervalNow() - epoch),
+                PR_IntervalToMilliseconds(tparse),
+                PR_IntervalToMilliseconds(tbuild),
+                PR_IntervalToMilliseconds(tinstall));
+
         incoming->unref();
     }
 
+    outgoing->unref();
+
     if (rv == PR_FAILURE)
         ereport(LOG_FAILURE, XP_GetAdminStr(DBT_ConfigurationManager_NotInstalled));
 
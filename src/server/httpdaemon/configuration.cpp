@@ -51,6 +51,7 @@
 #include "base/daemon.h"
 #include "base/ereport.h"
 #include "frame/conf.h"
+#include "frame/objset.h"
 #include "libaccess/aclproto.h" // ACL function prototypes
 #include "libaccess/aclerror.h" // aclErrorFmt prototype
 #include "libaccess/aclcache.h" // ACLCache object definition
@@ -67,6 +68,23 @@ using LIBXSD2CPP_NAMESPACE::CString;
 PRInt32 Configuration::ids = 0;
 PRInt32 Configuration::idInvalid = -1;
 
+//-----------------------------------------------------------------------------
+// ConfigurationFile
+//-----------------------------------------------------------------------------
+
+/**
+ * An obj.conf or ACL file parsed while building a Configuration.  The next
+ * Configuration reuses the parsed contents instead of parsing the file again
+ * if the file's size and modification time haven't changed.
+ */
+struct ConfigurationFile {
+    const char *filename;
+    PRFileInfo64 finfo;
+    PRBool stable; // PR_TRUE if finfo reliably identifies the contents
+    httpd_objset *objset;
+    ACLListHandle_t *acllist;
+};
+
 //-----------------------------------------------------------------------------
 // Configuration::parse
 //-----------------------------------------------------------------------------
@@ -81,25 +99,27 @@ Configuration *Configuration::parse()
 
     // Create a new Configuration based on the ServerXML object.  The
     // Configuration will assume ownership of the ServerXML object.
-    return new Configuration(serverXML, PR_TRUE);
+    return new Configuration(serverXML, PR_TRUE, NULL);
 }
 
 //-----------------------------------------------------------------------------
 // Configuration::create
 //-----------------------------------------------------------------------------
 
-Configuration *Configuration::create(ServerXML *serverXML, PRBool deleteServerXML)
+Configuration *Configuration::create(ServerXML *serverXML, PRBool deleteServerXML,
+                                     const Configuration *previous)
 {
     // Create a new Configuration based on the ServerXML object.  The
     // Configuration does not assume ownership of the ServerXML object.
-    return new Configuration(serverXML, deleteServerXML);
+    return new Configuration(serverXML, deleteServerXML, previous);
 }
 
 //-----------------------------------------------------------------------------
 // Configuration::Configuration
 //-----------------------------------------------------------------------------
 
-Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML)
+Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML,
+                             const Configuration *previous)
 : ServerXMLSchema::ServerWrapper(serverXML->server),
   ConfigurationObject(this),
   serverXML(serverXML),
@@ -109,14 +129,23 @@ Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML)
   pool(pool_create()),
   lscHash(0),
   vsHash(0),
+  objsetFiles(0),
+  aclFiles(0),
+  previous(previous),
+  countFilesReused(0),
   listener(0),
   aclcache(0)
 {
     // Post process the server.xml configuration
     try {
+        PRIntervalTime epoch = PR_IntervalNow();
+        PRIntervalTime tvs, tmime, tacl;
         int count;
         int i;
 
+        objsetFiles = new SimplePtrStringHash(findPrime(getVirtualServerCount() + 1));
+        aclFiles = new SimplePtrStringHash(251);
+
         // Hash variable names
         count = getVariableCount();
         for (i = 0; i < count; i++)
@@ -130,11 +159,18 @@ Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML)
                                                     pkcs11, this));
         }
 
-        // Instantiate a VirtualServer for each ServerXMLSchema::VirtualServer
+        // Instantiate a VirtualServer for each ServerXMLSchema::VirtualServer.
+        // XXX VirtualServers are not yet reused from the previous
+        // Configuration, even when unchanged.  A VirtualServer wraps this
+        // Configuration's server.xml DOM, is owned by this Configuration's
+        // ConfigurationObject tree and holds per-Configuration VSInitFunc
+        // user data.  Only the obj.conf and ACL files it uses are reused.
+        tvs = PR_IntervalNow();
         count = getVirtualServerCount();
         for (i = 0; i < count; i++) {
             vsVector.append(new VirtualServer(*getVirtualServer(i), this, this));
         }
+        tvs = PR_IntervalNow() - tvs;
 
         // Check for ListenSocketConfigs that have the same IP:port
         count = getLscCount();
@@ -242,7 +278,13 @@ Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML)
             }
         }
 
-        // Give VirtualServers a pointer to their MIME files
+        // Give VirtualServers a pointer to their MIME files.  Unlike obj.conf
+        // and ACL files, MIME files are parsed again for every Configuration:
+        // a MimeFile and its MimeTypes are ConfigurationObjects destroyed
+        // along with the Configuration that parsed them, so they can't be
+        // handed to the next one.  Each file is still parsed only once per
+        // Configuration however many VSs use it.
+        tmime = PR_IntervalNow();
         SimplePtrStringHash mimeFileHash(getMimeFileCount() + 1);
         count = getVSCount();
         for (i = 0; i < count; i++) {
@@ -265,12 +307,15 @@ Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML)
             }
         }
 
+        tmime = PR_IntervalNow() - tmime;
+
         // Set the name of the default ACL database.  This must be done after
         // we construct the configuration's AuthDbs (the AuthDb constructor
         // calls ACL_VirtualDbRegister) and before we parse its ACL files.
         ACL_DatabaseSetDefault(NULL, defaultAuthDbName);
 
         // construct ACLLists for the virtual servers
+        tacl = PR_IntervalNow();
         SimplePtrStringHash globalAclFileHash(251);
         count = getVSCount();
         for (i = 0; i < count; i++) {
@@ -329,6 +374,7 @@ Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML)
             // copy the pointers over to the vs
             vs->setACLList(aclroot);
         }
+        tacl = PR_IntervalNow() - tacl;
 
         // create an ACL cache for this configuration
         // if "acl-cache" is enabled, then only create ACLCache object
@@ -336,6 +382,20 @@ Configuration::Configuration(ServerXML *serverXML, PRBool deleteServerXML)
             aclcache = new ACLCache();
         } else 
             aclcache = NULL;
+
+        ereport(LOG_VERBOSE, "Built configuration %d in %u ms "
+                "(virtual servers %u ms, MIME types %u ms, ACLs %u ms, "
+                "%d of %d obj.conf and ACL files reused)",
+                id,
+                PR_IntervalToMilliseconds(PR_IntervalNow() - epoch),
+                PR_IntervalToMilliseconds(tvs),
+                PR_IntervalToMilliseconds(tmime),
+                PR_IntervalToMilliseconds(tacl),
+                countFilesReused, fileVector.length());
+
+        // Parsed files from the previous Configuration are only borrowed
+        // while we're being built
+        this->previous = NULL;
     }
     catch (const EreportableException& e) {
         cleanup();
@@ -369,9 +429,21 @@ void Configuration::cleanup()
         delete lscHash;
     if (vsHash)
         delete vsHash;
+    if (objsetFiles)
+        delete objsetFiles;
+    if (aclFiles)
+        delete aclFiles;
     if (aclcache)
         delete aclcache;
 
+    // Destroy the objset templates; ACLLists were released above
+    for (i = 0; i < fileVector.length(); i++) {
+        ConfigurationFile *file = (ConfigurationFile *)fileVector[i];
+        if (file->objset)
+            objset_free(file->objset);
+        delete file;
+    }
+
     // We need to destroy all descendent ConfigurationObjects before we destroy
     // the pool as some may have allocated memory from the pool
     destroyChildren();
@@ -472,22 +544,34 @@ ACLListHandle_t *Configuration::parseACLFile(ServerXMLSchema::String& aclFile,
     // If we haven't yet parsed this ACL file...
     ACLListHandle_t *acllist = (ACLListHandle_t *)aclFileHash.lookup((void*)filename);
     if (acllist == NULL) {
-        NSErr_t err = NSERRINIT;
+        ConfigurationFile *file = addFile(aclFiles, filename);
+
+        // A parsed ACLList doesn't depend on the rest of the configuration,
+        // so if the file hasn't changed we can share the previous one
+        const ConfigurationFile *previousFile = findPreviousFile(file, PR_TRUE);
+        if (previousFile) {
+            acllist = previousFile->acllist;
+            ACL_ListIncrement(0, acllist);
+            countFilesReused++;
+        } else {
+            NSErr_t err = NSERRINIT;
 
-        // Parse the ACL file
-        acllist = ACL_ParseFile(&err, (char *)filename);
-        if (acllist == NULL)
-            throw ConfigurationServerXMLException(aclFile, XP_GetAdminStr(DBT_Configuration_CannotParseAclFile), &err);
+            // Parse the ACL file
+            acllist = ACL_ParseFile(&err, (char *)filename);
+            if (acllist == NULL)
+                throw ConfigurationServerXMLException(aclFile, XP_GetAdminStr(DBT_Configuration_CannotParseAclFile), &err);
 
-        // Put method indices into the ACL expression structures...
-        if (ACL_ListPostParseForAuth(&err, acllist)) {
-            ACL_ListDecrement(0, acllist);
-            throw ConfigurationServerXMLException(aclFile, XP_GetAdminStr(DBT_Configuration_CannotPostParseAcls), &err);
-        }
+            // Put method indices into the ACL expression structures...
+            if (ACL_ListPostParseForAuth(&err, acllist)) {
+                ACL_ListDecrement(0, acllist);
+                throw ConfigurationServerXMLException(aclFile, XP_GetAdminStr(DBT_Configuration_CannotPostParseAcls), &err);
+            }
 
-        nserrDispose(&err);
+            nserrDispose(&err);
+        }
 
         // Remember the ACLList's ACLListHandle_t
+        file->acllist = acllist;
         aclListVector.append(acllist);
         aclFileHash.insert((void*)filename, (void*)acllist);
     }
@@ -495,6 +579,98 @@ ACLListHandle_t *Configuration::parseACLFile(ServerXMLSchema::String& aclFile,
     return acllist;
 }
 
+//-----------------------------------------------------------------------------
+// Configuration::getObjsetTemplate
+//-----------------------------------------------------------------------------
+
+const httpd_objset *Configuration::getObjsetTemplate(const char *filename)
+{
+    ConfigurationFile *file = (ConfigurationFile *)objsetFiles->lookup((void*)filename);
+    if (file == NULL) {
+        file = addFile(objsetFiles, filename);
+
+        // Copying the previous Configuration's objset is much cheaper than
+        // tokenizing the file and looking up all its SAFs again
+        const ConfigurationFile *previousFile = findPreviousFile(file, PR_FALSE);
+        if (previousFile) {
+            file->objset = objset_dup(previousFile->objset);
+            if (file->objset)
+                countFilesReused++;
+        }
+        // Otherwise prefer a snapshot of the file's previous parse
+        if (!file->objset) {
+            if (conf_getboolean("ObjsetSnapshot", PR_TRUE)) {
+                // Keep the snapshots in the instance directory so they
+                // survive a restart; the watchdog removes the temporary
+                // directory when the server exits
+                NSString snapdir;
+                snapdir.printf("%s/%s/objsnap",
+                               conf_get_true_globals()->Vserver_root,
+                               conf_get_true_globals()->Vserver_id);
+                file->objset = objset_load_snapshot(filename, snapdir);
+            } else {
+                file->objset = objset_load(filename, NULL);
+            }
+        }
+    }
+
+    return file->objset;
+}
+
+//-----------------------------------------------------------------------------
+// Configuration::addFile
+//-----------------------------------------------------------------------------
+
+ConfigurationFile *Configuration::addFile(SimplePtrStringHash *hash,
+                                          const char *filename)
+{
+    ConfigurationFile *file = new ConfigurationFile;
+    file->filename = filename;
+    file->objset = NULL;
+    file->acllist = NULL;
+
+    // Record the file's identity before we parse it.  A file modified within
+    // the last couple of seconds may be modified again without its timestamp
+    // changing, so don't let the next Configuration trust such a file.
+    file->stable = PR_FALSE;
+    if (PR_GetFileInfo64(filename, &file->finfo) == PR_SUCCESS) {
+        if (PR_Now() - file->finfo.modifyTime >= 2 * PR_USEC_PER_SEC)
+            file->stable = PR_TRUE;
+    }
+
+    fileVector.append(file);
+    hash->insert((void*)filename, (void*)file);
+
+    return file;
+}
+
+//-----------------------------------------------------------------------------
+// Configuration::findPreviousFile
+//-----------------------------------------------------------------------------
+
+const ConfigurationFile *Configuration::findPreviousFile(const ConfigurationFile *file,
+                                                         PRBool acl) const
+{
+    if (!previous || !file->stable)
+        return NULL;
+
+    SimplePtrStringHash *hash = acl ? previous->aclFiles : previous->objsetFiles;
+    if (!hash)
+        return NULL;
+
+    const ConfigurationFile *previousFile = (const ConfigurationFile *)hash->lookup((void*)file->filename);
+    if (!previousFile || !previousFile->stable)
+        return NULL;
+    if (acl ? !previousFile->acllist : !previousFile->objset)
+        return NULL;
+    if (previousFile->finfo.size != file->finfo.size ||
+        previousFile->finfo.modifyTime != file->finfo.modifyTime ||
+        previousFile->finfo.creationTime != file->finfo.creationTime)
+        return NULL;
+
+    return previousFile;
+}
+
 //-----------------------------------------------------------------------------
 // Configuration::getLscCount
 //-----------------------------------------------------------------------------
@@ -53,6 +53,7 @@ class Configuration;
 class ConfigurationListener;
 class MimeFile;
 class ACLCache;
+struct ConfigurationFile;
 
 //-----------------------------------------------------------------------------
 // ConfigurationServerXMLException
@@ -260,10 +261,13 @@ public:
      * Construct a new Configuration from a previously parsed ServerXML.  If
      * deleteServerXML is PR_TRUE, the Configuration assumes ownership of the
      * passed ServerXML *.  Otherwise, the caller is responsible for deleting
-     * the passed ServerXML after the Configuration is destroyed.  Throws
+     * the passed ServerXML after the Configuration is destroyed.  If a
+     * previous Configuration is passed, obj.conf and ACL files that have not
+     * changed since it was built are reused rather than parsed again.  Throws
      * EreportableException on error.  Never returns a NULL Configuration *.
      */
-    static Configuration *create(ServerXML *serverXML, PRBool deleteServerXML);
+    static Configuration *create(ServerXML *serverXML, PRBool deleteServerXML,
+                                 const Configuration *previous = NULL);
 
     /**
      * Return this Configuration's unique ID.
@@ -345,6 +349,14 @@ public:
      */
     const VirtualServer *getVS(const char* id) const;
 
+    /**
+     * Return the objset parsed from the named obj.conf file.  Each file is
+     * parsed once per Configuration.  The returned objset is shared and must
+     * be copied with objset_dup() before it is modified.  Returns NULL if the
+     * file could not be parsed.
+     */
+    const httpd_objset *getObjsetTemplate(const char *filename);
+
     /**
      * Return a reference to the server variables.
      */
@@ -376,7 +388,8 @@ private:
     /**
      * Instantiate a Configuration.
      */
-    Configuration(ServerXML *serverXML, PRBool deleteServerXML);
+    Configuration(ServerXML *serverXML, PRBool deleteServerXML,
+                  const Configuration *previous);
 
     /**
      * Copy constructor is undefined.
@@ -394,6 +407,8 @@ private:
     void cleanup();
     MimeFile *parseMIMEFile(ServerXMLSchema::String& mimeFile, SimplePtrStringHash& mimeFileHash);
     ACLListHandle_t *parseACLFile(ServerXMLSchema::String& aclFile, SimplePtrStringHash& aclFileHash);
+    ConfigurationFile *addFile(SimplePtrStringHash *hash, const char *filename);
+    const ConfigurationFile *findPreviousFile(const ConfigurationFile *file, PRBool acl) const;
 
     ServerXML *serverXML;
     PRBool deleteServerXML;
@@ -405,6 +420,11 @@ private:
     SimplePtrStringHash *lscHash;
     SimplePtrStringHash *vsHash;
     GenericVector aclListVector;
+    GenericVector fileVector;
+    SimplePtrStringHash *objsetFiles;
+    SimplePtrStringHash *aclFiles;
+    const Configuration *previous;
+    int countFilesReused;
     ConfigurationListener *listener;
     NVPairs serverVars;
     ACLCache *aclcache;
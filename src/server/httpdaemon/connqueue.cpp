@@ -43,6 +43,7 @@
 #include "httpdaemon/statsmanager.h"
 #include "httpdaemon/ListenSocket.h"
 #include "httpdaemon/httpheader.h"
+#include "httpdaemon/http2session.h"
 #include "time/nstime.h"
 #include "frame/conf_api.h"
 #include "private/pprio.h"
@@ -393,6 +394,7 @@ ConnectionQueue::logOverflow() {
 Connection::Connection()
 {
     connQueue = NULL;
+    http2 = NULL;
     async.inbuf.buf = NULL;
     async.inbuf.cursize = 0;
     async.inbuf.maxsize = 0;
@@ -413,6 +415,7 @@ PRStatus Connection::create(PRFileDesc* fd_, const PRNetAddr *addr, ListenSocket
     fSSLEnabled = PR_FALSE;
     fUncleanShutdown = PR_FALSE;
     fKeepAliveReservation = PR_FALSE;
+    fHttp2Stream = PR_FALSE;
 
     // get a ListenSocketConfig reference
     lsConfig = ls_->getConfig();
@@ -453,6 +456,33 @@ PRStatus Connection::create(PRFileDesc* fd_, const PRNetAddr *addr, ListenSocket
     return PR_SUCCESS;
 }
 
+void Connection::createStream(PRFileDesc* fd_, const Connection* parent)
+{
+    fd = fd_;
+    fNewlyAccepted = PR_FALSE;
+    fSSLEnabled = parent->fSSLEnabled;
+    fUncleanShutdown = PR_FALSE;
+    fKeepAliveReservation = PR_FALSE;
+    fHttp2Stream = PR_TRUE;
+
+    // the stream shares the parent connection's socket and configuration
+    lsConfig = parent->lsConfig;
+    lsConfig->ref();
+    sslconfig = parent->sslconfig;
+    net_addr_copy(&remoteAddress, &parent->remoteAddress);
+    localAddress = parent->localAddress;
+    remoteIP = parent->remoteIP;
+
+#ifdef HAS_ASYNC_ACCELERATOR
+    // responses have to go through the stream IO layer
+    async.fd = -1;
+    async.inbuf.cursize = 0;
+#endif
+
+    PRInt32 peakNew = PR_AtomicIncrement(&countActive);
+    while (peakNew > peakActive) peakNew = PR_AtomicSet(&peakActive, peakNew);
+}
+
 void Connection::destroy()
 {
     // No more HTTP-level traffic on the socket
@@ -466,6 +496,11 @@ void Connection::destroy()
     PR_ASSERT(!async.accel.headers.p);
 #endif
 
+    if (http2) {
+        delete http2;
+        http2 = NULL;
+    }
+
     if (fd) {
         PR_Close(fd);
         fd = NULL;
@@ -487,12 +522,22 @@ void Connection::enableSSL()
     if (sslconfig) {
         sslconfig->enable(fd);
         fSSLEnabled = PR_TRUE;
+
+#ifdef SSL_ENABLE_ALPN
+        // HTTP/2 streams are run by DaemonSessions from the thread pool, so
+        // don't offer h2 without one
+        if (!connQueue)
+            SSL_OptionSet(fd, SSL_ENABLE_ALPN, PR_FALSE);
+#endif
     }
 }
 
+// The SSL session of a stream's connection belongs to the HTTP/2 connection
+// it's a stream of, so abort(), timeout() and done() leave it alone
+
 void Connection::abort()
 {
-    if (fd && fSSLEnabled) {
+    if (fd && fSSLEnabled && !fHttp2Stream) {
         // Unconditionally suppress the SSLv3 close notify
         SSL_OptionSet(fd, SSL_SECURITY, PR_FALSE);
     }
@@ -500,7 +545,7 @@ void Connection::abort()
 
 void Connection::timeout()
 {
-    if (fd && fSSLEnabled && !fUncleanShutdown) {
+    if (fd && fSSLEnabled && !fUncleanShutdown && !fHttp2Stream) {
         // Tell NSS not to block trying to send the SSLv3 close notify alert
         PR_Send(fd, "", 0, 0, PR_INTERVAL_NO_WAIT);
     }
@@ -508,7 +553,7 @@ void Connection::timeout()
 
 void Connection::done()
 {
-    if (fd && fSSLEnabled && fUncleanShutdown) {
+    if (fd && fSSLEnabled && fUncleanShutdown && !fHttp2Stream) {
         // Suppress the SSLv3 close notify alert to keep MSIE happy
         SSL_OptionSet(fd, SSL_SECURITY, PR_FALSE);
     }
@@ -44,6 +44,7 @@
 class HttpHeader;
 class ListenSocket;
 class ConnectionQueue;
+class Http2Session;
 
 extern "C" void ConnectionQueueClock(void* context);
 
@@ -101,6 +102,12 @@ class Connection
      */
     PRStatus create(PRFileDesc* fd, const PRNetAddr *addr, ListenSocket* ls);
 
+    /**
+     * Record the creation of a connection for one of the streams of an
+     * HTTP/2 connection.  fd is the stream's IO layer.
+     */
+    void createStream(PRFileDesc* fd, const Connection* parent);
+
     /**
      * Close the connection
      */
@@ -220,6 +227,11 @@ class Connection
      */
     ConnectionAsync async;
 
+    /**
+     * HTTP/2 state if the connection speaks HTTP/2, otherwise NULL
+     */
+    Http2Session *http2;
+
     /**
      * Miscellaneous connection-related flags
      */
@@ -227,6 +239,7 @@ class Connection
     unsigned fSSLEnabled : 1;
     unsigned fUncleanShutdown : 1;
     unsigned fKeepAliveReservation : 1;
+    unsigned fHttp2Stream : 1;
 };
 
 /**
@@ -42,6 +42,8 @@ endif
 DAEMONOBJS+=daemonsession
 DAEMONOBJS+=httprequest
 DAEMONOBJS+=httpheader
+DAEMONOBJS+=http2session
+DAEMONOBJS+=hpack
 DAEMONOBJS+=HttpMethodRegistry
 DAEMONOBJS+=pollarray
 DAEMONOBJS+=kapollthr
@@ -59,6 +61,7 @@ DAEMONOBJS+=ListenSocketConfigHash
 DAEMONOBJS+=vsconf
 DAEMONOBJS+=servername
 DAEMONOBJS+=mime
+DAEMONOBJS+=mimeindex
 DAEMONOBJS+=AuthDb
 DAEMONOBJS+=statsutil
 DAEMONOBJS+=statsnodes
@@ -68,6 +71,7 @@ DAEMONOBJS+=statsavg
 DAEMONOBJS+=statsmanager
 DAEMONOBJS+=StatsMsgPreparer
 DAEMONOBJS+=statssession
+DAEMONOBJS+=statscounters
 DAEMONOBJS+=statsbkupmgr
 DAEMONOBJS+=StatsClient
 DAEMONOBJS+=throttling
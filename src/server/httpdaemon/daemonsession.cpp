@@ -55,6 +55,7 @@
 
 #include "httpdaemon/daemonsession.h"
 #include "httpdaemon/httprequest.h"
+#include "httpdaemon/http2session.h"
 #include "httpdaemon/dbthttpdaemon.h"
 #include "httpdaemon/connqueue.h"
 #include "httpdaemon/WebServer.h"                // WebServer::isTerminating()
@@ -579,7 +580,8 @@ DaemonSession::GetConnection(void)
         }
     }
 
-    if (!flagNew) recordKeepaliveHit();
+    // A stream of an HTTP/2 connection is never in keep-alive
+    if (!flagNew && !conn->fHttp2Stream) recordKeepaliveHit();
 
     inbuf->sd = conn->fd;
     inbuf->pos = 0;
@@ -643,20 +645,39 @@ DaemonSession::run(void)
             if (inbuf->cursize <= 0)
                 break;
 
-            // Figure out how much longer we can wait for the request header
-            PRIntervalTime timeout = rqHdrTimeoutInterval_;
-            if (timeout != PR_INTERVAL_NO_TIMEOUT) {
-                PRIntervalTime elapsed = conn->elapsed();
-                if (timeout > elapsed) {
-                    timeout -= elapsed;
-                } else {
-                    timeout = 0;
-                }
+            // Clients with prior knowledge start with the HTTP/2 preface
+            if (!conn->http2 && Http2Session::IsPreface(conn, inbuf)) {
+                conn->http2 = Http2Session::Create(conn);
+                if (!conn->http2)
+                    break;
             }
 
-            // HttpRequest::HandleRequest will call RequestKeepAlive() to set
-            // conn->fKeepAlive as appropriate
-            PRBool fSocketOpen = request_->HandleRequest(inbuf, timeout);
+            PRBool fSocketOpen;
+            if (conn->http2) {
+                // Http2Session::HandleFrames will call RequestKeepAlive()
+                // once the connection is idle
+                fSocketOpen = conn->http2->HandleFrames(this, inbuf);
+            } else {
+                // Figure out how much longer we can wait for the request header
+                PRIntervalTime timeout = rqHdrTimeoutInterval_;
+                if (timeout != PR_INTERVAL_NO_TIMEOUT) {
+                    PRIntervalTime elapsed = conn->elapsed();
+                    if (timeout > elapsed) {
+                        timeout -= elapsed;
+                    } else {
+                        timeout = 0;
+                    }
+                }
+
+                // HttpRequest::HandleRequest will call RequestKeepAlive() to set
+                // conn->fKeepAlive as appropriate
+                fSocketOpen = request_->HandleRequest(inbuf, timeout);
+
+                // HttpRequest::HandleRequest sets conn->http2 if it switched
+                // the connection to HTTP/2 with an h2c upgrade
+                if (fSocketOpen && conn->http2)
+                    fSocketOpen = conn->http2->HandleFrames(this, inbuf);
+            }
             if (fSocketOpen == PR_FALSE) {
                 conn->fd = NULL;
                 break;
@@ -861,7 +882,9 @@ DaemonSession::HandleKeepAlive(void)
 PRBool
 DaemonSession::RequestKeepAlive(PRBool fKeepAlive)
 {
-    if (pollManager_) {
+    // A stream of an HTTP/2 connection ends with its request; the connection
+    // it belongs to is what's kept alive
+    if (pollManager_ && !conn->fHttp2Stream) {
         if (fKeepAlive) {
             if (!conn->fKeepAliveReservation) {
                 // Ask keep-alive subsystem for a keep-alive "reservation"
@@ -0,0 +1,725 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * hpack.cpp: HPACK header compression for HTTP/2 (RFC 7541)
+ */
+
+#include <string.h>
+
+#include "netsite.h"
+#include "httpdaemon/hpack.h"
+
+// Size overhead the RFC charges for each dynamic table entry
+#define HPACK_ENTRY_OVERHEAD 32
+
+// Number of entries in the static table
+#define HPACK_STATIC_COUNT 61
+
+struct HpackStaticEntry {
+    const char *name;
+    int nlen;
+    const char *value;
+    int vlen;
+};
+
+#define HPACK_STATIC(n, v) { n, sizeof(n) - 1, v, sizeof(v) - 1 }
+
+// RFC 7541 Appendix A
+static const HpackStaticEntry hpack_static_table[HPACK_STATIC_COUNT] = {
+    HPACK_STATIC(":authority", ""),
+    HPACK_STATIC(":method", "GET"),
+    HPACK_STATIC(":method", "POST"),
+    HPACK_STATIC(":path", "/"),
+    HPACK_STATIC(":path", "/index.html"),
+    HPACK_STATIC(":scheme", "http"),
+    HPACK_STATIC(":scheme", "https"),
+    HPACK_STATIC(":status", "200"),
+    HPACK_STATIC(":status", "204"),
+    HPACK_STATIC(":status", "206"),
+    HPACK_STATIC(":status", "304"),
+    HPACK_STATIC(":status", "400"),
+    HPACK_STATIC(":status", "404"),
+    HPACK_STATIC(":status", "500"),
+    HPACK_STATIC("accept-charset", ""),
+    HPACK_STATIC("accept-encoding", "gzip, deflate"),
+    HPACK_STATIC("accept-language", ""),
+    HPACK_STATIC("accept-ranges", ""),
+    HPACK_STATIC("accept", ""),
+    HPACK_STATIC("access-control-allow-origin", ""),
+    HPACK_STATIC("age", ""),
+    HPACK_STATIC("allow", ""),
+    HPACK_STATIC("authorization", ""),
+    HPACK_STATIC("cache-control", ""),
+    HPACK_STATIC("content-disposition", ""),
+    HPACK_STATIC("content-encoding", ""),
+    HPACK_STATIC("content-language", ""),
+    HPACK_STATIC("content-length", ""),
+    HPACK_STATIC("content-location", ""),
+    HPACK_STATIC("content-range", ""),
+    HPACK_STATIC("content-type", ""),
+    HPACK_STATIC("cookie", ""),
+    HPACK_STATIC("date", ""),
+    HPACK_STATIC("etag", ""),
+    HPACK_STATIC("expect", ""),
+    HPACK_STATIC("expires", ""),
+    HPACK_STATIC("from", ""),
+    HPACK_STATIC("host", ""),
+    HPACK_STATIC("if-match", ""),
+    HPACK_STATIC("if-modified-since", ""),
+    HPACK_STATIC("if-none-match", ""),
+    HPACK_STATIC("if-range", ""),
+    HPACK_STATIC("if-unmodified-since", ""),
+    HPACK_STATIC("last-modified", ""),
+    HPACK_STATIC("link", ""),
+    HPACK_STATIC("location", ""),
+    HPACK_STATIC("max-forwards", ""),
+    HPACK_STATIC("proxy-authenticate", ""),
+    HPACK_STATIC("proxy-authorization", ""),
+    HPACK_STATIC("range", ""),
+    HPACK_STATIC("referer", ""),
+    HPACK_STATIC("refresh", ""),
+    HPACK_STATIC("retry-after", ""),
+    HPACK_STATIC("server", ""),
+    HPACK_STATIC("set-cookie", ""),
+    HPACK_STATIC("strict-transport-security", ""),
+    HPACK_STATIC("transfer-encoding", ""),
+    HPACK_STATIC("user-agent", ""),
+    HPACK_STATIC("vary", ""),
+    HPACK_STATIC("via", ""),
+    HPACK_STATIC("www-authenticate", "")
+};
+
+// Response header fields whose values rarely repeat.  Indexing them would
+// only push more useful entries out of the peer's dynamic table.
+static const char * const hpack_unindexed[] = {
+    "content-length",
+    "content-range",
+    "etag",
+    "last-modified",
+    "location",
+    "set-cookie",
+    NULL
+};
+
+// Number of codes of each length in bits (codes are 5 to 30 bits long)
+static const PRUint8 hpack_huffman_counts[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4
+};
+
+// Symbols in code order (shortest first, ties broken by symbol value)
+static const PRUint16 hpack_huffman_symbols[257] = {
+     48,  49,  50,  97,  99, 101, 105, 111, 115, 116,  32,  37,
+     45,  46,  47,  51,  52,  53,  54,  55,  56,  57,  61,  65,
+     95,  98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+     58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+     77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  89,
+    106, 107, 113, 118, 119, 120, 121, 122,  38,  42,  44,  59,
+     88,  90,  33,  34,  40,  41,  63,  39,  43, 124,  35,  62,
+      0,  36,  64,  91,  93, 126,  94, 125,  60,  96, 123,  92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+    167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+    132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+    173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233,   1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+    151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+    183, 188, 191, 197, 231, 239,   9, 142, 144, 145, 148, 159,
+    171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+    255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+    246, 247, 248, 250, 251, 252, 253, 254,   2,   3,   4,   5,
+      6,   7,   8,  11,  12,  14,  15,  16,  17,  18,  19,  20,
+     21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220,
+    249,  10,  13,  22, 256
+};
+
+
+/* ------------------------- hpack_huffman_decode ------------------------- */
+
+int hpack_huffman_decode(const unsigned char *in, int len, char *out)
+{
+    // The code is canonical, so the codes of each length are consecutive
+    // integers that follow on from the codes one bit shorter.  We walk down
+    // the lengths a bit at a time, tracking the first code of the current
+    // length and where its symbols start in hpack_huffman_symbols.
+    char *o = out;
+    PRUint32 code = 0;
+    PRUint32 first = 0;
+    int clen = 0;
+    int index = 0;
+
+    for (int i = 0; i < len; i++) {
+        unsigned c = in[i];
+        for (int bit = 7; bit >= 0; bit--) {
+            code = (code << 1) | ((c >> bit) & 1);
+            first <<= 1;
+            clen++;
+            if (clen > 30)
+                return -1;
+
+            PRUint32 n = hpack_huffman_counts[clen];
+            if (code - first < n) {
+                int sym = hpack_huffman_symbols[index + code - first];
+                if (sym == 256)
+                    return -1; // EOS must not appear in the data
+                *o++ = sym;
+                code = 0;
+                first = 0;
+                clen = 0;
+                index = 0;
+            } else {
+                first += n;
+                index += n;
+            }
+        }
+    }
+
+    // Any padding must be the most significant bits of EOS (all ones) and
+    // must be shorter than a byte
+    if (clen > 7 || code != (1U << clen) - 1)
+        return -1;
+
+    return o - out;
+}
+
+
+/* ------------------------- hpack_decode_integer ------------------------- */
+
+static inline PRBool hpack_decode_integer(const unsigned char **pp,
+                                          const unsigned char *end,
+                                          int prefix,
+                                          PRUint32 *pv)
+{
+    const unsigned char *p = *pp;
+    if (p == end)
+        return PR_FALSE;
+
+    PRUint32 mask = (1 << prefix) - 1;
+    PRUint32 v = *p++ & mask;
+    if (v == mask) {
+        // We don't need values anywhere near 2^28, so anything longer than
+        // four continuation bytes is an error
+        int shift = 0;
+        unsigned char b;
+        do {
+            if (p == end || shift > 21)
+                return PR_FALSE;
+            b = *p++;
+            v += (PRUint32) (b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+    }
+
+    *pp = p;
+    *pv = v;
+
+    return PR_TRUE;
+}
+
+
+/* ------------------------- hpack_encode_integer ------------------------- */
+
+static inline unsigned char *hpack_encode_integer(unsigned char *p,
+                                                  unsigned char first,
+                                                  int prefix,
+                                                  PRUint32 v)
+{
+    PRUint32 mask = (1 << prefix) - 1;
+    if (v < mask) {
+        *p++ = first | v;
+    } else {
+        *p++ = first | mask;
+        v -= mask;
+        while (v >= 0x80) {
+            *p++ = (v & 0x7f) | 0x80;
+            v >>= 7;
+        }
+        *p++ = v;
+    }
+
+    return p;
+}
+
+
+/* ------------------------- hpack_encode_string -------------------------- */
+
+static inline unsigned char *hpack_encode_string(unsigned char *p,
+                                                 const char *s,
+                                                 int len)
+{
+    p = hpack_encode_integer(p, 0x00, 7, len);
+    memcpy(p, s, len);
+
+    return p + len;
+}
+
+
+//-----------------------------------------------------------------------------
+// HpackTable::HpackTable
+//-----------------------------------------------------------------------------
+
+HpackTable::HpackTable()
+: ring(NULL),
+  capacity(0),
+  head(0),
+  count(0),
+  size(0),
+  maxSize(HPACK_DEFAULT_TABLE_SIZE)
+{ }
+
+//-----------------------------------------------------------------------------
+// HpackTable::~HpackTable
+//-----------------------------------------------------------------------------
+
+HpackTable::~HpackTable()
+{
+    while (count)
+        Evict();
+    if (ring)
+        PERM_FREE(ring);
+}
+
+//-----------------------------------------------------------------------------
+// HpackTable::Evict
+//-----------------------------------------------------------------------------
+
+void HpackTable::Evict()
+{
+    PR_ASSERT(count > 0);
+
+    Entry *e = &ring[(head + count - 1) % capacity];
+    size -= e->nlen + e->vlen + HPACK_ENTRY_OVERHEAD;
+    PERM_FREE(e->p);
+    e->p = NULL;
+    count--;
+}
+
+//-----------------------------------------------------------------------------
+// HpackTable::Resize
+//-----------------------------------------------------------------------------
+
+void HpackTable::Resize(PRUint32 newMaxSize)
+{
+    maxSize = newMaxSize;
+    while (size > maxSize)
+        Evict();
+}
+
+//-----------------------------------------------------------------------------
+// HpackTable::Add
+//-----------------------------------------------------------------------------
+
+PRStatus HpackTable::Add(const char *name, int nlen, const char *value, int vlen)
+{
+    PRUint32 esize = nlen + vlen + HPACK_ENTRY_OVERHEAD;
+    if (esize > maxSize) {
+        // Adding an entry larger than the table empties it
+        while (count)
+            Evict();
+        return PR_SUCCESS;
+    }
+
+    // Copy before evicting as name or value may point into an entry that's
+    // about to be evicted
+    char *p = (char *) PERM_MALLOC(nlen + vlen + 1);
+    if (!p)
+        return PR_FAILURE;
+    memcpy(p, name, nlen);
+    memcpy(p + nlen, value, vlen);
+
+    // Every entry costs at least HPACK_ENTRY_OVERHEAD, so that bounds how
+    // many entries the ring must hold
+    PRUint32 needed = maxSize / HPACK_ENTRY_OVERHEAD + 1;
+    if (capacity < needed) {
+        Entry *newRing = (Entry *) PERM_MALLOC(needed * sizeof(Entry));
+        if (!newRing) {
+            PERM_FREE(p);
+            return PR_FAILURE;
+        }
+        for (PRUint32 i = 0; i < count; i++)
+            newRing[i] = ring[(head + i) % capacity];
+        if (ring)
+            PERM_FREE(ring);
+        ring = newRing;
+        capacity = needed;
+        head = 0;
+    }
+
+    while (size + esize > maxSize)
+        Evict();
+
+    head = (head + capacity - 1) % capacity;
+    ring[head].p = p;
+    ring[head].nlen = nlen;
+    ring[head].vlen = vlen;
+    count++;
+    size += esize;
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// HpackTable::Get
+//-----------------------------------------------------------------------------
+
+PRBool HpackTable::Get(PRUint32 i,
+                       const char **name, int *nlen,
+                       const char **value, int *vlen) const
+{
+    if (i >= count)
+        return PR_FALSE;
+
+    const Entry *e = &ring[(head + i) % capacity];
+    *name = e->p;
+    *nlen = e->nlen;
+    *value = e->p + e->nlen;
+    *vlen = e->vlen;
+
+    return PR_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// HpackTable::Find
+//-----------------------------------------------------------------------------
+
+int HpackTable::Find(const char *name, int nlen, const char *value, int vlen,
+                     int *nameOnly) const
+{
+    *nameOnly = -1;
+
+    for (PRUint32 i = 0; i < count; i++) {
+        const Entry *e = &ring[(head + i) % capacity];
+        if (e->nlen == nlen && !memcmp(e->p, name, nlen)) {
+            if (e->vlen == vlen && !memcmp(e->p + nlen, value, vlen))
+                return i;
+            if (*nameOnly == -1)
+                *nameOnly = i;
+        }
+    }
+
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+// HpackDecoder::HpackDecoder
+//-----------------------------------------------------------------------------
+
+HpackDecoder::HpackDecoder()
+: maxTableSize(HPACK_DEFAULT_TABLE_SIZE),
+  scratch(NULL),
+  scratchSize(0),
+  scratchUsed(0)
+{ }
+
+//-----------------------------------------------------------------------------
+// HpackDecoder::~HpackDecoder
+//-----------------------------------------------------------------------------
+
+HpackDecoder::~HpackDecoder()
+{
+    if (scratch)
+        PERM_FREE(scratch);
+}
+
+//-----------------------------------------------------------------------------
+// HpackDecoder::SetMaxTableSize
+//-----------------------------------------------------------------------------
+
+void HpackDecoder::SetMaxTableSize(PRUint32 size)
+{
+    maxTableSize = size;
+    if (table.GetMaxSize() > size)
+        table.Resize(size);
+}
+
+//-----------------------------------------------------------------------------
+// HpackDecoder::DecodeString
+//-----------------------------------------------------------------------------
+
+PRStatus HpackDecoder::DecodeString(const unsigned char **pp,
+                                    const unsigned char *end,
+                                    const char **str, int *len)
+{
+    const unsigned char *p = *pp;
+    if (p == end)
+        return PR_FAILURE;
+
+    PRBool fHuffman = (*p & 0x80) != 0;
+
+    PRUint32 n;
+    if (!hpack_decode_integer(&p, end, 7, &n))
+        return PR_FAILURE;
+    if (n > (PRUint32) (end - p))
+        return PR_FAILURE;
+
+    if (fHuffman) {
+        // Decode uses the scratch space Decode reserved for the whole block
+        char *out = scratch + scratchUsed;
+        int rv = hpack_huffman_decode(p, n, out);
+        if (rv < 0)
+            return PR_FAILURE;
+        scratchUsed += rv;
+        *str = out;
+        *len = rv;
+    } else {
+        *str = (const char *) p;
+        *len = n;
+    }
+
+    *pp = p + n;
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// HpackDecoder::Decode
+//-----------------------------------------------------------------------------
+
+PRStatus HpackDecoder::Decode(const unsigned char *block, int len,
+                              HpackHeaderFn fn, void *context)
+{
+    // Huffman codes are at least 5 bits, so no block decodes to more than
+    // 8/5 of its length.  Reserving that up front means strings decoded into
+    // the scratch space never move.
+    int needed = len / 5 * 8 + 8;
+    if (scratchSize < needed) {
+        char *newScratch = (char *) PERM_MALLOC(needed);
+        if (!newScratch)
+            return PR_FAILURE;
+        if (scratch)
+            PERM_FREE(scratch);
+        scratch = newScratch;
+        scratchSize = needed;
+    }
+
+    const unsigned char *p = block;
+    const unsigned char *end = block + len;
+    PRBool fFirst = PR_TRUE;
+
+    while (p < end) {
+        const char *name;
+        int nlen;
+        const char *value;
+        int vlen;
+        PRUint32 index;
+        PRBool fIndex = PR_FALSE;
+
+        scratchUsed = 0;
+
+        if (*p & 0x80) {
+            // Indexed header field
+            if (!hpack_decode_integer(&p, end, 7, &index) || index == 0)
+                return PR_FAILURE;
+            if (index <= HPACK_STATIC_COUNT) {
+                const HpackStaticEntry *e = &hpack_static_table[index - 1];
+                name = e->name;
+                nlen = e->nlen;
+                value = e->value;
+                vlen = e->vlen;
+            } else if (!table.Get(index - HPACK_STATIC_COUNT - 1,
+                                  &name, &nlen, &value, &vlen)) {
+                return PR_FAILURE;
+            }
+
+        } else if ((*p & 0xe0) == 0x20) {
+            // Dynamic table size update, only allowed before any fields
+            PRUint32 size;
+            if (!fFirst || !hpack_decode_integer(&p, end, 5, &size))
+                return PR_FAILURE;
+            if (size > maxTableSize)
+                return PR_FAILURE;
+            table.Resize(size);
+            continue;
+
+        } else {
+            // Literal header field, either with incremental indexing (01) or
+            // without indexing/never indexed (0000/0001)
+            int prefix;
+            if (*p & 0x40) {
+                fIndex = PR_TRUE;
+                prefix = 6;
+            } else {
+                prefix = 4;
+            }
+
+            if (!hpack_decode_integer(&p, end, prefix, &index))
+                return PR_FAILURE;
+
+            if (index == 0) {
+                if (DecodeString(&p, end, &name, &nlen) != PR_SUCCESS)
+                    return PR_FAILURE;
+            } else if (index <= HPACK_STATIC_COUNT) {
+                name = hpack_static_table[index - 1].name;
+                nlen = hpack_static_table[index - 1].nlen;
+            } else if (!table.Get(index - HPACK_STATIC_COUNT - 1,
+                                  &name, &nlen, &value, &vlen)) {
+                return PR_FAILURE;
+            }
+
+            if (DecodeString(&p, end, &value, &vlen) != PR_SUCCESS)
+                return PR_FAILURE;
+        }
+
+        fFirst = PR_FALSE;
+
+        if ((*fn)(context, name, nlen, value, vlen) != PR_SUCCESS)
+            return PR_FAILURE;
+
+        if (fIndex) {
+            if (table.Add(name, nlen, value, vlen) != PR_SUCCESS)
+                return PR_FAILURE;
+        }
+    }
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// HpackEncoder::HpackEncoder
+//-----------------------------------------------------------------------------
+
+HpackEncoder::HpackEncoder()
+: pendingSize(HPACK_DEFAULT_TABLE_SIZE),
+  fPendingResize(PR_FALSE)
+{ }
+
+//-----------------------------------------------------------------------------
+// HpackEncoder::SetMaxTableSize
+//-----------------------------------------------------------------------------
+
+void HpackEncoder::SetMaxTableSize(PRUint32 size)
+{
+    // We never use more than the default even if the peer allows it, which
+    // keeps the per-connection memory bounded
+    if (size > HPACK_DEFAULT_TABLE_SIZE)
+        size = HPACK_DEFAULT_TABLE_SIZE;
+
+    if (size != table.GetMaxSize() || fPendingResize) {
+        pendingSize = size;
+        fPendingResize = PR_TRUE;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// HpackEncoder::Begin
+//-----------------------------------------------------------------------------
+
+unsigned char *HpackEncoder::Begin(unsigned char *p)
+{
+    if (fPendingResize) {
+        table.Resize(pendingSize);
+        p = hpack_encode_integer(p, 0x20, 5, pendingSize);
+        fPendingResize = PR_FALSE;
+    }
+
+    return p;
+}
+
+//-----------------------------------------------------------------------------
+// HpackEncoder::EncodeStatus
+//-----------------------------------------------------------------------------
+
+unsigned char *HpackEncoder::EncodeStatus(unsigned char *p, int status)
+{
+    // Static table entries 8 to 14
+    switch (status) {
+    case 200: *p++ = 0x80 | 8; return p;
+    case 204: *p++ = 0x80 | 9; return p;
+    case 206: *p++ = 0x80 | 10; return p;
+    case 304: *p++ = 0x80 | 11; return p;
+    case 400: *p++ = 0x80 | 12; return p;
+    case 404: *p++ = 0x80 | 13; return p;
+    case 500: *p++ = 0x80 | 14; return p;
+    }
+
+    char digits[3];
+    digits[0] = '0' + (status / 100) % 10;
+    digits[1] = '0' + (status / 10) % 10;
+    digits[2] = '0' + status % 10;
+
+    return EncodeHeader(p, ":status", 7, digits, 3);
+}
+
+//-----------------------------------------------------------------------------
+// HpackEncoder::EncodeHeader
+//-----------------------------------------------------------------------------
+
+unsigned char *HpackEncoder::EncodeHeader(unsigned char *p,
+                                          const char *name, int nlen,
+                                          const char *value, int vlen)
+{
+    // Look for the field or at least its name in the static table
+    PRUint32 nameIndex = 0;
+    for (int i = 0; i < HPACK_STATIC_COUNT; i++) {
+        const HpackStaticEntry *e = &hpack_static_table[i];
+        if (e->nlen == nlen && !memcmp(e->name, name, nlen)) {
+            if (e->vlen == vlen && vlen && !memcmp(e->value, value, vlen))
+                return hpack_encode_integer(p, 0x80, 7, i + 1);
+            if (!nameIndex)
+                nameIndex = i + 1;
+        }
+    }
+
+    // Then in the dynamic table
+    int dynamicNameIndex;
+    int dynamicIndex = table.Find(name, nlen, value, vlen, &dynamicNameIndex);
+    if (dynamicIndex != -1)
+        return hpack_encode_integer(p, 0x80, 7, HPACK_STATIC_COUNT + 1 + dynamicIndex);
+    if (!nameIndex && dynamicNameIndex != -1)
+        nameIndex = HPACK_STATIC_COUNT + 1 + dynamicNameIndex;
+
+    PRBool fIndex = PR_TRUE;
+    for (int i = 0; hpack_unindexed[i]; i++) {
+        if (!strncmp(hpack_unindexed[i], name, nlen) && !hpack_unindexed[i][nlen]) {
+            fIndex = PR_FALSE;
+            break;
+        }
+    }
+
+    // Adding to our copy of the table may evict the entry nameIndex refers
+    // to, but the peer resolves the name before it adds the new entry too
+    if (fIndex && table.Add(name, nlen, value, vlen) != PR_SUCCESS)
+        fIndex = PR_FALSE;
+
+    if (fIndex) {
+        p = hpack_encode_integer(p, 0x40, 6, nameIndex);
+    } else {
+        p = hpack_encode_integer(p, 0x00, 4, nameIndex);
+    }
+    if (!nameIndex)
+        p = hpack_encode_string(p, name, nlen);
+
+    return hpack_encode_string(p, value, vlen);
+}
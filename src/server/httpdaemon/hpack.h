@@ -0,0 +1,182 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef HTTPDAEMON_HPACK_H
+#define HTTPDAEMON_HPACK_H
+
+#include "nspr.h"
+
+// Default and maximum size of the HPACK dynamic table (RFC 7541 section 4.2)
+#define HPACK_DEFAULT_TABLE_SIZE 4096
+
+//-----------------------------------------------------------------------------
+// HpackTable
+//-----------------------------------------------------------------------------
+
+// HPACK dynamic table.  Entries live in a ring, newest first, and each one is
+// a single PERM_MALLOC'd block holding the name followed by the value.  Both
+// the decoder and the encoder keep one of these; their contents only have to
+// agree with the peer's, so nothing is shared between connections.
+class HpackTable {
+public:
+    HpackTable();
+    ~HpackTable();
+
+    // Add a name/value pair, evicting older entries to make room.  An entry
+    // larger than the table empties it and is not added.  Returns PR_FAILURE
+    // if memory couldn't be allocated, in which case the table is unchanged.
+    PRStatus Add(const char *name, int nlen, const char *value, int vlen);
+
+    // Change the maximum size, evicting entries as necessary.
+    void Resize(PRUint32 size);
+
+    // Look up an entry by its 0-based position, newest first.
+    PRBool Get(PRUint32 i,
+               const char **name, int *nlen,
+               const char **value, int *vlen) const;
+
+    // Find an entry.  Returns its 0-based position, newest first, or -1.
+    // *nameOnly is set to the position of an entry whose name matches but
+    // whose value doesn't, or -1.
+    int Find(const char *name, int nlen, const char *value, int vlen,
+             int *nameOnly) const;
+
+    PRUint32 GetCount() const { return count; }
+    PRUint32 GetMaxSize() const { return maxSize; }
+
+private:
+    struct Entry {
+        char *p;
+        int nlen;
+        int vlen;
+    };
+
+    void Evict();
+
+    Entry *ring;
+    PRUint32 capacity;
+    PRUint32 head;
+    PRUint32 count;
+    PRUint32 size;
+    PRUint32 maxSize;
+};
+
+//-----------------------------------------------------------------------------
+// HpackDecoder
+//-----------------------------------------------------------------------------
+
+// Called once per header field in a header block.  name and value aren't
+// nul-terminated and are only valid for the duration of the call.  Returning
+// PR_FAILURE stops decoding; the header block is then treated as malformed.
+typedef PRStatus (*HpackHeaderFn)(void *context,
+                                  const char *name, int nlen,
+                                  const char *value, int vlen);
+
+// Decodes complete header blocks (the concatenated fragments from a HEADERS
+// frame and any CONTINUATION frames).  A failed decode leaves the dynamic
+// table out of step with the peer's, so the caller must treat it as a
+// connection error.
+class HpackDecoder {
+public:
+    HpackDecoder();
+    ~HpackDecoder();
+
+    // Decode the len bytes at block, calling fn for each header field.
+    PRStatus Decode(const unsigned char *block, int len,
+                    HpackHeaderFn fn, void *context);
+
+    // Set the limit we advertised in SETTINGS_HEADER_TABLE_SIZE.
+    void SetMaxTableSize(PRUint32 size);
+
+private:
+    PRStatus DecodeString(const unsigned char **pp,
+                          const unsigned char *end,
+                          const char **str, int *len);
+    char *Reserve(int len);
+
+    HpackTable table;
+    PRUint32 maxTableSize;
+    char *scratch;
+    int scratchSize;
+    int scratchUsed;
+};
+
+//-----------------------------------------------------------------------------
+// HpackEncoder
+//-----------------------------------------------------------------------------
+
+// Encodes response header blocks.  Fields that tend to repeat from one
+// response to the next (Server, Content-Type, Cache-Control and the like)
+// are added to the dynamic table so later responses can send them as a
+// single index byte.  Fields that rarely repeat are sent without indexing.
+// Strings are sent as-is rather than Huffman coded.
+class HpackEncoder {
+public:
+    HpackEncoder();
+
+    // Apply the peer's SETTINGS_HEADER_TABLE_SIZE.  The size update is
+    // signalled at the start of the next header block.
+    void SetMaxTableSize(PRUint32 size);
+
+    // Start a header block at p.  Returns the new end of the block.
+    unsigned char *Begin(unsigned char *p);
+
+    // Append a :status pseudo-header.  Returns the new end of the block.
+    unsigned char *EncodeStatus(unsigned char *p, int status);
+
+    // Append a header field.  name must already be lowercase.  Returns the
+    // new end of the block.
+    unsigned char *EncodeHeader(unsigned char *p,
+                                const char *name, int nlen,
+                                const char *value, int vlen);
+
+    // Upper bound on the bytes EncodeHeader and Begin may write.
+    static int GetMaxEncodedLength(int nlen, int vlen) { return nlen + vlen + 16; }
+
+private:
+    HpackTable table;
+    PRUint32 pendingSize;
+    PRBool fPendingResize;
+};
+
+//-----------------------------------------------------------------------------
+// hpack_huffman_decode
+//-----------------------------------------------------------------------------
+
+// Decode the len bytes of Huffman coded data at in to out, which must have
+// room for at least 8 * len / 5 bytes.  Returns the decoded length or -1 if
+// the data is not validly coded.
+int hpack_huffman_decode(const unsigned char *in, int len, char *out);
+
+#endif // HTTPDAEMON_HPACK_H
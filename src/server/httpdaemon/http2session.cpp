@@ -0,0 +1,2758 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * http2session.cpp: HTTP/2 connections
+ *
+ * Each stream is turned into an HTTP/1.1 request on a Connection of its own
+ * and queued for a DaemonSession.  The response HttpRequest writes is parsed
+ * back out of the byte stream by the stream IO layer and sent as HEADERS and
+ * DATA frames.
+ */
+
+#include "netsite.h"
+#include "base/pool.h"
+#include "base/util.h"
+#include "base/ereport.h"
+#include "frame/conf.h"
+#include "httpdaemon/http2session.h"
+#include "httpdaemon/httpheader.h"
+#include "httpdaemon/daemonsession.h"
+#include "httpdaemon/connqueue.h"
+#include "ssl.h"
+
+// Frame types (RFC 7540 section 6)
+#define HTTP2_DATA              0x0
+#define HTTP2_HEADERS           0x1
+#define HTTP2_PRIORITY          0x2
+#define HTTP2_RST_STREAM        0x3
+#define HTTP2_SETTINGS          0x4
+#define HTTP2_PUSH_PROMISE      0x5
+#define HTTP2_PING              0x6
+#define HTTP2_GOAWAY            0x7
+#define HTTP2_WINDOW_UPDATE     0x8
+#define HTTP2_CONTINUATION      0x9
+
+// Frame flags
+#define HTTP2_FLAG_END_STREAM   0x1
+#define HTTP2_FLAG_ACK          0x1
+#define HTTP2_FLAG_END_HEADERS  0x4
+#define HTTP2_FLAG_PADDED       0x8
+#define HTTP2_FLAG_PRIORITY     0x20
+
+// Error codes (RFC 7540 section 7)
+#define HTTP2_NO_ERROR          0x0
+#define HTTP2_PROTOCOL_ERROR    0x1
+#define HTTP2_INTERNAL_ERROR    0x2
+#define HTTP2_FLOW_CONTROL_ERROR 0x3
+#define HTTP2_STREAM_CLOSED     0x5
+#define HTTP2_FRAME_SIZE_ERROR  0x6
+#define HTTP2_REFUSED_STREAM    0x7
+#define HTTP2_COMPRESSION_ERROR 0x9
+#define HTTP2_ENHANCE_YOUR_CALM 0xb
+
+// Settings (RFC 7540 section 6.5.2)
+#define HTTP2_SETTINGS_HEADER_TABLE_SIZE        0x1
+#define HTTP2_SETTINGS_ENABLE_PUSH              0x2
+#define HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS   0x3
+#define HTTP2_SETTINGS_INITIAL_WINDOW_SIZE      0x4
+#define HTTP2_SETTINGS_MAX_FRAME_SIZE           0x5
+#define HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE     0x6
+
+#define HTTP2_FRAME_HEADER_SIZE 9
+
+// Largest frame payload either side sends.  We never advertise a larger
+// SETTINGS_MAX_FRAME_SIZE, and never need to send larger frames.
+#define HTTP2_FRAME_SIZE 16384
+
+#define HTTP2_DEFAULT_WINDOW 65535
+#define HTTP2_MAX_WINDOW 0x7fffffff
+
+// Receive window we give the connection as a whole.  It's larger than a
+// stream's so one stream whose body isn't being read doesn't stall the rest.
+#define HTTP2_CONNECTION_WINDOW (1024 * 1024)
+
+// Replenish the connection receive window once this much has been consumed
+#define HTTP2_CONNECTION_UPDATE_THRESHOLD 32768
+
+// Replenish a stream receive window once this much has been consumed
+#define HTTP2_STREAM_UPDATE_THRESHOLD 16384
+
+// Limit on a request's header block and on the header list it decodes to
+#define HTTP2_MAX_HEADER_BLOCK 65536
+#define HTTP2_MAX_HEADER_LIST_SIZE 65536
+
+// Limit on the HTTP/1.1 response header we'll convert
+#define HTTP2_MAX_RESPONSE_HEADER 65536
+
+#define HTTP2_BUFFER_SIZE 32768
+
+static const char http2_preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+#define HTTP2_PREFACE_LEN (sizeof(http2_preface) - 1)
+
+static const char http2_switching_protocols[] = "HTTP/1.1 101 Switching Protocols\r\n"
+                                                "Connection: Upgrade\r\n"
+                                                "Upgrade: h2c\r\n"
+                                                "\r\n";
+
+// States of the HTTP/1.1 response parser
+enum Http2ResponseState {
+    HTTP2_RSP_HEADER = 0,       // accumulating the response header
+    HTTP2_RSP_BODY_LENGTH,      // Content-Length delimited body
+    HTTP2_RSP_BODY_CLOSE,       // body delimited by the end of the response
+    HTTP2_RSP_CHUNK_SIZE,       // chunk-size line
+    HTTP2_RSP_CHUNK_DATA,       // chunk-data
+    HTTP2_RSP_CHUNK_CRLF,       // CRLF after chunk-data
+    HTTP2_RSP_TRAILER,          // trailer lines after the last chunk
+    HTTP2_RSP_DONE              // response complete
+};
+
+// Request body data waiting to be read by HttpRequest
+struct Http2Chunk {
+    Http2Chunk *next;
+    int len;
+    int pos;
+    int credit;                 // flow-controlled bytes to credit once read
+    char data[1];
+};
+
+// HTTP/1.1 response being written to a stream
+struct Http2Response {
+    int state;
+    Http2Buffer header;
+    Http2Buffer block;
+    int scan;
+    PRInt64 remaining;
+    PRBool fEndStreamSent;
+};
+
+struct Http2Stream {
+    PRUint32 id;
+    Http2Stream *next;
+    Http2Session *session;
+    char *request;              // HTTP/1.1 request header
+    int requestLen;
+    int requestPos;             // how much of it HttpRequest has read
+    PRBool fEndStream;          // client has finished sending
+    PRBool fReset;              // stream was reset
+    PRBool fChunked;            // body is passed on chunked
+    PRBool fHead;               // HEAD request
+    PRBool fRunning;            // handed to a DaemonSession
+    PRBool fShutdown;           // HttpRequest is done with the stream
+    PRBool fRefused;            // couldn't be handed to a DaemonSession
+    Http2Chunk *body;
+    Http2Chunk *bodyTail;
+    PRInt32 recvWindow;
+    PRInt32 recvPending;
+    PRInt32 sendWindow;
+    Http2Response rsp;          // only touched by the stream's DaemonSession
+};
+
+PRBool Http2Session::fCleartext = PR_TRUE;
+int Http2Session::nMaxStreams = 100;
+PRDescIdentity Http2Session::identity = PR_INVALID_IO_LAYER;
+PRIOMethods Http2Session::methods;
+
+
+/* --------------------------- http2_get_uint32 --------------------------- */
+
+static inline PRUint32 http2_get_uint32(const unsigned char *p)
+{
+    return ((PRUint32) p[0] << 24) | ((PRUint32) p[1] << 16) |
+           ((PRUint32) p[2] << 8) | (PRUint32) p[3];
+}
+
+
+/* --------------------------- http2_put_uint32 --------------------------- */
+
+static inline unsigned char *http2_put_uint32(unsigned char *p, PRUint32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+
+    return p + 4;
+}
+
+
+/* ------------------------ http2_put_frame_header ------------------------ */
+
+static inline unsigned char *http2_put_frame_header(unsigned char *p,
+                                                    PRUint8 type,
+                                                    PRUint8 flags,
+                                                    PRUint32 id,
+                                                    int len)
+{
+    p[0] = len >> 16;
+    p[1] = len >> 8;
+    p[2] = len;
+    p[3] = type;
+    p[4] = flags;
+
+    return http2_put_uint32(p + 5, id & 0x7fffffff);
+}
+
+
+/* ------------------------- http2_buffer_reserve ------------------------- */
+
+static PRStatus http2_buffer_reserve(Http2Buffer *b, int len)
+{
+    if (b->len + len > b->size) {
+        int size = b->size ? b->size * 2 : 256;
+        while (size < b->len + len)
+            size *= 2;
+
+        char *p = (char *) PERM_REALLOC(b->p, size);
+        if (!p)
+            return PR_FAILURE;
+
+        b->p = p;
+        b->size = size;
+    }
+
+    return PR_SUCCESS;
+}
+
+
+/* ------------------------- http2_buffer_append -------------------------- */
+
+static inline PRStatus http2_buffer_append(Http2Buffer *b, const void *p, int len)
+{
+    if (http2_buffer_reserve(b, len) != PR_SUCCESS)
+        return PR_FAILURE;
+
+    memcpy(b->p + b->len, p, len);
+    b->len += len;
+
+    return PR_SUCCESS;
+}
+
+
+/* -------------------------- http2_buffer_free --------------------------- */
+
+static void http2_buffer_free(Http2Buffer *b)
+{
+    PERM_FREE(b->p);
+    b->p = NULL;
+    b->len = 0;
+    b->size = 0;
+}
+
+
+/* -------------------------- http2_stream_free --------------------------- */
+
+static void http2_stream_free(Http2Stream *stream)
+{
+    while (stream->body) {
+        Http2Chunk *chunk = stream->body;
+        stream->body = chunk->next;
+        PERM_FREE(chunk);
+    }
+    http2_buffer_free(&stream->rsp.header);
+    http2_buffer_free(&stream->rsp.block);
+    PERM_FREE(stream->request);
+    PERM_FREE(stream);
+}
+
+
+/* --------------------------- http2_token_eq ----------------------------- */
+
+static inline PRBool http2_token_eq(const char *s, int len, const char *token)
+{
+    return !strncasecmp(s, token, len) && !token[len];
+}
+
+
+/* ---------------------- http2_connection_specific ----------------------- */
+
+// Header fields that only have meaning for an HTTP/1.1 connection
+static PRBool http2_connection_specific(const char *name, int nlen)
+{
+    switch (nlen) {
+    case 7: return http2_token_eq(name, nlen, "upgrade");
+    case 10: return http2_token_eq(name, nlen, "connection") ||
+                    http2_token_eq(name, nlen, "keep-alive");
+    case 16: return http2_token_eq(name, nlen, "proxy-connection");
+    case 17: return http2_token_eq(name, nlen, "transfer-encoding");
+    }
+
+    return PR_FALSE;
+}
+
+
+/* ------------------------ http2_base64url_decode ------------------------ */
+
+// Decode unpadded base64url (RFC 4648 section 5) as used by HTTP2-Settings.
+// Returns the decoded length or -1.
+static int http2_base64url_decode(const char *in, int len, unsigned char *out)
+{
+    PRUint32 bits = 0;
+    int nbits = 0;
+    int n = 0;
+
+    for (int i = 0; i < len; i++) {
+        int c = in[i];
+        int v;
+        if (c >= 'A' && c <= 'Z') {
+            v = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            v = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            v = c - '0' + 52;
+        } else if (c == '-') {
+            v = 62;
+        } else if (c == '_') {
+            v = 63;
+        } else if (c == '=') {
+            break;
+        } else {
+            return -1;
+        }
+
+        bits = (bits << 6) | v;
+        nbits += 6;
+        if (nbits >= 8) {
+            nbits -= 8;
+            out[n++] = bits >> nbits;
+        }
+    }
+
+    return n;
+}
+
+
+//-----------------------------------------------------------------------------
+// Http2Session::Initialize
+//-----------------------------------------------------------------------------
+
+PRBool Http2Session::Initialize()
+{
+    fCleartext = conf_getboolean("Http2Cleartext", fCleartext);
+    nMaxStreams = conf_getboundedinteger("Http2MaxConcurrentStreams", 1, 1024, nMaxStreams);
+
+    if (identity == PR_INVALID_IO_LAYER) {
+        identity = PR_GetUniqueIdentity("http2/" PRODUCT_FULL_VERSION_ID);
+        if (identity == PR_INVALID_IO_LAYER)
+            return PR_FALSE;
+
+        methods = *PR_GetDefaultIOMethods();
+        methods.write = LayerWrite;
+        methods.writev = LayerWritev;
+        methods.send = LayerSend;
+        methods.sendfile = LayerSendFile;
+        methods.transmitfile = LayerTransmitFile;
+        methods.recv = LayerRecv;
+        methods.read = LayerRead;
+        methods.available = LayerAvailable;
+        methods.available64 = LayerAvailable64;
+        methods.poll = LayerPoll;
+        methods.shutdown = LayerShutdown;
+        methods.close = LayerClose;
+    }
+
+    return PR_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::IsPreface
+//-----------------------------------------------------------------------------
+
+PRBool Http2Session::IsPreface(Connection *conn, const netbuf *buf)
+{
+    // "PRI " is enough to tell the preface from an HTTP/1.x request line;
+    // ProcessInput checks the rest
+    int len = buf->cursize - buf->pos;
+    if (len < 4)
+        return PR_FALSE;
+    if (len > HTTP2_PREFACE_LEN)
+        len = HTTP2_PREFACE_LEN;
+    if (memcmp(buf->inbuf + buf->pos, http2_preface, len))
+        return PR_FALSE;
+
+    // Streams are run by DaemonSessions from the thread pool, and a stream
+    // can't carry another HTTP/2 connection
+    if (!conn->connQueue || conn->fHttp2Stream)
+        return PR_FALSE;
+
+    if (!conn->fSSLEnabled)
+        return fCleartext;
+
+#ifdef SSL_ENABLE_ALPN
+    // Over TLS, HTTP/2 must have been negotiated with ALPN
+    SSLNextProtoState state;
+    unsigned char proto[16];
+    unsigned int protoLen;
+    if (SSL_GetNextProto(conn->fd, &state, proto, &protoLen, sizeof(proto)) == SECSuccess &&
+        (state == SSL_NEXT_PROTO_NEGOTIATED || state == SSL_NEXT_PROTO_SELECTED) &&
+        protoLen == 2 && !memcmp(proto, "h2", 2))
+    {
+        return PR_TRUE;
+    }
+#endif
+
+    return PR_FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::IsUpgrade
+//-----------------------------------------------------------------------------
+
+PRBool Http2Session::IsUpgrade(Connection *conn, const HttpHeader *hdr)
+{
+    // h2c is only for cleartext connections (RFC 7540 section 3.2), and we
+    // don't upgrade requests with bodies as the body would have to be read
+    // before the upgrade takes effect
+    if (!fCleartext || conn->fSSLEnabled || conn->http2)
+        return PR_FALSE;
+    if (!conn->connQueue || conn->fHttp2Stream)
+        return PR_FALSE;
+    if (hdr->GetClientProtocolVersion() != PROTOCOL_VERSION_HTTP11)
+        return PR_FALSE;
+    if (hdr->GetContentLength() || hdr->GetTransferEncoding())
+        return PR_FALSE;
+
+    PRBool fUpgrade = PR_FALSE;
+    int nSettings = 0;
+
+    const HHHeader *hh;
+    for (int i = 0; (hh = hdr->GetHeader(i)) != NULL; i++) {
+        if (hh->ix == NSHttpHeader_Upgrade) {
+            HHString token;
+            PRBool wasQuoted;
+            int pos = 0;
+            while ((pos = HttpHeader::ParseCSList(&token, &hh->val, pos, wasQuoted)) != -1) {
+                if (http2_token_eq(token.ptr, token.len, "h2c"))
+                    fUpgrade = PR_TRUE;
+            }
+        } else if (hh->ix == NSHttpHeader_Unrecognized) {
+            if (http2_token_eq(hh->tag.ptr, hh->tag.len, "http2-settings"))
+                nSettings++;
+        }
+    }
+
+    return fUpgrade && nSettings == 1;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Http2Session
+//-----------------------------------------------------------------------------
+
+Http2Session::Http2Session(Connection *conn_)
+: conn(conn_),
+  wakeup(NULL),
+  rsize(HTTP2_BUFFER_SIZE),
+  rpos(0),
+  rlen(0),
+  hblockStream(0),
+  fHblockEndStream(PR_FALSE),
+  streams(NULL),
+  streamsTail(NULL),
+  nStreams(0),
+  nRunning(0),
+  lastStreamId(0),
+  sendWindow(HTTP2_DEFAULT_WINDOW),
+  recvWindow(HTTP2_DEFAULT_WINDOW),
+  recvPending(0),
+  peerInitialWindow(HTTP2_DEFAULT_WINDOW),
+  fPreface(PR_FALSE),
+  fSettings(PR_FALSE),
+  fStarted(PR_FALSE),
+  fGoawaySent(PR_FALSE),
+  fGoawayReceived(PR_FALSE),
+  fError(PR_FALSE),
+  fClosed(PR_FALSE)
+{
+    lock = PR_NewLock();
+    cv = lock ? PR_NewCondVar(lock) : NULL;
+    sendLock = PR_NewLock();
+
+    rbuf = (unsigned char *) PERM_MALLOC(rsize);
+
+    memset(&obuf, 0, sizeof(obuf));
+    memset(&wbuf, 0, sizeof(wbuf));
+    memset(&hblock, 0, sizeof(hblock));
+    memset(&rq, 0, sizeof(rq));
+
+    http2_buffer_reserve(&obuf, HTTP2_BUFFER_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::~Http2Session
+//-----------------------------------------------------------------------------
+
+Http2Session::~Http2Session()
+{
+    PR_ASSERT(!nRunning);
+
+    while (streams)
+        RemoveStream(streams);
+
+    // Stream layers link themselves to the socket's layer as they're pushed
+    // around by filters; don't leave it pointing at one
+    if (conn->fd)
+        conn->fd->higher = NULL;
+
+    if (wakeup)
+        PR_DestroyPollableEvent(wakeup);
+    if (cv)
+        PR_DestroyCondVar(cv);
+    if (lock)
+        PR_DestroyLock(lock);
+    if (sendLock)
+        PR_DestroyLock(sendLock);
+
+    http2_buffer_free(&obuf);
+    http2_buffer_free(&wbuf);
+    http2_buffer_free(&hblock);
+    http2_buffer_free(&rq.fields);
+    http2_buffer_free(&rq.cookie);
+    http2_buffer_free(&rq.values);
+
+    PERM_FREE(rbuf);
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::IsValid
+//-----------------------------------------------------------------------------
+
+PRBool Http2Session::IsValid() const
+{
+    return rbuf && obuf.p && lock && cv && sendLock;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Create
+//-----------------------------------------------------------------------------
+
+Http2Session *Http2Session::Create(Connection *conn)
+{
+    Http2Session *h2 = new Http2Session(conn);
+    if (!h2->IsValid()) {
+        delete h2;
+        return NULL;
+    }
+
+    return h2;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::CreateUpgrade
+//-----------------------------------------------------------------------------
+
+Http2Session *Http2Session::CreateUpgrade(Connection *conn, const HttpHeader *hdr)
+{
+    Http2Session *h2 = Create(conn);
+    if (!h2)
+        return NULL;
+
+    // Rebuild the request without the headers that asked for the upgrade
+    Http2Buffer text;
+    memset(&text, 0, sizeof(text));
+    const HHString& hsRequestLine = hdr->GetRequestLine();
+    PRStatus rv = http2_buffer_append(&text, hsRequestLine.ptr, hsRequestLine.len);
+    if (rv == PR_SUCCESS)
+        rv = http2_buffer_append(&text, "\r\n", 2);
+
+    const HHHeader *hh;
+    for (int i = 0; rv == PR_SUCCESS && (hh = hdr->GetHeader(i)) != NULL; i++) {
+        if (hh->ix == NSHttpHeader_Upgrade || hh->ix == NSHttpHeader_Connection)
+            continue;
+
+        if (hh->ix == NSHttpHeader_Unrecognized &&
+            http2_token_eq(hh->tag.ptr, hh->tag.len, "http2-settings"))
+        {
+            // Apply the client's settings as if they'd arrived in a
+            // SETTINGS frame, but without acknowledging them
+            unsigned char *settings = (unsigned char *) PERM_MALLOC(hh->val.len + 1);
+            int len = -1;
+            if (settings)
+                len = http2_base64url_decode(hh->val.ptr, hh->val.len, settings);
+            if (len < 0 || len % 6 || h2->ApplySettings(settings, len) != PR_SUCCESS)
+                rv = PR_FAILURE;
+            PERM_FREE(settings);
+            continue;
+        }
+
+        if (http2_buffer_append(&text, hh->tag.ptr, hh->tag.len) != PR_SUCCESS ||
+            http2_buffer_append(&text, ": ", 2) != PR_SUCCESS ||
+            http2_buffer_append(&text, hh->val.ptr, hh->val.len) != PR_SUCCESS ||
+            http2_buffer_append(&text, "\r\n", 2) != PR_SUCCESS)
+        {
+            rv = PR_FAILURE;
+        }
+    }
+    if (rv == PR_SUCCESS)
+        rv = http2_buffer_append(&text, "\r\n", 2);
+
+    // The request becomes stream 1, half-closed from the client's side
+    Http2Stream *stream = NULL;
+    if (rv == PR_SUCCESS)
+        stream = h2->AddStream(1);
+    if (!stream) {
+        http2_buffer_free(&text);
+        delete h2;
+        return NULL;
+    }
+
+    stream->request = text.p;
+    stream->requestLen = text.len;
+    stream->fEndStream = PR_TRUE;
+    stream->fHead = (hdr->GetMethodNumber() == METHOD_HEAD);
+    h2->lastStreamId = 1;
+
+    // 101 goes out ahead of our connection preface
+    http2_buffer_append(&h2->obuf, http2_switching_protocols, sizeof(http2_switching_protocols) - 1);
+
+    return h2;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::HandleFrames
+//-----------------------------------------------------------------------------
+
+PRBool Http2Session::HandleFrames(DaemonSession *session, netbuf *buf)
+{
+    // Take over whatever the DaemonSession read from the socket
+    int len = buf->cursize - buf->pos;
+    if (len > 0) {
+        if (rlen + len > rsize) {
+            if (rpos > 0) {
+                memmove(rbuf, rbuf + rpos, rlen - rpos);
+                rlen -= rpos;
+                rpos = 0;
+            }
+            if (rlen + len > rsize) {
+                unsigned char *p = (unsigned char *) PERM_REALLOC(rbuf, rlen + len);
+                if (!p) {
+                    Closed();
+                    len = 0;
+                } else {
+                    rbuf = p;
+                    rsize = rlen + len;
+                }
+            }
+        }
+        memcpy(rbuf + rlen, buf->inbuf + buf->pos, len);
+        rlen += len;
+    }
+    buf->pos = 0;
+    buf->cursize = 0;
+
+    // Our connection preface, and the rest of the connection window
+    if (!fStarted) {
+        unsigned char settings[12];
+        unsigned char *p = settings;
+        p[0] = 0;
+        p[1] = HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS;
+        p = http2_put_uint32(p + 2, nMaxStreams);
+        p[0] = 0;
+        p[1] = HTTP2_SETTINGS_MAX_HEADER_LIST_SIZE;
+        p = http2_put_uint32(p + 2, HTTP2_MAX_HEADER_LIST_SIZE);
+        PR_Lock(lock);
+        PRBool fUpgrade = (obuf.len > 0);
+        QueueFrame(HTTP2_SETTINGS, 0, 0, settings, p - settings);
+        SendWindowUpdate(0, HTTP2_CONNECTION_WINDOW - HTTP2_DEFAULT_WINDOW);
+        recvWindow = HTTP2_CONNECTION_WINDOW;
+        fStarted = PR_TRUE;
+        PR_Unlock(lock);
+
+        // Clients that upgraded from HTTP/1.1 read the 101 on its own before
+        // switching parsers, so don't bury it in front of the first response
+        if (fUpgrade)
+            Flush();
+    }
+
+    PRBool fKeepAlive = PR_FALSE;
+
+    for (;;) {
+        PR_Lock(lock);
+        ProcessInput();
+        PR_NotifyAllCondVar(cv);
+        PRBool fDone = (fError || fClosed);
+        PR_Unlock(lock);
+        if (fDone)
+            break;
+
+        // Hand new streams to DaemonSessions
+        DispatchStreams();
+
+        if (Flush() != PR_SUCCESS)
+            break;
+
+        PR_Lock(lock);
+        PRBool fIdle = (nStreams == 0);
+        PR_Unlock(lock);
+
+        if (fIdle && fGoawayReceived)
+            break;
+
+        // If the connection is idle, give it to the keep-alive subsystem
+        if (fIdle && rpos == rlen && !hblockStream) {
+            fKeepAlive = session->RequestKeepAlive(PR_TRUE);
+            break;
+        }
+
+        if (Wait(DaemonSession::GetIOTimeout()) != PR_SUCCESS) {
+            // Timing out while streams run is fine; they have timeouts of
+            // their own.  Otherwise we were waiting for the rest of a frame.
+            PR_Lock(lock);
+            if (!fClosed && !nStreams)
+                ConnectionError(HTTP2_PROTOCOL_ERROR);
+            PR_Unlock(lock);
+        }
+    }
+
+    if (!fKeepAlive) {
+        PR_Lock(lock);
+        if (!fClosed && !fGoawaySent) {
+            unsigned char goaway[8];
+            http2_put_uint32(goaway, lastStreamId);
+            http2_put_uint32(goaway + 4, HTTP2_NO_ERROR);
+            QueueFrame(HTTP2_GOAWAY, 0, 0, goaway, sizeof(goaway));
+            fGoawaySent = PR_TRUE;
+        }
+        PR_Unlock(lock);
+        Flush();
+
+        // Streams still running on other DaemonSessions fail now that the
+        // connection has; wait for them before the socket is closed
+        PR_Lock(lock);
+        while (nRunning > 0) {
+            PR_Unlock(lock);
+            PR_WaitForPollableEvent(wakeup);
+            PR_Lock(lock);
+        }
+        PR_Unlock(lock);
+
+        session->RequestKeepAlive(PR_FALSE);
+    }
+
+    return PR_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Fill
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::Fill(PRIntervalTime timeout)
+{
+    if (rpos > 0) {
+        memmove(rbuf, rbuf + rpos, rlen - rpos);
+        rlen -= rpos;
+        rpos = 0;
+    }
+
+    PR_ASSERT(rlen < rsize);
+
+    PRInt32 rv = PR_Recv(conn->fd, rbuf + rlen, rsize - rlen, 0, timeout);
+    if (rv <= 0) {
+        // Timeouts fail the operation in progress but not the connection
+        if (rv == 0 || PR_GetError() != PR_IO_TIMEOUT_ERROR)
+            Closed();
+        if (rv == 0)
+            PR_SetError(PR_CONNECT_RESET_ERROR, 0);
+        return PR_FAILURE;
+    }
+
+    rlen += rv;
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Wait
+//-----------------------------------------------------------------------------
+
+// Wait for data from the client or, while streams are running, for the last
+// of them to finish
+PRStatus Http2Session::Wait(PRIntervalTime timeout)
+{
+    PRPollDesc pd[2];
+    int npd = 1;
+    pd[0].fd = conn->fd;
+    pd[0].in_flags = PR_POLL_READ;
+    pd[0].out_flags = 0;
+    if (wakeup) {
+        pd[1].fd = wakeup;
+        pd[1].in_flags = PR_POLL_READ;
+        pd[1].out_flags = 0;
+        npd++;
+    }
+
+    PRInt32 rv = PR_Poll(pd, npd, timeout);
+    if (rv < 0) {
+        Closed();
+        return PR_FAILURE;
+    }
+    if (rv == 0) {
+        PR_SetError(PR_IO_TIMEOUT_ERROR, 0);
+        return PR_FAILURE;
+    }
+
+    if (npd > 1 && pd[1].out_flags)
+        PR_WaitForPollableEvent(wakeup);
+
+    // The socket may only have had TLS records that didn't carry data
+    if (pd[0].out_flags) {
+        if (Fill(PR_INTERVAL_NO_WAIT) != PR_SUCCESS && fClosed)
+            return PR_FAILURE;
+    }
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ProcessInput
+//-----------------------------------------------------------------------------
+
+void Http2Session::ProcessInput()
+{
+    if (!fPreface) {
+        int len = rlen - rpos;
+        if (len > HTTP2_PREFACE_LEN)
+            len = HTTP2_PREFACE_LEN;
+        if (memcmp(rbuf + rpos, http2_preface, len)) {
+            ereport(LOG_VERBOSE,
+                    "Received malformed HTTP/2 connection preface from %s",
+                    conn->remoteIP.buf);
+            fClosed = PR_TRUE;
+            return;
+        }
+        if (len < HTTP2_PREFACE_LEN)
+            return;
+        rpos += HTTP2_PREFACE_LEN;
+        fPreface = PR_TRUE;
+    }
+
+    while (!fError && !fClosed && rlen - rpos >= HTTP2_FRAME_HEADER_SIZE) {
+        const unsigned char *p = rbuf + rpos;
+        int len = (p[0] << 16) | (p[1] << 8) | p[2];
+        PRUint8 type = p[3];
+        PRUint8 flags = p[4];
+        PRUint32 id = http2_get_uint32(p + 5) & 0x7fffffff;
+
+        if (len > HTTP2_FRAME_SIZE) {
+            ConnectionError(HTTP2_FRAME_SIZE_ERROR);
+            return;
+        }
+        if (rlen - rpos < HTTP2_FRAME_HEADER_SIZE + len)
+            return;
+
+        rpos += HTTP2_FRAME_HEADER_SIZE + len;
+
+        // The client's preface ends with a SETTINGS frame
+        if (!fSettings && type != HTTP2_SETTINGS) {
+            ConnectionError(HTTP2_PROTOCOL_ERROR);
+            return;
+        }
+
+        if (ProcessFrame(type, flags, id, p + HTTP2_FRAME_HEADER_SIZE, len) != PR_SUCCESS) {
+            ConnectionError(HTTP2_PROTOCOL_ERROR);
+            return;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ProcessFrame
+//-----------------------------------------------------------------------------
+
+// Returns PR_FAILURE for a PROTOCOL_ERROR connection error.  Other connection
+// errors are raised directly with ConnectionError.
+PRStatus Http2Session::ProcessFrame(PRUint8 type, PRUint8 flags, PRUint32 id,
+                                    const unsigned char *payload, int len)
+{
+    // Nothing may come between a HEADERS frame and its CONTINUATION frames
+    if (hblockStream && type != HTTP2_CONTINUATION)
+        return PR_FAILURE;
+
+    switch (type) {
+    case HTTP2_DATA:
+        return ProcessData(flags, id, payload, len);
+
+    case HTTP2_HEADERS:
+        return ProcessHeaders(flags, id, payload, len);
+
+    case HTTP2_PRIORITY:
+        // Streams are dispatched as they arrive regardless of priority
+        if (id == 0)
+            return PR_FAILURE;
+        if (len != 5)
+            ResetStream(id, HTTP2_FRAME_SIZE_ERROR);
+        return PR_SUCCESS;
+
+    case HTTP2_RST_STREAM:
+        if (id == 0 || id > lastStreamId)
+            return PR_FAILURE;
+        if (len != 4) {
+            ConnectionError(HTTP2_FRAME_SIZE_ERROR);
+        } else if (Http2Stream *stream = FindStream(id)) {
+            if (stream->fRunning) {
+                stream->fReset = PR_TRUE;
+            } else {
+                RemoveStream(stream);
+            }
+        }
+        return PR_SUCCESS;
+
+    case HTTP2_SETTINGS:
+        return ProcessSettings(flags, id, payload, len);
+
+    case HTTP2_PUSH_PROMISE:
+        // Clients can't push
+        return PR_FAILURE;
+
+    case HTTP2_PING:
+        if (id != 0)
+            return PR_FAILURE;
+        if (len != 8) {
+            ConnectionError(HTTP2_FRAME_SIZE_ERROR);
+        } else if (!(flags & HTTP2_FLAG_ACK)) {
+            QueueFrame(HTTP2_PING, HTTP2_FLAG_ACK, 0, payload, len);
+        }
+        return PR_SUCCESS;
+
+    case HTTP2_GOAWAY:
+        if (id != 0)
+            return PR_FAILURE;
+        fGoawayReceived = PR_TRUE;
+        return PR_SUCCESS;
+
+    case HTTP2_WINDOW_UPDATE:
+        return ProcessWindowUpdate(id, payload, len);
+
+    case HTTP2_CONTINUATION:
+        return ProcessContinuation(flags, id, payload, len);
+    }
+
+    // Unknown frame types are ignored (RFC 7540 section 4.1)
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ProcessData
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::ProcessData(PRUint8 flags, PRUint32 id,
+                                   const unsigned char *payload, int len)
+{
+    if (id == 0 || id > lastStreamId)
+        return PR_FAILURE;
+
+    // The entire payload, padding included, counts against the windows.
+    // The connection's is replenished as streams consume what they're sent.
+    if (len > recvWindow) {
+        ConnectionError(HTTP2_FLOW_CONTROL_ERROR);
+        return PR_SUCCESS;
+    }
+    recvWindow -= len;
+
+    int padding = 0;
+    if (flags & HTTP2_FLAG_PADDED) {
+        if (len < 1)
+            return PR_FAILURE;
+        padding = payload[0] + 1;
+        if (padding > len)
+            return PR_FAILURE;
+    }
+    const char *data = (const char *) payload + (padding ? 1 : 0);
+    int datalen = len - padding;
+
+    // Data for streams that have been closed, or whose requests are done
+    // reading, is discarded
+    Http2Stream *stream = FindStream(id);
+    if (!stream || stream->fReset || stream->fShutdown) {
+        Credit(len);
+        return PR_SUCCESS;
+    }
+
+    if (stream->fEndStream) {
+        Credit(len);
+        ResetStream(id, HTTP2_STREAM_CLOSED);
+        return PR_SUCCESS;
+    }
+
+    if (len > stream->recvWindow) {
+        Credit(len);
+        ResetStream(id, HTTP2_FLOW_CONTROL_ERROR);
+        return PR_SUCCESS;
+    }
+    stream->recvWindow -= len;
+
+    PRBool fEndStream = (flags & HTTP2_FLAG_END_STREAM) != 0;
+
+    // Queue the data for HttpRequest, chunk framed if we told it the body
+    // is chunked
+    if (datalen > 0 || (fEndStream && stream->fChunked)) {
+        int size = datalen;
+        if (stream->fChunked)
+            size += sizeof("ffffffff\r\n\r\n0\r\n\r\n");
+
+        Http2Chunk *chunk = (Http2Chunk *) PERM_MALLOC(sizeof(Http2Chunk) + size);
+        if (!chunk) {
+            Credit(len);
+            ResetStream(id, HTTP2_INTERNAL_ERROR);
+            return PR_SUCCESS;
+        }
+
+        chunk->next = NULL;
+        chunk->pos = 0;
+        chunk->credit = len;
+        chunk->len = 0;
+        if (stream->fChunked && datalen > 0)
+            chunk->len += util_sprintf(chunk->data, "%x\r\n", datalen);
+        memcpy(chunk->data + chunk->len, data, datalen);
+        chunk->len += datalen;
+        if (stream->fChunked && datalen > 0) {
+            memcpy(chunk->data + chunk->len, "\r\n", 2);
+            chunk->len += 2;
+        }
+        if (stream->fChunked && fEndStream) {
+            memcpy(chunk->data + chunk->len, "0\r\n\r\n", 5);
+            chunk->len += 5;
+        }
+
+        if (stream->bodyTail) {
+            stream->bodyTail->next = chunk;
+        } else {
+            stream->body = chunk;
+        }
+        stream->bodyTail = chunk;
+    } else if (len > 0) {
+        // Nothing for HttpRequest to read, so credit the padding now
+        Credit(len);
+        if (!fEndStream) {
+            stream->recvWindow += len;
+            SendWindowUpdate(id, len);
+        }
+    }
+
+    if (fEndStream)
+        stream->fEndStream = PR_TRUE;
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ProcessHeaders
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::ProcessHeaders(PRUint8 flags, PRUint32 id,
+                                      const unsigned char *payload, int len)
+{
+    if (id == 0 || !(id & 1))
+        return PR_FAILURE;
+
+    int padding = 0;
+    int skip = 0;
+    if (flags & HTTP2_FLAG_PADDED) {
+        if (len < 1)
+            return PR_FAILURE;
+        padding = payload[0];
+        skip = 1;
+    }
+    if (flags & HTTP2_FLAG_PRIORITY)
+        skip += 5;
+    if (skip + padding > len)
+        return PR_FAILURE;
+
+    if (id <= lastStreamId) {
+        // Trailers must end the stream; anything else reuses a stream ID
+        Http2Stream *stream = FindStream(id);
+        if (!stream || stream->fEndStream || !(flags & HTTP2_FLAG_END_STREAM))
+            return PR_FAILURE;
+    } else {
+        lastStreamId = id;
+    }
+
+    hblock.len = 0;
+    if (http2_buffer_append(&hblock, payload + skip, len - skip - padding) != PR_SUCCESS) {
+        ConnectionError(HTTP2_INTERNAL_ERROR);
+        return PR_SUCCESS;
+    }
+    hblockStream = id;
+    fHblockEndStream = (flags & HTTP2_FLAG_END_STREAM) != 0;
+
+    if (flags & HTTP2_FLAG_END_HEADERS)
+        return DecodeHeaderBlock();
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ProcessContinuation
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::ProcessContinuation(PRUint8 flags, PRUint32 id,
+                                           const unsigned char *payload, int len)
+{
+    if (!hblockStream || id != hblockStream)
+        return PR_FAILURE;
+
+    if (hblock.len + len > HTTP2_MAX_HEADER_BLOCK) {
+        ConnectionError(HTTP2_ENHANCE_YOUR_CALM);
+        return PR_SUCCESS;
+    }
+
+    if (http2_buffer_append(&hblock, payload, len) != PR_SUCCESS) {
+        ConnectionError(HTTP2_INTERNAL_ERROR);
+        return PR_SUCCESS;
+    }
+
+    if (flags & HTTP2_FLAG_END_HEADERS)
+        return DecodeHeaderBlock();
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::DecodeHeaderBlock
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::DecodeHeaderBlock()
+{
+    PRUint32 id = hblockStream;
+    hblockStream = 0;
+
+    // Header blocks must always be decoded to keep the HPACK dynamic table
+    // in step with the client's, even for streams we won't process
+    rq.fields.len = 0;
+    rq.cookie.len = 0;
+    rq.values.len = 0;
+    rq.size = 0;
+    rq.method = rq.path = rq.authority = rq.host = -1;
+    rq.fRegular = PR_FALSE;
+    rq.fContentLength = PR_FALSE;
+    rq.fMalformed = PR_FALSE;
+
+    if (decoder.Decode((const unsigned char *) hblock.p, hblock.len,
+                       AddRequestHeader, this) != PR_SUCCESS)
+    {
+        ConnectionError(HTTP2_COMPRESSION_ERROR);
+        return PR_SUCCESS;
+    }
+
+    // Trailers are discarded; the request has already been passed on
+    if (Http2Stream *stream = FindStream(id)) {
+        Http2Chunk *chunk = NULL;
+        if (stream->fChunked) {
+            chunk = (Http2Chunk *) PERM_MALLOC(sizeof(Http2Chunk) + 5);
+            if (!chunk) {
+                ResetStream(id, HTTP2_INTERNAL_ERROR);
+                return PR_SUCCESS;
+            }
+            chunk->next = NULL;
+            chunk->pos = 0;
+            chunk->credit = 0;
+            chunk->len = 5;
+            memcpy(chunk->data, "0\r\n\r\n", 5);
+            if (stream->bodyTail) {
+                stream->bodyTail->next = chunk;
+            } else {
+                stream->body = chunk;
+            }
+            stream->bodyTail = chunk;
+        }
+        stream->fEndStream = PR_TRUE;
+        return PR_SUCCESS;
+    }
+
+    // Once we've sent GOAWAY, new streams are ignored
+    if (fGoawaySent)
+        return PR_SUCCESS;
+
+    if (nStreams >= nMaxStreams) {
+        ResetStream(id, HTTP2_REFUSED_STREAM);
+        return PR_SUCCESS;
+    }
+
+    if (rq.method == -1 || rq.path == -1)
+        rq.fMalformed = PR_TRUE;
+    if (rq.fMalformed) {
+        ResetStream(id, HTTP2_PROTOCOL_ERROR);
+        return PR_SUCCESS;
+    }
+
+    // Requests with bodies of unknown length are passed on chunked
+    PRBool fChunked = (!fHblockEndStream && !rq.fContentLength);
+
+    // Build the HTTP/1.1 request header
+    const char *values = rq.values.p;
+    int hostLen = (rq.authority != -1) ? rq.authorityLen : rq.hostLen;
+    const char *host = (rq.authority != -1) ? values + rq.authority : values + rq.host;
+    int len = rq.methodLen + 1 + rq.pathLen + sizeof(" HTTP/1.1\r\n") - 1 +
+              rq.fields.len + 2;
+    if (rq.authority != -1 || rq.host != -1)
+        len += sizeof("host: \r\n") - 1 + hostLen;
+    if (rq.cookie.len)
+        len += sizeof("cookie: \r\n") - 1 + rq.cookie.len;
+    if (fChunked)
+        len += sizeof("transfer-encoding: chunked\r\n") - 1;
+
+    if (len > HTTP2_MAX_HEADER_LIST_SIZE) {
+        ResetStream(id, HTTP2_PROTOCOL_ERROR);
+        return PR_SUCCESS;
+    }
+
+    char *text = (char *) PERM_MALLOC(len + 1);
+    Http2Stream *stream = text ? AddStream(id) : NULL;
+    if (!stream) {
+        PERM_FREE(text);
+        ResetStream(id, HTTP2_INTERNAL_ERROR);
+        return PR_SUCCESS;
+    }
+
+    char *p = text;
+    memcpy(p, values + rq.method, rq.methodLen);
+    p += rq.methodLen;
+    *p++ = ' ';
+    memcpy(p, values + rq.path, rq.pathLen);
+    p += rq.pathLen;
+    memcpy(p, " HTTP/1.1\r\n", 11);
+    p += 11;
+    if (rq.authority != -1 || rq.host != -1) {
+        memcpy(p, "host: ", 6);
+        p += 6;
+        memcpy(p, host, hostLen);
+        p += hostLen;
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    if (rq.fields.len) {
+        memcpy(p, rq.fields.p, rq.fields.len);
+        p += rq.fields.len;
+    }
+    if (rq.cookie.len) {
+        memcpy(p, "cookie: ", 8);
+        p += 8;
+        memcpy(p, rq.cookie.p, rq.cookie.len);
+        p += rq.cookie.len;
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+    if (fChunked) {
+        memcpy(p, "transfer-encoding: chunked\r\n", 28);
+        p += 28;
+    }
+    *p++ = '\r';
+    *p++ = '\n';
+    PR_ASSERT(p - text == len);
+
+    stream->request = text;
+    stream->requestLen = p - text;
+    stream->fEndStream = fHblockEndStream;
+    stream->fChunked = fChunked;
+    stream->fHead = (rq.methodLen == 4 && !memcmp(values + rq.method, "HEAD", 4));
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::AddRequestHeader
+//-----------------------------------------------------------------------------
+
+// HpackHeaderFn that collects a request's header fields.  A malformed request
+// is noted rather than failing the decode, which would have to be treated as
+// a connection error.
+PRStatus Http2Session::AddRequestHeader(void *context,
+                                        const char *name, int nlen,
+                                        const char *value, int vlen)
+{
+    Http2Session *h2 = (Http2Session *) context;
+
+    if (h2->rq.fMalformed)
+        return PR_SUCCESS;
+
+    // Stop collecting fields once the list is over the limit we advertised
+    // (sized as RFC 7540 6.5.2 does).  A small block can expand to far more
+    // than that through the dynamic table, so this can't wait until the
+    // block has been decoded.
+    h2->rq.size += nlen + vlen + 32;
+    if (h2->rq.size > HTTP2_MAX_HEADER_LIST_SIZE) {
+        h2->rq.fMalformed = PR_TRUE;
+        return PR_SUCCESS;
+    }
+
+    for (int i = 0; i < vlen; i++) {
+        if (value[i] == '\r' || value[i] == '\n' || value[i] == '\0') {
+            h2->rq.fMalformed = PR_TRUE;
+            return PR_SUCCESS;
+        }
+    }
+
+    if (nlen > 0 && name[0] == ':') {
+        // Pseudo-header fields must precede regular ones
+        int *offset = NULL;
+        int *len = NULL;
+        if (h2->rq.fRegular) {
+            h2->rq.fMalformed = PR_TRUE;
+        } else if (nlen == 7 && !memcmp(name, ":method", 7)) {
+            offset = &h2->rq.method;
+            len = &h2->rq.methodLen;
+        } else if (nlen == 5 && !memcmp(name, ":path", 5)) {
+            offset = &h2->rq.path;
+            len = &h2->rq.pathLen;
+        } else if (nlen == 10 && !memcmp(name, ":authority", 10)) {
+            offset = &h2->rq.authority;
+            len = &h2->rq.authorityLen;
+        } else if (nlen != 7 || memcmp(name, ":scheme", 7)) {
+            h2->rq.fMalformed = PR_TRUE;
+        }
+
+        if (offset) {
+            if (*offset != -1 || vlen == 0 || (len == &h2->rq.path && value[0] != '/' && (vlen != 1 || value[0] != '*')))
+                h2->rq.fMalformed = PR_TRUE;
+            *offset = h2->rq.values.len;
+            *len = vlen;
+            if (http2_buffer_append(&h2->rq.values, value, vlen) != PR_SUCCESS)
+                h2->rq.fMalformed = PR_TRUE;
+        }
+
+        return PR_SUCCESS;
+    }
+
+    h2->rq.fRegular = PR_TRUE;
+
+    // Field names must be lowercase tokens
+    if (nlen == 0)
+        h2->rq.fMalformed = PR_TRUE;
+    for (int i = 0; i < nlen; i++) {
+        char c = name[i];
+        if ((c >= 'A' && c <= 'Z') || c <= ' ' || c == ':' || c == 0x7f) {
+            h2->rq.fMalformed = PR_TRUE;
+            return PR_SUCCESS;
+        }
+    }
+
+    // Connection-specific fields make the request malformed, and TE may only
+    // say the client accepts trailers
+    if (http2_connection_specific(name, nlen) ||
+        (nlen == 2 && !memcmp(name, "te", 2) &&
+         !http2_token_eq(value, vlen, "trailers")))
+    {
+        h2->rq.fMalformed = PR_TRUE;
+        return PR_SUCCESS;
+    }
+
+    if (nlen == 6 && !memcmp(name, "cookie", 6)) {
+        // Cookie crumbs are joined back into a single Cookie header
+        if (h2->rq.cookie.len && http2_buffer_append(&h2->rq.cookie, "; ", 2) != PR_SUCCESS)
+            h2->rq.fMalformed = PR_TRUE;
+        if (http2_buffer_append(&h2->rq.cookie, value, vlen) != PR_SUCCESS)
+            h2->rq.fMalformed = PR_TRUE;
+        return PR_SUCCESS;
+    }
+
+    if (nlen == 4 && !memcmp(name, "host", 4)) {
+        // Host goes first in the request, and :authority takes precedence
+        if (h2->rq.host == -1) {
+            h2->rq.host = h2->rq.values.len;
+            h2->rq.hostLen = vlen;
+            if (http2_buffer_append(&h2->rq.values, value, vlen) != PR_SUCCESS)
+                h2->rq.fMalformed = PR_TRUE;
+        }
+        return PR_SUCCESS;
+    }
+
+    if (nlen == 14 && !memcmp(name, "content-length", 14))
+        h2->rq.fContentLength = PR_TRUE;
+
+    if (http2_buffer_reserve(&h2->rq.fields, nlen + 2 + vlen + 2) != PR_SUCCESS) {
+        h2->rq.fMalformed = PR_TRUE;
+        return PR_SUCCESS;
+    }
+    char *p = h2->rq.fields.p + h2->rq.fields.len;
+    memcpy(p, name, nlen);
+    p += nlen;
+    *p++ = ':';
+    *p++ = ' ';
+    memcpy(p, value, vlen);
+    p += vlen;
+    *p++ = '\r';
+    *p++ = '\n';
+    h2->rq.fields.len = p - h2->rq.fields.p;
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ProcessSettings
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::ProcessSettings(PRUint8 flags, PRUint32 id,
+                                       const unsigned char *payload, int len)
+{
+    if (id != 0)
+        return PR_FAILURE;
+
+    if (flags & HTTP2_FLAG_ACK) {
+        if (len != 0)
+            ConnectionError(HTTP2_FRAME_SIZE_ERROR);
+        return PR_SUCCESS;
+    }
+
+    if (len % 6) {
+        ConnectionError(HTTP2_FRAME_SIZE_ERROR);
+        return PR_SUCCESS;
+    }
+
+    if (ApplySettings(payload, len) != PR_SUCCESS)
+        return PR_SUCCESS;
+
+    QueueFrame(HTTP2_SETTINGS, HTTP2_FLAG_ACK, 0, NULL, 0);
+    fSettings = PR_TRUE;
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ApplySettings
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::ApplySettings(const unsigned char *payload, int len)
+{
+    for (int i = 0; i + 6 <= len; i += 6) {
+        PRUint16 setting = (payload[i] << 8) | payload[i + 1];
+        PRUint32 value = http2_get_uint32(payload + i + 2);
+
+        switch (setting) {
+        case HTTP2_SETTINGS_HEADER_TABLE_SIZE:
+            encoder.SetMaxTableSize(value);
+            break;
+
+        case HTTP2_SETTINGS_ENABLE_PUSH:
+            if (value > 1) {
+                ConnectionError(HTTP2_PROTOCOL_ERROR);
+                return PR_FAILURE;
+            }
+            break;
+
+        case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE:
+            if (value > HTTP2_MAX_WINDOW) {
+                ConnectionError(HTTP2_FLOW_CONTROL_ERROR);
+                return PR_FAILURE;
+            } else {
+                // The change applies to every open stream, and must not
+                // take any of their windows past the maximum
+                PRInt32 delta = (PRInt32) value - peerInitialWindow;
+                if (delta > 0) {
+                    for (Http2Stream *stream = streams; stream; stream = stream->next) {
+                        if (stream->sendWindow > HTTP2_MAX_WINDOW - delta) {
+                            ConnectionError(HTTP2_FLOW_CONTROL_ERROR);
+                            return PR_FAILURE;
+                        }
+                    }
+                }
+                peerInitialWindow = value;
+                for (Http2Stream *stream = streams; stream; stream = stream->next)
+                    stream->sendWindow += delta;
+            }
+            break;
+
+        case HTTP2_SETTINGS_MAX_FRAME_SIZE:
+            if (value < 16384 || value > 16777215) {
+                ConnectionError(HTTP2_PROTOCOL_ERROR);
+                return PR_FAILURE;
+            }
+            break;
+        }
+    }
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ProcessWindowUpdate
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::ProcessWindowUpdate(PRUint32 id,
+                                           const unsigned char *payload, int len)
+{
+    if (len != 4) {
+        ConnectionError(HTTP2_FRAME_SIZE_ERROR);
+        return PR_SUCCESS;
+    }
+
+    PRInt32 increment = http2_get_uint32(payload) & 0x7fffffff;
+
+    if (id == 0) {
+        if (increment == 0)
+            return PR_FAILURE;
+        if (sendWindow > HTTP2_MAX_WINDOW - increment) {
+            ConnectionError(HTTP2_FLOW_CONTROL_ERROR);
+            return PR_SUCCESS;
+        }
+        sendWindow += increment;
+    } else if (Http2Stream *stream = FindStream(id)) {
+        if (increment == 0) {
+            ResetStream(id, HTTP2_PROTOCOL_ERROR);
+        } else if (stream->sendWindow > HTTP2_MAX_WINDOW - increment) {
+            ResetStream(id, HTTP2_FLOW_CONTROL_ERROR);
+        } else {
+            stream->sendWindow += increment;
+        }
+    } else if (id > lastStreamId) {
+        return PR_FAILURE;
+    }
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::QueueFrame
+//-----------------------------------------------------------------------------
+
+// Called with lock held
+void Http2Session::QueueFrame(PRUint8 type, PRUint8 flags, PRUint32 id,
+                              const void *payload, int len)
+{
+    if (fClosed)
+        return;
+
+    if (http2_buffer_reserve(&obuf, HTTP2_FRAME_HEADER_SIZE + len) != PR_SUCCESS) {
+        // Without the frame the client and we would disagree about the
+        // state of the connection
+        fClosed = PR_TRUE;
+        PR_NotifyAllCondVar(cv);
+        return;
+    }
+
+    unsigned char *p = (unsigned char *) obuf.p + obuf.len;
+    p = http2_put_frame_header(p, type, flags, id, len);
+    if (len > 0)
+        memcpy(p, payload, len);
+    obuf.len += HTTP2_FRAME_HEADER_SIZE + len;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Flush
+//-----------------------------------------------------------------------------
+
+// Write the queued frames.  Called without lock held.
+PRStatus Http2Session::Flush()
+{
+    PR_Lock(sendLock);
+
+    // Take the queued frames so other threads can carry on queueing while
+    // we write
+    PR_Lock(lock);
+    Http2Buffer tmp = wbuf;
+    wbuf = obuf;
+    obuf = tmp;
+    obuf.len = 0;
+    PRBool fFailed = fClosed;
+    PR_Unlock(lock);
+
+    PRStatus rv = PR_SUCCESS;
+    if (fFailed) {
+        PR_SetError(PR_CONNECT_RESET_ERROR, 0);
+        rv = PR_FAILURE;
+    } else if (wbuf.len > 0) {
+        if (PR_Send(conn->fd, wbuf.p, wbuf.len, 0, DaemonSession::GetIOTimeout()) != wbuf.len) {
+            Closed();
+            rv = PR_FAILURE;
+        }
+    }
+    wbuf.len = 0;
+
+    PR_Unlock(sendLock);
+
+    return rv;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Closed
+//-----------------------------------------------------------------------------
+
+// Note that the connection can't be used any more.  Called without lock held.
+void Http2Session::Closed()
+{
+    PR_Lock(lock);
+    fClosed = PR_TRUE;
+    PR_NotifyAllCondVar(cv);
+    PR_Unlock(lock);
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ConnectionError
+//-----------------------------------------------------------------------------
+
+// Called with lock held.  The GOAWAY goes out with the next Flush.
+void Http2Session::ConnectionError(PRUint32 code)
+{
+    if (fError)
+        return;
+
+    ereport(LOG_VERBOSE,
+            "Closing HTTP/2 connection from %s (error %d)",
+            conn->remoteIP.buf, code);
+
+    if (!fGoawaySent) {
+        unsigned char goaway[8];
+        http2_put_uint32(goaway, lastStreamId);
+        http2_put_uint32(goaway + 4, code);
+        QueueFrame(HTTP2_GOAWAY, 0, 0, goaway, sizeof(goaway));
+        fGoawaySent = PR_TRUE;
+    }
+
+    fError = PR_TRUE;
+    PR_NotifyAllCondVar(cv);
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::ResetStream
+//-----------------------------------------------------------------------------
+
+// Called with lock held
+void Http2Session::ResetStream(PRUint32 id, PRUint32 code)
+{
+    unsigned char payload[4];
+    http2_put_uint32(payload, code);
+    QueueFrame(HTTP2_RST_STREAM, 0, id, payload, sizeof(payload));
+
+    if (Http2Stream *stream = FindStream(id)) {
+        if (stream->fRunning) {
+            stream->fReset = PR_TRUE;
+        } else {
+            RemoveStream(stream);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::SendWindowUpdate
+//-----------------------------------------------------------------------------
+
+// Called with lock held
+void Http2Session::SendWindowUpdate(PRUint32 id, PRInt32 increment)
+{
+    unsigned char payload[4];
+    http2_put_uint32(payload, increment);
+    QueueFrame(HTTP2_WINDOW_UPDATE, 0, id, payload, sizeof(payload));
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Credit
+//-----------------------------------------------------------------------------
+
+// Return DATA that's been consumed or discarded to the connection's receive
+// window.  Called with lock held.
+void Http2Session::Credit(PRInt32 credit)
+{
+    recvPending += credit;
+    if (recvPending >= HTTP2_CONNECTION_UPDATE_THRESHOLD) {
+        recvWindow += recvPending;
+        SendWindowUpdate(0, recvPending);
+        recvPending = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::AddStream
+//-----------------------------------------------------------------------------
+
+Http2Stream *Http2Session::AddStream(PRUint32 id)
+{
+    Http2Stream *stream = (Http2Stream *) PERM_MALLOC(sizeof(Http2Stream));
+    if (!stream)
+        return NULL;
+
+    memset(stream, 0, sizeof(*stream));
+    stream->id = id;
+    stream->session = this;
+    stream->recvWindow = HTTP2_DEFAULT_WINDOW;
+    stream->sendWindow = peerInitialWindow;
+
+    if (streamsTail) {
+        streamsTail->next = stream;
+    } else {
+        streams = stream;
+    }
+    streamsTail = stream;
+    nStreams++;
+
+    return stream;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::FindStream
+//-----------------------------------------------------------------------------
+
+Http2Stream *Http2Session::FindStream(PRUint32 id)
+{
+    for (Http2Stream *stream = streams; stream; stream = stream->next) {
+        if (stream->id == id)
+            return stream;
+    }
+
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::RemoveStream
+//-----------------------------------------------------------------------------
+
+// Called with lock held.  Whatever the stream's request didn't read is
+// credited back to the connection.
+void Http2Session::RemoveStream(Http2Stream *stream)
+{
+    Http2Stream *prev = NULL;
+    for (Http2Stream *s = streams; s != stream; s = s->next)
+        prev = s;
+
+    if (prev) {
+        prev->next = stream->next;
+    } else {
+        streams = stream->next;
+    }
+    if (streamsTail == stream)
+        streamsTail = prev;
+    nStreams--;
+
+    PRInt32 credit = 0;
+    for (Http2Chunk *chunk = stream->body; chunk; chunk = chunk->next)
+        credit += chunk->credit;
+    if (credit > 0)
+        Credit(credit);
+
+    http2_stream_free(stream);
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::DispatchStreams
+//-----------------------------------------------------------------------------
+
+// Hand the streams that have arrived to DaemonSessions
+void Http2Session::DispatchStreams()
+{
+    ConnectionQueue *queue = conn->connQueue;
+
+    for (;;) {
+        PR_Lock(lock);
+
+        Http2Stream *stream = streams;
+        while (stream && stream->fRunning)
+            stream = stream->next;
+
+        if (stream) {
+            // A DaemonSession running an HTTP/2 connection can't run its
+            // streams as well, so if every DaemonSession may end up doing
+            // that, refuse the stream rather than queue it to wait forever
+            if (!wakeup)
+                wakeup = PR_NewPollableEvent();
+            if (!wakeup || fError || fClosed ||
+                DaemonSession::GetActiveSessions() + (PRInt32) queue->GetLength() >= DaemonSession::GetMaxSessions())
+            {
+                ResetStream(stream->id, HTTP2_REFUSED_STREAM);
+                PR_Unlock(lock);
+                continue;
+            }
+
+            stream->fRunning = PR_TRUE;
+            nRunning++;
+        }
+
+        PR_Unlock(lock);
+
+        if (!stream)
+            break;
+
+        StartStream(stream);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::StartStream
+//-----------------------------------------------------------------------------
+
+// Queue a stream's request for a DaemonSession on a Connection whose socket
+// is the stream IO layer
+void Http2Session::StartStream(Http2Stream *stream)
+{
+    ConnectionQueue *queue = conn->connQueue;
+
+    Connection *sconn = queue->GetUnused();
+    PRFileDesc *layer = NULL;
+    if (sconn)
+        layer = PR_CreateIOLayerStub(identity, &methods);
+    if (!layer) {
+        if (sconn)
+            queue->AddUnused(sconn);
+        PR_Lock(lock);
+        stream->fRefused = PR_TRUE;
+        PR_Unlock(lock);
+        FinishStream(stream);
+        return;
+    }
+
+    // The socket beneath the layer answers questions about the connection,
+    // such as its addresses and SSL status
+    layer->secret = (PRFilePrivate *) stream;
+    layer->lower = conn->fd;
+
+    sconn->createStream(layer, conn);
+
+    if (queue->AddReady(sconn) != PR_SUCCESS) {
+        // Closing the layer finishes the stream
+        PR_Lock(lock);
+        stream->fRefused = PR_TRUE;
+        PR_Unlock(lock);
+        sconn->destroy();
+        return;
+    }
+
+    DaemonSession::PostThreads();
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::FinishStream
+//-----------------------------------------------------------------------------
+
+// End a stream once HttpRequest is done with it.  Called without lock held.
+// The session may be gone once this returns.
+void Http2Session::FinishStream(Http2Stream *stream)
+{
+    Http2Response *rsp = &stream->rsp;
+
+    PR_Lock(lock);
+
+    stream->fShutdown = PR_TRUE;
+
+    if (stream->fRefused) {
+        unsigned char payload[4];
+        http2_put_uint32(payload, HTTP2_REFUSED_STREAM);
+        QueueFrame(HTTP2_RST_STREAM, 0, stream->id, payload, sizeof(payload));
+    } else if (!stream->fReset && !fError && !fClosed) {
+        if (!rsp->fEndStreamSent) {
+            if (rsp->state == HTTP2_RSP_BODY_CLOSE) {
+                QueueFrame(HTTP2_DATA, HTTP2_FLAG_END_STREAM, stream->id, NULL, 0);
+                rsp->fEndStreamSent = PR_TRUE;
+            } else {
+                // Incomplete response
+                unsigned char payload[4];
+                http2_put_uint32(payload, HTTP2_INTERNAL_ERROR);
+                QueueFrame(HTTP2_RST_STREAM, 0, stream->id, payload, sizeof(payload));
+            }
+        }
+
+        // Tell the client to stop sending a body we didn't read
+        if (rsp->fEndStreamSent && !stream->fEndStream) {
+            unsigned char payload[4];
+            http2_put_uint32(payload, HTTP2_NO_ERROR);
+            QueueFrame(HTTP2_RST_STREAM, 0, stream->id, payload, sizeof(payload));
+        }
+    }
+
+    // Whatever body wasn't read goes back to the connection's window
+    PRInt32 credit = 0;
+    while (Http2Chunk *chunk = stream->body) {
+        credit += chunk->credit;
+        stream->body = chunk->next;
+        PERM_FREE(chunk);
+    }
+    stream->bodyTail = NULL;
+    if (credit > 0)
+        Credit(credit);
+
+    PR_Unlock(lock);
+
+    Flush();
+
+    PR_Lock(lock);
+
+    RemoveStream(stream);
+
+    // When the last stream is done, the connection's DaemonSession may be
+    // waiting to give the connection to the keep-alive subsystem or to close
+    // it.  That's signalled with the pollable event rather than cv because
+    // NSPR notifies condition variables after releasing the lock, by which
+    // time the session may have been deleted.
+    PR_ASSERT(nRunning > 0);
+    if (--nRunning == 0) {
+        conn->fd->higher = NULL;
+        PR_SetPollableEvent(wakeup);
+    }
+
+    PR_Unlock(lock);
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Respond
+//-----------------------------------------------------------------------------
+
+// Parse the HTTP/1.1 response HttpRequest is writing and pass it on as
+// HTTP/2 frames
+PRStatus Http2Session::Respond(Http2Stream *stream, const char *p, int len)
+{
+    Http2Response *rsp = &stream->rsp;
+
+    while (len > 0) {
+        int n;
+
+        switch (rsp->state) {
+        case HTTP2_RSP_HEADER: {
+            int start = rsp->header.len;
+            if (start + len > HTTP2_MAX_RESPONSE_HEADER) {
+                PR_SetError(PR_BUFFER_OVERFLOW_ERROR, 0);
+                return PR_FAILURE;
+            }
+            if (http2_buffer_append(&rsp->header, p, len) != PR_SUCCESS)
+                return PR_FAILURE;
+
+            // Look for the end of the header
+            const char *h = rsp->header.p;
+            int i = rsp->scan;
+            while (i + 4 <= rsp->header.len && memcmp(h + i, "\r\n\r\n", 4))
+                i++;
+            if (i + 4 > rsp->header.len) {
+                rsp->scan = i;
+                return PR_SUCCESS;
+            }
+
+            n = i + 4 - start;
+            rsp->header.len = i + 4;
+            rsp->scan = 0;
+            if (SendResponseHeaders(stream) != PR_SUCCESS)
+                return PR_FAILURE;
+            break;
+        }
+
+        case HTTP2_RSP_BODY_LENGTH:
+            n = len;
+            if (n > rsp->remaining)
+                n = rsp->remaining;
+            rsp->remaining -= n;
+            if (SendData(stream, p, n, rsp->remaining == 0) != PR_SUCCESS)
+                return PR_FAILURE;
+            if (rsp->remaining == 0)
+                rsp->state = HTTP2_RSP_DONE;
+            break;
+
+        case HTTP2_RSP_BODY_CLOSE:
+            n = len;
+            if (SendData(stream, p, n, PR_FALSE) != PR_SUCCESS)
+                return PR_FAILURE;
+            break;
+
+        case HTTP2_RSP_CHUNK_SIZE:
+            // rsp->scan is set once we're past the hex digits
+            n = 1;
+            if (*p == '\n') {
+                if (rsp->remaining) {
+                    rsp->state = HTTP2_RSP_CHUNK_DATA;
+                } else {
+                    rsp->state = HTTP2_RSP_TRAILER;
+                }
+                rsp->scan = 0;
+            } else if (!rsp->scan && isxdigit((unsigned char) *p)) {
+                if (rsp->remaining > (PR_INT32_MAX >> 4)) {
+                    PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+                    return PR_FAILURE;
+                }
+                int c = *p;
+                int v = (c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10;
+                rsp->remaining = (rsp->remaining << 4) | v;
+            } else {
+                rsp->scan = 1;
+            }
+            break;
+
+        case HTTP2_RSP_CHUNK_DATA:
+            n = len;
+            if (n > rsp->remaining)
+                n = rsp->remaining;
+            rsp->remaining -= n;
+            if (SendData(stream, p, n, PR_FALSE) != PR_SUCCESS)
+                return PR_FAILURE;
+            if (rsp->remaining == 0)
+                rsp->state = HTTP2_RSP_CHUNK_CRLF;
+            break;
+
+        case HTTP2_RSP_CHUNK_CRLF:
+            n = 1;
+            if (*p == '\n')
+                rsp->state = HTTP2_RSP_CHUNK_SIZE;
+            break;
+
+        case HTTP2_RSP_TRAILER:
+            // rsp->scan counts the characters on the current trailer line
+            n = 1;
+            if (*p == '\n') {
+                if (rsp->scan == 0) {
+                    rsp->state = HTTP2_RSP_DONE;
+                    if (SendData(stream, NULL, 0, PR_TRUE) != PR_SUCCESS)
+                        return PR_FAILURE;
+                }
+                rsp->scan = 0;
+            } else if (*p != '\r') {
+                rsp->scan++;
+            }
+            break;
+
+        default:
+            // Anything after the end of the response is discarded
+            n = len;
+            break;
+        }
+
+        p += n;
+        len -= n;
+    }
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::SendResponseHeaders
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::SendResponseHeaders(Http2Stream *stream)
+{
+    Http2Response *rsp = &stream->rsp;
+    char *h = rsp->header.p;
+    char *end = h + rsp->header.len - 2;
+
+    // Status-Line
+    char *eol = (char *) memchr(h, '\n', end - h);
+    char *sp = eol ? (char *) memchr(h, ' ', eol - h) : NULL;
+    if (!sp || eol - sp < 4 ||
+        !isdigit(sp[1]) || !isdigit(sp[2]) || !isdigit(sp[3]))
+    {
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return PR_FAILURE;
+    }
+    int status = (sp[1] - '0') * 100 + (sp[2] - '0') * 10 + (sp[3] - '0');
+
+    // The encoded block is never longer than the HTTP/1.1 header
+    rsp->block.len = 0;
+    if (http2_buffer_reserve(&rsp->block, rsp->header.len + 32) != PR_SUCCESS)
+        return PR_FAILURE;
+
+    // Streams share the HPACK encoder, so a block must be queued in the same
+    // hold of lock that encodes it
+    PR_Lock(lock);
+
+    if (fError || fClosed || stream->fReset) {
+        PR_Unlock(lock);
+        PR_SetError(PR_CONNECT_RESET_ERROR, 0);
+        return PR_FAILURE;
+    }
+
+    unsigned char *b = (unsigned char *) rsp->block.p;
+    b = encoder.Begin(b);
+    b = encoder.EncodeStatus(b, status);
+
+    PRBool fChunked = PR_FALSE;
+    PRInt64 contentLength = -1;
+
+    for (char *line = eol + 1; line < end; line = eol + 1) {
+        eol = (char *) memchr(line, '\n', end - line);
+        if (!eol)
+            eol = end;
+
+        char *colon = (char *) memchr(line, ':', eol - line);
+        if (!colon || colon == line)
+            continue;
+
+        int nlen = colon - line;
+        for (int i = 0; i < nlen; i++)
+            line[i] = tolower(line[i]);
+
+        char *value = colon + 1;
+        char *vend = eol;
+        while (value < vend && (*value == ' ' || *value == '\t'))
+            value++;
+        while (vend > value && (vend[-1] == '\r' || vend[-1] == ' ' || vend[-1] == '\t'))
+            vend--;
+        int vlen = vend - value;
+
+        if (nlen == 17 && !memcmp(line, "transfer-encoding", 17)) {
+            fChunked = (vlen >= 7 && !strncasecmp(vend - 7, "chunked", 7));
+            continue;
+        }
+        if (http2_connection_specific(line, nlen))
+            continue;
+        if (nlen == 14 && !memcmp(line, "content-length", 14))
+            contentLength = util_atoi64(value);
+
+        int size = HpackEncoder::GetMaxEncodedLength(nlen, vlen);
+        int used = b - (unsigned char *) rsp->block.p;
+        if (used + size > rsp->block.size) {
+            rsp->block.len = used;
+            if (http2_buffer_reserve(&rsp->block, size) != PR_SUCCESS) {
+                // The encoder has moved on without the client's decoder
+                ConnectionError(HTTP2_INTERNAL_ERROR);
+                PR_Unlock(lock);
+                return PR_FAILURE;
+            }
+            b = (unsigned char *) rsp->block.p + used;
+        }
+
+        b = encoder.EncodeHeader(b, line, nlen, value, vlen);
+    }
+
+    rsp->block.len = b - (unsigned char *) rsp->block.p;
+    rsp->header.len = 0;
+
+    PRBool fEndStream = PR_FALSE;
+    if (status < 200) {
+        // Interim response; the final response follows
+        rsp->state = HTTP2_RSP_HEADER;
+    } else if (stream->fHead || status == 204 || status == 304) {
+        rsp->state = HTTP2_RSP_DONE;
+        fEndStream = PR_TRUE;
+    } else if (fChunked) {
+        rsp->state = HTTP2_RSP_CHUNK_SIZE;
+        rsp->remaining = 0;
+        rsp->scan = 0;
+    } else if (contentLength == 0) {
+        rsp->state = HTTP2_RSP_DONE;
+        fEndStream = PR_TRUE;
+    } else if (contentLength > 0) {
+        rsp->state = HTTP2_RSP_BODY_LENGTH;
+        rsp->remaining = contentLength;
+    } else {
+        rsp->state = HTTP2_RSP_BODY_CLOSE;
+    }
+
+    // HEADERS, then CONTINUATION frames for the rest of a large block
+    const char *p = rsp->block.p;
+    int len = rsp->block.len;
+    PRUint8 type = HTTP2_HEADERS;
+    PRUint8 flags = fEndStream ? HTTP2_FLAG_END_STREAM : 0;
+    do {
+        int n = len;
+        if (n > HTTP2_FRAME_SIZE) {
+            n = HTTP2_FRAME_SIZE;
+        } else {
+            flags |= HTTP2_FLAG_END_HEADERS;
+        }
+        QueueFrame(type, flags, stream->id, p, n);
+        p += n;
+        len -= n;
+        type = HTTP2_CONTINUATION;
+        flags = 0;
+    } while (len > 0);
+
+    if (fEndStream)
+        rsp->fEndStreamSent = PR_TRUE;
+
+    PR_Unlock(lock);
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// http2_wait
+//-----------------------------------------------------------------------------
+
+// Wait on cv for what's left of timeout since epoch.  Fails with
+// PR_IO_TIMEOUT_ERROR once timeout has elapsed.
+static PRStatus http2_wait(PRCondVar *cv, PRIntervalTime epoch, PRIntervalTime timeout)
+{
+    if (timeout != PR_INTERVAL_NO_TIMEOUT) {
+        PRIntervalTime elapsed = PR_IntervalNow() - epoch;
+        if (elapsed >= timeout) {
+            PR_SetError(PR_IO_TIMEOUT_ERROR, 0);
+            return PR_FAILURE;
+        }
+        timeout -= elapsed;
+    }
+
+    PR_WaitCondVar(cv, timeout);
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::WaitForWindow
+//-----------------------------------------------------------------------------
+
+// Wait until the stream may send DATA.  Called with lock held; drops it to
+// flush, so the caller must not hold sendLock.
+PRStatus Http2Session::WaitForWindow(Http2Stream *stream)
+{
+    PRIntervalTime epoch = PR_IntervalNow();
+
+    for (;;) {
+        if (fError || fClosed || stream->fReset) {
+            PR_SetError(PR_CONNECT_RESET_ERROR, 0);
+            return PR_FAILURE;
+        }
+
+        if (sendWindow > 0 && stream->sendWindow > 0)
+            return PR_SUCCESS;
+
+        // The client won't open the window for DATA it hasn't seen
+        if (obuf.len > 0) {
+            PR_Unlock(lock);
+            PRStatus rv = Flush();
+            PR_Lock(lock);
+            if (rv != PR_SUCCESS)
+                return PR_FAILURE;
+            continue;
+        }
+
+        // The connection's DaemonSession notifies us as WINDOW_UPDATEs arrive
+        if (http2_wait(cv, epoch, DaemonSession::GetIOTimeout()) != PR_SUCCESS)
+            return PR_FAILURE;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::SendData
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::SendData(Http2Stream *stream, const char *p, int len, PRBool fLast)
+{
+    Http2Response *rsp = &stream->rsp;
+
+    if (len == 0) {
+        if (fLast) {
+            PR_Lock(lock);
+            QueueFrame(HTTP2_DATA, HTTP2_FLAG_END_STREAM, stream->id, NULL, 0);
+            rsp->fEndStreamSent = PR_TRUE;
+            PR_Unlock(lock);
+        }
+        return PR_SUCCESS;
+    }
+
+    while (len > 0) {
+        PR_Lock(lock);
+
+        if (WaitForWindow(stream) != PR_SUCCESS) {
+            PR_Unlock(lock);
+            return PR_FAILURE;
+        }
+
+        int n = len;
+        if (n > HTTP2_FRAME_SIZE)
+            n = HTTP2_FRAME_SIZE;
+        if (n > sendWindow)
+            n = sendWindow;
+        if (n > stream->sendWindow)
+            n = stream->sendWindow;
+        sendWindow -= n;
+        stream->sendWindow -= n;
+
+        PRUint8 flags = 0;
+        if (fLast && n == len) {
+            flags = HTTP2_FLAG_END_STREAM;
+            rsp->fEndStreamSent = PR_TRUE;
+        }
+
+        // Small frames are queued with the rest.  Larger ones are sent along
+        // with whatever is queued without copying the data.
+        PRBool fQueued = (obuf.len + HTTP2_FRAME_HEADER_SIZE + n <= HTTP2_BUFFER_SIZE);
+        if (fQueued)
+            QueueFrame(HTTP2_DATA, flags, stream->id, p, n);
+
+        PR_Unlock(lock);
+
+        if (!fQueued && SendDataFrame(stream, flags, p, NULL, 0, n) != PR_SUCCESS)
+            return PR_FAILURE;
+
+        p += n;
+        len -= n;
+    }
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::SendFileData
+//-----------------------------------------------------------------------------
+
+PRStatus Http2Session::SendFileData(Http2Stream *stream, PRFileDesc *fd, PRInt64 offset, PRInt64 len)
+{
+    Http2Response *rsp = &stream->rsp;
+
+    while (len > 0) {
+        if (rsp->state != HTTP2_RSP_BODY_LENGTH &&
+            rsp->state != HTTP2_RSP_BODY_CLOSE &&
+            rsp->state != HTTP2_RSP_CHUNK_DATA)
+        {
+            // Not body data (or not only body data), so parse it as if it
+            // had been written
+            char buffer[8192];
+            PRInt32 n = sizeof(buffer);
+            if (n > len)
+                n = len;
+            if (PR_Seek64(fd, offset, PR_SEEK_SET) == -1)
+                return PR_FAILURE;
+            n = PR_Read(fd, buffer, n);
+            if (n <= 0) {
+                if (n == 0)
+                    PR_SetError(PR_END_OF_FILE_ERROR, 0);
+                return PR_FAILURE;
+            }
+            if (Respond(stream, buffer, n) != PR_SUCCESS)
+                return PR_FAILURE;
+            offset += n;
+            len -= n;
+            continue;
+        }
+
+        PR_Lock(lock);
+
+        if (WaitForWindow(stream) != PR_SUCCESS) {
+            PR_Unlock(lock);
+            return PR_FAILURE;
+        }
+
+        PRInt64 n = len;
+        if (rsp->state != HTTP2_RSP_BODY_CLOSE && n > rsp->remaining)
+            n = rsp->remaining;
+        if (n > HTTP2_FRAME_SIZE)
+            n = HTTP2_FRAME_SIZE;
+        if (n > sendWindow)
+            n = sendWindow;
+        if (n > stream->sendWindow)
+            n = stream->sendWindow;
+        sendWindow -= n;
+        stream->sendWindow -= n;
+
+        PR_Unlock(lock);
+
+        PRUint8 flags = 0;
+        if (rsp->state == HTTP2_RSP_BODY_LENGTH && n == rsp->remaining) {
+            flags = HTTP2_FLAG_END_STREAM;
+            rsp->fEndStreamSent = PR_TRUE;
+        }
+
+        if (SendDataFrame(stream, flags, NULL, fd, offset, n) != PR_SUCCESS)
+            return PR_FAILURE;
+
+        offset += n;
+        len -= n;
+
+        if (rsp->state != HTTP2_RSP_BODY_CLOSE) {
+            rsp->remaining -= n;
+            if (rsp->remaining == 0) {
+                if (rsp->state == HTTP2_RSP_BODY_LENGTH) {
+                    rsp->state = HTTP2_RSP_DONE;
+                } else {
+                    rsp->state = HTTP2_RSP_CHUNK_CRLF;
+                }
+            }
+        }
+    }
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::SendDataFrame
+//-----------------------------------------------------------------------------
+
+// Write the queued frames followed by a DATA frame whose payload is either p
+// or a slice of fd, which is sent without being copied.  The frame has
+// already been charged to the flow control windows.
+PRStatus Http2Session::SendDataFrame(Http2Stream *stream, PRUint8 flags,
+                                     const char *p, PRFileDesc *fd, PRInt64 offset, int n)
+{
+    PR_Lock(sendLock);
+
+    // Put the frame header after the queued frames and take them, as Flush
+    // does.  A reset stream doesn't get its frame, and the window it was
+    // charged goes back to the connection.
+    PR_Lock(lock);
+    PRBool fFailed = (fError || fClosed || stream->fReset);
+    if (fFailed) {
+        sendWindow += n;
+    } else if (http2_buffer_reserve(&obuf, HTTP2_FRAME_HEADER_SIZE) != PR_SUCCESS) {
+        fClosed = PR_TRUE;
+        PR_NotifyAllCondVar(cv);
+        fFailed = PR_TRUE;
+    } else {
+        http2_put_frame_header((unsigned char *) obuf.p + obuf.len, HTTP2_DATA, flags, stream->id, n);
+        obuf.len += HTTP2_FRAME_HEADER_SIZE;
+        Http2Buffer tmp = wbuf;
+        wbuf = obuf;
+        obuf = tmp;
+        obuf.len = 0;
+    }
+    PR_Unlock(lock);
+
+    PRStatus rv = PR_SUCCESS;
+    if (fFailed) {
+        PR_SetError(PR_CONNECT_RESET_ERROR, 0);
+        rv = PR_FAILURE;
+    } else {
+        PRInt32 sent;
+        if (fd) {
+            PRSendFileData sfd;
+            sfd.fd = fd;
+            sfd.file_offset = offset;
+            sfd.file_nbytes = n;
+            sfd.header = wbuf.p;
+            sfd.hlen = wbuf.len;
+            sfd.trailer = NULL;
+            sfd.tlen = 0;
+            sent = PR_SendFile(conn->fd, &sfd, PR_TRANSMITFILE_KEEP_OPEN, DaemonSession::GetIOTimeout());
+        } else {
+            PRIOVec iov[2];
+            iov[0].iov_base = wbuf.p;
+            iov[0].iov_len = wbuf.len;
+            iov[1].iov_base = (char *) p;
+            iov[1].iov_len = n;
+            sent = PR_Writev(conn->fd, iov, 2, DaemonSession::GetIOTimeout());
+        }
+        if (sent != wbuf.len + n) {
+            Closed();
+            rv = PR_FAILURE;
+        }
+    }
+    wbuf.len = 0;
+
+    PR_Unlock(sendLock);
+
+    return rv;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Write
+//-----------------------------------------------------------------------------
+
+PRInt32 Http2Session::Write(Http2Stream *stream, const PRIOVec *iov, int iovcnt)
+{
+    PRInt32 total = 0;
+
+    for (int i = 0; i < iovcnt; i++) {
+        if (Respond(stream, iov[i].iov_base, iov[i].iov_len) != PR_SUCCESS) {
+            AbortResponse(stream);
+            return -1;
+        }
+        total += iov[i].iov_len;
+    }
+
+    if (Flush() != PR_SUCCESS)
+        return -1;
+
+    return total;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::AbortResponse
+//-----------------------------------------------------------------------------
+
+// Reset a stream after a failed write so that a truncated response isn't
+// mistaken for a complete one
+void Http2Session::AbortResponse(Http2Stream *stream)
+{
+    PRErrorCode prerr = PR_GetError();
+    PRInt32 oserr = PR_GetOSError();
+
+    PR_Lock(lock);
+    if (!stream->fReset && !stream->rsp.fEndStreamSent && !fError && !fClosed)
+        ResetStream(stream->id, HTTP2_INTERNAL_ERROR);
+    PR_Unlock(lock);
+
+    PR_SetError(prerr, oserr);
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::SendFile
+//-----------------------------------------------------------------------------
+
+PRInt32 Http2Session::SendFile(Http2Stream *stream, PRSendFileData *sfd)
+{
+    PRInt64 nbytes = sfd->file_nbytes;
+    if (nbytes == 0) {
+        PRFileInfo64 info;
+        if (PR_GetOpenFileInfo64(sfd->fd, &info) != PR_SUCCESS)
+            return -1;
+        nbytes = info.size - sfd->file_offset;
+    }
+
+    if ((sfd->hlen > 0 && Respond(stream, (const char *) sfd->header, sfd->hlen) != PR_SUCCESS) ||
+        (nbytes > 0 && SendFileData(stream, sfd->fd, sfd->file_offset, nbytes) != PR_SUCCESS) ||
+        (sfd->tlen > 0 && Respond(stream, (const char *) sfd->trailer, sfd->tlen) != PR_SUCCESS))
+    {
+        AbortResponse(stream);
+        return -1;
+    }
+
+    if (Flush() != PR_SUCCESS)
+        return -1;
+
+    PRInt64 total = sfd->hlen + nbytes + sfd->tlen;
+    if (total > PR_INT32_MAX)
+        total = PR_INT32_MAX;
+
+    return total;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Read
+//-----------------------------------------------------------------------------
+
+PRInt32 Http2Session::Read(Http2Stream *stream, void *buf, PRInt32 amount, PRBool fPeek, PRIntervalTime timeout)
+{
+    PR_Lock(lock);
+
+    if (fError || fClosed || stream->fReset) {
+        PR_Unlock(lock);
+        PR_SetError(PR_CONNECT_RESET_ERROR, 0);
+        return -1;
+    }
+
+    // The request header comes first, on its own
+    if (stream->requestPos < stream->requestLen) {
+        PRInt32 n = stream->requestLen - stream->requestPos;
+        if (n > amount)
+            n = amount;
+        memcpy(buf, stream->request + stream->requestPos, n);
+        if (!fPeek)
+            stream->requestPos += n;
+        PR_Unlock(lock);
+        return n;
+    }
+
+    // Wait for body data.  The connection's DaemonSession notifies us as it
+    // arrives.
+    PRIntervalTime epoch = PR_IntervalNow();
+    while (!stream->body) {
+        if (fError || fClosed || stream->fReset) {
+            PR_Unlock(lock);
+            PR_SetError(PR_CONNECT_RESET_ERROR, 0);
+            return -1;
+        }
+
+        // Once the response is complete, whatever the client hasn't sent
+        // yet won't be read
+        if (stream->fEndStream || stream->rsp.fEndStreamSent || stream->fShutdown) {
+            PR_Unlock(lock);
+            return 0;
+        }
+
+        if (http2_wait(cv, epoch, timeout) != PR_SUCCESS) {
+            PR_Unlock(lock);
+            return -1;
+        }
+    }
+
+    PRInt32 n = 0;
+    PRInt32 credit = 0;
+    Http2Chunk *chunk = stream->body;
+    while (chunk && n < amount) {
+        int len = chunk->len - chunk->pos;
+        if (len > amount - n)
+            len = amount - n;
+        memcpy((char *) buf + n, chunk->data + chunk->pos, len);
+        n += len;
+
+        if (fPeek) {
+            chunk = chunk->next;
+            continue;
+        }
+
+        chunk->pos += len;
+        if (chunk->pos == chunk->len) {
+            credit += chunk->credit;
+            stream->body = chunk->next;
+            if (!stream->body)
+                stream->bodyTail = NULL;
+            PERM_FREE(chunk);
+            chunk = stream->body;
+        }
+    }
+
+    // Let the client send more once we've drained enough
+    if (credit > 0) {
+        Credit(credit);
+        if (!stream->fEndStream) {
+            stream->recvPending += credit;
+            if (stream->recvPending >= HTTP2_STREAM_UPDATE_THRESHOLD || !stream->body) {
+                stream->recvWindow += stream->recvPending;
+                SendWindowUpdate(stream->id, stream->recvPending);
+                stream->recvPending = 0;
+            }
+        }
+    }
+
+    PRBool fQueued = (obuf.len > 0);
+
+    PR_Unlock(lock);
+
+    if (fQueued)
+        Flush();
+
+    return n;
+}
+
+//-----------------------------------------------------------------------------
+// Http2Session::Available
+//-----------------------------------------------------------------------------
+
+PRInt32 Http2Session::Available(Http2Stream *stream)
+{
+    PR_Lock(lock);
+
+    PRInt32 n = stream->requestLen - stream->requestPos;
+    for (Http2Chunk *chunk = stream->body; chunk; chunk = chunk->next)
+        n += chunk->len - chunk->pos;
+
+    PR_Unlock(lock);
+
+    return n;
+}
+
+//-----------------------------------------------------------------------------
+// Stream IO layer methods
+//-----------------------------------------------------------------------------
+
+// Each stream's Connection has a layer of its own whose lower layer is the
+// connection's socket.  Filters may be pushed above it and move it around in
+// memory, so the stream is always found through fd->secret.
+
+PRInt32 Http2Session::LayerWrite(PRFileDesc *fd, const void *buf, PRInt32 amount)
+{
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    PRIOVec iov;
+    iov.iov_base = (char *) buf;
+    iov.iov_len = amount;
+
+    return stream->session->Write(stream, &iov, 1);
+}
+
+PRInt32 Http2Session::LayerWritev(PRFileDesc *fd, const PRIOVec *iov, PRInt32 iov_size, PRIntervalTime timeout)
+{
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    return stream->session->Write(stream, iov, iov_size);
+}
+
+PRInt32 Http2Session::LayerSend(PRFileDesc *fd, const void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout)
+{
+    return LayerWrite(fd, buf, amount);
+}
+
+PRInt32 Http2Session::LayerSendFile(PRFileDesc *fd, PRSendFileData *sfd, PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    return stream->session->SendFile(stream, sfd);
+}
+
+PRInt32 Http2Session::LayerTransmitFile(PRFileDesc *sd, PRFileDesc *fd, const void *headers, PRInt32 hlen, PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+    Http2Stream *stream = (Http2Stream *) sd->secret;
+
+    PRSendFileData sfd;
+    sfd.fd = fd;
+    sfd.file_offset = 0;
+    sfd.file_nbytes = 0;
+    sfd.header = headers;
+    sfd.hlen = hlen;
+    sfd.trailer = NULL;
+    sfd.tlen = 0;
+
+    return stream->session->SendFile(stream, &sfd);
+}
+
+PRInt32 Http2Session::LayerRecv(PRFileDesc *fd, void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout)
+{
+    if (flags != 0 && flags != PR_MSG_PEEK) {
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return -1;
+    }
+
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    return stream->session->Read(stream, buf, amount, flags == PR_MSG_PEEK, timeout);
+}
+
+PRInt32 Http2Session::LayerRead(PRFileDesc *fd, void *buf, PRInt32 amount)
+{
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    return stream->session->Read(stream, buf, amount, PR_FALSE, DaemonSession::GetIOTimeout());
+}
+
+PRInt32 Http2Session::LayerAvailable(PRFileDesc *fd)
+{
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    return stream->session->Available(stream);
+}
+
+PRInt64 Http2Session::LayerAvailable64(PRFileDesc *fd)
+{
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    return stream->session->Available(stream);
+}
+
+PRInt16 Http2Session::LayerPoll(PRFileDesc *fd, PRInt16 in_flags, PRInt16 *out_flags)
+{
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+
+    if ((in_flags & PR_POLL_READ) && stream->session->Available(stream) > 0) {
+        *out_flags = PR_POLL_READ;
+        return in_flags;
+    }
+
+    return fd->lower->methods->poll(fd->lower, in_flags, out_flags);
+}
+
+PRStatus Http2Session::LayerShutdown(PRFileDesc *fd, PRIntn how)
+{
+    // The connection stays open.  All the stream needs to know is that
+    // HttpRequest won't read any more of it.
+    Http2Stream *stream = (Http2Stream *) fd->secret;
+    Http2Session *h2 = stream->session;
+
+    PR_Lock(h2->lock);
+    stream->fShutdown = PR_TRUE;
+    PR_Unlock(h2->lock);
+
+    return PR_SUCCESS;
+}
+
+PRStatus Http2Session::LayerClose(PRFileDesc *fd)
+{
+    // Closing the stream's Connection ends the stream but leaves the
+    // connection's socket open
+    if (Http2Stream *stream = (Http2Stream *) fd->secret)
+        stream->session->FinishStream(stream);
+
+    fd->secret = NULL;
+    fd->lower = NULL;
+    fd->dtor(fd);
+
+    return PR_SUCCESS;
+}
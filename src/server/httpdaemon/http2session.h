@@ -0,0 +1,276 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef HTTPDAEMON_HTTP2SESSION_H
+#define HTTPDAEMON_HTTP2SESSION_H
+
+#include "nspr.h"
+#include "netsite.h"
+#include "httpdaemon/libdaemon.h"
+#include "httpdaemon/hpack.h"
+
+class Connection;
+class DaemonSession;
+class HttpHeader;
+struct Http2Stream;
+
+//-----------------------------------------------------------------------------
+// Http2Buffer
+//-----------------------------------------------------------------------------
+
+// Growable PERM_MALLOC'd byte buffer
+struct Http2Buffer {
+    char *p;
+    int len;
+    int size;
+};
+
+//-----------------------------------------------------------------------------
+// Http2Session
+//-----------------------------------------------------------------------------
+
+// An HTTP/2 connection (RFC 7540).
+//
+// The DaemonSession thread that owns the connection reads and processes its
+// frames.  Each stream's request is turned back into an HTTP/1.1 request
+// header and given a Connection of its own, which goes through the
+// ConnectionQueue to another DaemonSession like any ready connection.  That
+// DaemonSession runs it through HttpRequest::HandleRequest, so HTTP/2
+// requests go through the same accelerator cache, NSAPI pipeline and
+// HttpFilterContext as HTTP/1.1 requests.  The stream Connection's fd is an
+// NSPR IO layer that feeds HttpRequest the request header and body and turns
+// the HTTP/1.1 response it writes into HEADERS and DATA frames, applying
+// HTTP/2 flow control as it goes.  Up to Http2MaxConcurrentStreams streams
+// run at once, and that's what we advertise in
+// SETTINGS_MAX_CONCURRENT_STREAMS.
+//
+// Frame output is shared by all the streams.  Frames are queued under lock,
+// which also keeps the HPACK encoder in step with the order frames are
+// written, and written out under sendLock.  sendLock is always taken before
+// lock, and nothing waits for the peer while holding lock.
+//
+// When no streams are open the connection goes to the keep-alive subsystem
+// like any other, with the Http2Session kept in Connection::http2 so the
+// DaemonSession that picks it up next carries on where this one left off.
+//
+// HTTP/2 needs the DaemonSession thread pool.  Without one, it isn't offered.
+class HTTPDAEMON_DLL Http2Session {
+public:
+    // Read the magnus.conf settings and set up the stream IO layer.
+    static PRBool Initialize();
+
+    // Returns PR_TRUE if buf starts with (the beginning of) the HTTP/2
+    // connection preface and conn may speak HTTP/2.  TLS connections must
+    // have negotiated h2 with ALPN.
+    static PRBool IsPreface(Connection *conn, const netbuf *buf);
+
+    // Returns PR_TRUE if hdr is an HTTP/1.1 request asking for an h2c
+    // upgrade that we can honour.
+    static PRBool IsUpgrade(Connection *conn, const HttpHeader *hdr);
+
+    // Create a session for a connection that opened with the preface.
+    static Http2Session *Create(Connection *conn);
+
+    // Create a session for a connection being upgraded from HTTP/1.1.  The
+    // request in hdr becomes stream 1.
+    static Http2Session *CreateUpgrade(Connection *conn, const HttpHeader *hdr);
+
+    ~Http2Session();
+
+    // Process the connection until it goes idle or is closed.  buf holds any
+    // data the DaemonSession has already read from the socket.  On return,
+    // no streams are running and the connection has a keep-alive reservation
+    // if it should be kept open.
+    PRBool HandleFrames(DaemonSession *session, netbuf *buf);
+
+private:
+    Http2Session(Connection *conn);
+    PRBool IsValid() const;
+
+    // Input
+    PRStatus Fill(PRIntervalTime timeout);
+    PRStatus Wait(PRIntervalTime timeout);
+    void ProcessInput();
+    PRStatus ProcessFrame(PRUint8 type, PRUint8 flags, PRUint32 id,
+                          const unsigned char *payload, int len);
+    PRStatus ProcessData(PRUint8 flags, PRUint32 id,
+                         const unsigned char *payload, int len);
+    PRStatus ProcessHeaders(PRUint8 flags, PRUint32 id,
+                            const unsigned char *payload, int len);
+    PRStatus ProcessContinuation(PRUint8 flags, PRUint32 id,
+                                 const unsigned char *payload, int len);
+    PRStatus ProcessSettings(PRUint8 flags, PRUint32 id,
+                             const unsigned char *payload, int len);
+    PRStatus ProcessWindowUpdate(PRUint32 id,
+                                 const unsigned char *payload, int len);
+    PRStatus ApplySettings(const unsigned char *payload, int len);
+    PRStatus DecodeHeaderBlock();
+    static PRStatus AddRequestHeader(void *context,
+                                     const char *name, int nlen,
+                                     const char *value, int vlen);
+
+    // Output
+    void QueueFrame(PRUint8 type, PRUint8 flags, PRUint32 id,
+                    const void *payload, int len);
+    PRStatus Flush();
+    void Closed();
+    void ConnectionError(PRUint32 code);
+    void ResetStream(PRUint32 id, PRUint32 code);
+    void SendWindowUpdate(PRUint32 id, PRInt32 increment);
+    void Credit(PRInt32 credit);
+
+    // Streams
+    Http2Stream *AddStream(PRUint32 id);
+    Http2Stream *FindStream(PRUint32 id);
+    void RemoveStream(Http2Stream *stream);
+    void DispatchStreams();
+    void StartStream(Http2Stream *stream);
+    void FinishStream(Http2Stream *stream);
+
+    // Response to a stream
+    PRStatus Respond(Http2Stream *stream, const char *p, int len);
+    PRStatus SendResponseHeaders(Http2Stream *stream);
+    PRStatus WaitForWindow(Http2Stream *stream);
+    PRStatus SendData(Http2Stream *stream, const char *p, int len, PRBool fLast);
+    PRStatus SendFileData(Http2Stream *stream, PRFileDesc *fd, PRInt64 offset, PRInt64 len);
+    PRStatus SendDataFrame(Http2Stream *stream, PRUint8 flags,
+                           const char *p, PRFileDesc *fd, PRInt64 offset, int n);
+
+    // Stream IO layer
+    void AbortResponse(Http2Stream *stream);
+    PRInt32 Write(Http2Stream *stream, const PRIOVec *iov, int iovcnt);
+    PRInt32 SendFile(Http2Stream *stream, PRSendFileData *sfd);
+    PRInt32 Read(Http2Stream *stream, void *buf, PRInt32 amount, PRBool fPeek, PRIntervalTime timeout);
+    PRInt32 Available(Http2Stream *stream);
+
+    static PRInt32 LayerWrite(PRFileDesc *fd, const void *buf, PRInt32 amount);
+    static PRInt32 LayerWritev(PRFileDesc *fd, const PRIOVec *iov, PRInt32 iov_size, PRIntervalTime timeout);
+    static PRInt32 LayerSend(PRFileDesc *fd, const void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout);
+    static PRInt32 LayerSendFile(PRFileDesc *fd, PRSendFileData *sfd, PRTransmitFileFlags flags, PRIntervalTime timeout);
+    static PRInt32 LayerTransmitFile(PRFileDesc *sd, PRFileDesc *fd, const void *headers, PRInt32 hlen, PRTransmitFileFlags flags, PRIntervalTime timeout);
+    static PRInt32 LayerRecv(PRFileDesc *fd, void *buf, PRInt32 amount, PRIntn flags, PRIntervalTime timeout);
+    static PRInt32 LayerRead(PRFileDesc *fd, void *buf, PRInt32 amount);
+    static PRInt32 LayerAvailable(PRFileDesc *fd);
+    static PRInt64 LayerAvailable64(PRFileDesc *fd);
+    static PRInt16 LayerPoll(PRFileDesc *fd, PRInt16 in_flags, PRInt16 *out_flags);
+    static PRStatus LayerShutdown(PRFileDesc *fd, PRIntn how);
+    static PRStatus LayerClose(PRFileDesc *fd);
+
+    Connection *conn;
+
+    // Protects everything below that the stream threads share with the
+    // connection's thread: the streams, flow control, the queued frames
+    // and the HPACK encoder
+    PRLock *lock;
+
+    // Notified when frames have been processed or the connection fails
+    PRCondVar *cv;
+
+    // Serializes writes to the socket
+    PRLock *sendLock;
+
+    // Wakes the connection's thread when the last running stream finishes.
+    // Created when the first stream is dispatched.
+    PRFileDesc *wakeup;
+
+    // Data read from the socket but not yet processed.  Only the
+    // connection's thread touches it.
+    unsigned char *rbuf;
+    int rsize;
+    int rpos;
+    int rlen;
+
+    // Frames waiting to be written, and the ones being written by whoever
+    // holds sendLock
+    Http2Buffer obuf;
+    Http2Buffer wbuf;
+
+    // Header block being reassembled from HEADERS and CONTINUATION frames
+    Http2Buffer hblock;
+    PRUint32 hblockStream;
+    PRBool fHblockEndStream;
+
+    // Request being decoded from a header block.  Pseudo-header and Host
+    // values are kept in values; the offsets are -1 until they're seen.
+    struct {
+        Http2Buffer fields;
+        Http2Buffer cookie;
+        Http2Buffer values;
+        int size;
+        int method;
+        int methodLen;
+        int path;
+        int pathLen;
+        int authority;
+        int authorityLen;
+        int host;
+        int hostLen;
+        PRBool fRegular;
+        PRBool fContentLength;
+        PRBool fMalformed;
+    } rq;
+
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+
+    // Open streams, lowest ID first, and how many of them have been handed
+    // to DaemonSessions
+    Http2Stream *streams;
+    Http2Stream *streamsTail;
+    int nStreams;
+    int nRunning;
+    PRUint32 lastStreamId;
+
+    // Flow control.  recvPending is DATA that streams have consumed but
+    // that hasn't been credited back to the connection yet.
+    PRInt32 sendWindow;
+    PRInt32 recvWindow;
+    PRInt32 recvPending;
+    PRInt32 peerInitialWindow;
+
+    PRBool fPreface;
+    PRBool fSettings;
+    PRBool fStarted;
+    PRBool fGoawaySent;
+    PRBool fGoawayReceived;
+    PRBool fError;
+    PRBool fClosed;
+
+    static PRBool fCleartext;
+    static int nMaxStreams;
+    static PRDescIdentity identity;
+    static PRIOMethods methods;
+};
+
+#endif // HTTPDAEMON_HTTP2SESSION_H
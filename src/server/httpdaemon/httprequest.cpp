@@ -40,6 +40,7 @@
 
 #include "httpdaemon/httprequest.h"
 #include "httpdaemon/daemonsession.h"
+#include "httpdaemon/http2session.h"
 #include "httpdaemon/HttpMethodRegistry.h"
 #include <base/plist.h>
 #include <libaccess/acl.h>
@@ -194,6 +195,9 @@ PRBool HttpRequest::fDiscardMisquotedCookies = PR_TRUE;
 // Enable URI canonicalization by default
 PRBool HttpRequest::fCanonicalizeURI = PR_TRUE;
 
+// Coalesce up to 64KB of responses to pipelined requests by default
+int HttpRequest::iPipelineBatchSize = 65536;
+
 const Filter *HttpRequest::httpfilter = NULL;
 
 /* TCP_NODELAY socket option inherited from listen socket */
@@ -382,6 +386,9 @@ HttpRequest::HandleRequest(netbuf *buf, PRIntervalTime timeout)
     /* First request on a session or after keepalive is not pipelined */
     fPipelined = PR_FALSE;
 
+    /* Whether we've held back any responses for batching */
+    PRBool fBatched = PR_FALSE;
+
     /* Loop while there is still data from the client */
     while (rqSn.sn.csd_open && (buf->pos < buf->cursize)) {
         // Track session statistics
@@ -448,6 +455,22 @@ HttpRequest::HandleRequest(netbuf *buf, PRIntervalTime timeout)
             }
         }
 
+        // If the client asked to upgrade to HTTP/2, the Http2Session answers
+        // this request as stream 1 once we return
+        if (!iStatus && Http2Session::IsUpgrade(pSession->conn, rqHdr)) {
+            pSession->conn->http2 = Http2Session::CreateUpgrade(pSession->conn, rqHdr);
+            if (pSession->conn->http2) {
+                pool_recycle(pool, poolMark);
+                if (RestoreInputBuffer(buf, origBufInbuf, origBufMaxsize) != PR_SUCCESS) {
+                    // Lost the start of the HTTP/2 connection
+                    delete pSession->conn->http2;
+                    pSession->conn->http2 = NULL;
+                }
+                fKeepAliveRequested = PR_FALSE;
+                break;
+            }
+        }
+
         // Record length of the request header
         rqSn.received += buf->pos;
         if (fQOS)
@@ -457,6 +480,25 @@ HttpRequest::HandleRequest(netbuf *buf, PRIntervalTime timeout)
         // keep-alive subsystem for another connection?
         fKeepAliveRequested = pSession->RequestKeepAlive(rqHdr->IsKeepAliveRequested());
 
+        // If the client already sent another request behind this one, hold
+        // this response back so it goes out with the next in a single write.
+        // Anything in the buffer might be a request body if there's one.
+        if (iPipelineBatchSize > 0) {
+            if (!iStatus &&
+                fKeepAliveRequested &&
+                buf->pos < buf->cursize &&
+                !rqHdr->GetContentLength() &&
+                !rqHdr->GetTransferEncoding())
+            {
+                if (net_batch_output(rqSn.sn.csd, iPipelineBatchSize) == 0)
+                    fBatched = PR_TRUE;
+            } else if (fBatched) {
+                // Last of the pipelined requests; its first write sends
+                // the responses we've held back
+                net_batch_output(rqSn.sn.csd, 0);
+            }
+        }
+
         // Get the host, either from Host: header or URL
         const HHString *hsHost = rqHdr->GetHost();
 
@@ -524,7 +566,8 @@ HttpRequest::HandleRequest(netbuf *buf, PRIntervalTime timeout)
             fKeepAliveRequested = PR_FALSE;
 
         // Track session statistics
-        pSession->endProcessing(vs, iStatus, rqSn.received, rqSn.transmitted);
+        pSession->endProcessing(vs, iStatus, rqSn.received, rqSn.transmitted,
+                                lsc->getLatencyHistogram());
 
         // Count next request, if any, as pipelined
         fPipelined = PR_TRUE;
@@ -533,6 +576,12 @@ HttpRequest::HandleRequest(netbuf *buf, PRIntervalTime timeout)
             break;
     }
 
+    // Send anything still held back before we wait for more requests
+    if (fBatched) {
+        net_batch_output(rqSn.sn.csd, 0);
+        net_batch_flush(rqSn.sn.csd);
+    }
+
     // Let DaemonSession know our current intentions with respect to keepalive
     pSession->RequestKeepAlive(fKeepAliveRequested);
 
@@ -788,51 +837,60 @@ void HttpRequest::UnacceleratedRespond()
     if (const HHString *hsQuery = rqHdr->GetQuery())
         pblock_kvinsert(pb_key_query, hsQuery->ptr, hsQuery->len, rqRq.rq.reqpb);
 
-    /* Get abs_path part of request URI, and canonicalize the path */
-    char *absPath;
+    /* Get abs_path part of request URI, canonicalize and decode it */
+    char *absPath = NULL;
+    int absPathLen = 0;
+    int rvAbsPath = 1;
     const HHString& hsAbsPath = rqHdr->GetRequestAbsPath();
     if (hsAbsPath.len > 0) {
+#ifdef XP_WIN32
         if (fCanonicalizeURI) {
             absPath = util_canonicalize_uri(pool, hsAbsPath.ptr, hsAbsPath.len, NULL);
-            if (!absPath) {
-                if (!iStatus) {
-                    ereport(LOG_VERBOSE,
-                            "Received malformed request from %s (URI points outside document root)",
-                            clientIP);
-                    iStatus = PROTOCOL_FORBIDDEN;
-                }
-            }
+            if (!absPath)
+                rvAbsPath = -1;
         } else {
             absPath = HttpHeader::HHDup(pool, &hsAbsPath);
         }
-    } else {
-        absPath = NULL;
-    }
-
-    /* Decode the abs_path */
-    if (absPath) {
-#ifdef XP_WIN32
-        char *unmpath = (char *) pool_malloc(pool, strlen(absPath) + 1);
-        if (!util_uri_unescape_and_normalize(pool, absPath, unmpath))
-            absPath = NULL;
-        pblock_nvinsert("unmuri", unmpath, rqRq.rq.vars);
+        if (absPath) {
+            char *unmpath = (char *) pool_malloc(pool, strlen(absPath) + 1);
+            if (!util_uri_unescape_and_normalize(pool, absPath, unmpath))
+                rvAbsPath = 0;
+            pblock_nvinsert("unmuri", unmpath, rqRq.rq.vars);
+        }
 #else
-        if (!util_uri_unescape_strict(absPath))
-            absPath = NULL;
+        if (fCanonicalizeURI) {
+            /* Canonicalize and decode in a single pass */
+            rvAbsPath = util_canonicalize_uri_unescape(pool, hsAbsPath.ptr, hsAbsPath.len, &absPath, &absPathLen);
+        } else {
+            absPath = HttpHeader::HHDup(pool, &hsAbsPath);
+            rvAbsPath = util_uri_unescape_strict(absPath);
+        }
 #endif
-        if (!absPath) {
-            if (!iStatus) {
-                ereport(LOG_VERBOSE,
-                        "Received malformed request from %s (invalid URI encoding)",
-                        clientIP);
-                iStatus = PROTOCOL_BAD_REQUEST;
-            }
+    }
+
+    if (rvAbsPath == -1) {
+        if (!iStatus) {
+            ereport(LOG_VERBOSE,
+                    "Received malformed request from %s (URI points outside document root)",
+                    clientIP);
+            iStatus = PROTOCOL_FORBIDDEN;
         }
+        absPath = NULL;
+    } else if (rvAbsPath == 0) {
+        if (!iStatus) {
+            ereport(LOG_VERBOSE,
+                    "Received malformed request from %s (invalid URI encoding)",
+                    clientIP);
+            iStatus = PROTOCOL_BAD_REQUEST;
+        }
+        absPath = NULL;
     }
 
     /* Pass the abs_path as "uri" in reqpb */
     if (absPath) {
-        pblock_kvinsert(pb_key_uri, absPath, strlen(absPath), rqRq.rq.reqpb);
+        if (!absPathLen)
+            absPathLen = strlen(absPath);
+        pblock_kvinsert(pb_key_uri, absPath, absPathLen, rqRq.rq.reqpb);
     } else {
         if (!iStatus) {
             ereport(LOG_VERBOSE,
@@ -961,6 +1019,11 @@ PRBool HttpRequest::Initialize ()
 
     fCanonicalizeURI = conf_getboolean("CanonicalizeURI", fCanonicalizeURI);
 
+    iPipelineBatchSize = conf_getboundedinteger("PipelineBatchSize", 0, 1048576, iPipelineBatchSize);
+
+    if (!Http2Session::Initialize())
+        rv = PR_FALSE;
+
     return rv;
 }
 
@@ -138,6 +138,9 @@ class HTTPDAEMON_DLL HttpRequest {
     /* whether to Canonicalize URI paths */
     static PRBool               fCanonicalizeURI;
 
+    /* bytes of responses to pipelined requests to coalesce, 0 to disable */
+    static int                  iPipelineBatchSize;
+
     /**
      * HTTP server filter.
      **/
@@ -129,6 +129,19 @@ typedef struct DNSCacheInfo {
 
 PRBool GetDNSCacheInfo(DNSCacheInfo *info);
 
+typedef struct SSLSessionInfo {
+    PRBool        flagCacheEnabled;
+    PRBool        flagTicketsSupported;
+
+    PRUint32      numHandshakes;
+    PRUint32      numFullHandshakes;
+    PRUint32      numCacheResumptions;
+    PRUint32      numTicketResumptions;
+    PRUint32      numCacheMisses;
+} SSLSessionInfo;
+
+PRBool GetSSLSessionInfo(SSLSessionInfo *info);
+
 typedef struct NativeThreadPoolInfo {
     PRInt32 pool_thread_count;
     PRInt32 pool_thread_max;
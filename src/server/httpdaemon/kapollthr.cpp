@@ -379,6 +379,10 @@ KAPollThread::ClassifyRequest(AcceleratorAsync *async, Connection *connection)
     if (connection->async.fd == -1)
         return REQUEST_QUEUE;
 
+    // HTTP/2 frames are for the connection's Http2Session
+    if (connection->http2)
+        return REQUEST_QUEUE;
+
     PR_ASSERT(desiredInputBufferSize > sizeof("GET "));
 
     // Resize the input buffer if it looks like it might be too small to hold
@@ -520,7 +524,8 @@ KAPollThread::AcceleratedRespond(PRInt32 numAcceleratable, AcceleratorAsync *asy
             }
             endFunction(STATS_PROFILE_CACHE);
             endProcessing(vs, status_num, connection->async.inbuf.cursize,
-                          transmitted);
+                          transmitted,
+                          connection->lsConfig->getLatencyHistogram());
             break;
 
         case ACCEL_ASYNC_AGAIN:
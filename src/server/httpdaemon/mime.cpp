@@ -47,12 +47,8 @@
 //-----------------------------------------------------------------------------
 
 MimeFile::MimeFile(ServerXMLSchema::String& mimeFile, ConfigurationObject* parent)
-: ConfigurationObject(parent), 
-  extHashExact(3), 
-  extHashMixed(3)
+: ConfigurationObject(parent)
 {
-    extHashMixed.setMixCase();
-
     try {
         parseFile(mimeFile);
     }
@@ -249,8 +245,11 @@ MimeType* MimeFile::addType(MimeType* type, const char* filename, int ln, int cn
     CListIterator<char> iterator(&type->extList);
     const char* ext;
     while (ext = (++iterator)) {
-        // If the extension has been added already (with the same case)...
-        if (extHashExact.lookup((void*)ext)) {
+        // Use type for case sensitive matches and, if this is the first
+        // occurrence of this extension in any case, for case insensitive
+        // matches.  If the extension has been added already (with the same
+        // case), the earlier type is kept...
+        if (!extIndex.add(ext, &type->info)) {
             // Duplicate extension.  This is a configuration error, but we
             // allow it to ease migration from 4.x servers.
             ereport(LOG_MISCONFIG,
@@ -261,15 +260,6 @@ MimeType* MimeFile::addType(MimeType* type, const char* filename, int ln, int cn
                     ext,
                     XP_GetAdminStr(DBT_Configuration_ExtensionMultiplyDefined));
         }
-
-        // If this is the first occurrence of this extension in any case, we
-        // will use type for case insensitive matches
-        if (!extHashMixed.lookup((void*)ext)) {
-            extHashMixed.insert((void*)ext, (void*)type);
-        }
-
-        // Use type for case sensitive matches
-        extHashExact.insert((void*)ext, (void*)type);
     }
 
     // Caller is responsible for delete'ing type when we're destroyed.  This is
@@ -277,34 +267,6 @@ MimeType* MimeFile::addType(MimeType* type, const char* filename, int ln, int cn
     return type;
 }
 
-//-----------------------------------------------------------------------------
-// MimeFile::findExtCaseSensitive
-//-----------------------------------------------------------------------------
-
-const cinfo* MimeFile::findExtCaseSensitive(const char* ext) const
-{
-    // XXX SimpleHash has its constness wrong
-    SimplePtrStringHash* hash = (SimplePtrStringHash*)&extHashExact;
-    const MimeType* mimeType = (const MimeType*)hash->lookup((void*)ext);
-    if (mimeType)
-        return &mimeType->ci;
-    return NULL;
-}
-
-//-----------------------------------------------------------------------------
-// MimeFile::findExtCaseInsensitive
-//-----------------------------------------------------------------------------
-
-const cinfo* MimeFile::findExtCaseInsensitive(const char* ext) const
-{
-    // XXX SimpleHash has its constness wrong
-    SimplePtrStringHash* hash = (SimplePtrStringHash*)&extHashMixed;
-    const MimeType* mimeType = (const MimeType*)hash->lookup((void*)ext);
-    if (mimeType)
-        return &mimeType->ci;
-    return NULL;
-}
-
 //-----------------------------------------------------------------------------
 // Mime::Mime
 //-----------------------------------------------------------------------------
@@ -336,96 +298,66 @@ void Mime::addMimeFile(MimeFile *mimeFile)
 
 const cinfo* Mime::findExt(const char* ext) const
 {
-    int i;
+    const MimeContentInfo* info = findExt(ext, strlen(ext));
+    if (info)
+        return &info->ci;
+    return NULL;
+}
 
-    // First try a case sensitive lookup across all MIME files
-    for (i = 0; i < mimeFilesVector.length(); i++) {
-        const cinfo* cinfo = ((MimeFile*)mimeFilesVector[i])->findExtCaseSensitive(ext);
-        if (cinfo)
-            return cinfo;
-    }
+const MimeContentInfo* Mime::findExt(const char* ext, int len) const
+{
+    PRUint32 hash = MimeExtIndex::hash(ext, len);
+    const MimeContentInfo* mixed = NULL;
+    int i;
 
-    // The case sensitive lookup failed, try case insensitive
+    // A case sensitive match in any MIME file beats a case insensitive match,
+    // so only fall back to the first case insensitive match once every MIME
+    // file has been checked
     for (i = 0; i < mimeFilesVector.length(); i++) {
-        const cinfo* cinfo = ((MimeFile*)mimeFilesVector[i])->findExtCaseInsensitive(ext);
-        if (cinfo)
-            return cinfo;
+        const MimeContentInfo* exact;
+        const MimeContentInfo* m;
+        ((MimeFile*)mimeFilesVector[i])->findExt(ext, len, hash, &exact, &m);
+        if (exact)
+            return exact;
+        if (!mixed)
+            mixed = m;
     }
 
-    return NULL;
+    return mixed;
 }
 
 //-----------------------------------------------------------------------------
-// Mime::getContentInfo
+// Mime::findContentInfo
 //-----------------------------------------------------------------------------
 
-cinfo* Mime::getContentInfo(pool_handle_t* pool, const char* uri) const
+PRBool Mime::findContentInfo(const char* uri, MimeContentInfo* info) const
 {
-    char* temp = pool_strdup(pool, uri);
-    cinfo* ci = getContentInfo(pool, temp);
-    pool_free(pool, temp);
-    return ci;
+    return mime_find_content_info(*this, uri, info);
 }
 
+//-----------------------------------------------------------------------------
+// Mime::getContentInfo
+//-----------------------------------------------------------------------------
+
 cinfo* Mime::getContentInfo(pool_handle_t* pool, char* uri) const
 {
-    const char* type = 0;
-    const char* encoding = 0;
-    const char* language = 0;
-    char* exts;
-
-    // Find the last path component of uri
-    exts = strchr(uri, FILE_PATHSEP);
-    if (!exts)
-        exts = uri;
-    else
-        ++exts;
-
-    // Find the first extension
-    exts = strchr(exts, CINFO_SEPARATOR);
-    if (!exts) return 0;
-    ++exts;
-
-    // For every extension, starting with the first...
-    while (*exts) {
-        // Find the end of this extension
-        char* t = exts;
-        while (*t && (*t != CINFO_SEPARATOR)) ++t;
-        if (t == exts) {
-            exts++;
-            continue;
-        }
-
-        // Null terminate this extension
-        char c = *t;
-        *t = '\0';
-
-        // exts is now the beginning of an extension.  See if there's a cinfo
-        // associated with this extension.
-        const cinfo* ci = findExt(exts);
-        if (ci) {
-            if (ci->type) type = ci->type;
-            if (ci->encoding) encoding = ci->encoding;
-            if (ci->language) language = ci->language;
-        }
+    return getContentInfo(pool, (const char*)uri);
+}
 
-        // Restore the separator at the end of this extension
-        if (c) {
-            *t = c;
-            ++t;
-        }
+cinfo* Mime::getContentInfo(pool_handle_t* pool, const char* uri) const
+{
+    MimeContentInfo info;
 
-        // Next extension...
-        exts = t;
-    }
+    if (!findContentInfo(uri, &info))
+        return 0;
 
     // Create a new cinfo, the caller is responsible for FREE()ing it
     cinfo* ci = 0;
-    if (type || encoding || language) {
+    if (info.ci.type || info.ci.encoding || info.ci.language) {
         ci = (cinfo*)pool_malloc(pool, sizeof(*ci));
-        ci->type = type ? pool_strdup(pool, type) : 0;
-        ci->encoding = encoding ? pool_strdup(pool, encoding) : 0;
-        ci->language = language ? pool_strdup(pool, language) : 0;
+        ci->type = info.ci.type ? pool_strdup(pool, info.ci.type) : 0;
+        ci->encoding = info.ci.encoding ? pool_strdup(pool, info.ci.encoding) : 0;
+        ci->language = info.ci.language ? pool_strdup(pool, info.ci.language) : 0;
     }
 
     return ci;
@@ -447,9 +379,9 @@ MimeType::MimeType(const char* type, const char* encoding, const char* language,
 
 MimeType::~MimeType()
 {
-    if (ci.type) free(ci.type);
-    if (ci.encoding) free(ci.encoding);
-    if (ci.language) free(ci.language);
+    if (info.ci.type) free(info.ci.type);
+    if (info.ci.encoding) free(info.ci.encoding);
+    if (info.ci.language) free(info.ci.language);
 
     // Empty extList, freeing the strdup()'d strings
     char* string;
@@ -465,9 +397,12 @@ MimeType::~MimeType()
 
 void MimeType::init(const char* type, const char* encoding, const char* language, char* exts)
 {
-    ci.type = type ? strdup(type) : 0;
-    ci.encoding = encoding ? strdup(encoding) : 0;
-    ci.language = language ? strdup(language) : 0;
+    info.ci.type = type ? strdup(type) : 0;
+    info.ci.encoding = encoding ? strdup(encoding) : 0;
+    info.ci.language = language ? strdup(language) : 0;
+    info.typeLen = type ? strlen(type) : 0;
+    info.encodingLen = encoding ? strlen(encoding) : 0;
+    info.languageLen = language ? strlen(language) : 0;
 
     // For every extension in the list...
     while (*exts) {
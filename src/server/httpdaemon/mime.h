@@ -36,6 +36,7 @@
 
 #include "base/cinfo.h"
 #include "httpdaemon/configuration.h"
+#include "httpdaemon/mimeindex.h"
 #include "generated/ServerXMLSchema/Server.h"
 #include "support/GenericVector.h"
 #include "support/LinkedList.hh"
@@ -53,7 +54,7 @@ public:
 private:
     void init(const char* type, const char* enc, const char* lang, char* exts);
 
-    cinfo ci;
+    MimeContentInfo info;
     CList<char> extList;
 
 friend class MimeFile;
@@ -67,8 +68,9 @@ class MimeFile : public ConfigurationObject {
 public:
     MimeFile(ServerXMLSchema::String& mimeFile, ConfigurationObject* parent);
 
-    const cinfo* findExtCaseSensitive(const char* ext) const;
-    const cinfo* findExtCaseInsensitive(const char* ext) const;
+    inline void findExt(const char* ext, int len, PRUint32 hash,
+                        const MimeContentInfo** exact,
+                        const MimeContentInfo** mixed) const;
 
 private:
     void parseFile(const char* filename);
@@ -76,12 +78,16 @@ private:
     MimeType* addType(MimeType* type);
     MimeType* addType(MimeType* type, const char* filename, int line, int column);
 
-    SimplePtrStringHash extHashExact;
-    SimplePtrStringHash extHashMixed;
-
-    static const int sizeExtHash;
+    MimeExtIndex extIndex;
 };
 
+inline void MimeFile::findExt(const char* ext, int len, PRUint32 hash,
+                              const MimeContentInfo** exact,
+                              const MimeContentInfo** mixed) const
+{
+    extIndex.find(ext, len, hash, exact, mixed);
+}
+
 //-----------------------------------------------------------------------------
 // Mime
 //-----------------------------------------------------------------------------
@@ -95,7 +101,16 @@ public:
     cinfo* getContentInfo(pool_handle_t* pool, char* uri) const;
     cinfo* getContentInfo(pool_handle_t* pool, const char* uri) const;
 
+    // Find the type, encoding, and language for uri without copying any
+    // strings.  The strings in info belong to the configuration.  Returns
+    // PR_FALSE if none of uri's extensions has a MIME type.
+    PRBool findContentInfo(const char* uri, MimeContentInfo* info) const;
+
+    // Find the len bytes at ext, which need not be nul-terminated
+    const MimeContentInfo* findExt(const char* ext, int len) const;
+
 private:
+
     GenericVector mimeFilesVector;
 };
 
@@ -0,0 +1,167 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string.h>
+
+#include "base/ereport.h"
+#include "support/EreportableException.h"
+#include "httpdaemon/mimeindex.h"
+#include "httpdaemon/dbthttpdaemon.h"
+
+// Initial number of slots, must be a power of 2
+#define MIMEINDEX_INITIAL_SIZE 64
+
+//-----------------------------------------------------------------------------
+// MimeExtIndex::MimeExtIndex
+//-----------------------------------------------------------------------------
+
+MimeExtIndex::MimeExtIndex()
+: slots(NULL),
+  mask(0),
+  count(0)
+{ }
+
+//-----------------------------------------------------------------------------
+// MimeExtIndex::~MimeExtIndex
+//-----------------------------------------------------------------------------
+
+MimeExtIndex::~MimeExtIndex()
+{
+    if (slots)
+        PERM_FREE(slots);
+}
+
+//-----------------------------------------------------------------------------
+// MimeExtIndex::grow
+//-----------------------------------------------------------------------------
+
+void MimeExtIndex::grow()
+{
+    PRUint32 size = slots ? (mask + 1) * 2 : MIMEINDEX_INITIAL_SIZE;
+    Slot* old = slots;
+    PRUint32 oldSize = slots ? mask + 1 : 0;
+
+    // Leave the existing slots alone if we can't allocate new ones
+    Slot* grown = (Slot*)PERM_CALLOC(size * sizeof(Slot));
+    if (!grown)
+        throw EreportableException(LOG_CATASTROPHE, XP_GetAdminStr(DBT_Configuration_OutOfMemory));
+
+    slots = grown;
+    mask = size - 1;
+
+    // Reinsert the existing slots.  Every extension is already unique, so
+    // each slot simply goes to the first free slot in its probe sequence.
+    for (PRUint32 i = 0; i < oldSize; i++) {
+        if (old[i].ext) {
+            PRUint32 j = old[i].hash & mask;
+            while (slots[j].ext)
+                j = (j + 1) & mask;
+            slots[j] = old[i];
+        }
+    }
+
+    if (old)
+        PERM_FREE(old);
+}
+
+//-----------------------------------------------------------------------------
+// MimeExtIndex::add
+//-----------------------------------------------------------------------------
+
+PRBool MimeExtIndex::add(const char* ext, const MimeContentInfo* info)
+{
+    // Keep the load factor at or below 1/2 so probe sequences stay short
+    if ((count + 1) * 2 > mask + 1)
+        grow();
+
+    int len = strlen(ext);
+    PRUint32 h = hash(ext, len);
+    const MimeContentInfo* mixed = info;
+
+    PRUint32 i = h & mask;
+    while (slots[i].ext) {
+        Slot* slot = &slots[i];
+        if (slot->hash == h && slot->len == len &&
+            !strncasecmp(slot->ext, ext, len))
+        {
+            // Same extension with the same case, first definition wins
+            if (!memcmp(slot->ext, ext, len))
+                return PR_FALSE;
+
+            // Same extension in a different case, the case insensitive
+            // match remains whatever was added first
+            mixed = slot->mixed;
+        }
+        i = (i + 1) & mask;
+    }
+
+    slots[i].ext = ext;
+    slots[i].len = len;
+    slots[i].hash = h;
+    slots[i].exact = info;
+    slots[i].mixed = mixed;
+    count++;
+
+    return PR_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// MimeExtIndex::find
+//-----------------------------------------------------------------------------
+
+void MimeExtIndex::find(const char* ext, int len, PRUint32 h,
+                        const MimeContentInfo** exact,
+                        const MimeContentInfo** mixed) const
+{
+    *exact = NULL;
+    *mixed = NULL;
+
+    if (!slots)
+        return;
+
+    PRUint32 i = h & mask;
+    while (slots[i].ext) {
+        const Slot* slot = &slots[i];
+        if (slot->hash == h && slot->len == len &&
+            !strncasecmp(slot->ext, ext, len))
+        {
+            *mixed = slot->mixed;
+            if (!memcmp(slot->ext, ext, len)) {
+                *exact = slot->exact;
+                return;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+}
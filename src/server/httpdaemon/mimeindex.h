@@ -0,0 +1,179 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef HTTPDAEMON_MIMEINDEX_H
+#define HTTPDAEMON_MIMEINDEX_H
+
+#include <string.h>
+#include "httpdaemon/libdaemon.h"
+#include "base/cinfo.h"
+
+//-----------------------------------------------------------------------------
+// MimeContentInfo
+//-----------------------------------------------------------------------------
+
+// The content info for a MIME type along with the lengths of its strings, so
+// the values can be inserted into a pblock without being scanned again.
+struct MimeContentInfo {
+    cinfo ci;
+    int typeLen;
+    int encodingLen;
+    int languageLen;
+};
+
+//-----------------------------------------------------------------------------
+// MimeExtIndex
+//-----------------------------------------------------------------------------
+
+// Open addressed table that maps filename extensions to MimeContentInfo.  It
+// is built once at configuration time and is read only afterwards, so lookups
+// don't lock.  Extensions are hashed case insensitively, which means a single
+// probe sequence finds both the case sensitive match and the first extension
+// added that differs only in case.
+class HTTPDAEMON_DLL MimeExtIndex {
+public:
+    MimeExtIndex();
+    ~MimeExtIndex();
+
+    // Add ext.  The ext string is not copied and must outlive the index.
+    // Returns PR_FALSE if ext (with the same case) was already added, in which
+    // case the earlier definition is kept.  Throws EreportableException if the
+    // index can't grow.
+    PRBool add(const char* ext, const MimeContentInfo* info);
+
+    // Look up the len bytes at ext, which need not be nul-terminated.  hash
+    // must be the value returned by hash(ext, len).  Sets *exact to the case
+    // sensitive match and *mixed to the case insensitive match, either of
+    // which may be NULL.
+    void find(const char* ext, int len, PRUint32 hash,
+              const MimeContentInfo** exact,
+              const MimeContentInfo** mixed) const;
+
+    // Case insensitive hash of the len bytes at ext.
+    static inline PRUint32 hash(const char* ext, int len);
+
+private:
+    struct Slot {
+        const char* ext;
+        int len;
+        PRUint32 hash;
+        const MimeContentInfo* exact;
+        const MimeContentInfo* mixed;
+    };
+
+    void grow();
+
+    Slot* slots;
+    PRUint32 mask;
+    PRUint32 count;
+};
+
+inline PRUint32 MimeExtIndex::hash(const char* ext, int len)
+{
+    PRUint32 h = 5381;
+    for (int i = 0; i < len; i++) {
+        unsigned char c = ext[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        h = (h << 5) + h + c;
+    }
+    return h;
+}
+
+//-----------------------------------------------------------------------------
+// mime_find_content_info
+//-----------------------------------------------------------------------------
+
+// Find the type, encoding, and language for uri, looking up each extension of
+// its last path component with finder.findExt(ext, len).  Later extensions
+// override earlier ones.  The strings in info are not copied.  Returns
+// PR_FALSE if none of uri's extensions has a MIME type.
+template <class Finder>
+PRBool mime_find_content_info(const Finder& finder, const char* uri, MimeContentInfo* info)
+{
+    const char* exts;
+
+    memset(info, 0, sizeof(*info));
+
+    // Find the last path component of uri
+    exts = strchr(uri, FILE_PATHSEP);
+    if (!exts)
+        exts = uri;
+    else
+        ++exts;
+
+    // Find the first extension
+    exts = strchr(exts, CINFO_SEPARATOR);
+    if (!exts) return PR_FALSE;
+    ++exts;
+
+    // For every extension, starting with the first...
+    PRBool found = PR_FALSE;
+    while (*exts) {
+        // Find the end of this extension
+        const char* t = exts;
+        while (*t && (*t != CINFO_SEPARATOR)) ++t;
+        if (t == exts) {
+            exts++;
+            continue;
+        }
+
+        // See if there's a MIME type associated with this extension
+        const MimeContentInfo* ext = finder.findExt(exts, (int)(t - exts));
+        if (ext) {
+            if (ext->ci.type) {
+                info->ci.type = ext->ci.type;
+                info->typeLen = ext->typeLen;
+            }
+            if (ext->ci.encoding) {
+                info->ci.encoding = ext->ci.encoding;
+                info->encodingLen = ext->encodingLen;
+            }
+            if (ext->ci.language) {
+                info->ci.language = ext->ci.language;
+                info->languageLen = ext->languageLen;
+            }
+            found = PR_TRUE;
+        }
+
+        // Next extension...
+        if (*t)
+            ++t;
+        exts = t;
+    }
+
+    return found;
+}
+
+#endif // HTTPDAEMON_MIMEINDEX_H
@@ -335,7 +335,9 @@ PRBool StatsProcessNodesHandler::updateThreadSlot(int pid,
     const void* threadBuffer = bufferReader.readBuffer(sizeof(StatsThreadSlot));
     if (!threadBuffer)
         return PR_FALSE;
+    thread->beginUpdate();
     memcpy(&thread->threadStats, threadBuffer, sizeof(StatsThreadSlot));
+    thread->endUpdate();
 
     return StatsBackupManager::copyProfileBucketChain(thread->profile,
                                                       nCountProfileBuckets_,
@@ -0,0 +1,699 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <nspr.h>
+
+#include "netsite.h"
+#include "base/ereport.h"
+#include "base/util.h"
+#include "base/shmem.h"
+#include "base/file.h"
+#include "public/iwsstats.h"
+#include "support/NSString.h"
+#include "httpdaemon/statsmanager.h"
+#include "httpdaemon/statscounters.h"
+
+#ifdef XP_UNIX
+#include <unistd.h>
+#include <sys/param.h>
+#endif
+
+// Slots per process beyond maxThreads for keep-alive, acceptor and other
+// threads that run a StatsSession
+#define STATS_COUNTER_SPARE_SLOTS 64
+
+// Attempts to get a consistent copy of a slot that's being updated
+#define STATS_COUNTER_READ_RETRIES 100
+
+//-----------------------------------------------------------------------------
+// StatsCounters static variable definitions
+//-----------------------------------------------------------------------------
+
+shmem_s* StatsCounters::shmem = NULL;
+char* StatsCounters::slots = NULL;
+int StatsCounters::sizeSlot = 0;
+int StatsCounters::countSlots = 0;
+int StatsCounters::countProfileHistograms = 0;
+StatsNamedHistogram* StatsCounters::named = NULL;
+
+//-----------------------------------------------------------------------------
+// getCurrentPid
+//-----------------------------------------------------------------------------
+
+static inline PRUint32 getCurrentPid()
+{
+#ifdef XP_UNIX
+    return getpid();
+#else
+    return 1;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::init
+//-----------------------------------------------------------------------------
+
+PRStatus StatsCounters::init(int maxProcs, int maxThreads, int countProfileBuckets)
+{
+    PR_ASSERT(!slots);
+
+    if (maxProcs < 1)
+        maxProcs = 1;
+    if (countProfileBuckets < 0)
+        countProfileBuckets = 0;
+    countSlots = maxProcs * (maxThreads + STATS_COUNTER_SPARE_SLOTS);
+    countProfileHistograms = countProfileBuckets;
+
+    // Each slot is followed by its request and profile bucket histograms
+    sizeSlot = sizeof(StatsCounterSlot) +
+               (1 + countProfileHistograms) * sizeof(StatsHistogram);
+    sizeSlot = (sizeSlot + STATS_COUNTER_CACHE_LINE - 1) & ~(STATS_COUNTER_CACHE_LINE - 1);
+
+    int sizeNamed = STATS_HISTOGRAM_NAMED_SLOTS * sizeof(StatsNamedHistogram);
+    int size = sizeNamed + countSlots * sizeSlot;
+
+#ifdef XP_UNIX
+    // The segment must be shared by every child we fork
+    char path[MAXPATHLEN];
+    util_snprintf(path, sizeof(path), "%s/stats-counters.%d",
+                  system_get_temp_dir(), getpid());
+    shmem = shmem_alloc(path, size + STATS_COUNTER_CACHE_LINE, 0);
+    if (!shmem) {
+        ereport(LOG_WARN, "Unable to allocate statistics counters (%s)",
+                system_errmsg());
+        countSlots = 0;
+        return PR_FAILURE;
+    }
+    char* base = (char*) shmem->data;
+#else
+    char* base = (char*) PERM_CALLOC(size + STATS_COUNTER_CACHE_LINE);
+    if (!base) {
+        countSlots = 0;
+        return PR_FAILURE;
+    }
+#endif
+
+    // Align the named histograms and slots to a cache line boundary
+    base += (STATS_COUNTER_CACHE_LINE - ((size_t) base % STATS_COUNTER_CACHE_LINE)) % STATS_COUNTER_CACHE_LINE;
+    named = (StatsNamedHistogram*) base;
+    slots = base + sizeNamed;
+
+    return PR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::terminate
+//-----------------------------------------------------------------------------
+
+void StatsCounters::terminate()
+{
+    slots = NULL;
+    named = NULL;
+    countSlots = 0;
+    if (shmem) {
+        shmem_free(shmem);
+        shmem = NULL;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::allocSlot
+//-----------------------------------------------------------------------------
+
+StatsCounterSlot* StatsCounters::allocSlot()
+{
+    PRUint32 pid = getCurrentPid();
+
+    for (int i = 0; i < countSlots; i++) {
+        StatsCounterSlot* slot = getSlot(i);
+        if (slot->pid == 0 &&
+            XP_AtomicCompareAndSwap32(&slot->pid, 0, pid) == 0)
+        {
+            slot->mode = STATS_THREAD_IDLE;
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::freeSlot
+//-----------------------------------------------------------------------------
+
+void StatsCounters::freeSlot(StatsCounterSlot* slot)
+{
+    if (!slot)
+        return;
+
+    PR_ASSERT(!(slot->seq & 1));
+    slot->mode = STATS_THREAD_EMPTY;
+    XP_ProducerMemoryBarrier();
+    slot->pid = 0;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::freeProcessSlots
+//-----------------------------------------------------------------------------
+
+void StatsCounters::freeProcessSlots(PRInt32 pid)
+{
+    for (int i = 0; i < countSlots; i++) {
+        StatsCounterSlot* slot = getSlot(i);
+        if (slot->pid == (PRUint32) pid) {
+            // The process may have died mid-update
+            if (slot->seq & 1)
+                slot->seq++;
+            slot->mode = STATS_THREAD_EMPTY;
+            XP_ProducerMemoryBarrier();
+            slot->pid = 0;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::getNamedHistogram
+//-----------------------------------------------------------------------------
+
+StatsHistogram* StatsCounters::getNamedHistogram(StatsHistogramType type, const char* id)
+{
+    if (!named || !id)
+        return NULL;
+
+    for (;;) {
+        StatsNamedHistogram* unused = NULL;
+
+        for (int i = 0; i < STATS_HISTOGRAM_NAMED_SLOTS; i++) {
+            StatsNamedHistogram* entry = &named[i];
+
+            // Wait out another thread or process that's naming or clearing
+            // this entry
+            while (entry->type == STATS_HISTOGRAM_CLAIMING)
+                PR_Sleep(PR_INTERVAL_NO_WAIT);
+
+            PRUint32 t = entry->type;
+            if (t == STATS_HISTOGRAM_FREE) {
+                if (!unused)
+                    unused = entry;
+                continue;
+            }
+
+            XP_ConsumerMemoryBarrier();
+            if (t == (PRUint32) type && !strcmp(entry->id, id)) {
+                // Take a reference unless the last one is being dropped
+                PRUint32 refs = entry->refs;
+                if (refs == 0 || XP_AtomicCompareAndSwap32(&entry->refs, refs, refs + 1) != refs) {
+                    // Look at this entry again
+                    i--;
+                    continue;
+                }
+                return &entry->histogram;
+            }
+        }
+
+        if (!unused)
+            return NULL;
+
+        if (XP_AtomicCompareAndSwap32(&unused->type, STATS_HISTOGRAM_FREE, STATS_HISTOGRAM_CLAIMING) == STATS_HISTOGRAM_FREE) {
+            util_strlcpy(unused->id, id, sizeof(unused->id));
+            unused->refs = 1;
+            XP_ProducerMemoryBarrier();
+            unused->type = type;
+            return &unused->histogram;
+        }
+
+        // Lost the race, possibly to someone naming the same histogram; look
+        // again
+    }
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::releaseNamedHistogram
+//-----------------------------------------------------------------------------
+
+void StatsCounters::releaseNamedHistogram(StatsHistogram* histogram)
+{
+    if (!histogram)
+        return;
+
+    StatsNamedHistogram* entry = (StatsNamedHistogram*)
+        ((char*) histogram - offsetof(StatsNamedHistogram, histogram));
+    PR_ASSERT(entry >= named && entry < named + STATS_HISTOGRAM_NAMED_SLOTS);
+
+    PRUint32 refs;
+    do {
+        refs = entry->refs;
+        PR_ASSERT(refs > 0);
+    } while (XP_AtomicCompareAndSwap32(&entry->refs, refs, refs - 1) != refs);
+
+    if (refs != 1)
+        return;
+
+    // That was the last reference.  Clear the entry so whoever claims it
+    // next starts from zero.
+    entry->type = STATS_HISTOGRAM_CLAIMING;
+    XP_ProducerMemoryBarrier();
+    entry->id[0] = '\0';
+    memset(&entry->histogram, 0, sizeof(entry->histogram));
+    XP_ProducerMemoryBarrier();
+    entry->type = STATS_HISTOGRAM_FREE;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::recordHistogramAtomic
+//-----------------------------------------------------------------------------
+
+void StatsCounters::recordHistogramAtomic(StatsHistogram* histogram, PRUint64 microseconds)
+{
+    XP_AtomicIncrement64(&histogram->counts[getHistogramIndex(microseconds)]);
+    XP_AtomicAdd64(&histogram->microsecondsTotal, microseconds);
+
+    PRUint64 max = histogram->microsecondsMax;
+    while (microseconds > max) {
+        PRUint64 prev = XP_AtomicCompareAndSwap64(&histogram->microsecondsMax, max, microseconds);
+        if (prev == max)
+            break;
+        max = prev;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::mergeHistogram
+//-----------------------------------------------------------------------------
+
+void StatsCounters::mergeHistogram(StatsHistogram* sum, const StatsHistogram* histogram)
+{
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+        sum->counts[i] += histogram->counts[i];
+    sum->microsecondsTotal += histogram->microsecondsTotal;
+    if (histogram->microsecondsMax > sum->microsecondsMax)
+        sum->microsecondsMax = histogram->microsecondsMax;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::getHistogramCount
+//-----------------------------------------------------------------------------
+
+PRUint64 StatsCounters::getHistogramCount(const StatsHistogram* histogram)
+{
+    PRUint64 count = 0;
+    for (int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++)
+        count += histogram->counts[i];
+    return count;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::getHistogramPercentile
+//-----------------------------------------------------------------------------
+
+PRUint64 StatsCounters::getHistogramPercentile(const StatsHistogram* histogram, double q)
+{
+    PRUint64 count = getHistogramCount(histogram);
+    if (count == 0)
+        return 0;
+
+    // Rank of the value we're looking for, starting at 1
+    PRUint64 rank = (PRUint64) (q * count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+
+    int i;
+    PRUint64 seen = 0;
+    for (i = 0; i < STATS_HISTOGRAM_BUCKETS - 1; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank)
+            break;
+    }
+
+    if (i < STATS_HISTOGRAM_SUB_BUCKETS)
+        return i;
+
+    // Report the midpoint of the bucket
+    int shift = i / STATS_HISTOGRAM_SUB_BUCKETS - 1;
+    PRUint64 lower = (PRUint64) (STATS_HISTOGRAM_SUB_BUCKETS + i % STATS_HISTOGRAM_SUB_BUCKETS) << shift;
+    PRUint64 width = (PRUint64) 1 << shift;
+
+    return lower + width / 2;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::readSlot
+//-----------------------------------------------------------------------------
+
+PRBool StatsCounters::readSlot(const StatsCounterSlot* slot,
+                               StatsCounterValues* values)
+{
+    for (int i = 0; i < STATS_COUNTER_READ_RETRIES; i++) {
+        PRUint32 seq = slot->seq;
+        XP_ConsumerMemoryBarrier();
+        memcpy(values, &slot->values, sizeof(*values));
+        XP_ConsumerMemoryBarrier();
+        if (!(seq & 1) && slot->seq == seq)
+            return PR_TRUE;
+    }
+
+    // The writer is stuck.  Settle for whatever we copied last.
+    return PR_FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::snapshot
+//-----------------------------------------------------------------------------
+
+void StatsCounters::snapshot(StatsCounterValues* sum)
+{
+    memset(sum, 0, sizeof(*sum));
+
+    for (int i = 0; i < countSlots; i++) {
+        const StatsCounterSlot* slot = getSlot(i);
+
+        // Slots that were never claimed have nothing to contribute
+        if (slot->seq == 0)
+            continue;
+
+        StatsCounterValues values;
+        readSlot(slot, &values);
+
+        sum->countRequests += values.countRequests;
+        sum->countBytesReceived += values.countBytesReceived;
+        sum->countBytesTransmitted += values.countBytesTransmitted;
+        sum->count2xx += values.count2xx;
+        sum->count3xx += values.count3xx;
+        sum->count4xx += values.count4xx;
+        sum->count5xx += values.count5xx;
+        sum->countOther += values.countOther;
+        sum->count200 += values.count200;
+        sum->count302 += values.count302;
+        sum->count304 += values.count304;
+        sum->count400 += values.count400;
+        sum->count401 += values.count401;
+        sum->count403 += values.count403;
+        sum->count404 += values.count404;
+        sum->count503 += values.count503;
+        sum->countKeepaliveHits += values.countKeepaliveHits;
+        sum->microsecondsProcessing += values.microsecondsProcessing;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::snapshotRequestHistogram
+//-----------------------------------------------------------------------------
+
+void StatsCounters::snapshotRequestHistogram(StatsHistogram* sum)
+{
+    memset(sum, 0, sizeof(*sum));
+
+    for (int i = 0; i < countSlots; i++) {
+        StatsCounterSlot* slot = getSlot(i);
+        if (slot->seq == 0)
+            continue;
+        mergeHistogram(sum, getRequestHistogram(slot));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::snapshotProfileHistogram
+//-----------------------------------------------------------------------------
+
+void StatsCounters::snapshotProfileHistogram(int index, StatsHistogram* sum)
+{
+    memset(sum, 0, sizeof(*sum));
+
+    if (index < 0 || index >= countProfileHistograms)
+        return;
+
+    for (int i = 0; i < countSlots; i++) {
+        StatsCounterSlot* slot = getSlot(i);
+        if (slot->seq == 0)
+            continue;
+        mergeHistogram(sum, getProfileHistogram(slot, index));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::snapshotNamedHistogram
+//-----------------------------------------------------------------------------
+
+PRBool StatsCounters::snapshotNamedHistogram(int idx, StatsHistogramType* type,
+                                             const char** id, StatsHistogram* copy)
+{
+    if (!named || idx < 0 || idx >= STATS_HISTOGRAM_NAMED_SLOTS)
+        return PR_FALSE;
+
+    const StatsNamedHistogram* entry = &named[idx];
+    PRUint32 t = entry->type;
+    if (t != STATS_HISTOGRAM_VIRTUAL_SERVER && t != STATS_HISTOGRAM_LISTENER)
+        return PR_FALSE;
+    XP_ConsumerMemoryBarrier();
+
+    *type = (StatsHistogramType) t;
+    *id = entry->id;
+    memcpy(copy, &entry->histogram, sizeof(*copy));
+
+    return PR_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::countThreads
+//-----------------------------------------------------------------------------
+
+int StatsCounters::countThreads(PRUint32 mode)
+{
+    int count = 0;
+
+    for (int i = 0; i < countSlots; i++) {
+        const StatsCounterSlot* slot = getSlot(i);
+        if (slot->pid && slot->mode == mode)
+            count++;
+    }
+
+    return count;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::writePrometheus
+//-----------------------------------------------------------------------------
+
+static const struct {
+    PRUint32 mode;
+    const char* name;
+} threadModes[] = {
+    { STATS_THREAD_IDLE, "idle" },
+    { STATS_THREAD_DNS, "DNS" },
+    { STATS_THREAD_REQUEST, "request" },
+    { STATS_THREAD_PROCESSING, "processing" },
+    { STATS_THREAD_RESPONSE, "response" },
+    { STATS_THREAD_UPDATING, "updating" },
+    { STATS_THREAD_KEEPALIVE, "keep-alive" }
+};
+
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+//-----------------------------------------------------------------------------
+// appendLabelValue
+//
+// Append a label value, escaped as the text exposition format requires
+//-----------------------------------------------------------------------------
+
+static void appendLabelValue(NSString& out, const char* value)
+{
+    for (const char* p = value; *p; p++) {
+        if (*p == '\\' || *p == '"') {
+            out.append('\\');
+            out.append(*p);
+        } else if (*p == '\n') {
+            out.append("\\n");
+        } else {
+            out.append(*p);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// appendSummary
+//
+// Append a histogram as the samples of a Prometheus summary.  label is NULL
+// or the name of a label whose value is value.
+//-----------------------------------------------------------------------------
+
+static void appendSummary(NSString& out, const char* metric,
+                          const char* label, const char* value,
+                          const StatsHistogram* histogram)
+{
+    NSString labels;
+    if (label) {
+        labels.append(label);
+        labels.append("=\"");
+        appendLabelValue(labels, value);
+        labels.append("\",");
+    }
+
+    for (int i = 0; i < (int)(sizeof(quantiles) / sizeof(quantiles[0])); i++) {
+        PRUint64 microseconds = StatsCounters::getHistogramPercentile(histogram, quantiles[i]);
+        out.printf("%s{%squantile=\"%g\"} %llu.%06llu\n",
+                   metric, labels.data(), quantiles[i],
+                   microseconds / PR_USEC_PER_SEC,
+                   microseconds % PR_USEC_PER_SEC);
+    }
+
+    // Strip the trailing comma for the _sum and _count samples
+    NSString suffix;
+    if (label) {
+        suffix.append('{');
+        suffix.append(labels.data(), labels.length() - 1);
+        suffix.append('}');
+    }
+
+    out.printf("%s_sum%s %llu.%06llu\n",
+               metric, suffix.data(),
+               histogram->microsecondsTotal / PR_USEC_PER_SEC,
+               histogram->microsecondsTotal % PR_USEC_PER_SEC);
+    out.printf("%s_count%s %llu\n",
+               metric, suffix.data(),
+               StatsCounters::getHistogramCount(histogram));
+}
+
+int StatsCounters::writePrometheus(PRFileDesc* fd)
+{
+    StatsCounterValues sum;
+    snapshot(&sum);
+
+    NSString out;
+    out.setGrowthSize(NSString::MEDIUM_STRING);
+    int i;
+
+    out.printf(
+        "# HELP webserver_requests_total Requests processed.\n"
+        "# TYPE webserver_requests_total counter\n"
+        "webserver_requests_total %llu\n"
+        "# HELP webserver_responses_total Responses by status class and code.\n"
+        "# TYPE webserver_responses_total counter\n"
+        "webserver_responses_total{class=\"2xx\"} %llu\n"
+        "webserver_responses_total{class=\"3xx\"} %llu\n"
+        "webserver_responses_total{class=\"4xx\"} %llu\n"
+        "webserver_responses_total{class=\"5xx\"} %llu\n"
+        "webserver_responses_total{class=\"other\"} %llu\n"
+        "webserver_responses_total{code=\"200\"} %llu\n"
+        "webserver_responses_total{code=\"302\"} %llu\n"
+        "webserver_responses_total{code=\"304\"} %llu\n"
+        "webserver_responses_total{code=\"400\"} %llu\n"
+        "webserver_responses_total{code=\"401\"} %llu\n"
+        "webserver_responses_total{code=\"403\"} %llu\n"
+        "webserver_responses_total{code=\"404\"} %llu\n"
+        "webserver_responses_total{code=\"503\"} %llu\n",
+        sum.countRequests,
+        sum.count2xx, sum.count3xx, sum.count4xx, sum.count5xx, sum.countOther,
+        sum.count200, sum.count302, sum.count304, sum.count400,
+        sum.count401, sum.count403, sum.count404, sum.count503);
+
+    out.printf(
+        "# HELP webserver_received_bytes_total Bytes received in requests.\n"
+        "# TYPE webserver_received_bytes_total counter\n"
+        "webserver_received_bytes_total %llu\n"
+        "# HELP webserver_transmitted_bytes_total Bytes transmitted in responses.\n"
+        "# TYPE webserver_transmitted_bytes_total counter\n"
+        "webserver_transmitted_bytes_total %llu\n"
+        "# HELP webserver_keepalive_hits_total Requests received on keep-alive connections.\n"
+        "# TYPE webserver_keepalive_hits_total counter\n"
+        "webserver_keepalive_hits_total %llu\n"
+        "# HELP webserver_processing_seconds_total Time spent processing requests.\n"
+        "# TYPE webserver_processing_seconds_total counter\n"
+        "webserver_processing_seconds_total %llu.%06llu\n",
+        sum.countBytesReceived,
+        sum.countBytesTransmitted,
+        sum.countKeepaliveHits,
+        sum.microsecondsProcessing / PR_USEC_PER_SEC,
+        sum.microsecondsProcessing % PR_USEC_PER_SEC);
+
+    out.printf(
+        "# HELP webserver_threads Worker threads by mode.\n"
+        "# TYPE webserver_threads gauge\n");
+    for (i = 0; i < (int)(sizeof(threadModes) / sizeof(threadModes[0])); i++) {
+        out.printf("webserver_threads{mode=\"%s\"} %d\n",
+                   threadModes[i].name, countThreads(threadModes[i].mode));
+    }
+
+    StatsHistogram histogram;
+
+    // Server wide request latency
+    out.printf(
+        "# HELP webserver_request_duration_seconds Request latency.\n"
+        "# TYPE webserver_request_duration_seconds summary\n");
+    snapshotRequestHistogram(&histogram);
+    appendSummary(out, "webserver_request_duration_seconds",
+                  NULL, NULL, &histogram);
+
+    // Request latency by virtual server and listener
+    StatsHistogramType types[] = { STATS_HISTOGRAM_VIRTUAL_SERVER,
+                                   STATS_HISTOGRAM_LISTENER };
+    const char* metrics[] = { "webserver_virtual_server_request_duration_seconds",
+                              "webserver_listener_request_duration_seconds" };
+    const char* labels[] = { "vs", "listener" };
+    for (int t = 0; t < 2; t++) {
+        out.printf("# HELP %s Request latency by %s.\n"
+                   "# TYPE %s summary\n",
+                   metrics[t], labels[t], metrics[t]);
+        for (i = 0; i < STATS_HISTOGRAM_NAMED_SLOTS; i++) {
+            StatsHistogramType type;
+            const char* id;
+            if (snapshotNamedHistogram(i, &type, &id, &histogram) &&
+                type == types[t])
+            {
+                appendSummary(out, metrics[t], labels[t], id, &histogram);
+            }
+        }
+    }
+
+    // Time spent in NSAPI functions by profile bucket
+    if (countProfileHistograms > 0) {
+        out.printf(
+            "# HELP webserver_function_duration_seconds NSAPI function latency by profile bucket.\n"
+            "# TYPE webserver_function_duration_seconds summary\n");
+        for (i = 0; i < countProfileHistograms; i++) {
+            const char* name = StatsManager::getProfileBucketName(i);
+            if (!name)
+                continue;
+            snapshotProfileHistogram(i, &histogram);
+            appendSummary(out, "webserver_function_duration_seconds",
+                          "bucket", name, &histogram);
+        }
+    }
+
+    if (PR_Write(fd, out.data(), out.length()) != (int) out.length())
+        return -1;
+
+    return 0;
+}
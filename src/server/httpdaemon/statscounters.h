@@ -0,0 +1,322 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STATSCOUNTERS_H
+#define STATSCOUNTERS_H
+
+#include "nspr.h"
+#include "xp/xp.h"
+#include "httpdaemon/libdaemon.h"
+
+//-----------------------------------------------------------------------------
+// StatsCounterValues
+//
+// Monotonic request counters kept by each worker thread.
+//-----------------------------------------------------------------------------
+
+struct StatsCounterValues {
+    PRUint64 countRequests;
+    PRUint64 countBytesReceived;
+    PRUint64 countBytesTransmitted;
+    PRUint64 count2xx;
+    PRUint64 count3xx;
+    PRUint64 count4xx;
+    PRUint64 count5xx;
+    PRUint64 countOther;
+    PRUint64 count200;
+    PRUint64 count302;
+    PRUint64 count304;
+    PRUint64 count400;
+    PRUint64 count401;
+    PRUint64 count403;
+    PRUint64 count404;
+    PRUint64 count503;
+    PRUint64 countKeepaliveHits;
+    PRUint64 microsecondsProcessing;
+};
+
+// Slots and shared histograms are aligned to this many bytes
+#define STATS_COUNTER_CACHE_LINE 64
+
+//-----------------------------------------------------------------------------
+// StatsHistogram
+//
+// Fixed size, HDR style latency histogram.  Values are microseconds.  Values
+// below STATS_HISTOGRAM_SUB_BUCKETS have a bucket each; above that, every
+// power of two is split into STATS_HISTOGRAM_SUB_BUCKETS linear buckets, so
+// a bucket's width is never more than 1/8 of its lower bound.  Values of
+// 2^STATS_HISTOGRAM_MAX_BITS microseconds (about 268 seconds) and above
+// share the last bucket.  The largest value is kept exactly.
+//-----------------------------------------------------------------------------
+
+#define STATS_HISTOGRAM_SUB_BITS 3
+#define STATS_HISTOGRAM_SUB_BUCKETS (1 << STATS_HISTOGRAM_SUB_BITS)
+#define STATS_HISTOGRAM_MAX_BITS 28
+#define STATS_HISTOGRAM_BUCKETS ((STATS_HISTOGRAM_MAX_BITS - STATS_HISTOGRAM_SUB_BITS + 1) * STATS_HISTOGRAM_SUB_BUCKETS)
+
+struct StatsHistogram {
+    PRUint64 counts[STATS_HISTOGRAM_BUCKETS];
+    PRUint64 microsecondsTotal;
+    PRUint64 microsecondsMax;
+};
+
+//-----------------------------------------------------------------------------
+// StatsHistogramType
+//-----------------------------------------------------------------------------
+
+enum StatsHistogramType { STATS_HISTOGRAM_FREE = 0,
+                          STATS_HISTOGRAM_VIRTUAL_SERVER = 1,
+                          STATS_HISTOGRAM_LISTENER = 2,
+                          STATS_HISTOGRAM_CLAIMING = 0xff };
+
+//-----------------------------------------------------------------------------
+// StatsNamedHistogram
+//
+// A histogram shared by every thread and process that serves requests for a
+// particular virtual server or listener.  Every getNamedHistogram() takes a
+// reference that releaseNamedHistogram() drops; the last release clears the
+// entry so another name can claim it.
+//-----------------------------------------------------------------------------
+
+struct StatsNamedHistogram {
+    volatile PRUint32 type;
+    volatile PRUint32 refs;
+    char id[129];
+    char reserved[STATS_COUNTER_CACHE_LINE - 8 - 129 % STATS_COUNTER_CACHE_LINE];
+    StatsHistogram histogram;
+};
+
+#define STATS_HISTOGRAM_NAMED_SLOTS 256
+
+//-----------------------------------------------------------------------------
+// StatsCounterSlot
+//
+// One thread's counters in the shared counter segment.  Each slot has a
+// single writer, the thread that claimed it, which brackets its updates by
+// incrementing seq so that seq is odd while an update is in progress.
+// Readers copy the values and retry if seq was odd or changed.  Slots are
+// padded to a multiple of the cache line size so that threads never write
+// to the same line.  A released slot keeps its values so the totals remain
+// monotonic when the slot is reused.
+//
+// Each slot is followed by the thread's request latency histogram and one
+// histogram per profile bucket.  The owning thread updates these without
+// the sequence counter; a reader may see a histogram that is a request or
+// two out of date, which doesn't matter for percentiles.
+//-----------------------------------------------------------------------------
+
+struct StatsCounterSlotData {
+    volatile PRUint32 seq;
+    volatile PRUint32 pid;
+    volatile PRUint32 mode;
+    PRUint32 reserved;
+    StatsCounterValues values;
+};
+
+struct StatsCounterSlot : public StatsCounterSlotData {
+    char pad[STATS_COUNTER_CACHE_LINE - sizeof(StatsCounterSlotData) % STATS_COUNTER_CACHE_LINE];
+};
+
+//-----------------------------------------------------------------------------
+// StatsCounters
+//
+// Lock free, per thread request counters and latency histograms that live in
+// memory shared by the primordial process and all its children.  Any process
+// can produce a server-wide snapshot without taking a lock or exchanging
+// messages with the other processes.
+//-----------------------------------------------------------------------------
+
+class HTTPDAEMON_DLL StatsCounters {
+public:
+    // Called by the primordial process prior to the first fork
+    static PRStatus init(int maxProcs, int maxThreads, int countProfileBuckets);
+
+    // Called by the primordial process on server shutdown
+    static void terminate();
+
+    // Claim a slot for the calling thread.  Returns NULL if every slot is
+    // in use.
+    static StatsCounterSlot* allocSlot();
+
+    // Release a slot claimed by allocSlot()
+    static void freeSlot(StatsCounterSlot* slot);
+
+    // Release the slots of a process that died without releasing them
+    static void freeProcessSlots(PRInt32 pid);
+
+    // Bracket updates to a slot's values
+    static inline void beginUpdate(StatsCounterSlot* slot);
+    static inline void endUpdate(StatsCounterSlot* slot);
+
+    // Return a slot's request latency or profile bucket histogram
+    static inline StatsHistogram* getRequestHistogram(StatsCounterSlot* slot);
+    static inline StatsHistogram* getProfileHistogram(StatsCounterSlot* slot, int index);
+
+    // Find or create the shared histogram for a virtual server or listener
+    // and take a reference to it.  Returns NULL if the table is full.
+    static StatsHistogram* getNamedHistogram(StatsHistogramType type, const char* id);
+
+    // Drop a reference taken by getNamedHistogram
+    static void releaseNamedHistogram(StatsHistogram* histogram);
+
+    // Record a value in a histogram owned by the calling thread
+    static inline void recordHistogram(StatsHistogram* histogram, PRUint64 microseconds);
+
+    // Record a value in a histogram shared with other threads
+    static void recordHistogramAtomic(StatsHistogram* histogram, PRUint64 microseconds);
+
+    // Sum the values of every slot
+    static void snapshot(StatsCounterValues* sum);
+
+    // Sum the request latency histograms or the histograms for a profile
+    // bucket from every slot
+    static void snapshotRequestHistogram(StatsHistogram* sum);
+    static void snapshotProfileHistogram(int index, StatsHistogram* sum);
+
+    // Copy the idx'th named histogram.  Returns PR_FALSE if there is no such
+    // histogram.
+    static PRBool snapshotNamedHistogram(int idx, StatsHistogramType* type,
+                                         const char** id, StatsHistogram* copy);
+
+    // Return the number of values recorded in a histogram
+    static PRUint64 getHistogramCount(const StatsHistogram* histogram);
+
+    // Return the value at or below which the fraction q of the values
+    // recorded in a histogram fall
+    static PRUint64 getHistogramPercentile(const StatsHistogram* histogram, double q);
+
+    // Count the claimed slots whose mode is mode
+    static int countThreads(PRUint32 mode);
+
+    // Return the number of per thread profile bucket histograms
+    static int getProfileHistogramCount() { return countProfileHistograms; }
+
+    // Write a snapshot in the Prometheus text exposition format
+    static int writePrometheus(PRFileDesc* fd);
+
+    static PRBool isInitialized() { return (slots != NULL); }
+
+private:
+    static inline StatsCounterSlot* getSlot(int i);
+    static inline int getHistogramIndex(PRUint64 microseconds);
+    static PRBool readSlot(const StatsCounterSlot* slot,
+                           StatsCounterValues* values);
+    static void mergeHistogram(StatsHistogram* sum, const StatsHistogram* histogram);
+
+    static struct shmem_s* shmem;
+    static char* slots;
+    static int sizeSlot;
+    static int countSlots;
+    static int countProfileHistograms;
+    static StatsNamedHistogram* named;
+};
+
+//-----------------------------------------------------------------------------
+// StatsCounters::beginUpdate
+//-----------------------------------------------------------------------------
+
+inline void StatsCounters::beginUpdate(StatsCounterSlot* slot)
+{
+    slot->seq++;
+    XP_ProducerMemoryBarrier();
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::endUpdate
+//-----------------------------------------------------------------------------
+
+inline void StatsCounters::endUpdate(StatsCounterSlot* slot)
+{
+    XP_ProducerMemoryBarrier();
+    slot->seq++;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::getSlot
+//-----------------------------------------------------------------------------
+
+inline StatsCounterSlot* StatsCounters::getSlot(int i)
+{
+    return (StatsCounterSlot*) (slots + i * sizeSlot);
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::getRequestHistogram
+//-----------------------------------------------------------------------------
+
+inline StatsHistogram* StatsCounters::getRequestHistogram(StatsCounterSlot* slot)
+{
+    return (StatsHistogram*) (slot + 1);
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::getProfileHistogram
+//-----------------------------------------------------------------------------
+
+inline StatsHistogram* StatsCounters::getProfileHistogram(StatsCounterSlot* slot, int index)
+{
+    PR_ASSERT(index >= 0 && index < countProfileHistograms);
+    return getRequestHistogram(slot) + 1 + index;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::getHistogramIndex
+//-----------------------------------------------------------------------------
+
+inline int StatsCounters::getHistogramIndex(PRUint64 microseconds)
+{
+    if (microseconds < STATS_HISTOGRAM_SUB_BUCKETS)
+        return (int) microseconds;
+
+    if (microseconds >= ((PRUint64) 1 << STATS_HISTOGRAM_MAX_BITS))
+        return STATS_HISTOGRAM_BUCKETS - 1;
+
+    int bits = PR_FloorLog2((PRUint32) microseconds);
+    int sub = (int) (microseconds >> (bits - STATS_HISTOGRAM_SUB_BITS)) & (STATS_HISTOGRAM_SUB_BUCKETS - 1);
+
+    return (bits - STATS_HISTOGRAM_SUB_BITS + 1) * STATS_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+//-----------------------------------------------------------------------------
+// StatsCounters::recordHistogram
+//-----------------------------------------------------------------------------
+
+inline void StatsCounters::recordHistogram(StatsHistogram* histogram, PRUint64 microseconds)
+{
+    histogram->counts[getHistogramIndex(microseconds)]++;
+    histogram->microsecondsTotal += microseconds;
+    if (microseconds > histogram->microsecondsMax)
+        histogram->microsecondsMax = microseconds;
+}
+
+#endif // STATSCOUNTERS_H
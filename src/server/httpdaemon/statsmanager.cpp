@@ -47,6 +47,7 @@
 #include "time/nstime.h"
 #include "httpdaemon/vsmanager.h"
 #include "httpdaemon/statsmanager.h"
+#include "httpdaemon/statscounters.h"
 #include "httpdaemon/libdaemon.h"
 #include "httpdaemon/daemonsession.h"
 #include "httpdaemon/httprequest.h"
@@ -522,6 +523,9 @@ int StatsManager::initEarly(int maxProcs, int maxThreads)
     hdr->process = 0;
     hdr->vss = 0;
 
+    // Per thread request counters shared by every process
+    StatsCounters::init(maxProcs, maxThreads, countProfileBuckets);
+
     accumulatedVSStats = new StatsAccumulatedVSSlot;
     memset(accumulatedVSStats, 0, sizeof(StatsAccumulatedVSSlot));
 
@@ -601,6 +605,7 @@ void StatsManager::terminateServer()
 {
     if (hdr) memset(hdr->hdrStats.magic, 0, sizeof(hdr->hdrStats.magic));
     if (shmem) shmem_free(shmem);
+    StatsCounters::terminate();
 #ifdef XP_WIN32
     if (ntStatsServer) {
         ntStatsServer->terminate();
@@ -812,6 +817,7 @@ void StatsManager::freeProcessSlot(PRInt32 pid)
     // This should only be called from the primordial process following child
     // death
     hdr->hdrStats.countChildDied++;
+    StatsCounters::freeProcessSlots(pid);
 }
 
 //-----------------------------------------------------------------------------
@@ -964,6 +970,12 @@ StatsVirtualServerNode* StatsManager::getVirtualServerSlot(const VirtualServer*
         statsAppendLast(hdr, vss);
     }
 
+    // Request latency for this VS is shared by every process
+    if (!vss->latency) {
+        vss->latency = StatsCounters::getNamedHistogram(
+                                STATS_HISTOGRAM_VIRTUAL_SERVER, vs->name);
+    }
+
     // Store a reference to vss in vs so we can find it quickly next time
     vs->setUserData(slotVSPrivateData, vss);
 
@@ -1189,6 +1201,19 @@ void StatsManager::pollStats(void)
     }
 #endif
 
+    // Update StatsSslBucket
+    StatsSslBucket* ssl = &procCurrent->procStats.sslBucket;
+    SSLSessionInfo infoSsl;
+    if (GetSSLSessionInfo(&infoSsl)) {
+        ssl->flagCacheEnabled = infoSsl.flagCacheEnabled;
+        ssl->flagTicketsSupported = infoSsl.flagTicketsSupported;
+        ssl->countHandshakes = infoSsl.numHandshakes;
+        ssl->countFullHandshakes = infoSsl.numFullHandshakes;
+        ssl->countCacheResumptions = infoSsl.numCacheResumptions;
+        ssl->countTicketResumptions = infoSsl.numTicketResumptions;
+        ssl->countCacheMisses = infoSsl.numCacheMisses;
+    }
+
     // Update StatsKeepaliveBucket
     StatsKeepaliveBucket* keepalive = &procCurrent->procStats.keepAliveBucket;
     keepAliveInfo infoKeepalive;
@@ -1226,6 +1251,11 @@ void StatsManager::pollStats(void)
             vss->vssStats.mode = STATS_VIRTUALSERVER_EMPTY;
             request->countOpenConnections = 0;
             request->rateBytesTransmitted = 0;
+
+            // Let another name have its latency histogram
+            StatsHistogram* latency = vss->latency;
+            vss->latency = NULL;
+            StatsCounters::releaseNamedHistogram(latency);
         }
         vss = vss->next;
     }
@@ -1442,6 +1472,9 @@ void StatsManager::runSelfDiagnostics()
     nSize = sizeof(struct _StatsDnsBucket);
     PR_ASSERT(nSize % 8 == 0);
     ereport(LOG_INFORM, "_StatsDnsBucket                 %d", nSize);
+    nSize = sizeof(struct _StatsSslBucket);
+    PR_ASSERT(nSize % 8 == 0);
+    ereport(LOG_INFORM, "_StatsSslBucket                 %d", nSize);
     nSize = sizeof(struct _StatsKeepaliveBucket);
     PR_ASSERT(nSize % 8 == 0);
     ereport(LOG_INFORM, "_StatsKeepaliveBucket           %d", nSize);
@@ -1636,6 +1669,17 @@ int StatsManager::serviceDumpStats(PRFileDesc * fd, const char* query)
                              statsmsgReqGetServiceDumpAck);
 }
 
+//-----------------------------------------------------------------------------
+// StatsManager::getProfileBucketName
+//-----------------------------------------------------------------------------
+
+const char* StatsManager::getProfileBucketName(int index)
+{
+    if (index < 0 || index >= countProfileBuckets)
+        return NULL;
+    return getNameFromStringStore(((ProfileBucketStrings*)profiles[index])->name);
+}
+
 //-----------------------------------------------------------------------------
 // StatsManager::getNameFromStringStore
 //-----------------------------------------------------------------------------
@@ -133,6 +133,7 @@ public:
     static ptrdiff_t getFunctionName(const char *name);
     static void addProfileBucket(const char* name, const char* description);
     static int getProfileBucketCount() { return countProfileBuckets; }
+    static const char* getProfileBucketName(int index);
     static StatsHeaderNode* getHeader() { return hdr; }
     static StatsProcessNode* findProcessSlot();
     static void activateProcessSlot(PRInt32 pid);
@@ -38,6 +38,9 @@
 #include "base/util.h"          // util_snprintf
 #include "httpdaemon/vsconf.h"  // VirtualServer
 
+// Number of times getThreadStats() retries a copy that raced with an update
+#define STATS_THREAD_READ_RETRIES 100
+
 ////////////////////////////////////////////////////////////////
 
 // StatsProfileNode Class members
@@ -89,7 +92,8 @@ StatsVirtualServerNode::StatsVirtualServerNode(const VirtualServer* vs,
                                                int nProfileBucketsCount):
                                                wms(NULL),
                                                next(NULL),
-                                               profile(NULL)
+                                               profile(NULL),
+                                               latency(NULL)
 {
     nProfileBucketsCount_ = nProfileBucketsCount;
     if (nProfileBucketsCount > 0)
@@ -253,6 +257,7 @@ StatsVirtualServerNode::resetStats(void)
 //-----------------------------------------------------------------------------
 
 StatsThreadNode::StatsThreadNode(int nProfileBucketsCount):
+                                 seq_(0),
                                  next(0),
                                  profile(0)
 {
@@ -268,10 +273,6 @@ StatsThreadNode::StatsThreadNode(int nProfileBucketsCount):
         profile = new StatsProfileNode[nProfileBucketsCount];
         statsMakeListFromArray(profile, nProfileBucketsCount);
     }
-
-    // Create the lock that serializes access to realtime thread statistics
-    lock_ = PR_NewLock();
-
 }
 
 //-----------------------------------------------------------------------------
@@ -284,6 +285,25 @@ StatsThreadNode::~StatsThreadNode(void)
     profile = NULL;
 }
 
+//-----------------------------------------------------------------------------
+// StatsThreadNode::getThreadStats
+//-----------------------------------------------------------------------------
+
+void
+StatsThreadNode::getThreadStats(StatsThreadSlot* copy) const
+{
+    for (int i = 0; i < STATS_THREAD_READ_RETRIES; i++) {
+        PRUint32 seq = seq_;
+        XP_ConsumerMemoryBarrier();
+        memcpy(copy, &threadStats, sizeof(*copy));
+        XP_ConsumerMemoryBarrier();
+        if (!(seq & 1) && seq_ == seq)
+            return;
+    }
+
+    // The writer is stuck.  Settle for whatever we copied last.
+}
+
 //-----------------------------------------------------------------------------
 // StatsThreadNode::getNodeData
 //-----------------------------------------------------------------------------
@@ -291,7 +311,9 @@ StatsThreadNode::~StatsThreadNode(void)
 PRBool
 StatsThreadNode::getNodeData(StatsMsgBuff& msgbuff) const
 {
-    msgbuff.appendSlot(threadStats);
+    StatsThreadSlot copy;
+    getThreadStats(&copy);
+    msgbuff.appendSlot(copy);
     statsGetNodeListData(profile, msgbuff);
     return PR_TRUE;
 }
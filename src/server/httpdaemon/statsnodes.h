@@ -34,12 +34,14 @@
 #ifndef _STATSNODES_H
 #define _STATSNODES_H
 
+#include "xp/xp.h"                   // XP_ProducerMemoryBarrier
 #include "public/iwsstats.h"         // StatsxxxSlot
 #include "httpdaemon/libdaemon.h"    // HTTPDAEMON_DLL
 #include "support/NSString.h"        // NSString
 
 class VirtualServer;
 class StatsMsgBuff;
+struct StatsHistogram;
 
 //----------------------------------------------------------
 //
@@ -73,14 +75,16 @@ struct StatsProfileNode
 // StatsThreadNode
 //
 // N.B. Unlike other statistics, some thread-specific statistics are updated in
-// realtime without acquiring calling StatsManager::lockStatsData().  These
-// statistics are protected by StatsThreadNode::lock().
+// realtime without calling StatsManager::lockStatsData().  The thread that
+// owns the node is their only writer and brackets each update with
+// beginUpdate() and endUpdate().  Readers take a consistent copy with
+// getThreadStats() instead of locking out the writer.
 //-----------------------------------------------------------------------------
 
 struct HTTPDAEMON_DLL StatsThreadNode
 {
 private:
-    PRLock* lock_;
+    volatile PRUint32 seq_;
     int nProfileBucketsCount_;
 
 public:
@@ -90,8 +94,9 @@ public:
 
     StatsThreadNode(int nProfileBucketsCount);
     ~StatsThreadNode(void);
-    void lock() { PR_Lock(lock_); }
-    void unlock() { PR_Unlock(lock_); }
+    inline void beginUpdate();
+    inline void endUpdate();
+    void getThreadStats(StatsThreadSlot* copy) const;
     PRBool getNodeData(StatsMsgBuff& msgbuff) const;
     PRBool compareId(int mode) const;
 };
@@ -368,6 +373,7 @@ public:
     StatsProfileNode* profile;
     StatsWebModuleNode* wms;
     StatsVirtualServerNode* next;
+    StatsHistogram* latency;
 
 
     StatsVirtualServerNode(const VirtualServer* vs, int nProfileBucketsCount);
@@ -663,6 +669,22 @@ StatsHeaderNode::setFirst(StatsCpuInfoNode* cpsNode)
     cps = cpsNode;
 }
 
+inline
+void
+StatsThreadNode::beginUpdate()
+{
+    seq_++;
+    XP_ProducerMemoryBarrier();
+}
+
+inline
+void
+StatsThreadNode::endUpdate()
+{
+    XP_ProducerMemoryBarrier();
+    seq_++;
+}
+
 inline
 void
 StatsHeaderNode::getFirst(StatsVirtualServerNode*& vssNode) const
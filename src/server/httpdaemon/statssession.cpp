@@ -74,6 +74,7 @@ StatsSession::StatsSession(const char* threadQName)
   countDirtyCacheEntries(0),
   countRequestsCached(0),
   thread(0),
+  counters(0),
   profiles(0),
   entriesVs(0),
   entryThread(0),
@@ -87,6 +88,9 @@ StatsSession::StatsSession(const char* threadQName)
 
     thread = StatsManager::allocThreadSlot(threadQName);
 
+    if (StatsCounters::isInitialized())
+        counters = StatsCounters::allocSlot();
+
     if (countProfileBuckets) {
         profiles = (StatsProfileBucket*)malloc(countProfileBuckets * sizeof(profiles[0]));
         memset(profiles, 0, countProfileBuckets * sizeof(profiles[0]));
@@ -107,6 +111,7 @@ StatsSession::~StatsSession()
 
     setMode(STATS_THREAD_EMPTY);
     flush();
+    StatsCounters::freeSlot(counters);
     free(profiles);
     free(entriesVs);
     free(entryThread);
@@ -122,12 +127,14 @@ void StatsSession::beginClient(PRNetAddr* remoteAddress)
 
     PRTime now = ft_timeNow();
 
+    if (counters) counters->mode = STATS_THREAD_REQUEST;
+
     // Update realtime thread stats
-    thread->lock();
+    thread->beginUpdate();
     thread->threadStats.mode = STATS_THREAD_REQUEST;
     net_addr_copy(&thread->threadStats.addressClient, remoteAddress);
     thread->threadStats.timeRequestStarted = now;
-    thread->unlock();
+    thread->endUpdate();
 }
 
 //-----------------------------------------------------------------------------
@@ -150,11 +157,13 @@ void StatsSession::beginRequest()
     if (thread->threadStats.mode != STATS_THREAD_REQUEST) {
         PRTime now = ft_timeNow();
 
+        if (counters) counters->mode = STATS_THREAD_REQUEST;
+
         // Update realtime thread stats
-        thread->lock();
+        thread->beginUpdate();
         thread->threadStats.mode = STATS_THREAD_REQUEST;
         thread->threadStats.timeRequestStarted = now;
-        thread->unlock();
+        thread->endUpdate();
     }
 }
 
@@ -178,7 +187,7 @@ void StatsSession::beginProcessing(const VirtualServer* vs, const HHString& meth
     int urilen = minimum(uri.len, sizeof(thread->threadStats.requestBucket.uri) - 1);
 
     // Update realtime thread stats
-    thread->lock();
+    thread->beginUpdate();
     thread->threadStats.mode = STATS_THREAD_PROCESSING;
     memcpy(thread->threadStats.vsId, vs->name, vsidlen);
     thread->threadStats.vsId[vsidlen] = '\0';
@@ -186,7 +195,7 @@ void StatsSession::beginProcessing(const VirtualServer* vs, const HHString& meth
     thread->threadStats.requestBucket.method[methodlen] = '\0';
     memcpy(thread->threadStats.requestBucket.uri, uri.ptr, urilen);
     thread->threadStats.requestBucket.uri[urilen] = '\0';
-    thread->unlock();
+    thread->endUpdate();
 
     // Get a StatsCacheEntry for this VS.  We will buffer VS-specific stats
     // updates in this entry until StatsSession::flush() is called.
@@ -203,7 +212,7 @@ void StatsSession::beginProcessing(const VirtualServer* vs, const HHString& meth
 // StatsSession::endProcessing
 //-----------------------------------------------------------------------------
 
-void StatsSession::endProcessing(const VirtualServer* vs, int statusHttp, PRInt64 countBytesReceived, PRInt64 countBytesTransmitted)
+void StatsSession::endProcessing(const VirtualServer* vs, int statusHttp, PRInt64 countBytesReceived, PRInt64 countBytesTransmitted, StatsHistogram* latencyListener)
 {
     if (!StatsManager::isInitialized()) return;
 
@@ -229,14 +238,17 @@ void StatsSession::endProcessing(const VirtualServer* vs, int statusHttp, PRInt6
     // We've updated StatsCacheEntrys
     countRequestsCached++;
 
+    // Update the lock free counters
+    countRequest(vs, statusHttp, countBytesReceived, countBytesTransmitted, latencyListener);
+
     // The session is idle
     inFunction(0);
-    thread->lock();
+    thread->beginUpdate();
     thread->threadStats.vsId[0] = '\0';
     thread->threadStats.requestBucket.method[0] = '\0';
     thread->threadStats.requestBucket.uri[0] = '\0';
     thread->threadStats.timeRequestStarted = 0;
-    thread->unlock();
+    thread->endUpdate();
 
     // Implicit flush if it's time
     if (isTimeForFlush()) flush();
@@ -257,12 +269,12 @@ void StatsSession::abortProcessing(const VirtualServer* vs)
 
     // The session is idle
     inFunction(0);
-    thread->lock();
+    thread->beginUpdate();
     thread->threadStats.vsId[0] = '\0';
     thread->threadStats.requestBucket.method[0] = '\0';
     thread->threadStats.requestBucket.uri[0] = '\0';
     thread->threadStats.timeRequestStarted = 0;
-    thread->unlock();
+    thread->endUpdate();
 }
 
 //-----------------------------------------------------------------------------
@@ -297,6 +309,60 @@ void StatsSession::cacheRequest(StatsCacheEntry* entry, int statusHttp, PRInt64
     }
 }
 
+//-----------------------------------------------------------------------------
+// StatsSession::countRequest
+//-----------------------------------------------------------------------------
+
+void StatsSession::countRequest(const VirtualServer* vs, int statusHttp, PRInt64 countBytesReceived, PRInt64 countBytesTransmitted, StatsHistogram* latencyListener)
+{
+    if (!counters) return;
+
+    PRIntervalTime ticksProcessing = PR_IntervalNow() - ticksBeginRequest;
+    PRUint64 microsecondsProcessing = PR_IntervalToMicroseconds(ticksProcessing);
+
+    StatsCounters::beginUpdate(counters);
+
+    StatsCounterValues& values = counters->values;
+
+    values.countRequests++;
+    values.countBytesReceived += countBytesReceived;
+    values.countBytesTransmitted += countBytesTransmitted;
+    values.microsecondsProcessing += microsecondsProcessing;
+
+    switch (statusHttp / 100) {
+    case 2:  values.count2xx++; break; 
+    case 3:  values.count3xx++; break; 
+    case 4:  values.count4xx++; break; 
+    case 5:  values.count5xx++; break; 
+    default: values.countOther++; break;
+    }
+
+    switch (statusHttp) {
+    case 200: values.count200++; break;
+    case 302: values.count302++; break;
+    case 304: values.count304++; break;
+    case 400: values.count400++; break;
+    case 401: values.count401++; break;
+    case 403: values.count403++; break;
+    case 404: values.count404++; break;
+    case 503: values.count503++; break;
+    }
+
+    StatsCounters::endUpdate(counters);
+
+    // Latency histograms.  This thread's histogram has no other writers; the
+    // VS and listener histograms are shared.
+    StatsCounters::recordHistogram(StatsCounters::getRequestHistogram(counters), microsecondsProcessing);
+
+    StatsVirtualServerNode* vss = StatsManager::getVirtualServerSlot(vs);
+    StatsHistogram* latencyVs = vss ? vss->latency : NULL;
+    if (latencyVs)
+        StatsCounters::recordHistogramAtomic(latencyVs, microsecondsProcessing);
+
+    if (latencyListener)
+        StatsCounters::recordHistogramAtomic(latencyListener, microsecondsProcessing);
+}
+
 //-----------------------------------------------------------------------------
 // StatsSession::cacheProfiles
 //-----------------------------------------------------------------------------
@@ -369,7 +435,9 @@ void StatsSession::flush()
     if (thread) {
         // Accumulate stats counter deltas for this thread
         flushProfiles(thread->profile, entryThread);
+        thread->beginUpdate();
         sumRequest(&thread->threadStats.requestBucket, &entryThread->request);
+        thread->endUpdate();
     }
 
     // Track keepalives
@@ -38,6 +38,7 @@
 #include <nspr.h>
 
 #include "httpdaemon/statsmanager.h"
+#include "httpdaemon/statscounters.h"
 #include "support/SimpleHash.h"
 
 typedef struct HHString HHString;
@@ -61,7 +62,7 @@ public:
     inline void endFunction(int indexProfileBucket);
     inline void abortFunction();
     void beginProcessing(const VirtualServer* vs, const HHString& method, const HHString& uri);
-    void endProcessing(const VirtualServer* vs, int statusHttp, PRInt64 countBytesReceived, PRInt64 countBytesTransmitted);
+    void endProcessing(const VirtualServer* vs, int statusHttp, PRInt64 countBytesReceived, PRInt64 countBytesTransmitted, StatsHistogram* latencyListener = NULL);
     void abortProcessing(const VirtualServer* vs);
     PRIntervalTime getRequestStartTime() { return ticksBeginRequest; }
     PRBool isFlushed();
@@ -71,6 +72,7 @@ public:
     static int countMaxCacheEntries;
 
 private:
+    void countRequest(const VirtualServer* vs, int statusHttp, PRInt64 countBytesReceived, PRInt64 countBytesTransmitted, StatsHistogram* latencyListener);
     void cacheRequest(StatsCacheEntry* entry, int statusHttp, PRInt64 countBytesReceived, PRInt64 countBytesTransmitted);
     void cacheProfiles(StatsCacheEntry* entry);
     void flushProfiles(StatsProfileNode* profile, const StatsCacheEntry* entry);
@@ -87,6 +89,7 @@ private:
     int countDirtyCacheEntries;
     int countRequestsCached;
     StatsThreadNode* thread;
+    StatsCounterSlot* counters;
     StatsProfileBucket* profiles;
     StatsCacheEntry* entriesVs;
     StatsCacheEntry* entryThread;
@@ -107,6 +110,7 @@ private:
 inline void StatsSession::setMode(PRUint32 mode)
 {
     if (thread) thread->threadStats.mode = mode;
+    if (counters) counters->mode = mode;
 }
 
 //-----------------------------------------------------------------------------
@@ -116,6 +120,12 @@ inline void StatsSession::setMode(PRUint32 mode)
 inline void StatsSession::recordKeepaliveHit()
 {
     countKeepaliveHits++;
+
+    if (counters) {
+        StatsCounters::beginUpdate(counters);
+        counters->values.countKeepaliveHits++;
+        StatsCounters::endUpdate(counters);
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -182,6 +192,13 @@ inline void StatsSession::endFunction(int indexProfileBucket)
             profiles[indexProfileBucket].ticksDispatch += ticksDispatch;
             profiles[indexProfileBucket].ticksFunction += ticksFunction;
 
+            if (counters) {
+                PRUint64 microseconds = PR_IntervalToMicroseconds(ticksFunction);
+                StatsCounters::recordHistogram(StatsCounters::getProfileHistogram(counters, STATS_PROFILE_ALL), microseconds);
+                if (indexProfileBucket != STATS_PROFILE_ALL)
+                    StatsCounters::recordHistogram(StatsCounters::getProfileHistogram(counters, indexProfileBucket), microseconds);
+            }
+
             ticksEndFunction = ticksNow;
         }
     }
@@ -693,6 +693,24 @@ void StatsManagerUtil::accumulateDNS(StatsDnsBucket* sum,
     sum->countAsyncLookupsInProgress += delta->countAsyncLookupsInProgress;
 }
 
+//-----------------------------------------------------------------------------
+// StatsManagerUtil::accumulateSsl
+//-----------------------------------------------------------------------------
+
+void StatsManagerUtil::accumulateSsl(StatsSslBucket* sum,
+                                     const StatsSslBucket* delta)
+{
+    if (!(delta && sum))
+        return;
+    sum->flagCacheEnabled            |= delta->flagCacheEnabled;
+    sum->flagTicketsSupported        |= delta->flagTicketsSupported;
+    sum->countHandshakes             += delta->countHandshakes;
+    sum->countFullHandshakes         += delta->countFullHandshakes;
+    sum->countCacheResumptions       += delta->countCacheResumptions;
+    sum->countTicketResumptions      += delta->countTicketResumptions;
+    sum->countCacheMisses            += delta->countCacheMisses;
+}
+
 //-----------------------------------------------------------------------------
 // StatsManagerUtil::accumulateRequest
 //
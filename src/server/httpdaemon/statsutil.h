@@ -219,6 +219,8 @@ public:
                                 const StatsCacheBucket* delta);
     static void accumulateDNS(StatsDnsBucket* sum,
                               const StatsDnsBucket* delta);
+    static void accumulateSsl(StatsSslBucket* sum,
+                              const StatsSslBucket* delta);
     static void accumulateRequest(StatsRequestBucket* sum,
                                   const StatsRequestBucket* delta);
     static void accumulateProfile(StatsProfileBucket* sum,
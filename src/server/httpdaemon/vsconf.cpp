@@ -125,9 +125,11 @@ VirtualServer :: VirtualServer(ServerXMLSchema::VirtualServer& config,
                 defaultVirtualDb = authDb->getVirtualDb();
         }
 
-        // Parse the objset template
-        // XXX when multiple VSs share a template, we should parse it only once
-        objset = objset_load(objectFile, NULL);
+        // Copy the objset template, which the Configuration parses only once
+        // for all the VSs that share it
+        const httpd_objset *tmpl = server->getObjsetTemplate(objectFile);
+        if (tmpl)
+            objset = objset_dup(tmpl);
         if (!objset) {
             // failed to parse
             NSString error;
@@ -32,596 +32,646 @@
  */
 
 #include "drcache.h"
+#include "xp/xp.h"
 
 DrHashNode::~DrHashNode()
 {
-	lastAge = maxAge = 0;
 	entry   = 0;
-	next    = prev   = 0;
+	next    = 0;
+	lruPrev = lruNext = 0;
 	keyLen  = 0;
-	delete key;
-	PR_DestroyLock(exAgeLock);
-	PR_DestroyRWLock(rwNodeLock);
+	delete [] key;
 }
 
-DrHashNode::DrHashNode()
+DrHashNode::DrHashNode(Entry *newEntry, const char *newKey, PRUint32 klen,
+						PRUint32 hash, PRIntervalTime timeout)
 {
-	lastAge = maxAge = 0;
-	entry   = 0;
-	next    = prev   = 0;
-	key     = 0;
-	keyLen  = 0;
-	exAgeLock  = 0;
-	rwNodeLock = 0;
-	
-}
-
-DrHashNode::DrHashNode(Entry *&newEntry, const char *newKey, PRUint32 klen)
-{
-	next       = prev = 0;
-	maxAge     = 0;
-	entry      = newEntry;
-	exAgeLock  = PR_NewLock();
-	rwNodeLock = PR_NewRWLock(PR_RWLOCK_RANK_NONE, "rwNodeLock");
-	lastAge    = PR_IntervalNow();
-	keyLen     = klen;
-	key        = new char[keyLen + 1];
-	memcpy((void *)key, (const void *)newKey, keyLen);
-}
-
-DrHashNode::DrHashNode(Entry *&newEntry, const char *newKey, PRUint32 klen,
-						PRIntervalTime timeout)
-{
-	next       = prev = 0;
+	next       = 0;
+	lruPrev    = lruNext = 0;
+	refreshing = 0;
+	referenced = 0;
+	size       = 0;
 	maxAge     = timeout;
 	entry      = newEntry;
-	exAgeLock  = PR_NewLock();
-	rwNodeLock = PR_NewRWLock(PR_RWLOCK_RANK_NONE, "rwNodeLock");
 	lastAge    = PR_IntervalNow();
+	hashVal    = hash;
 	keyLen     = klen;
 	key        = new char[keyLen + 1];
 	memcpy((void *)key, (const void *)newKey, keyLen);
+	key[keyLen] = '\0';
 }
 
-inline Entry *DrHashNode::replaceEntry(Entry *&newEntry)
-{
-/*Lock it in write mode - so no one is reading from it*/
-/*Assumes lock on ageLock*/
-
-	Entry *old = nodeLockWrite();
-	entry      = newEntry;
-	lastAge    = PR_IntervalNow();
-	nodeUnlock();
-	return old;
-}
-
-inline Entry *DrHashNode::replaceEntry(Entry *&newEntry, PRIntervalTime timeout)
-{
-/*Lock it in write mode - so no one is reading from it*/
-/*Assumes lock on ageLock*/
-
-	Entry *old = nodeLockWrite();
-	entry      = newEntry;
-	lastAge    = PR_IntervalNow();
-	maxAge     = timeout;
-	nodeUnlock();
-	return old;
-}
-
-inline void DrHashNode::linkNode(DrHashNode &newNode)
-{
-	next         = &newNode;
-	newNode.prev      = this;
-}
-
-void DrHashNode::ageLock(void)
-{
-	PR_Lock(exAgeLock);
-}
-
-void DrHashNode::ageUnlock(void)
-{
-	PR_Unlock(exAgeLock);
-}
-
-Entry *DrHashNode::nodeLockRead(void)
-{
-	PR_RWLock_Rlock(rwNodeLock);
-	return(entry);
-}
-
-inline Entry *DrHashNode::nodeLockWrite(void)
+Entry *DrHashNode::getEntry(void)
 {
-	PR_RWLock_Wlock(rwNodeLock);
-	return(entry);
-}
-
-void DrHashNode::nodeUnlock(void)
-{
-	PR_RWLock_Unlock(rwNodeLock);
+/*Caller must be inside a read section*/
+	Entry *out = entry;
+	XP_ConsumerMemoryBarrier();
+/*Tell the eviction scan that the node is in use*/
+	if(!referenced)
+	{
+		referenced = 1;
+	}
+	return(out);
 }
 
-inline PRBool DrHashNode::isExpired(PRIntervalTime range)
+PRBool DrHashNode::isExpired(PRIntervalTime now)
 {
-	return(((PR_IntervalNow() - lastAge) > range) ? PR_TRUE : PR_FALSE);
+/*A maxAge of 0 means the entry never expires*/
+	return((maxAge && (PRIntervalTime)(now - lastAge) > maxAge) ?
+							PR_TRUE : PR_FALSE);
 }
 
-inline PRBool DrHashNode::isExpired()
+PRBool DrHashNode::isExpired()
 {
-	return(((PR_IntervalNow() - lastAge) > maxAge) ? PR_TRUE : PR_FALSE);
+	return(isExpired(PR_IntervalNow()));
 }
 
 DrHashList::~DrHashList()
 {
+/*No readers remain; free everything directly*/
 	DrHashNode *iter = 0;
-	PR_RWLock_Wlock(rwListLock);
-	while(head)
+	while(lruHead)
 	{
-		iter      = head;
-	 	head = iter->next;
-		fnFre(iter->entry);
+		iter    = lruHead;
+		lruHead = iter->lruNext;
+		if(fnFre && iter->entry)
+		{
+			fnFre(iter->entry);
+		}
 		delete iter;
 	}
-	PR_RWLock_Unlock(rwListLock);
-	PR_DestroyRWLock(rwListLock);
-	head       = tail = 0;
+	freeRetired(retiredWaiting);
+	freeRetired(retired);
+	delete [] buckets;
+	PR_DestroyLock(lock);
+	lruHead    = lruTail = 0;
+	buckets    = 0;
 	ctr        = 0;
-	rwListLock = 0;
+	curBytes   = 0;
+	lock       = 0;
 	fnCmp      = 0;
 	fnRef      = 0;
 	fnFre      = 0;
 }
 
-DrHashList::DrHashList()
+DrHashList::DrHashList(PRUint32 nBuckets, PRUint64 maxSize,
+						PRIntervalTime maxAge, CompareFunc_t fnCompare,
+						RefreshFunc_t fnRefresh, FreeFunc_t fnFree)
 {
-	head       = tail = 0;
-	ctr        = 0;
-	rwListLock = 0;
-	fnCmp      = 0;
-	fnRef      = 0;
-	fnFre      = 0;
+	lock           = PR_NewLock();
+	buckets        = new DrHashNode * volatile [nBuckets];
+	bucketMask     = nBuckets - 1;
+	for(PRUint32 iCtr = 0; iCtr < nBuckets; iCtr++)
+	{
+		buckets[iCtr] = 0;
+	}
+	lruHead        = lruTail = 0;
+	ctr            = 0;
+	curBytes       = 0;
+	maxBytes       = maxSize;
+	maxEntryAge    = maxAge;
+	epoch          = 0;
+	readers[0]     = readers[1] = 0;
+	retired        = 0;
+	retiredWaiting = 0;
+	fnCmp          = fnCompare;
+	fnRef          = fnRefresh;
+	fnFre          = fnFree;
 }
 
-DrHashList::DrHashList(CompareFunc_t fnCompare, RefreshFunc_t fnRefresh,
-                        FreeFunc_t fnFree)
+PRUint32 DrHashList::readLock(void)
 {
-	head       = tail = 0;
-	ctr        = 0;
-	rwListLock = PR_NewRWLock(PR_RWLOCK_RANK_NONE, "rwListLock");
-	fnCmp      = fnCompare;
-	fnRef      = fnRefresh;
-	fnFre      = fnFree;
+	for(;;)
+	{
+		PRUint32 current = epoch & 1;
+		PR_AtomicIncrement((PRInt32 *)&readers[current]);
+		if((PRUint32)(epoch & 1) == current)
+		{
+			return(current);
+		}
+/*The epoch moved on while we registered, register against the new one*/
+		PR_AtomicDecrement((PRInt32 *)&readers[current]);
+	}
 }
 
-inline DrHashNode *DrHashList::getEntry(const char *&key, PRUint32 len,
-							Request *rq, Session *sn)
+void DrHashList::readUnlock(PRUint32 current)
 {
-	DrHashNode *node = head;
-	PR_RWLock_Rlock(rwListLock);
+	PR_AtomicDecrement((PRInt32 *)&readers[current]);
+}
+
+DrHashNode *DrHashList::findEntry(const char *key, PRUint32 len,
+							PRUint32 hash)
+{
+/*Called with the shard lock or inside a read section*/
+	DrHashNode *node = buckets[(hash >> DR_SHARD_BITS) & bucketMask];
 	while(node)
 	{
-		if(fnCmp(key, node->key, len, node->keyLen))
+		XP_ConsumerMemoryBarrier();
+		if(node->hashVal == hash && fnCmp(key, node->key, len, node->keyLen))
 		{
 			break;
 		}
 		node = node->next;
 	}
-	PR_RWLock_Unlock(rwListLock);
-	if(!node)
+	return(node);
+}
+
+PRUint32 DrHashList::entrySize(const Entry *entry, PRUint32 klen)
+{
+	PRUint32 size = sizeof(DrHashNode) + klen + 1;
+	if(entry)
 	{
-		node = putEntry(key, len, PR_FALSE, rq, sn);
+		size += sizeof(Entry) + entry->dataLen;
 	}
-	return node;
+	return(size);
 }
 
-inline DrHashNode *DrHashList::tryGetEntry(const char *&key, PRUint32 len,
-							Request *rq, Session *sn)
+inline void DrHashList::lruPush(DrHashNode *node)
 {
-	DrHashNode *node = head;
-	PR_RWLock_Rlock(rwListLock);
-	while(node)
+	node->lruPrev = 0;
+	node->lruNext = lruHead;
+	if(lruHead)
 	{
-		if(fnCmp(key, node->key, len, node->keyLen))
-		{
-			break;
-		}
-		node = node->next;
+		lruHead->lruPrev = node;
 	}
-	PR_RWLock_Unlock(rwListLock);
-	if(node)
+	else
 	{
-		node->ageLock();
-		if(node->isExpired())
-		{
-/*Send NULL so that caller refreshes it himself*/
-			node = 0;
-		}
-		node->ageUnlock();
+		lruTail = node;
 	}
-	return node;
+	lruHead = node;
 }
 
-inline DrHashNode *DrHashList::getUnexpiredEntry(const char *&key, PRUint32 len,
-							PRIntervalTime range, Request *rq, Session *sn)
+inline void DrHashList::lruUnlink(DrHashNode *node)
 {
-	DrHashNode *node = head;
-	PR_RWLock_Rlock(rwListLock);
-	while(node)
+	if(node->lruPrev)
 	{
-		if(fnCmp(key, node->key, len, node->keyLen))
-		{
-			break;
-		}
-		node = node->next;
+		node->lruPrev->lruNext = node->lruNext;
 	}
-	PR_RWLock_Unlock(rwListLock);
-	if(!node)
+	else
 	{
-		node = putEntry(key, len, PR_FALSE, rq, sn);
+		lruHead = node->lruNext;
 	}
-	if(node)
+	if(node->lruNext)
 	{
-/*Check for Expiry, if Expired then we replace it*/
-/*Get A lock on the agelock, this makes sure no one is writing to it*/
-		node->ageLock();
-		if(node->isExpired(range))
-		{
-/*Call The refresh Function to Add one for this key*/
-			Entry *entry = fnRef(key, len, 0, rq, sn);
-			Entry *old   = node->replaceEntry(entry);
-/*Delete the old entry*/
-			fnFre(old);
-		}
-		node->ageUnlock();
+		node->lruNext->lruPrev = node->lruPrev;
+	}
+	else
+	{
+		lruTail = node->lruPrev;
 	}
-	return node;
+	node->lruPrev = node->lruNext = 0;
 }
 
-inline DrHashNode *DrHashList::forceRefresh(const char *&key, PRUint32 len,
-							Request *rq, Session *sn)
+void DrHashList::retire(Entry *entry, DrHashNode *node)
 {
-	DrHashNode *node = head;
+/*Assumes the shard lock*/
+	DrRetired *item = new DrRetired;
+	item->entry = entry;
+	item->node  = node;
+	item->next  = retired;
+	retired     = item;
+}
 
-	PR_RWLock_Rlock(rwListLock);
-/*First Try to locate it*/
-	while(node)
+DrRetired *DrHashList::reclaim(void)
+{
+/*Assumes the shard lock.  Never waits for readers; if the readers of the*/
+/*previous epoch haven't all left, we try again next time*/
+	DrRetired *dead = 0;
+	if(retiredWaiting)
 	{
-		if(fnCmp(key, node->key, len, node->keyLen))
+		PRUint32 previous = (epoch & 1) ^ 1;
+		if(PR_AtomicAdd((PRInt32 *)&readers[previous], 0) != 0)
 		{
-			break;
+			return(0);
 		}
-		node = node->next;
+		dead           = retiredWaiting;
+		retiredWaiting = 0;
 	}
-	PR_RWLock_Unlock(rwListLock);
-	if(!node)
+	if(retired)
 	{
-		node = putEntry(key, len, PR_TRUE, rq, sn);
+/*Readers that register after the flip can't see anything retired so far*/
+		retiredWaiting = retired;
+		retired        = 0;
+		PR_AtomicSet((PRInt32 *)&epoch, epoch + 1);
 	}
-	else
-	{
-/*Call The refresh Function to Add one for this key*/
-		Entry *entry = fnRef(key, len, 0, rq, sn);
-
-/*Get A lock on the agelock, this makes sure no one is writing to it*/
-		node->ageLock();
-		Entry *old   = node->replaceEntry(entry);
-		node->ageUnlock();
-
-/*Delete the old entry*/
-		fnFre(old);
-	}
-	return node;
+	return(dead);
 }
 
-inline DrHashNode *DrHashList::refreshEntry(const char *&key, PRUint32 len,
-								PRIntervalTime timeout, Entry *entry)
+void DrHashList::freeRetired(DrRetired *list)
 {
-	DrHashNode *node = head;
-
-	PR_RWLock_Rlock(rwListLock);
-/*First Try to locate it*/
-	while(node)
+	while(list)
 	{
-		if(fnCmp(key, node->key, len, node->keyLen))
+		DrRetired *item = list;
+		list = item->next;
+		if(item->node)
 		{
-			break;
+			if(fnFre && item->node->entry)
+			{
+				fnFre(item->node->entry);
+			}
+			delete item->node;
 		}
-		node = node->next;
+		else
+		if(fnFre && item->entry)
+		{
+			fnFre(item->entry);
+		}
+		delete item;
 	}
-	PR_RWLock_Unlock(rwListLock);
-	if(!node)
+}
+
+void DrHashList::replaceEntry(DrHashNode *node, Entry *entry,
+							PRIntervalTime timeout)
+{
+/*Assumes the shard lock*/
+	Entry    *old  = node->entry;
+	PRUint32  size = entrySize(entry, node->keyLen);
+
+/*Make the new entry's contents visible before the entry itself*/
+	XP_ProducerMemoryBarrier();
+	node->entry   = entry;
+	if(timeout)
 	{
-		node = putEntry(key, len, timeout, entry);
+		node->maxAge = timeout;
 	}
-	else
+	node->lastAge = PR_IntervalNow();
+	curBytes      = curBytes - node->size + size;
+	node->size    = size;
+	if(old && old != entry)
 	{
-/*Get A lock on the agelock, this makes sure no one is writing to it*/
-		node->ageLock();
-		Entry *old   = node->replaceEntry(entry, timeout);
-		node->ageUnlock();
-/*Delete the old entry*/
-		fnFre(old);
+		retire(old, 0);
 	}
-	return node;
 }
 
-inline DrHashNode *DrHashList::putEntry(const char *&key, PRUint32 len,
-								PRBool ifForce, Request * rq, Session *sn)
+void DrHashList::removeNode(DrHashNode *node)
 {
-	DrHashNode *node = head;
+/*Assumes the shard lock.  Readers may still be walking through the node,*/
+/*so its next pointer is left alone*/
+	DrHashNode * volatile *link = &buckets[(node->hashVal >> DR_SHARD_BITS)
+							& bucketMask];
+	while(*link && *link != node)
+	{
+		link = &(*link)->next;
+	}
+	if(*link)
+	{
+		*link = node->next;
+	}
+	lruUnlink(node);
+	curBytes -= node->size;
+	ctr--;
+	retire(0, node);
+}
 
-	PR_RWLock_Wlock(rwListLock);
-/*Try locating the node one more time*/
-	while(node)
+void DrHashList::evict(void)
+{
+/*Assumes the shard lock*/
+	if(!maxBytes)
 	{
-		if(fnCmp(key, node->key, len, node->keyLen))
-		{
-			break;
-		}
-		node = node->next;
+		return;
 	}
-	if(!node)
+/*Give referenced nodes a second chance, but don't go round forever*/
+	PRUint32 scans = 2 * ctr;
+	while(curBytes > maxBytes && lruTail && scans--)
 	{
-/*Still not there, I will add one*/
-/*Call The refresh Function to Add one for this key*/
-		Entry *entry = fnRef(key, len, 0, rq, sn);
-		node = new DrHashNode(entry, key, len);
-		if(tail)
+		DrHashNode *node = lruTail;
+		if(node->referenced)
 		{
-			tail->linkNode(*node);
-			tail = node;
+			node->referenced = 0;
+			lruUnlink(node);
+			lruPush(node);
 		}
 		else
 		{
-			head = tail = node;
+			removeNode(node);
 		}
-		ctr++;
 	}
-	PR_RWLock_Unlock(rwListLock);
-	if(node && ifForce)
+	while(curBytes > maxBytes && lruTail)
 	{
-/*Requested a force Replace*/
-		Entry *entry = fnRef(key, len, 0, rq, sn);
-
-/*Get A lock on the agelock, this makes sure no one is writing to it*/
-		node->ageLock();
-		Entry *old   = node->replaceEntry(entry);
-		node->ageUnlock();
-
-/*Delete the old entry*/
-		fnFre(old);
+		removeNode(lruTail);
 	}
-	return(node);
 }
 
-inline DrHashNode *DrHashList::putEntry(const char *&key, PRUint32 len,
-		PRIntervalTime timeout, Entry *entry)
+DrHashNode *DrHashList::publish(const char *key, PRUint32 len, PRUint32 hash,
+							PRIntervalTime timeout, Entry *entry,
+							PRBool ifReplace)
 {
-	DrHashNode *node = head;
+	DrHashNode *node;
+	Entry      *unused = 0;
 
-	PR_RWLock_Wlock(rwListLock);
+	PR_Lock(lock);
 /*Try locating the node one more time*/
-	while(node)
-	{
-		if(fnCmp(key, node->key, len, node->keyLen))
-		{
-			break;
-		}
-		node = node->next;
-	}
-	if(!node)
+	node = findEntry(key, len, hash);
+	if(node)
 	{
-/*Still not there, I will add one*/
-		node = new DrHashNode(entry, key, len, timeout);
-		if(tail)
+		if(ifReplace)
 		{
-			tail->linkNode(*node);
-			tail = node;
+			replaceEntry(node, entry, timeout);
 		}
 		else
 		{
-			head = tail = node;
+/*Somebody beat us to it; nobody has seen our entry*/
+			unused = entry;
 		}
-		ctr++;
-		PR_RWLock_Unlock(rwListLock);
 	}
 	else
 	{
-		PR_RWLock_Unlock(rwListLock);
+/*Still not there, I will add one*/
+		node = new DrHashNode(entry, key, len, hash,
+							(timeout ? timeout : maxEntryAge));
+		node->size = entrySize(entry, len);
+		DrHashNode * volatile *bucket = &buckets[(hash >> DR_SHARD_BITS)
+							& bucketMask];
+		node->next = *bucket;
+/*Make the node visible only once it is complete*/
+		XP_ProducerMemoryBarrier();
+		*bucket = node;
+		lruPush(node);
+		curBytes += node->size;
+		ctr++;
+	}
+	evict();
+	DrRetired *dead = reclaim();
+	PR_Unlock(lock);
+
+	freeRetired(dead);
+	if(unused && fnFre)
+	{
+		fnFre(unused);
+	}
+	return(node);
+}
 
-/*Get A lock on the agelock, this makes sure no one is writing to it*/
+DrHashNode *DrHashList::getEntry(const char *key, PRUint32 len, PRUint32 hash,
+							Request *rq, Session *sn)
+{
+	DrHashNode *node = findEntry(key, len, hash);
+	if(!node)
+	{
+/*Call The refresh Function to Add one for this key*/
+		Entry *entry = fnRef(key, len, 0, rq, sn);
+		if(!entry)
+		{
+			return(0);
+		}
+		node = publish(key, len, hash, 0, entry, PR_FALSE);
+	}
+	return(node);
+}
 
-		node->ageLock();
-		Entry *old   = node->replaceEntry(entry, timeout);
-		node->ageUnlock();
+DrHashNode *DrHashList::tryGetEntry(const char *key, PRUint32 len,
+							PRUint32 hash)
+{
+	DrHashNode *node = findEntry(key, len, hash);
+	if(node && node->isExpired())
+	{
+/*Send NULL so that caller refreshes it himself*/
+		node = 0;
+	}
+	return(node);
+}
 
-/*Delete the old entry*/
-		fnFre(old);
+DrHashNode *DrHashList::getUnexpiredEntry(const char *key, PRUint32 len,
+							PRUint32 hash, Request *rq, Session *sn)
+{
+	DrHashNode *node = findEntry(key, len, hash);
+	if(!node)
+	{
+		return(getEntry(key, len, hash, rq, sn));
+	}
+/*Check for Expiry, if Expired then one thread replaces it while the*/
+/*others keep sending the old entry*/
+	if(node->isExpired() &&
+		PR_AtomicSet((PRInt32 *)&node->refreshing, 1) == 0)
+	{
+		Entry *entry = fnRef(key, len, 0, rq, sn);
+		DrHashNode *fresh = 0;
+		if(entry)
+		{
+			fresh = publish(key, len, hash, 0, entry, PR_TRUE);
+		}
+		node->refreshing = 0;
+		node = fresh;
 	}
 	return(node);
 }
 
-DrHashTable::~DrHashTable()
+DrHashNode *DrHashList::forceRefresh(const char *key, PRUint32 len,
+							PRUint32 hash, Request *rq, Session *sn)
 {
-	for(PRUint32 iCtr = 0; iCtr < hashSize; iCtr++)
+/*Call The refresh Function to Add one for this key*/
+	Entry *entry = fnRef(key, len, 0, rq, sn);
+	if(!entry)
 	{
-		delete hashTable[iCtr];
+		return(0);
 	}
-	delete hashTable;
+	return(publish(key, len, hash, 0, entry, PR_TRUE));
 }
 
-DrHashTable::DrHashTable()
+DrHashNode *DrHashList::refreshEntry(const char *key, PRUint32 len,
+							PRUint32 hash, PRIntervalTime timeout, Entry *entry)
 {
-	rwTableLock = 0;
-	maxEntryAge = 0;
-	hashSize    = 0;
-	hashMask    = 0;
-	hashTable   = 0;
-	fnCmp       = 0;
-	fnRef       = 0;
-	fnFre       = 0;
+	return(publish(key, len, hash, (timeout ? timeout : maxEntryAge), entry,
+							PR_TRUE));
 }
 
-DrHashTable::DrHashTable(PRUint32 maxEntries, PRIntervalTime maxAge, 
-						CompareFunc_t fnCompare, RefreshFunc_t fnRefresh,
-						FreeFunc_t fnFree)
+void DrHashList::sweep(PRIntervalTime now)
 {
-	rwTableLock = PR_NewRWLock(PR_RWLOCK_RANK_NONE, "rwTableLock");
-	maxEntryAge = maxAge;
-	hashSize    = (!(maxEntries % MIN_SIZE) ?
-		maxEntries : (maxEntries
-										+ (MIN_SIZE - (maxEntries % MIN_SIZE))));
-	hashMask    = hashSize - 1;
-	hashTable   = new DrHashList*[hashSize];
-	for(PRUint32 iCtr = 0; iCtr < hashSize; iCtr++)
+	PR_Lock(lock);
+/*Drop entries that have expired and weren't used since the last sweep*/
+	DrHashNode *node = lruTail;
+	while(node)
 	{
-		hashTable[iCtr] = 0;
+		DrHashNode *prev = node->lruPrev;
+		if(!node->refreshing && node->isExpired(now))
+		{
+			if(node->referenced)
+			{
+				node->referenced = 0;
+			}
+			else
+			{
+				removeNode(node);
+			}
+		}
+		node = prev;
 	}
-	fnCmp      = fnCompare;
-	fnRef      = fnRefresh;
-	fnFre      = fnFree;
+	evict();
+	DrRetired *dead = reclaim();
+	PR_Unlock(lock);
+
+	freeRetired(dead);
 }
 
-PRUint32 DrHashTable::hashIt(const char *&key, PRUint32 len)
+DrHashTable::~DrHashTable()
 {
-	PRUint32  iLen    = len;
-	PRUint32  iScatter = 0;
-	for(PRUint32 iCtr = 0; iCtr < iLen; iCtr++)
+	PR_Lock(sweepLock);
+	sweepStop = PR_TRUE;
+	PR_NotifyCondVar(sweepCv);
+	PR_Unlock(sweepLock);
+	if(sweeper)
 	{
-		iScatter += (key[iCtr] + iCtr + hashSize);
+		PR_JoinThread(sweeper);
 	}
-	return(((iScatter >> 3) ^ (iScatter << 3)) & hashMask);
+	for(PRUint32 iCtr = 0; iCtr < DR_SHARDS; iCtr++)
+	{
+		delete shards[iCtr];
+	}
+	PR_DestroyCondVar(sweepCv);
+	PR_DestroyLock(sweepLock);
 }
 
-DrHashNode *DrHashTable::getEntry(const char *&key, PRUint32 len, Request *rq,
-								Session *sn)
+DrHashTable::DrHashTable(PRUint32 maxEntries, PRUint64 maxBytes,
+						PRIntervalTime maxAge, CompareFunc_t fnCompare,
+						RefreshFunc_t fnRefresh, FreeFunc_t fnFree)
 {
-	DrHashNode    *out   = 0;
-	PRUint32 keyVal = hashIt(key, len);
-	
-/*Must Have a refresh Callback*/
-	if(!fnRef)
+	PRUint64 want = maxEntries;
+	if(!want && maxBytes)
 	{
-		return(0);
+		want = maxBytes / DR_AVERAGE_ENTRY_SIZE;
 	}
-	if(hashTable[keyVal])
+	if(want > DR_MAX_BUCKETS)
 	{
-		out = hashTable[keyVal]->getEntry(key, len, rq, sn);
+		want = DR_MAX_BUCKETS;
 	}
-	else
+	PRUint32 nBuckets = MIN_SIZE;
+	while((PRUint64)nBuckets * DR_SHARDS < want)
 	{
-		out = putEntry(key, len, PR_FALSE, rq, sn);
+		nBuckets <<= 1;
 	}
-	return(out);
+	PRUint64 shardBytes = (maxBytes + DR_SHARDS - 1) / DR_SHARDS;
+
+	maxEntryAge = maxAge;
+	for(PRUint32 iCtr = 0; iCtr < DR_SHARDS; iCtr++)
+	{
+		shards[iCtr] = new DrHashList(nBuckets, shardBytes, maxAge,
+							fnCompare, fnRefresh, fnFree);
+	}
+	sweepLock      = PR_NewLock();
+	sweepCv        = PR_NewCondVar(sweepLock);
+	sweeper        = 0;
+	sweeperStarted = 0;
+	sweepStop      = PR_FALSE;
+	fnCmp          = fnCompare;
+	fnRef          = fnRefresh;
+	fnFre          = fnFree;
 }
 
-DrHashNode *DrHashTable::tryGetEntry(const char *&key, PRUint32 len,
-				Request *rq, Session *sn)
+PRUint32 DrHashTable::hashIt(const char *key, PRUint32 len)
 {
-	DrHashNode    *out   = 0;
-	PRUint32 keyVal = hashIt(key, len);
-/*Need not check for the Refresh Function - when in this path*/	
-/*Implementor may just be checking for expiry - he manages freshness himself*/
-	if(hashTable[keyVal])
+/*FNV-1a*/
+	PRUint32 iScatter = 2166136261U;
+	for(PRUint32 iCtr = 0; iCtr < len; iCtr++)
 	{
-		out = hashTable[keyVal]->tryGetEntry(key, len, rq, sn);
+		iScatter ^= (unsigned char)key[iCtr];
+		iScatter *= 16777619U;
 	}
-	return(out);
+	return(iScatter);
 }
 
-DrHashNode *DrHashTable::getUnexpiredEntry(const char *&key, PRUint32 len,
-								Request *rq, Session *sn)
+void DrHashTable::startSweeper(void)
 {
-	DrHashNode    *out   = 0;
-	PRUint32 keyVal = hashIt(key, len);
-	
-/*Must Have a refresh Callback*/
-	if(!fnRef)
+/*Started on first use rather than at init so it runs in the process that*/
+/*serves requests*/
+	if(PR_AtomicSet((PRInt32 *)&sweeperStarted, 1) == 0)
 	{
-		return(0);
+		sweeper = PR_CreateThread(PR_SYSTEM_THREAD, sweeperMain, this,
+							PR_PRIORITY_LOW, PR_GLOBAL_THREAD,
+							PR_JOINABLE_THREAD, 0);
 	}
-	if(hashTable[keyVal])
+}
+
+void DrHashTable::sweeperMain(void *arg)
+{
+	DrHashTable *obj = (DrHashTable *)arg;
+
+	PR_Lock(obj->sweepLock);
+	while(!obj->sweepStop)
 	{
-		out = hashTable[keyVal]->getUnexpiredEntry(key, len,
-						maxEntryAge, rq, sn);
+		PR_WaitCondVar(obj->sweepCv, PR_SecondsToInterval(DR_SWEEP_INTERVAL));
+		if(obj->sweepStop)
+		{
+			break;
+		}
+		PR_Unlock(obj->sweepLock);
+		PRIntervalTime now = PR_IntervalNow();
+		for(PRUint32 iCtr = 0; iCtr < DR_SHARDS; iCtr++)
+		{
+			obj->shards[iCtr]->sweep(now);
+		}
+		PR_Lock(obj->sweepLock);
 	}
-	else
+	PR_Unlock(obj->sweepLock);
+}
+
+void DrHashTable::beginRead(const char *key, PRUint32 len, DrReadSection &rs)
+{
+	if(!sweeperStarted)
 	{
-		out = putEntry(key, len, PR_FALSE, rq, sn);
+		startSweeper();
 	}
-	return(out);
+	rs.hashVal = hashIt(key, len);
+	rs.shard   = shards[rs.hashVal & (DR_SHARDS - 1)];
+	rs.epoch   = rs.shard->readLock();
+}
+
+void DrHashTable::endRead(DrReadSection &rs)
+{
+	rs.shard->readUnlock(rs.epoch);
+	rs.shard = 0;
 }
 
-DrHashNode *DrHashTable::forceRefresh(const char *&key, PRUint32 len,
-								Request *rq, Session *sn)
+DrHashNode *DrHashTable::getEntry(DrReadSection &rs, const char *key,
+							PRUint32 len, Request *rq, Session *sn)
 {
-	DrHashNode    *out   = 0;
-	PRUint32 keyVal = hashIt(key, len);
-	
 /*Must Have a refresh Callback*/
 	if(!fnRef)
 	{
 		return(0);
 	}
-	if(hashTable[keyVal])
-	{
-		out = hashTable[keyVal]->forceRefresh(key, len, rq, sn);
-	}
-	else
-	{
-		out = putEntry(key, len, PR_TRUE, rq, sn);
-	}
-	return(out);
+	return(rs.shard->getEntry(key, len, rs.hashVal, rq, sn));
 }
 
-DrHashNode *DrHashTable::putEntry(const char *&key, PRUint32 len,
-								PRIntervalTime timeout, Entry *entry)
+DrHashNode *DrHashTable::tryGetEntry(DrReadSection &rs, const char *key,
+							PRUint32 len)
 {
-	PRUint32 keyVal = hashIt(key, len);
+/*Need not check for the Refresh Function - when in this path*/	
+/*Implementor may just be checking for expiry - he manages freshness himself*/
+	return(rs.shard->tryGetEntry(key, len, rs.hashVal));
+}
 
-/*this method is called by outsider on forcefully dr_cache_refresh*/
-	if(!hashTable[keyVal])
+DrHashNode *DrHashTable::getUnexpiredEntry(DrReadSection &rs, const char *key,
+							PRUint32 len, Request *rq, Session *sn)
+{
+/*Must Have a refresh Callback*/
+	if(!fnRef)
 	{
-		PR_RWLock_Wlock(rwTableLock);
-		if(!hashTable[keyVal])
-		{
-/*Still not there, I will add one*/
-			hashTable[keyVal] =
-						new DrHashList(fnCmp, fnRef, fnFre);
-		}
-		PR_RWLock_Unlock(rwTableLock);
+		return(0);
 	}
-	DrHashNode *out = hashTable[keyVal]->refreshEntry(key, len, ((timeout == 0) ?
-							maxEntryAge : timeout), entry);
-	return(out);
+	return(rs.shard->getUnexpiredEntry(key, len, rs.hashVal, rq, sn));
 }
 
-DrHashNode *DrHashTable::putEntry(const char *&key, PRUint32 len,
-								PRBool ifForce, Request *rq, Session *sn)
+DrHashNode *DrHashTable::forceRefresh(DrReadSection &rs, const char *key,
+							PRUint32 len, Request *rq, Session *sn)
 {
-	PRUint32 keyVal = hashIt(key, len);
-
-/*this method is not called by outsiders - so we do not check for fnRef != 0*/
-/*We have taken care of fnRef already*/
-	if(!hashTable[keyVal])
-	{
-		PR_RWLock_Wlock(rwTableLock);
-		if(!hashTable[keyVal])
-		{
-/*Still not there, I will add one*/
-			hashTable[keyVal] =
-						new DrHashList(fnCmp, fnRef, fnFre);
-		}
-		PR_RWLock_Unlock(rwTableLock);
-	}
-	DrHashNode *out;
-	if(ifForce)
+/*Must Have a refresh Callback*/
+	if(!fnRef)
 	{
-		out = hashTable[keyVal]->forceRefresh(key, len, rq, sn);
+		return(0);
 	}
-	else
+	return(rs.shard->forceRefresh(key, len, rs.hashVal, rq, sn));
+}
+
+DrHashNode *DrHashTable::putEntry(const char *key, PRUint32 len,
+								PRIntervalTime timeout, Entry *entry)
+{
+/*this method is called by outsider on forcefully dr_cache_refresh*/
+/*The node may be evicted as soon as we return, don't dereference it*/
+	if(!sweeperStarted)
 	{
-		out = hashTable[keyVal]->getEntry(key, len, rq, sn);
+		startSweeper();
 	}
-	return(out);
+	PRUint32 hash = hashIt(key, len);
+	return(shards[hash & (DR_SHARDS - 1)]->refreshEntry(key, len, hash,
+							timeout, entry));
 }
@@ -38,98 +38,158 @@
 
 #define MIN_SIZE 16
 
+/*The table is split in 1 << DR_SHARD_BITS independently locked shards*/
+#define DR_SHARD_BITS  4
+#define DR_SHARDS      (1 << DR_SHARD_BITS)
+
+/*Expected entry size, used to size the hash from a byte limit*/
+#define DR_AVERAGE_ENTRY_SIZE 4096
+
+/*Upper bound on the buckets in a table*/
+#define DR_MAX_BUCKETS (1 << 20)
+
+/*How often the sweeper expires idle entries and frees retired ones*/
+#define DR_SWEEP_INTERVAL 1
+
+class DrHashNode;
 class DrHashList;
+class DrHashTable;
+
+/*Reads
+ *Lookups walk the hash chains and read an entry without taking any lock.
+ *Instead a reader brackets its access with DrHashTable::beginRead and
+ *DrHashTable::endRead, which count it against the shard's current epoch.
+ *Writers serialize on the shard lock, publish new nodes and entries with a
+ *producer barrier, and put unlinked nodes and replaced entries on a retire
+ *list.  Retired memory is freed only after the epoch has moved on and every
+ *reader counted against the old epoch has left.
+ */
+struct DrReadSection
+{
+	DrHashList    *shard;
+	PRUint32       hashVal;
+	PRUint32       epoch;
+};
+
+struct DrRetired
+{
+	Entry         *entry;
+	DrHashNode    *node;
+	DrRetired     *next;
+};
 
 class DrHashNode
 {
 public:
 	~DrHashNode();
-	DrHashNode();
-	DrHashNode(Entry *&entry, const char *newKey, PRUint32 klen);
-	DrHashNode(Entry *&entry, const char *newKey, PRUint32 klen,
-						PRIntervalTime timeout);
-	Entry *replaceEntry(Entry *&entry);
-	Entry *replaceEntry(Entry *&entry, PRIntervalTime timeout);
-	void linkNode(DrHashNode &newNode);
-	void ageLock(void);
-	void ageUnlock(void);
-	Entry *nodeLockRead(void);
-	Entry *nodeLockWrite(void);
-	void nodeUnlock(void);
-	PRBool  isExpired(PRIntervalTime range);
+	DrHashNode(Entry *entry, const char *newKey, PRUint32 klen,
+						PRUint32 hash, PRIntervalTime timeout);
+	Entry *getEntry(void);
 	PRBool  isExpired(void);
+	PRBool  isExpired(PRIntervalTime now);
 private:
-	Entry          *entry;
-	char           *key;
-	DrHashNode     *next;
-	DrHashNode     *prev;
-	PRLock         *exAgeLock;
-	PRRWLock       *rwNodeLock;
-	PRUint32        keyLen;
-	PRIntervalTime lastAge; 
-	PRIntervalTime maxAge; 
+	Entry * volatile         entry;
+	char                    *key;
+	PRUint32                 keyLen;
+	PRUint32                 hashVal;
+	PRUint32                 size;
+	DrHashNode * volatile    next;
+	DrHashNode              *lruPrev;
+	DrHashNode              *lruNext;
+	volatile PRInt32         refreshing;
+	volatile PRInt32         referenced;
+	volatile PRIntervalTime  lastAge; 
+	volatile PRIntervalTime  maxAge; 
 	friend class DrHashList;
 };
 
+/*One shard of a DrHashTable
+ *Each shard has its own lock, hash buckets, byte limit and LRU list.  The
+ *LRU list is approximate: a hit only marks the node referenced, and the
+ *eviction scan gives referenced nodes a second chance.
+ */
 class DrHashList
 {
 public:
 	~DrHashList();
-	DrHashList();
-	DrHashList(CompareFunc_t cmp, RefreshFunc_t ref, FreeFunc_t fre);
-	DrHashNode *getEntry(const char *&key, PRUint32 len,
+	DrHashList(PRUint32 buckets, PRUint64 maxBytes, PRIntervalTime maxAge,
+						CompareFunc_t cmp, RefreshFunc_t ref, FreeFunc_t fre);
+	PRUint32 readLock(void);
+	void readUnlock(PRUint32 epoch);
+	DrHashNode *findEntry(const char *key, PRUint32 len, PRUint32 hash);
+	DrHashNode *getEntry(const char *key, PRUint32 len, PRUint32 hash,
 							Request * rq, Session *sn);
-	DrHashNode *tryGetEntry(const char *&key, PRUint32 len,
+	DrHashNode *tryGetEntry(const char *key, PRUint32 len, PRUint32 hash);
+	DrHashNode *getUnexpiredEntry(const char *key, PRUint32 len,
+							PRUint32 hash, Request * rq, Session *sn);
+	DrHashNode *forceRefresh(const char *key, PRUint32 len, PRUint32 hash,
 							Request * rq, Session *sn);
-	DrHashNode *getUnexpiredEntry(const char *&key, PRUint32 len,
-							PRIntervalTime range, Request * rq, Session *sn);
-	DrHashNode *forceRefresh(const char *&key, PRUint32 len,
-							Request * rq, Session *sn);
-	DrHashNode *refreshEntry(const char *&key, PRUint32 len,
+	DrHashNode *refreshEntry(const char *key, PRUint32 len, PRUint32 hash,
 							PRIntervalTime timeout, Entry *entry);
+	void sweep(PRIntervalTime now);
 	CompareFunc_t  fnCmp;
 	RefreshFunc_t  fnRef;
 	FreeFunc_t     fnFre;
 private:
-	DrHashNode *head;
-	DrHashNode *tail;
-	PRRWLock   *rwListLock;
-	PRUint32   ctr;
-	DrHashNode *putEntry(const char *&key, PRUint32 len,
-							PRBool ifForce, Request * rq, Session *sn);
-	DrHashNode *putEntry(const char *&key, PRUint32 len, PRIntervalTime timeout,
-							Entry *entry);
+	PRLock                *lock;
+	DrHashNode * volatile *buckets;
+	PRUint32               bucketMask;
+	DrHashNode            *lruHead;
+	DrHashNode            *lruTail;
+	PRUint32               ctr;
+	PRUint64               curBytes;
+	PRUint64               maxBytes;
+	PRIntervalTime         maxEntryAge;
+	volatile PRInt32       epoch;
+	volatile PRInt32       readers[2];
+	DrRetired             *retired;
+	DrRetired             *retiredWaiting;
+	DrHashNode *publish(const char *key, PRUint32 len, PRUint32 hash,
+							PRIntervalTime timeout, Entry *entry,
+							PRBool ifReplace);
+	void replaceEntry(DrHashNode *node, Entry *entry,
+							PRIntervalTime timeout);
+	void removeNode(DrHashNode *node);
+	void lruPush(DrHashNode *node);
+	void lruUnlink(DrHashNode *node);
+	void evict(void);
+	void retire(Entry *entry, DrHashNode *node);
+	DrRetired *reclaim(void);
+	void freeRetired(DrRetired *list);
+	static PRUint32 entrySize(const Entry *entry, PRUint32 klen);
 };
 
 class DrHashTable
 {
 public:
 	~DrHashTable();
-	DrHashTable();
-	DrHashTable(PRUint32 maxEntries, PRIntervalTime maxAge, CompareFunc_t cmp,
-							RefreshFunc_t ref, FreeFunc_t fre);
-	DrHashNode *getEntry(const char *&key, PRUint32 len,
-							Request * rq, Session *sn);
-	DrHashNode *tryGetEntry(const char *&key, PRUint32 len,
-							Request * rq, Session *sn);
-	DrHashNode *getUnexpiredEntry(const char *&key, PRUint32 len,
+	DrHashTable(PRUint32 maxEntries, PRUint64 maxBytes, PRIntervalTime maxAge,
+							CompareFunc_t cmp, RefreshFunc_t ref, FreeFunc_t fre);
+	void beginRead(const char *key, PRUint32 len, DrReadSection &rs);
+	void endRead(DrReadSection &rs);
+	DrHashNode *getEntry(DrReadSection &rs, const char *key, PRUint32 len,
 							Request * rq, Session *sn);
-	DrHashNode *forceRefresh(const char *&key, PRUint32 len,
+	DrHashNode *tryGetEntry(DrReadSection &rs, const char *key, PRUint32 len);
+	DrHashNode *getUnexpiredEntry(DrReadSection &rs, const char *key,
+							PRUint32 len, Request * rq, Session *sn);
+	DrHashNode *forceRefresh(DrReadSection &rs, const char *key, PRUint32 len,
 							Request * rq, Session *sn);
-	DrHashNode *putEntry(const char *&key, PRUint32 len, PRIntervalTime timeout,
+	DrHashNode *putEntry(const char *key, PRUint32 len, PRIntervalTime timeout,
 							Entry *entry);
 	CompareFunc_t  fnCmp;
 	RefreshFunc_t  fnRef;
 	FreeFunc_t     fnFre;
 protected:
-	DrHashList     **hashTable;
-	PRUint32       hashSize;
-	PRUint32       hashMask;
+	DrHashList     *shards[DR_SHARDS];
 	PRIntervalTime maxEntryAge;
 private:
-	PRRWLock       *rwTableLock;
-	PRUint32       hashIt(const char *&key, PRUint32 len);
-	DrHashNode     *putEntry(const char *&key, PRUint32 len,
-							PRBool ifForce, Request * rq, Session *sn);
+	PRLock         *sweepLock;
+	PRCondVar      *sweepCv;
+	PRThread       *sweeper;
+	volatile PRInt32 sweeperStarted;
+	PRBool         sweepStop;
+	PRUint32       hashIt(const char *key, PRUint32 len);
+	void           startSweeper(void);
+	static void    sweeperMain(void *arg);
 };
 #endif
@@ -55,7 +55,18 @@ NSAPI_PUBLIC PRInt32 dr_cache_init(DrHdl *hdl, RefreshFunc_t ref,
 	PRUint32 maxEntries, PRIntervalTime maxAge)
 {
 	*hdl = NULL;
-	DrHashTable *obj = new DrHashTable(maxEntries, maxAge, cmp, ref, fre);
+/*maxEntries only sizes the hash; the cache has no byte limit*/
+	DrHashTable *obj = new DrHashTable(maxEntries, 0, maxAge, cmp, ref, fre);
+	*hdl = (DrHdl)obj;
+	return((*hdl == (DrHdl)NULL) ? 0 : 1);
+}
+
+NSAPI_PUBLIC PRInt32 dr_cache_init_size(DrHdl *hdl, RefreshFunc_t ref,
+	FreeFunc_t fre, CompareFunc_t cmp,
+	PRUint64 maxBytes, PRIntervalTime maxAge)
+{
+	*hdl = NULL;
+	DrHashTable *obj = new DrHashTable(0, maxBytes, maxAge, cmp, ref, fre);
 	*hdl = (DrHdl)obj;
 	return((*hdl == (DrHdl)NULL) ? 0 : 1);
 }
@@ -74,8 +85,9 @@ NSAPI_PUBLIC PRInt32 dr_net_write(DrHdl hdl, const char *key, PRUint32 klen,
 	PRIntervalTime timeout, PRUint32 flags, Request *rq, Session *sn)
 {
 	NSAPIIOVec   iov[3];
-	DrHashTable *obj;
+	DrHashTable *obj  = 0;
 	DrHashNode  *node = 0;
+	DrReadSection rs;
 	PRInt32 iovLen    = 0;
 	PRInt32 cLen      = hlen + flen;
 
@@ -100,45 +112,51 @@ NSAPI_PUBLIC PRInt32 dr_net_write(DrHdl hdl, const char *key, PRUint32 klen,
 	{
 		obj = (DrHashTable *)hdl;	
 
+/*Whatever entry we find stays valid until endRead, even if it is replaced*/
+		obj->beginRead(key, klen, rs);
+
 		if(flags & DR_FORCE)
 		{
-			node = obj->forceRefresh(key, klen, rq, sn);
+			node = obj->forceRefresh(rs, key, klen, rq, sn);
 		}
 		else
 		if(flags & DR_CHECK)
 		{
 /*The Caller does not want the Refresh To be called - if entry expired*/
 /*The Caller does not want the Refresh To be called - if entry not present*/
-			if(!(node = obj->tryGetEntry(key, klen, rq, sn)))
+			if(!(node = obj->tryGetEntry(rs, key, klen)))
 			{
+				obj->endRead(rs);
 				return(DR_EXPIR);
 			}
 		}
 		else
 		if(flags & DR_IGNORE)
 		{
-			node = obj->getEntry(key, klen, rq, sn);
+			node = obj->getEntry(rs, key, klen, rq, sn);
 		}
 		else
 		{
-			node = obj->getUnexpiredEntry(key, klen, rq, sn);
+			node = obj->getUnexpiredEntry(rs, key, klen, rq, sn);
 		}
 		if(!node)
 		{
 			const char *errmsg = "error code unavailable";
 			log_error(LOG_WARN, "dr-net-write", sn, rq, "cache get error %s "
 			"(%s)", pszUri, errmsg);
+
+			obj->endRead(rs);
+
 			return(DR_ERROR);
 		}
-/*We Need to lock the Node, otherwise someone may steal our Entry*/
-		Entry *theEntry = node->nodeLockRead();
+		Entry *theEntry = node->getEntry();
 		if(!theEntry)
 		{
 			const char *errmsg = "error code unavailable";
 			log_error(LOG_WARN, "dr-net-write", sn, rq, "cache entry null %s "
 			"(%s)", pszUri, errmsg);
 
-			node->nodeUnlock();
+			obj->endRead(rs);
 
 			return(DR_ERROR);
 		}
@@ -162,10 +180,10 @@ NSAPI_PUBLIC PRInt32 dr_net_write(DrHdl hdl, const char *key, PRUint32 klen,
 		protocol_start_response(sn, rq);
 	}
 	PRInt32 ret = net_writev(sn->csd, iov, iovLen);
-/*If we have got the data from cache we need to unlock the node*/
+/*If we have got the data from cache we need to leave the read section*/
 	if(node)
 	{
-		node->nodeUnlock();
+		obj->endRead(rs);
 	}
 	return(ret);
 }
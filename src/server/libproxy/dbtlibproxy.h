@@ -237,6 +237,8 @@ Use the search function of your browser to enter search terms.\n<ISINDEX>")
     ResDef(DBT_hostDnsCache_init_errorCreatingDnsCache, 856, "CORE7856: Error creating dns cache")
     ResDef(DBT_hostDnsCache_insert_errorAllocatingEnt, 857, "CORE7857: Error allocating entry")
     ResDef(DBT_hostDnsCache_insert_mallocFailure, 858, "CORE7858: malloc failure")
+    ResDef(DBT_hostDnsCache_init_refreshTime_lt_zero, 859, "CORE7859: refresh < 0, using %d")
+    ResDef(DBT_hostDnsCache_refresh_errorCreatingThread, 860, "CORE7860: Error creating dns cache refresh thread")
 
 /* common client errors */    /*reserv 900 - 925 */
     ResDef(DBT_common_unable_to_contact, 901, "unable to contact %s:%d (%s)")
@@ -42,9 +42,11 @@
 #include "base/cache.h"
 #include "base/util.h"
 #include "base/pool.h"
+#include "base/daemon.h"
 #include "frame/log.h"
 #include "libproxy/host_dns_cache.h"
 #include "libproxy/util.h"
+#include "ares/arapi.h"
 
 #include "libproxy/dbtlibproxy.h"
 
@@ -57,8 +59,39 @@
 #define ABSOLUTE_CACHE_MAX         32768    /* disallow larger sizes */
 #define DEFAULT_HASH_SIZE          (2*DEFAULT_CACHE_MAX)
 
+#define DEFAULT_REFRESH_TIME   30   /* refresh popular entries 30s early */
+#define REFRESH_MIN_HITS       2    /* lookups before an entry is popular */
+
+#define LOOKUP_HASH_SIZE       64   /* buckets for in-flight lookups */
+
 #define DNS_CACHE_INIT         "dns-cache-init"
 #define DNS_CACHE_INSERT       "dns-cache-insert"
+#define DNS_CACHE_REFRESH      "dns-cache-refresh"
+
+/* ----- Types -------------------------------------------------------- */
+
+/* dns_lookup_t
+ * A DNS query in progress.  Threads that miss the cache for the same name
+ * while the query is in progress wait for its answer instead of issuing
+ * their own query.
+ */
+typedef struct dns_lookup_t {
+    char                *name;      /* name being resolved */
+    PRCondVar           *cvar;      /* notified when the query completes */
+    PRHostEnt           *hostent;   /* answer, NULL on failure */
+    PRBool              done;       /* PR_TRUE once the query completes */
+    int                 refcount;   /* resolving thread plus waiters */
+    struct dns_lookup_t *next;
+} dns_lookup_t;
+
+/* dns_refresh_t
+ * A popular cache entry that should be resolved again before it expires.
+ */
+typedef struct dns_refresh_t {
+    char                 *host;
+    char                 *name;     /* name to send to DNS if not host */
+    struct dns_refresh_t *next;
+} dns_refresh_t;
 
 /* ----- Forwards ----------------------------------------------------- */
 static unsigned int dns_cache_hash_host_name(unsigned int, void *);
@@ -66,11 +99,25 @@ static int dns_cache_compare_keys(void *, void *);
 static int dns_cache_cleanup(void *);
 static int dns_cache_debug(pblock *pb, Session *sn, Request *rq);
 static int dns_cache_print(void *data, SYS_NETFD fd);
+static host_dns_cache_entry_t *dns_cache_insert(const char *, const char *, PRHostEnt *, unsigned int, PRUint32);
+static void dns_cache_check_refresh(host_dns_cache_entry_t *entry);
+static void dns_cache_terminate(void *);
 
 /* ----- Static globals ----------------------------------------------- */
 static cache_t          *dns_cache = NULL;
 static unsigned long    dns_expire_time = DEFAULT_EXPIRE_TIME;
 static PRBool           negative_dns_cache = PR_TRUE;
+static unsigned long    dns_refresh_time = DEFAULT_REFRESH_TIME;
+
+/* dns_lookup_lock protects the in-flight lookups and the refresh queue */
+static PRCallOnceType   dns_lookup_once;
+static PRLock           *dns_lookup_lock = NULL;
+static dns_lookup_t     *dns_lookup_table[LOOKUP_HASH_SIZE];
+static PRCondVar        *dns_refresh_cvar = NULL;
+static dns_refresh_t    *dns_refresh_queue = NULL;
+static PRThread         *dns_refresh_thread = NULL;
+static PRBool           dns_refresh_shutdown = PR_FALSE;
+static PRBool           dns_async_resolver = PR_FALSE;
 
 static public_cache_functions_t dns_cache_functions = {
     dns_cache_hash_host_name,
@@ -96,6 +143,38 @@ NSAPI_PUBLIC PRStatus host_dns_cache_hostent_init(void)
     return PR_SUCCESS;
 }
 
+/*
+ * Duplicates a hostent's address list.  The addresses are h_length bytes
+ * of binary data, not strings, so util_strlist_dup can't copy them.
+ */
+static char **addr_list_dup(char **addr_list, int length, pool_handle_t *pool)
+{
+    char **newlist;
+    int naddrs = 0;
+
+    if (!addr_list)
+        return NULL;
+
+    while (addr_list[naddrs])
+        naddrs++;
+
+    if (pool)
+        newlist = (char **) pool_malloc(pool, sizeof(char *)*(naddrs + 1));
+    else
+        newlist = (char **) PERM_MALLOC(sizeof(char *)*(naddrs + 1));
+
+    for (int i = 0; i < naddrs; i++) {
+        if (pool)
+            newlist[i] = (char *) pool_malloc(pool, length);
+        else
+            newlist[i] = (char *) PERM_MALLOC(length);
+        memcpy(newlist[i], addr_list[i], length);
+    }
+    newlist[naddrs] = NULL;
+
+    return newlist;
+}
+
 /*
  * Used to duplicate a PRHostEnt structure stored in the dns cache
  * onto a sessions memory pool.
@@ -126,11 +205,11 @@ static PRHostEnt *hostent_dup(PRHostEnt *hostent, pool_handle_t *pool = NULL)
     // copy aliases and addresses
     if (pool) {
         newent->h_aliases = util_strlist_pool_dup(hostent->h_aliases, pool);
-        newent->h_addr_list = util_strlist_pool_dup(hostent->h_addr_list, pool);
     } else {
         newent->h_aliases = util_strlist_dup(hostent->h_aliases);
-        newent->h_addr_list = util_strlist_dup(hostent->h_addr_list);
     }
+    newent->h_addr_list = addr_list_dup(hostent->h_addr_list,
+                                        hostent->h_length, pool);
 
     return newent;
 }
@@ -181,6 +260,9 @@ dns_cache_cleanup(void *voiddata)
     if (data->host)
         PERM_FREE(data->host);
 
+    if (data->name)
+        PERM_FREE(data->name);
+
     if (data->hostent)
         hostent_free(data->hostent);
 
@@ -220,6 +302,24 @@ dns_cache_print(void *voiddata, SYS_NETFD fd)
     return 0;
 }
 
+static PRStatus
+dns_lookup_init(void)
+{
+    dns_lookup_lock = PR_NewLock();
+    if (!dns_lookup_lock)
+        return PR_FAILURE;
+
+    dns_refresh_cvar = PR_NewCondVar(dns_lookup_lock);
+    if (!dns_refresh_cvar)
+        return PR_FAILURE;
+
+    asyncDNSInfo info;
+    GetAsyncDNSInfo(&info);
+    dns_async_resolver = info.enabled;
+
+    return PR_SUCCESS;
+}
+
 NSAPI_PUBLIC int
 host_dns_cache_init(pblock *pb, Session *sn, Request *rq)
 {
@@ -228,6 +328,7 @@ host_dns_cache_init(pblock *pb, Session *sn, Request *rq)
     char *str_expire_time = pblock_findval("expire", pb);
     char *str_disable = pblock_findval("disable", pb);
     char *str_negative_dns_cache = pblock_findval("negative-dns-cache", pb);
+    char *str_refresh_time = pblock_findval("refresh", pb);
     int hash_size;
     int cache_size;
 
@@ -283,6 +384,17 @@ host_dns_cache_init(pblock *pb, Session *sn, Request *rq)
             }
         }
 
+    if (str_refresh_time) {
+        int refresh_time = atoi(str_refresh_time);
+        if (refresh_time < 0) {
+            log_error(LOG_WARN, DNS_CACHE_INIT, sn, rq,
+                      XP_GetAdminStr(DBT_hostDnsCache_init_refreshTime_lt_zero),
+                      DEFAULT_REFRESH_TIME);
+            refresh_time = DEFAULT_REFRESH_TIME;
+        }
+        dns_refresh_time = refresh_time;
+    }
+
     if (str_negative_dns_cache) {
         int ret = util_getboolean(str_negative_dns_cache, -1);
         if ( ret == -1 ) {
@@ -300,6 +412,9 @@ host_dns_cache_init(pblock *pb, Session *sn, Request *rq)
         return REQ_ABORTED;
     }
 
+    /* Stop the refresh thread when the server shuts down */
+    daemon_atrestart(dns_cache_terminate, NULL);
+
     return REQ_PROCEED;
 }
 
@@ -313,14 +428,40 @@ host_dns_cache_destroy(cache_t *cache)
 
 NSAPI_PUBLIC host_dns_cache_entry_t *
 host_dns_cache_insert(const char *host, PRHostEnt *hostent, unsigned int verified)
+{
+    return host_dns_cache_insert_ttl(host, hostent, verified, PR_AR_TTL_UNKNOWN);
+}
+
+NSAPI_PUBLIC host_dns_cache_entry_t *
+host_dns_cache_insert_ttl(const char *host, PRHostEnt *hostent, unsigned int verified, PRUint32 ttl)
+{
+    return dns_cache_insert(host, NULL, hostent, verified, ttl);
+}
+
+/*
+ * Caches hostent under host like host_dns_cache_insert_ttl().  name is the
+ * name that was sent to DNS, if it differs from host, so that a background
+ * refresh can send the same query.
+ */
+static host_dns_cache_entry_t *
+dns_cache_insert(const char *host, const char *name, PRHostEnt *hostent, unsigned int verified, PRUint32 ttl)
 {
     host_dns_cache_entry_t *newentry;
+    unsigned long lifetime;
 
-    if ( !dns_cache || !hostent)  {
+    /* A NULL hostent records a failed lookup in the negative cache */
+    if ( !dns_cache || (!hostent && !negative_dns_cache))  {
         return NULL;
     }
 
-    if ( (newentry = (host_dns_cache_entry_t *)PERM_MALLOC(sizeof(host_dns_cache_entry_t))) == NULL) {
+    /* The DNS server's TTL wins if it's shorter than our expire time */
+    lifetime = dns_expire_time;
+    if (ttl != PR_AR_TTL_UNKNOWN && ttl < lifetime)
+        lifetime = ttl;
+    if (lifetime == 0)
+        return NULL;
+
+    if ( (newentry = (host_dns_cache_entry_t *)PERM_CALLOC(sizeof(host_dns_cache_entry_t))) == NULL) {
         log_error(LOG_FAILURE, DNS_CACHE_INSERT, NULL, NULL,
                   XP_GetAdminStr(DBT_hostDnsCache_insert_errorAllocatingEnt));
         goto error;
@@ -335,16 +476,27 @@ host_dns_cache_insert(const char *host, PRHostEnt *hostent, unsigned int verifie
     } else
         newentry->host = NULL;
 
+    if (name && host && strcmp(name, host)) {
+        if ( (newentry->name = PERM_STRDUP(name)) == NULL) {
+            log_error(LOG_FAILURE, DNS_CACHE_INSERT, NULL, NULL,
+                      XP_GetAdminStr(DBT_hostDnsCache_insert_mallocFailure));
+            goto error;
+        }
+    }
+
 #ifdef CACHE_DEBUG
     newentry->cache.magic = CACHE_ENTRY_MAGIC;
 #endif
 
     /* create and copy the host entry */
-    newentry->hostent = hostent_dup(hostent);
+    newentry->hostent = hostent ? hostent_dup(hostent) : NULL;
 
     newentry->verified = verified;
 
     newentry->last_access = time(NULL);
+    newentry->expires = newentry->last_access + lifetime;
+    newentry->hits = 0;
+    newentry->refreshing = 0;
 
     if ( cache_insert_p(dns_cache, &(newentry->cache), (void *)(newentry->host), 
         (void *)newentry, &dns_cache_entry_functions) < 0) {
@@ -363,6 +515,8 @@ error:
     if (newentry) {
         if (newentry->host)
             PERM_FREE(newentry->host);
+        if (newentry->name)
+            PERM_FREE(newentry->name);
         if (newentry->hostent)
             hostent_free(newentry->hostent);
         PERM_FREE(newentry);
@@ -417,6 +571,8 @@ host_dns_cache_lookup_host_name(const char *name)
         }
 
         (void)host_dns_cache_touch(ptr);
+
+        dns_cache_check_refresh(ptr);
     }
 
     return ptr;
@@ -429,7 +585,7 @@ host_dns_cache_valid(host_dns_cache_entry_t *entry)
 
     now = time(NULL);
 
-    if (now > (time_t)(entry->last_access + dns_expire_time))
+    if (now > entry->expires)
         return -1;
 
     return cache_valid(dns_cache, (cache_entry_t *)entry);
@@ -451,7 +607,9 @@ host_dns_cache_lookup(const char *host, Session *sn, Request *rq)
 
     cache_entry = host_dns_cache_lookup_host_name(host);
     if (cache_entry) {
-        PRHostEnt *p = hostent_dup(cache_entry->hostent, sn->pool);
+        PRHostEnt *p = NULL;
+        if (cache_entry->hostent)
+            p = hostent_dup(cache_entry->hostent, sn->pool);
         /*
          * once we have the cached item duplicated, bring down its
          * access count. 
@@ -463,6 +621,340 @@ host_dns_cache_lookup(const char *host, Session *sn, Request *rq)
     return NULL;
 }
 
+/*
+ * Issues a DNS query for name.  Returns a PERM_MALLOC'd PRHostEnt and the
+ * smallest TTL of the answer records, or NULL on failure.
+ */
+static PRHostEnt *dns_cache_query(const char *name, PRUint32 *ttl)
+{
+    char buf[PR_AR_MAXHOSTENTBUF];
+    PRHostEnt hostent;
+
+    if (PR_AR_GetHostByNameTTL(name, buf, sizeof(buf), &hostent,
+                               PR_AR_DEFAULT_TIMEOUT, PR_AF_INET,
+                               ttl) != PR_SUCCESS)
+    {
+        /*
+         * The asynchronous resolver only asks DNS, so give the system
+         * resolver a chance to find the name in /etc/hosts, NIS, etc.
+         */
+        if (!dns_async_resolver)
+            return NULL;
+        if (PR_GetHostByName(name, buf, sizeof(buf), &hostent) != PR_SUCCESS)
+            return NULL;
+        *ttl = PR_AR_TTL_UNKNOWN;
+    }
+
+    return hostent_dup(&hostent);
+}
+
+/*
+ * Resolves name, joining a query already in progress for the same name if
+ * there is one.  The answer is cached under host, as is a failure if the
+ * negative DNS cache is enabled and pool is non-NULL; a failed background
+ * refresh (pool is NULL) leaves the existing entry to expire.  Returns a
+ * copy of the answer allocated from pool, or NULL on failure or if pool is
+ * NULL.
+ */
+static PRHostEnt *dns_cache_coalesced_query(const char *host, const char *name, pool_handle_t *pool)
+{
+    unsigned int bucket = dns_cache_hash_host_name(LOOKUP_HASH_SIZE, (void *)name);
+    dns_lookup_t *lookup;
+    dns_lookup_t **pp;
+    PRHostEnt *rv = NULL;
+
+    PR_Lock(dns_lookup_lock);
+
+    for (lookup = dns_lookup_table[bucket]; lookup; lookup = lookup->next) {
+        if (!strcmp(lookup->name, name))
+            break;
+    }
+
+    if (lookup) {
+        /* Another thread is already resolving name, so wait for it */
+        lookup->refcount++;
+        while (!lookup->done)
+            PR_WaitCondVar(lookup->cvar, PR_INTERVAL_NO_TIMEOUT);
+    } else {
+        lookup = (dns_lookup_t *)PERM_CALLOC(sizeof(dns_lookup_t));
+        if (lookup) {
+            lookup->name = PERM_STRDUP(name);
+            lookup->cvar = PR_NewCondVar(dns_lookup_lock);
+        }
+        if (!lookup || !lookup->name || !lookup->cvar) {
+            if (lookup) {
+                if (lookup->name)
+                    PERM_FREE(lookup->name);
+                PERM_FREE(lookup);
+            }
+            PR_Unlock(dns_lookup_lock);
+
+            /* Can't share the query, but can still make one */
+            PRUint32 ttl;
+            PRHostEnt *hostent = dns_cache_query(name, &ttl);
+            if (hostent || pool)
+                dns_cache_insert(host, name, hostent, 0, ttl);
+            if (hostent) {
+                if (pool)
+                    rv = hostent_dup(hostent, pool);
+                hostent_free(hostent);
+            }
+            return rv;
+        }
+
+        lookup->refcount = 1;
+        lookup->next = dns_lookup_table[bucket];
+        dns_lookup_table[bucket] = lookup;
+
+        PR_Unlock(dns_lookup_lock);
+
+        PRUint32 ttl;
+        PRHostEnt *hostent = dns_cache_query(name, &ttl);
+        if (hostent || pool)
+            dns_cache_insert(host, name, hostent, 0, ttl);
+
+        PR_Lock(dns_lookup_lock);
+
+        /*
+         * The answer is in the cache now (if it could be cached), so later
+         * lookups needn't wait on this query
+         */
+        for (pp = &dns_lookup_table[bucket]; *pp != lookup; pp = &(*pp)->next);
+        *pp = lookup->next;
+
+        lookup->hostent = hostent;
+        lookup->done = PR_TRUE;
+        PR_NotifyAllCondVar(lookup->cvar);
+    }
+
+    if (lookup->hostent && pool)
+        rv = hostent_dup(lookup->hostent, pool);
+
+    if (--lookup->refcount == 0) {
+        if (lookup->hostent)
+            hostent_free(lookup->hostent);
+        PR_DestroyCondVar(lookup->cvar);
+        PERM_FREE(lookup->name);
+        PERM_FREE(lookup);
+    }
+
+    PR_Unlock(dns_lookup_lock);
+
+    return rv;
+}
+
+static void dns_refresh_free(dns_refresh_t *refresh)
+{
+    PERM_FREE(refresh->host);
+    if (refresh->name)
+        PERM_FREE(refresh->name);
+    PERM_FREE(refresh);
+}
+
+/*
+ * Resolves the hosts on the refresh queue so that popular entries are
+ * replaced before they expire.  Runs until dns_cache_terminate() is called.
+ */
+static void dns_cache_refresh_thread(void *arg)
+{
+    PR_Lock(dns_lookup_lock);
+
+    for (;;) {
+        while (!dns_refresh_queue && !dns_refresh_shutdown)
+            PR_WaitCondVar(dns_refresh_cvar, PR_INTERVAL_NO_TIMEOUT);
+
+        if (dns_refresh_shutdown)
+            break;
+
+        dns_refresh_t *refresh = dns_refresh_queue;
+        dns_refresh_queue = refresh->next;
+
+        PR_Unlock(dns_lookup_lock);
+
+        /* Send the same query as the lookup that cached the entry */
+        dns_cache_coalesced_query(refresh->host,
+                                  refresh->name ? refresh->name : refresh->host,
+                                  NULL);
+        dns_refresh_free(refresh);
+
+        PR_Lock(dns_lookup_lock);
+    }
+
+    PR_Unlock(dns_lookup_lock);
+}
+
+/*
+ * Stops the refresh thread, waiting for a refresh in progress to finish,
+ * and discards the refreshes that are still queued.
+ */
+static void dns_cache_terminate(void *unused)
+{
+    if (!dns_lookup_lock)
+        return;
+
+    PR_Lock(dns_lookup_lock);
+    dns_refresh_shutdown = PR_TRUE;
+    PRThread *thread = dns_refresh_thread;
+    dns_refresh_thread = NULL;
+    PR_NotifyAllCondVar(dns_refresh_cvar);
+    PR_Unlock(dns_lookup_lock);
+
+    if (thread)
+        PR_JoinThread(thread);
+
+    PR_Lock(dns_lookup_lock);
+    while (dns_refresh_queue) {
+        dns_refresh_t *refresh = dns_refresh_queue;
+        dns_refresh_queue = refresh->next;
+        dns_refresh_free(refresh);
+    }
+    PR_Unlock(dns_lookup_lock);
+}
+
+/*
+ * Schedules a background refresh of an entry that is popular and close to
+ * expiring.  The caller MUST have already incremented the use count for
+ * this entry.
+ */
+static void dns_cache_check_refresh(host_dns_cache_entry_t *entry)
+{
+    if (!dns_refresh_time || !entry->host || !entry->hostent)
+        return;
+
+    if (PR_AtomicIncrement(&entry->hits) < REFRESH_MIN_HITS)
+        return;
+
+    /* Refresh within dns_refresh_time or half the lifetime of expiring */
+    time_t window = dns_refresh_time;
+    if (window > (entry->expires - entry->last_access) / 2)
+        window = (entry->expires - entry->last_access) / 2;
+    if (time(NULL) + window < entry->expires)
+        return;
+
+    /* Only schedule one refresh per entry */
+    if (PR_AtomicSet(&entry->refreshing, 1))
+        return;
+
+    if (PR_CallOnce(&dns_lookup_once, dns_lookup_init) != PR_SUCCESS)
+        return;
+
+    dns_refresh_t *refresh = (dns_refresh_t *)PERM_CALLOC(sizeof(dns_refresh_t));
+    if (!refresh)
+        return;
+    refresh->host = PERM_STRDUP(entry->host);
+    if (entry->name)
+        refresh->name = PERM_STRDUP(entry->name);
+    if (!refresh->host || (entry->name && !refresh->name)) {
+        if (refresh->host)
+            PERM_FREE(refresh->host);
+        PERM_FREE(refresh);
+        return;
+    }
+
+    PR_Lock(dns_lookup_lock);
+
+    if (dns_refresh_shutdown) {
+        PR_Unlock(dns_lookup_lock);
+        dns_refresh_free(refresh);
+        return;
+    }
+
+    /* Start the refresh thread on first use, i.e. after any fork */
+    if (!dns_refresh_thread) {
+        dns_refresh_thread = PR_CreateThread(PR_SYSTEM_THREAD,
+                                             dns_cache_refresh_thread,
+                                             NULL,
+                                             PR_PRIORITY_NORMAL,
+                                             PR_GLOBAL_THREAD,
+                                             PR_JOINABLE_THREAD,
+                                             0);
+        if (!dns_refresh_thread) {
+            PR_Unlock(dns_lookup_lock);
+            log_error(LOG_FAILURE, DNS_CACHE_REFRESH, NULL, NULL,
+                      XP_GetAdminStr(DBT_hostDnsCache_refresh_errorCreatingThread));
+            dns_refresh_free(refresh);
+            return;
+        }
+    }
+
+    refresh->next = dns_refresh_queue;
+    dns_refresh_queue = refresh;
+    PR_NotifyCondVar(dns_refresh_cvar);
+
+    PR_Unlock(dns_lookup_lock);
+}
+
+NSAPI_PUBLIC PRHostEnt *
+host_dns_cache_resolve(const char *host, Session *sn, Request *rq)
+{
+    host_dns_cache_entry_t *cache_entry;
+    const char *name = host;
+    PRNetAddr addr;
+    char *tmp;
+    int dots;
+
+    if (!host || !*host)
+        return NULL;
+
+    /* IP address literals don't need DNS or the cache */
+    if (PR_StringToNetAddr(host, &addr) == PR_SUCCESS) {
+        PRHostEnt *he = (PRHostEnt *)pool_malloc(sn->pool, sizeof(PRHostEnt));
+        char *hostbuf = (char *)pool_malloc(sn->pool, PR_NETDB_BUF_SIZE);
+        if (!he || !hostbuf)
+            return NULL;
+        if (PR_GetHostByName(host, hostbuf, PR_NETDB_BUF_SIZE, he) != PR_SUCCESS)
+            return NULL;
+        return he;
+    }
+
+    if (PR_CallOnce(&dns_lookup_once, dns_lookup_init) != PR_SUCCESS)
+        return NULL;
+
+    /*
+     * Another thread may have cached the answer since the caller's lookup,
+     * or the name may be in the negative cache
+     */
+    cache_entry = host_dns_cache_lookup_host_name(host);
+    if (cache_entry) {
+        PRHostEnt *p = NULL;
+        if (cache_entry->hostent)
+            p = hostent_dup(cache_entry->hostent, sn->pool);
+        host_dns_cache_use_decrement(cache_entry);
+        return p;
+    }
+
+    log_error(LOG_VERBOSE, NULL, sn, rq, "attempting to resolve %s", host);
+
+    /*
+     * Names with more than local-domain-levels dots are fully qualified, so
+     * append a trailing dot to keep the resolver from searching the local
+     * domains
+     */
+    if (rq && rq->vars && (tmp = pblock_findval("local-domain-levels", rq->vars)) &&
+        (dots = atoi(tmp)) >= 0)
+    {
+        int cnt = 0;
+        int len = strlen(host);
+
+        for (const char *p = host; *p; p++) {
+            if (*p == '.')
+                cnt++;
+        }
+
+        if (cnt > dots && host[len - 1] != '.') {
+            char *dothost = (char *)pool_malloc(sn->pool, len + 2);
+            if (dothost) {
+                memcpy(dothost, host, len);
+                dothost[len] = '.';
+                dothost[len + 1] = '\0';
+                name = dothost;
+            }
+        }
+    }
+
+    return dns_cache_coalesced_query(host, name, sn->pool);
+}
+
 NSAPI_PUBLIC PRBool host_dns_cache_is_negative_dns_cache_enabled()
 {
     return negative_dns_cache;
@@ -56,9 +56,13 @@
 typedef struct host_dns_cache_entry_t {
     cache_entry_t   cache;       /* we are a subclass of cache */
     char            *host;
+    char            *name;       /* name sent to DNS if not host, or NULL */
     PRHostEnt       *hostent;
     unsigned int    verified;    /* 0 if not reverse dns done, 1 otherwise */
     time_t          last_access; /* time this entry was cached */
+    time_t          expires;     /* time this entry's DNS records expire */
+    PRInt32         hits;        /* number of lookups that found this entry */
+    PRInt32         refreshing;  /* 1 once a refresh has been scheduled */
 } host_dns_cache_entry_t;
 
 NSPR_BEGIN_EXTERN_C
@@ -86,6 +90,15 @@ NSAPI_PUBLIC void host_dns_cache_destroy(cache_t *);
  */
 NSAPI_PUBLIC host_dns_cache_entry_t *host_dns_cache_insert(const char *host, PRHostEnt *hostent, unsigned int verified);
 
+/* host_dns_cache_insert_ttl()
+ * Like host_dns_cache_insert(), but the entry expires after ttl seconds
+ * (the record's DNS time to live) if that is sooner than the cache-wide
+ * expire time.  ttl may be PR_AR_TTL_UNKNOWN.  Records with a TTL of 0 are
+ * not cached.
+ * Returns non-NULL on success, NULL on failure.
+ */
+NSAPI_PUBLIC host_dns_cache_entry_t *host_dns_cache_insert_ttl(const char *host, PRHostEnt *hostent, unsigned int verified, PRUint32 ttl);
+
 /* host_dns_cache_delete()
  * Attempts to manually delete an entry from the cache.  Normally, the 
  * cache is capable of maintaining itself.  This routine should only be
@@ -124,7 +137,8 @@ NSAPI_PUBLIC host_dns_cache_entry_t *host_dns_cache_lookup_host_name(const char
 
 /* host_dns_cache_valid()
  * Chacks to see if an entry in the cache is valid.  To do so, it checks
- * That the entry has not been in the cache for more than <expire> seconds.  
+ * That the entry has not been in the cache for longer than its DNS TTL or
+ * more than <expire> seconds.  
  * The caller MUST have already incremented the use count for this entry 
  * before calling this routine.
  * 
@@ -143,6 +157,17 @@ NSAPI_PUBLIC int host_dns_cache_touch(host_dns_cache_entry_t *entry);
 
 NSAPI_PUBLIC PRHostEnt *host_dns_cache_lookup(const char *host, Session *sn, Request *rq);
 
+/* host_dns_cache_resolve()
+ * Resolves a host name that wasn't found in the cache.  Concurrent calls
+ * for the same name share a single DNS query, and the answer is cached for
+ * the lifetime of its DNS records.  Names DNS doesn't know are looked up
+ * with the system resolver, failures are cached if negative-dns-cache is
+ * enabled, and IP address literals are converted without a lookup.
+ *
+ * Returns a PRHostEnt allocated from sn's pool, or NULL on failure.
+ */
+NSAPI_PUBLIC PRHostEnt *host_dns_cache_resolve(const char *host, Session *sn, Request *rq);
+
 NSAPI_PUBLIC PRBool host_dns_cache_is_negative_dns_cache_enabled();
 
 /*
@@ -382,20 +382,62 @@ out:
     return ep;
 }
 
+/*
+ * Copy the literal characters a compiled expression starts with to lit and
+ * return how many there are.  A character followed by * or \{ \} is not
+ * literal.
+ */
+static int getlit(char *ep, char *lit, int size)
+{
+    int n = 0;
+
+    while (*ep == CCHR && n < size - 1) {
+        lit[n++] = ep[1];
+        ep += 2;
+    }
+    lit[n] = '\0';
+
+    return (n);
+}
+
 int sed_step(char *p1, char *p2, int circf, step_vars_storage *vars)
 {
     int c;
+    char lit[LITSIZE];
+    int litlen;
 
 
     if (circf) {
         vars->loc1 = p1;
         return (_advance(p1, p2, vars));
     }
-    /* fast check for first character */
+    /*
+     * fast check for a literal prefix: strchr and strstr are vectorized in
+     * most C libraries, so only the places the prefix occurs are tried
+     */
     if (*p2 == CCHR) {
-        c = p2[1];
+        litlen = getlit(p2, lit, sizeof(lit));
+        while ((p1 = (litlen == 1) ? strchr(p1, lit[0]) : strstr(p1, lit))) {
+            /* the expression is nothing but the literal */
+            if (p2[2 * litlen] == CCEOF) {
+                vars->loc1 = p1;
+                vars->loc2 = p1 + litlen;
+                return (1);
+            }
+            if (_advance(p1, p2, vars)) {
+                vars->loc1 = p1;
+                return (1);
+            }
+            p1++;
+        }
+        return (0);
+    }
+    /* fast check for a character class */
+    if (*p2 == CCL) {
+        char *ep = p2 + 1;
         do {
-            if (*p1 != c)
+            c = *p1;
+            if ((c & 0200) || !ISTHERE(c))
                 continue;
             if (_advance(p1, p2, vars)) {
                 vars->loc1 = p1;
@@ -84,6 +84,8 @@ extern "C" {
 
 #define    NBRA    9
 
+#define    LITSIZE    64    /* longest literal prefix searched for */
+
 #define    PLACE(c)    ep[c >> 3] |= bittab[c & 07]
 #define    ISTHERE(c)    (ep[c >> 3] & bittab[c & 07])
 
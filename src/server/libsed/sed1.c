@@ -97,7 +97,8 @@ static PRStatus execute(sed_eval_t *eval);
 static int match(sed_eval_t *eval, char *expbuf, int gf,
                  step_vars_storage *step_vars);
 static PRStatus dosub(sed_eval_t *eval, char *rhsbuf, int n,
-                          step_vars_storage *step_vars);
+                          step_vars_storage *step_vars, char **psp,
+                          char **plp);
 static char *place(sed_eval_t *eval, char *asp, char *al1, char *al2);
 static PRStatus command(sed_eval_t *eval, sed_reptr_t *ipc,
                             step_vars_storage *step_vars);
@@ -127,6 +128,9 @@ static void grow_buffer(pool_handle_t *pool, char **buffer,
     int spendsize = 0;
     if (*cursize >= newsize)
         return;
+    /* Grow at least geometrically so long lines aren't copied repeatedly */
+    if (newsize < *cursize * 2)
+        newsize = *cursize * 2;
     /* Align it to 4 KB boundary */
     newsize = (newsize  + ((1 << 12) - 1)) & ~((1 << 12) -1);
     newbuffer = (char *)pool_calloc(pool, (size_t)1, (size_t)newsize);
@@ -607,34 +611,52 @@ static int match(sed_eval_t *eval, char *expbuf, int gf,
 
 /*
  * substitute
+ *
+ * The result is built up in genbuf as matches are found and copied back to
+ * linebuf once, so the matching for a g flag continues in the original line
+ * instead of copying the whole line after every replacement.
  */
 static int substitute(sed_eval_t *eval, sed_reptr_t *ipc,
                       step_vars_storage *step_vars)
 {
+    char *sp;    /* end of the result in genbuf */
+    char *lp;    /* start of the line not yet copied to genbuf */
+
     if(match(eval, ipc->re1, 0, step_vars) == 0)    return(0);
 
     eval->numpass = 0;
     eval->sflag = 0;        /* Flags if any substitution was made */
-    if (dosub(eval, ipc->rhs, ipc->gfl, step_vars) != PR_SUCCESS)
+    sp = eval->genbuf;
+    lp = eval->linebuf;
+    if (dosub(eval, ipc->rhs, ipc->gfl, step_vars, &sp, &lp) != PR_SUCCESS)
         return -1;
 
     if(ipc->gfl) {
         while(*step_vars->loc2) {
             if(match(eval, ipc->re1, 1, step_vars) == 0) break;
-            if (dosub(eval, ipc->rhs, ipc->gfl, step_vars) != PR_SUCCESS)
+            if (dosub(eval, ipc->rhs, ipc->gfl, step_vars, &sp, &lp) != PR_SUCCESS)
                 return -1;
         }
     }
+
+    if (eval->sflag) {
+        append_to_genbuf(eval, lp, &sp);
+        copy_to_linebuf(eval, eval->genbuf);
+    }
     return(eval->sflag);
 }
 
 /*
  * dosub
+ *
+ * Append the line from *plp up to the match and the replacement to the
+ * result at *psp and advance *plp past the match.
  */
 static PRStatus dosub(sed_eval_t *eval, char *rhsbuf, int n,
-                          step_vars_storage *step_vars)
+                          step_vars_storage *step_vars, char **psp,
+                          char **plp)
 {
-    char *lp, *sp, *rp;
+    char *sp, *rp;
     int c;
     PRStatus rv = PR_SUCCESS;
 
@@ -643,10 +665,9 @@ static PRStatus dosub(sed_eval_t *eval, char *rhsbuf, int n,
         if(n != eval->numpass) return PR_SUCCESS;
     }
     eval->sflag = 1;
-    lp = eval->linebuf;
-    sp = eval->genbuf;
+    sp = *psp;
     rp = rhsbuf;
-    sp = place(eval, sp, lp, step_vars->loc1);
+    sp = place(eval, sp, *plp, step_vars->loc1);
     while ((c = *rp++) != 0) {
         if (c == '&') {
             sp = place(eval, sp, step_vars->loc1, step_vars->loc2);
@@ -670,10 +691,8 @@ static PRStatus dosub(sed_eval_t *eval, char *rhsbuf, int n,
             grow_gen_buffer(eval, eval->gsize + 1024, &sp);
         }
     }
-    lp = step_vars->loc2;
-    step_vars->loc2 = sp - eval->genbuf + eval->linebuf;
-    append_to_genbuf(eval, lp, &sp);
-    copy_to_linebuf(eval, eval->genbuf);
+    *psp = sp;
+    *plp = step_vars->loc2;
     return rv;
 }
 
@@ -0,0 +1,721 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * cache: process-wide cache of .htaccess files and user databases
+ *
+ * Without it every request opens and parses the access file of every
+ * directory between ntrans-base and the requested file, and every Basic
+ * authentication scans the whole user database.  Parsed access files,
+ * directories that have none, and user databases are kept here by file
+ * name.  An entry that hasn't been checked for cache-max-age seconds is
+ * revalidated against the file's stat information before it is used.
+ */
+
+#include "base/crit.h"
+#include "base/util.h"
+#include "base/file.h"
+#include "frame/log.h"
+#include "frame/protocol.h"
+
+#include "htaccess.h"
+
+/* Number of hash buckets, must be a power of 2 */
+#define HTACCESS_CACHE_BUCKETS 1024
+
+/* Kinds of cached file */
+#define HTACCESS_NODE_ACCESS 0
+#define HTACCESS_NODE_USERS  1
+
+typedef struct htaccess_node_s htaccess_node;
+struct htaccess_node_s {
+    char *path;
+    PRUint32 hash;
+    int kind;
+    int exists;                 /* stat succeeded */
+    time_t mtime;
+    time_t ctime;
+    off_t size;
+    ino_t ino;
+    time_t checked;             /* when the stat information was taken */
+    int refcnt;
+    int cached;                 /* linked into the hash table */
+    htaccess_node *next;
+    htaccess_node *lru_prev;
+    htaccess_node *lru_next;
+};
+
+struct htaccess_file_s {
+    htaccess_node node;
+    security_data *sec;         /* NULL if there is no access file */
+};
+
+struct htaccess_users_s {
+    htaccess_node node;
+    PRUint32 mask;
+    htaccess_user **buckets;
+};
+
+static CRITICAL _cache_crit = NULL;
+static int _cache_max_entries = HTACCESS_CACHE_SIZE;
+static int _cache_max_age = HTACCESS_CACHE_MAX_AGE;
+static int _cache_entries = 0;
+static htaccess_node *_cache_buckets[HTACCESS_CACHE_BUCKETS];
+static htaccess_node *_cache_lru_head = NULL;
+static htaccess_node *_cache_lru_tail = NULL;
+
+
+/* --------------------------- security_data copies ----------------------- */
+
+
+static char *
+_cache_strdup(const char *s)
+{
+    return s ? PERM_STRDUP(s) : NULL;
+}
+
+static int
+_cache_copylist(int num, char **list, int *methods,
+                char ***plist, int **pmethods)
+{
+    int y;
+
+    if (num < 0)
+        num = 0;
+
+    *plist = (char **) PERM_CALLOC((num + 1) * sizeof(char *));
+    *pmethods = (int *) PERM_CALLOC((num + 1) * sizeof(int));
+    if (!*plist || !*pmethods)
+        return -1;
+
+    for (y = 0; y < num; y++) {
+        if (!((*plist)[y] = PERM_STRDUP(list[y])))
+            return -1;
+        (*pmethods)[y] = methods[y];
+    }
+
+    return 0;
+}
+
+static void
+_cache_freelist(int num, char **list, int *methods)
+{
+    int y;
+
+    if (list) {
+        for (y = 0; y < num; y++) {
+            if (list[y])
+                PERM_FREE(list[y]);
+        }
+        PERM_FREE(list);
+    }
+    if (methods)
+        PERM_FREE(methods);
+}
+
+static void
+_cache_freesec(security_data *sec)
+{
+    _cache_freelist(sec->num_allow, sec->allow, sec->allow_methods);
+    _cache_freelist(sec->num_auth, sec->auth, sec->auth_methods);
+    _cache_freelist(sec->num_deny, sec->deny, sec->deny_methods);
+    if (sec->d)
+        PERM_FREE(sec->d);
+    if (sec->auth_type)
+        PERM_FREE(sec->auth_type);
+    if (sec->auth_name)
+        PERM_FREE(sec->auth_name);
+    if (sec->auth_pwfile)
+        PERM_FREE(sec->auth_pwfile);
+    if (sec->auth_grpfile)
+        PERM_FREE(sec->auth_grpfile);
+    PERM_FREE(sec);
+}
+
+/* Copy a request-allocated security_data into the permanent heap */
+static security_data *
+_cache_copysec(security_data *sec)
+{
+    security_data *copy;
+
+    copy = (security_data *) PERM_CALLOC(sizeof(security_data));
+    if (!copy)
+        return NULL;
+
+    memcpy(copy->order, sec->order, sizeof(copy->order));
+    copy->auth_nsdb = sec->auth_nsdb;
+
+    copy->num_allow = copy->max_num_allow = sec->num_allow;
+    copy->num_auth = copy->max_num_auth = sec->num_auth;
+    copy->num_deny = copy->max_num_deny = sec->num_deny;
+
+    if (_cache_copylist(sec->num_allow, sec->allow, sec->allow_methods,
+                        &copy->allow, &copy->allow_methods) ||
+        _cache_copylist(sec->num_auth, sec->auth, sec->auth_methods,
+                        &copy->auth, &copy->auth_methods) ||
+        _cache_copylist(sec->num_deny, sec->deny, sec->deny_methods,
+                        &copy->deny, &copy->deny_methods))
+    {
+        _cache_freesec(copy);
+        return NULL;
+    }
+
+    copy->d = _cache_strdup(sec->d);
+    copy->auth_type = _cache_strdup(sec->auth_type);
+    copy->auth_name = _cache_strdup(sec->auth_name);
+    copy->auth_pwfile = _cache_strdup(sec->auth_pwfile);
+    copy->auth_grpfile = _cache_strdup(sec->auth_grpfile);
+
+    return copy;
+}
+
+
+/* ------------------------------ cache nodes ----------------------------- */
+
+
+static PRUint32
+_cache_hash(const char *s, int kind)
+{
+    PRUint32 hash = 5381 + kind;
+
+    while (*s)
+        hash = (hash << 5) + hash + (unsigned char) *s++;
+
+    return hash;
+}
+
+static void
+_cache_setstat(htaccess_node *node, struct stat *finfo)
+{
+    node->exists = (finfo != NULL);
+    if (finfo) {
+        node->mtime = finfo->st_mtime;
+        node->ctime = finfo->st_ctime;
+        node->size = finfo->st_size;
+        node->ino = finfo->st_ino;
+    }
+    node->checked = time(NULL);
+}
+
+/* Has the file changed since its stat information was taken? */
+static int
+_cache_changed(htaccess_node *node)
+{
+    struct stat finfo;
+    int exists = (system_stat(node->path, &finfo) == 0);
+
+    if (exists != node->exists)
+        return 1;
+
+    if (exists && (finfo.st_mtime != node->mtime ||
+                   finfo.st_ctime != node->ctime ||
+                   finfo.st_size != node->size ||
+                   finfo.st_ino != node->ino))
+        return 1;
+
+    return 0;
+}
+
+static htaccess_node *
+_cache_newnode(const char *path, int kind, int size, struct stat *finfo)
+{
+    htaccess_node *node = (htaccess_node *) PERM_CALLOC(size);
+
+    if (!node)
+        return NULL;
+
+    if (!(node->path = PERM_STRDUP(path))) {
+        PERM_FREE(node);
+        return NULL;
+    }
+
+    node->hash = _cache_hash(path, kind);
+    node->kind = kind;
+    node->refcnt = 1;
+    _cache_setstat(node, finfo);
+
+    return node;
+}
+
+static void
+_cache_freenode(htaccess_node *node)
+{
+    if (node->kind == HTACCESS_NODE_ACCESS) {
+        htaccess_file *hf = (htaccess_file *) node;
+
+        if (hf->sec)
+            _cache_freesec(hf->sec);
+    } else {
+        htaccess_users *users = (htaccess_users *) node;
+        htaccess_user *u, *next;
+        PRUint32 b;
+
+        if (users->buckets) {
+            for (b = 0; b <= users->mask; b++) {
+                for (u = users->buckets[b]; u; u = next) {
+                    next = u->next;
+                    PERM_FREE(u);
+                }
+            }
+            PERM_FREE(users->buckets);
+        }
+    }
+
+    PERM_FREE(node->path);
+    PERM_FREE(node);
+}
+
+/* Take a node out of the hash table and LRU list, _cache_crit held */
+static void
+_cache_unlink(htaccess_node *node)
+{
+    htaccess_node **pp;
+
+    pp = &_cache_buckets[node->hash & (HTACCESS_CACHE_BUCKETS - 1)];
+    while (*pp != node)
+        pp = &(*pp)->next;
+    *pp = node->next;
+    node->next = NULL;
+
+    if (node->lru_prev)
+        node->lru_prev->lru_next = node->lru_next;
+    else
+        _cache_lru_head = node->lru_next;
+    if (node->lru_next)
+        node->lru_next->lru_prev = node->lru_prev;
+    else
+        _cache_lru_tail = node->lru_prev;
+    node->lru_prev = NULL;
+    node->lru_next = NULL;
+
+    node->cached = 0;
+    _cache_entries--;
+}
+
+/* Make a node the most recently used, _cache_crit held */
+static void
+_cache_touch(htaccess_node *node)
+{
+    if (node == _cache_lru_head)
+        return;
+
+    node->lru_prev->lru_next = node->lru_next;
+    if (node->lru_next)
+        node->lru_next->lru_prev = node->lru_prev;
+    else
+        _cache_lru_tail = node->lru_prev;
+
+    node->lru_prev = NULL;
+    node->lru_next = _cache_lru_head;
+    _cache_lru_head->lru_prev = node;
+    _cache_lru_head = node;
+}
+
+static void
+_cache_release(htaccess_node *node)
+{
+    int unused;
+
+    if (_cache_crit) {
+        crit_enter(_cache_crit);
+        unused = (--node->refcnt == 0 && !node->cached);
+        crit_exit(_cache_crit);
+    } else {
+        unused = (--node->refcnt == 0);
+    }
+
+    if (unused)
+        _cache_freenode(node);
+}
+
+/*
+ * Find a node and take a reference to it.  Returns NULL if the file isn't
+ * cached or has changed since it was.
+ */
+static htaccess_node *
+_cache_lookup(const char *path, int kind)
+{
+    htaccess_node *node;
+    PRUint32 hash;
+    time_t now;
+    time_t checked = 0;
+
+    if (!_cache_crit || _cache_max_entries <= 0)
+        return NULL;
+
+    hash = _cache_hash(path, kind);
+
+    crit_enter(_cache_crit);
+    for (node = _cache_buckets[hash & (HTACCESS_CACHE_BUCKETS - 1)];
+         node; node = node->next)
+    {
+        if (node->hash == hash && node->kind == kind &&
+            !strcmp(node->path, path))
+        {
+            node->refcnt++;
+            checked = node->checked;
+            _cache_touch(node);
+            break;
+        }
+    }
+    crit_exit(_cache_crit);
+
+    if (!node)
+        return NULL;
+
+    now = time(NULL);
+    if (now - checked >= _cache_max_age) {
+        if (_cache_changed(node)) {
+            crit_enter(_cache_crit);
+            if (node->cached)
+                _cache_unlink(node);
+            crit_exit(_cache_crit);
+            _cache_release(node);
+            return NULL;
+        }
+        crit_enter(_cache_crit);
+        node->checked = now;
+        crit_exit(_cache_crit);
+    }
+
+    return node;
+}
+
+/*
+ * Add a node to the cache, replacing any node for the same file and
+ * evicting the least recently used ones if the cache is full.  The caller
+ * keeps its reference.
+ */
+static void
+_cache_insert(htaccess_node *node)
+{
+    htaccess_node *dead = NULL;
+    htaccess_node *old;
+    PRUint32 b = node->hash & (HTACCESS_CACHE_BUCKETS - 1);
+
+    crit_enter(_cache_crit);
+
+    for (old = _cache_buckets[b]; old; old = old->next) {
+        if (old->hash == node->hash && old->kind == node->kind &&
+            !strcmp(old->path, node->path))
+            break;
+    }
+    if (old) {
+        _cache_unlink(old);
+        if (old->refcnt == 0) {
+            old->next = dead;
+            dead = old;
+        }
+    }
+
+    while (_cache_entries >= _cache_max_entries && _cache_lru_tail) {
+        old = _cache_lru_tail;
+        _cache_unlink(old);
+        if (old->refcnt == 0) {
+            old->next = dead;
+            dead = old;
+        }
+    }
+
+    node->next = _cache_buckets[b];
+    _cache_buckets[b] = node;
+    node->lru_prev = NULL;
+    node->lru_next = _cache_lru_head;
+    if (_cache_lru_head)
+        _cache_lru_head->lru_prev = node;
+    else
+        _cache_lru_tail = node;
+    _cache_lru_head = node;
+    node->cached = 1;
+    _cache_entries++;
+
+    crit_exit(_cache_crit);
+
+    while (dead) {
+        old = dead;
+        dead = dead->next;
+        _cache_freenode(old);
+    }
+}
+
+
+/* ------------------------------ access files ---------------------------- */
+
+
+void
+htaccess_cache_init(int max_entries, int max_age)
+{
+    if (!_cache_crit)
+        _cache_crit = crit_init();
+
+    _cache_max_entries = max_entries;
+    _cache_max_age = max_age;
+}
+
+/*
+ * Look up the parsed access file file.  On a hit *psec is set to its
+ * security_data, or NULL if the file doesn't exist, and the returned entry
+ * must be passed to htaccess_cache_release once the caller is done with it.
+ */
+htaccess_file *
+htaccess_cache_lookup(char *file, security_data **psec)
+{
+    htaccess_file *hf;
+
+    hf = (htaccess_file *) _cache_lookup(file, HTACCESS_NODE_ACCESS);
+    if (hf)
+        *psec = hf->sec;
+
+    return hf;
+}
+
+/*
+ * Cache the access file file, parsed into sec, or its absence if sec is
+ * NULL.  finfo is the file's stat information, or NULL if stat failed.
+ * The cache keeps its own copy of sec and returns it in *psec.  Returns
+ * NULL if the file couldn't be cached.
+ */
+htaccess_file *
+htaccess_cache_insert(char *file, struct stat *finfo, security_data *sec,
+                      security_data **psec)
+{
+    htaccess_file *hf;
+
+    if (!_cache_crit || _cache_max_entries <= 0)
+        return NULL;
+
+    hf = (htaccess_file *) _cache_newnode(file, HTACCESS_NODE_ACCESS,
+                                          sizeof(htaccess_file), finfo);
+    if (!hf)
+        return NULL;
+
+    if (sec && !(hf->sec = _cache_copysec(sec))) {
+        _cache_freenode(&hf->node);
+        return NULL;
+    }
+
+    _cache_insert(&hf->node);
+
+    *psec = hf->sec;
+
+    return hf;
+}
+
+void
+htaccess_cache_release(htaccess_file *hf)
+{
+    _cache_release(&hf->node);
+}
+
+
+/* ----------------------------- user databases --------------------------- */
+
+
+/* Add a user unless it's already there, the first entry for a user wins */
+static int
+_users_add(htaccess_users *users, char *name, char *pw, char *groups)
+{
+    htaccess_user **pu;
+    htaccess_user *u;
+    PRUint32 hash = _cache_hash(name, HTACCESS_NODE_USERS);
+    int nlen = strlen(name) + 1;
+    int plen = strlen(pw) + 1;
+    int glen = strlen(groups) + 1;
+
+    for (pu = &users->buckets[hash & users->mask]; *pu; pu = &(*pu)->next) {
+        if (!strcmp((*pu)->name, name))
+            return 0;
+    }
+
+    u = (htaccess_user *) PERM_MALLOC(sizeof(htaccess_user) +
+                                      nlen + plen + glen);
+    if (!u)
+        return -1;
+
+    u->name = (char *) (u + 1);
+    u->pw = u->name + nlen;
+    u->groups = u->pw + plen;
+    memcpy(u->name, name, nlen);
+    memcpy(u->pw, pw, plen);
+    memcpy(u->groups, groups, glen);
+    u->next = NULL;
+    *pu = u;
+
+    return 0;
+}
+
+static htaccess_users *
+_users_load(char *userdb, struct stat *finfo, filebuffer *buf)
+{
+    htaccess_users *users;
+    PRUint32 nbuckets;
+    char line[1024];
+    char *t;
+    char *cp;
+    char *groups;
+    int ln;
+    int eof;
+
+    users = (htaccess_users *) _cache_newnode(userdb, HTACCESS_NODE_USERS,
+                                              sizeof(htaccess_users), finfo);
+    if (!users)
+        return NULL;
+
+    /* Size the table for a line of about 32 bytes per user */
+    for (nbuckets = 16; (off_t) nbuckets < finfo->st_size / 32 &&
+                        nbuckets < (1 << 20); nbuckets <<= 1);
+    users->mask = nbuckets - 1;
+    users->buckets = (htaccess_user **)
+        PERM_CALLOC(nbuckets * sizeof(htaccess_user *));
+    if (!users->buckets) {
+        _cache_freenode(&users->node);
+        return NULL;
+    }
+
+    for (eof = 0, ln = 1; !eof; ++ln) {
+
+        eof = util_getline(buf, ln, sizeof(line), line);
+        if (!line[0])
+            continue;
+
+        /* Look for ':' terminating user name */
+        t = strchr(line, ':');
+        if (!t)
+            continue;
+        *t++ = '\0';
+
+        /* Look for colon at end of password, groups end at the next ':' */
+        groups = (char *) "";
+        cp = strchr(t, ':');
+        if (cp) {
+            *cp++ = '\0';
+            groups = cp;
+            cp = strchr(groups, ':');
+            if (cp)
+                *cp = '\0';
+        }
+
+        if (_users_add(users, line, t, groups)) {
+            _cache_freenode(&users->node);
+            return NULL;
+        }
+    }
+
+    return users;
+}
+
+/*
+ * Get the parsed user database userdb, loading it if it isn't cached or
+ * has changed.  On REQ_PROCEED the database must be passed to
+ * htaccess_users_close once the caller is done with it.
+ */
+int
+htaccess_users_open(char *userdb, htaccess_users **pusers,
+                    Session *sn, Request *rq)
+{
+    htaccess_users *users;
+    SYS_FILE fd;
+    filebuffer *buf;
+    struct stat finfo;
+
+    users = (htaccess_users *) _cache_lookup(userdb, HTACCESS_NODE_USERS);
+    if (users) {
+        *pusers = users;
+        return REQ_PROCEED;
+    }
+
+    if ((system_stat(userdb, &finfo) < 0) || !S_ISREG(finfo.st_mode)) {
+        log_error(LOG_MISCONFIG, "htaccess-userdb", sn, rq,
+                  "invalid user database file %s", userdb);
+        return REQ_ABORTED;
+    }
+
+    /* Open user file */
+
+    fd = system_fopenRO(userdb);
+    if (fd == SYS_ERROR_FD) {
+        log_error(LOG_FAILURE, "htaccess-userdb", sn, rq, 
+                  "can't open basic user/group file %s (%s)", userdb, 
+                  system_errmsg());
+        protocol_status(sn, rq, PROTOCOL_SERVER_ERROR, NULL);
+        return REQ_ABORTED;
+    }
+
+    buf = filebuf_open(fd, FILE_BUFFERSIZE);
+    if(!buf) {
+        log_error(LOG_FAILURE, "htaccess-userdb", sn, rq, 
+                  "can't open buffer from password file %s (%s)", userdb, 
+                  system_errmsg());
+        protocol_status(sn, rq, PROTOCOL_SERVER_ERROR, NULL);
+        system_fclose(fd);
+        return REQ_ABORTED;
+    }
+
+    users = _users_load(userdb, &finfo, buf);
+    filebuf_close(buf);
+
+    if (!users) {
+        log_error(LOG_FAILURE, "htaccess-userdb", sn, rq,
+                  "out of memory reading user database %s", userdb);
+        protocol_status(sn, rq, PROTOCOL_SERVER_ERROR, NULL);
+        return REQ_ABORTED;
+    }
+
+    if (_cache_crit && _cache_max_entries > 0)
+        _cache_insert(&users->node);
+
+    *pusers = users;
+
+    return REQ_PROCEED;
+}
+
+htaccess_user *
+htaccess_users_find(htaccess_users *users, char *user)
+{
+    htaccess_user *u;
+    PRUint32 hash = _cache_hash(user, HTACCESS_NODE_USERS);
+
+    for (u = users->buckets[hash & users->mask]; u; u = u->next) {
+        if (!strcmp(u->name, user))
+            return u;
+    }
+
+    return NULL;
+}
+
+void
+htaccess_users_close(htaccess_users *users)
+{
+    _cache_release(&users->node);
+}
@@ -48,6 +48,9 @@
 
 #include "httpd.h"
 
+typedef struct htaccess_file_s htaccess_file;
+typedef struct htaccess_users_s htaccess_users;
+
 typedef struct {
     pblock *pb;
     Session *sn;
@@ -72,7 +75,10 @@ typedef struct {
 #endif /* AUTHNSDBFILE */
 
     int num_sec;
-    security_data * sec;
+    int max_num_sec;
+    security_data ** sec;
+    htaccess_file ** sec_file;  /* cache entry holding sec[x], or NULL */
+    int sec_uncacheable;        /* parsing called a registered directive */
 
     char *remote_host;
     char *remote_ip;
@@ -156,6 +162,8 @@ int htaccess_evaluate(htaccess_context_s *ctxt);
 static htaccess_context_s *
     _htaccess_newctxt(pblock *pb, Session *sn, Request *rq);
 static void _htaccess_freectxt(htaccess_context_s *ctxt);
+static void _htaccess_addsec(htaccess_context_s *ctxt, security_data *sec,
+                             htaccess_file *hf);
 
 /* http_auth */
 int htaccess_check_auth(security_data *sec, int m, htaccess_context_s *ctxt);
@@ -171,7 +179,8 @@ const char * htaccess_check_allow(char * where);
 filebuffer * htaccess_cfg_open(char *name);
 void htaccess_cfg_close(filebuffer *buf);
 int htaccess_parse_access_dir(filebuffer *f, int line, char _or, char *dir,
-                              char *file, htaccess_context_s *ctxt);
+                              char *file, security_data **psec,
+                              htaccess_context_s *ctxt);
 
 
 /* http_request */
@@ -191,6 +200,32 @@ extern char *_ht_fn_usrgrp;
 
 /* list */
 security_data * htaccess_newsec(void);
-security_data * htaccess_addsec(security_data * head, security_data * item);
-security_data * htaccess_getsec(security_data * head, int x);
-void htaccess_secflush(security_data * head);
+void htaccess_freesec(security_data * item);
+
+/* cache */
+
+/* Default limit on the number of cached files */
+#define HTACCESS_CACHE_SIZE 1024
+
+/* Default number of seconds between stat checks of a cached file */
+#define HTACCESS_CACHE_MAX_AGE 1
+
+/* A user database entry */
+typedef struct htaccess_user_s htaccess_user;
+struct htaccess_user_s {
+    char *name;
+    char *pw;
+    char *groups;               /* comma-separated, "" if none were given */
+    htaccess_user *next;
+};
+
+void htaccess_cache_init(int max_entries, int max_age);
+htaccess_file * htaccess_cache_lookup(char *file, security_data **psec);
+htaccess_file * htaccess_cache_insert(char *file, struct stat *finfo,
+                                      security_data *sec,
+                                      security_data **psec);
+void htaccess_cache_release(htaccess_file *hf);
+int htaccess_users_open(char *userdb, htaccess_users **pusers,
+                        Session *sn, Request *rq);
+htaccess_user * htaccess_users_find(htaccess_users *users, char *user);
+void htaccess_users_close(htaccess_users *users);
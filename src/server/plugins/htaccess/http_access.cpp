@@ -45,6 +45,7 @@
  * 
  */
 
+#include "base/file.h"       /* system_stat */
 #include "frame/protocol.h"  /* protocol_status */
 
 #include "htaccess.h"
@@ -82,6 +83,7 @@ int htaccess_in_domain(char *domain, char *what) {
  *       check_allow()
  */
 int htaccess_in_ip(char *allowfrom, char *where) {
+    char buf[MAX_STRING_LEN];
     char * s;
     unsigned long mask = 0; /* allow all bits */
 
@@ -90,6 +92,11 @@ int htaccess_in_ip(char *allowfrom, char *where) {
 
     remoteip = inet_addr(where);
 
+    /* allowfrom may be a cached entry shared with other requests */
+    strncpy(buf, allowfrom, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    allowfrom = buf;
+
     if ((s = strchr(allowfrom, '/'))) { 
 
         *s++ = '\0';
@@ -157,7 +164,7 @@ int htaccess_check_method(int method_mask, int method) {
 
 int htaccess_find_allow(int x, int method, htaccess_context_s *ctxt) {
     register int y;
-    security_data * sec = htaccess_getsec(ctxt->sec, x);
+    security_data * sec = ctxt->sec[x];
 
     if(sec->num_allow < 0)
         return 0;
@@ -182,7 +189,7 @@ int htaccess_find_allow(int x, int method, htaccess_context_s *ctxt) {
 
 int htaccess_find_deny(int x, int method, htaccess_context_s *ctxt) {
     register int y;
-    security_data * sec = htaccess_getsec(ctxt->sec, x);
+    security_data * sec = ctxt->sec[x];
 
     if(sec->num_deny < 0)
         return 1;
@@ -207,7 +214,7 @@ int htaccess_find_deny(int x, int method, htaccess_context_s *ctxt) {
 
 void htaccess_check_dir_access(int x, int m, int *w, int *n, htaccess_context_s *ctxt) 
 {
-    security_data * sec = htaccess_getsec(ctxt->sec, x);
+    security_data * sec = ctxt->sec[x];
 
     if(sec->auth_type)
         ctxt->auth_type = sec->auth_type;
@@ -309,18 +316,57 @@ int htaccess_evaluate_access(char *p, int isdir, int methnum,
         if ((strcmp(root_dir, base)) == 0) start=1;
 
         if (start) {
-            filebuffer *f;
+            htaccess_file *hf;
+            security_data *sec = NULL;
 
             htaccess_make_full_path(root_dir, access_name, full_filename);
 
-            /* don't create a context unless there is a file to parse */
-            if ((f=htaccess_cfg_open(full_filename))) {
-		if (!init) {
+            /* use the cached file, or the cached lack of one, if unchanged */
+            hf = htaccess_cache_lookup(full_filename, &sec);
+            if (!hf) {
+                struct stat finfo;
+                struct stat *pfinfo = NULL;
+                filebuffer *f = NULL;
+
+                if (system_stat(full_filename, &finfo) == 0) {
+                    pfinfo = &finfo;
+                    if (S_ISREG(finfo.st_mode))
+                        f = htaccess_cfg_open(full_filename);
+                }
+
+                /* don't create a context unless there is a file to parse */
+                if (f) {
+                    if (!init) {
+                        ctxt = _htaccess_newctxt(pb, sn, rq);
+                        init=1;
+                    }
+                    ctxt->sec_uncacheable = 0;
+                    if (htaccess_parse_access_dir(f,-1,0,root_dir,full_filename,
+                                                  &sec,ctxt) == REQ_PROCEED &&
+                        !ctxt->sec_uncacheable)
+                    {
+                        security_data *parsed = sec;
+
+                        hf = htaccess_cache_insert(full_filename, pfinfo,
+                                                   parsed, &sec);
+                        if (hf)
+                            htaccess_freesec(parsed);
+                    }
+                    htaccess_cfg_close(f);
+                } else {
+                    hf = htaccess_cache_insert(full_filename, pfinfo,
+                                               NULL, &sec);
+                }
+            }
+
+            if (sec) {
+                if (!init) {
                     ctxt = _htaccess_newctxt(pb, sn, rq);
                     init=1;
                 }
-                htaccess_parse_access_dir(f,-1,0,root_dir,full_filename,ctxt);
-                htaccess_cfg_close(f);
+                _htaccess_addsec(ctxt, sec, hf);
+            } else if (hf) {
+                htaccess_cache_release(hf);
             }
         }
     }
@@ -335,7 +381,7 @@ int htaccess_evaluate_access(char *p, int isdir, int methnum,
             rv = ACCESS_FORBIDDEN;
         else {
             if(need_auth >= 0) {
-                security_data * sec = htaccess_getsec(ctxt->sec, need_auth);
+                security_data * sec = ctxt->sec[need_auth];
                 if(htaccess_check_auth(sec,methnum,ctxt) == REQ_ABORTED)
                     rv = ACCESS_AUTHFAIL;
             }
@@ -427,6 +473,10 @@ _htaccess_newctxt(pblock *pb, Session *sn, Request *rq)
     ctxt->auth_line = pblock_findval("authorization", rq->headers);
 
     ctxt->num_sec = 0;
+    ctxt->max_num_sec = 0;
+    ctxt->sec = NULL;
+    ctxt->sec_file = NULL;
+    ctxt->sec_uncacheable = 0;
 
     ctxt->remote_host = rhst;
     ctxt->remote_ip = pblock_findval("ip", sn->client);
@@ -439,32 +489,55 @@ _htaccess_newctxt(pblock *pb, Session *sn, Request *rq)
     ctxt->user[0] = '\0';
     ctxt->groupname[0] = '\0';
 
-    ctxt->sec = htaccess_newsec();
-
     return ctxt;
 }
 
+/* Append the security_data of the next directory, hf is its cache entry */
+static void
+_htaccess_addsec(htaccess_context_s *ctxt, security_data *sec,
+                 htaccess_file *hf)
+{
+    if (ctxt->num_sec == ctxt->max_num_sec) {
+        ctxt->max_num_sec += 8;
+        ctxt->sec = (security_data **) REALLOC(ctxt->sec,
+                        ctxt->max_num_sec * sizeof(security_data *));
+        ctxt->sec_file = (htaccess_file **) REALLOC(ctxt->sec_file,
+                        ctxt->max_num_sec * sizeof(htaccess_file *));
+    }
+
+    ctxt->sec[ctxt->num_sec] = sec;
+    ctxt->sec_file[ctxt->num_sec] = hf;
+    ctxt->num_sec++;
+}
+
 static void
 _htaccess_freectxt(htaccess_context_s *ctxt)
 {
-    int x, y;
+    int x;
+
+    if(ctxt->user_check_fn)
+        FREE(ctxt->user_check_fn);
+    if(ctxt->group_check_fn)
+        FREE(ctxt->group_check_fn);
+    if (ctxt->auth_authdb) {
+        htaccess_kill_group(ctxt);
+    }
+    if (ctxt->auth_grplist) {
+        FREE(ctxt->auth_grplist);
+    }
+    if (ctxt->auth_grplfile) {
+        FREE(ctxt->auth_grplfile);
+    }
 
     for(x=0;x<ctxt->num_sec;x++) {
-        if(ctxt->user_check_fn)
-            FREE(ctxt->user_check_fn);
-        if(ctxt->group_check_fn)
-            FREE(ctxt->group_check_fn);
-        if (ctxt->auth_authdb) {
-            htaccess_kill_group(ctxt);
-        }
-        if (ctxt->auth_grplist) {
-            FREE(ctxt->auth_grplist);
-        }
-        if (ctxt->auth_grplfile) {
-            FREE(ctxt->auth_grplfile);
-        }
+        if (ctxt->sec_file[x])
+            htaccess_cache_release(ctxt->sec_file[x]);
+        else
+            htaccess_freesec(ctxt->sec[x]);
+    }
+    if (ctxt->sec) {
+        FREE(ctxt->sec);
+        FREE(ctxt->sec_file);
     }
-    htaccess_secflush(ctxt->sec);
-    FREE(ctxt->sec);
     FREE(ctxt);
 }
@@ -144,28 +144,25 @@ static int grow_sectable(int * max_num, char *** data, int ** data_methods)
 }
 
 
-int 
-htaccess_parse_access_dir(filebuffer *f, int line, char _or, char *dir, 
-                          char *file, htaccess_context_s *ctxt) 
+static int 
+_parse_access_dir(filebuffer *f, int line, char _or, char *dir, 
+                  char *file, security_data *sec, htaccess_context_s *ctxt) 
 {
     char l[MAX_STRING_LEN];
     char w[MAX_STRING_LEN];
     char w2[MAX_STRING_LEN];
     char w3[MAX_STRING_LEN];
     int n=line;
-    register int x,i,q;
+    register int i,q;
     int methods = 0;
     int methnum = 0;
     int inlimit=0;
     int inlimitexcept=0;
     struct t_command * item;
-    security_data * sec = htaccess_newsec();
 
     log_error(LOG_VERBOSE, "htaccess_parse_access_dir", ctxt->sn, ctxt->rq, 
               "Processing [%s]", file);
 
-    x = ctxt->num_sec;
-
     if(!(sec->d = (char *)MALLOC((sizeof(char)) * (strlen(dir) + 2))))
         return die(NO_MEMORY,"parse_access_dir",ctxt);
     if(htaccess_is_matchexp(dir))
@@ -390,6 +387,11 @@ htaccess_parse_access_dir(filebuffer *f, int line, char _or, char *dir,
                 if (inlimit || inlimitexcept)
                     return access_syntax_error(n, "directive not allowed here.",
                                                file,ctxt);
+
+                /* Registered directives act on the request and set up the
+                 * context, so the file has to be parsed for every request */
+                ctxt->sec_uncacheable = 1;
+
                 switch(item->argtype) {
                     case BOOL:
                         htaccess_cfg_getword(w2,l);
@@ -496,11 +498,30 @@ htaccess_parse_access_dir(filebuffer *f, int line, char _or, char *dir,
     /* EOF w/o </LimitExcept> */
     if(inlimitexcept)
         return access_syntax_error(n,"<LimitExcept> missing </LimitExcept>", file,ctxt);
-    ++ctxt->num_sec;
-    ctxt->sec = htaccess_addsec(ctxt->sec, sec);
     return REQ_PROCEED;
 }
 
+/*
+ * Parse an access control file into a new security_data. *psec is set only
+ * if the file was parsed without error.
+ */
+int 
+htaccess_parse_access_dir(filebuffer *f, int line, char _or, char *dir, 
+                          char *file, security_data **psec,
+                          htaccess_context_s *ctxt) 
+{
+    security_data * sec = htaccess_newsec();
+    int rv;
+
+    rv = _parse_access_dir(f, line, _or, dir, file, sec, ctxt);
+    if (rv == REQ_PROCEED)
+        *psec = sec;
+    else
+        htaccess_freesec(sec);
+
+    return rv;
+}
+
 
 int htaccess_check_group(char *group, int glen, char *grplist)
 {
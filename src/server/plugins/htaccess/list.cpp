@@ -31,9 +31,9 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-/* Simple single linked-list functions. This replaces an array of MAX_SECURITY
- * elements of security_data in the context, reducing memory usage from
- * 68,788 bytes/request to at around 1960 bytes/request */
+/* security_data allocation. The context used to hold an array of MAX_SECURITY
+ * elements of security_data, which cost 68,788 bytes/request. It now holds
+ * pointers to entries allocated here or shared from the cache. */
 
 #include "htaccess.h"
 
@@ -63,92 +63,49 @@ security_data * htaccess_newsec(void)
     item->num_auth = 0;
     item->num_deny = 0;
 
+    item->d = NULL;
+    item->auth_type = NULL;
+    item->auth_name = NULL;
+    item->auth_pwfile = NULL;
+    item->auth_grpfile = NULL;
+
     item->next = NULL;
 
     return item;
 }
 
-/* Add a new entry, returning a pointer to the head. This first entry needs
- * to have already been allocated as a place holder. */
-security_data * htaccess_addsec(security_data * head, security_data * item)
+/* Free an entry allocated by htaccess_newsec */
+void htaccess_freesec(security_data * item)
 {
-    security_data * start;
-
-    start = head;
-
-    while (head->next != NULL) {
-        head = head->next;
-    }
-
-    head->next = item;
-
-    return start;
-}
-
-/*
- * Get an element. The first entry is a place holder so give the x+1 entry
- * back.
- */
-security_data * htaccess_getsec(security_data * head, int x)
-{
-    int i = 0;
-    security_data * start;
+    int y;
 
-    start = head;
-    x++;
+    if(item->d)
+        FREE(item->d);
 
-    while (start && (i < x)) {
-        start = start->next;
-        i++;
-    }
+    for(y=0;y<item->num_allow;y++)
+        FREE(item->allow[y]);
+    FREE(item->allow);
+    FREE(item->allow_methods);
 
-    if (start)
-        return start;
-    else
-        return NULL;
-}
+    for(y=0;y<item->num_deny;y++)
+        FREE(item->deny[y]);
+    FREE(item->deny);
+    FREE(item->deny_methods);
 
-/* Free all elements of the list except the head */
-void htaccess_secflush(security_data * head)
-{
-    security_data * start;
-    security_data * item;
-    int y;
+    for(y=0;y<item->num_auth;y++)
+        FREE(item->auth[y]);
+    FREE(item->auth);
+    FREE(item->auth_methods);
 
-    start = head->next;
+    if(item->auth_type)
+        FREE(item->auth_type);
+    if(item->auth_name)
+        FREE(item->auth_name);
 
-    while(start) {
-        item = start;
-        FREE(item->d);
+    if(item->auth_pwfile)
+        FREE(item->auth_pwfile);
+    if(item->auth_grpfile)
+        FREE(item->auth_grpfile);
 
-        for(y=0;y<item->num_allow;y++)
-            FREE(item->allow[y]);
-        FREE(item->allow);
-        FREE(item->allow_methods);
-        item->max_num_allow = 0;
-
-        for(y=0;y<item->num_deny;y++)
-            FREE(item->deny[y]);
-        FREE(item->deny);
-        FREE(item->deny_methods);
-        item->max_num_deny = 0;
-
-        for(y=0;y<item->num_auth;y++)
-            FREE(item->auth[y]);
-        FREE(item->auth);
-        FREE(item->auth_methods);
-        item->max_num_auth = 0;
-
-        if(item->auth_type)
-            FREE(item->auth_type);
-        if(item->auth_name)
-            FREE(item->auth_name);
-
-        if(item->auth_pwfile)
-            FREE(item->auth_pwfile);
-        if(item->auth_grpfile)
-            FREE(item->auth_grpfile);
-        start = item->next;
-        FREE(item);
-    }
+    FREE(item);
 }
@@ -66,14 +66,9 @@ htaccess_userdb(pblock *pb, Session *sn, Request *rq)
     char *userdb = pblock_findval("userdb", pb);
     char *user = pblock_findval("user", pb);
     char *pw = pblock_findval("pw", pb);
-    char *t;
-    char *cp;
-    SYS_FILE fd;
-    filebuffer *buf;
-    int ln;
-    int eof;
-    struct stat finfo;
-    char line[1024];
+    htaccess_users *users;
+    htaccess_user *entry;
+    int rv;
 
     if (!userdb) {
         log_error(LOG_MISCONFIG, "htaccess-userdb", sn, rq,
@@ -93,93 +88,29 @@ htaccess_userdb(pblock *pb, Session *sn, Request *rq)
         return REQ_ABORTED;
     }
 
-    if ((system_stat(userdb, &finfo) < 0) || !S_ISREG(finfo.st_mode)) {
-        log_error(LOG_MISCONFIG, "htaccess-userdb", sn, rq,
-                  "invalid user database file %s", userdb);
-        return REQ_ABORTED;
-    }
-
-    /* Open user file */
-
-    fd = system_fopenRO(userdb);
-    if (fd == SYS_ERROR_FD) {
-        log_error(LOG_FAILURE, "htaccess-userdb", sn, rq, 
-                  "can't open basic user/group file %s (%s)", userdb, 
-                  system_errmsg());
-        protocol_status(sn, rq, PROTOCOL_SERVER_ERROR, NULL);
-        return REQ_ABORTED;
-    }
-
-    buf = filebuf_open(fd, FILE_BUFFERSIZE);
-    if(!buf) {
-        log_error(LOG_FAILURE, "htaccess-userdb", sn, rq, 
-                  "can't open buffer from password file %s (%s)", userdb, 
-                  system_errmsg());
-        protocol_status(sn, rq, PROTOCOL_SERVER_ERROR, NULL);
-        system_fclose(fd);
-        return REQ_ABORTED;
-    }
-
-    /* Scan user file for desired user */
-    for (eof = 0, ln = 1; !eof; ++ln) {
-
-        eof = util_getline(buf, ln, sizeof(line), line);
-        if (line[0]) {
-
-            /* Look for ':' terminating user name */
-            t = strchr(line, ':');
-            if (t) {
-
-                /* Terminate user name */
-                *t++ = '\0';
-
-                /* Is this the desired user? */
-                if (!strcmp(line, user)) {
-
-                    /* Look for colon at end of password */
-                    cp = strchr(t, ':');
-                    if (cp) {
-
-                        /* Terminate password, advance to start of groups */
-                        *cp++ = '\0';
-                    }
-
-                    if (ACL_CryptCompare(pw, t, t) != 0) {
-                        log_error(LOG_SECURITY, "htaccess-userdb", sn, rq, 
-                          "user %s password did not match user database %s", 
-                                  user, userdb);
-                        break;
-                    }
-
-                    /* Got a match, so try for groups  */
-                    if (cp) {
-
-                        /* Save start of groups */
-                        t = cp;
-
-                        /* Terminate groups at next ':' or end-of-line */
-                        cp = strchr(t, ':');
-                        if (cp) *cp = 0;
-
-                        /* Set comma-separated list of groups */
-                        pblock_nvinsert("auth-group", t, rq->vars);
-                    }
-                    else {
-                        /* Set an empty group list */
-                        pblock_nvinsert("auth-group", "", rq->vars);
-                    }
-
-                    filebuf_close(buf);
-                    return REQ_PROCEED;
-                }
-            }
+    /* Get the parsed user file, cached until it changes */
+    rv = htaccess_users_open(userdb, &users, sn, rq);
+    if (rv != REQ_PROCEED)
+        return rv;
+
+    /* Look up the desired user */
+    rv = REQ_NOACTION;
+    entry = htaccess_users_find(users, user);
+    if (entry) {
+        if (ACL_CryptCompare(pw, entry->pw, entry->pw) != 0) {
+            log_error(LOG_SECURITY, "htaccess-userdb", sn, rq, 
+                      "user %s password did not match user database %s", 
+                      user, userdb);
+        }
+        else {
+            /* Set comma-separated list of groups */
+            pblock_nvinsert("auth-group", entry->groups, rq->vars);
+            rv = REQ_PROCEED;
         }
-
     }
 
-    /* The desired user was not found, or the password didn't match */
-    filebuf_close(buf);
-    return REQ_NOACTION;
+    htaccess_users_close(users);
+    return rv;
 }
 
 #ifdef __cplusplus
@@ -192,11 +123,17 @@ htaccess_init(pblock *pb, Session *unused2, Request *unused3)
     char *gwu = pblock_findval("groups-with-users", pb);
     char *fnbasic = pblock_findval("basic-auth-fn", pb);
     char *fnuser = pblock_findval("user-auth-fn", pb);
+    char *cachesize = pblock_findval("cache-size", pb);
+    char *cachemaxage = pblock_findval("cache-max-age", pb);
 
     _ht_gwu = (gwu && !strcasecmp(gwu, "yes"));
     _ht_fn_basic = (fnbasic) ? fnbasic : (char *)"basic-auth";
     _ht_fn_user = (fnuser) ? fnuser : 0;
 
+    /* Parsed access files and user databases, cache-size 0 disables */
+    htaccess_cache_init(cachesize ? atoi(cachesize) : HTACCESS_CACHE_SIZE,
+                        cachemaxage ? atoi(cachemaxage) : HTACCESS_CACHE_MAX_AGE);
+
     if (!func_find("htaccess-userdb")) {
         func_insert("htaccess-userdb", htaccess_userdb);
     }
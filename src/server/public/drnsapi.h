@@ -94,7 +94,8 @@ typedef PRIntn (*CompareFunc_t)(const char *k1, const char *k2,
  *                    - can be null, pl. see DR_CHECK, DR_EXPIR below
  *         fre        - Function Pointer to Free an Entry
  *         cmp        - Key Comparator Function
- *         maxEntries - Maximum Number of Entries
+ *         maxEntries - Expected Number of Entries, used to size the cache
+ *                    - Entries are not evicted, see dr_cache_init_size
  *         maxAge     - Maximum age an Entry is Valid
  *                    - If 0 - then cache never expires
  *OUTPUT : hdl        - Allocated 'DrHdl' on Success NULL on Failure
@@ -105,6 +106,23 @@ NSAPI_PUBLIC PRInt32 dr_cache_init(DrHdl *hdl, RefreshFunc_t ref,
 				FreeFunc_t fre, CompareFunc_t cmp,
 				PRUint32 maxEntries, PRIntervalTime maxAge);
 
+/*NSAPI Function Called by the Application at Init*/
+/*Same as dr_cache_init, but limits the memory used by the cached entries*/
+/*rather than sizing the cache by a number of entries.  When the limit is*/
+/*reached, the least recently used entries are evicted*/
+/*INPUT  : maxBytes   - Maximum Bytes used by Keys and Entries
+ *                    - If 0 - then the cache is not limited
+ *         Remaining arguments as for dr_cache_init
+ *OUTPUT : hdl        - Allocated 'DrHdl' on Success NULL on Failure
+ *         Returns    - 1 on Success 0 on Failure
+ *Expired entries that are not used are removed in the background, and
+ *'fre' may be called from a thread other than the request threads
+ */
+
+NSAPI_PUBLIC PRInt32 dr_cache_init_size(DrHdl *hdl, RefreshFunc_t ref,
+				FreeFunc_t fre, CompareFunc_t cmp,
+				PRUint64 maxBytes, PRIntervalTime maxAge);
+
 /*NSAPI Function To Destroy Cache Entry Completly
  *This Function takes the handle to a previously initialized cache object
  *and destroys it and renders it unusable
@@ -136,6 +154,8 @@ NSAPI_PUBLIC PRInt32 dr_cache_refresh(DrHdl hdl, const char *key, PRUint32 klen,
  *By default this function will refresh the cache if expired or create a
  *cache Entry if none found with the key - unless DR_CHECK is passed in 'flags'
  *in which case the refresh must be done separately using dr_cache_refresh
+ *While one request refreshes an expired entry, concurrent requests for the
+ *same key send the expired entry rather than waiting
  *INPUT   : hdl       - Persistent 'DrHdl' created through dr_cache_init
  *          key       - Key to Cache/Search/Refresh
  *         klen       - Length of Key
@@ -65,7 +65,7 @@ PR_BEGIN_EXTERN_C
 
 #define STATS_MAGIC                 "iWS\n"
 #define STATS_VERSION_MAJOR         1
-#define STATS_VERSION_MINOR         3
+#define STATS_VERSION_MINOR         4
 
 #define STATS_STATUS_NOT_ENABLED 0x00
 #define STATS_STATUS_ENABLED     0x01
@@ -217,6 +217,26 @@ typedef struct _StatsDnsBucket {
     /* Note: this structure may grow in future versions */
 } StatsDnsBucket;
 
+/* 
+ * StatsSslBucket
+ * 
+ * This structure contains SSL/TLS handshake and session resumption
+ * statistics.
+ */
+typedef struct _StatsSslBucket {
+    PRPackedBool flagCacheEnabled;
+    PRPackedBool flagTicketsSupported;
+    char     reserved[2];
+
+    PRUint32 countHandshakes;
+    PRUint32 countFullHandshakes;
+    PRUint32 countCacheResumptions;
+    PRUint32 countTicketResumptions;
+    PRUint32 countCacheMisses;
+
+    /* Note: this structure may grow in future versions */
+} StatsSslBucket;
+
 /* 
  * StatsKeepaliveBucket
  * 
@@ -551,6 +571,8 @@ typedef struct _StatsProcessSlot {
     PRUint64 sizeVirtual;
     PRUint64 sizeResident;
 
+    StatsSslBucket           sslBucket;
+
     /* Note: this structure may grow in future versions */
 } StatsProcessSlot;
 
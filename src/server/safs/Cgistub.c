@@ -100,6 +100,15 @@ static void SetupCgiStubSignalDisposition();
 #define MIN_USER_ID    99 /* RedHat Linux uses uid 99 / gid 99 for nobody / nobody. */
 #endif
 
+/* default number of persistent workers a second-stage process keeps */
+#define PERSISTENT_WORKERS     4
+
+/* default number of requests a persistent worker handles before it's retired */
+#define PERSISTENT_REQUESTS 1000
+
+/* seconds to wait for a persistent worker to answer or open its FIFOs */
+#define PERSISTENT_TIMEOUT    30
+
 /* Convert literal to a string via preprocessor */
 #define _STRINGIFY(x) #x
 #define STRINGIFY(x) _STRINGIFY(x)
@@ -114,6 +123,8 @@ int          listen_fd   = 0;
 const char * myName;
 int          min_user_uid = MIN_USER_ID;    /* minimum non-system uid */
 int          trusted_uid = -1;              /* trust no one */
+int          persistent_workers = PERSISTENT_WORKERS;  /* per stub */
+int          persistent_requests = PERSISTENT_REQUESTS; /* per worker */
 #ifdef _BE_VERBOSE
 int          verbose = 1;                   /* be noisy */
 #else
@@ -134,6 +145,8 @@ typedef struct {
     char *   prog;                  /* executable (argv0) */
     char **  argv;                  /* argv array */
     char **  envp;                  /* environment variables array */
+    char *   persistent;            /* persistent worker wrapper path */
+    char *   script;                /* script run by a persistent worker */
 } child_parms_t;
 
 /*
@@ -142,7 +155,9 @@ typedef struct {
  */
 char parameters[512] = "Cgistub parameter block\0"
                        "min_user_uid "STRINGIFY(MIN_USER_ID)"       \n"
-                       "trusted_uid -1        \n";
+                       "trusted_uid -1        \n"
+                       "persistent_workers 4        \n"
+                       "persistent_requests 1000        \n";
 
 /*
  * Return a pointer into a parameter block
@@ -448,6 +463,12 @@ static void parse_parameters(void)
 {
     min_user_uid = get_int_parameter("min_user_uid");
     trusted_uid = get_int_parameter("trusted_uid");
+    persistent_workers = get_int_parameter("persistent_workers");
+    if (persistent_workers < 0)
+        persistent_workers = PERSISTENT_WORKERS;
+    persistent_requests = get_int_parameter("persistent_requests");
+    if (persistent_requests < 1)
+        persistent_requests = PERSISTENT_REQUESTS;
 }
 
 /*
@@ -492,6 +513,41 @@ int setrlimit_wrapper(int resource, const char* string)
     return 0; /* success */
 }
 
+/*
+ *  make sure a program that's about to run as another user is owned by
+ *  that user (or the trusted user) and can't be written by anyone else
+ */
+static crsp_type_e
+check_program( const char * file, uid_t child_uid, int * rsp_info )
+{
+    struct stat st;
+
+    /* get permissions on the program we're trying to execute */
+    if (stat(file, &st)) {
+        *rsp_info = errno;
+        return CRSP_STATFAIL;
+    }
+
+    /* are we trying to execute something we don't own? */
+    if (st.st_uid != child_uid) {
+        /* if it's not owned by the trusted user... */
+        if (trusted_uid < 0 || st.st_uid != trusted_uid) {
+            *rsp_info = EACCES;
+            return CRSP_EXECOWNER;
+        }
+    }
+
+    /* trying to exec something we're not allowed to is handled by exec */
+
+    /* are we trying to execute something someone else can write to? */
+    if (st.st_mode & (S_IWGRP | S_IWOTH)) {
+        *rsp_info = EACCES;
+        return CRSP_EXECPERMS;
+    }
+
+    return CRSP_OK;
+}
+
 /*
  *  exec the new process (this runs as a child)
  *  this returns an error indication and sets the
@@ -672,8 +728,6 @@ child_code( child_parms_t * parms, int * rsp_info )
      * is caller attempting to change users?
      */
     if (child_uid != caller_uid) {
-        struct stat st;
-
         /* 
          * caller is attempting to change users, be very picky about what is 
          * and is not allowed
@@ -688,28 +742,14 @@ child_code( child_parms_t * parms, int * rsp_info )
             }
         }
 
-        /* get permissions on the program we're trying to execute */
-        if (stat(path, &st)) {
-            *rsp_info = errno;
-            return CRSP_STATFAIL;
-        }
-
-        /* are we trying to execute something we don't own? */
-        if (st.st_uid != child_uid) {
-            /* if it's not owned by the trusted user... */
-            if (trusted_uid < 0 || st.st_uid != trusted_uid) {
-                *rsp_info = EACCES;
-                return CRSP_EXECOWNER;
-            }
-        }
+        /* check the program we're trying to execute */
+        if ((rc = check_program(path, child_uid, rsp_info)) != CRSP_OK)
+            return rc;
 
-        /* trying to exec something we're not allowed to is handled by exec */
-
-        /* are we trying to execute something someone else can write to? */
-        if (st.st_mode & (S_IWGRP | S_IWOTH)) {
-            *rsp_info = EACCES;
-            return CRSP_EXECPERMS;
-        }
+        /* a persistent worker will run the script as well */
+        if (parms->script &&
+            (rc = check_program(parms->script, child_uid, rsp_info)) != CRSP_OK)
+            return rc;
     }
 
     /* cleanup for the kid */
@@ -815,6 +855,7 @@ parse_start_req( cstub_start_req_t * rq, size_t rq_len, child_parms_t * parms,
         case CRQT_RLIMIT_NOFILE: parms->rlimit_nofile = &ptlv->vector; break;
         case CRQT_PATH:          parms->path = &ptlv->vector; break;
         case CRQT_PROG:          parms->prog = &ptlv->vector; break;
+        case CRQT_PERSISTENT:    parms->persistent = &ptlv->vector; break;
         case CRQT_ENVP:  
             parms->envp = 
                 unbuild_varargs_array( parms->envp, &ptlv->vector,
@@ -871,6 +912,659 @@ parse_start_req( cstub_start_req_t * rq, size_t rq_len, child_parms_t * parms,
     return 1;
 }
 
+/*
+ *  persistent workers kept by this second-stage process
+ */
+typedef struct {
+    char *      key;            /* wrapper, script and options; NULL if free */
+    int         fd;             /* our end of the worker's control socket */
+    pid_t       pid;            /* worker pid */
+    uid_t       uid;            /* user the worker and its children run as */
+    int         requests;       /* requests handed to the worker */
+    unsigned    used;           /* when the worker was last used */
+} persistent_worker_t;
+
+static persistent_worker_t * workers = NULL;
+static unsigned              workers_clock = 0;
+static char *                workers_dir = NULL;   /* holds the FIFOs */
+static unsigned              workers_seq = 0;
+
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+/* SIGALRM only needs to interrupt a blocking read() or open() */
+static void
+persistent_timeout( int sig )
+{
+}
+
+/*
+ *  build the key that identifies the workers able to serve a request;
+ *  everything the worker was set up with before exec is part of it
+ */
+static char *
+persistent_key( child_parms_t * parms )
+{
+    const char * parts[9];
+    size_t       len = 0;
+    char *       key;
+    char *       p;
+    int          i;
+
+    parts[0] = parms->persistent;
+    parts[1] = parms->path;
+    parts[2] = parms->user_name;
+    parts[3] = parms->group_name;
+    parts[4] = parms->nice;
+    parts[5] = parms->rlimit_as;
+    parts[6] = parms->rlimit_core;
+    parts[7] = parms->rlimit_cpu;
+    parts[8] = parms->rlimit_nofile;
+
+    for ( i = 0; i < 9; i++ ) {
+        len += (parts[i] ? strlen( parts[i] ) : 0) + 1;
+    }
+
+    key = malloc( len );
+    if ( ! key ) {
+        return NULL;
+    }
+
+    p = key;
+    for ( i = 0; i < 9; i++ ) {
+        if ( parts[i] ) {
+            strcpy( p, parts[i] );
+            p += strlen( parts[i] );
+        }
+        *p++ = '\n';
+    }
+    p[-1] = '\0';
+
+    return key;
+}
+
+/*
+ *  retire a worker; it exits when it sees EOF on its control socket,
+ *  leaving any requests it already started running
+ */
+static void
+persistent_close( persistent_worker_t * w )
+{
+    if ( verbose ) {
+        fprintf( stderr, "%s: retiring persistent worker pid %d after %d requests\n",
+                 myName, (int) w->pid, w->requests );
+    }
+    close( w->fd );
+    free( w->key );
+    w->key = NULL;
+}
+
+/*
+ *  find the worker for key, or a slot for a new one (evicting the least
+ *  recently used worker if all slots are taken)
+ */
+static persistent_worker_t *
+persistent_find( const char * key, int * found )
+{
+    persistent_worker_t * lru = NULL;
+    int                   i;
+
+    if ( ! workers ) {
+        struct sigaction sa;
+        char             dir[] = "/tmp/cgistub.XXXXXX";
+
+        /*
+         *  the FIFOs for worker children go in a directory only we can
+         *  write to; others may reach into it (a worker may run as another
+         *  user) but can't list it or change what's in it
+         */
+        if ( ! mkdtemp( dir ) ) {
+            return NULL;
+        }
+        if ( chmod( dir, 0711 ) || ! ( workers_dir = strdup( dir ))) {
+            rmdir( dir );
+            return NULL;
+        }
+
+        workers = calloc( persistent_workers, sizeof( persistent_worker_t ));
+        if ( ! workers ) {
+            rmdir( workers_dir );
+            free( workers_dir );
+            workers_dir = NULL;
+            return NULL;
+        }
+
+        /* a worker that goes away must not take us with it */
+        memset( &sa, 0, sizeof( sa ));
+        sa.sa_handler = SIG_IGN;
+        sigemptyset( &sa.sa_mask );
+        sigaction( SIGPIPE, &sa, NULL );
+
+        /* no SA_RESTART; timeouts must interrupt blocking calls */
+        sa.sa_handler = persistent_timeout;
+        sigaction( SIGALRM, &sa, NULL );
+    }
+
+    *found = 0;
+    for ( i = 0; i < persistent_workers; i++ ) {
+        persistent_worker_t * w = &workers[i];
+        if ( w->key && ! strcmp( w->key, key )) {
+            *found = 1;
+            return w;
+        }
+        if ( ! lru || ( lru->key && ( ! w->key || w->used < lru->used ))) {
+            lru = w;
+        }
+    }
+
+    if ( lru->key ) {
+        persistent_close( lru );
+    }
+
+    return lru;
+}
+
+/*
+ *  retire all workers and remove the FIFO directory when the server
+ *  disconnects
+ */
+static void
+persistent_cleanup( void )
+{
+    int i;
+
+    if ( ! workers ) {
+        return;
+    }
+    for ( i = 0; i < persistent_workers; i++ ) {
+        if ( workers[i].key ) {
+            persistent_close( &workers[i] );
+        }
+    }
+    free( workers );
+    workers = NULL;
+    rmdir( workers_dir );
+    free( workers_dir );
+    workers_dir = NULL;
+}
+
+/*
+ *  the user child_code will run a worker as
+ */
+static int
+persistent_uid( child_parms_t * parms, uid_t * uid )
+{
+    struct passwd * pw;
+
+    if ( parms->user_name ) {
+        pw = getpwnam( parms->user_name );
+        if ( ! pw ) {
+            return -1;
+        }
+        *uid = pw->pw_uid;
+    } else {
+        *uid = getuid();
+    }
+    return 0;
+}
+
+/*
+ *  start a worker; this forks and execs the wrapper like process_start_req
+ *  would exec the program itself, with a socketpair as its stdin and stdout
+ */
+static crsp_type_e
+persistent_start( child_parms_t * parms, persistent_worker_t * w,
+                  int * rsp_info, int connfd )
+{
+    child_parms_t   wparms;
+    char *          wargv[3];
+    char *          wenvp[2];
+    int             sv[2];
+    int             pip[2];
+    int             childResponse[2];
+    int             count;
+    int             pid;
+    int             i;
+
+    if ( persistent_uid( parms, &w->uid ) ) {
+        *rsp_info = errno;
+        return CRSP_USERFAIL;
+    }
+
+    if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) == -1 ) {
+        *rsp_info = errno;
+        return CRSP_RESOURCE;
+    }
+    if ( pipe( pip ) == -1 ) {
+        *rsp_info = errno;
+        close( sv[0] );
+        close( sv[1] );
+        return CRSP_RESOURCE;
+    }
+    fcntl( sv[0], F_SETFD, FD_CLOEXEC );
+    fcntl( pip[0], F_SETFD, FD_CLOEXEC );
+    fcntl( pip[1], F_SETFD, FD_CLOEXEC );
+
+    /*
+     *  the wrapper gets the script as its only argument and none of the
+     *  request's environment except for PATH; each request brings its own
+     */
+    wargv[0] = parms->persistent;
+    wargv[1] = parms->path;
+    wargv[2] = NULL;
+    wenvp[0] = NULL;
+    wenvp[1] = NULL;
+    for ( i = 0; parms->envp && parms->envp[i]; i++ ) {
+        if ( ! strncmp( parms->envp[i], "PATH=", 5 )) {
+            wenvp[0] = parms->envp[i];
+            break;
+        }
+    }
+
+    wparms = *parms;
+    wparms.path = parms->persistent;
+    wparms.prog = parms->persistent;
+    wparms.script = parms->path;
+    wparms.ch_dir = NULL;
+    wparms.argv = wargv;
+    wparms.envp = wenvp;
+
+    pid = fork();
+    if ( pid == -1 ) {
+        *rsp_info = errno;
+        close( sv[0] );
+        close( sv[1] );
+        close( pip[0] );
+        close( pip[1] );
+        return CRSP_FORKFAIL;
+    } else if ( pid == 0 ) {
+        close( sv[0] );
+        close( pip[0] );
+        close( connfd );
+
+        dup2( sv[1], STDIN_FILENO );
+        dup2( sv[1], STDOUT_FILENO );
+        if ( sv[1] != STDIN_FILENO && sv[1] != STDOUT_FILENO ) {
+            close( sv[1] );
+        }
+
+        SetupCgiSignalDisposition();
+
+        childResponse[0] = child_code( &wparms, &childResponse[1] );
+        write( pip[1], (char *)childResponse, sizeof( childResponse ) );
+        _exit(1);
+    }
+
+    close( sv[1] );
+    close( pip[1] );
+
+    count = read( pip[0], (char *)childResponse, sizeof( childResponse ) );
+    close( pip[0] );
+
+    if ( count > 0 ) {
+        if ( verbose ) {
+            fprintf( stderr, "%s: exec failure on persistent worker pid %d, info %d, code %d\n", 
+                    myName, pid, childResponse[0], childResponse[1] );
+        }
+        waitpid( pid, NULL, 0 );
+        close( sv[0] );
+        *rsp_info = childResponse[1];
+        return childResponse[0];
+    }
+
+    if ( verbose ) {
+        fprintf( stderr, "%s: started persistent worker pid %d for %s\n",
+                 myName, pid, parms->path );
+    }
+
+    w->fd = sv[0];
+    w->pid = pid;
+    w->requests = 0;
+
+    return CRSP_OK;
+}
+
+/*
+ *  write a whole buffer to a worker
+ */
+static int
+persistent_write( int fd, const char * buf, size_t len )
+{
+    while ( len > 0 ) {
+        ssize_t rv = write( fd, buf, len );
+        if ( rv < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( rv <= 0 ) {
+            return -1;
+        }
+        buf += rv;
+        len -= rv;
+    }
+    return 0;
+}
+
+/*
+ *  read a worker's one line answer; this is short and rare enough that
+ *  reading a byte at a time (and not past the line) is fine
+ */
+static int
+persistent_read_line( int fd, char * buf, size_t size )
+{
+    size_t len = 0;
+
+    while ( len < size - 1 ) {
+        ssize_t rv = read( fd, &buf[len], 1 );
+        if ( rv <= 0 ) {
+            return -1;
+        }
+        if ( buf[len] == '\n' ) {
+            break;
+        }
+        len++;
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+/*
+ *  kill a child a worker says it started; the pid comes from the worker,
+ *  which runs script code, so don't use our own privileges to do it
+ */
+static void
+persistent_kill( persistent_worker_t * w, pid_t pid )
+{
+    pid_t killer;
+
+    if ( w->uid == geteuid() ) {
+        kill( pid, SIGKILL );
+        return;
+    }
+
+    killer = fork();
+    if ( killer == 0 ) {
+        if ( setuid( w->uid ) == 0 ) {
+            kill( pid, SIGKILL );
+        }
+        _exit(0);
+    }
+    if ( killer > 0 ) {
+        waitpid( killer, NULL, 0 );
+    }
+}
+
+/*
+ *  open one of the FIFOs we made for a worker's child, making sure it
+ *  still is that FIFO
+ */
+static int
+persistent_open_fifo( persistent_worker_t * w, const char * fifo, int mode )
+{
+    struct stat st;
+    int         fd;
+
+    fd = open( fifo, mode | O_NOFOLLOW );
+    if ( fd == -1 ) {
+        return -1;
+    }
+    if ( fstat( fd, &st ) == -1 ) {
+        close( fd );
+        return -1;
+    }
+    if ( ! S_ISFIFO( st.st_mode ) || st.st_uid != w->uid ) {
+        close( fd );
+        errno = EPERM;
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ *  hand a request to a worker and collect the fds of its child
+ *  returns -1 if the worker has gone away and the request can be retried
+ */
+static int
+persistent_dispatch( persistent_worker_t * w, child_parms_t * parms,
+                     cstub_start_rsp_t * rsp, int * rsp_desc, int * ndesc )
+{
+    static const char * suffix[3] = { ".in", ".out", ".err" };
+    static const int    mode[3] = { O_WRONLY, O_RDONLY, O_RDONLY };
+    char            line[64];
+    char            hdr[32];
+    char            argc[16];
+    char *          record;
+    char *          p;
+    char *          prefix;
+    char *          fifo[3];
+    size_t          len;
+    int             nargs;
+    int             fds[3];
+    int             hdrlen;
+    int             pid;
+    int             err;
+    int             i;
+
+    /*
+     *  make the FIFOs the worker's child will open; they live in our
+     *  directory and belong to the user the child runs as
+     */
+    len = strlen( workers_dir ) + 16;
+    prefix = malloc( 4 * len );
+    if ( ! prefix ) {
+        rsp->crsp_rspinfo = CRSP_RESOURCE;
+        rsp->crsp_errcode = ENOMEM;
+        return 0;
+    }
+    sprintf( prefix, "%s/%u", workers_dir, ++workers_seq );
+    err = 0;
+    for ( i = 0; i < 3; i++ ) {
+        fifo[i] = prefix + (i + 1) * len;
+        sprintf( fifo[i], "%s%s", prefix, suffix[i] );
+        if ( ! err && ( mkfifo( fifo[i], 0600 ) ||
+                        ( w->uid != geteuid() && 
+                          chown( fifo[i], w->uid, (gid_t) -1 )))) {
+            err = errno;
+        }
+    }
+    if ( err ) {
+        for ( i = 0; i < 3; i++ ) {
+            unlink( fifo[i] );
+        }
+        free( prefix );
+        rsp->crsp_rspinfo = CRSP_RESOURCE;
+        rsp->crsp_errcode = err;
+        return 0;
+    }
+
+    /* count argv and size the record */
+    for ( nargs = 0; parms->argv[nargs]; nargs++ )
+        ;
+    sprintf( argc, "%d", nargs );
+
+    len = strlen( prefix ) + 1;
+    len += (parms->ch_dir ? strlen( parms->ch_dir ) : 0) + 1;
+    len += strlen( argc ) + 1;
+    for ( i = 0; i < nargs; i++ ) {
+        len += strlen( parms->argv[i] ) + 1;
+    }
+    for ( i = 0; parms->envp && parms->envp[i]; i++ ) {
+        len += strlen( parms->envp[i] ) + 1;
+    }
+
+    hdrlen = sprintf( hdr, "%lu\n", (unsigned long) len );
+    record = malloc( hdrlen + len );
+    if ( ! record ) {
+        for ( i = 0; i < 3; i++ ) {
+            unlink( fifo[i] );
+        }
+        free( prefix );
+        rsp->crsp_rspinfo = CRSP_RESOURCE;
+        rsp->crsp_errcode = ENOMEM;
+        return 0;
+    }
+
+#define PERSISTENT_ADD(s) \
+        { const char * t = (s); size_t n = strlen( t ) + 1; \
+          memcpy( p, t, n ); p += n; }
+    memcpy( record, hdr, hdrlen );
+    p = record + hdrlen;
+    PERSISTENT_ADD( prefix );
+    PERSISTENT_ADD( parms->ch_dir ? parms->ch_dir : "" );
+    PERSISTENT_ADD( argc );
+    for ( i = 0; i < nargs; i++ ) {
+        PERSISTENT_ADD( parms->argv[i] );
+    }
+    for ( i = 0; parms->envp && parms->envp[i]; i++ ) {
+        PERSISTENT_ADD( parms->envp[i] );
+    }
+#undef PERSISTENT_ADD
+
+    /* send the request and wait for the worker to fork its child */
+    alarm( PERSISTENT_TIMEOUT );
+    err = persistent_write( w->fd, record, hdrlen + len );
+    free( record );
+    if ( err == 0 ) {
+        err = persistent_read_line( w->fd, line, sizeof( line ));
+    }
+    alarm( 0 );
+    if ( err < 0 ) {
+        for ( i = 0; i < 3; i++ ) {
+            unlink( fifo[i] );
+        }
+        free( prefix );
+        return -1;
+    }
+
+    w->used = ++workers_clock;
+    w->requests++;
+
+    pid = strtol( line, &p, 10 );
+    if ( pid <= 0 ) {
+        for ( i = 0; i < 3; i++ ) {
+            unlink( fifo[i] );
+        }
+        free( prefix );
+        rsp->crsp_rspinfo = CRSP_FORKFAIL;
+        rsp->crsp_errcode = atoi( p );
+        return 0;
+    }
+
+    /*
+     *  open the FIFOs in the order the child does; each open completes once
+     *  the child has opened the other end
+     */
+    err = 0;
+    alarm( PERSISTENT_TIMEOUT );
+    for ( i = 0; i < 3; i++ ) {
+        fds[i] = err ? -1 : persistent_open_fifo( w, fifo[i], mode[i] );
+        if ( fds[i] == -1 && ! err ) {
+            err = errno;
+        }
+    }
+    alarm( 0 );
+
+    for ( i = 0; i < 3; i++ ) {
+        unlink( fifo[i] );
+    }
+    free( prefix );
+
+    if ( err ) {
+        if ( verbose ) {
+            fprintf( stderr, "%s: persistent worker pid %d child %d failed to connect (%d)\n",
+                     myName, (int) w->pid, pid, err );
+        }
+        persistent_kill( w, pid );
+        for ( i = 0; i < 3; i++ ) {
+            if ( fds[i] != -1 ) {
+                close( fds[i] );
+            }
+        }
+        rsp->crsp_rspinfo = CRSP_RESOURCE;
+        rsp->crsp_errcode = err;
+        return 0;
+    }
+
+    rsp->crsp_pid = pid;
+    rsp_desc[0] = fds[0];
+    rsp_desc[1] = fds[1];
+    rsp_desc[2] = fds[2];
+    *ndesc = 3;
+
+    if ( verbose ) {
+        fprintf( stderr, "%s: persistent worker pid %d started child pid %d\n",
+                 myName, (int) w->pid, pid );
+    }
+
+    return 0;
+}
+
+/*
+ *  handle a start request with a persistent worker
+ */
+static void
+process_persistent_req( child_parms_t * parms, cstub_start_rsp_t * rsp,
+                        int * rsp_desc, int * ndesc, int connfd )
+{
+    persistent_worker_t * w;
+    crsp_type_e           rc;
+    char *                key;
+    int                   found;
+    int                   info;
+    int                   attempt;
+
+    key = persistent_key( parms );
+    if ( ! key ) {
+        rsp->crsp_rspinfo = CRSP_RESOURCE;
+        rsp->crsp_errcode = ENOMEM;
+        return;
+    }
+
+    w = persistent_find( key, &found );
+    if ( ! w ) {
+        free( key );
+        rsp->crsp_rspinfo = CRSP_RESOURCE;
+        rsp->crsp_errcode = ENOMEM;
+        return;
+    }
+
+    /* an idle worker may have exited; start a fresh one and try once more */
+    for ( attempt = 0; attempt < 2; attempt++ ) {
+        if ( ! found ) {
+            rc = persistent_start( parms, w, &info, connfd );
+            if ( rc != CRSP_OK ) {
+                free( key );
+                rsp->crsp_rspinfo = rc;
+                rsp->crsp_errcode = info;
+                return;
+            }
+            w->key = key;
+            key = NULL;
+            found = 1;
+        }
+
+        if ( persistent_dispatch( w, parms, rsp, rsp_desc, ndesc ) == 0 ) {
+            if ( w->requests >= persistent_requests ) {
+                persistent_close( w );
+            }
+            free( key );
+            return;
+        }
+
+        /* keep the key for the replacement worker */
+        key = w->key;
+        w->key = NULL;
+        close( w->fd );
+        found = 0;
+    }
+
+    free( key );
+    rsp->crsp_rspinfo = CRSP_FORKFAIL;
+    rsp->crsp_errcode = EPIPE;
+}
+
 /*
  *  handle a start request
  */
@@ -911,6 +1605,14 @@ process_start_req( cstub_start_req_t * rq, size_t rq_len,
         return;
     }
 
+    /* run the program through a persistent worker if asked to */
+    if ( parms.persistent && *parms.persistent && ! parms.ch_root &&
+         persistent_workers > 0 ) {
+        process_persistent_req( &parms, rsp, rsp_desc, ndesc, connfd );
+        CLEANUP();
+        return;
+    }
+
     if ( pipe( pin ) == -1 ) {
         rsp->crsp_rspinfo = CRSP_RESOURCE;
         rsp->crsp_errcode = errno;
@@ -1339,6 +2041,8 @@ wait_for_request( int connfd )
                 getpid() );
     }
 
+    persistent_cleanup();
+
     /* Linux seems to be running into problems with the recycling of fds
      * Close the fd ourselves instead of expecting the system to close it
      * for us.
@@ -124,6 +124,37 @@ extern "C" {
  * All this is encoded in the ChildExec and CExecReqPipe classes 
  */
 
+/*
+ * Persistent CGI workers
+ *
+ * A start request that carries a CRQT_PERSISTENT vector asks the 
+ * second-stage process to run the program through a persistent worker 
+ * instead of exec...()ing it.  The vector names a wrapper (for example
+ * cgiworker.pl) that keeps an interpreter warm.  The second-stage 
+ * process starts the wrapper once per program and set of user, group, 
+ * nice and rlimit options, with a socketpair as its stdin and stdout, 
+ * and keeps it for up to persistent_requests requests.  For each request
+ * it creates three FIFOs, <prefix>.in, <prefix>.out and <prefix>.err, in
+ * a directory of its own that only it can write to, gives them to the 
+ * user the worker runs as, and writes
+ *
+ *     <length>\n<prefix>\0<dir>\0<argc>\0<argv[0]>\0...<envp[0]>\0...
+ *
+ * to the worker.  The worker forks a child that opens the FIFOs as stdin,
+ * stdout and stderr (in that order), replaces its environment, umask, cwd
+ * and argv with the request's and runs the script, and answers
+ *
+ *     <pid>\n       or       0 <errno>\n
+ *
+ * The second-stage process opens the FIFOs without following links, makes
+ * sure they are still the FIFOs it made, unlinks them and returns the fds
+ * exactly as it would for a fork/exec'd child.  Nothing the worker says 
+ * is used as a path, as the worker runs script code.  Because each 
+ * request runs in a fresh fork of a worker that never runs scripts 
+ * itself, no state leaks between requests.
+ * Requests that ask for a chroot always use fork/exec.
+ */
+
 /* the default visible name the child stub listener binds */
 #ifndef CSTUB_DEFSOCKNAME
 #define CSTUB_DEFSOCKNAME       "/tmp/.cgistub"     
@@ -180,7 +211,8 @@ typedef enum {
         CRQT_RLIMIT_CORE   = 11,/* setrlimit(RLIMIT_CORE) values */
         CRQT_RLIMIT_CPU    = 12,/* setrlimit(RLIMIT_CPU) values */
         CRQT_RLIMIT_NOFILE = 13,/* setrlimit(RLIMIT_NOFILE) values */
-        CRQT_END        = 14    /* no more (optional) vector */
+        CRQT_END        = 14,   /* no more (optional) vector */
+        CRQT_PERSISTENT = 15    /* persistent worker wrapper path */
 } creq_tlv_type_e;
 
 /* All TLVs start on a TLV_ALIGN offset in a linear buffer */
@@ -1284,6 +1284,7 @@ int ChildExec::buildStartRequest( char *& cPtr, size_t& msgSize,
     int                 len_rlimit_core = 0;
     int                 len_rlimit_cpu = 0;
     int                 len_rlimit_nofile = 0;
+    int                 len_persistent = 0;
 
     cPtr    = NULL;
     msgSize = 0;
@@ -1342,6 +1343,10 @@ int ChildExec::buildStartRequest( char *& cPtr, size_t& msgSize,
         len_rlimit_nofile = strlen( parms.cs_opts.rlimit_nofile ) + 1;
         totlen += ROUND_UP( (len_rlimit_nofile + TLV_VECOFF), TLV_ALIGN );
     }
+    if ( parms.cs_opts.persistent ) {
+        len_persistent = strlen( parms.cs_opts.persistent ) + 1;
+        totlen += ROUND_UP( (len_persistent + TLV_VECOFF), TLV_ALIGN );
+    }
     if ( parms.cs_envargs ) {
         envp_array = cs_build_varargs_array( -1, parms.cs_envargs, &len_envp_ar );
         if (len_envp_ar)
@@ -1416,6 +1421,10 @@ int ChildExec::buildStartRequest( char *& cPtr, size_t& msgSize,
         ptlv += cs_add_tlv_hdr( ptlv, CRQT_RLIMIT_NOFILE, 
                                 len_rlimit_nofile, parms.cs_opts.rlimit_nofile );
     }
+    if ( len_persistent ) {
+        ptlv += cs_add_tlv_hdr( ptlv, CRQT_PERSISTENT, 
+                                len_persistent, parms.cs_opts.persistent );
+    }
     if ( len_envp_ar ) {
         ptlv += cs_add_tlv_hdr( ptlv, CRQT_ENVP, len_envp_ar, envp_array );
         FREE(envp_array);
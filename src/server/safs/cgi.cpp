@@ -1280,6 +1280,7 @@ static int cgi_start_exec(pblock *pb, Session *sn, Request *rq,
     opts.rlimit_core = cgi_get_param("rlimit_core", pb);
     opts.rlimit_cpu = cgi_get_param("rlimit_cpu", pb);
     opts.rlimit_nofile = cgi_get_param("rlimit_nofile", pb);
+    opts.persistent = cgi_get_param("persistent", pb);
 
     // Start the child
     PRStatus rv = child_exec(child, argv, env, &opts, _timeout);
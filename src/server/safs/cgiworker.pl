@@ -0,0 +1,139 @@
+#!/usr/bin/perl
+#
+# DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+#
+# Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+#
+# THE BSD LICENSE
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+# Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# Neither the name of the  nor the names of its contributors may be
+# used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+# OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+# OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+#
+# cgiworker.pl
+#
+# Persistent worker for Perl CGI scripts.  Cgistub starts this once per
+# script (see the send-cgi "persistent" parameter) and hands it requests
+# over stdin; for each one it forks a child that runs the script with the
+# request's stdio, environment, cwd and argv.  The worker compiles the
+# script once, so modules it uses are loaded only once, but never runs it;
+# every request starts from the same clean interpreter.
+#
+
+use strict;
+use POSIX qw(_exit);
+
+my $script = shift @ARGV or die "usage: $0 script\n";
+my ($code, $mtime) = compile_script();
+my $umask = umask;
+
+$SIG{CHLD} = 'IGNORE';
+binmode STDIN;
+binmode STDOUT;
+$| = 1;
+
+while (defined(my $len = <STDIN>)) {
+    chomp $len;
+
+    my $record = '';
+    while (length($record) < $len) {
+        last unless read(STDIN, $record, $len - length($record), length($record));
+    }
+    last if length($record) != $len;
+
+    # fifo prefix, dir, argc, argv[0..argc-1], envp...
+    my @fields = split(/\0/, $record, -1);
+    pop @fields;
+    my $prefix = shift @fields;
+    my $cwd = shift @fields;
+    my $argc = shift @fields;
+    my @args = splice(@fields, 0, $argc);
+    my @env = @fields;
+
+    # pick up edits to the script
+    ($code, $mtime) = compile_script() if (stat($script))[9] != $mtime;
+
+    # Cgistub made these and removes them
+    my @fifos = map { "$prefix.$_" } qw(in out err);
+
+    my $pid = fork;
+    if (!defined $pid) {
+        print "0 ", $! + 0, "\n";
+        next;
+    }
+
+    if ($pid == 0) {
+        # same order as Cgistub opens the other ends
+        open(STDIN, '<', $fifos[0]) or _exit(1);
+        open(STDOUT, '>', $fifos[1]) or _exit(1);
+        open(STDERR, '>', $fifos[2]) or _exit(1);
+        $| = 0;
+
+        $SIG{CHLD} = 'DEFAULT';
+        %ENV = ();
+        foreach (@env) {
+            my ($name, $value) = split(/=/, $_, 2);
+            $ENV{$name} = $value;
+        }
+        umask $umask;
+        chdir $cwd if length $cwd;
+        shift @args;
+        $0 = $script;
+        @ARGV = @args;
+
+        if ($code) {
+            eval { $code->() };
+        } else {
+            do $script;
+        }
+        if ($@) {
+            print STDERR $@;
+            exit 255;
+        }
+        exit 0;
+    }
+
+    print "$pid\n";
+}
+
+# Cgistub closed us; leave running children alone
+exit 0;
+
+# Compile the script into a sub, running its use statements and BEGIN blocks
+# here.  If that fails each request falls back to do FILE, which reports the
+# error to the client's stderr.
+sub compile_script {
+    my $mtime = (stat($script))[9];
+    open(my $fh, '<', $script) or return (undef, $mtime);
+    my $source = '';
+    while (<$fh>) {
+        last if /^__(END|DATA)__\s*$/;
+        $source .= $_;
+    }
+    close($fh);
+    my $code = eval "package main; sub {\n#line 1 \"$script\"\n$source\n}";
+    return ($code, $mtime);
+}
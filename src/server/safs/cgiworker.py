@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+#
+# DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+#
+# Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+#
+# THE BSD LICENSE
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+# Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# Neither the name of the  nor the names of its contributors may be
+# used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+# OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+# OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+#
+# cgiworker.py
+#
+# Persistent worker for Python CGI scripts.  Cgistub starts this once per
+# script (see the send-cgi "persistent" parameter) and hands it requests
+# over stdin; for each one it forks a child that runs the script with the
+# request's stdio, environment, cwd and argv.  The worker compiles the
+# script once but never runs it, so every request starts from the same
+# clean interpreter.
+#
+
+import io
+import os
+import signal
+import sys
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: %s script\n" % sys.argv[0])
+        return 1
+
+    script = sys.argv[1]
+    with open(script, "rb") as f:
+        code = compile(f.read(), script, "exec")
+    mtime = os.stat(script).st_mtime
+
+    umask = os.umask(0)
+    os.umask(umask)
+
+    signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+    ctl = os.fdopen(0, "rb")
+
+    while True:
+        line = ctl.readline()
+        if not line:
+            break
+        length = int(line)
+        record = ctl.read(length)
+        if len(record) != length:
+            break
+
+        # fifo prefix, dir, argc, argv[0..argc-1], envp...
+        fields = record.split(b"\0")[:-1]
+        prefix = fields[0]
+        cwd = fields[1]
+        argc = int(fields[2])
+        args = fields[3:3 + argc]
+        env = fields[3 + argc:]
+
+        # pick up edits to the script
+        try:
+            st = os.stat(script)
+            if st.st_mtime != mtime:
+                with open(script, "rb") as f:
+                    code = compile(f.read(), script, "exec")
+                mtime = st.st_mtime
+        except (OSError, SyntaxError):
+            pass
+
+        # Cgistub made these and removes them
+        fifos = [prefix + b".in", prefix + b".out", prefix + b".err"]
+        try:
+            pid = os.fork()
+        except OSError as e:
+            os.write(1, ("0 %d\n" % e.errno).encode())
+            continue
+
+        if pid == 0:
+            run(code, script, fifos, cwd, args, env, umask)
+
+        os.write(1, ("%d\n" % pid).encode())
+
+    # Cgistub closed us; leave running children alone
+    return 0
+
+def run(code, script, fifos, cwd, args, env, umask):
+    status = 0
+    try:
+        # same order as Cgistub opens the other ends
+        for fd, (fifo, flags) in enumerate(zip(fifos, (os.O_RDONLY, os.O_WRONLY, os.O_WRONLY))):
+            tmp = os.open(fifo, flags)
+            os.dup2(tmp, fd)
+            os.close(tmp)
+        sys.stdin = io.open(0, "r", closefd=False)
+        sys.stdout = io.open(1, "w", closefd=False)
+        sys.stderr = io.open(2, "w", closefd=False)
+
+        signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+        os.environ.clear()
+        for entry in env:
+            name, _, value = entry.decode("latin-1").partition("=")
+            os.environ[name] = value
+        os.umask(umask)
+        if cwd:
+            os.chdir(cwd)
+        sys.argv = [script] + [arg.decode("latin-1") for arg in args[1:]]
+
+        exec(code, {"__name__": "__main__", "__file__": script,
+                    "__builtins__": __builtins__})
+    except SystemExit as e:
+        status = e.code if isinstance(e.code, int) else (e.code is not None)
+    except BaseException:
+        import traceback
+        traceback.print_exc()
+        status = 255
+    try:
+        sys.stdout.flush()
+        sys.stderr.flush()
+    finally:
+        os._exit(status)
+
+if __name__ == "__main__":
+    sys.exit(main())
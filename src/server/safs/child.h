@@ -58,6 +58,7 @@ typedef struct ChildOptions {
     const char *rlimit_core;   /* setrlimit(RLIMIT_CORE) values */
     const char *rlimit_cpu;    /* setrlimit(RLIMIT_CPU) values */
     const char *rlimit_nofile; /* setrlimit(RLIMIT_NOFILE) values */
+    const char *persistent;    /* persistent worker wrapper, NULL to exec */
 } ChildOptions;
 
 /*
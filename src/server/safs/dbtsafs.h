@@ -327,4 +327,5 @@ BEGIN_STR(safs)
     ResDef(DBT_flexLogError4, 396, "HTTP4396: Log file %s should be removed before changing its format (ASCII <--> Binary)")
     ResDef(DBT_flexLogError5, 397, "HTTP4397: Binary log file version mismatch error. Please remove the log file and restart the server" )
     ResDef(DBT_digestTooMany, 398, "HTTP4398: Too many parameters in Digest Authorization header (possibly an attack). Dropping excess parameters. Authentication in progress will fail")
+    ResDef(DBT_indexerror4, 399, "HTTP4399: error watching directories for changes (%s), cached indexes will expire instead")
 END_STR(safs)
@@ -542,6 +542,42 @@ int write_stats_dump(PRFileDesc *fd, StatsHeaderNode *hdr)
         }
     }
 
+    // SSL/TLS session info
+    {
+        StatsSslBucket ssls;
+        memset(&ssls, 0, sizeof(ssls));
+
+        // Accumulate SSL buckets for every process
+        StatsProcessNode *process = hdr->process;
+        while (process) {
+            StatsManagerUtil::accumulateSsl(&ssls,
+                                            &process->procStats.sslBucket);
+            process = process->next;
+        }
+
+        if (ssls.countHandshakes > 0) {
+            PRUint32 resumed = ssls.countCacheResumptions +
+                               ssls.countTicketResumptions;
+            float hitratio = (float)resumed / (float)ssls.countHandshakes;
+
+            PR_fprintf(fd,
+                       "\nSSLSessionInfo:\n"
+                       "------------------\n"
+                       "Handshakes          %lu\n"
+                       "FullHandshakes      %lu\n"
+                       "CacheResumptions    %lu\n"
+                       "TicketResumptions   %lu\n"
+                       "ResumptionRatio     %lu/%lu (%6.2f%%)\n",
+                       ssls.countHandshakes,
+                       ssls.countFullHandshakes,
+                       ssls.countCacheResumptions,
+                       ssls.countTicketResumptions,
+                       resumed,
+                       ssls.countHandshakes,
+                       hitratio * 100.0);
+        }
+    }
+
     // NSAPI Profile Info
     if (hdrStats->maxProfileBuckets) {
         int i;
@@ -652,34 +688,33 @@ int write_stats_dump(PRFileDesc *fd, StatsHeaderNode *hdr)
         for (process = hdr->process; process; process = process->next) {
             StatsThreadNode *thread;
             for (thread = process->thread; thread; thread = thread->next) {
-                thread->lock();
+                StatsThreadSlot threadStats;
+                thread->getThreadStats(&threadStats);
 
-                PRUint32 mode = thread->threadStats.mode;
+                PRUint32 mode = threadStats.mode;
                 if (mode != STATS_THREAD_EMPTY && mode != STATS_THREAD_IDLE &&
                     mode != STATS_THREAD_KEEPALIVE) {
                     rows[y].columns[SESSION_COLUMN_PROCESS].printf("%u", process->procStats.pid);
-                    rows[y].columns[SESSION_COLUMN_STATUS] = StatsManager::getMode(&thread->threadStats);
+                    rows[y].columns[SESSION_COLUMN_STATUS] = StatsManager::getMode(&threadStats);
 
                     char addr[NET_ADDR_STRING_SIZE];
-                    net_addr_to_string(&thread->threadStats.addressClient, addr, sizeof(addr));
+                    net_addr_to_string(&threadStats.addressClient, addr, sizeof(addr));
                     rows[y].columns[SESSION_COLUMN_CLIENT] = addr;
 
-                    rows[y].timeRequestStarted = thread->threadStats.timeRequestStarted;
+                    rows[y].timeRequestStarted = threadStats.timeRequestStarted;
                     if (rows[y].timeRequestStarted != 0) {
                         PRTime microseconds = now - rows[y].timeRequestStarted;
                         int seconds = (microseconds + PR_USEC_PER_SEC/2) / PR_USEC_PER_SEC;
                         rows[y].columns[SESSION_COLUMN_AGE].printf("%d", seconds);
                     }
 
-                    rows[y].columns[SESSION_COLUMN_VS] = thread->threadStats.vsId;
-                    rows[y].columns[SESSION_COLUMN_METHOD] = thread->threadStats.requestBucket.method;
-                    rows[y].columns[SESSION_COLUMN_URI] = thread->threadStats.requestBucket.uri;
-                    rows[y].columns[SESSION_COLUMN_FUNCTION] = STATS_GET_FUNCTION_NAME(&thread->threadStats);
+                    rows[y].columns[SESSION_COLUMN_VS] = threadStats.vsId;
+                    rows[y].columns[SESSION_COLUMN_METHOD] = threadStats.requestBucket.method;
+                    rows[y].columns[SESSION_COLUMN_URI] = threadStats.requestBucket.uri;
+                    rows[y].columns[SESSION_COLUMN_FUNCTION] = STATS_GET_FUNCTION_NAME(&threadStats);
 
                     y++;
                 }
-
-                thread->unlock();
             }
         }
 
@@ -405,8 +405,10 @@ const char *flex_scan_dollar_token(FlexFormat *f, const char *p)
     NSString interpolative(p, len);
 
     FlexToken *t = flex_add_token(f, TOKEN_MODEL);
-    if (t)
+    if (t) {
         t->model = model_str_create(interpolative);
+        model_str_compile(t->model);
+    }
 
     return p + len;
 }
@@ -37,9 +37,11 @@
  * Chris Elving
  */
 
+#include <stddef.h>
 #include "base/net.h"
 #include "base/util.h"
 #include "base/pool.h"
+#include "base/file.h"
 #include "frame/log.h"
 #include "frame/http.h"
 #include "frame/filter.h"
@@ -50,11 +52,30 @@
 #include "safs/headerfooter.h"
 
 
+/*
+ * Header and footer files no larger than this are kept in memory
+ */
+#define HEADERFOOTER_MAX_CACHED_SIZE (64 * 1024)
+
+/*
+ * HeaderFooterContent is the body of a header or footer file.  It's stored
+ * as private data on the file's NSFC entry, so it's discarded along with the
+ * entry when the file changes.
+ */
+typedef struct HeaderFooterContent {
+    int len;
+    char data[1];
+} HeaderFooterContent;
+
 typedef struct HeaderFooter {
     void (*fn)(FilterLayer *layer, char *value);
     char *value;
     PRBool flagCheckSrvhdrs;
     PRBool flagSendHeaderFooter;
+    NSFCCache cache;
+    NSFCEntry entry;
+    const HeaderFooterContent *content;
+    PRInt64 remaining;
 } HeaderFooter;
 
 static FilterInsertFunc header_insert;
@@ -68,6 +89,9 @@ static FilterRemoveFunc footer_remove;
 static const Filter *_header_filter;
 static const Filter *_footer_filter;
 
+static PRCallOnceType headerfooter_cache_once;
+static NSFCPrivDataKey headerfooter_cache_key = NULL;
+
 
 /* ------------------------------ add-header ------------------------------ */
 
@@ -120,12 +144,141 @@ static inline void headerfooter_check_srvhdrs(FilterLayer *layer)
         // The requested URI's Etag doesn't uniquely identify the response
         http_weaken_etag(layer->context->sn, layer->context->rq);
 
-        // The presence of a header/footer mucks up the content-length
-        param_free(pblock_removekey(pb_key_content_length, layer->context->rq->srvhdrs));
+        // The presence of a header/footer mucks up the content-length unless
+        // we know how long the header/footer is
+        pb_param *pp = pblock_removekey(pb_key_content_length, layer->context->rq->srvhdrs);
+        if (pp) {
+            if (headerfooter->content && headerfooter->flagSendHeaderFooter) {
+                PRInt64 cl = util_atoi64(pp->value);
+                if (cl >= 0) {
+                    char buf[UTIL_I64TOA_SIZE];
+                    int len = util_i64toa(cl + headerfooter->content->len, buf);
+                    pblock_kvinsert(pb_key_content_length, buf, len, layer->context->rq->srvhdrs);
+                    headerfooter->remaining = cl;
+                }
+            }
+            param_free(pp);
+        }
     }
 }
 
 
+/* ------------------------ headerfooter_adjust_rv ------------------------ */
+
+static inline int headerfooter_adjust_rv(int rv, int len)
+{
+    // Don't count header/footer bytes against the caller's data
+    if (rv == IO_ERROR)
+        return IO_ERROR;
+    if (rv < len)
+        return 0;
+    return rv - len;
+}
+
+
+/* ----------------------- headerfooter_cache_init ------------------------ */
+
+static void PR_CALLBACK headerfooter_cache_evictor(NSFCCache cache,
+                                                   const char *filename,
+                                                   NSFCPrivDataKey key,
+                                                   void *privateData)
+{
+    PERM_FREE(privateData);
+}
+
+static PRStatus headerfooter_cache_init(void)
+{
+    NSFCCache cache = GetServerFileCache();
+    if (cache)
+        headerfooter_cache_key = NSFC_NewPrivateDataKey(cache, headerfooter_cache_evictor);
+
+    return PR_SUCCESS;
+}
+
+
+/* ----------------------- headerfooter_cache_read ------------------------ */
+
+static HeaderFooterContent *headerfooter_cache_read(const char *path, const NSFCFileInfo *finfo)
+{
+    if (finfo->pr.type != PR_FILE_FILE || finfo->pr.size > HEADERFOOTER_MAX_CACHED_SIZE)
+        return NULL;
+
+    int size = finfo->pr.size;
+
+    HeaderFooterContent *content = (HeaderFooterContent *)
+        PERM_MALLOC(offsetof(HeaderFooterContent, data) + size + 1);
+    if (!content)
+        return NULL;
+
+    SYS_FILE fd = system_fopenRO(path);
+    if (fd == SYS_ERROR_FD) {
+        PERM_FREE(content);
+        return NULL;
+    }
+
+    // Read one byte more than expected so we notice if the file grew
+    int len = 0;
+    int rv;
+    while ((rv = system_fread(fd, content->data + len, size + 1 - len)) > 0)
+        len += rv;
+
+    system_fclose(fd);
+
+    if (rv == IO_ERROR || len != size) {
+        PERM_FREE(content);
+        return NULL;
+    }
+
+    content->len = len;
+
+    return content;
+}
+
+
+/* ----------------------- headerfooter_cache_open ------------------------ */
+
+/*
+ * headerfooter_cache_open: find the cached body of a header/footer file.  On
+ * return headerfooter->content is the body, if it could be cached.  The NSFC
+ * entry is held until headerfooter_remove so the body can't be freed while
+ * it's in use.
+ */
+static void headerfooter_cache_open(HeaderFooter *headerfooter, const char *path)
+{
+    PR_CallOnce(&headerfooter_cache_once, &headerfooter_cache_init);
+    if (!headerfooter_cache_key || !path)
+        return;
+
+    NSFCCache cache = GetServerFileCache();
+    NSFCFileInfo finfo;
+    NSFCStatusInfo si;
+    NSFCStatus rfc = NSFC_AccessFilename(path, &headerfooter->entry, &finfo, cache, &si);
+    if (rfc != NSFC_OK)
+        return;
+    headerfooter->cache = cache;
+
+    HeaderFooterContent *content = NULL;
+    rfc = NSFC_GetEntryPrivateData(headerfooter->entry, headerfooter_cache_key,
+                                   (void **)&content, cache);
+    if (rfc == NSFC_NOTFOUND) {
+        content = headerfooter_cache_read(path, &finfo);
+        if (!content)
+            return;
+
+        rfc = NSFC_SetEntryPrivateData(headerfooter->entry, headerfooter_cache_key, content, cache);
+        if (rfc != NSFC_OK) {
+            // Someone else cached it first or the file changed
+            PERM_FREE(content);
+            return;
+        }
+    } else if (rfc != NSFC_OK) {
+        return;
+    }
+
+    headerfooter->content = content;
+}
+
+
 /* ---------------------- headerfooter_send_absolute ---------------------- */
 
 static void headerfooter_send_absolute(FilterLayer *layer, char *filename)
@@ -137,17 +290,17 @@ static void headerfooter_send_absolute(FilterLayer *layer, char *filename)
 }
 
 
-/* ---------------------- headerfooter_send_relative ---------------------- */
+/* ---------------------- headerfooter_relative_path ---------------------- */
 
-static void headerfooter_send_relative(FilterLayer *layer, char *filename)
+static char *headerfooter_relative_path(FilterLayer *layer, const char *filename)
 {
     const char* ntrans_base;
+    char *path = NULL;
 
     ntrans_base = pblock_findval("ntrans-base", layer->context->rq->vars);
     if (ntrans_base) {
         int ntrans_base_len = strlen(ntrans_base);
         int filename_len = strlen(filename);
-        char *path;
 
         path = (char *)pool_malloc(layer->context->pool, ntrans_base_len + 1 + filename_len + 1);
         if (path) {
@@ -160,14 +313,25 @@ static void headerfooter_send_relative(FilterLayer *layer, char *filename)
                 path[pos++] = '/';
 
             strcpy(&path[pos], filename);
+        }
+    }
 
-            NSFC_TransmitFile(layer->lower, path, NULL, 0, NULL, 0,
-                              PR_INTERVAL_NO_TIMEOUT, 
-                              GetServerFileCache(), 
-                              NULL);
+    return path;
+}
 
-            pool_free(layer->context->pool, path);
-        }
+
+/* ---------------------- headerfooter_send_relative ---------------------- */
+
+static void headerfooter_send_relative(FilterLayer *layer, char *filename)
+{
+    char *path = headerfooter_relative_path(layer, filename);
+    if (path) {
+        NSFC_TransmitFile(layer->lower, path, NULL, 0, NULL, 0,
+                          PR_INTERVAL_NO_TIMEOUT, 
+                          GetServerFileCache(), 
+                          NULL);
+
+        pool_free(layer->context->pool, path);
     }
 }
 
@@ -189,7 +353,11 @@ static inline void headerfooter_send(FilterLayer *layer)
     // Call the header/footer function once per response
     if (headerfooter->flagSendHeaderFooter) {
         headerfooter->flagSendHeaderFooter = PR_FALSE;
-        headerfooter->fn(layer, headerfooter->value);
+        if (headerfooter->content) {
+            net_write(layer->lower, headerfooter->content->data, headerfooter->content->len);
+        } else {
+            headerfooter->fn(layer, headerfooter->value);
+        }
     }
 }
 
@@ -209,13 +377,23 @@ static int headerfooter_insert(FilterLayer *layer, pblock *pb, const char *name)
 
         headerfooter->flagCheckSrvhdrs = PR_TRUE;
         headerfooter->flagSendHeaderFooter = PR_TRUE;
+        headerfooter->cache = NULL;
+        headerfooter->entry = NSFCENTRY_INIT;
+        headerfooter->content = NULL;
+        headerfooter->remaining = -1;
 
         // Populate header/footer context with parameters from pblock
         if ((value = pblock_findval("file", pb)) != NULL) {
             if (util_getboolean(pblock_findval("NSIntAbsFilePath", pb), PR_FALSE)) {
                 headerfooter->fn = &headerfooter_send_absolute;
+                headerfooter_cache_open(headerfooter, value);
             } else {
                 headerfooter->fn = &headerfooter_send_relative;
+                char *path = headerfooter_relative_path(layer, value);
+                if (path) {
+                    headerfooter_cache_open(headerfooter, path);
+                    pool_free(layer->context->pool, path);
+                }
             }
             headerfooter->value = pool_strdup(layer->context->pool, value);
 
@@ -230,9 +408,14 @@ static int headerfooter_insert(FilterLayer *layer, pblock *pb, const char *name)
         }
 
         // We only want to buffer the data if a generatd Content-length header
-        // would be useful
-        if (KEEP_ALIVE(layer->context->rq))
+        // would be useful.  When the header/footer is cached, any
+        // Content-length is adjusted rather than removed, and HTTP/1.1
+        // clients can be sent the rest chunked.
+        if (KEEP_ALIVE(layer->context->rq) &&
+            (!headerfooter->content || layer->context->rq->protv_num < PROTOCOL_VERSION_HTTP11))
+        {
             httpfilter_buffer_output(layer->context->sn, layer->context->rq, PR_TRUE);
+        }
 
         layer->context->data = headerfooter;
     }
@@ -247,6 +430,9 @@ static void headerfooter_remove(FilterLayer *layer)
 {
     HeaderFooter *headerfooter = (HeaderFooter *)layer->context->data;
 
+    if (NSFCENTRY_ISVALID(&headerfooter->entry))
+        NSFC_ReleaseEntry(headerfooter->cache, &headerfooter->entry);
+
     if (headerfooter->value)
         pool_free(layer->context->pool, headerfooter->value);
 
@@ -270,23 +456,46 @@ static void header_remove(FilterLayer *layer)
 }
 
 
-/* ----------------------------- header_write ----------------------------- */
+/* ---------------------------- header_writev ----------------------------- */
 
-static int header_write(FilterLayer *layer, const void *buf, int amount)
+static int header_writev(FilterLayer *layer, const NSAPIIOVec *iov, int iov_size)
 {
+    HeaderFooter *headerfooter = (HeaderFooter *)layer->context->data;
+
     headerfooter_check_srvhdrs(layer);
+
+    // Send a cached header along with the first data
+    if (headerfooter->content && headerfooter->flagSendHeaderFooter) {
+        NSAPIIOVec *hiov = (NSAPIIOVec *)pool_malloc(layer->context->pool, (iov_size + 1) * sizeof(NSAPIIOVec));
+        if (hiov) {
+            headerfooter->flagSendHeaderFooter = PR_FALSE;
+
+            hiov[0].iov_base = (char *)headerfooter->content->data;
+            hiov[0].iov_len = headerfooter->content->len;
+            memcpy(&hiov[1], iov, iov_size * sizeof(NSAPIIOVec));
+
+            int rv = net_writev(layer->lower, hiov, iov_size + 1);
+
+            pool_free(layer->context->pool, hiov);
+
+            return headerfooter_adjust_rv(rv, headerfooter->content->len);
+        }
+    }
+
     headerfooter_send(layer);
-    return net_write(layer->lower, buf, amount);
+    return net_writev(layer->lower, iov, iov_size);
 }
 
 
-/* ---------------------------- header_writev ----------------------------- */
+/* ----------------------------- header_write ----------------------------- */
 
-static int header_writev(FilterLayer *layer, const NSAPIIOVec *iov, int iov_size)
+static int header_write(FilterLayer *layer, const void *buf, int amount)
 {
-    headerfooter_check_srvhdrs(layer);
-    headerfooter_send(layer);
-    return net_writev(layer->lower, iov, iov_size);
+    NSAPIIOVec iov;
+    iov.iov_base = (char *)buf;
+    iov.iov_len = amount;
+
+    return header_writev(layer, &iov, 1);
 }
 
 
@@ -294,7 +503,42 @@ static int header_writev(FilterLayer *layer, const NSAPIIOVec *iov, int iov_size
 
 static int header_sendfile(FilterLayer *layer, sendfiledata *sfd)
 {
+    HeaderFooter *headerfooter = (HeaderFooter *)layer->context->data;
+
     headerfooter_check_srvhdrs(layer);
+
+    // Prepend a cached header to the sendfile headers so the file is still
+    // sent with a single sendfile()
+    if (headerfooter->content && headerfooter->flagSendHeaderFooter) {
+        const HeaderFooterContent *content = headerfooter->content;
+        sendfiledata hsfd = *sfd;
+        char *header = NULL;
+
+        if (sfd->hlen > 0) {
+            header = (char *)pool_malloc(layer->context->pool, content->len + sfd->hlen);
+            if (header) {
+                memcpy(header, content->data, content->len);
+                memcpy(header + content->len, sfd->header, sfd->hlen);
+                hsfd.header = header;
+                hsfd.hlen = content->len + sfd->hlen;
+            }
+        } else {
+            hsfd.header = content->data;
+            hsfd.hlen = content->len;
+        }
+
+        if (hsfd.header != sfd->header) {
+            headerfooter->flagSendHeaderFooter = PR_FALSE;
+
+            int rv = net_sendfile(layer->lower, &hsfd);
+
+            if (header)
+                pool_free(layer->context->pool, header);
+
+            return headerfooter_adjust_rv(rv, content->len);
+        }
+    }
+
     headerfooter_send(layer);
     return net_sendfile(layer->lower, sfd);
 }
@@ -317,12 +561,25 @@ static void footer_remove(FilterLayer *layer)
 }
 
 
-/* ----------------------------- footer_write ----------------------------- */
+/* ---------------------------- footer_is_last ---------------------------- */
 
-static int footer_write(FilterLayer *layer, const void *buf, int amount)
+static inline PRBool footer_is_last(HeaderFooter *headerfooter, PRInt64 amount)
 {
-    headerfooter_check_srvhdrs(layer);
-    return net_write(layer->lower, buf, amount);
+    // When we know how much data precedes the footer, the footer can go out
+    // with the last of it
+    if (!headerfooter->content || !headerfooter->flagSendHeaderFooter)
+        return PR_FALSE;
+    if (headerfooter->remaining < 0)
+        return PR_FALSE;
+
+    headerfooter->remaining -= amount;
+    if (headerfooter->remaining == 0)
+        return PR_TRUE;
+
+    if (headerfooter->remaining < 0)
+        headerfooter->remaining = -1;
+
+    return PR_FALSE;
 }
 
 
@@ -330,16 +587,102 @@ static int footer_write(FilterLayer *layer, const void *buf, int amount)
 
 static int footer_writev(FilterLayer *layer, const NSAPIIOVec *iov, int iov_size)
 {
+    HeaderFooter *headerfooter = (HeaderFooter *)layer->context->data;
+
     headerfooter_check_srvhdrs(layer);
+
+    if (headerfooter->content && headerfooter->remaining > 0) {
+        PRInt64 amount = 0;
+        for (int i = 0; i < iov_size; i++)
+            amount += iov[i].iov_len;
+
+        if (footer_is_last(headerfooter, amount)) {
+            NSAPIIOVec *fiov = (NSAPIIOVec *)pool_malloc(layer->context->pool, (iov_size + 1) * sizeof(NSAPIIOVec));
+            if (fiov) {
+                headerfooter->flagSendHeaderFooter = PR_FALSE;
+
+                memcpy(fiov, iov, iov_size * sizeof(NSAPIIOVec));
+                fiov[iov_size].iov_base = (char *)headerfooter->content->data;
+                fiov[iov_size].iov_len = headerfooter->content->len;
+
+                int rv = net_writev(layer->lower, fiov, iov_size + 1);
+
+                pool_free(layer->context->pool, fiov);
+
+                return headerfooter_adjust_rv(rv, headerfooter->content->len);
+            }
+        }
+    }
+
     return net_writev(layer->lower, iov, iov_size);
 }
 
 
+/* ----------------------------- footer_write ----------------------------- */
+
+static int footer_write(FilterLayer *layer, const void *buf, int amount)
+{
+    NSAPIIOVec iov;
+    iov.iov_base = (char *)buf;
+    iov.iov_len = amount;
+
+    return footer_writev(layer, &iov, 1);
+}
+
+
 /* --------------------------- footer_sendfile ---------------------------- */
 
 static int footer_sendfile(FilterLayer *layer, sendfiledata *sfd)
 {
+    HeaderFooter *headerfooter = (HeaderFooter *)layer->context->data;
+
     headerfooter_check_srvhdrs(layer);
+
+    if (headerfooter->content && headerfooter->remaining > 0) {
+        // A length of 0 means the rest of the file
+        PRInt64 flen = sfd->len;
+        if (flen == 0) {
+            PRFileInfo64 finfo;
+            if (PR_GetOpenFileInfo64(sfd->fd, &finfo) == PR_SUCCESS) {
+                flen = finfo.size - sfd->offset;
+            } else {
+                flen = -1;
+            }
+        }
+
+        // Append a cached footer to the sendfile trailers so the file is
+        // still sent with a single sendfile()
+        if (flen >= 0 && footer_is_last(headerfooter, sfd->hlen + flen + sfd->tlen)) {
+            const HeaderFooterContent *content = headerfooter->content;
+            sendfiledata fsfd = *sfd;
+            char *trailer = NULL;
+
+            if (sfd->tlen > 0) {
+                trailer = (char *)pool_malloc(layer->context->pool, sfd->tlen + content->len);
+                if (trailer) {
+                    memcpy(trailer, sfd->trailer, sfd->tlen);
+                    memcpy(trailer + sfd->tlen, content->data, content->len);
+                    fsfd.trailer = trailer;
+                    fsfd.tlen = sfd->tlen + content->len;
+                }
+            } else {
+                fsfd.trailer = content->data;
+                fsfd.tlen = content->len;
+            }
+
+            if (fsfd.trailer != sfd->trailer) {
+                headerfooter->flagSendHeaderFooter = PR_FALSE;
+
+                int rv = net_sendfile(layer->lower, &fsfd);
+
+                if (trailer)
+                    pool_free(layer->context->pool, trailer);
+
+                return headerfooter_adjust_rv(rv, content->len);
+            }
+        }
+    }
+
     return net_sendfile(layer->lower, sfd);
 }
 
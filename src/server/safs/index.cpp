@@ -50,12 +50,22 @@
 #include "base/cinfo.h"
 #include "base/util.h"
 #include "base/shexp.h"
+#include "time/nstime.h"
+#include "xp/xpatomic.h"
+#include "safs/nsfcsafs.h"
 
 #include <errno.h>
+#include <stddef.h>
 
 #include <sys/stat.h>
 #include "safs/dbtsafs.h"
 
+#if defined(LINUX)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#endif
+
 /* The granularity of our buffer of directory entries. */
 #define NUM_ENTRIES 64
 
@@ -70,6 +80,9 @@ void FREE_AR(char **ar)
 {
     register int x;
 
+    if (!ar)
+        return;
+
     for(x = 0; ar[x]; x++)
         FREE(ar[x]);
     FREE(ar);
@@ -127,12 +140,519 @@ char **_dir_ls(char *path, Session *sn, Request *rq)
 }
 
 
+/* ------------------------ Directory listing cache ----------------------- */
+
+/*
+ * The rows of a listing depend only on the directory contents and the
+ * indexing options, so they are rendered once and kept as NSFC private data
+ * on the cache entry for the directory.  NSFC discards the entry, and with
+ * it the listing, when it notices that the directory mtime has changed.  On
+ * Linux each cached directory is also watched with inotify so that files
+ * being added, removed or rewritten invalidate the listing immediately.
+ * Where no watch could be added a listing is only trusted for the file
+ * cache MaxAge, as changes to the files themselves do not touch the mtime
+ * of the directory.
+ */
+
+#define INDEX_VARIANT_SIMPLE     0
+#define INDEX_VARIANT_COMMON     1
+#define INDEX_VARIANT_COMMON_RAW 2
+#define INDEX_VARIANTS           3
+
+/* Rows of uncached listings are written in chunks of this size */
+#define INDEX_CHUNK_SIZE 16384
+
+/* Listings with more rows than this are streamed and never cached */
+#define INDEX_CACHE_MAXSIZE (1024 * 1024)
+
+struct IndexListing {
+    int gen;          /* cindex_gen the rows were rendered with */
+    time_t expires;   /* 0 if the listing doesn't expire */
+    int len;
+    char rows[1];
+};
+
+struct IndexCacheEntry {
+    IndexListing * volatile listings[INDEX_VARIANTS];
+    int wd;           /* inotify watch descriptor, -1 if not watched */
+};
+
+struct IndexCache {
+    NSFCCache cache;
+    NSFCEntry entry;
+    IndexCacheEntry *ice;
+    IndexListing *listing;
+    int variant;
+    int gen;
+};
+
+struct IndexRows {
+    const char *fn;
+    Session *sn;
+    Request *rq;
+    PRBool caching;
+    char *buf;
+    int len;
+    int size;
+    int bytes;
+};
+
+static PRCallOnceType index_cache_once;
+static NSFCPrivDataKey index_cache_key = NULL;
+
+/* Bumped by cindex_init so listings rendered with old options are dropped */
+static int cindex_gen = 0;
+
+
+#if defined(LINUX)
+
+#define INDEX_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+                          IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | \
+                          IN_DELETE_SELF | IN_MOVE_SELF)
+
+#define INDEX_WATCH_BUCKETS 256
+
+struct IndexWatch {
+    int wd;
+    int refcnt;
+    char *path;
+    IndexWatch *next;
+};
+
+static int index_watch_fd = -1;
+static PRLock *index_watch_lock = NULL;
+static IndexWatch *index_watches[INDEX_WATCH_BUCKETS];
+
+
+static IndexWatch **_index_watch_find(int wd)
+{
+    IndexWatch **pw = &index_watches[(unsigned)wd % INDEX_WATCH_BUCKETS];
+
+    while (*pw && (*pw)->wd != wd)
+        pw = &(*pw)->next;
+
+    return pw;
+}
+
+
+static int _index_watch_add(const char *path)
+{
+    if (index_watch_fd == -1)
+        return -1;
+
+    PR_Lock(index_watch_lock);
+
+    int wd = inotify_add_watch(index_watch_fd, path, INDEX_WATCH_MASK);
+    if (wd != -1) {
+        IndexWatch **pw = _index_watch_find(wd);
+        if (*pw) {
+            (*pw)->refcnt++;
+        } else {
+            IndexWatch *w = (IndexWatch *)PERM_MALLOC(sizeof(*w));
+            if (w) {
+                w->wd = wd;
+                w->refcnt = 1;
+                w->path = PERM_STRDUP(path);
+                w->next = NULL;
+                *pw = w;
+            } else {
+                inotify_rm_watch(index_watch_fd, wd);
+                wd = -1;
+            }
+        }
+    }
+
+    PR_Unlock(index_watch_lock);
+
+    return wd;
+}
+
+
+static void _index_watch_remove(int wd)
+{
+    if (wd == -1)
+        return;
+
+    PR_Lock(index_watch_lock);
+
+    IndexWatch **pw = _index_watch_find(wd);
+    IndexWatch *w = *pw;
+    if (w && --w->refcnt == 0) {
+        *pw = w->next;
+        inotify_rm_watch(index_watch_fd, wd);
+        PERM_FREE(w->path);
+        PERM_FREE(w);
+    }
+
+    PR_Unlock(index_watch_lock);
+}
+
+
+static void _index_watch_invalidate(int wd)
+{
+    char path[PATH_BUF_MAX];
+
+    PR_Lock(index_watch_lock);
+
+    IndexWatch *w = *_index_watch_find(wd);
+    if (w)
+        util_strlcpy(path, w->path, sizeof(path));
+
+    PR_Unlock(index_watch_lock);
+
+    /* The evictor takes index_watch_lock, so don't hold it here */
+    if (w)
+        NSFC_InvalidateFilename(path, GetServerFileCache());
+}
+
+
+static void _index_watch_invalidate_all(void)
+{
+    int *wds = NULL;
+    int n = 0, size = 0;
+
+    PR_Lock(index_watch_lock);
+
+    for (int i = 0; i < INDEX_WATCH_BUCKETS; i++) {
+        for (IndexWatch *w = index_watches[i]; w; w = w->next) {
+            if (n == size) {
+                size += NUM_ENTRIES;
+                wds = (int *)PERM_REALLOC(wds, size * sizeof(int));
+                if (!wds)
+                    break;
+            }
+            wds[n++] = w->wd;
+        }
+    }
+
+    PR_Unlock(index_watch_lock);
+
+    if (wds) {
+        for (int i = 0; i < n; i++)
+            _index_watch_invalidate(wds[i]);
+        PERM_FREE(wds);
+    }
+}
+
+
+static void _index_watch_thread(void *arg)
+{
+    char buf[INDEX_CHUNK_SIZE]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        int rv = read(index_watch_fd, buf, sizeof(buf));
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv <= 0)
+            break;
+
+        /* Events for one directory tend to arrive in bursts */
+        int lastwd = -1;
+        for (char *p = buf; p < buf + rv; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                _index_watch_invalidate_all();
+                lastwd = -1;
+            } else if (!(ev->mask & IN_IGNORED) && ev->wd != lastwd) {
+                _index_watch_invalidate(ev->wd);
+                lastwd = ev->wd;
+            }
+
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    ereport(LOG_FAILURE, XP_GetAdminStr(DBT_indexerror4), system_errmsg());
+
+    /* Listings of watched directories can no longer be trusted */
+    PR_Lock(index_watch_lock);
+    int fd = index_watch_fd;
+    index_watch_fd = -1;
+    PR_Unlock(index_watch_lock);
+
+    _index_watch_invalidate_all();
+    close(fd);
+}
+
+
+static void _index_watch_init(void)
+{
+    index_watch_lock = PR_NewLock();
+    if (!index_watch_lock)
+        return;
+
+    index_watch_fd = inotify_init();
+    if (index_watch_fd == -1)
+        return;
+
+    fcntl(index_watch_fd, F_SETFD, FD_CLOEXEC);
+
+    PRThread *thread = PR_CreateThread(PR_SYSTEM_THREAD,
+                                       _index_watch_thread,
+                                       NULL,
+                                       PR_PRIORITY_NORMAL,
+                                       PR_GLOBAL_THREAD,
+                                       PR_UNJOINABLE_THREAD,
+                                       0);
+    if (!thread) {
+        close(index_watch_fd);
+        index_watch_fd = -1;
+    }
+}
+
+#else
+
+static int _index_watch_add(const char *path)
+{
+    return -1;
+}
+
+static void _index_watch_remove(int wd)
+{
+}
+
+static void _index_watch_init(void)
+{
+}
+
+#endif /* LINUX */
+
+
+static void PR_CALLBACK _index_cache_evictor(NSFCCache cache,
+                                             const char *filename,
+                                             NSFCPrivDataKey key,
+                                             void *privateData)
+{
+    IndexCacheEntry *ice = (IndexCacheEntry *)privateData;
+
+    _index_watch_remove(ice->wd);
+
+    for (int i = 0; i < INDEX_VARIANTS; i++) {
+        if (ice->listings[i])
+            PERM_FREE(ice->listings[i]);
+    }
+    PERM_FREE(ice);
+}
+
+
+static PRStatus _index_cache_init(void)
+{
+    NSFCCache cache = GetServerFileCache();
+    if (cache) {
+        index_cache_key = NSFC_NewPrivateDataKey(cache, _index_cache_evictor);
+        if (index_cache_key)
+            _index_watch_init();
+    }
+
+    return PR_SUCCESS;
+}
+
+
+/*
+ * _index_cache_open: find the cached listing for a directory.  On return
+ * ic->listing is the listing to send, if any, and ic->ice is where a newly
+ * rendered listing can be stored, if anywhere.
+ */
+static void _index_cache_open(IndexCache *ic, const char *path, int variant)
+{
+    ic->cache = NULL;
+    ic->entry = NSFCENTRY_INIT;
+    ic->ice = NULL;
+    ic->listing = NULL;
+    ic->variant = variant;
+    ic->gen = cindex_gen;
+
+    PR_CallOnce(&index_cache_once, &_index_cache_init);
+    if (!index_cache_key || !path)
+        return;
+
+    NSFCCache cache = GetServerFileCache();
+    NSFCFileInfo finfo;
+    NSFCStatusInfo si;
+    NSFCStatus rfc = NSFC_AccessFilename(path, &ic->entry, &finfo, cache, &si);
+    if (rfc != NSFC_OK)
+        return;
+    ic->cache = cache;
+
+    IndexCacheEntry *ice = NULL;
+    rfc = NSFC_GetEntryPrivateData(ic->entry, index_cache_key,
+                                   (void **)&ice, cache);
+    if (rfc == NSFC_NOTFOUND) {
+        ice = (IndexCacheEntry *)PERM_CALLOC(sizeof(*ice));
+        if (!ice)
+            return;
+
+        /* Watch before reading so no change can slip by unnoticed */
+        ice->wd = _index_watch_add(path);
+
+        rfc = NSFC_SetEntryPrivateData(ic->entry, index_cache_key, ice, cache);
+        if (rfc != NSFC_OK) {
+            _index_cache_evictor(cache, path, index_cache_key, ice);
+            return;
+        }
+    } else if (rfc != NSFC_OK) {
+        return;
+    }
+
+    IndexListing *listing = ice->listings[variant];
+    if (listing) {
+        if (listing->gen == ic->gen &&
+            (!listing->expires || ft_time() < listing->expires))
+        {
+            ic->listing = listing;
+        } else {
+            /* Render this one from scratch and start over next time */
+            NSFC_InvalidateFilename(path, cache);
+        }
+        return;
+    }
+
+    ic->ice = ice;
+}
+
+
+static void _index_cache_store(IndexCache *ic, const char *rows, int len)
+{
+    time_t expires = 0;
+
+    if (!ic->ice)
+        return;
+
+    if (ic->ice->wd == -1) {
+        int maxage = GetServerFileCacheMaxAge();
+        if (maxage == 0)
+            return;
+        if (maxage > 0)
+            expires = ft_time() + maxage;
+    }
+
+    IndexListing *listing = (IndexListing *)
+        PERM_MALLOC(offsetof(IndexListing, rows) + len);
+    if (!listing)
+        return;
+
+    listing->gen = ic->gen;
+    listing->expires = expires;
+    listing->len = len;
+    memcpy(listing->rows, rows, len);
+
+    if (XP_AtomicCompareAndSwapPtr(&ic->ice->listings[ic->variant],
+                                   NULL, listing) != NULL)
+    {
+        /* Someone else rendered the same listing first */
+        PERM_FREE(listing);
+    }
+}
+
+
+static void _index_cache_close(IndexCache *ic)
+{
+    if (NSFCENTRY_ISVALID(&ic->entry))
+        NSFC_ReleaseEntry(ic->cache, &ic->entry);
+}
+
+
+static int _index_write(const char *fn, Session *sn, Request *rq,
+                        const char *buf, int len)
+{
+    if (net_write(sn->csd, (char *)buf, len) == IO_ERROR) {
+        if (errno != EPIPE) {
+            log_error(LOG_WARN, (char *)fn, sn, rq,
+                      XP_GetAdminStr(DBT_indexerror2),
+                      system_errmsg());
+        }
+        return IO_ERROR;
+    }
+
+    return 0;
+}
+
+
+/*
+ * The rows of a listing are collected in one buffer so they can be cached.
+ * Once they outgrow INDEX_CACHE_MAXSIZE, or if the listing can't be cached
+ * anyway, they are streamed out in INDEX_CHUNK_SIZE pieces instead.
+ */
+static void _rows_init(IndexRows *rows, const char *fn, Session *sn,
+                       Request *rq, IndexCache *ic)
+{
+    rows->fn = fn;
+    rows->sn = sn;
+    rows->rq = rq;
+    rows->caching = ic->ice ? PR_TRUE : PR_FALSE;
+    rows->buf = NULL;
+    rows->len = 0;
+    rows->size = 0;
+    rows->bytes = 0;
+}
+
+
+static int _rows_flush(IndexRows *rows)
+{
+    if (rows->len) {
+        if (_index_write(rows->fn, rows->sn, rows->rq,
+                         rows->buf, rows->len) == IO_ERROR)
+            return IO_ERROR;
+        rows->len = 0;
+    }
+
+    return 0;
+}
+
+
+static int _rows_add(IndexRows *rows, const char *s, int l)
+{
+    if (rows->caching && rows->len + l > INDEX_CACHE_MAXSIZE)
+        rows->caching = PR_FALSE;
+
+    if (!rows->caching && rows->len + l > INDEX_CHUNK_SIZE) {
+        if (_rows_flush(rows) == IO_ERROR)
+            return IO_ERROR;
+    }
+
+    if (rows->len + l > rows->size) {
+        int size = rows->size ? rows->size * 2 : INDEX_CHUNK_SIZE;
+        if (size < rows->len + l)
+            size = rows->len + l;
+        char *buf = (char *)(rows->buf ? REALLOC(rows->buf, size)
+                                       : MALLOC(size));
+        if (!buf)
+            return IO_ERROR;
+        rows->buf = buf;
+        rows->size = size;
+    }
+
+    memcpy(&rows->buf[rows->len], s, l);
+    rows->len += l;
+    rows->bytes += l;
+
+    return 0;
+}
+
+
+static int _rows_finish(IndexRows *rows, IndexCache *ic)
+{
+    if (rows->caching)
+        _index_cache_store(ic, rows->buf ? rows->buf : "", rows->len);
+
+    int rv = _rows_flush(rows);
+
+    if (rows->buf)
+        FREE(rows->buf);
+    rows->buf = NULL;
+
+    return rv;
+}
+
+
 /* ----------------------------- index_simple ----------------------------- */
 
 
-int index_simple(pblock *pb, Session *sn, Request *rq)
+static int _index_simple(pblock *pb, Session *sn, Request *rq, IndexCache *ic)
 {
-    char **ar;
+    char **ar = NULL;
     int x, l;
     char c, *path = pblock_findval("path", rq->vars);
     char *uri = pblock_findval("uri", rq->reqpb);
@@ -144,7 +664,7 @@ int index_simple(pblock *pb, Session *sn, Request *rq)
 
     char* query = pblock_findval("query", rq->reqpb);
 
-    if(!(ar = _dir_ls(path, sn, rq)))
+    if(!ic->listing && !(ar = _dir_ls(path, sn, rq)))
         return REQ_ABORTED;
 
     httpfilter_buffer_output(sn, rq, PR_TRUE);
@@ -201,25 +721,34 @@ int index_simple(pblock *pb, Session *sn, Request *rq)
         uri[x+1] = c;
     }
 
-    for(x=0; ar[x]; x++) {
-        util_uri_escape(buf2, ar[x]);
-        l = util_snprintf(buf, sizeof(buf), "<li> <A NAME=\"%s\" HREF=\"%s\">%s</A>\n",
-                    buf2, buf2, ar[x]);
+    if(ic->listing) {
+        l = ic->listing->len;
         bytes += l;
-        FREE(ar[x]);
-        if(net_write(sn->csd, buf, l) == IO_ERROR) {
-            if(errno != EPIPE) {
-                log_error(LOG_WARN, "index-simple", sn, rq, 
-                          XP_GetAdminStr(DBT_indexerror2),
-                          system_errmsg());
-            }
+        if(_index_write("index-simple", sn, rq, ic->listing->rows, l) == IO_ERROR)
             return REQ_EXIT;
+    }
+    else {
+        IndexRows rows;
+
+        _rows_init(&rows, "index-simple", sn, rq, ic);
+        for(x=0; ar[x]; x++) {
+            util_uri_escape(buf2, ar[x]);
+            l = util_snprintf(buf, sizeof(buf), "<li> <A NAME=\"%s\" HREF=\"%s\">%s</A>\n",
+                        buf2, buf2, ar[x]);
+            if(_rows_add(&rows, buf, l) == IO_ERROR) {
+                FREE_AR(ar);
+                return REQ_EXIT;
+            }
         }
+        FREE_AR(ar);
+        if(_rows_finish(&rows, ic) == IO_ERROR)
+            return REQ_EXIT;
+        bytes += rows.bytes;
     }
+
     l = util_sprintf(buf, "</ul>\n");
     bytes += l;
 
-    FREE(ar);
     if(net_write(sn->csd, buf, l) == IO_ERROR) {
         if(errno != EPIPE) {
             log_error(LOG_WARN, "index-simple", sn, rq, 
@@ -236,6 +765,20 @@ int index_simple(pblock *pb, Session *sn, Request *rq)
 }
 
 
+int index_simple(pblock *pb, Session *sn, Request *rq)
+{
+    IndexCache ic;
+    int rv;
+
+    _index_cache_open(&ic, pblock_findval("path", rq->vars),
+                      INDEX_VARIANT_SIMPLE);
+    rv = _index_simple(pb, sn, rq, &ic);
+    _index_cache_close(&ic);
+
+    return rv;
+}
+
+
 /* --------------------------- Bloated Indexing --------------------------- */
 
 
@@ -276,6 +819,8 @@ int cindex_init(pblock *pb, Session *sn, Request *rq)
     char *wid = pblock_findval("widths", pb);
     char *t;
 
+    cindex_gen++;
+
     ignore = pblock_findval("ignore", pb);
 
     if ((t = pblock_findval("timezone", pb))) {
@@ -519,10 +1064,14 @@ int _numpad(char *t, int size, int n, char c)
     }
 
 
-int cindex_send(pblock *pb, Session *sn, Request *rq)
+static int _cindex_rows(IndexRows *rows, char *path, char **ar,
+                        PRBool urlencode);
+
+
+static int _cindex_send(pblock *pb, Session *sn, Request *rq, IndexCache *ic)
 {
-    char **ar, *t;
-    register int x, y, stat_good, l;
+    char **ar = NULL, *t;
+    register int x, l;
     char c = 0, *path = pblock_findval("path", rq->vars);
     char *uri = pblock_findval("uri", rq->reqpb);
     char *head = pblock_findval("header", pb);
@@ -532,8 +1081,6 @@ int cindex_send(pblock *pb, Session *sn, Request *rq)
 	
     char buf[PATH_BUF_MAX], buf2[3*PATH_BUF_MAX];
     int bytes;
-    struct stat finfo;
-    cinfo *ci = 0;
     char *query;
 
     /* Check if the urlencoding for file names is disabled */
@@ -542,7 +1089,7 @@ int cindex_send(pblock *pb, Session *sn, Request *rq)
 
     bytes = 0;
 
-    if(!(ar = _dir_ls(path, sn, rq)))
+    if(!ic->listing && !(ar = _dir_ls(path, sn, rq)))
         return REQ_ABORTED;
 
     httpfilter_buffer_output(sn, rq, PR_TRUE);
@@ -613,13 +1160,60 @@ int cindex_send(pblock *pb, Session *sn, Request *rq)
     }
     IDX_WRITE(buf2, l);
 
+    if(ic->listing) {
+        bytes += ic->listing->len;
+        IDX_WRITE(ic->listing->rows, ic->listing->len);
+    }
+    else {
+        IndexRows rows;
+
+        _rows_init(&rows, "index-common", sn, rq, ic);
+        if(_cindex_rows(&rows, path, ar, urlencode) == IO_ERROR) {
+            FREE_AR(ar);
+            return REQ_ABORTED;
+        }
+        FREE_AR(ar);
+        if(_rows_finish(&rows, ic) == IO_ERROR)
+            return REQ_ABORTED;
+        bytes += rows.bytes;
+    }
+
+    bytes += 6;
+    IDX_WRITE("</PRE>", 6);
+
+    if(readme) {
+        if( (l = _insert_readme(path, readme, 1, sn->csd)) == -1)
+            return REQ_EXIT;
+        else 
+            bytes += l;
+    }
+
+    util_itoa(bytes, buf);
+    pblock_nvinsert("content-length", buf, rq->vars);
+
+    return REQ_PROCEED;
+}
+
+
+/*
+ * _cindex_rows: render one row per directory entry.  Everything here ends
+ * up in the cached listing, so it must not depend on the request.
+ */
+static int _cindex_rows(IndexRows *rows, char *path, char **ar,
+                        PRBool urlencode)
+{
+    register int x, y, stat_good, l;
+    char buf[PATH_BUF_MAX], buf2[3*PATH_BUF_MAX];
+    struct stat finfo;
+    cinfo *ci;
+
     for(x=0; ar[x]; x++) {
         char *alt, *icn, fn[PATH_BUF_MAX + sizeof("</A>")];
 
         if(ignore && (!shexp_cmp(ar[x], ignore)))
             continue;
 
-        alt = NULL; icn = NULL;
+        alt = NULL; icn = NULL; ci = NULL;
 
         util_snprintf(fn, sizeof(fn), "%s%s", path, ar[x]);
         stat_good = (stat(fn, &finfo) == -1 ? 0 : 1);
@@ -635,8 +1229,6 @@ int cindex_send(pblock *pb, Session *sn, Request *rq)
         else {
             ci = cinfo_find(ar[x]);
             _set_icon(ci, &icn, &alt);
-            if (ci)
-                FREE(ci);
         }
         util_uri_escape(buf2, ar[x]);
 
@@ -707,25 +1299,28 @@ int cindex_send(pblock *pb, Session *sn, Request *rq)
             buf[l++] = '\n';
         }
     
-        bytes += l;
-        IDX_WRITE(buf, l);
+        if (ci)
+            FREE(ci);
 
-        FREE(ar[x]);
+        if(_rows_add(rows, buf, l) == IO_ERROR)
+            return IO_ERROR;
     }
-    bytes += 6;
-    IDX_WRITE("</PRE>", 6);
 
-    FREE(ar);
+    return 0;
+}
 
-    if(readme) {
-        if( (l = _insert_readme(path, readme, 1, sn->csd)) == -1)
-            return REQ_EXIT;
-        else 
-            bytes += l;
-    }
 
-    util_itoa(bytes, buf);
-    pblock_nvinsert("content-length", buf, rq->vars);
+int cindex_send(pblock *pb, Session *sn, Request *rq)
+{
+    char *str = pblock_findval("urlencoding", pb);
+    IndexCache ic;
+    int rv;
 
-    return REQ_PROCEED;
+    _index_cache_open(&ic, pblock_findval("path", rq->vars),
+                      (str && !strcmp(str, "off")) ? INDEX_VARIANT_COMMON_RAW
+                                                   : INDEX_VARIANT_COMMON);
+    rv = _cindex_send(pb, sn, rq, &ic);
+    _index_cache_close(&ic);
+
+    return rv;
 }
@@ -42,6 +42,7 @@
 #include "safs/nstpsafs.h"
 #include "frame/func.h"
 #include "frame/log.h"
+#include "base/util.h"
 
 NSAPI_PUBLIC int
 nstp_init_saf (pblock *pb, Session *, Request *)
@@ -70,6 +71,7 @@ nstp_init_saf (pblock *pb, Session *, Request *)
 	unsigned minThreads = 0;
 	unsigned queueSize  = 0;
 	unsigned stackSize  = 0;
+	PRBool cpuAffinity  = PR_FALSE;
 
 	const char *val = pblock_findval ("MaxThreads", pb);
 
@@ -91,5 +93,10 @@ nstp_init_saf (pblock *pb, Session *, Request *)
 	if (val != NULL)
 		stackSize  = atoi (val);
 
-	return func_addPool (poolName, minThreads, maxThreads, queueSize, stackSize, poolStart);
+	val = pblock_findval ("CPUAffinity", pb);
+
+	if (val != NULL)
+		cpuAffinity = util_getboolean (val, PR_FALSE);
+
+	return func_addPool2 (poolName, minThreads, maxThreads, queueSize, stackSize, cpuAffinity, poolStart);
 }
@@ -193,25 +193,17 @@ int otype_shtmlhacks(pblock *pb, Session *sn, Request *rq)
 /* ---------------------------- otype_ext2type ---------------------------- */
 
 
-static inline void otype_ciadd(const char *c, pblock *srvhdrs, const pb_key *key)
+static inline void otype_ciadd(const char *c, int len, pblock *srvhdrs, const pb_key *key)
 {
     if (c) {
         if (!pblock_findkey(key, srvhdrs))
-            pblock_kvinsert(key, c, strlen(c), srvhdrs);
-    }
-}
-
-static inline void otype_ciadd(const char *c, pblock *srvhdrs, const char *name)
-{
-    if (c) {
-        if (!pblock_find(name, srvhdrs))
-            pblock_nvinsert(name, c, srvhdrs);
+            pblock_kvinsert(key, c, len, srvhdrs);
     }
 }
 
 NSAPI_PUBLIC int otype_ext2type(pblock *param, Session *sn, Request *rq)
 {
-    cinfo *ci;
+    MimeContentInfo info;
     pb_param *pp;
     char *path = pblock_findkeyval(pb_key_path, rq->vars);
     NSFCFileInfo *finfo = NULL;
@@ -240,18 +232,13 @@ NSAPI_PUBLIC int otype_ext2type(pblock *param, Session *sn, Request *rq)
         }
     }
 
-    // Get content info
+    // Get content info.  The strings belong to the configuration, so there's
+    // nothing to free.
     const VirtualServer* vs = request_get_vs(rq);
-    ci = vs->getMime().getContentInfo(sn->pool, path);
-    if(ci) {
-        otype_ciadd(ci->type, rq->srvhdrs, pb_key_content_type);
-        otype_ciadd(ci->encoding, rq->srvhdrs, "content-encoding");
-        otype_ciadd(ci->language, rq->srvhdrs, "content-language");
-
-        pool_free(sn->pool, ci->type);
-        pool_free(sn->pool, ci->encoding);
-        pool_free(sn->pool, ci->language);
-        pool_free(sn->pool, ci);
+    if(vs->getMime().findContentInfo(path, &info)) {
+        otype_ciadd(info.ci.type, info.typeLen, rq->srvhdrs, pb_key_content_type);
+        otype_ciadd(info.ci.encoding, info.encodingLen, rq->srvhdrs, pb_key_content_encoding);
+        otype_ciadd(info.ci.language, info.languageLen, rq->srvhdrs, pb_key_content_language);
     }
 
     return REQ_PROCEED;
@@ -43,6 +43,7 @@
 #include "httpdaemon/ListenSocketConfig.h"
 #include "httpdaemon/statsmanager.h"
 #include "httpdaemon/statssession.h"
+#include "httpdaemon/statscounters.h"
 #include "support/stringvalue.h"
 #include "support/xmloutput.h"
 #include "safs/perf.h"
@@ -64,7 +65,7 @@ static char dtd[] =
 "          versionMinor CDATA #REQUIRED\n"
 ">\n"
 "\n"
-"<!ELEMENT server (connection-queue*,thread-pool*,profile*,process*,virtual-server*,session-replication?,cpu-info*)>\n"
+"<!ELEMENT server (connection-queue*,thread-pool*,profile*,process*,virtual-server*,session-replication?,cpu-info*,latency*)>\n"
 "<!ATTLIST server\n"
 "          id ID #REQUIRED\n"
 "          versionServer CDATA #REQUIRED\n"
@@ -355,6 +356,19 @@ static char dtd[] =
 "          percentIdle CDATA #REQUIRED\n"
 "          percentUser CDATA #REQUIRED\n"
 "          percentKernel CDATA #REQUIRED\n"
+">\n"
+"\n"
+"<!ELEMENT latency EMPTY>\n"
+"<!ATTLIST latency\n"
+"          type (request|virtual-server|listener|profile) #REQUIRED\n"
+"          id CDATA #IMPLIED\n"
+"          count CDATA #REQUIRED\n"
+"          microsecondsTotal CDATA #REQUIRED\n"
+"          microsecondsP50 CDATA #REQUIRED\n"
+"          microsecondsP90 CDATA #REQUIRED\n"
+"          microsecondsP99 CDATA #REQUIRED\n"
+"          microsecondsP999 CDATA #REQUIRED\n"
+"          microsecondsMax CDATA #REQUIRED\n"
 ">\n";
 
 //-----------------------------------------------------------------------------
@@ -665,6 +679,64 @@ static void outputCpuInfos(XMLOutput &xml, PList_t qlist, StatsHeaderNode *heade
 #endif
 }
 
+//-----------------------------------------------------------------------------
+// outputLatency
+//-----------------------------------------------------------------------------
+
+static void outputLatency(XMLOutput &xml, const char *type, const char *id, const StatsHistogram *histogram)
+{
+    xml.beginElement("latency");
+    xml.attribute("type", type);
+    if (id)
+        xml.attribute("id", id);
+    xml.attribute("count", StatsCounters::getHistogramCount(histogram));
+    xml.attribute("microsecondsTotal", histogram->microsecondsTotal);
+    xml.attribute("microsecondsP50", StatsCounters::getHistogramPercentile(histogram, 0.5));
+    xml.attribute("microsecondsP90", StatsCounters::getHistogramPercentile(histogram, 0.9));
+    xml.attribute("microsecondsP99", StatsCounters::getHistogramPercentile(histogram, 0.99));
+    xml.attribute("microsecondsP999", StatsCounters::getHistogramPercentile(histogram, 0.999));
+    xml.attribute("microsecondsMax", histogram->microsecondsMax);
+    xml.endElement("latency");
+}
+
+//-----------------------------------------------------------------------------
+// outputLatencies
+//-----------------------------------------------------------------------------
+
+static void outputLatencies(XMLOutput &xml, PList_t qlist)
+{
+    if (!isEnabled(qlist, "latency"))
+        return;
+
+    if (!StatsCounters::isInitialized())
+        return;
+
+    StatsHistogram histogram;
+
+    StatsCounters::snapshotRequestHistogram(&histogram);
+    outputLatency(xml, "request", NULL, &histogram);
+
+    int i;
+    for (i = 0; i < STATS_HISTOGRAM_NAMED_SLOTS; i++) {
+        StatsHistogramType type;
+        const char *id;
+        if (StatsCounters::snapshotNamedHistogram(i, &type, &id, &histogram)) {
+            outputLatency(xml,
+                          (type == STATS_HISTOGRAM_LISTENER) ? "listener" : "virtual-server",
+                          id, &histogram);
+        }
+    }
+
+    int countProfileHistograms = StatsCounters::getProfileHistogramCount();
+    for (i = 0; i < countProfileHistograms; i++) {
+        const char *name = StatsManager::getProfileBucketName(i);
+        if (!name)
+            continue;
+        StatsCounters::snapshotProfileHistogram(i, &histogram);
+        outputLatency(xml, "profile", name, &histogram);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // outputVirtualServers
 //-----------------------------------------------------------------------------
@@ -806,9 +878,10 @@ static void outputThreads(XMLOutput &xml, PList_t qlist, const Configuration *co
     StatsThreadNode *threadNode;
     threadNode = process->thread;
     while (threadNode) {
-        threadNode->lock();
+        StatsThreadSlot threadStats;
+        threadNode->getThreadStats(&threadStats);
 
-        StatsThreadSlot* thread = &threadNode->threadStats;
+        StatsThreadSlot* thread = &threadStats;
         if (thread->mode != STATS_THREAD_EMPTY) {
             xml.beginElement("thread");
             xml.attribute("mode", StatsManager::getMode(thread));
@@ -832,8 +905,6 @@ static void outputThreads(XMLOutput &xml, PList_t qlist, const Configuration *co
             xml.endElement("thread");
         }
 
-        threadNode->unlock();
-
         threadNode = threadNode->next;
     }
 }
@@ -919,6 +990,27 @@ static void outputDnsBucket(XMLOutput &xml, PList_t qlist, StatsProcessNode *pro
     xml.endElement("dns-bucket");
 }
 
+//-----------------------------------------------------------------------------
+// outputSslBucket
+//-----------------------------------------------------------------------------
+
+static void outputSslBucket(XMLOutput &xml, PList_t qlist, StatsProcessNode *process)
+{
+    if (!isEnabled(qlist, "ssl-bucket"))
+        return;
+
+    StatsSslBucket *ssl = &process->procStats.sslBucket;
+    xml.beginElement("ssl-bucket");
+    xml.attribute("flagCacheEnabled", ssl->flagCacheEnabled);
+    xml.attribute("flagTicketsSupported", ssl->flagTicketsSupported);
+    xml.attribute("countHandshakes", ssl->countHandshakes);
+    xml.attribute("countFullHandshakes", ssl->countFullHandshakes);
+    xml.attribute("countCacheResumptions", ssl->countCacheResumptions);
+    xml.attribute("countTicketResumptions", ssl->countTicketResumptions);
+    xml.attribute("countCacheMisses", ssl->countCacheMisses);
+    xml.endElement("ssl-bucket");
+}
+
 //-----------------------------------------------------------------------------
 // outputThreadPoolBuckets
 //-----------------------------------------------------------------------------
@@ -1084,6 +1176,8 @@ static void outputProcesses(XMLOutput &xml, PList_t qlist, const Configuration *
 
             outputDnsBucket(xml, qlist, processNode);
 
+            outputSslBucket(xml, qlist, processNode);
+
             outputKeepAliveBucket(xml, qlist, processNode);
 
             outputCacheBucket(xml, qlist, processNode);
@@ -1225,6 +1319,8 @@ static void outputServer(XMLOutput &xml, PList_t qlist, const Configuration *con
 
     outputCpuInfos(xml, qlist, headerNode);
 
+    outputLatencies(xml, qlist);
+
     xml.endElement("server");
 }
 
@@ -1294,6 +1390,32 @@ int stats_xml(pblock *pb, Session *sn, Request *rq)
     return REQ_PROCEED;
 }
 
+//-----------------------------------------------------------------------------
+// stats_prometheus (stats-prometheus Service SAF)
+//-----------------------------------------------------------------------------
+
+int stats_prometheus(pblock *pb, Session *sn, Request *rq)
+{
+    // The counters live in memory shared by every process, so any process
+    // can report on the whole server without locking or messaging
+    if (!StatsCounters::isInitialized()) {
+        protocol_status(sn, rq, PROTOCOL_NOT_FOUND, NULL);
+        return REQ_ABORTED;
+    }
+
+    param_free(pblock_remove("content-type", rq->srvhdrs));
+    pblock_nvinsert("content-type", "text/plain; version=0.0.4", rq->srvhdrs);
+    httpfilter_buffer_output(sn, rq, PR_TRUE);
+    protocol_status(sn, rq, PROTOCOL_OK, NULL);
+    if (protocol_start_response(sn, rq) == REQ_NOACTION)
+        return REQ_PROCEED;
+
+    if (StatsCounters::writePrometheus(sn->csd) < 0)
+        return REQ_EXIT;
+
+    return REQ_PROCEED;
+}
+
 //-----------------------------------------------------------------------------
 // write_stats_dtd
 //-----------------------------------------------------------------------------
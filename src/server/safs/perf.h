@@ -47,6 +47,7 @@ NSPR_BEGIN_EXTERN_C
 Func perf_init;
 Func perf_define_bucket;
 Func stats_xml;
+Func stats_prometheus;
 
 NSAPI_PUBLIC int write_stats_dtd(PRFileDesc *fd);
 NSAPI_PUBLIC int write_stats_xml(PRFileDesc *fd, void *hdr, PList_t qlist);
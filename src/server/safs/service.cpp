@@ -54,12 +54,18 @@
 #include "frame/httpfilter.h"
 #include "plstr.h"
 #include "safs/nsfcsafs.h"
+#include "private/pprio.h"
 #include "httpdaemon/configurationmanager.h"
 #include "httpdaemon/configuration.h"
 #include "httpdaemon/ListenSocketConfig.h"
 
 #include <errno.h>
 #include <limits.h>
+#ifdef XP_UNIX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
 
 #define TRAILER_MAX_LEN 512
 #define TRAILER_LASTMOD ":LASTMOD:"
@@ -286,16 +292,162 @@ static int _range_send(SYS_FILE fd, SYS_NETFD sd, PROffset64 rstart, PROffset64
   return IO_OKAY;
 }
 
-static int _range_service(Session *sn, Request *rq, const char *path, PRFileInfo64 *finfo, const char *range)
+/*
+ * _range_layout lays out the body of a 206 response as a list of segments,
+ * each a block of part headers followed by a slice of the file, and computes
+ * its exact length.  All the part headers are formatted into a single buffer
+ * up front.  A multipart body ends with a segment that carries only the
+ * closing boundary.  Returns the number of segments.
+ */
+static int _range_layout(Session *sn, Request *rq, _range_element *head,
+                         int num_ranges, const PRFileInfo64 *finfo,
+                         const char *doc_type, const char *sep, int seplen,
+                         NSFCRange **segments, PRInt64 *content_length)
+{
+    _range_element *curr_head;
+    int nsegments = (num_ranges > 1) ? num_ranges + 1 : 1;
+    NSFCRange *r = (NSFCRange *) pool_malloc(sn->pool, nsegments * sizeof(NSFCRange));
+    PRInt64 cl = 0;
+    int i;
+
+    if (num_ranges == 1) {
+        r[0].header = NULL;
+        r[0].hdrlen = 0;
+        r[0].offset = head->start;
+        r[0].length = head->end - head->start + 1;
+        *segments = r;
+        *content_length = r[0].length;
+        return 1;
+    }
+
+    int doclen = doc_type ? strlen(doc_type) : 0;
+    int partsz = num_ranges * (seplen + doclen + 128) + seplen + 4;
+    char *parts = (char *) pool_malloc(sn->pool, partsz);
+    int l = 0;
+
+    for (i = 0, curr_head = head; curr_head; i++, curr_head = curr_head->next) {
+        int pos = l;
+        memcpy(parts + l, sep, seplen);
+        l += seplen;
+        if (doc_type) {
+            l += util_snprintf(parts + l, partsz - l,
+                               "\r\nContent-type: %s", doc_type);
+        }
+        l += util_snprintf(parts + l, partsz - l,
+                           "\r\n%s: bytes %lld-%lld/%lld\r\n\r\n",
+                           rq->protv_num >= 101 ? "Content-range" : "Range",
+                           curr_head->start,
+                           curr_head->end,
+                           finfo->size);
+        r[i].header = parts + pos;
+        r[i].hdrlen = l - pos;
+        r[i].offset = curr_head->start;
+        r[i].length = curr_head->end - curr_head->start + 1;
+        cl += r[i].hdrlen + r[i].length;
+    }
+    PR_ASSERT(i == num_ranges);
+
+    memcpy(parts + l, sep, seplen);
+    memcpy(parts + l + seplen, "--\r\n", 4);
+    r[i].header = parts + l;
+    r[i].hdrlen = seplen + 4;
+    r[i].offset = 0;
+    r[i].length = 0;
+    cl += r[i].hdrlen;
+    l += r[i].hdrlen;
+    PR_ASSERT(l <= partsz);
+
+    *segments = r;
+    *content_length = cl;
+
+    return nsegments;
+}
+
+/*
+ * _range_cork asks the TCP stack to hold back partial frames while the
+ * segments of a multipart response are written so that part headers and
+ * file data are coalesced into full-sized packets.  Clearing the cork
+ * flushes anything still pending.
+ */
+static void _range_cork(SYS_NETFD sd, int on)
+{
+#if defined(XP_UNIX) && (defined(TCP_CORK) || defined(TCP_NOPUSH))
+    PRFileDesc *bottom = PR_GetIdentitiesLayer(sd, PR_NSPR_IO_LAYER);
+    if (bottom) {
+        int osfd = PR_FileDesc2NativeHandle(bottom);
+#ifdef TCP_CORK
+        setsockopt(osfd, IPPROTO_TCP, TCP_CORK, (char *)&on, sizeof(on));
+#else
+        setsockopt(osfd, IPPROTO_TCP, TCP_NOPUSH, (char *)&on, sizeof(on));
+#endif
+    }
+#endif
+}
+
+/*
+ * _range_transmit sends the segments laid out by _range_layout.  Each
+ * segment's part headers go out with its file slice in a single sendfile
+ * call.  Returns IO_OKAY or IO_ERROR.
+ */
+static int _range_transmit(Session *sn, Request *rq, SYS_FILE fd,
+                           NSFCEntry entry, NSFCCache nsfcCache,
+                           const NSFCRange *segments, int nsegments)
+{
+    int i;
+
+    if (entry != NSFCENTRY_INIT) {
+        NSFCStatusInfo statusInfo;
+        NSFCSTATUSINFO_INIT(&statusInfo);
+        if (NSFC_TransmitEntryRanges(sn->csd, entry, segments, nsegments,
+                                     PR_INTERVAL_NO_TIMEOUT, nsfcCache,
+                                     &statusInfo) < 0)
+            return IO_ERROR;
+        return IO_OKAY;
+    }
+
+    for (i = 0; i < nsegments; i++) {
+        const NSFCRange *s = &segments[i];
+        if (s->length == 0) {
+            if (net_write(sn->csd, s->header, s->hdrlen) == IO_ERROR)
+                return IO_ERROR;
+        } else if ((PRUint64) (s->offset + s->length) == (size_t) (s->offset + s->length)) {
+            sendfiledata sfd;
+            sfd.fd = fd;
+            sfd.offset = s->offset;
+            sfd.len = s->length;
+            sfd.header = s->header;
+            sfd.hlen = s->hdrlen;
+            sfd.trailer = NULL;
+            sfd.tlen = 0;
+            if (net_sendfile(sn->csd, &sfd) == IO_ERROR)
+                return IO_ERROR;
+        } else {
+            // The range lies beyond what sendfile can address
+            if (s->hdrlen && net_write(sn->csd, s->header, s->hdrlen) == IO_ERROR)
+                return IO_ERROR;
+            if (_range_send(fd, sn->csd, s->offset, s->offset + s->length - 1,
+                            s->length) == IO_ERROR)
+                return IO_ERROR;
+        }
+    }
+
+    return IO_OKAY;
+}
+
+static int _range_service(Session *sn, Request *rq, const char *path,
+                          PRFileInfo64 *finfo, const char *range,
+                          NSFCEntry entry, NSFCCache nsfcCache)
 {
     char sep[128];
     char numstr[UTIL_I64TOA_SIZE];
     char hdr[256];
-    char *ums;
-    int l, seplen = 0, num_ranges, parse_status=0;
+    int seplen = 0, num_ranges, parse_status=0;
     pb_param *doc_type;
-    SYS_FILE fd;
-    _range_element *head = NULL, *curr_head = NULL;
+    SYS_FILE fd = SYS_ERROR_FD;
+    _range_element *head = NULL;
+    NSFCRange *segments;
+    int nsegments;
+    PRInt64 content_length;
 
     if (strncmp(range, "bytes=", 6))
         return REQ_NOACTION;
@@ -324,7 +476,6 @@ static int _range_service(Session *sn, Request *rq, const char *path, PRFileInfo
     if(!(pblock_find("status", rq->srvhdrs)))
         protocol_status(sn, rq, PROTOCOL_PARTIAL_CONTENT, NULL);
 
-    /* Set content-length only if there's one range. */
     param_free(pblock_remove("content-length", rq->srvhdrs));
 
     PR_ASSERT(num_ranges >= 1);
@@ -339,70 +490,52 @@ static int _range_service(Session *sn, Request *rq, const char *path, PRFileInfo
             util_sprintf(hdr, "multipart/x-byteranges; boundary=%s", &sep[4]);
         }
         pblock_nvinsert("content-type", hdr, rq->srvhdrs);
-        util_sprintf(&sep[seplen], "%c%c", CR, LF);
-        seplen += 2;
     }
     else {
-        util_i64toa(head->end - head->start + 1, numstr);
-        pblock_nvinsert("content-length", numstr, rq->srvhdrs);
         util_sprintf(hdr, "bytes %lld-%lld/%lld", head->start, head->end, finfo->size);
         pblock_nvinsert("content-range", hdr, rq->srvhdrs);
         doc_type = NULL;
     }
-    if((fd = system_fopenRO(path)) == SYS_ERROR_FD) {
-        log_error(LOG_WARN, "send-file", sn, rq, XP_GetAdminStr(DBT_serviceError3), 
-                  path, system_errmsg());
-        protocol_status(sn, rq, (rtfile_notfound() ? PROTOCOL_NOT_FOUND : 
-                                 PROTOCOL_FORBIDDEN), NULL);
-        _ranges_free(head);
-        return REQ_ABORTED;
-    }
-    if(protocol_start_response(sn,rq) != REQ_NOACTION) {
-        curr_head = head;
-        while(curr_head != NULL) {
-            if(num_ranges > 1) {
-                net_write(sn->csd, sep, seplen);
-                l = 0;
-                if (doc_type) {
-                    l += util_snprintf(hdr + l, sizeof(hdr) - l,
-                                       "Content-type: %s\n",
-                                       doc_type->value);
-                }
-                if (rq->protv_num >= 101) {
-                    l += util_snprintf(hdr + l, sizeof(hdr) - l,
-                                       "Content-range: bytes %lld-%lld/%lld\n\n",
-                                       curr_head->start, 
-                                       curr_head->end, 
-                                       finfo->size);
-                }
-                else {
-                    l += util_snprintf(hdr + l, sizeof(hdr) - l,
-                                       "Range: bytes %lld-%lld/%lld\n\n",
-                                       curr_head->start, 
-                                       curr_head->end, 
-                                       finfo->size);
-                }
-                net_write(sn->csd, hdr, l);
-            }
-            if(_range_send(fd, sn->csd, curr_head->start, curr_head->end,
-                           (curr_head->end - curr_head->start + 1)) == IO_ERROR) {
-                system_fclose(fd);
-                param_free(doc_type);
-                _ranges_free(head);
-                return REQ_EXIT;
-            }
-            curr_head = curr_head->next;
+
+    // Work out the whole body up front so even a multipart response carries
+    // an exact Content-length
+    nsegments = _range_layout(sn, rq, head, num_ranges, finfo,
+                              doc_type ? doc_type->value : NULL, sep, seplen,
+                              &segments, &content_length);
+    util_i64toa(content_length, numstr);
+    pblock_nvinsert("content-length", numstr, rq->srvhdrs);
+
+    param_free(doc_type);
+    _ranges_free(head);
+
+    // Send from the file cache entry if we have one, otherwise open the file
+    if (entry != NSFCENTRY_INIT && nsegments > NSFC_MAX_RANGES)
+        entry = NSFCENTRY_INIT;
+    if (entry == NSFCENTRY_INIT) {
+        if((fd = system_fopenRO(path)) == SYS_ERROR_FD) {
+            log_error(LOG_WARN, "send-file", sn, rq, XP_GetAdminStr(DBT_serviceError3), 
+                      path, system_errmsg());
+            protocol_status(sn, rq, (rtfile_notfound() ? PROTOCOL_NOT_FOUND : 
+                                     PROTOCOL_FORBIDDEN), NULL);
+            return REQ_ABORTED;
         }
     }
-    if(num_ranges > 1) {
-        util_sprintf(&sep[seplen-2], "--%c%c", CR, LF);
-        seplen += 2;
-        net_write(sn->csd, sep, seplen);
+
+    int res = REQ_PROCEED;
+    if(protocol_start_response(sn,rq) != REQ_NOACTION) {
+        if (nsegments > 1)
+            _range_cork(sn->csd, 1);
+        if (_range_transmit(sn, rq, fd, entry, nsfcCache,
+                            segments, nsegments) == IO_ERROR)
+            res = REQ_EXIT;
+        if (nsegments > 1)
+            _range_cork(sn->csd, 0);
     }
-    system_fclose(fd);
-    param_free(doc_type);
-    _ranges_free(head);
-    return REQ_PROCEED;
+
+    if (fd != SYS_ERROR_FD)
+        system_fclose(fd);
+
+    return res;
 }
 
 int service_plain_range(pblock *param, Session *sn, Request *rq)
@@ -430,7 +563,8 @@ int service_plain_range(pblock *param, Session *sn, Request *rq)
         return REQ_ABORTED;
     }
 
-    return _range_service(sn, rq, path, &finfo, range);
+    return _range_service(sn, rq, path, &finfo, range,
+                          NSFCENTRY_INIT, NULL);
 }
 
 
@@ -526,7 +660,16 @@ int service_plain_file(pblock *param, Session *sn, Request *rq)
 
     const char *range = pblock_findkeyval(pb_key_range, rq->headers);
     if (range) {
-        ret = _range_service(sn, rq, path, &finfo->pr, range);
+        // Ignore Range: if the client's copy is out of date
+        const char *if_range = pblock_findkeyval(pb_key_if_range, rq->headers);
+        if (if_range && !http_match_if_range(if_range,
+                                             pblock_findkeyval(pb_key_etag, rq->srvhdrs),
+                                             pblock_findkeyval(pb_key_last_modified, rq->srvhdrs)))
+            range = NULL;
+    }
+    if (range) {
+        ret = _range_service(sn, rq, path, &finfo->pr, range,
+                             entry, nsfcCache);
         if (ret != REQ_NOACTION) {
             if (NSFCENTRY_ISVALID(&entry))
                 NSFC_ReleaseEntry(nsfcCache, &entry);
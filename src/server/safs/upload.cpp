@@ -57,6 +57,11 @@
 
 #include "safs/nsfcsafs.h"
 
+#if defined(LINUX)
+#include <fcntl.h>
+#include "private/pprio.h"
+#endif
+
 #define UPLOAD_METHOD "PUT"
 #define RENAME_METHOD "MOVE"
 #define INDEX_METHOD "INDEX"
@@ -90,10 +95,11 @@ static void _insertContentLength(Request& rq, int len);
 /* This is netbuf_buf2sd with net_write replaced with system_fwrite.
    It also is designed to swallow any remaining data if the writes fail.
  */
-int 
-_netbuf_buf2fd(netbuf *buf, SYS_FILE fd, int len)
+PRInt64 
+_netbuf_buf2fd(netbuf *buf, SYS_FILE fd, PRInt64 len)
 {
-    register int n = len, t, ns;
+    register PRInt64 n = len, ns;
+    register int t;
     int write_error = 0;
     int bytes_written;
 
@@ -126,7 +132,7 @@ _netbuf_buf2fd(netbuf *buf, SYS_FILE fd, int len)
 
     while(1) {
         if(n != -1)
-            t = (n < buf->maxsize ? n : buf->maxsize);
+            t = (n < buf->maxsize ? (int)n : buf->maxsize);
 
         switch(netbuf_grab(buf, t)) {
           case IO_ERROR:
@@ -160,6 +166,75 @@ _netbuf_buf2fd(netbuf *buf, SYS_FILE fd, int len)
 }
 
 
+/* Like _netbuf_buf2fd, but splices the body from the socket into the file.
+   Only used when httpfilter_can_splice_request_body says it's possible.
+ */
+static PRInt64
+_netbuf_splice2fd(netbuf *buf, Session *sn, Request *rq, SYS_FILE fd, PRInt64 len)
+{
+    PRInt64 ns = 0;
+    int t;
+
+    /* First, flush the current buffer */
+    t = buf->cursize - buf->pos;
+    if(t > len)
+        t = (int)len;
+    if(t) {
+        if(system_fwrite(fd, (char *)&buf->inbuf[buf->pos], t) == IO_ERROR) {
+            buf->errmsg = system_errmsg();
+            /* Swallow the rest */
+            _netbuf_buf2fd(buf, SYS_ERROR_FD, len);
+            return IO_ERROR;
+        }
+        buf->pos += t;
+        ns += t;
+    }
+
+    while(ns < len) {
+        PRInt64 rv = httpfilter_splice_request_body(sn, rq, (PRFileDesc *)fd, len - ns);
+        if(rv < 1) {
+            if(rv == 0)
+                buf->errmsg = "premature EOF";
+            else
+                buf->errmsg = system_errmsg();
+            return IO_ERROR;
+        }
+        ns += rv;
+    }
+
+    return ns;
+}
+
+
+/* Reserve space for an upload of known size so the file is laid out in one
+   piece and a full disk is noticed before the body is read */
+static void
+_upload_preallocate(SYS_FILE fd, PRInt64 len)
+{
+#if defined(LINUX)
+    if(len > 0)
+        fallocate(PR_FileDesc2NativeHandle((PRFileDesc *)fd),
+                  FALLOC_FL_KEEP_SIZE, 0, len);
+#endif
+}
+
+
+/* Give back the space _upload_preallocate reserved beyond what was actually
+   written when an upload fails or comes up short */
+static void
+_upload_release(SYS_FILE fd, PRInt64 len)
+{
+#if defined(LINUX)
+    if(len > 0) {
+        int nfd = PR_FileDesc2NativeHandle((PRFileDesc *)fd);
+        off_t written = lseek(nfd, 0, SEEK_CUR);
+        if(written != -1)
+            ftruncate(nfd, written);
+    }
+#endif
+}
+
+
 /* ----------------------------- upload_file ------------------------------ */
 
 
@@ -169,14 +244,15 @@ upload_file(pblock *pb, Session *sn, Request *rq)
     char *t, *path;
     struct stat fi;
     SYS_FILE fd;
-    int cl, existed, wrote, rv;
+    PRInt64 cl, wrote;
+    int existed, rv;
 
     if ( !ISMPUT(rq))
         return REQ_NOACTION;
 
     t = pblock_findval("content-length", rq->headers);
     if(t) {
-        cl = atoi(t);
+        cl = util_atoi64(t);
         if(cl < 0) {
             protocol_status(sn, rq, PROTOCOL_BAD_REQUEST, NULL);
             log_error(LOG_WARN, "upload-file", sn, rq, 
@@ -233,7 +309,15 @@ upload_file(pblock *pb, Session *sn, Request *rq)
             return rv;
     }
 
-    wrote = _netbuf_buf2fd(sn->inbuf, fd, cl);
+    _upload_preallocate(fd, cl);
+
+    if(cl > 0 && httpfilter_can_splice_request_body(sn, rq))
+        wrote = _netbuf_splice2fd(sn->inbuf, sn, rq, fd, cl);
+    else
+        wrote = _netbuf_buf2fd(sn->inbuf, fd, cl);
+
+    if(wrote == IO_ERROR || (cl != -1 && wrote != cl))
+        _upload_release(fd, cl);
 
     system_fclose(fd);
 
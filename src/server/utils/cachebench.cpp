@@ -0,0 +1,247 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * cachebench.cpp
+ *
+ * Multi-threaded throughput benchmark for the generic cache_t.  Each run
+ * starts N threads that look up random keys, insert on a miss and release
+ * every reference, for a fixed amount of time.  N doubles from 1 up to the
+ * requested maximum so lock contention shows up as poor scaling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netsite.h"
+#include "base/cache.h"
+#include "nspr.h"
+
+typedef struct bench_entry_t {
+    cache_entry_t cache;    /* must be first; cache_delete() frees it */
+    unsigned int key;
+} bench_entry_t;
+
+typedef struct bench_thread_t {
+    PRThread *thread;
+    unsigned int seed;
+    PRUint64 ops;
+    PRUint64 hits;
+} bench_thread_t;
+
+static cache_t *cache;
+static unsigned int keyspace;
+static volatile PRInt32 stop;
+
+static unsigned int
+bench_hash(unsigned int hash_size, void *key)
+{
+    return (*(unsigned int *)key * 2654435761u) % hash_size;
+}
+
+static int
+bench_compare(void *key1, void *key2)
+{
+    return *(unsigned int *)key1 != *(unsigned int *)key2;
+}
+
+static int
+bench_cleanup(void *data)
+{
+    return 0;
+}
+
+static int
+bench_print(void *data, SYS_NETFD fd)
+{
+    return 0;
+}
+
+static public_cache_functions_t bench_cache_functions = {
+    bench_hash,
+    NULL
+};
+
+static cache_entry_functions_t bench_entry_functions = {
+    bench_compare,
+    bench_cleanup,
+    bench_print
+};
+
+static void
+bench_thread(void *arg)
+{
+    bench_thread_t *bt = (bench_thread_t *)arg;
+    unsigned int x = bt->seed;
+
+    while (!stop) {
+        unsigned int key;
+        bench_entry_t *entry;
+
+        /* xorshift32 */
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        key = x % keyspace;
+
+        entry = (bench_entry_t *)cache_do_lookup(cache, &key);
+        if (entry) {
+            bt->hits++;
+            cache_use_decrement(cache, &entry->cache);
+        } else {
+            entry = (bench_entry_t *)PERM_MALLOC(sizeof(bench_entry_t));
+            entry->key = key;
+            if (cache_insert_p(cache, &entry->cache, &entry->key, entry,
+                               &bench_entry_functions) == 0) {
+                cache_use_decrement(cache, &entry->cache);
+            } else {
+                PERM_FREE(entry);
+            }
+        }
+        bt->ops++;
+    }
+}
+
+static double
+bench_run(int nthreads, unsigned int entries, int seconds, double *hitratio)
+{
+    bench_thread_t *threads;
+    PRUint64 ops = 0;
+    PRUint64 hits = 0;
+    PRIntervalTime start;
+    PRIntervalTime elapsed;
+    int i;
+
+    cache = cache_create(entries, 2 * entries, &bench_cache_functions);
+    if (!cache) {
+        fprintf(stderr, "cachebench: cannot create cache\n");
+        exit(1);
+    }
+
+    threads = (bench_thread_t *)calloc(nthreads, sizeof(bench_thread_t));
+    stop = 0;
+    start = PR_IntervalNow();
+    for (i = 0; i < nthreads; i++) {
+        threads[i].seed = 2463534242u + 7919 * i;
+        threads[i].thread = PR_CreateThread(PR_USER_THREAD, bench_thread,
+                                            &threads[i], PR_PRIORITY_NORMAL,
+                                            PR_GLOBAL_THREAD,
+                                            PR_JOINABLE_THREAD, 0);
+        if (!threads[i].thread) {
+            fprintf(stderr, "cachebench: cannot create thread\n");
+            exit(1);
+        }
+    }
+
+    PR_Sleep(PR_SecondsToInterval(seconds));
+    PR_AtomicSet((PRInt32 *)&stop, 1);
+
+    for (i = 0; i < nthreads; i++) {
+        PR_JoinThread(threads[i].thread);
+        ops += threads[i].ops;
+        hits += threads[i].hits;
+    }
+    elapsed = PR_IntervalNow() - start;
+
+    free(threads);
+    cache_destroy(cache);
+    cache = NULL;
+
+    *hitratio = ops ? (double)hits / (double)ops : 0.0;
+
+    return (double)ops * PR_TicksPerSecond() / (elapsed ? elapsed : 1);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-n entries] [-k keys] [-s seconds] [-t maxthreads]\n", progname);
+    exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int entries = 10000;
+    int seconds = 2;
+    int maxthreads = 64;
+    double base = 0.0;
+    int nthreads;
+    int i;
+
+    keyspace = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-n")) {
+            entries = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-k")) {
+            keyspace = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s")) {
+            seconds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-t")) {
+            maxthreads = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (entries < 1 || seconds < 1 || maxthreads < 1)
+        usage(argv[0]);
+
+    /* By default a fifth of the keys don't fit, so inserts and evictions
+     * are part of the mix.
+     */
+    if (keyspace < 1)
+        keyspace = entries + entries / 4;
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    printf("entries %u, keys %u, %d second(s) per run\n",
+           entries, keyspace, seconds);
+    printf("%8s %14s %8s %8s\n", "threads", "ops/sec", "hit%", "scaling");
+
+    for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+        double hitratio;
+        double rate = bench_run(nthreads, entries, seconds, &hitratio);
+        if (nthreads == 1)
+            base = rate;
+        printf("%8d %14.0f %7.1f%% %7.2fx\n", nthreads, rate,
+               hitratio * 100.0, base > 0.0 ? rate / base : 0.0);
+        fflush(stdout);
+    }
+
+    PR_Cleanup();
+
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * cgibench.cpp
+ *
+ * Throughput benchmark for CGI execution through Cgistub.  Each thread
+ * starts the script with ChildExec, closes its stdin and reads its stdout
+ * and stderr to EOF.  The script is run first with a fork/exec per request
+ * and then, if a wrapper is given, through a persistent worker so the two
+ * request rates can be compared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "netsite.h"
+#include "safs/ChildExec.h"
+#include "nspr.h"
+
+typedef struct bench_thread_t {
+    PRThread *thread;
+    int id;
+    PRUint64 requests;
+    PRUint64 bytes;
+    PRUint64 errors;
+} bench_thread_t;
+
+static ChildExec *cexec;
+static const char *script;
+static const char *wrapper;
+static volatile PRInt32 stop;
+
+static PRUint64
+bench_drain(int fd)
+{
+    char buf[8192];
+    PRUint64 total = 0;
+    int rv;
+
+    for (;;) {
+        rv = read(fd, buf, sizeof(buf));
+        if (rv < 0 && errno == EINTR)
+            continue;
+        if (rv <= 0)
+            break;
+        total += rv;
+    }
+    close(fd);
+
+    return total;
+}
+
+static void
+bench_thread(void *arg)
+{
+    bench_thread_t *bt = (bench_thread_t *)arg;
+    char query[64];
+    const char *args[] = { NULL };
+    const char *envp[] = { "GATEWAY_INTERFACE=CGI/1.1", "REQUEST_METHOD=GET",
+                           query, "PATH=/usr/bin:/bin", NULL };
+
+    while (!stop) {
+        cexec_args_t cs;
+        int ioerr = 0;
+
+        PR_snprintf(query, sizeof(query), "QUERY_STRING=t=%d&n=%llu",
+                    bt->id, bt->requests);
+
+        memset(&cs, 0, sizeof(cs));
+        cs.cs_exec_path = script;
+        cs.cs_argv0 = script;
+        cs.cs_args = args;
+        cs.cs_envargs = envp;
+        cs.cs_opts.persistent = wrapper;
+
+        if (cexec->exec(cs, ioerr) != CERR_OK) {
+            bt->errors++;
+            continue;
+        }
+
+        close(cs.cs_stdin);
+        bt->bytes += bench_drain(cs.cs_stdout);
+        bench_drain(cs.cs_stderr);
+        bt->requests++;
+    }
+}
+
+static double
+bench_run(int nthreads, int seconds, double *bytes, PRUint64 *errors)
+{
+    bench_thread_t *threads;
+    PRUint64 requests = 0;
+    PRUint64 total = 0;
+    PRIntervalTime start;
+    PRIntervalTime elapsed;
+    int i;
+
+    threads = (bench_thread_t *)calloc(nthreads, sizeof(bench_thread_t));
+    stop = 0;
+    *errors = 0;
+
+    start = PR_IntervalNow();
+    for (i = 0; i < nthreads; i++) {
+        threads[i].id = i;
+        threads[i].thread = PR_CreateThread(PR_USER_THREAD, bench_thread,
+                                            &threads[i], PR_PRIORITY_NORMAL,
+                                            PR_GLOBAL_THREAD,
+                                            PR_JOINABLE_THREAD, 0);
+        if (!threads[i].thread) {
+            fprintf(stderr, "cgibench: cannot create thread\n");
+            exit(1);
+        }
+    }
+
+    PR_Sleep(PR_SecondsToInterval(seconds));
+    PR_AtomicSet((PRInt32 *)&stop, 1);
+
+    for (i = 0; i < nthreads; i++) {
+        PR_JoinThread(threads[i].thread);
+        requests += threads[i].requests;
+        total += threads[i].bytes;
+        *errors += threads[i].errors;
+    }
+    elapsed = PR_IntervalNow() - start;
+
+    free(threads);
+
+    *bytes = requests ? (double)total / requests : 0.0;
+
+    return (double)requests * PR_TicksPerSecond() / (elapsed ? elapsed : 1);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s -c cgistub [-w wrapper] [-s seconds] [-t threads] script\n", progname);
+    exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *cgistub = NULL;
+    const char *persistent = NULL;
+    int seconds = 5;
+    int nthreads = 1;
+    double base = 0.0;
+    int pass;
+    int ioerr;
+    int i;
+
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-c")) {
+            cgistub = argv[++i];
+        } else if (!strcmp(argv[i], "-w")) {
+            persistent = argv[++i];
+        } else if (!strcmp(argv[i], "-s")) {
+            seconds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-t")) {
+            nthreads = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (i != argc - 1 || !cgistub || seconds < 1 || nthreads < 1)
+        usage(argv[0]);
+    script = argv[i];
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    cexec = new ChildExec(cgistub);
+    cexec->setMinChildren(nthreads);
+    cexec->setMaxChildren(nthreads);
+    if (cexec->initialize(ioerr) != CERR_OK) {
+        fprintf(stderr, "cgibench: cannot start %s (error %d)\n", cgistub, ioerr);
+        return 1;
+    }
+
+    printf("%s, %d thread(s), %d second(s) per run\n", script, nthreads,
+           seconds);
+    printf("%-12s %12s %12s %8s %8s\n", "mode", "requests/s", "bytes/req",
+           "speedup", "errors");
+
+    for (pass = 0; pass < (persistent ? 2 : 1); pass++) {
+        double bytes;
+        PRUint64 errors;
+        double rate;
+
+        wrapper = pass ? persistent : NULL;
+        rate = bench_run(nthreads, seconds, &bytes, &errors);
+        if (pass == 0)
+            base = rate;
+        printf("%-12s %12.1f %12.0f %7.2fx %8llu\n",
+               pass ? "persistent" : "fork/exec", rate, bytes,
+               base > 0.0 ? rate / base : 0.0, (unsigned long long)errors);
+        fflush(stdout);
+    }
+
+    cexec->Terminate();
+    delete cexec;
+
+    PR_Cleanup();
+
+    return 0;
+}
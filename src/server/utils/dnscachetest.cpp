@@ -0,0 +1,367 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * dnscachetest.cpp
+ *
+ * Tests the proxy DNS cache against a stub DNS server on the loopback
+ * interface.  The stub answers every A query with 192.0.2.<n>, where n
+ * counts the queries it has seen for that name, and a TTL of <t> seconds
+ * for names that begin "ttl<t>." (300 otherwise).  It delays each answer
+ * so that concurrent lookups overlap.  The test checks that
+ *
+ *   - concurrent lookups of a name share one query,
+ *   - an entry expires after its record's TTL, and
+ *   - a popular entry is refreshed in the background before it expires,
+ *
+ * and that the refresh thread stops at shutdown.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netsite.h"
+#include "base/pool.h"
+#include "base/pblock.h"
+#include "base/daemon.h"
+#include "libproxy/host_dns_cache.h"
+#include "ares/arapi.h"
+#include "nspr.h"
+
+#define STUB_MAX_NAMES      16
+#define STUB_DEFAULT_TTL    300
+#define STUB_DELAY          200     /* milliseconds before each answer */
+#define COALESCE_THREADS    16
+
+typedef struct stub_name_t {
+    char name[256];
+    int queries;
+} stub_name_t;
+
+static PRFileDesc *stub_fd;
+static PRLock *stub_lock;
+static stub_name_t stub_names[STUB_MAX_NAMES];
+
+static PRLock *gate_lock;
+static PRCondVar *gate_cvar;
+static PRBool gate_open;
+
+static int failures;
+
+/*
+ * stub_count records a query for name and returns the number of queries
+ * seen for it so far.
+ */
+static int
+stub_count(const char *name)
+{
+    int n = 0;
+
+    PR_Lock(stub_lock);
+    for (int i = 0; i < STUB_MAX_NAMES; i++) {
+        if (!stub_names[i].name[0])
+            strcpy(stub_names[i].name, name);
+        if (!strcmp(stub_names[i].name, name)) {
+            n = ++stub_names[i].queries;
+            break;
+        }
+    }
+    PR_Unlock(stub_lock);
+
+    return n;
+}
+
+/*
+ * stub_queries returns the number of queries seen for name.
+ */
+static int
+stub_queries(const char *name)
+{
+    int n = 0;
+
+    PR_Lock(stub_lock);
+    for (int i = 0; i < STUB_MAX_NAMES; i++) {
+        if (!strcmp(stub_names[i].name, name)) {
+            n = stub_names[i].queries;
+            break;
+        }
+    }
+    PR_Unlock(stub_lock);
+
+    return n;
+}
+
+static void
+stub_thread(void *arg)
+{
+    unsigned char buf[512];
+    PRNetAddr from;
+
+    for (;;) {
+        PRInt32 len = PR_RecvFrom(stub_fd, buf, sizeof(buf) - 16, 0, &from,
+                                  PR_INTERVAL_NO_TIMEOUT);
+        if (len < 0)
+            break;
+        if (len < 12)
+            continue;
+
+        /* Decode the question's name */
+        char name[256];
+        int nlen = 0;
+        int pos = 12;
+        while (pos < len && buf[pos]) {
+            int l = buf[pos++];
+            if (pos + l > len || nlen + l + 1 >= (int) sizeof(name))
+                break;
+            if (nlen)
+                name[nlen++] = '.';
+            memcpy(name + nlen, buf + pos, l);
+            nlen += l;
+            pos += l;
+        }
+        if (pos + 5 > len || buf[pos])
+            continue;
+        name[nlen] = '\0';
+        pos += 5; /* root label, QTYPE, QCLASS */
+
+        int n = stub_count(name);
+        PRUint32 ttl = STUB_DEFAULT_TTL;
+        if (!strncmp(name, "ttl", 3))
+            ttl = atoi(name + 3);
+
+        PR_Sleep(PR_MillisecondsToInterval(STUB_DELAY));
+
+        /* Answer with the question followed by one A record */
+        buf[2] = 0x84 | (buf[2] & 0x01); /* QR, AA, RD */
+        buf[3] = 0x80; /* RA, NOERROR */
+        buf[4] = 0; buf[5] = 1; /* QDCOUNT */
+        buf[6] = 0; buf[7] = 1; /* ANCOUNT */
+        memset(buf + 8, 0, 4); /* NSCOUNT, ARCOUNT */
+        unsigned char *p = buf + pos;
+        *p++ = 0xc0; *p++ = 12; /* pointer to the question's name */
+        *p++ = 0; *p++ = 1; /* A */
+        *p++ = 0; *p++ = 1; /* IN */
+        *p++ = (ttl >> 24) & 0xff;
+        *p++ = (ttl >> 16) & 0xff;
+        *p++ = (ttl >> 8) & 0xff;
+        *p++ = ttl & 0xff;
+        *p++ = 0; *p++ = 4;
+        *p++ = 192; *p++ = 0; *p++ = 2; *p++ = n;
+
+        PR_SendTo(stub_fd, buf, p - buf, 0, &from, PR_INTERVAL_NO_TIMEOUT);
+    }
+}
+
+static PRStatus
+stub_start(PRNetAddr *addr)
+{
+    stub_lock = PR_NewLock();
+    stub_fd = PR_NewUDPSocket();
+    if (!stub_lock || !stub_fd)
+        return PR_FAILURE;
+
+    PR_InitializeNetAddr(PR_IpAddrLoopback, 0, addr);
+    if (PR_Bind(stub_fd, addr) != PR_SUCCESS)
+        return PR_FAILURE;
+    if (PR_GetSockName(stub_fd, addr) != PR_SUCCESS)
+        return PR_FAILURE;
+
+    if (!PR_CreateThread(PR_SYSTEM_THREAD, stub_thread, NULL,
+                         PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                         PR_UNJOINABLE_THREAD, 0))
+        return PR_FAILURE;
+
+    return PR_SUCCESS;
+}
+
+/*
+ * resolve looks up host through the cache and returns the last byte of its
+ * first address, or -1 on failure.
+ */
+static int
+resolve(const char *host)
+{
+    pool_handle_t *pool = pool_create();
+    Session sn;
+    memset(&sn, 0, sizeof(sn));
+    sn.pool = pool;
+
+    int rv = -1;
+    PRHostEnt *hostent = host_dns_cache_lookup(host, &sn, NULL);
+    if (!hostent)
+        hostent = host_dns_cache_resolve(host, &sn, NULL);
+    if (hostent && hostent->h_addr_list && hostent->h_addr_list[0])
+        rv = (unsigned char) hostent->h_addr_list[0][3];
+
+    pool_destroy(pool);
+
+    return rv;
+}
+
+static void
+check(PRBool ok, const char *what, int value)
+{
+    printf("%-48s %6d %s\n", what, value, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+static void
+coalesce_thread(void *arg)
+{
+    PR_Lock(gate_lock);
+    while (!gate_open)
+        PR_WaitCondVar(gate_cvar, PR_INTERVAL_NO_TIMEOUT);
+    PR_Unlock(gate_lock);
+
+    *(int *) arg = resolve("coalesce.stub.test");
+}
+
+static void
+test_coalesce(void)
+{
+    PRThread *threads[COALESCE_THREADS];
+    int answers[COALESCE_THREADS];
+    int i;
+
+    gate_lock = PR_NewLock();
+    gate_cvar = PR_NewCondVar(gate_lock);
+
+    for (i = 0; i < COALESCE_THREADS; i++) {
+        answers[i] = -1;
+        threads[i] = PR_CreateThread(PR_USER_THREAD, coalesce_thread,
+                                     &answers[i], PR_PRIORITY_NORMAL,
+                                     PR_GLOBAL_THREAD, PR_JOINABLE_THREAD, 0);
+    }
+
+    PR_Lock(gate_lock);
+    gate_open = PR_TRUE;
+    PR_NotifyAllCondVar(gate_cvar);
+    PR_Unlock(gate_lock);
+
+    int resolved = 0;
+    for (i = 0; i < COALESCE_THREADS; i++) {
+        if (threads[i])
+            PR_JoinThread(threads[i]);
+        if (answers[i] == 1)
+            resolved++;
+    }
+
+    check(resolved == COALESCE_THREADS, "concurrent lookups resolved", resolved);
+    check(stub_queries("coalesce.stub.test") == 1, "queries for concurrent lookups",
+          stub_queries("coalesce.stub.test"));
+}
+
+static void
+test_ttl(void)
+{
+    const char *host = "ttl4.stub.test";
+
+    resolve(host);
+    resolve(host);
+    check(stub_queries(host) == 1, "queries within TTL", stub_queries(host));
+
+    PR_Sleep(PR_SecondsToInterval(5));
+    int answer = resolve(host);
+    check(stub_queries(host) == 2 && answer == 2, "queries after TTL", stub_queries(host));
+}
+
+static void
+test_refresh(void)
+{
+    const char *host = "ttl6.refresh.stub.test";
+
+    resolve(host);
+
+    /* Two lookups within half the TTL of expiring schedule a refresh */
+    PR_Sleep(PR_SecondsToInterval(4));
+    resolve(host);
+    resolve(host);
+    PR_Sleep(PR_SecondsToInterval(1));
+    check(stub_queries(host) == 2, "queries after early refresh", stub_queries(host));
+
+    /* The refreshed entry outlives the original one */
+    PR_Sleep(PR_SecondsToInterval(2));
+    int answer = resolve(host);
+    check(answer == 2 && stub_queries(host) == 2, "answer after original expiry", answer);
+}
+
+int
+main(int argc, char *argv[])
+{
+    PRNetAddr addr;
+
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    if (stub_start(&addr) != PR_SUCCESS) {
+        fprintf(stderr, "%s: unable to start stub DNS server\n", argv[0]);
+        return 1;
+    }
+
+    PR_AR_Init(PR_SecondsToInterval(5));
+    if (PR_AR_SetNameServer(&addr) != PR_SUCCESS) {
+        fprintf(stderr, "%s: unable to start asynchronous resolver\n", argv[0]);
+        return 1;
+    }
+
+    if (host_dns_cache_hostent_init() != PR_SUCCESS) {
+        fprintf(stderr, "%s: unable to initialize DNS cache\n", argv[0]);
+        return 1;
+    }
+    pblock *pb = pblock_create(4);
+    pblock_nvinsert("refresh", "30", pb);
+    if (host_dns_cache_init(pb, NULL, NULL) != REQ_PROCEED) {
+        fprintf(stderr, "%s: unable to initialize DNS cache\n", argv[0]);
+        return 1;
+    }
+    pblock_free(pb);
+
+    test_coalesce();
+    test_ttl();
+    test_refresh();
+
+    /* Stops the refresh thread */
+    daemon_dorestart();
+    check(PR_TRUE, "shutdown", 0);
+
+    PR_Close(stub_fd);
+
+    PR_Cleanup();
+
+    return failures ? 1 : 0;
+}
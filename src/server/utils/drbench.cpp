@@ -0,0 +1,296 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * drbench.cpp
+ *
+ * Multi-threaded throughput benchmark for the dynamic result cache.  Each
+ * thread sends cached entries to a socket pair with dr_net_write and, for
+ * a configurable share of its operations, replaces an entry with
+ * dr_cache_refresh.  A drain thread per worker reads the other end of the
+ * socket pair.  The thread count doubles from 1 up to the requested
+ * maximum so lock contention shows up as poor scaling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netsite.h"
+#include "base/pblock.h"
+#include "drnsapi.h"
+#include "nspr.h"
+
+typedef struct bench_thread_t {
+    PRThread *thread;
+    PRThread *drain;
+    PRFileDesc *pair[2];
+    Session sn;
+    Request rq;
+    unsigned int seed;
+    PRUint64 ops;
+    PRUint64 errors;
+} bench_thread_t;
+
+static DrHdl cache;
+static unsigned int keyspace;
+static unsigned int entrysize;
+static unsigned int refreshpct;
+static volatile PRInt32 stop;
+static volatile PRInt32 misses;
+
+static Entry *
+bench_alloc(void)
+{
+    Entry *entry = (Entry *)malloc(sizeof(Entry));
+    entry->data = (char *)malloc(entrysize);
+    entry->dataLen = entrysize;
+    memset(entry->data, 'x', entrysize);
+    return entry;
+}
+
+static Entry *
+bench_refresh(const char *key, PRUint32 len, PRIntervalTime timeout,
+              Request *rq, Session *sn)
+{
+    PR_AtomicIncrement((PRInt32 *)&misses);
+    return bench_alloc();
+}
+
+static void
+bench_free(Entry *entry)
+{
+    free(entry->data);
+    free(entry);
+}
+
+static PRIntn
+bench_compare(const char *k1, const char *k2, PRUint32 len1, PRUint32 len2)
+{
+    return len1 == len2 && !memcmp(k1, k2, len1);
+}
+
+static void
+bench_drain(void *arg)
+{
+    PRFileDesc *fd = (PRFileDesc *)arg;
+    char buf[65536];
+
+    while (PR_Recv(fd, buf, sizeof(buf), 0, PR_INTERVAL_NO_TIMEOUT) > 0)
+        ;
+}
+
+static void
+bench_thread(void *arg)
+{
+    bench_thread_t *bt = (bench_thread_t *)arg;
+    unsigned int x = bt->seed;
+    char key[32];
+
+    while (!stop) {
+        unsigned int r;
+        int len;
+
+        /* xorshift32 */
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        len = PR_snprintf(key, sizeof(key), "/dr/%u", x % keyspace);
+
+        r = (x >> 8) % 100;
+        if (r < refreshpct) {
+            if (!dr_cache_refresh(cache, key, len, 0, bench_alloc(),
+                                  &bt->rq, &bt->sn))
+                bt->errors++;
+        } else {
+            if (dr_net_write(cache, key, len, NULL, NULL, 0, 0,
+                             PR_INTERVAL_NO_TIMEOUT, 0,
+                             &bt->rq, &bt->sn) < 0)
+                bt->errors++;
+        }
+        bt->ops++;
+    }
+}
+
+static double
+bench_run(int nthreads, PRUint64 maxbytes, PRIntervalTime maxage,
+          int seconds, double *hitratio, PRUint64 *errors)
+{
+    bench_thread_t *threads;
+    PRUint64 ops = 0;
+    PRIntervalTime start;
+    PRIntervalTime elapsed;
+    int i;
+
+    if (!dr_cache_init_size(&cache, bench_refresh, bench_free, bench_compare,
+                            maxbytes, maxage)) {
+        fprintf(stderr, "drbench: cannot create cache\n");
+        exit(1);
+    }
+
+    threads = (bench_thread_t *)calloc(nthreads, sizeof(bench_thread_t));
+    stop = 0;
+    misses = 0;
+    *errors = 0;
+    for (i = 0; i < nthreads; i++) {
+        bench_thread_t *bt = &threads[i];
+        if (PR_NewTCPSocketPair(bt->pair) != PR_SUCCESS) {
+            fprintf(stderr, "drbench: cannot create socket pair\n");
+            exit(1);
+        }
+        bt->sn.csd = bt->pair[0];
+        bt->rq.reqpb = pblock_create(4);
+        bt->rq.srvhdrs = pblock_create(4);
+        pblock_nvinsert("uri", "/drbench", bt->rq.reqpb);
+        bt->seed = 2463534242u + 7919 * i;
+        bt->drain = PR_CreateThread(PR_USER_THREAD, bench_drain, bt->pair[1],
+                                    PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                    PR_JOINABLE_THREAD, 0);
+    }
+
+    start = PR_IntervalNow();
+    for (i = 0; i < nthreads; i++) {
+        threads[i].thread = PR_CreateThread(PR_USER_THREAD, bench_thread,
+                                            &threads[i], PR_PRIORITY_NORMAL,
+                                            PR_GLOBAL_THREAD,
+                                            PR_JOINABLE_THREAD, 0);
+        if (!threads[i].thread || !threads[i].drain) {
+            fprintf(stderr, "drbench: cannot create thread\n");
+            exit(1);
+        }
+    }
+
+    PR_Sleep(PR_SecondsToInterval(seconds));
+    PR_AtomicSet((PRInt32 *)&stop, 1);
+
+    for (i = 0; i < nthreads; i++) {
+        PR_JoinThread(threads[i].thread);
+        ops += threads[i].ops;
+        *errors += threads[i].errors;
+    }
+    elapsed = PR_IntervalNow() - start;
+
+    for (i = 0; i < nthreads; i++) {
+        PR_Close(threads[i].pair[0]);
+        PR_JoinThread(threads[i].drain);
+        PR_Close(threads[i].pair[1]);
+        pblock_free(threads[i].rq.reqpb);
+        pblock_free(threads[i].rq.srvhdrs);
+    }
+
+    free(threads);
+    dr_cache_destroy(&cache);
+
+    *hitratio = ops ? 1.0 - (double)misses / (double)ops : 0.0;
+
+    return (double)ops * PR_TicksPerSecond() / (elapsed ? elapsed : 1);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-k keys] [-b entrybytes] [-m maxbytes] [-a maxage-ms] [-r refresh%%] [-s seconds] [-t maxthreads]\n", progname);
+    exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    PRUint64 maxbytes = 0;
+    unsigned int maxage = 0;
+    int seconds = 2;
+    int maxthreads = 64;
+    double base = 0.0;
+    int nthreads;
+    int i;
+
+    keyspace = 10000;
+    entrysize = 1024;
+    refreshpct = 1;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-k")) {
+            keyspace = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-b")) {
+            entrysize = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-m")) {
+            maxbytes = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-a")) {
+            maxage = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-r")) {
+            refreshpct = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s")) {
+            seconds = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-t")) {
+            maxthreads = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (keyspace < 1 || entrysize < 1 || refreshpct > 100 ||
+        seconds < 1 || maxthreads < 1)
+        usage(argv[0]);
+
+    /* By default a fifth of the entries don't fit, so evictions are part
+     * of the mix.
+     */
+    if (maxbytes == 0)
+        maxbytes = (PRUint64)keyspace * entrysize * 4 / 5;
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    printf("keys %u, entry %u bytes, limit %llu bytes, max age %u ms, "
+           "%u%% refresh, %d second(s) per run\n",
+           keyspace, entrysize, (unsigned long long)maxbytes, maxage, refreshpct, seconds);
+    printf("%8s %14s %8s %8s %8s\n", "threads", "ops/sec", "hit%", "scaling",
+           "errors");
+
+    for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+        double hitratio;
+        PRUint64 errors;
+        double rate = bench_run(nthreads, maxbytes,
+                                PR_MillisecondsToInterval(maxage),
+                                seconds, &hitratio, &errors);
+        if (nthreads == 1)
+            base = rate;
+        printf("%8d %14.0f %7.1f%% %7.2fx %8llu\n", nthreads, rate,
+               hitratio * 100.0, base > 0.0 ? rate / base : 0.0,
+               (unsigned long long)errors);
+        fflush(stdout);
+    }
+
+    PR_Cleanup();
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * exprbench.cpp
+ *
+ * Measures the per-request cost of evaluating obj.conf expressions and
+ * interpolated string models as expression trees against the bytecode
+ * produced by expr_compile and model_str_compile, and checks that both
+ * produce the same result.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netsite.h"
+#include "base/pool.h"
+#include "base/pblock.h"
+#include "frame/req.h"
+#include "frame/expr.h"
+#include "frame/expr_pvt.h"
+#include "frame/model.h"
+#include "frame/model_pvt.h"
+#include "safs/var.h"
+#include "nspr.h"
+
+static const char *exprs[] = {
+    "$method eq 'GET'",
+    "$uri =~ '^/images/' || $uri =~ '\\.(gif|jpg|png)$'",
+    "$headers{'host'} eq 'www.example.com' and $ip =~ '^10\\.'",
+    "not $internal and ($method eq 'GET' or $method eq 'HEAD') and $protocol eq 'HTTP/1.1'",
+    "$query eq 'a=1&b=2' and 1 + 2 * 3 == 7 and 'abc' . 'def' eq 'abcdef'",
+    "$uri = '/images/*.png'",
+    NULL
+};
+
+static const char *strings[] = {
+    "/docs$uri",
+    "http://$headers{'host'}$uri?$query",
+    "$ip $method $uri $protocol $headers{'user-agent'}",
+    NULL
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-n iterations] [-e expression] [-s string]\n", progname);
+    exit(1);
+}
+
+static PRBool
+same(const Result& a, const Result& b)
+{
+    if (a.isError() != b.isError())
+        return PR_FALSE;
+    if (a.isError())
+        return PR_TRUE;
+    if (a.getStringLength() != b.getStringLength())
+        return PR_FALSE;
+    return !memcmp(a.getConstString(), b.getConstString(), a.getStringLength());
+}
+
+static double
+run(const Expression *expr, Session *sn, Request *rq, int iterations)
+{
+    pool_handle_t *pool = pool_create();
+    PRIntervalTime start = PR_IntervalNow();
+
+    for (int i = 0; i < iterations; i++) {
+        Context context(sn, rq, pool);
+        expr->execute(context);
+        if (i % 1000 == 999) {
+            pool_destroy(pool);
+            pool = pool_create();
+        }
+    }
+
+    double seconds = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start) / 1000000.0;
+    if (seconds <= 0)
+        seconds = 0.000001;
+
+    pool_destroy(pool);
+
+    return seconds * 1000000000.0 / iterations;
+}
+
+static int
+bench(const char *text, Expression *tree, Expression *program, Session *sn, Request *rq, int iterations)
+{
+    if (!tree || !program) {
+        fprintf(stderr, "%s: %s\n", text, system_errmsg());
+        return 1;
+    }
+
+    if (!program->isCompiled()) {
+        printf("%-48.48s %11s\n", text, "not compiled");
+        return 0;
+    }
+
+    pool_handle_t *pool = pool_create();
+    Context treeContext(sn, rq, pool);
+    Context programContext(sn, rq, pool);
+    PRBool ok = same(tree->execute(treeContext), program->execute(programContext));
+    pool_destroy(pool);
+    if (!ok) {
+        printf("%-48.48s %11s\n", text, "MISMATCH");
+        return 1;
+    }
+
+    double nsTree = run(tree, sn, rq, iterations);
+    double nsProgram = run(program, sn, rq, iterations);
+
+    printf("%-48.48s %8.1f ns %8.1f ns %6.2fx\n", text, nsTree, nsProgram, nsTree / nsProgram);
+
+    return 0;
+}
+
+static int
+bench_expr(const char *s, Session *sn, Request *rq, int iterations)
+{
+    Expression *tree = expr_create(s);
+    Expression *program = expr_create(s);
+    if (program)
+        expr_compile(program);
+
+    int rv = bench(s, tree, program, sn, rq, iterations);
+
+    if (tree)
+        expr_free(tree);
+    if (program)
+        expr_free(program);
+
+    return rv;
+}
+
+static int
+bench_string(const char *s, Session *sn, Request *rq, int iterations)
+{
+    ModelString *tree = model_str_create(s);
+    ModelString *program = model_str_create(s);
+    if (program)
+        model_str_compile(program);
+
+    int rv = bench(s, tree, program, sn, rq, iterations);
+
+    if (tree)
+        model_str_free(tree);
+    if (program)
+        model_str_free(program);
+
+    return rv;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int iterations = 1000000;
+    const char *expr = NULL;
+    const char *string = NULL;
+    int failures = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-n")) {
+            iterations = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-e")) {
+            expr = argv[++i];
+        } else if (!strcmp(argv[i], "-s")) {
+            string = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (iterations < 1)
+        usage(argv[0]);
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    if (var_init() != PR_SUCCESS) {
+        fprintf(stderr, "%s: unable to register variables\n", argv[0]);
+        return 1;
+    }
+
+    /* A representative request for the $variables to look at */
+    pool_handle_t *pool = pool_create();
+    NSAPIRequest *nrq = (NSAPIRequest *) pool_calloc(pool, 1, sizeof(NSAPIRequest));
+    if (!nrq || request_initialize(pool, NULL, "www.example.com", nrq) != PR_SUCCESS) {
+        fprintf(stderr, "%s: unable to create request\n", argv[0]);
+        return 1;
+    }
+    Request *rq = &nrq->rq;
+    pblock_nvinsert("method", "GET", rq->reqpb);
+    pblock_nvinsert("uri", "/images/logos/heliod-banner-large.png", rq->reqpb);
+    pblock_nvinsert("protocol", "HTTP/1.1", rq->reqpb);
+    pblock_nvinsert("query", "a=1&b=2", rq->reqpb);
+    pblock_nvinsert("host", "www.example.com", rq->headers);
+    pblock_nvinsert("user-agent", "Mozilla/5.0 (X11; Linux x86_64)", rq->headers);
+
+    Session sn;
+    memset(&sn, 0, sizeof(sn));
+    sn.pool = pool;
+    sn.client = pblock_create_pool(pool, 4);
+    pblock_nvinsert("ip", "10.1.2.3", sn.client);
+
+    printf("%-48s %11s %11s %7s\n", "Expression", "tree", "bytecode", "");
+    if (expr || string) {
+        if (expr)
+            failures += bench_expr(expr, &sn, rq, iterations);
+        if (string)
+            failures += bench_string(string, &sn, rq, iterations);
+    } else {
+        for (i = 0; exprs[i]; i++)
+            failures += bench_expr(exprs[i], &sn, rq, iterations);
+        for (i = 0; strings[i]; i++)
+            failures += bench_string(strings[i], &sn, rq, iterations);
+    }
+
+    pool_destroy(pool);
+
+    PR_Cleanup();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,315 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * htaccessbench.cpp
+ *
+ * Builds a deep directory hierarchy under a document root, with an
+ * .htaccess file in every other directory, and GETs the file at the bottom
+ * from a running server with htaccess-find enabled.  Every request makes
+ * the htaccess plugin look for an access file in each directory on the
+ * path, so the request rate shows the cost of that walk.  Reports the
+ * request rate and the number of responses that weren't 200 OK.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nspr.h"
+#include "plstr.h"
+
+#define BUFFER_SIZE (64 * 1024)
+#define PATH_SIZE 4096
+
+static const char *host = "localhost";
+static int port = 80;
+static const char *prefix = NULL;
+static char uri[PATH_SIZE];
+static int requests = 1000;
+static PRNetAddr addr;
+
+static PRInt32 total_requests;
+static PRInt32 total_errors;
+static PRInt32 total_not_ok;
+static PRLock *total_lock;
+
+static const char htaccess[] =
+    "<Limit GET POST>\n"
+    "order deny,allow\n"
+    "deny from 192.0.2.0/24\n"
+    "allow from all\n"
+    "</Limit>\n";
+
+static const char content[] = "htaccessbench\n";
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s -u uri-prefix -d depth [-r docroot] [-h host] [-p port] [-t threads] [-n requests]\n", progname);
+    exit(1);
+}
+
+static PRBool
+write_file(const char *path, const char *data)
+{
+    PRFileDesc *fd = PR_Open(path, PR_WRONLY | PR_CREATE_FILE | PR_TRUNCATE, 0644);
+    if (!fd)
+        return PR_FALSE;
+    int len = strlen(data);
+    PRBool ok = (PR_Write(fd, data, len) == len);
+    PR_Close(fd);
+    return ok;
+}
+
+/*
+ * build_tree creates docroot/d0/d1/.../d<depth-1>/index.html, with an
+ * .htaccess file in every other directory.  Existing files are replaced.
+ */
+static PRBool
+build_tree(const char *docroot, int depth)
+{
+    char path[PATH_SIZE];
+    char file[PATH_SIZE];
+    int len = PR_snprintf(path, sizeof(path), "%s", docroot);
+
+    for (int i = 0; i < depth; i++) {
+        len += PR_snprintf(path + len, sizeof(path) - len, "/d%d", i);
+        if (len >= PATH_SIZE - 32)
+            return PR_FALSE;
+        if (PR_MkDir(path, 0755) != PR_SUCCESS && PR_GetError() != PR_FILE_EXISTS_ERROR)
+            return PR_FALSE;
+        if (i % 2 == 0) {
+            PR_snprintf(file, sizeof(file), "%s/.htaccess", path);
+            if (!write_file(file, htaccess))
+                return PR_FALSE;
+        }
+    }
+
+    PR_snprintf(file, sizeof(file), "%s/index.html", path);
+    return write_file(file, content);
+}
+
+static PRFileDesc *
+connect_server(void)
+{
+    PRFileDesc *fd = PR_NewTCPSocket();
+    if (fd && PR_Connect(fd, &addr, PR_INTERVAL_NO_TIMEOUT) != PR_SUCCESS) {
+        PR_Close(fd);
+        fd = NULL;
+    }
+    return fd;
+}
+
+/*
+ * read_response reads a response, returning the status code or -1 on error.
+ * The entity body is discarded.  *keep_alive is cleared if the server
+ * indicated it will close the connection.
+ */
+static int
+read_response(PRFileDesc *fd, char *buf, PRBool *keep_alive)
+{
+    int len = 0;
+    char *eoh = NULL;
+    while (!eoh) {
+        if (len == BUFFER_SIZE - 1)
+            return -1;
+        int rv = PR_Recv(fd, buf + len, BUFFER_SIZE - 1 - len, 0, PR_INTERVAL_NO_TIMEOUT);
+        if (rv <= 0)
+            return -1;
+        len += rv;
+        buf[len] = '\0';
+        eoh = strstr(buf, "\r\n\r\n");
+    }
+    *eoh = '\0';
+
+    int status = -1;
+    if (sscanf(buf, "HTTP/%*d.%*d %d", &status) != 1)
+        return -1;
+
+    PRInt64 content_length = -1;
+    for (char *p = strstr(buf, "\r\n"); p; p = strstr(p + 2, "\r\n")) {
+        if (!PL_strncasecmp(p + 2, "Content-length:", 15))
+            content_length = strtoll(p + 17, NULL, 10);
+        if (!PL_strncasecmp(p + 2, "Connection:", 11) && PL_strcasestr(p + 13, "close"))
+            *keep_alive = PR_FALSE;
+    }
+    if (content_length < 0)
+        return -1;
+
+    PRInt64 remaining = content_length - (len - (eoh + 4 - buf));
+    while (remaining > 0) {
+        int rv = PR_Recv(fd, buf, remaining < BUFFER_SIZE ? (int) remaining : BUFFER_SIZE, 0, PR_INTERVAL_NO_TIMEOUT);
+        if (rv <= 0)
+            return -1;
+        remaining -= rv;
+    }
+
+    return status;
+}
+
+static void
+client_thread(void *arg)
+{
+    char *buf = (char *) malloc(BUFFER_SIZE);
+    char request[PATH_SIZE + 256];
+    PRFileDesc *fd = NULL;
+    int nrequests = 0;
+    int nerrors = 0;
+    int nnotok = 0;
+
+    int len = PR_snprintf(request, sizeof(request),
+                          "GET %s HTTP/1.1\r\n"
+                          "Host: %s\r\n"
+                          "\r\n",
+                          uri, host);
+
+    for (int i = 0; i < requests; i++) {
+        if (!fd)
+            fd = connect_server();
+
+        PRBool keep_alive = PR_TRUE;
+        int status = -1;
+        if (fd && PR_Send(fd, request, len, 0, PR_INTERVAL_NO_TIMEOUT) == len)
+            status = read_response(fd, buf, &keep_alive);
+
+        nrequests++;
+        if (status == -1) {
+            nerrors++;
+        } else if (status != 200) {
+            nnotok++;
+        }
+
+        if (status == -1 || !keep_alive) {
+            if (fd)
+                PR_Close(fd);
+            fd = NULL;
+        }
+    }
+
+    if (fd)
+        PR_Close(fd);
+    free(buf);
+
+    PR_Lock(total_lock);
+    total_requests += nrequests;
+    total_errors += nerrors;
+    total_not_ok += nnotok;
+    PR_Unlock(total_lock);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *docroot = NULL;
+    int depth = 0;
+    int threads = 8;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-h")) {
+            host = argv[++i];
+        } else if (!strcmp(argv[i], "-p")) {
+            port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-u")) {
+            prefix = argv[++i];
+        } else if (!strcmp(argv[i], "-d")) {
+            depth = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-r")) {
+            docroot = argv[++i];
+        } else if (!strcmp(argv[i], "-t")) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-n")) {
+            requests = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!prefix || depth < 1 || threads < 1 || requests < 1)
+        usage(argv[0]);
+
+    int len = PR_snprintf(uri, sizeof(uri), "%s", prefix);
+    if (len > 0 && uri[len - 1] == '/')
+        uri[--len] = '\0';
+    for (int d = 0; d < depth && len < PATH_SIZE - 32; d++)
+        len += PR_snprintf(uri + len, sizeof(uri) - len, "/d%d", d);
+    if (len >= PATH_SIZE - 32)
+        usage(argv[0]);
+    PR_snprintf(uri + len, sizeof(uri) - len, "/index.html");
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    if (docroot && !build_tree(docroot, depth)) {
+        fprintf(stderr, "Unable to create the directory tree under %s\n", docroot);
+        return 1;
+    }
+
+    PRHostEnt hostent;
+    char hostbuf[PR_NETDB_BUF_SIZE];
+    if (PR_GetHostByName(host, hostbuf, sizeof(hostbuf), &hostent) != PR_SUCCESS ||
+        PR_EnumerateHostEnt(0, &hostent, port, &addr) < 0)
+    {
+        fprintf(stderr, "Unable to resolve %s\n", host);
+        return 1;
+    }
+
+    total_lock = PR_NewLock();
+
+    PRThread **tids = (PRThread **) malloc(threads * sizeof(PRThread *));
+    PRIntervalTime start = PR_IntervalNow();
+    for (i = 0; i < threads; i++) {
+        tids[i] = PR_CreateThread(PR_USER_THREAD, client_thread, NULL,
+                                  PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                  PR_JOINABLE_THREAD, 0);
+    }
+    for (i = 0; i < threads; i++) {
+        if (tids[i])
+            PR_JoinThread(tids[i]);
+    }
+    double seconds = (double) PR_IntervalToMilliseconds(PR_IntervalNow() - start) / 1000.0;
+    if (seconds <= 0)
+        seconds = 0.001;
+
+    printf("depth %d, threads %d, requests %d, errors %d, unexpected status %d\n",
+           depth, threads, total_requests, total_errors, total_not_ok);
+    printf("%-20s %10.1f requests/s\n", "rate", total_requests / seconds);
+
+    free(tids);
+    PR_DestroyLock(total_lock);
+
+    PR_Cleanup();
+
+    return (total_errors || total_not_ok) ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * mimebench.cpp
+ *
+ * Measures the per-request cost of the ObjectType type-by-extension lookup.
+ * The extensions from a MIME types file are loaded both into the pair of
+ * SimplePtrStringHash tables the server used to use and into a MimeExtIndex.
+ * A stream of URIs, one per extension, is then typed both ways, copying the
+ * URI and the result and inserting the content type with pblock_nvinsert for
+ * the former, and typing the URI with the same mime_find_content_info() that
+ * Mime::findContentInfo uses and inserting the content type with
+ * pblock_kvinsert for the latter.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "netsite.h"
+#include "base/pblock.h"
+#include "base/pool.h"
+#include "support/SimpleHash.h"
+#include "httpdaemon/mimeindex.h"
+#include "nspr.h"
+
+#define MAX_LINE 1024
+
+static SimplePtrStringHash *hash_exact;
+static SimplePtrStringHash *hash_mixed;
+static MimeExtIndex *ext_index;
+static char **uris;
+static int nuris;
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s -f mime.types [-n iterations]\n", progname);
+    exit(1);
+}
+
+/*
+ * add_type adds the extensions from a "type=x exts=a,b" line.
+ */
+static void
+add_type(char *line)
+{
+    char *type = NULL;
+    char *exts = NULL;
+
+    for (char *t = strtok(line, " \t\r\n"); t; t = strtok(NULL, " \t\r\n")) {
+        if (!strncasecmp(t, "type=", 5))
+            type = t + 5;
+        else if (!strncasecmp(t, "exts=", 5))
+            exts = t + 5;
+    }
+    if (!type || !exts)
+        return;
+
+    MimeContentInfo *info = (MimeContentInfo *) calloc(1, sizeof(MimeContentInfo));
+    info->ci.type = strdup(type);
+    info->typeLen = strlen(type);
+
+    for (char *ext = strtok(exts, ","); ext; ext = strtok(NULL, ",")) {
+        ext = strdup(ext);
+        if (!hash_mixed->lookup(ext))
+            hash_mixed->insert(ext, info);
+        hash_exact->insert(ext, info);
+        ext_index->add(ext, info);
+
+        uris = (char **) realloc(uris, (nuris + 1) * sizeof(char *));
+        uris[nuris] = (char *) malloc(strlen(ext) + sizeof("/docs/file."));
+        sprintf(uris[nuris], "/docs/file.%s", ext);
+        nuris++;
+    }
+}
+
+/*
+ * type_hash types uri the way the server used to: copy the URI, look up every
+ * extension in the case sensitive and then the case insensitive hash, copy
+ * the result and insert it by name.
+ */
+static void
+type_hash(pool_handle_t *pool, const char *uri, pblock *srvhdrs)
+{
+    char *temp = pool_strdup(pool, uri);
+    const char *type = NULL;
+
+    char *exts = strchr(temp, '/');
+    exts = exts ? exts + 1 : temp;
+    exts = strchr(exts, '.');
+    if (exts) {
+        exts++;
+        while (*exts) {
+            char *t = exts;
+            while (*t && *t != '.') ++t;
+            char c = *t;
+            *t = '\0';
+            MimeContentInfo *info = (MimeContentInfo *) hash_exact->lookup(exts);
+            if (!info)
+                info = (MimeContentInfo *) hash_mixed->lookup(exts);
+            if (info && info->ci.type)
+                type = info->ci.type;
+            if (c) {
+                *t = c;
+                t++;
+            }
+            exts = t;
+        }
+    }
+
+    if (type) {
+        char *copy = pool_strdup(pool, type);
+        if (!pblock_find("content-type", srvhdrs))
+            pblock_nvinsert("content-type", copy, srvhdrs);
+        pool_free(pool, copy);
+    }
+
+    pool_free(pool, temp);
+}
+
+/*
+ * IndexFinder looks up an extension in ext_index the way Mime::findExt does
+ * for a single MIME file.
+ */
+struct IndexFinder {
+    const MimeContentInfo *findExt(const char *ext, int len) const
+    {
+        const MimeContentInfo *exact;
+        const MimeContentInfo *mixed;
+        ext_index->find(ext, len, MimeExtIndex::hash(ext, len), &exact, &mixed);
+        return exact ? exact : mixed;
+    }
+};
+
+/*
+ * type_index types uri the way ObjectType does now: find the content info in
+ * place with Mime::findContentInfo's lookup and insert the type by key using
+ * its known length.
+ */
+static void
+type_index(const char *uri, pblock *srvhdrs)
+{
+    IndexFinder finder;
+    MimeContentInfo info;
+
+    if (mime_find_content_info(finder, uri, &info) && info.ci.type) {
+        if (!pblock_findkey(pb_key_content_type, srvhdrs))
+            pblock_kvinsert(pb_key_content_type, info.ci.type, info.typeLen, srvhdrs);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *filename = NULL;
+    int iterations = 1000000;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-f")) {
+            filename = argv[++i];
+        } else if (!strcmp(argv[i], "-n")) {
+            iterations = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!filename || iterations < 1)
+        usage(argv[0]);
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    hash_exact = new SimplePtrStringHash(3);
+    hash_mixed = new SimplePtrStringHash(3);
+    hash_mixed->setMixCase();
+    ext_index = new MimeExtIndex();
+
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Unable to open %s\n", filename);
+        return 1;
+    }
+    char line[MAX_LINE];
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] != '#')
+            add_type(line);
+    }
+    fclose(fp);
+
+    if (!nuris) {
+        fprintf(stderr, "No extensions in %s\n", filename);
+        return 1;
+    }
+
+    pool_handle_t *pool = pool_create();
+    pblock *srvhdrs = pblock_create(11);
+
+    PRIntervalTime start = PR_IntervalNow();
+    for (i = 0; i < iterations; i++) {
+        type_hash(pool, uris[i % nuris], srvhdrs);
+        param_free(pblock_remove("content-type", srvhdrs));
+    }
+    double hash_ns = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start) * 1000.0 / iterations;
+
+    start = PR_IntervalNow();
+    for (i = 0; i < iterations; i++) {
+        type_index(uris[i % nuris], srvhdrs);
+        param_free(pblock_removekey(pb_key_content_type, srvhdrs));
+    }
+    double index_ns = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start) * 1000.0 / iterations;
+
+    printf("extensions %d, iterations %d\n", nuris, iterations);
+    printf("%-20s %10.1f ns/request\n", "hash", hash_ns);
+    printf("%-20s %10.1f ns/request\n", "index", index_ns);
+    printf("%-20s %10.2fx\n", "speedup", index_ns > 0 ? hash_ns / index_ns : 0.0);
+
+    pblock_free(srvhdrs);
+    pool_destroy(pool);
+
+    PR_Cleanup();
+
+    return 0;
+}
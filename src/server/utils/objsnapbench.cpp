@@ -0,0 +1,145 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * objsnapbench.cpp
+ *
+ * Measures the startup cost of loading an obj.conf file.  The file is parsed
+ * with objset_load, then loaded with objset_load_snapshot, first to write the
+ * snapshot and then repeatedly from the snapshot.  The object sets built both
+ * ways are checked to contain the same number of objects and directives.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netsite.h"
+#include "frame/object.h"
+#include "frame/objset.h"
+#include "nspr.h"
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s -f obj.conf [-d snapdir] [-n iterations]\n", progname);
+    exit(1);
+}
+
+/*
+ * count_directives returns the number of directives in an object set.
+ */
+static int
+count_directives(const httpd_objset *os)
+{
+    int n = 0;
+    for (int x = 0; x < os->pos; x++) {
+        const httpd_object *obj = os->obj[x];
+        for (int dc = 0; dc < obj->nd; dc++)
+            n += obj->dt[dc].ni;
+    }
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *filename = NULL;
+    const char *snapdir = "/tmp";
+    int iterations = 100;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-f")) {
+            filename = argv[++i];
+        } else if (!strcmp(argv[i], "-d")) {
+            snapdir = argv[++i];
+        } else if (!strcmp(argv[i], "-n")) {
+            iterations = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!filename || iterations < 1)
+        usage(argv[0]);
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    httpd_objset *os = objset_load(filename, NULL);
+    if (!os) {
+        fprintf(stderr, "Unable to parse %s\n", filename);
+        return 1;
+    }
+    int nobjs = os->pos;
+    int ndirectives = count_directives(os);
+    objset_free(os);
+
+    PRIntervalTime start = PR_IntervalNow();
+    for (i = 0; i < iterations; i++)
+        objset_free(objset_load(filename, NULL));
+    double parse_us = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start) / iterations;
+
+    // The first load takes the snapshot (unless one is left over from an
+    // earlier run of the same file)
+    start = PR_IntervalNow();
+    os = objset_load_snapshot(filename, snapdir);
+    double first_us = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start);
+    if (!os) {
+        fprintf(stderr, "Unable to load %s\n", filename);
+        return 1;
+    }
+    objset_free(os);
+
+    start = PR_IntervalNow();
+    for (i = 0; i < iterations; i++) {
+        os = objset_load_snapshot(filename, snapdir);
+        if (!os || os->pos != nobjs || count_directives(os) != ndirectives) {
+            fprintf(stderr, "Snapshot of %s does not match the parsed file\n", filename);
+            return 1;
+        }
+        objset_free(os);
+    }
+    double snapshot_us = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start) / iterations;
+
+    printf("objects %d, directives %d, iterations %d\n", nobjs, ndirectives, iterations);
+    printf("%-20s %10.1f us/load\n", "parse", parse_us);
+    printf("%-20s %10.1f us/load\n", "first snapshot", first_us);
+    printf("%-20s %10.1f us/load\n", "snapshot", snapshot_us);
+    printf("%-20s %10.2fx\n", "speedup", snapshot_us > 0 ? parse_us / snapshot_us : 0.0);
+
+    PR_Cleanup();
+
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * putbench.cpp
+ *
+ * Uploads a file of the given size with PUT requests against a running
+ * server and reports the request rate, upload throughput and the number of
+ * responses that weren't 201 Created or 204 No Content.  Each thread uploads
+ * to its own URI (the given URI with the thread number appended) so uploads
+ * don't contend for the same file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nspr.h"
+#include "plstr.h"
+
+#define BUFFER_SIZE (64 * 1024)
+
+static const char *host = "localhost";
+static int port = 80;
+static const char *uri = NULL;
+static PRInt64 size = 0;
+static int requests = 10;
+static PRNetAddr addr;
+
+static PRInt32 total_requests;
+static PRInt32 total_errors;
+static PRInt32 total_unexpected;
+static PRInt64 total_bytes;
+static PRLock *total_lock;
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s -u uri -s size [-h host] [-p port] [-t threads] [-n requests]\n", progname);
+    exit(1);
+}
+
+static PRFileDesc *
+connect_server(void)
+{
+    PRFileDesc *fd = PR_NewTCPSocket();
+    if (fd && PR_Connect(fd, &addr, PR_INTERVAL_NO_TIMEOUT) != PR_SUCCESS) {
+        PR_Close(fd);
+        fd = NULL;
+    }
+    return fd;
+}
+
+/*
+ * send_body sends size bytes of entity body from buf, returning PR_FAILURE on
+ * error.
+ */
+static PRStatus
+send_body(PRFileDesc *fd, const char *buf)
+{
+    PRInt64 remaining = size;
+    while (remaining > 0) {
+        int len = remaining < BUFFER_SIZE ? (int) remaining : BUFFER_SIZE;
+        if (PR_Send(fd, buf, len, 0, PR_INTERVAL_NO_TIMEOUT) != len)
+            return PR_FAILURE;
+        remaining -= len;
+    }
+    return PR_SUCCESS;
+}
+
+/*
+ * read_response reads a response, returning the status code or -1 on error.
+ * The entity body is discarded.  *keep_alive is cleared if the server
+ * indicated it will close the connection.
+ */
+static int
+read_response(PRFileDesc *fd, char *buf, PRBool *keep_alive)
+{
+    int len = 0;
+    char *eoh = NULL;
+    while (!eoh) {
+        if (len == BUFFER_SIZE - 1)
+            return -1;
+        int rv = PR_Recv(fd, buf + len, BUFFER_SIZE - 1 - len, 0, PR_INTERVAL_NO_TIMEOUT);
+        if (rv <= 0)
+            return -1;
+        len += rv;
+        buf[len] = '\0';
+        eoh = strstr(buf, "\r\n\r\n");
+    }
+    *eoh = '\0';
+
+    int status = -1;
+    if (sscanf(buf, "HTTP/%*d.%*d %d", &status) != 1)
+        return -1;
+
+    PRInt64 content_length = 0;
+    for (char *p = strstr(buf, "\r\n"); p; p = strstr(p + 2, "\r\n")) {
+        if (!PL_strncasecmp(p + 2, "Content-length:", 15))
+            content_length = strtoll(p + 17, NULL, 10);
+        if (!PL_strncasecmp(p + 2, "Connection:", 11) && PL_strcasestr(p + 13, "close"))
+            *keep_alive = PR_FALSE;
+    }
+
+    PRInt64 remaining = content_length - (len - (eoh + 4 - buf));
+    while (remaining > 0) {
+        int rv = PR_Recv(fd, buf, remaining < BUFFER_SIZE ? (int) remaining : BUFFER_SIZE, 0, PR_INTERVAL_NO_TIMEOUT);
+        if (rv <= 0)
+            return -1;
+        remaining -= rv;
+    }
+
+    return status;
+}
+
+static void
+client_thread(void *arg)
+{
+    int id = (int) (size_t) arg;
+    char *buf = (char *) malloc(BUFFER_SIZE);
+    char *body = (char *) malloc(BUFFER_SIZE);
+    char request[1024];
+    PRFileDesc *fd = NULL;
+    int nrequests = 0;
+    int nerrors = 0;
+    int nunexpected = 0;
+    PRInt64 nbytes = 0;
+
+    for (int i = 0; i < BUFFER_SIZE; i++)
+        body[i] = 'a' + (i % 26);
+
+    int len = PR_snprintf(request, sizeof(request),
+                          "PUT %s%d HTTP/1.1\r\n"
+                          "Host: %s\r\n"
+                          "Content-length: %lld\r\n"
+                          "\r\n",
+                          uri, id, host, size);
+
+    for (int i = 0; i < requests; i++) {
+        if (!fd)
+            fd = connect_server();
+
+        PRBool keep_alive = PR_TRUE;
+        int status = -1;
+        if (fd && PR_Send(fd, request, len, 0, PR_INTERVAL_NO_TIMEOUT) == len &&
+            send_body(fd, body) == PR_SUCCESS)
+        {
+            status = read_response(fd, buf, &keep_alive);
+        }
+
+        nrequests++;
+        if (status == -1) {
+            nerrors++;
+        } else {
+            if (status != 201 && status != 204)
+                nunexpected++;
+            nbytes += size;
+        }
+
+        if (status == -1 || !keep_alive) {
+            if (fd)
+                PR_Close(fd);
+            fd = NULL;
+        }
+    }
+
+    if (fd)
+        PR_Close(fd);
+    free(body);
+    free(buf);
+
+    PR_Lock(total_lock);
+    total_requests += nrequests;
+    total_errors += nerrors;
+    total_unexpected += nunexpected;
+    total_bytes += nbytes;
+    PR_Unlock(total_lock);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int threads = 1;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-h")) {
+            host = argv[++i];
+        } else if (!strcmp(argv[i], "-p")) {
+            port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-u")) {
+            uri = argv[++i];
+        } else if (!strcmp(argv[i], "-s")) {
+            size = strtoll(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-t")) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-n")) {
+            requests = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!uri || size < 1 || threads < 1 || requests < 1)
+        usage(argv[0]);
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    PRHostEnt hostent;
+    char hostbuf[PR_NETDB_BUF_SIZE];
+    if (PR_GetHostByName(host, hostbuf, sizeof(hostbuf), &hostent) != PR_SUCCESS ||
+        PR_EnumerateHostEnt(0, &hostent, port, &addr) < 0)
+    {
+        fprintf(stderr, "Unable to resolve %s\n", host);
+        return 1;
+    }
+
+    total_lock = PR_NewLock();
+
+    PRThread **tids = (PRThread **) malloc(threads * sizeof(PRThread *));
+    PRIntervalTime start = PR_IntervalNow();
+    for (i = 0; i < threads; i++) {
+        tids[i] = PR_CreateThread(PR_USER_THREAD, client_thread, (void *) (size_t) (i + 1),
+                                  PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD,
+                                  PR_JOINABLE_THREAD, 0);
+    }
+    for (i = 0; i < threads; i++) {
+        if (tids[i])
+            PR_JoinThread(tids[i]);
+    }
+    double seconds = (double) PR_IntervalToMilliseconds(PR_IntervalNow() - start) / 1000.0;
+    if (seconds <= 0)
+        seconds = 0.001;
+
+    printf("threads %d, requests %d, errors %d, unexpected status %d\n",
+           threads, total_requests, total_errors, total_unexpected);
+    printf("%-20s %10.1f requests/s\n", "rate", total_requests / seconds);
+    printf("%-20s %10.1f MB/s\n", "throughput", (double) total_bytes / seconds / (1024 * 1024));
+
+    free(tids);
+    PR_DestroyLock(total_lock);
+
+    PR_Cleanup();
+
+    return (total_errors || total_unexpected) ? 1 : 0;
+}
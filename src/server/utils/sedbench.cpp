@@ -0,0 +1,192 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * sedbench.cpp
+ *
+ * Measures the throughput of the sed-response filter's engine.  An HTML
+ * body of the requested size is generated, either as short lines or as one
+ * long line like minified markup, and is streamed through a compiled sed
+ * script in write-sized chunks the way a FilterLayer receives it.  Reports
+ * MB/s for each script.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netsite.h"
+#include "base/util.h"
+#include "base/pool.h"
+#include "libsed/libsed.h"
+#include "nspr.h"
+
+static const char *scripts[] = {
+    "s/www\\.example\\.com/cdn.example.net/g",
+    "s/[Hh][Rr][Ee][Ff]=\"http:/href=\"https:/g",
+    "s/<\\/*b>//g",
+    NULL
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-s size] [-c chunk] [-n iterations] [-1] [-e script]\n", progname);
+    exit(1);
+}
+
+static void
+errf(void *data, const char *fmt, va_list args)
+{
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+}
+
+/*
+ * make_body returns size bytes of HTML, with a newline every few links
+ * unless oneline is set.
+ */
+static char *
+make_body(int size, PRBool oneline)
+{
+    char *body = (char *) malloc(size + 256);
+    int len = 0;
+    int i = 0;
+
+    while (len < size) {
+        len += PR_snprintf(body + len, 256,
+                           "<a href=\"http://www.example.com/page%d.html\">"
+                           "<b>page</b> %d</a>%s",
+                           i, i, (!oneline && i % 8 == 7) ? "\n" : " ");
+        i++;
+    }
+    body[size] = '\0';
+
+    return body;
+}
+
+static double
+run(const char *script, const char *body, int size, int chunk, int iterations, PRFileDesc *out)
+{
+    PRIntervalTime start = PR_IntervalNow();
+
+    for (int i = 0; i < iterations; i++) {
+        pool_handle_t *pool = pool_create();
+        sed_commands_t commands;
+        sed_eval_t eval;
+
+        if (sed_init_commands(&commands, errf, NULL, pool) != PR_SUCCESS ||
+            sed_compile_string(&commands, script) != PR_SUCCESS ||
+            sed_finalize_commands(&commands) != PR_SUCCESS ||
+            sed_init_eval(&eval, &commands, errf, NULL, pool) != PR_SUCCESS)
+        {
+            fprintf(stderr, "Unable to compile %s\n", script);
+            exit(1);
+        }
+
+        for (int offset = 0; offset < size; offset += chunk) {
+            int n = (size - offset < chunk) ? size - offset : chunk;
+            sed_eval_buffer(&eval, body + offset, n, out);
+        }
+        sed_finalize_eval(&eval, out);
+
+        sed_destroy_eval(&eval);
+        sed_destroy_commands(&commands);
+        pool_destroy(pool);
+    }
+
+    double seconds = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start) / 1000000.0;
+    if (seconds <= 0)
+        seconds = 0.000001;
+
+    return (double) size * iterations / seconds / (1024 * 1024);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int size = 4 * 1024 * 1024;
+    int chunk = 8192;
+    int iterations = 5;
+    PRBool oneline = PR_FALSE;
+    const char *script = NULL;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-1")) {
+            oneline = PR_TRUE;
+            continue;
+        }
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-s")) {
+            size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-c")) {
+            chunk = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-n")) {
+            iterations = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-e")) {
+            script = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (size < 1 || chunk < 1 || iterations < 1)
+        usage(argv[0]);
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    PRFileDesc *out = PR_Open("/dev/null", PR_WRONLY, 0);
+    if (!out) {
+        fprintf(stderr, "Unable to open /dev/null\n");
+        return 1;
+    }
+
+    char *body = make_body(size, oneline);
+
+    printf("%d byte %s body, %d byte writes, %d iterations\n",
+           size, oneline ? "single line" : "multi-line", chunk, iterations);
+    if (script) {
+        printf("%-48s %10.1f MB/s\n", script, run(script, body, size, chunk, iterations, out));
+    } else {
+        for (i = 0; scripts[i]; i++)
+            printf("%-48s %10.1f MB/s\n", scripts[i], run(scripts[i], body, size, chunk, iterations, out));
+    }
+
+    free(body);
+    PR_Close(out);
+
+    PR_Cleanup();
+
+    return 0;
+}
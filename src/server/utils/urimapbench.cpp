@@ -0,0 +1,165 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * urimapbench.cpp
+ *
+ * Compares the lookup rate of the UriMap tree walk (UriMap::map) with the
+ * flattened UriMapper (UriMapper::map) for a configurable number of mapped
+ * URI spaces.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nspr.h"
+#include "support/urimapper.h"
+
+#define NUM_REQUESTS 4096
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-n uri spaces] [-i iterations]\n", progname);
+    exit(1);
+}
+
+static double
+elapsed_ns(PRIntervalTime start, int lookups)
+{
+    PRIntervalTime elapsed = PR_IntervalNow() - start;
+    return (double)PR_IntervalToMicroseconds(elapsed) * 1000.0 / lookups;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int spaces = 1000;
+    int iterations = 500;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-n")) {
+            spaces = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-i")) {
+            iterations = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (spaces < 1 || iterations < 1)
+        usage(argv[0]);
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    // Web application style URI spaces, some with nested spaces
+    UriMap<long> map;
+    for (i = 0; i < spaces; i++) {
+        char path[64];
+        sprintf(path, "/app%d", i);
+        map.addUriSpace(path, i + 1);
+        if (i % 4 == 0) {
+            sprintf(path, "/app%d/static/", i);
+            map.addUriSpace(path, spaces + i + 1);
+        }
+    }
+
+    UriMapper<long> mapper(map);
+
+    // Mix of hits at various depths, exact matches, ;params and misses
+    static char requests[NUM_REQUESTS][128];
+    unsigned int x = 2463534242u;
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        int app = x % (spaces + spaces / 8 + 1);
+        switch (x % 5) {
+        case 0:
+            sprintf(requests[i], "/app%d", app);
+            break;
+        case 1:
+            sprintf(requests[i], "/app%d/index.jsp", app);
+            break;
+        case 2:
+            sprintf(requests[i], "/app%d/static/images/logo.gif", app);
+            break;
+        case 3:
+            sprintf(requests[i], "/app%d/servlet/Login;jsessionid=%08x", app, x);
+            break;
+        default:
+            sprintf(requests[i], "/other%d/index.html", app);
+            break;
+        }
+    }
+
+    // Make sure both agree before timing anything
+    int mismatches = 0;
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        if (!strchr(requests[i], ';') &&
+            map.map(requests[i]) != mapper.map((const char *)requests[i]))
+            mismatches++;
+    }
+
+    int lookups = iterations * NUM_REQUESTS;
+    long sum = 0;
+    PRIntervalTime start;
+
+    start = PR_IntervalNow();
+    for (int iter = 0; iter < iterations; iter++) {
+        for (i = 0; i < NUM_REQUESTS; i++)
+            sum += map.map(requests[i]);
+    }
+    double ns_map = elapsed_ns(start, lookups);
+
+    start = PR_IntervalNow();
+    for (int iter = 0; iter < iterations; iter++) {
+        for (i = 0; i < NUM_REQUESTS; i++) {
+            const char *suffix;
+            const char *param;
+            sum += mapper.map((const char *)requests[i], &suffix, &param);
+        }
+    }
+    double ns_mapper = elapsed_ns(start, lookups);
+
+    printf("uri spaces %d, lookups %d, mismatches %d (checksum %ld)\n",
+           spaces, lookups, mismatches, sum);
+    printf("%-20s %10.1f ns/lookup\n", "UriMap::map", ns_map);
+    printf("%-20s %10.1f ns/lookup\n", "UriMapper::map", ns_mapper);
+
+    PR_Cleanup();
+
+    return mismatches ? 1 : 0;
+}
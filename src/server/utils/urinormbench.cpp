@@ -0,0 +1,246 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * urinormbench.cpp
+ *
+ * Measures util_canonicalize_uri_unescape against the two pass
+ * util_canonicalize_uri and util_uri_unescape_strict sequence it replaces
+ * in the request path, and with -f checks that both produce the same
+ * result for randomly generated URIs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netsite.h"
+#include "base/pool.h"
+#include "base/util.h"
+#include "nspr.h"
+
+static const char *uris[] = {
+    "/",
+    "/index.html",
+    "/images/logos/heliod-banner-large.png",
+    "/docs/2011/release%20notes/Installation%20Guide.html",
+    "/app/./static/../static//css/site.min.css",
+    "/cgi-bin/search.cgi;jsessionid=0123456789ABCDEF",
+    "/a/very/long/path/with/many/segments/to/walk/through/before/reaching/the/file/at/the/end/of/it.html",
+    NULL
+};
+
+/* Pieces random URIs are assembled from */
+static const char *pieces[] = {
+    "/", "/", "/", ".", "..", ";", "a", "bc", "index.html",
+    "%", "%4", "%41", "%7e", "%2E", "%2e%2E", "%2F", "%2f", "%00", "%zz", "%%",
+    "abcdefghijklmnopqrstuvwxyz"
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-n iterations] [-f fuzz-iterations] [-u uri]\n", progname);
+    exit(1);
+}
+
+static int
+two_pass(pool_handle_t *pool, const char *uri, int len, char **pcanon, int *pcanonlen)
+{
+    char *canon = util_canonicalize_uri(pool, uri, len, NULL);
+    if (!canon)
+        return -1;
+
+    if (!util_uri_unescape_strict(canon))
+        return 0;
+
+    *pcanon = canon;
+    *pcanonlen = strlen(canon);
+
+    return 1;
+}
+
+static char *
+make_uri(char *buf, int size, int *plen)
+{
+    int len = 0;
+
+    /* most start with '/', like a request's abs_path */
+    if (rand() % 8)
+        buf[len++] = '/';
+
+    while (len < size) {
+        const char *piece;
+        if (rand() % 16 == 0) {
+            /* an arbitrary byte other than NUL */
+            static char c[2];
+            c[0] = (char) (1 + rand() % 255);
+            piece = c;
+        } else {
+            piece = pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))];
+        }
+
+        int n = strlen(piece);
+        if (len + n > size)
+            break;
+        memcpy(buf + len, piece, n);
+        len += n;
+    }
+
+    *plen = len;
+
+    return buf;
+}
+
+static int
+fuzz(int iterations)
+{
+    char buf[256];
+    int failures = 0;
+    int rvs[3] = { 0, 0, 0 };
+
+    for (int i = 0; i < iterations; i++) {
+        pool_handle_t *pool = pool_create();
+        int len;
+
+        /* short URIs hit the byte loop, longer ones the vector loop */
+        make_uri(buf, 1 + rand() % ((i & 1) ? 24 : (int) sizeof(buf)), &len);
+
+        char *expected = NULL;
+        int expectedLen = 0;
+        int rvExpected = two_pass(pool, buf, len, &expected, &expectedLen);
+
+        char *actual = NULL;
+        int actualLen = 0;
+        int rvActual = util_canonicalize_uri_unescape(pool, buf, len, &actual, &actualLen);
+
+        if (rvActual != rvExpected ||
+            (rvActual == 1 && (actualLen != expectedLen || memcmp(actual, expected, actualLen))))
+        {
+            fprintf(stderr, "Mismatch for \"%.*s\": expected %d \"%s\", got %d \"%s\"\n",
+                    len, buf, rvExpected, rvExpected == 1 ? expected : "",
+                    rvActual, rvActual == 1 ? actual : "");
+            failures++;
+        }
+        rvs[rvExpected + 1]++;
+
+        pool_destroy(pool);
+    }
+
+    printf("%d URIs: %d outside document root, %d invalid, %d valid, %d mismatches\n",
+           iterations, rvs[0], rvs[1], rvs[2], failures);
+
+    return failures;
+}
+
+typedef int (*decode_fn)(pool_handle_t *pool, const char *uri, int len, char **pcanon, int *pcanonlen);
+
+static double
+run(decode_fn fn, const char *uri, int iterations)
+{
+    int len = strlen(uri);
+    pool_handle_t *pool = pool_create();
+    PRIntervalTime start = PR_IntervalNow();
+
+    for (int i = 0; i < iterations; i++) {
+        char *canon;
+        int canonlen;
+        fn(pool, uri, len, &canon, &canonlen);
+        if (i % 1000 == 999) {
+            pool_destroy(pool);
+            pool = pool_create();
+        }
+    }
+
+    double seconds = (double) PR_IntervalToMicroseconds(PR_IntervalNow() - start) / 1000000.0;
+    if (seconds <= 0)
+        seconds = 0.000001;
+
+    pool_destroy(pool);
+
+    return seconds * 1000000000.0 / iterations;
+}
+
+static void
+bench(const char *uri, int iterations)
+{
+    double ns2 = run(two_pass, uri, iterations);
+    double ns1 = run(util_canonicalize_uri_unescape, uri, iterations);
+
+    printf("%-48.48s %8.1f ns %8.1f ns %6.2fx\n", uri, ns2, ns1, ns2 / ns1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int iterations = 1000000;
+    int fuzzIterations = 0;
+    const char *uri = NULL;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        if (!strcmp(argv[i], "-n")) {
+            iterations = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-f")) {
+            fuzzIterations = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-u")) {
+            uri = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (iterations < 1 || fuzzIterations < 0)
+        usage(argv[0]);
+
+    PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+
+    if (fuzzIterations) {
+        srand(PR_IntervalNow());
+        int failures = fuzz(fuzzIterations);
+        PR_Cleanup();
+        return failures ? 1 : 0;
+    }
+
+    printf("%-48s %11s %11s %7s\n", "URI", "two pass", "one pass", "");
+    if (uri) {
+        bench(uri, iterations);
+    } else {
+        for (i = 0; uris[i]; i++)
+            bench(uris[i], iterations);
+    }
+
+    PR_Cleanup();
+
+    return 0;
+}
@@ -87,12 +87,15 @@ int _watchdog_server_init_done;
 int _watchdog_server_death;
 int _watchdog_server_rotate;
 int _watchdog_server_restart;
+int _watchdog_server_upgrade;
 int _watchdog_server_start_error = 1;
 int _watchdog_stop_waiting_for_messages         = 0;
 int _watchdog_admin_is_waiting_for_reply        = 0;
 int _watchdog_admin_waiting_for_reconfig_status = 0;
 int _watchdog_created_tempdir = 0;
 int _watchdog_server_pid = -1;
+int _watchdog_upgrade_pid = -1;
+int _watchdog_draining_pid = -1;
 int _watchdog_parent_pid = -1;
 int _watchdog_detach = 1;
 int _watchdog_use_stderr = 1;
@@ -112,6 +115,8 @@ wdSMF *wdsmf = NULL;
 #endif // FEAT_SMF
 
 void watchdog_exit(int status);
+int _watchdog_exec(int server_starts, const char *server_exe,
+                   char * argv[], char * envp[], int *spid);
 
 wdLSmanager     LS;
 
@@ -125,6 +130,16 @@ char errmsgstr[1024];
 //
 wdServerMessage* adminChannel = NULL;
 
+//
+// Hot upgrade (SIGUSR2): a new server generation is started next to the
+// running one and picks up the same listen sockets through GetLS.  Once it
+// sends EndInit it becomes the current server and the old generation is
+// told to terminate, which lets it finish its keep-alive connections while
+// the new one is already accepting.  drainingChannel is the admin channel
+// of that old generation.
+//
+wdServerMessage* drainingChannel = NULL;
+
 void
 watchdog_info(const char *msgstring)
 {
@@ -230,6 +245,132 @@ watchdog_kill_server(void)
     }
 }
 
+static void
+watchdog_reap_draining_server(void)
+{
+    int stat, rv;
+
+    if (_watchdog_draining_pid == -1)
+        return;
+
+    rv = waitpid(_watchdog_draining_pid, &stat, WNOHANG);
+    if (rv == _watchdog_draining_pid || (rv < 0 && errno == ECHILD)) {
+        _watchdog_draining_pid = -1;
+        drainingChannel = NULL;
+        /* Listeners only the previous configuration used */
+        LS.unbind_stale();
+    }
+}
+
+void
+watchdog_upgrade_server(int server_starts, const char *server_exe,
+                        char * argv[], char * envp[])
+{
+    _watchdog_server_upgrade = 0;
+
+    /* The old generation may have exited while SIGCHLD was ignored */
+    watchdog_reap_draining_server();
+
+    if (_watchdog_upgrade_pid != -1 || _watchdog_draining_pid != -1) {
+        watchdog_error("server upgrade ignored: previous upgrade still in progress");
+        return;
+    }
+    if (adminChannel == NULL) {
+        watchdog_error("server upgrade ignored: server is not running");
+        return;
+    }
+
+    /*
+     * Start the new generation; the running server keeps accepting on
+     * the shared listen sockets until the new one has initialized.
+     */
+    LS.begin_generation();
+    _watchdog_exec(server_starts + 1, server_exe, argv, envp,
+                   &_watchdog_upgrade_pid);
+    if (_watchdog_upgrade_pid < 0) {
+        watchdog_errno("could not start new server generation");
+        _watchdog_upgrade_pid = -1;
+    }
+}
+
+void
+watchdog_promote_server(void)
+{
+    /* Called when the new generation sends EndInit */
+    _watchdog_draining_pid = _watchdog_server_pid;
+    drainingChannel = adminChannel;
+    _watchdog_server_pid = _watchdog_upgrade_pid;
+    _watchdog_upgrade_pid = -1;
+    adminChannel = NULL;
+
+    if (drainingChannel != NULL) {
+        if (drainingChannel->SendToServer(wdmsgTerminate, NULL) == 0)
+            watchdog_errno("error communicating with previous server");
+    } else {
+        kill(_watchdog_draining_pid, SIGTERM);
+    }
+}
+
+void
+watchdog_abort_upgrade(void)
+{
+    int stat, rv;
+
+    if (_watchdog_upgrade_pid == -1)
+        return;
+
+    watchdog_error("server upgrade aborted");
+    kill(_watchdog_upgrade_pid, SIGTERM);
+    do {
+        rv = waitpid(_watchdog_upgrade_pid, &stat, 0);
+    } while ((rv < 0) && (errno == EINTR));
+    _watchdog_upgrade_pid = -1;
+}
+
+int
+watchdog_reap_generations(void)
+{
+    /*
+     * SIGCHLD does not say which child exited.  Reap a new generation
+     * that failed during initialization or an old one that has finished
+     * draining, and leave _watchdog_server_death set only if it was the
+     * current server that exited.  Returns non-zero if it was.
+     *
+     * Loops that wait for the current server to exit call this in their
+     * condition rather than testing _watchdog_server_death directly, so a
+     * SIGCHLD from another generation that arrives after the last reap
+     * cannot end the loop and leave the watchdog blocked in waitpid().
+     */
+    int stat, rv;
+    siginfo_t si;
+
+    if (!_watchdog_server_death)
+        return 0;
+
+    _watchdog_server_death = 0;
+
+    if (_watchdog_upgrade_pid != -1) {
+        rv = waitpid(_watchdog_upgrade_pid, &stat, WNOHANG);
+        if (rv == _watchdog_upgrade_pid || (rv < 0 && errno == ECHILD)) {
+            watchdog_error("new server generation failed to initialize");
+            _watchdog_upgrade_pid = -1;
+        }
+    }
+
+    watchdog_reap_draining_server();
+
+    memset(&si, 0, sizeof(si));
+    rv = waitid(P_PID, _watchdog_server_pid, &si,
+                WEXITED | WNOHANG | WNOWAIT);
+    if ((rv == 0 && si.si_pid == _watchdog_server_pid) ||
+        (rv < 0 && errno == ECHILD)) {
+        _watchdog_server_death = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
 void
 watchdog_rotate_server_logs(void)
 {
@@ -322,6 +463,13 @@ watchdog_exit(int status)
         }
     }
 
+    if (_watchdog_upgrade_pid != -1)
+        kill(_watchdog_upgrade_pid, SIGTERM);
+
+    /* An old generation still draining goes down with us too */
+    if (_watchdog_draining_pid != -1)
+        kill(_watchdog_draining_pid, SIGTERM);
+
     if (_watchdog_server_pid != -1) {
         /* Take the server down with us */
         watchdog_kill_server();
@@ -489,6 +637,8 @@ void process_server_messages(int nmessages, int server_starts)
                 /* HUP seen on this socket */
                 LS.msg_table[i]._waiting = 0;   // Clear it
                 LS.pa_table[i].fd        = -1;  // no more on this socket
+                if (drainingChannel == LS.msg_table[i].wdSM)
+                    drainingChannel = NULL;
                 if(LS.msg_table[i].wdSM!=NULL)  // might be null from EmptyRead
                     delete LS.msg_table[i].wdSM;
                 LS.msg_table[i].wdSM = NULL;    // Clear it
@@ -528,8 +678,16 @@ void process_server_messages(int nmessages, int server_starts)
                         parse_LS_message_string(msgstring, &ls_name, &new_ip,
                                                 &port, &family, &lsQsize, 
                                                 &sendBsize, &recvBsize);
-                        newfd = LS.removeLS(ls_name, new_ip, port, family,
-                                            lsQsize, sendBsize, recvBsize);
+                        /*
+                         * While generations overlap the socket is shared,
+                         * so only the current primordial may close it.
+                         */
+                        if ((_watchdog_upgrade_pid == -1 &&
+                             _watchdog_draining_pid == -1) ||
+                            wdSM == adminChannel) {
+                            newfd = LS.removeLS(ls_name, new_ip, port, family,
+                                                lsQsize, sendBsize, recvBsize);
+                        }
                         if (wdSM->SendToServer( wdmsgCloseLSreply, NULL) ==0) {
                                 watchdog_errno("error communicating with server");
                         }
@@ -541,6 +699,8 @@ void process_server_messages(int nmessages, int server_starts)
                         assert(LS.msg_table[i].wdSM!=NULL);
                         if (adminChannel == LS.msg_table[i].wdSM)
                             adminChannel = NULL;
+                        if (drainingChannel == LS.msg_table[i].wdSM)
+                            drainingChannel = NULL;
                         delete LS.msg_table[i].wdSM;
                         LS.msg_table[i].wdSM = NULL;    // Clear it
                         if (_watchdog_admin_is_waiting_for_reply == i)
@@ -597,6 +757,10 @@ void process_server_messages(int nmessages, int server_starts)
                         }
                         break;
                     case wdmsgEndInit:
+                        if (_watchdog_upgrade_pid != -1) {
+                            /* New generation is ready: retire the old one */
+                            watchdog_promote_server();
+                        }
                         rv = watchdog_logpid();
                         if (rv) {
                             sprintf(errmsgstr,
@@ -724,6 +888,7 @@ void process_server_messages(int nmessages, int server_starts)
 void wait_for_message(int server_starts)
 {
     int nmsgs = LS.Wait_for_Message();
+    watchdog_reap_generations();
     if (nmsgs == 0) return;
     else if (nmsgs > 0) {
         process_server_messages(nmsgs,server_starts);
@@ -1039,6 +1204,7 @@ int main(int argc, char **argv, char **envp)
         _watchdog_server_death                          = 0;
         _watchdog_server_rotate                         = 0;
         _watchdog_server_restart                        = 0;
+        _watchdog_server_upgrade                        = 0;
         _watchdog_stop_waiting_for_messages             = 0;
         _watchdog_admin_waiting_for_reconfig_status     = 0;
 
@@ -1064,9 +1230,9 @@ int main(int argc, char **argv, char **envp)
             if (_watchdog_death)
                 watchdog_kill_server();
 
-            if (_watchdog_server_death) {
+            if (watchdog_reap_generations()) {
                 do {
-                    rv = wait(&server_stat);
+                    rv = waitpid(_watchdog_server_pid, &server_stat, 0);
                 } while ((rv < 0) && (errno == EINTR));
 
                 if (transient_child) {
@@ -1157,7 +1323,7 @@ int main(int argc, char **argv, char **envp)
         /* Main Loop:                                   */
         /* Just wait for requests from the server until */
         /*      a SIGCHLD or other action is signalled  */
-        while(!_watchdog_server_death) {
+        while (!watchdog_reap_generations()) {
             if (_watchdog_server_rotate) {
                 _watchdog_server_rotate = 0;
                 watchdog_rotate_server_logs();
@@ -1168,9 +1334,17 @@ int main(int argc, char **argv, char **envp)
                 break;
             }
 
+            if (_watchdog_server_upgrade) {
+                watchdog_upgrade_server(server_starts, server_exe,
+                                        argv, envp);
+            }
+
             wait_for_message(server_starts);
         }
 
+        /* A generation still initializing goes down with this one */
+        watchdog_abort_upgrade();
+
         if (_watchdog_server_death && !_watchdog_killed_server) {
             // server died but watchdog did not terminate it
             if (n_reconfigDone>0) {
@@ -1181,12 +1355,13 @@ int main(int argc, char **argv, char **envp)
         }
 
         /* Shutdown loop: ends when server terminates   */
-        while (!_watchdog_server_death && !_watchdog_stop_waiting_for_messages) {
+        while (!watchdog_reap_generations() &&
+               !_watchdog_stop_waiting_for_messages) {
             wait_for_message(server_starts);
         }
 
         do {
-            rv = wait(&server_stat);
+            rv = waitpid(_watchdog_server_pid, &server_stat, 0);
         } while ((rv < 0) && (errno == EINTR));
 
         if ((rv < 0) && (errno == ECHILD)) {
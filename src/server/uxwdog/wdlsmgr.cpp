@@ -82,6 +82,7 @@ default_port(80),
 ls_count(0),
 ls_table(NULL),
 ls_table_size(INITIAL_LS_SIZE),
+ls_generation(0),
 pa_count(0), pa_table(NULL), pa_table_size(INITIAL_PA_SIZE)
 {
 }
@@ -116,6 +117,27 @@ int wdLSmanager::get_table_size(void)
     return pa_table_size;
 }
 
+void wdLSmanager::begin_generation(void)
+{
+    ls_generation++;
+}
+
+void wdLSmanager::unbind_stale(void)
+{
+    /* Close the sockets the current generation did not ask for */
+    int i;
+    if (ls_table != NULL) {
+        for (i = 0; i < ls_count; i++) {
+            if (ls_table[i].port != -1 &&
+                ls_table[i].generation != ls_generation) {
+                close(ls_table[i].fd);
+                ls_table[i].fd = -1;
+                ls_table[i].port = -1;
+            }
+        }
+    }
+}
+
 int wdLSmanager::create_new_LS(char *UDS_Name, char *new_IP, int new_port,
                                int family, int ls_Qsize, int SendBSize, 
                                int RecvBSize)
@@ -263,6 +285,7 @@ void wdLSmanager::Initialize_new_ls_table(int table_start, int table_size)
         ls_table[i].listen_queue_size = -1;
         ls_table[i].send_buff_size = -1;
         ls_table[i].recv_buff_size = -1;
+        ls_table[i].generation = -1;
     }
 }
 
@@ -443,6 +466,7 @@ int wdLSmanager::getNewLS(char *new_ls_name, char *new_IP, int new_port,
                      ls_Qsize, SendBSize, RecvBSize);
     if (i >= 0) {
         /* found it: return LS */
+        ls_table[i].generation = ls_generation;
         return ls_table[i].fd;
     }
 
@@ -521,6 +545,7 @@ int wdLSmanager::addLS(char *ls_name, char *ip, int port, int family,
     ls_table[index].listen_queue_size = ls_Qsize;
     ls_table[index].send_buff_size = SendBSize;
     ls_table[index].recv_buff_size = RecvBSize;
+    ls_table[index].generation = ls_generation;
     return 1;
 }
 
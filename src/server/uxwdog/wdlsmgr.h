@@ -71,6 +71,7 @@ typedef struct _wdLS_entry {
         int     listen_queue_size;
         int     send_buff_size;
         int     recv_buff_size;
+        int     generation;     /* last server generation to use it     */
 } wdLS_entry;
 
 typedef struct _msg_info {
@@ -103,6 +104,11 @@ class wdLSmanager {
         void    unbind_all              (void);
         int     get_table_size          (void);
 
+        /* Hot upgrade: tag sockets requested by a new server generation */
+        /* and close the ones that only the retired generation used      */
+        void    begin_generation        (void);
+        void    unbind_stale            (void);
+
   private:
         void    Initialize_new_ls_table (int table_start, int table_size);
         int     lookupLS                (char * new_ls_name, char * new_IP,
@@ -120,6 +126,7 @@ class wdLSmanager {
 
         int     ls_count;               /* Number of entries entered    */
         int     ls_table_size;          /* Number of entries allocated  */
+        int     ls_generation;          /* Current server generation    */
         int     msg_listener_fd;        /* socket for talking to server */
 
         int     pa_count;               /* Number of entries used       */
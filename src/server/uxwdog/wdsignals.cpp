@@ -47,6 +47,7 @@ extern int _watchdog_server_init_done;
 extern int _watchdog_server_death;
 extern int _watchdog_server_rotate;
 extern int _watchdog_server_restart;
+extern int _watchdog_server_upgrade;
 extern int _watchdog_server_start_error;
 
 static int watchdog_pending_signal = 0;
@@ -75,6 +76,7 @@ sig_usr1(int sig)
 static void
 sig_usr2(int sig)
 {
+    _watchdog_server_upgrade = 1;
     watchdog_pending_signal = 1;
 }
 
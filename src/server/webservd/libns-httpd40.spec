@@ -74,6 +74,13 @@ arch            all
 version         SUNW_1.1
 end
 
+function        dr_cache_init_size
+declaration     PRInt32 dr_cache_init_size(DrHdl *hdl, RefreshFunc_t ref, FreeFunc_t fre, CompareFunc_t cmp, PRUint64 maxBytes, PRIntervalTime maxAge)
+include         "drnsapi.h"
+arch            all
+version         SUNW_1.2
+end
+
 function        dr_cache_refresh
 declaration     PRInt32 dr_cache_refresh(DrHdl hdl, const char *key, PRUint32 klen, PRIntervalTime timeout, Entry *entry, Request *rq, Session *sn)
 include         "drnsapi.h"
@@ -835,6 +842,11 @@ arch            all
 version         SUNWprivate
 end
 
+function        cache_get_stats
+arch            all
+version         SUNWprivate
+end
+
 function        cache_insert
 arch            all
 version         SUNWprivate
@@ -1455,6 +1467,11 @@ arch            all
 version         SUNWprivate
 end
 
+function        filter_read_transparent
+arch            all
+version         SUNWprivate
+end
+
 function        find_user_dbm
 arch            all
 version         SUNWprivate
@@ -1955,6 +1972,16 @@ arch            all
 version         SUNWprivate
 end
 
+function        httpfilter_can_splice_request_body
+arch            all
+version         SUNWprivate
+end
+
+function        httpfilter_splice_request_body
+arch            all
+version         SUNWprivate
+end
+
 function        https_SHA1_Hash
 arch            all
 version         SUNWprivate
@@ -4950,6 +4977,11 @@ arch            all
 version         SUNWprivate
 end
 
+function        GetSSLSessionInfo
+arch            all
+version         SUNWprivate
+end
+
 function        GetMagnusSecurityOptions
 arch            all
 version         SUNWprivate
@@ -5320,6 +5352,11 @@ arch            all
 version         SUNWprivate
 end
 
+function        http_match_if_range
+arch            all
+version         SUNWprivate
+end
+
 function        http_check_preconditions
 arch            all
 version         SUNWprivate
@@ -124,6 +124,24 @@ PR_IMPLEMENT(PRStatus) PR_AR_GetHostByAddr( const PRNetAddr *addrp,
 PR_IMPLEMENT(PRStatus) PR_AR_GetHostByName( const char *name, char *buf,
     PRIntn bufsize, PRHostEnt *hentp, PRIntervalTime timeout, PRUint16 af )
 {
+    return PR_AR_GetHostByNameTTL(name, buf, bufsize, hentp, timeout, af, NULL);
+}
+
+/*
+ * PR_AR_GetHostByNameTTL
+ *
+ *  Same as PR_AR_GetHostByName(), but also returns the time to live of
+ *  the answer so callers can cache it for as long as the DNS server
+ *  allows.
+ */
+
+PR_IMPLEMENT(PRStatus) PR_AR_GetHostByNameTTL( const char *name, char *buf,
+    PRIntn bufsize, PRHostEnt *hentp, PRIntervalTime timeout, PRUint16 af,
+    PRUint32 *ttl )
+{
+    if (ttl)
+        *ttl = PR_AR_TTL_UNKNOWN;
+
     if ( (NULL == name) || (NULL == buf) || (0 == bufsize) || (NULL == hentp) )
     {
         return PR_FAILURE;
@@ -141,6 +159,8 @@ PR_IMPLEMENT(PRStatus) PR_AR_GetHostByName( const char *name, char *buf,
     DNSSession newsession(name, af, timeout, buf, bufsize, hentp);
     if (PR_TRUE == resolver->process(&newsession))
     {
+            if (ttl)
+                *ttl = newsession.getTTL();
             return PR_SUCCESS;
     }
 #endif
@@ -148,6 +168,28 @@ PR_IMPLEMENT(PRStatus) PR_AR_GetHostByName( const char *name, char *buf,
     return PR_FAILURE;
 }
 
+/*
+ * PR_AR_SetNameServer
+ *
+ *  Directs queries to a specific name server instead of those listed in
+ *  the resolv.conf file.
+ */
+
+PR_IMPLEMENT(PRStatus) PR_AR_SetNameServer( const PRNetAddr *addr )
+{
+    if ( (NULL == addr) || (NULL == resolver) )
+    {
+        return PR_FAILURE;
+    }
+
+#ifdef XP_UNIX
+    resolver->setNameServer(addr);
+    return PR_SUCCESS;
+#else
+    return PR_FAILURE;
+#endif
+}
+
 PRBool GetAsyncDNSInfo(asyncDNSInfo *info)
 {
     memset(info, 0, sizeof(asyncDNSInfo));
@@ -48,6 +48,9 @@ PR_BEGIN_EXTERN_C
 #define PR_AR_MAXHOSTENTBUF 1024
 #define PR_AR_DEFAULT_TIMEOUT	0
 
+/* TTL returned when the resolver doesn't know a record's time to live */
+#define PR_AR_TTL_UNKNOWN	0xffffffff
+
 /* Error return codes */
 #define PR_AR_OK	0
 
@@ -64,6 +67,21 @@ PR_EXTERN(PRStatus) 	PR_AR_GetHostByName(
         PRUint16
 );
 
+/*
+ * PR_AR_GetHostByNameTTL is PR_AR_GetHostByName that also returns the
+ * smallest TTL, in seconds, of the answer records.  The TTL is
+ * PR_AR_TTL_UNKNOWN when the asynchronous resolver isn't running.
+ */
+PR_EXTERN(PRStatus) 	PR_AR_GetHostByNameTTL(
+	const char *,
+        char *,
+        PRIntn,
+	PRHostEnt *,
+        PRIntervalTime,
+        PRUint16,
+        PRUint32 *
+);
+
 PR_EXTERN(PRStatus) 	PR_AR_GetHostByAddr(
 	const PRNetAddr *,
         char *,
@@ -72,6 +90,14 @@ PR_EXTERN(PRStatus) 	PR_AR_GetHostByAddr(
         PRIntervalTime
 );
 
+/*
+ * PR_AR_SetNameServer makes the asynchronous resolver send its queries to
+ * addr instead of the name servers in resolv.conf, e.g. to test against a
+ * local stub DNS server.  Only UDP queries are redirected.  Fails if
+ * PR_AR_Init hasn't started the resolver.
+ */
+PR_EXTERN(PRStatus) 	PR_AR_SetNameServer(const PRNetAddr *);
+
 typedef struct asyncDNSInfo {
     PRBool   enabled;
     PRUint32 numNameLookups;
@@ -143,6 +143,17 @@ hostent* DNSSession :: getArhost()
     return &ar_host;
 }
 
+PRUint32 DNSSession :: getTTL() const
+{
+    return re_ttl;
+}
+
+void DNSSession :: updateTTL(PRUint32 ttl)
+{
+    if (ttl < re_ttl)
+        re_ttl = ttl;
+}
+
 hent& DNSSession :: getHent()
 {
     return re_he;
@@ -211,6 +222,7 @@ void DNSSession :: common(PRIntervalTime tm)
     memset(re_name, 0, sizeof(re_name));
     memset((void*)&re_he, 0, sizeof(re_he));
     memset((void*)&ar_host, 0, sizeof(ar_host));
+    re_ttl = PR_AR_TTL_UNKNOWN;
 }
 
 void DNSSession :: setRename(const char* inname)
@@ -676,6 +688,9 @@ Resolver :: Resolver(PRIntervalTime timeout)
 
     afd = NULL;
 
+    ar_use_nameserver = PR_FALSE;
+    memset(&ar_nameserver, 0, sizeof(ar_nameserver));
+
     // then create a DNS manager background thread
 
     PRThread* ar_worker = PR_CreateThread(PR_SYSTEM_THREAD,
@@ -800,6 +815,18 @@ DNSSessionHash& Resolver :: getHTable()
     return DNShash;
 }
 
+/*
+ * setNameServer
+ *
+ * Sends UDP queries to addr instead of the name servers listed in the
+ * resolv.conf file.
+ */
+void Resolver :: setNameServer(const PRNetAddr* addr)
+{
+    ar_nameserver = *addr;
+    ar_use_nameserver = PR_TRUE;
+}
+
 PRLock* Resolver :: getDnsLock()
 {
     return dnslock;
@@ -952,8 +979,8 @@ PRBool Resolver :: process(DNSSession* session)
     
             memset((char *)rp, 0, sizeof(resi));
             ar_reinfo.re_na_look++;
-            strncpy(host, session->getName(), 64);
-            host[64] = '\0';
+            strncpy(host, session->getName(), sizeof(host) - 1);
+            host[sizeof(host) - 1] = '\0';
     
             locstatus = PR_TRUE;
             switch(session->getFamily())
@@ -1115,6 +1142,15 @@ int Resolver :: ar_send_res_msg(char *msg, int len, int rcount)
             afd = NULL;
         }
     }
+    else if (ar_use_nameserver)
+    {
+        if (PR_SendTo(afd, msg, len, 0,
+            &ar_nameserver,
+            PR_INTERVAL_NO_TIMEOUT) == len) {
+            ar_reinfo.re_sent++;
+            sent++;
+        }
+    }
     else
         for (i = 0; i < rcount; i++)
         {
@@ -1222,7 +1258,9 @@ int Resolver :: do_query_name(resinfo_t *resi, const char *name, DNSSession* ses
     char    hname[MAXDNAME];
     int    len;
 
-    len = strlen((char *)strncpy(hname, session->getName(), sizeof(hname)-1));
+    strncpy(hname, session->getName(), sizeof(hname)-1);
+    hname[sizeof(hname)-1] = '\0';
+    len = strlen(hname);
 
     /*
      * Store the name passed as the one to lookup and generate other host
@@ -1384,7 +1422,7 @@ int Resolver :: ar_procanswer(DNSSession* session, HEADER* hptr, u_char* buf, u_
         cp += sizeof(short);
         xclass = (int)GetShort(cp);
         cp += sizeof(short);
-        /* ttl = */ (void)(PRUint32)GetLong(cp);
+        session->updateTTL((PRUint32)GetLong(cp));
         cp += INT32SZ;
         dlen =  (int)GetShort(cp);
         cp += sizeof(short);
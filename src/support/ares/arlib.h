@@ -171,6 +171,9 @@ class DNSSession
         hostent* getArhost();
 
         datapacket* getData();
+
+        PRUint32 getTTL() const;    // smallest TTL of the answer records
+        void updateTTL(PRUint32 ttl);
        
     protected:
         PRBool awake;
@@ -197,7 +200,7 @@ class DNSSession
         int re_sent;
         char re_srch;
         char re_type;
-        char re_name[65];
+        char re_name[MAXDNAME];
         hent re_he;
         in6_addr re_addr;
         char re_addrtype;
@@ -205,6 +208,7 @@ class DNSSession
         datapacket* re_data;
         char re_retries;
         hostent ar_host;
+        PRUint32 re_ttl;
 };
 
 // linked list of DNS sessions
@@ -322,6 +326,7 @@ class Resolver
         PRInt32 getNameLookups() const;
         PRInt32 getAddrLookups() const;
         PRInt32 getCurrentLookups() const;
+        void setNameServer(const PRNetAddr* addr);
 
     protected:
         int ar_vc;
@@ -337,6 +342,8 @@ class Resolver
         PRInt32 namelookups;
         PRInt32 addrlookups;
         PRInt32 curlookups;
+        PRBool ar_use_nameserver; // send UDP queries to ar_nameserver
+        PRNetAddr ar_nameserver;
 };
 
 const PRInt32 ARES_CALLINIT = 2;
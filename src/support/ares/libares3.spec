@@ -71,11 +71,21 @@ arch            all
 version         SUNWprivate
 end
 
+function        PR_AR_GetHostByNameTTL
+arch            all
+version         SUNWprivate
+end
+
 function        PR_AR_Init
 arch            all
 version         SUNWprivate
 end
 
+function        PR_AR_SetNameServer
+arch            all
+version         SUNWprivate
+end
+
 data            resolver
 arch            all
 version         SUNWprivate
@@ -253,6 +253,74 @@ NSFC_TransmitAsync(NSFCNativeSocketDesc socket, NSFCEntry entry,
     return rv;
 }
 
+PR_IMPLEMENT(NSFCAsyncStatus)
+NSFC_TransmitAsyncRanges(NSFCNativeSocketDesc socket, NSFCEntry entry,
+                         const NSFCRange *ranges, PRInt32 nranges,
+                         PRInt64 *offset, NSFCCache cache)
+{
+    NSFCAsyncStatus rv;
+
+    PR_ASSERT(nranges > 0 && nranges <= NSFC_MAX_RANGES);
+
+#ifdef XP_WIN32
+    rv = NSFC_ASYNCSTATUS_WOULDBLOCK;
+#else
+    rv = NSFC_MD_TransmitAsyncRanges(socket, entry, ranges, nranges,
+                                     offset, cache);
+#endif
+
+    if (rv == NSFC_ASYNCSTATUS_DONE)
+        NSFC_RecordEntryHit(cache, entry);
+
+    return rv;
+}
+
+/*
+ * NSFC_TransmitEntryRanges - transmit ranges of the file for an entry
+ *
+ * caller need to have a valid entry handle
+ */
+PR_IMPLEMENT(PRInt64)
+NSFC_TransmitEntryRanges(PRFileDesc *socket,
+                         NSFCEntry entry,
+                         const NSFCRange *ranges, PRInt32 nranges,
+                         PRIntervalTime timeout,
+                         NSFCCache cache,
+                         NSFCStatusInfo *statusInfo)
+{
+    NSFCEntryImpl *nep = entry;
+    PRInt64 rv;
+
+    NSFCSTATUSINFO_INIT(statusInfo);
+
+    if (nranges < 1 || nranges > NSFC_MAX_RANGES) {
+        NSFCSTATUSINFO_SET(statusInfo, NSFC_STATUSINFO_BADCALL);
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return -1;
+    }
+
+    if (!NSFC_CheckRanges(nep->finfo.pr.size, ranges, nranges)) {
+        NSFCSTATUSINFO_SET(statusInfo, NSFC_STATUSINFO_FILESIZE);
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return -1;
+    }
+
+    NSFC_RecordEntryHit(cache, nep);
+
+    rv = NSFC_MD_TransmitRanges(socket, nep, ranges, nranges, timeout,
+                                cache, statusInfo);
+
+#ifdef XP_WIN32
+    /* Work-around for NSPR error mapping deficiency */
+    if ((rv < 0) && (PR_GetError() == PR_UNKNOWN_ERROR) &&
+        (PR_GetOSError() == ERROR_NETNAME_DELETED)) {
+        PR_SetError(PR_CONNECT_RESET_ERROR, ERROR_NETNAME_DELETED);
+    }
+#endif /* XP_WIN32 */
+
+    return rv;
+}
+
 /*
  * NSFC_TransmitEntryFile - transmit file for a entry
  *
@@ -691,6 +759,114 @@ NSFC_PR_SendFile(PRFileDesc *socket, PRFileDesc *fd, NSFCFileInfo *finfo,
     return rv;
 }
 
+/*
+ * NSFC_CheckRanges - check that ranges lie within a file of the given size
+ */
+PR_IMPLEMENT(PRBool)
+NSFC_CheckRanges(PRInt64 size, const NSFCRange *ranges, PRInt32 nranges)
+{
+    for (PRInt32 i = 0; i < nranges; i++) {
+        if (ranges[i].hdrlen < 0 || ranges[i].offset < 0 ||
+            ranges[i].length < 0 ||
+            ranges[i].offset + ranges[i].length > size)
+            return PR_FALSE;
+    }
+
+    return PR_TRUE;
+}
+
+/*
+ * NSFC_PR_SendFileRanges - transmit ranges of a file using PR_SendFile()
+ *
+ * Ranges that extend past the reach of PR_SendFile()'s 32-bit file offset are
+ * sent with PR_Seek64()/PR_Read(), so the caller must not pass a shared fd
+ * unless all ranges end before PR_INT32_MAX.
+ */
+PR_IMPLEMENT(PRInt64)
+NSFC_PR_SendFileRanges(PRFileDesc *socket, PRFileDesc *fd,
+                       const NSFCRange *ranges, PRInt32 nranges,
+                       PRIntervalTime timeout, NSFCCache cache)
+{
+    PRInt64 total = 0;
+    PRInt64 rv = 0;
+
+    for (PRInt32 i = 0; i < nranges && rv >= 0; i++) {
+        const NSFCRange *range = &ranges[i];
+
+        if (range->length == 0) {
+            /* PR_SendFile() treats 0 bytes as "to the end of the file" */
+            if (range->hdrlen > 0) {
+                rv = PR_Send(socket, range->header, range->hdrlen, 0, timeout);
+            } else {
+                rv = 0;
+            }
+        }
+        else if (range->hdrlen + range->offset + range->length <= PR_INT32_MAX) {
+            PRSendFileData sfd;
+            sfd.fd = fd;
+            sfd.file_offset = (PRUint32) range->offset;
+            sfd.file_nbytes = (PRSize) range->length;
+            sfd.header = range->header;
+            sfd.hlen = range->hdrlen;
+            sfd.trailer = NULL;
+            sfd.tlen = 0;
+            rv = PR_SendFile(socket, &sfd, PR_TRANSMITFILE_KEEP_OPEN, timeout);
+        }
+        else {
+            PRInt32 buff_size = cache->cfg.bufferSize;
+            char *buff = (char *) malloc(buff_size);
+            if (!buff) {
+                PR_SetError(PR_OUT_OF_MEMORY_ERROR, 0);
+                rv = -1;
+                break;
+            }
+
+            PRInt64 sent = 0;
+            if (range->hdrlen > 0)
+                rv = PR_Send(socket, range->header, range->hdrlen, 0, timeout);
+            if (rv >= 0)
+                sent += rv;
+            if (rv >= 0 && PR_Seek64(fd, range->offset, PR_SEEK_SET) < 0)
+                rv = -1;
+
+            PRInt64 remain = range->length;
+            while (rv >= 0 && remain > 0) {
+                PRInt32 n = buff_size;
+                if (n > remain)
+                    n = (PRInt32) remain;
+                rv = PR_Read(fd, buff, n);
+                if (rv <= 0) {
+                    /* The file was truncated beneath us */
+                    if (rv == 0)
+                        PR_SetError(PR_END_OF_FILE_ERROR, 0);
+                    rv = -1;
+                    break;
+                }
+                rv = PR_Send(socket, buff, (PRInt32) rv, 0, timeout);
+                if (rv >= 0) {
+                    sent += rv;
+                    remain -= rv;
+                }
+            }
+
+            free(buff);
+
+            if (rv >= 0)
+                rv = sent;
+        }
+
+        if (rv >= 0)
+            total += rv;
+    }
+
+    if (rv < 0) {
+        _NSFC_PR_NT_CancelIo(socket);
+        return -1;
+    }
+
+    return total;
+}
+
 #ifdef XP_WIN32
 static PRStatus
 _NSFC_Dummy_NT_CancelIo(PRFileDesc *fd)
@@ -206,6 +206,16 @@ arch            all
 version         SUNWprivate
 end
 
+function        NSFC_TransmitAsyncRanges
+arch            all
+version         SUNWprivate
+end
+
+function        NSFC_TransmitEntryRanges
+arch            all
+version         SUNWprivate
+end
+
 function        NSFC_TransmitFile
 arch            all
 version         SUNWprivate
@@ -315,6 +315,168 @@ NSFC_MD_TransmitAsync(int socket,
     return NSFC_ASYNCSTATUS_DONE;
 }
 
+PR_IMPLEMENT(NSFCAsyncStatus)
+NSFC_MD_TransmitAsyncRanges(int socket,
+                            NSFCEntryImpl *nep,
+                            const NSFCRange *ranges,
+                            PRInt32 nranges,
+                            PRInt64 *offset,
+                            NSFCCache cache)
+{
+    /* Stay within the smallest IOV_MAX of the platforms we support */
+    struct iovec iov[PR_MAX_IOVECTOR_SIZE];
+    int iovcnt = 0;
+    PRInt64 total = 0;
+
+    /* Make sure the content is already in memory */
+    if (!(nep->flags & NSFCENTRY_HASCONTENT) || nep->md.fd ||
+        !NSFC_CheckRanges(nep->md.length, ranges, nranges)) {
+        *offset = 0;
+        return NSFC_ASYNCSTATUS_WOULDBLOCK;
+    }
+
+    /* Construct the iov[], skipping *offset bytes */
+    PRInt64 skip = *offset;
+    PR_ASSERT(skip >= 0);
+    for (PRInt32 i = 0; i < nranges; i++) {
+        const NSFCRange *range = &ranges[i];
+
+        if (range->hdrlen > skip) {
+            if (iovcnt < PR_MAX_IOVECTOR_SIZE) {
+                iov[iovcnt].iov_base = (char *)range->header + skip;
+                iov[iovcnt].iov_len = range->hdrlen - skip;
+                iovcnt++;
+            }
+            skip = 0;
+        } else {
+            skip -= range->hdrlen;
+        }
+        if (range->length > skip) {
+            if (iovcnt < PR_MAX_IOVECTOR_SIZE) {
+                iov[iovcnt].iov_base = (char *)nep->md.pcontent + range->offset + skip;
+                iov[iovcnt].iov_len = range->length - skip;
+                iovcnt++;
+            }
+            skip = 0;
+        } else {
+            skip -= range->length;
+        }
+
+        total += range->hdrlen + range->length;
+    }
+    PR_ASSERT(skip == 0);
+
+    /* Send the iov[] */
+    if (iovcnt > 0) {
+        int rv = writev(socket, iov, iovcnt);
+        if (rv == -1) {
+            /* Bail out on network error */
+            int e = errno;
+            if (e != EAGAIN && e != EWOULDBLOCK)
+                return NSFC_ASYNCSTATUS_IOERROR;
+        } else {
+            /* Keep track of how much data has been sent */
+            *offset += rv;
+        }
+    }
+
+    /* Let the caller know if there's more data left to send */
+    if (*offset < total)
+        return NSFC_ASYNCSTATUS_AGAIN;
+
+    /* Keep count of cached content hits */
+    PR_AtomicIncrement((PRInt32 *)&cache->ctntHits);
+
+    return NSFC_ASYNCSTATUS_DONE;
+}
+
+PR_IMPLEMENT(PRInt64)
+NSFC_MD_TransmitRanges(PRFileDesc *socket, NSFCEntryImpl *nep,
+                       const NSFCRange *ranges, PRInt32 nranges,
+                       PRIntervalTime timeout, NSFCCache cache,
+                       NSFCStatusInfo *statusInfo)
+{
+    PRInt64 rv;
+    PRInt32 i;
+
+    PR_ASSERT(nep != NULL && (nep->flags & NSFCENTRY_HASINFO) &&
+              !(nep->flags & NSFCENTRY_ERRORINFO));
+
+    if ((nep->flags & NSFCENTRY_HASCONTENT) && !nep->md.fd) {
+        /* Keep count of cached content hits */
+        PR_AtomicIncrement((PRInt32 *)&cache->ctntHits);
+
+        if (!NSFC_CheckRanges(nep->md.length, ranges, nranges)) {
+            NSFCSTATUSINFO_SET(statusInfo, NSFC_STATUSINFO_FILESIZE);
+            PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+            return -1;
+        }
+
+        /* Content is in memory, so just writev the headers and slices */
+        PRIOVec iov[PR_MAX_IOVECTOR_SIZE];
+        PRInt32 iovcnt = 0;
+        PRInt64 total = 0;
+        for (i = 0; i < nranges; i++) {
+            if (ranges[i].hdrlen > 0) {
+                iov[iovcnt].iov_base = (char *)ranges[i].header;
+                iov[iovcnt].iov_len = ranges[i].hdrlen;
+                ++iovcnt;
+            }
+            if (ranges[i].length > 0) {
+                iov[iovcnt].iov_base = (char *)nep->md.pcontent + ranges[i].offset;
+                iov[iovcnt].iov_len = ranges[i].length;
+                ++iovcnt;
+            }
+            if (iovcnt > PR_MAX_IOVECTOR_SIZE - 2 || i == nranges - 1) {
+                if (iovcnt > 0) {
+                    rv = PR_Writev(socket, iov, iovcnt, timeout);
+                    if (rv < 0)
+                        return -1;
+                    total += rv;
+                }
+                iovcnt = 0;
+            }
+        }
+
+        return total;
+    }
+
+    /*
+     * A cached fd is shared between threads, so we can only use it when
+     * PR_SendFile() can reach every range without seeking
+     */
+    PRBool shareable = PR_TRUE;
+    for (i = 0; i < nranges; i++) {
+        if (ranges[i].hdrlen + ranges[i].offset + ranges[i].length > PR_INT32_MAX)
+            shareable = PR_FALSE;
+    }
+
+    if ((nep->flags & NSFCENTRY_HASCONTENT) && shareable) {
+        PR_AtomicIncrement((PRInt32 *)&cache->ctntHits);
+
+        rv = NSFC_PR_SendFileRanges(socket, nep->md.fd, ranges, nranges,
+                                    timeout, cache);
+    } else {
+        /* Keep count of cached content misses */
+        PR_AtomicIncrement((PRInt32 *)&cache->ctntMiss);
+
+        NSFCStatusInfo mystatusInfo;
+        NSFCSTATUSINFO_INIT(&mystatusInfo);
+        PRFileDesc *fd = NSFC_OpenEntryFile(nep, cache, &mystatusInfo);
+        if (!fd) {
+            NSFCSTATUSINFO_SET(statusInfo, mystatusInfo);
+            return -1;
+        }
+
+        rv = NSFC_PR_SendFileRanges(socket, fd, ranges, nranges,
+                                    timeout, cache);
+
+        PR_Close(fd);
+    }
+
+    return rv;
+}
+
 static PRInt64
 __MDEntry_Transmit(PRFileDesc *socket, NSFCMDEntry *md, NSFCFileInfo *finfo,
                    const void *headers, PRInt32 hdrlen,
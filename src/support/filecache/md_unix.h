@@ -89,6 +89,21 @@ PR_EXTERN(PRInt64) NSFC_MD_TransmitFile(PRFileDesc *socket,
                                         NSFCCache cache,
                                         NSFCStatusInfo *statusInfo);
 
+PR_EXTERN(NSFCAsyncStatus) NSFC_MD_TransmitAsyncRanges(int socket,
+                                                       NSFCEntryImpl *nep,
+                                                       const NSFCRange *ranges,
+                                                       PRInt32 nranges,
+                                                       PRInt64 *offset,
+                                                       NSFCCache cache);
+
+PR_EXTERN(PRInt64) NSFC_MD_TransmitRanges(PRFileDesc *socket,
+                                          NSFCEntryImpl *nep,
+                                          const NSFCRange *ranges,
+                                          PRInt32 nranges,
+                                          PRIntervalTime timeout,
+                                          NSFCCache cache,
+                                          NSFCStatusInfo *statusInfo);
+
 PR_EXTERN(PRInt32) NSFC_MD_GetPageSize();
 
 #endif /* __md_unix_h_ */
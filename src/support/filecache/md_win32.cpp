@@ -176,6 +176,49 @@ done:
     return rv;
 }
 
+PR_IMPLEMENT(PRInt64)
+NSFC_MD_TransmitRanges(PRFileDesc *socket, NSFCEntryImpl *nep,
+                       const NSFCRange *ranges, PRInt32 nranges,
+                       PRIntervalTime timeout, NSFCCache cache,
+                       NSFCStatusInfo *statusInfo)
+{
+    PRInt64 rv;
+
+    PR_ASSERT(nep != NULL && (nep->flags & NSFCENTRY_HASINFO) &&
+              !(nep->flags & NSFCENTRY_ERRORINFO));
+
+    /* Note that we can't use a cached fd for ranges beyond 2GB */
+    PRBool shareable = PR_TRUE;
+    for (PRInt32 i = 0; i < nranges; i++) {
+        if (ranges[i].hdrlen + ranges[i].offset + ranges[i].length > PR_INT32_MAX)
+            shareable = PR_FALSE;
+    }
+
+    if ((nep->flags & NSFCENTRY_OPENFD) && shareable) {
+        PR_AtomicIncrement((PRInt32 *)&cache->ctntHits);
+
+        rv = NSFC_PR_SendFileRanges(socket, nep->md.fd, ranges, nranges,
+                                    timeout, cache);
+    } else {
+        (void)PR_AtomicIncrement((PRInt32 *)&cache->ctntMiss);
+
+        NSFCStatusInfo mystatusInfo;
+        NSFCSTATUSINFO_INIT(&mystatusInfo);
+        PRFileDesc *fd = NSFC_OpenEntryFile(nep, cache, &mystatusInfo);
+        if (!fd) {
+            NSFCSTATUSINFO_SET(statusInfo, mystatusInfo);
+            return -1;
+        }
+
+        rv = NSFC_PR_SendFileRanges(socket, fd, ranges, nranges,
+                                    timeout, cache);
+
+        PR_Close(fd);
+    }
+
+    return rv;
+}
+
 PR_IMPLEMENT(PRInt32)
 NSFC_MD_GetPageSize()
 {
@@ -66,6 +66,14 @@ PR_EXTERN(PRInt64) NSFC_MD_TransmitFile(PRFileDesc *socket,
                                         NSFCCache cache,
                                         NSFCStatusInfo *statusInfo);
 
+PR_EXTERN(PRInt64) NSFC_MD_TransmitRanges(PRFileDesc *socket,
+                                          NSFCEntryImpl *nep,
+                                          const NSFCRange *ranges,
+                                          PRInt32 nranges,
+                                          PRIntervalTime timeout,
+                                          NSFCCache cache,
+                                          NSFCStatusInfo *statusInfo);
+
 PR_EXTERN(PRInt32) NSFC_MD_GetPageSize();
 
 #endif /* __md_win32_h_ */
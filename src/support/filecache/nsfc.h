@@ -326,6 +326,26 @@ typedef void (PR_CALLBACK *NSFCPrivDataDeleteFN)(NSFCCache cache,
                                                  const char *filename,
                                                  NSFCPrivDataKey key,
                                                  void *privateData);
+/*
+ * TYPE: NSFCRange - byte range of a cached file
+ *
+ * This structure describes one segment of a partial response transmitted by
+ * NSFC_TransmitEntryRanges() or NSFC_TransmitAsyncRanges().  Each segment
+ * consists of an optional buffer (e.g. HTTP response headers or a multipart
+ * boundary) followed by length bytes of file content starting at offset.  A
+ * segment with a length of 0 transmits only the buffer.
+ */
+typedef struct NSFCRange NSFCRange;
+struct NSFCRange {
+    const void *header;    /* pointer to data preceding the file content */
+    PRInt32 hdrlen;        /* length of header data */
+    PRInt64 offset;        /* offset of the first byte of file content */
+    PRInt64 length;        /* number of bytes of file content */
+};
+
+/* Maximum number of NSFCRange segments that may be transmitted at once */
+#define NSFC_MAX_RANGES 64
+
 /*
  * TYPE: NSFCNativeSocketDesc - operating system socket descriptor
  *
@@ -603,6 +623,28 @@ PR_EXTERN(NSFCAsyncStatus) NSFC_TransmitAsync(NSFCNativeSocketDesc socket,
                                               PRInt64 *offset,
                                               NSFCCache cache);
 
+/*
+ * NSFC_TransmitAsyncRanges - asynchronously transmit ranges of a file
+ *
+ * This function is like NSFC_TransmitAsync(), except that it transmits
+ * nranges NSFCRange segments rather than a header and the entire file.
+ * On return, *offset is set to the total number of bytes (header data and
+ * file content) transmitted so far.
+ *
+ *      socket - operating system output socket file descriptor
+ *      entry - cache entry handle
+ *      ranges - segments to transmit
+ *      nranges - number of segments, at most NSFC_MAX_RANGES
+ *      offset - offset from which to resume transmission
+ *      cache - file cache instance handle
+ */
+PR_EXTERN(NSFCAsyncStatus) NSFC_TransmitAsyncRanges(NSFCNativeSocketDesc socket,
+                                                    NSFCEntry entry,
+                                                    const NSFCRange *ranges,
+                                                    PRInt32 nranges,
+                                                    PRInt64 *offset,
+                                                    NSFCCache cache);
+
 /*
  * NSFC_TransmitEntryFile - transmit file on network socket
  *
@@ -632,6 +674,30 @@ PR_EXTERN(PRInt64) NSFC_TransmitEntryFile(PRFileDesc *socket,
                                           NSFCCache cache,
                                           NSFCStatusInfo *statusInfo);
 
+/*
+ * NSFC_TransmitEntryRanges - transmit ranges of a file on network socket
+ *
+ * This function transmits, on a specified network socket, nranges NSFCRange
+ * segments of a file for which a handle for a cache entry was previously
+ * obtained.  Returns the total number of bytes transmitted or -1 on error.
+ * If a segment lies outside the file, no data is transmitted and
+ * *statusInfo is set to NSFC_STATUSINFO_FILESIZE.
+ *
+ *      socket - output socket file descriptor
+ *      entry - cache entry handle
+ *      ranges - segments to transmit
+ *      nranges - number of segments, at most NSFC_MAX_RANGES
+ *      timeout - see PR_TransmitFile()
+ *      cache - file cache instance handle
+ */
+PR_EXTERN(PRInt64) NSFC_TransmitEntryRanges(PRFileDesc *socket,
+                                            NSFCEntry entry,
+                                            const NSFCRange *ranges,
+                                            PRInt32 nranges,
+                                            PRIntervalTime timeout,
+                                            NSFCCache cache,
+                                            NSFCStatusInfo *statusInfo);
+
 /*
  * NSFC_TransmitFile - transmit file on network socket
  *
@@ -309,6 +309,17 @@ PR_EXTERN(PRInt32) NSFC_PR_SendFile(PRFileDesc *socket,
                                     PRInt32 sendfileSize,
                                     NSFCStatusInfo *statusInfo);
 
+PR_EXTERN(PRInt64) NSFC_PR_SendFileRanges(PRFileDesc *socket,
+                                          PRFileDesc *fd,
+                                          const NSFCRange *ranges,
+                                          PRInt32 nranges,
+                                          PRIntervalTime timeout,
+                                          NSFCCache cache);
+
+PR_EXTERN(PRBool) NSFC_CheckRanges(PRInt64 size,
+                                   const NSFCRange *ranges,
+                                   PRInt32 nranges);
+
 PR_EXTERN(PRBool)
 NSFC_isSizeOK(NSFCCache cache, NSFCFileInfo* finfo, 
               PRInt32 hdrlen, PRInt32 tlrlen, PRInt32& sendfileSize);
@@ -33,6 +33,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <limits.h>
 
 #include "nspr.h"
@@ -248,6 +249,22 @@ void *UriMapImpl::map(UriMapNodeImpl *node, void *dataUriSpace, const char *path
     return dataUriSpace;
 }
 
+//-----------------------------------------------------------------------------
+// UriMapperQueueItem
+//-----------------------------------------------------------------------------
+
+struct UriMapperQueueItem {
+    UriMapNodeImpl *node;    // Node to create an entry for
+    void *dataUriSpace;      // Data associated with the enclosing URI space
+    int lenUri;              // Length of the URI up to and including node
+    int lenUriSpace;         // Length of the enclosing URI space's URI
+    int offset;              // Offset of the node's entry in _entries
+    int size;                // Size of the node's entry
+    int offsetHashTable;     // Offset of ht[] within the entry
+    int hsize;               // Number of ht[] slots
+    int firstChild;          // Queue index of the node's first child
+};
+
 //-----------------------------------------------------------------------------
 // UriMapperImpl::UriMapperImpl
 //-----------------------------------------------------------------------------
@@ -259,22 +276,112 @@ UriMapperImpl::UriMapperImpl(const UriMapImpl &map)
   _size(0)
 {
     UriMapNodeImpl *root = map._root;
+    if (!root)
+        return;
+
+    // Create a stub node that can act as the tree root if necessary
+    UriMapNodeImpl stub("", 0, PR_TRUE);
+    if (root->sibling != NULL) {
+        stub.child = root;
+        root = &stub;
+    }
 
-    if (root) {
-        // Create a stub node that can act as the tree root if necessary
-        UriMapNodeImpl stub("", 0, PR_TRUE);
-        if (root->sibling != NULL) {
-            stub.child = root;
-            root = &stub;
+    // Count the nodes so we can queue them all up front
+    int numNodes = countNodes(root);
+
+    // Lay the nodes out breadth first.  Since each node's children are
+    // queued together, their entries end up adjacent in _entries.
+    UriMapperQueueItem *queue = (UriMapperQueueItem *)malloc(numNodes * sizeof(UriMapperQueueItem));
+    if (!queue)
+        return;
+    int tail = 0;
+    queue[tail].node = root;
+    queue[tail].dataUriSpace = 0;
+    queue[tail].lenUri = strlen(root->fragment);
+    queue[tail].lenUriSpace = 0;
+    tail++;
+
+    for (int head = 0; head < tail; head++) {
+        UriMapperQueueItem *item = &queue[head];
+        UriMapNodeImpl *node = item->node;
+
+        item->offset = _size;
+        item->size = getEntrySize(node, &item->offsetHashTable, &item->hsize);
+        item->firstChild = tail;
+        _size += item->size;
+
+        // Data this entry will advertise for its URI space
+        void *dataEntryUriSpace = node->isInheritable ? node->data : item->dataUriSpace;
+
+        // If this is the end of a path segment, all child fragments will
+        // be inside our URI space
+        void *dataUriSpace = item->dataUriSpace;
+        int lenUriSpace = item->lenUriSpace;
+        int lenFragment = strlen(node->fragment);
+        if (lenFragment > 0 && node->fragment[lenFragment - 1] == '/') {
+            dataUriSpace = dataEntryUriSpace;
+            lenUriSpace = item->lenUri;
+        }
+
+        for (UriMapNodeImpl *child = node->child; child; child = child->sibling) {
+            UriMapperQueueItem *childItem = &queue[tail++];
+            childItem->node = child;
+            childItem->lenUri = item->lenUri + strlen(child->fragment);
+
+            if (*child->fragment == '/') {
+                // This child's fragment will be inside our URI space
+                childItem->dataUriSpace = dataEntryUriSpace;
+                childItem->lenUriSpace = item->lenUri;
+            } else {
+                childItem->dataUriSpace = dataUriSpace;
+                childItem->lenUriSpace = lenUriSpace;
+            }
         }
+    }
 
-        // Do a dry run to find out how big to make the _entries buffer
-        add(root, 0, 0, 0);
-        _entries = (char *)malloc(_size);
+    PR_ASSERT(tail == numNodes);
 
-        // Once more with feeling
-        _root = add(root, 0, 0, 0);
+    _entries = malloc(_size);
+    if (!_entries) {
+        free(queue);
+        _size = 0;
+        return;
     }
+
+    // Fill in the entries now that every entry's offset is known
+    for (int n = 0; n < numNodes; n++) {
+        UriMapperQueueItem *item = &queue[n];
+        UriMapNodeImpl *node = item->node;
+
+        UriMapperEntryImpl *entry = (UriMapperEntryImpl *)((char *)_entries + item->offset);
+        entry->dataUri = node->isTerminal ? node->data : item->dataUriSpace;
+        entry->dataUriSpace = node->isInheritable ? node->data : item->dataUriSpace;
+        entry->lenUriSpace = node->isInheritable ? item->lenUri : item->lenUriSpace;
+        entry->hmask = item->hsize - 1;
+        entry->offsetHashTable = item->offsetHashTable;
+        strcpy(entry->fragment, node->fragment);
+
+        PRUint32 *ht = (PRUint32 *)((char *)entry + item->offsetHashTable);
+        for (int j = 0; j < item->hsize; j++)
+            ht[j] = 0;
+
+        // The node's children were queued consecutively in sibling order
+        int i = item->firstChild;
+        for (UriMapNodeImpl *child = node->child; child; child = child->sibling) {
+            PRUint32 *slot = &ht[((unsigned char)*child->fragment) & entry->hmask];
+            PR_ASSERT(*slot == 0);
+            PR_ASSERT(queue[i].node == child);
+            *slot = queue[i++].offset;
+        }
+
+        _used += item->size;
+    }
+
+    PR_ASSERT(_used == _size);
+
+    free(queue);
+
+    _root = (UriMapperEntryImpl *)_entries;
 }
 
 //-----------------------------------------------------------------------------
@@ -287,96 +394,41 @@ UriMapperImpl::~UriMapperImpl()
 }
 
 //-----------------------------------------------------------------------------
-// UriMapperImpl::add
+// UriMapperImpl::countNodes
 //-----------------------------------------------------------------------------
 
-UriMapperEntryImpl *UriMapperImpl::add(UriMapNodeImpl *node, void *dataUriSpace, int lenUri, int lenUriSpace)
+int UriMapperImpl::countNodes(UriMapNodeImpl *node)
 {
-    lenUri += strlen(node->fragment);
-
-    // Create an entry for this node
-    UriMapperEntryImpl *entry = allocate(node, dataUriSpace, lenUri, lenUriSpace);
+    int count = 1;
 
-    if (entry) {
-        // If this is the end of a path segment...
-        if (node->fragment[strlen(node->fragment) - 1] == '/') {
-            // All child fragments will be inside our URI space
-            dataUriSpace = entry->dataUriSpace;
-            lenUriSpace = lenUri;
-        }
-    }
-
-    // For each of this node's children...
     UriMapNodeImpl *child = node->child;
     while (child) {
-        void *dataChildUriSpace = dataUriSpace;
-        int lenChildUriSpace = lenUriSpace;
-
-        if (entry) {
-            // If this is the beginning of a path segment...
-            if (*child->fragment == '/') {
-                // This child's fragment will be inside our URI space
-                dataChildUriSpace = entry->dataUriSpace;
-                lenChildUriSpace = lenUri;
-            }
-
-            // Add this child's entry to the hash table
-            int i = ((unsigned char)*child->fragment) & entry->hmask;
-            entry->ht[i] = add(child, dataChildUriSpace, lenUri, lenChildUriSpace);
-
-        } else {
-            // We're just checking how big the _entries buffer should be
-            add(child, dataChildUriSpace, lenUri, lenChildUriSpace);
-        }
-
+        count += countNodes(child);
         child = child->sibling;
     }
 
-    return entry;
+    return count;
 }
 
 //-----------------------------------------------------------------------------
-// UriMapperImpl::allocate
+// UriMapperImpl::getEntrySize
 //-----------------------------------------------------------------------------
 
-UriMapperEntryImpl *UriMapperImpl::allocate(UriMapNodeImpl *node, void *dataUriSpace, int lenUri, int lenUriSpace)
+int UriMapperImpl::getEntrySize(UriMapNodeImpl *node, int *offsetHashTable, int *hsize)
 {
-    // Get length required for path fragment
-    int lenFragment = strlen(node->fragment);
-
-    // Get optimal hash table size
-    int hsize = getChildHashSize(node);
+    // Header and nul-terminated path fragment
+    int size = offsetof(UriMapperEntryImpl, fragment) + strlen(node->fragment) + 1;
 
-    // Increase lenFragment so the allocation is a multiple of sizeof(void *)
-    int align = (sizeof(UriMapperEntryImpl) + lenFragment) & (sizeof(void *) - 1);
-    if (align)
-        lenFragment += (sizeof(void *) - align);
+    // Hash table of PRUint32 child offsets
+    size = (size + sizeof(PRUint32) - 1) & ~(sizeof(PRUint32) - 1);
+    *offsetHashTable = size;
+    *hsize = getChildHashSize(node);
+    size += *hsize * sizeof(PRUint32);
 
-    // Get length required for this entry
-    int needed = sizeof(UriMapperEntryImpl) + lenFragment + hsize * sizeof(UriMapperEntryImpl *);
-    if (!_entries) {
-        // We're just checking how big the _entries buffer should be
-        _size += needed;
-        return NULL;
-    }
+    // Keep the next entry pointer aligned
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
 
-    // Allocate an entry from the _entries buffer
-    char *base = (char *)_entries + _used;
-    _used += needed;
-    PR_ASSERT(_used <= _size);
-
-    // Initialize the entry
-    UriMapperEntryImpl *entry = (UriMapperEntryImpl *)base;
-    entry->dataUri = node->isTerminal ? node->data : dataUriSpace;
-    entry->dataUriSpace = node->isInheritable ? node->data : dataUriSpace;
-    entry->lenUriSpace = node->isInheritable ? lenUri : lenUriSpace;
-    entry->ht = (UriMapperEntryImpl **)(base + sizeof(UriMapperEntryImpl) + lenFragment);
-    for (int i = 0; i < hsize; i++)
-        entry->ht[i] = NULL;
-    entry->hmask = (hsize - 1);
-    strcpy(entry->fragment, node->fragment);
-
-    return entry;
+    return size;
 }
 
 //-----------------------------------------------------------------------------
@@ -81,12 +81,26 @@ friend class UriMapperImpl;
 // UriMapperEntryImpl
 //-----------------------------------------------------------------------------
 
+/*
+ * UriMapperEntryImpl is laid out in the UriMapperImpl _entries buffer as
+ *
+ *     UriMapperEntryImpl
+ *     char fragment[]                   nul-terminated
+ *     (padding)
+ *     PRUint32 ht[hmask + 1]            _entries offset of each child, or 0
+ *
+ * Entries are allocated breadth first from a single buffer so that the
+ * children of an entry are adjacent in memory, and children are referenced
+ * by 32-bit offsets rather than pointers to keep the hash tables small.  The
+ * root entry is at offset 0, which is never a child, so 0 marks an empty
+ * hash table slot.
+ */
 struct UriMapperEntryImpl {
     void *dataUri;           // Data associated with URI that terminates here
     void *dataUriSpace;      // Data associated with path segments below us
-    UriMapperEntryImpl **ht; // Hash table of entries below this entry
     int lenUriSpace;         // Length of the URI space's URI
-    int hmask;               // ht[c & hmask] holds entries that begin with c
+    int hmask;               // ht[c & hmask] holds the entry that begins with c
+    int offsetHashTable;     // Offset of ht[] from this entry
     char fragment[1];        // Variable length, nul-terminated, path fragment
 };
 
@@ -104,8 +118,9 @@ public:
 private:
     UriMapperImpl(const UriMapperImpl &);
     UriMapperImpl& operator=(const UriMapperImpl &);
-    UriMapperEntryImpl *add(UriMapNodeImpl *node, void *dataUriSpace, int lenUri, int lenUriSpace);
-    UriMapperEntryImpl *allocate(UriMapNodeImpl *node, void *dataUriSpace, int lenUri, int lenUriSpace);
+    inline UriMapperEntryImpl *getChild(UriMapperEntryImpl *entry, char c);
+    static int countNodes(UriMapNodeImpl *node);
+    static int getEntrySize(UriMapNodeImpl *node, int *offsetHashTable, int *hsize);
     static int getChildHashSize(UriMapNodeImpl *node);
 
     UriMapperEntryImpl *_root;
@@ -199,6 +214,16 @@ private:
 // UriMapperImpl::map
 //-----------------------------------------------------------------------------
 
+inline UriMapperEntryImpl *UriMapperImpl::getChild(UriMapperEntryImpl *entry, char c)
+{
+    const PRUint32 *ht = (const PRUint32 *)((char *)entry + entry->offsetHashTable);
+    PRUint32 offset = ht[((unsigned char)c) & entry->hmask];
+    if (offset == 0)
+        return NULL;
+
+    return (UriMapperEntryImpl *)((char *)_entries + offset);
+}
+
 inline void *UriMapperImpl::map(char *path, char **suffix, char **param)
 {
     return map(path, (const char **)(void *)suffix, (const char **)(void *)param);
@@ -245,7 +270,7 @@ inline void *UriMapperImpl::map(const char *path, const char **suffix, const cha
             // path extends beyond fragment
             dataUriSpace = entry->dataUriSpace;
             lenUriSpace = entry->lenUriSpace;
-            entry = entry->ht[((unsigned char)*ppath) & entry->hmask];
+            entry = getChild(entry, *ppath);
 
         } else {
             // path matches exactly
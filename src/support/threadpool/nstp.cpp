@@ -41,6 +41,7 @@
 * intended publication of this Source Code.
 */
 
+#include <stddef.h>              /* for offsetof() */
 #include "nstp_pvt.h"
 
 static PRCallOnceType once = { 0 };
@@ -49,13 +50,400 @@ static PRIntn   NSTPInstanceCount   = 0;
 static NSTPPool NSTPInstanceList    = NULL;
 static NSTPPool NSTPDefaultInstance = NULL;
 static PRBool	hasTimeout = PR_FALSE;
+static PRUintn  NSTPWaiterIndex;
+
+static void PR_CALLBACK DestroyWaiter(void *priv)
+{
+    delete (CL_elem *)priv;
+}
 
 static PRStatus InitializePoolLock(void)
 {
+    if (PR_NewThreadPrivateIndex(&NSTPWaiterIndex, DestroyWaiter) != PR_SUCCESS)
+        return PR_FAILURE;
+
     NSTPLock = PR_NewLock();
     return (NSTPLock) ? PR_SUCCESS : PR_FAILURE;
 }
 
+/*
+* NSTP_GetWaiter - get the calling thread's work item lock/cvar
+*
+* A thread blocks in NSTP_QueueWorkItem() until its work item is complete,
+* so each calling thread needs exactly one lock/cvar pair.  It is created
+* on first use and kept in thread private data until the thread exits.
+*/
+static CL_elem *
+NSTP_GetWaiter (void)
+{
+    CL_elem *waiter = (CL_elem *)PR_GetThreadPrivate(NSTPWaiterIndex);
+
+    if (waiter == NULL) {
+        waiter = new CL_elem ();
+        if (waiter == NULL || waiter -> lock == NULL || waiter -> cvar == NULL) {
+            delete waiter;
+            return NULL;
+        }
+
+        if (PR_SetThreadPrivate(NSTPWaiterIndex, waiter) != PR_SUCCESS) {
+            delete waiter;
+            return NULL;
+        }
+    }
+
+    return waiter;
+}
+
+/*
+* NSTP_NewThread - create a new thread pool thread
+*
+* The pool instance lock must be held by the caller.  Returns NULL if the
+* threads array is full or the thread could not be created.
+*/
+static NSTPThread *
+NSTP_NewThread (NSTPPool pip)
+{
+    if (pip -> nthreads >= pip -> maxThreads)
+        return NULL;
+
+    NSTPThread *self = PR_NEWZAP (NSTPThread);
+    if (!self)
+        return NULL;
+
+    self -> pool = pip;
+    self -> index = pip -> nthreads;
+
+    self -> lock = PR_NewLock();
+    if (self -> lock)
+        self -> cvar = PR_NewCondVar(self -> lock);
+    if (!self -> cvar) {
+        if (self -> lock)
+            PR_DestroyLock(self -> lock);
+        PR_DELETE(self);
+        return NULL;
+    }
+
+    /*
+    * In solaris, all the threads  which are going to run
+    * java needs to be bound thread so that we can reliably
+    * get the register state to do GC.
+    */
+    PRThread *thread = PR_CreateThread(PR_USER_THREAD,
+        NSTP_ThreadMain,
+        (void *)self,
+        PR_PRIORITY_NORMAL,
+        PR_GLOBAL_THREAD,
+        PR_UNJOINABLE_THREAD,
+        pip -> config.stackSize);
+    if (!thread) {
+        PR_DestroyCondVar(self -> cvar);
+        PR_DestroyLock(self -> lock);
+        PR_DELETE(self);
+        return NULL;
+    }
+
+    /*
+    * Publish the thread only after it is fully initialized, as
+    * NSTP_QueueWorkItem() and thieves scan the array without the
+    * pool lock.
+    */
+    pip -> threads[self -> index] = self;
+    PR_AtomicIncrement(&pip -> nthreads);
+
+    ++pip -> stats.threadCount;
+    PR_AtomicIncrement(&pip -> stats.freeCount);
+
+    return self;
+}
+
+/*
+* NSTP_BindThread - bind a thread pool thread to a CPU
+*
+* Threads are spread over the CPUs the process was allowed to run on when
+* the pool was created, so an affinity mask set by the administrator
+* (taskset, cpusets, etc.) is respected.
+*/
+static void
+NSTP_BindThread (NSTPThread *self)
+{
+#ifdef LINUX
+    NSTPPool pip = self -> pool;
+    int ncpus = CPU_COUNT(&pip -> cpus);
+    if (ncpus > 1) {
+        int n = self -> index % ncpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &pip -> cpus) && n-- == 0) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(cpu, &cpus);
+                sched_setaffinity(0, sizeof(cpus), &cpus);
+                break;
+            }
+        }
+    }
+#endif
+}
+
+/*
+* NSTP_Unlink - remove a work item from a thread's work queue
+*
+* The lock of the thread that owns the work queue must be held.
+*/
+static void
+NSTP_Unlink (NSTPThread *thread, NSTPWorkItem *work)
+{
+    if (work -> prev)
+        work -> prev -> next = work -> next;
+    else
+        thread -> head = work -> next;
+
+    if (work -> next)
+        work -> next -> prev = work -> prev;
+    else
+        thread -> tail = work -> prev;
+
+    work -> next = NULL;
+    work -> prev = NULL;
+    work -> owner = NULL;
+}
+
+/*
+* NSTP_Dequeued - account for a work item leaving a work queue
+*
+* Called without any locks held.  If the pool is shutting down, wakes the
+* thread in NSTP_DestroyPool() that is waiting for the work queues to drain.
+*/
+static void
+NSTP_Dequeued (NSTPPool pip)
+{
+    if (PR_AtomicDecrement(&pip -> stats.queueCount) == 0 && pip -> shutdown) {
+        PR_Lock(pip -> lock);
+        PR_NotifyAllCondVar(pip -> cvar);
+        PR_Unlock(pip -> lock);
+    }
+}
+
+/*
+* NSTP_RecordLatency - add a work item's queue time to the pool statistics
+*/
+static void
+NSTP_RecordLatency (NSTPPool pip, NSTPWorkItem *work)
+{
+    PRInt64 us = PR_Now() - work -> queued;
+    int bucket = 0;
+
+    while (us > 0 && bucket < NSTP_LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    PR_AtomicIncrement(&pip -> stats.queueLatency[bucket]);
+    PR_AtomicIncrement(&pip -> stats.workCount);
+}
+
+/*
+* NSTP_StealWork - take a work item queued on another thread
+*
+* Work is stolen from the tail of the victim's work queue so that thieves
+* don't contend with the owner, which takes work from the head.
+*/
+static NSTPWorkItem *
+NSTP_StealWork (NSTPThread *self)
+{
+    NSTPPool pip = self -> pool;
+    PRInt32 n = pip -> nthreads;
+
+    for (PRInt32 i = 1; i < n; i++) {
+        NSTPThread *victim = pip -> threads[(self -> index + i) % n];
+
+        /* Unlocked peek so we don't take the locks of idle threads */
+        if (!victim || !victim -> tail)
+            continue;
+
+        PR_Lock(victim -> lock);
+        NSTPWorkItem *work = victim -> tail;
+        if (work)
+            NSTP_Unlink(victim, work);
+        PR_Unlock(victim -> lock);
+
+        if (work) {
+            PR_AtomicIncrement(&pip -> stats.stealCount);
+            return work;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+* NSTP_TakeWork - get the next work item for a thread pool thread
+*
+* Takes work from the thread's own work queue, steals work from other
+* threads, or waits until work is queued.  Returns NULL when the thread
+* should exit.
+*/
+static NSTPWorkItem *
+NSTP_TakeWork (NSTPThread *self)
+{
+    NSTPPool pip = self -> pool;
+    NSTPWorkItem *work;
+
+    for (;;) {
+        PR_Lock(self -> lock);
+        work = self -> head;
+        if (work)
+            NSTP_Unlink(self, work);
+        PR_Unlock(self -> lock);
+        if (work)
+            break;
+
+        work = NSTP_StealWork(self);
+        if (work)
+            break;
+
+        /*
+        * Advertise that this thread is idle before looking for work one
+        * last time.  A thread that queues work on a busy thread after we
+        * looked will see the idle count and signal us.
+        */
+        PR_AtomicIncrement(&pip -> idleCount);
+        PR_Lock(self -> lock);
+        self -> idle = PR_TRUE;
+        PR_Unlock(self -> lock);
+
+        work = NSTP_StealWork(self);
+
+        PR_Lock(self -> lock);
+        if (!work) {
+            while (!self -> head && !self -> signaled && !self -> shutdown)
+                PR_WaitCondVar(self -> cvar, PR_INTERVAL_NO_TIMEOUT);
+        }
+        PRBool exiting = (!work && !self -> head && self -> shutdown);
+        self -> idle = PR_FALSE;
+        self -> signaled = PR_FALSE;
+        PR_Unlock(self -> lock);
+        PR_AtomicDecrement(&pip -> idleCount);
+
+        if (work)
+            break;
+        if (exiting)
+            return NULL;
+    }
+
+    NSTP_Dequeued(pip);
+    NSTP_RecordLatency(pip, work);
+
+    return work;
+}
+
+/*
+* NSTP_WakeIdleThread - ask an idle thread to steal work
+*/
+static void
+NSTP_WakeIdleThread (NSTPPool pip)
+{
+    PRInt32 n = pip -> nthreads;
+
+    for (PRInt32 i = 0; i < n; i++) {
+        NSTPThread *thread = pip -> threads[i];
+        if (!thread || !thread -> idle)
+            continue;
+
+        PR_Lock(thread -> lock);
+        PRBool wake = (thread -> idle && !thread -> signaled);
+        if (wake) {
+            thread -> signaled = PR_TRUE;
+            PR_NotifyCondVar(thread -> cvar);
+        }
+        PR_Unlock(thread -> lock);
+
+        if (wake)
+            break;
+    }
+}
+
+/*
+* NSTP_FindThread - choose the thread to queue a work item on
+*
+* Prefers an idle thread, then a newly created thread if all threads are
+* busy and the pool may grow, and finally the next busy thread in round
+* robin order.
+*/
+static NSTPThread *
+NSTP_FindThread (NSTPPool tpool)
+{
+    NSTPThread *thread;
+    PRInt32 n = tpool -> nthreads;
+    PRInt32 i;
+
+    if (tpool -> idleCount > 0 && n > 0) {
+        PRUint32 start = (PRUint32)tpool -> nextThread;
+        for (i = 0; i < n; i++) {
+            thread = tpool -> threads[(start + i) % n];
+            if (thread && thread -> idle && !thread -> signaled)
+                return thread;
+        }
+    }
+
+    /* If all threads are busy, consider creating a new thread */
+    if (n == 0 || ((tpool -> stats.freeCount <= 0) && tpool -> config.maxThread &&
+                   (tpool -> stats.threadCount < tpool -> config.maxThread)))
+    {
+        PR_Lock(tpool -> lock);
+        thread = NULL;
+        if (tpool -> nthreads == 0 ||
+            ((tpool -> stats.freeCount <= 0) &&
+             (tpool -> stats.threadCount < tpool -> config.maxThread)))
+        {
+            thread = NSTP_NewThread(tpool);
+        }
+        PR_Unlock(tpool -> lock);
+
+        if (thread)
+            return thread;
+
+        n = tpool -> nthreads;
+        if (n == 0)
+            return NULL;
+    }
+
+    /* Whichever thread becomes free first will steal the work item */
+    for (;;) {
+        i = (PRInt32)((PRUint32)PR_AtomicIncrement(&tpool -> nextThread) % n);
+        thread = tpool -> threads[i];
+        if (thread)
+            return thread;
+    }
+}
+
+/*
+* NSTP_CancelWork - remove a work item that hasn't started from its queue
+*
+* Returns PR_TRUE if the work item was removed, or PR_FALSE if a thread
+* has already taken it.
+*/
+static PRBool
+NSTP_CancelWork (NSTPPool tpool, NSTPWorkItem *work)
+{
+    /* A work item's owner only ever changes from a thread to NULL */
+    for (;;) {
+        NSTPThread *owner = work -> owner;
+        if (!owner)
+            return PR_FALSE;
+
+        PR_Lock(owner -> lock);
+        PRBool removed = (work -> owner == owner);
+        if (removed)
+            NSTP_Unlink(owner, work);
+        PR_Unlock(owner -> lock);
+
+        if (removed) {
+            NSTP_Dequeued(tpool);
+            return PR_TRUE;
+        }
+    }
+}
+
 /*
 * NSTP_CreatePool - create a new thread pool instance
 */
@@ -87,7 +475,8 @@ NSTP_CreatePool (NSTPPoolConfig *pcfg, NSTPPool *pool)
             break;
         }
 		
-        if (pcfg->version != NSTP_API_VERSION) {
+        if (pcfg->version < NSTP_API_VERSION_MIN ||
+            pcfg->version > NSTP_API_VERSION_MAX) {
 			
             /* Unsupported API version */
             PR_DELETE(pip);
@@ -95,13 +484,40 @@ NSTP_CreatePool (NSTPPoolConfig *pcfg, NSTPPool *pool)
             break;
         }
 		
-        /* Copy the configuration parameters into the instance */
-        pip->config = *pcfg;
+        /*
+        * Copy the configuration parameters into the instance.  Version 1
+        * callers don't know about the fields added in version 2.
+        */
+        if (pcfg->version == 1)
+            memcpy(&pip->config, pcfg, offsetof(NSTPPoolConfig, cpuAffinity));
+        else
+            pip->config = *pcfg;
+
+#ifdef LINUX
+        /* Remember which CPUs this pool's threads may be bound to */
+        if (pip->config.cpuAffinity &&
+            sched_getaffinity(0, sizeof(pip->cpus), &pip->cpus) != 0)
+            pip->config.cpuAffinity = PR_FALSE;
+#endif
+
+        /* Size the threads array for the most threads the pool can have */
+        pip->maxThreads = pip->config.initThread;
+        if (pip->maxThreads < pip->config.maxThread)
+            pip->maxThreads = pip->config.maxThread;
+        if (pip->maxThreads < 1)
+            pip->maxThreads = 1;
+        pip->threads = (NSTPThread **) PR_Calloc(pip->maxThreads, sizeof(NSTPThread *));
+        if (!pip->threads) {
+            PR_DELETE(pip);
+            rv = PR_FAILURE;
+            break;
+        }
 		
         /* Get a new lock for this instance */
         pip->lock = PR_NewLock();
         if (!pip->lock) {
             /* Failed to create lock for new pool instance */
+            PR_DELETE(pip->threads);
             PR_DELETE(pip);
             rv = PR_FAILURE;
             break;
@@ -112,6 +528,7 @@ NSTP_CreatePool (NSTPPoolConfig *pcfg, NSTPPool *pool)
         if (!pip->cvar) {
             /* Failed to create condition variable for new pool instance */
             PR_DestroyLock(pip->lock);
+            PR_DELETE(pip->threads);
             PR_DELETE(pip);
             rv = PR_FAILURE;
             break;
@@ -131,41 +548,25 @@ NSTP_CreatePool (NSTPPoolConfig *pcfg, NSTPPool *pool)
 		
         /* Create initial threads */
         if (pip->config.initThread > 0) {
-            PRThread *thread;
             int i;
 			
+            PR_Lock(pip->lock);
             for (i = 0; i < pip->config.initThread; ++i) {
-				
-			/*
-			* In solaris, all the threads  which are going to run
-			* java needs to be bound thread so that we can reliably
-			* get the register state to do GC.
-				*/
-                thread = PR_CreateThread(PR_USER_THREAD,
-					NSTP_ThreadMain,
-					(void *)pip,
-					PR_PRIORITY_NORMAL,
-					PR_GLOBAL_THREAD,
-					PR_UNJOINABLE_THREAD,
-					pip->config.stackSize);
-				
-                if (!thread) {
+                if (!NSTP_NewThread(pip)) {
                     /* Failed, so shutdown threads already created */
-                    PR_Lock(pip->lock);
-                    if (pip->stats.threadCount > 0) {
-                        pip->shutdown = PR_TRUE;
-                        rv = PR_NotifyAllCondVar(pip->cvar);
+                    pip->shutdown = PR_TRUE;
+                    for (int j = 0; j < pip->nthreads; j++) {
+                        NSTPThread *thread = pip->threads[j];
+                        PR_Lock(thread->lock);
+                        thread->shutdown = PR_TRUE;
+                        PR_NotifyCondVar(thread->cvar);
+                        PR_Unlock(thread->lock);
                     }
-                    PR_Unlock(pip->lock);
                     rv = PR_FAILURE;
                     break;
                 }
-				
-                PR_Lock(pip->lock);
-                ++pip->stats.threadCount;
-                ++pip->stats.freeCount;
-                PR_Unlock(pip->lock);
             }
+            PR_Unlock(pip->lock);
         } /* initThread > 0 */
 		*pool = pip;	// ruslan: need to assign it back
     }
@@ -219,7 +620,8 @@ NSTP_Initialize (const NSTPGlobalConfig *config, PRIntn *vmin, PRIntn *vmax)
     }
     else
 	{
-		hasTimeout = config -> tmoEnable;
+		if (config)
+			hasTimeout = config -> tmoEnable;
         rv = PR_CallOnce (&once, InitializePoolLock);
     }
 	
@@ -232,114 +634,98 @@ NSTP_QueueWorkItem (NSTPPool tpool, NSTPWorkFN workfn, NSTPWorkArg workarg, PRIn
     PRStatus     rv;
     NSTPStatus rsts;
     NSTPWorkItem work;
+    NSTPThread *thread;
     PRIntervalTime epoch;
+    PRInt32 queued;
+    PRBool idle;
 	
     /* Pretend loop to avoid goto */
     while (1)
 	{		
         /* Initialize work item on stack */
         work.next = NULL;
+        work.prev = NULL;
+        work.owner = NULL;
         work.workfn  =  workfn;
         work.workarg = workarg;
 		
         work.work_status = NSTP_STATUS_WORK_QUEUED;
         work.work_complete = PR_FALSE;
-		
-        /* Acquire thread pool lock */
-        PR_Lock (tpool -> lock);
 
-        /* Determine whether work queue is full, or if shutdown in progress */
-        if ((tpool -> config.maxQueue && (tpool -> stats.queueCount >= tpool -> config.maxQueue))
-			|| tpool -> shutdown)
+        /* Reject new work if shutdown in progress */
+        if (tpool -> shutdown)
+        {
+            rsts = NSTP_STATUS_SHUTDOWN_REJECT;
+            break;
+        }
+
+        /* Count number of work items queued */
+        queued = PR_AtomicIncrement(&tpool -> stats.queueCount);
+
+        /* Determine whether work queue is full */
+        if (tpool -> config.maxQueue && (queued > tpool -> config.maxQueue))
 		{			
             /* Work queue is full, so reject request */
-            PR_Unlock (tpool->lock);
-            rsts = tpool->shutdown ? NSTP_STATUS_BUSY_REJECT : NSTP_STATUS_SHUTDOWN_REJECT;
+            PR_AtomicDecrement(&tpool -> stats.queueCount);
+            rsts = NSTP_STATUS_BUSY_REJECT;
             break;
         }
 
-		// ruslan: add locks/cvars recycling
+        /* The peak is only approximate as it is updated without a lock */
+        if (queued > tpool -> stats.maxQueue) 
+            tpool -> stats.maxQueue = queued;
 
-		if (tpool -> waiter_mon != NULL)
-		{
-			work.waiter_mon = tpool -> waiter_mon;
-			tpool -> waiter_mon = tpool -> waiter_mon -> next;
-		}
-		else
-		{
-			CL_elem *lv = new CL_elem ();
+        work.waiter_mon = NSTP_GetWaiter();
+        thread = work.waiter_mon ? NSTP_FindThread(tpool) : NULL;
+        if (!thread)
+        {
+            PR_AtomicDecrement(&tpool -> stats.queueCount);
+            rsts = NSTP_STATUS_NSPR_FAILURE;
+            break;
+        }
 
-			if (lv == NULL || lv -> lock == NULL || lv -> cvar == NULL)
-			{
-				PR_Unlock (tpool -> lock);
+        /* Queue work item on the chosen thread */
+        PR_Lock (thread -> lock);
 
-				if (lv != NULL)
-					delete lv;
+        if (thread -> shutdown)
+        {
+            PR_Unlock (thread -> lock);
+            PR_AtomicDecrement(&tpool -> stats.queueCount);
+            rsts = NSTP_STATUS_SHUTDOWN_REJECT;
+            break;
+        }
 
-	            rsts = NSTP_STATUS_NSPR_FAILURE;
-				break;
-			}
-			else
-				work.waiter_mon = lv;
-		}
-		
-        /* Queue work item */
-        if (tpool -> tail)
-            tpool -> tail -> next = &work;
+        work.queued = PR_Now ();
+        work.owner = thread;
+        work.prev = thread -> tail;
+        if (thread -> tail)
+            thread -> tail -> next = &work;
         else
-            tpool -> head = &work;
+            thread -> head = &work;
+        thread -> tail = &work;
 
-		tpool->tail = &work;
-		
-        /* Count number of work items queued */
-        if (++tpool -> stats.queueCount > tpool -> stats.maxQueue) 
-            tpool -> stats.maxQueue = tpool -> stats.queueCount;
-		
-        /* If all threads are busy, consider creating a new thread */
-        if ((tpool->stats.freeCount <= 0) && tpool->config.maxThread &&
-            (tpool->stats.threadCount < tpool->config.maxThread))
-		{
-            PRThread *thread;
-			
-            /*
-			* Bump the total thread count before we release the pool
-			* lock, so that we don't create more than the allowed
-			* number of threads.
-			*/
-            ++tpool -> stats.threadCount;
-            ++tpool -> stats.freeCount;
-            PR_Unlock (tpool->lock);
-			
-            thread = PR_CreateThread(PR_USER_THREAD,
-				NSTP_ThreadMain,
-				(void *)tpool,
-				PR_PRIORITY_NORMAL,
-				PR_GLOBAL_THREAD,
-				PR_UNJOINABLE_THREAD,
-				tpool->config.stackSize);
-			
-            /* Reacquire the pool lock */
-            PR_Lock(tpool->lock);
-			
-            if (!thread) {
-                --tpool->stats.freeCount;
-                --tpool->stats.threadCount;
-                PR_Unlock(tpool->lock);
-                rsts = PR_FAILURE;
-                break;
-            }
-			
+        /* Wakeup the thread if it is waiting for work */
+        idle = thread -> idle;
+        if (idle)
+        {
+            thread -> signaled = PR_TRUE;
+            PR_NotifyCondVar (thread -> cvar);
         }
-		
-        /* Wakeup a waiting thread */
-        PR_NotifyCondVar (tpool -> cvar);
-		
-        /* Release thread pool lock */
-        PR_Unlock (tpool -> lock);
+
+        PR_Unlock (thread -> lock);
+
+        /*
+        * The work item was queued on a busy thread, so ask an idle thread
+        * (if any) to steal it.  The atomic read orders it after the queue
+        * update above; see NSTP_TakeWork().
+        */
+        if (!idle && PR_AtomicAdd(&tpool -> idleCount, 0) > 0)
+            NSTP_WakeIdleThread(tpool);
 		
 		/* Record start time of wait */
-		if (hasTimeout &&
-			timeout != PR_INTERVAL_NO_TIMEOUT && timeout != PR_INTERVAL_NO_WAIT)
+		PRBool timed = (hasTimeout &&
+			timeout != PR_INTERVAL_NO_TIMEOUT && timeout != PR_INTERVAL_NO_WAIT);
+		if (timed)
 			epoch = PR_IntervalNow ();
 		
         /* Acquire the work item lock */
@@ -348,34 +734,43 @@ NSTP_QueueWorkItem (NSTPPool tpool, NSTPWorkFN workfn, NSTPWorkArg workarg, PRIn
         /* Now wait for work to be completed */
         while (work.work_complete == PR_FALSE) 
 		{
-			
-            rv = PR_WaitCondVar (work.waiter_mon -> cvar, hasTimeout ? timeout : PR_INTERVAL_NO_TIMEOUT);
-			if (rv == PR_FAILURE) 
-			{
-				/* Some kind of NSPR error */
-				work.work_status = NSTP_STATUS_NSPR_FAILURE;
-				work.work_complete = PR_TRUE;
-			}
-			else 
-			if (hasTimeout &&
-				!work.work_complete && timeout != PR_INTERVAL_NO_TIMEOUT &&
-				timeout != PR_INTERVAL_NO_WAIT
-				&&
-				((PRIntervalTime)(PR_IntervalNow() - epoch) > timeout)) 
+			PRIntervalTime wait = PR_INTERVAL_NO_TIMEOUT;
+			if (timed)
 			{
-					
-				/* Wait timed out */
-				/* XXX if (work not started yet) */
-				work.work_status = NSTP_STATUS_WORK_TIMEOUT;
-				work.work_complete = PR_TRUE;
-				rv = PR_FAILURE;
-				/* XXX else PR_Interrupt thread? */
+				PRIntervalTime elapsed = (PRIntervalTime)(PR_IntervalNow() - epoch);
+				wait = (elapsed < timeout) ? timeout - elapsed : PR_INTERVAL_NO_WAIT;
 			}
 
-			if (rv == PR_FAILURE)
-			{
-				/* XXX remove work item from queue */
+			if (wait == PR_INTERVAL_NO_WAIT)
+				rv = PR_SUCCESS;
+			else
+				rv = PR_WaitCondVar (work.waiter_mon -> cvar, wait);
+
+			if (work.work_complete)
 				break;
+
+			if (rv == PR_FAILURE || (timed &&
+				(PRIntervalTime)(PR_IntervalNow() - epoch) >= timeout))
+			{
+				/*
+				* Some kind of NSPR error or the wait timed out.  The work
+				* item lives on our stack, so we can only give up on it if
+				* no thread has started it yet.
+				*/
+				PR_Unlock (work.waiter_mon -> lock);
+				PRBool canceled = NSTP_CancelWork (tpool, &work);
+				PR_Lock (work.waiter_mon -> lock);
+
+				if (canceled)
+				{
+					work.work_status = (rv == PR_FAILURE) ?
+						NSTP_STATUS_NSPR_FAILURE : NSTP_STATUS_WORK_TIMEOUT;
+					work.work_complete = PR_TRUE;
+					break;
+				}
+
+				/* Work has started, so wait for it to finish */
+				timed = PR_FALSE;
 			}
 		} /* while work_complete */
 		
@@ -383,15 +778,6 @@ NSTP_QueueWorkItem (NSTPPool tpool, NSTPWorkFN workfn, NSTPWorkArg workarg, PRIn
 				
 		/* Release the work item lock */
 		PR_Unlock (work.waiter_mon -> lock);		
-		
-		PR_Lock   (tpool -> lock);		
-			/* 
-			Cleanup and continue 
-			*/
-			work.waiter_mon -> next = tpool -> waiter_mon;
-			tpool -> waiter_mon = work.waiter_mon;
-
-		PR_Unlock (tpool -> lock);
 
 		break;
 	} /* while */
@@ -415,70 +801,24 @@ NSTP_Terminate(PRBool doitnow)
 void
 NSTP_ThreadMain (void *arg)
 {
-    NSTPPool pip = (NSTPPool)arg;
-    NSTPWorkItem *work = NULL;
-    NSTPThread self;
+    NSTPThread *self = (NSTPThread *)arg;
+    NSTPPool pip = self -> pool;
+    NSTPWorkItem *work;
 	
     /* Initialize structure describing this thread */
-    self.prthread = PR_GetCurrentThread ();
-    self.work = NULL;
-    self.shutdown = PR_FALSE;
-	
-    PR_Lock(pip->lock);
-	
-    /* Add this thread to the list of threads in the thread pool instance */
-    self.next = pip->threads;
-    pip->threads = &self;
-	
-    /*
-	* The free thread count was incremented when this thread was created.
-	* The thread is free, but we're going to increment the count at the
-	* beginning of the loop below, so decrement it here.
-	*/
-    --pip -> stats.freeCount;
+    self -> prthread = PR_GetCurrentThread ();
+
+    if (pip -> config.cpuAffinity)
+        NSTP_BindThread(self);
 	
     /*
-	* Begin main service loop.  The pool lock is held at the beginning
-	* of the loop, either because it was acquired above, or because it
-	* was acquired at the end of the previous iteration.
+	* Begin main service loop.  The thread is counted as free when it is
+	* created and whenever it isn't running a work function.
 	*/
-    while (!self.shutdown) {
-		
-        /* Count this thread as free */
-        ++pip -> stats.freeCount;
-		
-        /* Wait for something on the work queue, or for shutdown */
-        while (!pip->head && !self.shutdown) {
-            PR_WaitCondVar (pip->cvar, PR_INTERVAL_NO_TIMEOUT);
-        }
-		
-        /* Dequeue the head work item */
-        work = pip->head;
-        pip -> head = work -> next;
-		pip -> stats.queueCount--;	// decrement the queue count
-
-        if (!pip->head) {
-            pip->tail = NULL;
-			
-			/*
-			* If the pool shutdown flag is set, wake all threads waiting
-			* on the pool cvar, so that the one that is waiting for the
-			* work queue to be empty will wake up and see that.  The
-			* other (worker) threads will immediately go back to waiting
-			* on the pool cvar when they see that the work queue is
-			* empty.
-			*/
-			if (pip->shutdown) {
-				PR_NotifyAllCondVar(pip->cvar);
-			}
-        }
-        self.work = work;
+    while ((work = NSTP_TakeWork(self)) != NULL) {
 		
         /* This thread is no longer free */
-        --pip -> stats.freeCount;
-		
-        /* Release the pool instance lock */
-        PR_Unlock(pip->lock);
+        PR_AtomicDecrement(&pip -> stats.freeCount);
 		
         /* Call the work function */
         work->workfn(work->workarg);
@@ -496,16 +836,20 @@ NSTP_ThreadMain (void *arg)
         /* Release the lock */
         PR_Unlock(work -> waiter_mon -> lock);
 		
-        /* Acquire the pool instance lock for the next iteration */
-        PR_Lock(pip->lock);
+        /* Count this thread as free */
+        PR_AtomicIncrement(&pip -> stats.freeCount);
     }
+
+    PR_AtomicDecrement(&pip -> stats.freeCount);
 	
+    PR_Lock(pip->lock);
+
     /* Decrement the thread count before this thread terminates */
     if (--pip -> stats.threadCount <= 0)
 	{
 		
 		/* Notify shutdown thread when this is the last thread */
-		PR_NotifyCondVar(pip->cvar);
+		PR_NotifyAllCondVar(pip->cvar);
     }
 	
     PR_Unlock(pip->lock);
@@ -524,66 +868,73 @@ PR_IMPLEMENT(void)
 NSTP_DestroyPool(NSTPPool pool, PRBool doitnow)
 {
     NSTPWorkItem *work;
-	
-    PR_Lock(pool->lock);
+    NSTPThread *thread;
+    int i;
 	
     /*
 	* Indicate pool is being shut down, so no more requests
 	* will be accepted.
 	*/
+    PR_Lock(pool->lock);
     pool->shutdown = PR_TRUE;
+    PR_Unlock(pool->lock);
 	
     if (doitnow) {
 		
 		/* Complete all queued work items with NSTP_STATUS_SHUTDOWN_REJECT */
-		while ((work = pool->head) != NULL) {
-			
-			/* Dequeue work item */
-			pool->head = work->next;
-			if (pool->head == NULL) {
-				pool->tail = NULL;
+		for (i = 0; i < pool->nthreads; i++) {
+			thread = pool->threads[i];
+
+			PR_Lock(thread->lock);
+			while ((work = thread->head) != NULL) {
+				
+				/* Dequeue work item */
+				NSTP_Unlink(thread, work);
+				
+				PR_Unlock(thread->lock);
+
+				NSTP_Dequeued(pool);
+				
+				/* Acquire the lock used by the calling, waiting thread */
+				PR_Lock ( work -> waiter_mon -> lock);
+				
+				/* Set work completion status */
+				work->work_status = NSTP_STATUS_SHUTDOWN_REJECT;
+				work->work_complete = PR_TRUE;
+				
+				/* Wake up the calling, waiting thread */
+				PR_NotifyCondVar (work -> waiter_mon -> cvar);
+				
+				/* Release the lock */
+				PR_Unlock (work -> waiter_mon -> lock);
+				
+				PR_Lock (thread -> lock);
 			}
-			
-			PR_Unlock(pool->lock);
-			
-			/* Acquire the lock used by the calling, waiting thread */
-			PR_Lock ( work -> waiter_mon -> lock);
-			
-			/* Set work completion status */
-			work->work_status = NSTP_STATUS_SHUTDOWN_REJECT;
-			work->work_complete = PR_TRUE;
-			
-			/* Wake up the calling, waiting thread */
-			PR_NotifyCondVar (work -> waiter_mon -> cvar);
-			
-			/* Release the lock */
-			PR_Unlock (work -> waiter_mon -> lock);
-			
-			PR_Lock (pool -> lock);
+			PR_Unlock(thread->lock);
 		}
     }
-    else {
-		/* doitnow is PR_FALSE */
-		
-		/* Wait for work queue to be empty */
-		while (pool->head != NULL) {
-			PR_WaitCondVar(pool->cvar, PR_INTERVAL_NO_TIMEOUT);
-		}
+
+    PR_Lock(pool->lock);
+
+    /*
+    * Wait for the work queues to be empty.  The atomic read pairs with
+    * the one in NSTP_Dequeued() so one side always sees the other.
+    */
+    while (PR_AtomicAdd(&pool->stats.queueCount, 0) > 0) {
+		PR_WaitCondVar(pool->cvar, PR_INTERVAL_NO_TIMEOUT);
     }
 	
     if (pool -> stats.threadCount > 0)
 	{
-		NSTPThread *thread;
-		NSTPThread *nxt_thread;
-		
-		for (thread = pool->threads; thread; thread = nxt_thread) {
-			nxt_thread = thread->next;
+		/* Wakeup all threads to look at their shutdown flags */
+		for (i = 0; i < pool->nthreads; i++) {
+			thread = pool->threads[i];
+			PR_Lock(thread->lock);
 			thread->shutdown = PR_TRUE;
+			PR_NotifyCondVar(thread->cvar);
+			PR_Unlock(thread->lock);
 		}
 		
-		/* Wakeup all threads to look at their shutdown flags */
-		PR_NotifyAllCondVar(pool->cvar);
-		
 		/* Wait for threadCount to go to zero */
 		while (pool -> stats.threadCount > 0) 
 		{
@@ -592,9 +943,16 @@ NSTP_DestroyPool(NSTPPool pool, PRBool doitnow)
     }
 	
     PR_Unlock(pool->lock);
+
+    for (i = 0; i < pool->nthreads; i++) {
+		thread = pool->threads[i];
+		PR_DestroyCondVar(thread->cvar);
+		PR_DestroyLock(thread->lock);
+		PR_DELETE(thread);
+    }
 	
+    PR_DELETE(pool->threads);
     PR_DestroyCondVar(pool->cvar);
     PR_DestroyLock(pool->lock);
     PR_DELETE(pool);
 }
-
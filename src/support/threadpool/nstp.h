@@ -60,9 +60,17 @@ PR_BEGIN_EXTERN_C
 #define NSTP_STATUS_WORK_ACTIVE      2
 
 /* Thread pool API version numbers */
-#define NSTP_API_VERSION        1  /* Current API version number */
+#define NSTP_API_VERSION        2  /* Current API version number */
 #define NSTP_API_VERSION_MIN    1  /* Minimum version number supported */
-#define NSTP_API_VERSION_MAX    1  /* Maximum version number supported */
+#define NSTP_API_VERSION_MAX    2  /* Maximum version number supported */
+
+/*
+ * Number of queue latency histogram buckets.  Bucket 0 counts work items
+ * that waited less than 1us for a thread; bucket n counts work items that
+ * waited at least 2^(n-1)us but less than 2^n us.  The last bucket counts
+ * everything slower.
+ */
+#define NSTP_LATENCY_BUCKETS    24
 
 /* TYPES */
 
@@ -103,6 +111,7 @@ struct NSTPPoolConfig	{
     PRIntn stackSize;           /* stack size of pool threads */
     PRIntn maxQueue;            /* maximum work queue length */
     PRIntervalTime defTimeout;  /* default timeout on thread wait */
+    PRBool cpuAffinity;         /* PR_TRUE: bind threads to CPUs (v2) */
 };
 
 typedef struct NSTPPoolStats_s NSTPPoolStats;
@@ -111,6 +120,9 @@ struct NSTPPoolStats_s	{
     PRInt32 maxQueue;       /* maximum number of items ever queued */
     PRInt32 freeCount;      /* number of free threads */
     PRInt32 threadCount;    /* total number of threads in pool */
+    PRInt32 workCount;      /* number of work items dequeued */
+    PRInt32 stealCount;     /* number of work items stolen from a busy thread */
+    PRInt32 queueLatency[NSTP_LATENCY_BUCKETS]; /* time spent queued */
 };
 
 
@@ -179,6 +191,10 @@ PR_EXTERN(PRStatus) NSTP_Initialize(const NSTPGlobalConfig *config,
  * thread pool instance.  The calling thread is blocked until the
  * work item is either completed or rejected.
  *
+ * Each pool thread has its own work queue.  Work items are handed to an
+ * idle thread when there is one; otherwise they are queued on a busy
+ * thread, and the first thread to become idle steals them.
+ *
  *      tpool - thread pool instance handle
  *      workfn - pointer to work function to be called
  *      workarg - pointer to work function argument/return value structure
@@ -45,6 +45,9 @@
  */
 
 #include <string.h>              /* for memset() */
+#ifdef LINUX
+#include <sched.h>               /* for cpu_set_t */
+#endif
 #include "nstp.h"
 
 PR_BEGIN_EXTERN_C
@@ -86,32 +89,46 @@ public:
  * NSTPPool - thread pool instance structure
  *
  * This defines the structure of a thread pool instance.  Each instance
- * has its own configuration parameters, work queue, threads, and
- * statistics.
+ * has its own configuration parameters, threads, and statistics.  Work
+ * is queued on the individual threads rather than on the pool, so the
+ * pool lock is only needed to create threads and to shut down.
  */
 struct NSTPPool_s {
     NSTPPool next;          /* next thread pool instance */
     PRLock * lock;          /* lock for access to pool instance */
-    PRCondVar *cvar;        /* cvar notified when work queued	*/
+    PRCondVar *cvar;        /* cvar notified when threads exit or drain */
     NSTPPoolConfig config;  /* configuration parameters */
-    NSTPWorkItem *head;     /* first item on work queue */
-    NSTPWorkItem *tail;     /* last item on work queue	*/
-    NSTPThread *threads;    /* list of all threads		*/
+    NSTPThread **threads;   /* array of all threads */
+    PRInt32 maxThreads;     /* size of threads array */
+    PRInt32 nthreads;       /* number of entries in threads array */
+    PRInt32 idleCount;      /* number of threads waiting for work */
+    PRInt32 nextThread;     /* round robin index for busy pools */
     PRBool shutdown;        /* PR_TRUE: all threads exit*/
 	NSTPPoolStats	stats;	/* pool statistics			*/
-    CL_elem	  *waiter_mon;	/* list of available worker locks/cvars	*/
+#ifdef LINUX
+    cpu_set_t cpus;         /* CPUs threads may be bound to */
+#endif
 };
 
 /*
  * NSTPThread - thread pool thread structure
  *
  * This defines a structure used for keeping track of thread pool threads.
- * It is normally allocated on the stack of the thread pool thread itself.
+ * Each thread owns a double ended work queue.  Work is added at the tail
+ * and the owning thread takes work from the head.  Idle threads steal
+ * from the tail of other threads' queues.  The structure is allocated
+ * when the thread is created and freed when the pool is destroyed.
  */
 struct NSTPThread {
-    NSTPThread *next;    /* next thread on thread pool list */
+    NSTPPool pool;       /* thread pool instance */
+    PRIntn index;        /* index in the pool's threads array */
     PRThread *prthread;  /* NSPR thread handle for this thread */
-    NSTPWorkItem *work;  /* current work item, if any */
+    PRLock *lock;        /* lock for the fields below */
+    PRCondVar *cvar;     /* cvar notified when work queued or signaled */
+    NSTPWorkItem *head;  /* first item on work queue */
+    NSTPWorkItem *tail;  /* last item on work queue */
+    PRBool idle;         /* PR_TRUE when waiting on cvar for work */
+    PRBool signaled;     /* PR_TRUE when asked to look for work to steal */
     PRBool shutdown;     /* shutdown flag for this thread */
 };
 
@@ -123,6 +140,9 @@ struct NSTPThread {
  */
 struct NSTPWorkItem {
     NSTPWorkItem *next;     /* pointer to next item on work queue */
+    NSTPWorkItem *prev;     /* pointer to previous item on work queue */
+    NSTPThread *owner;      /* thread whose queue holds the item, if any */
+    PRTime queued;          /* time the item was queued */
     NSTPWorkFN workfn;      /* pointer to work function */
     NSTPWorkArg workarg;    /* pointer to work function arguments */
     CL_elem	*waiter_mon;	/* cvar between calling and pool threads */
@@ -0,0 +1,174 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "histogram.h"
+
+LatencyHistogram :: LatencyHistogram()
+{
+    countsLength = indexOf(HISTOGRAM_MAX_VALUE) + 1;
+    counts = new PRInt64[countsLength];
+    reset();
+};
+
+LatencyHistogram :: ~LatencyHistogram()
+{
+    delete [] counts;
+};
+
+// Values below HISTOGRAM_SUB_BUCKETS have a bucket of their own.  Above
+// that, each power of two is split into HISTOGRAM_HALF_BUCKETS buckets.
+int LatencyHistogram :: indexOf(PRInt64 value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return (int) value;
+
+    int msb = 0;
+    for (PRInt64 v = value; v > 1; v >>= 1)
+        msb++;
+
+    int shift = msb - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    return shift * HISTOGRAM_HALF_BUCKETS + (int) (value >> shift);
+};
+
+PRInt64 LatencyHistogram :: highestValueAt(int index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS)
+        return index;
+
+    int shift = index / HISTOGRAM_HALF_BUCKETS - 1;
+    PRInt64 sub = index - shift * HISTOGRAM_HALF_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+};
+
+void LatencyHistogram :: reset()
+{
+    memset(counts, 0, sizeof(PRInt64) * countsLength);
+    total = 0;
+    min = 0;
+    max = 0;
+    sum = 0;
+};
+
+void LatencyHistogram :: record(PRInt64 value)
+{
+    if (value < 0)
+        value = 0;
+    if (value > HISTOGRAM_MAX_VALUE)
+        value = HISTOGRAM_MAX_VALUE;
+
+    counts[indexOf(value)]++;
+    if (!total || value < min)
+        min = value;
+    if (value > max)
+        max = value;
+    sum += value;
+    total++;
+};
+
+void LatencyHistogram :: add(const LatencyHistogram& other)
+{
+    if (!other.total)
+        return;
+
+    for (int i = 0; i < countsLength; i++)
+        counts[i] += other.counts[i];
+    if (!total || other.min < min)
+        min = other.min;
+    if (other.max > max)
+        max = other.max;
+    sum += other.sum;
+    total += other.total;
+};
+
+PRInt64 LatencyHistogram :: getCount() const
+{
+    return total;
+};
+
+PRInt64 LatencyHistogram :: getMin() const
+{
+    return min;
+};
+
+PRInt64 LatencyHistogram :: getMax() const
+{
+    return max;
+};
+
+double LatencyHistogram :: getMean() const
+{
+    return total ? sum / total : 0;
+};
+
+// Returns the highest value equivalent to the bucket holding the given
+// percentile, so a reported percentile is never lower than the real one.
+PRInt64 LatencyHistogram :: getValueAtPercentile(double percentile) const
+{
+    if (!total)
+        return 0;
+
+    PRInt64 target = (PRInt64) (percentile / 100.0 * total + 0.5);
+    if (target < 1)
+        target = 1;
+
+    PRInt64 seen = 0;
+    for (int i = 0; i < countsLength; i++)
+    {
+        seen += counts[i];
+        if (seen >= target)
+        {
+            PRInt64 value = highestValueAt(i);
+            return (value < max) ? value : max;
+        };
+    };
+
+    return max;
+};
+
+void LatencyHistogram :: writeJSON(FILE* f) const
+{
+    PRBool first = PR_TRUE;
+
+    fprintf(f, "[");
+    for (int i = 0; i < countsLength; i++)
+    {
+        if (counts[i])
+        {
+            fprintf(f, "%s[%lld, %lld]", first ? "" : ", ",
+                    (long long) highestValueAt(i), (long long) counts[i]);
+            first = PR_FALSE;
+        };
+    };
+    fprintf(f, "]");
+};
@@ -0,0 +1,85 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdio.h>
+#include <prtypes.h>
+#include "http.h"
+
+// Significant bits of each recorded value.  Values are bucketed with a
+// relative error of at most 1/64, like an HDR histogram with two
+// significant decimal digits.
+#define HISTOGRAM_SUB_BUCKET_BITS 7
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_HALF_BUCKETS (HISTOGRAM_SUB_BUCKETS / 2)
+
+// Largest value that can be recorded.  Larger values are clamped.
+#define HISTOGRAM_MAX_VALUE ((((PRInt64)1) << 36) - 1)
+
+// Log-linear latency histogram.  Recording is a handful of shifts and an
+// increment so every response can be recorded.  Each connection keeps its
+// own histogram; they are merged with add() once the run is over.
+class __EXPORT LatencyHistogram
+{
+    public:
+        LatencyHistogram();
+        ~LatencyHistogram();
+
+        void record(PRInt64 value);
+        void add(const LatencyHistogram& other);
+        void reset();
+
+        PRInt64 getCount() const;
+        PRInt64 getMin() const;
+        PRInt64 getMax() const;
+        double getMean() const;
+        PRInt64 getValueAtPercentile(double percentile) const;
+
+        // write the non-empty buckets as a JSON array of [value, count] pairs
+        void writeJSON(FILE* f) const;
+
+    private:
+        static int indexOf(PRInt64 value);
+        static PRInt64 highestValueAt(int index);
+
+        PRInt64* counts;
+        int countsLength;
+        PRInt64 total;
+        PRInt64 min;
+        PRInt64 max;
+        double sum;
+};
+
+#endif
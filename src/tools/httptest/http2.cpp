@@ -0,0 +1,508 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * HTTP/2 TESTS
+ * These test the HTTP/2 session: framing, HPACK and flow control.  They
+ * need a listener with HTTP/2 enabled, and SSL ones need ALPN.
+ *
+ * 1. GET requests
+ * 1A. GET small file
+ * 1B. GET large file through a 16K stream window
+ *
+ * 2. HPACK
+ * 2A. RFC 7541 C.4 requests (Huffman strings, dynamic table)
+ * 2B. header list over the advertised limit
+ *
+ * 3. Connection errors
+ * 3A. DATA on stream 0
+ * 3B. HEADERS on an even stream
+ * 3C. SETTINGS with a partial setting
+ * 3D. PING with 7 bytes
+ * 3E. WINDOW_UPDATE overflowing the connection window
+ * 3F. SETTINGS_INITIAL_WINDOW_SIZE overflowing a queued stream's window
+ *
+ */
+
+#include <string.h>
+#include "engine.h"
+#include "log.h"
+#include "tests.h"
+#include "http2client.h"
+
+#define SMALLFILE "/upload/http2/small.html"
+#define SMALLSIZE 1024
+#define LARGEFILE "/upload/http2/large.html"
+#define LARGESIZE 1024000
+
+// RFC 7541 C.4.1 to C.4.3, the first request header blocks of a connection
+static const unsigned char hpackC41[] =
+{
+	0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b,
+	0xa0, 0xab, 0x90, 0xf4, 0xff
+};
+static const unsigned char hpackC42[] =
+{
+	0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf
+};
+static const unsigned char hpackC43[] =
+{
+	0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9,
+	0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf
+};
+
+// common code of the HTTP/2 tests
+class Http2Test: public NetscapeTest
+{
+	public:
+		Http2Test(const char* tname) : NetscapeTest(tname, HTTP11), client(Engine::globaltimeout) { };
+
+	protected:
+		// opens an HTTP/2 connection to the server
+		PRBool connect(PRInt32 initialWindow = 1 << 30)
+		{
+			const HttpServer& server = instance->myServer();
+			Engine engine;
+			PRFileDesc* sock = engine._doConnect(server.getAddr(), server.isSSL(), NULL, 0, NULL,
+			                                     PR_FALSE, SecurityProtocols(), Engine::globaltimeout,
+			                                     "httptest-http2");
+			if (!sock)
+			{
+				Logger::logError(LOGERROR, "unable to connect to the server");
+				return PR_FALSE;
+			};
+			if (server.isSSL() && !Http2Client::offerALPN(sock))
+			{
+				PR_Close(sock);
+				Logger::logError(LOGERROR, "unable to offer h2 with ALPN");
+				return PR_FALSE;
+			};
+			if (!client.start(sock, server.isSSL(), initialWindow))
+			{
+				client.close();
+				Logger::logError(LOGERROR, "server did not start an HTTP/2 session");
+				return PR_FALSE;
+			};
+			return PR_TRUE;
+		};
+
+		// Reads frames until the stream ends.  Returns its status, 0 if
+		// the stream was reset or -1 if the connection failed.
+		PRInt32 getResponse(PRUint32 stream, PRInt64& received, PRInt32 windowUpdate = 0)
+		{
+			PRInt32 status = 0;
+			received = 0;
+			for (;;)
+			{
+				Http2Frame frame;
+				if (!client.readFrame(frame) || frame.type == HTTP2_GOAWAY)
+					return -1;
+				if (frame.stream != stream)
+					continue;
+
+				if (frame.type == HTTP2_RST_STREAM)
+					return 0;
+				if (frame.type == HTTP2_HEADERS && status < 200)
+					status = Http2Client::getStatus(frame.payload, frame.payloadLength);
+				else if (frame.type == HTTP2_DATA)
+				{
+					received += frame.length;
+					if (windowUpdate && frame.length && !(frame.flags & HTTP2_FLAG_END_STREAM))
+					{
+						// give the stream back what it used
+						unsigned char increment[4];
+						increment[0] = (unsigned char) (frame.length >> 24);
+						increment[1] = (unsigned char) (frame.length >> 16);
+						increment[2] = (unsigned char) (frame.length >> 8);
+						increment[3] = (unsigned char) frame.length;
+						if (!client.sendFrame(HTTP2_WINDOW_UPDATE, 0, stream, increment, sizeof(increment)))
+							return -1;
+					};
+				}
+				else
+					continue;
+
+				if (frame.flags & HTTP2_FLAG_END_STREAM)
+					return status;
+			};
+		};
+
+		// Reads frames until GOAWAY.  Returns its error code, or -1 if the
+		// connection ended without one.
+		PRInt32 getGoaway()
+		{
+			for (;;)
+			{
+				Http2Frame frame;
+				if (!client.readFrame(frame))
+					return -1;
+				if (frame.type == HTTP2_GOAWAY && frame.payloadLength >= 8)
+					return (frame.payload[4] << 24) | (frame.payload[5] << 16) |
+					       (frame.payload[6] << 8) | frame.payload[7];
+			};
+		};
+
+		const char* getAuthority()
+		{
+			const HttpServer& server = instance->myServer();
+			PR_snprintf(authority, sizeof(authority), "%s:%d", server.getAddrString(),
+			            PR_ntohs(PR_NetAddrInetPort(server.getAddr())));
+			return authority;
+		};
+
+		Http2Client client;
+		char authority[128];
+};
+
+class Http2Test1A: public Http2Test
+{
+	public:
+		Http2Test1A(const char* tname = "HTTP2 1A- GET small file",
+			const char* filename = SMALLFILE,
+			PRInt64 filesize = SMALLSIZE,
+			PRInt32 window = 1 << 30)
+			: Http2Test(tname), fname(filename), fsize(filesize), initialWindow(window) { };
+
+		virtual PRBool setup()
+		{
+			if (!instance)
+				return PR_FALSE;
+
+			const HttpServer& server = instance->myServer();
+			ready = server.putFile(fname, (int) fsize);
+			return ready;
+		};
+
+		virtual PRBool run()
+		{
+			if (!instance || !connect(initialWindow))
+				return PR_FALSE;
+
+			PRInt64 received;
+			PRUint32 stream = client.sendRequest("GET", fname, getAuthority());
+			PRInt32 status = stream ? getResponse(stream, received, initialWindow < fsize) : -1;
+			if (status != 200)
+				Logger::logError(LOGERROR, "server responded with status code %d", status);
+			else if (received != fsize)
+				Logger::logError(LOGERROR, "received %lld bytes instead of %lld",
+				                 (long long) received, (long long) fsize);
+			else
+				instance->setStatus(PR_SUCCESS);
+
+			client.close();
+			return PR_TRUE;
+		};
+
+	protected:
+		const char* fname;
+		PRInt64 fsize;
+		PRInt32 initialWindow;
+};
+
+enableTest<Http2Test1A> http2test1a;
+
+class Http2Test1B: public Http2Test1A
+{
+	public:
+		Http2Test1B() : Http2Test1A("HTTP2 1B- GET large file through a 16K stream window", LARGEFILE, LARGESIZE, 16384) {};
+};
+
+enableTest<Http2Test1B> http2test1b;
+
+class Http2Test2A: public Http2Test
+{
+	public:
+		Http2Test2A() : Http2Test("HTTP2 2A- RFC 7541 C.4 requests") {};
+
+		virtual PRBool run()
+		{
+			if (!instance || !connect())
+				return PR_FALSE;
+
+			// The blocks depend on each other through the dynamic table,
+			// so they must go on one connection in this order.  Any status
+			// will do; what matters is that the server decoded them.
+			static const unsigned char* blocks[] = { hpackC41, hpackC42, hpackC43 };
+			static const PRInt32 lengths[] = { sizeof(hpackC41), sizeof(hpackC42), sizeof(hpackC43) };
+			PRBool success = PR_TRUE;
+			for (PRUint32 i = 0; i < 3 && success; i++)
+			{
+				PRInt64 received;
+				PRUint32 stream = 2 * i + 1;
+				PRInt32 status = -1;
+				if (client.sendFrame(HTTP2_HEADERS, HTTP2_FLAG_END_STREAM | HTTP2_FLAG_END_HEADERS,
+				                     stream, blocks[i], lengths[i]))
+					status = getResponse(stream, received);
+				if (status < 100)
+				{
+					Logger::logError(LOGERROR, "request C.4.%d failed (%d)", i + 1, status);
+					success = PR_FALSE;
+				};
+			};
+			if (success)
+				instance->setStatus(PR_SUCCESS);
+
+			client.close();
+			return PR_TRUE;
+		};
+};
+
+enableTest<Http2Test2A> http2test2a;
+
+class Http2Test2B: public Http2Test
+{
+	public:
+		Http2Test2B() : Http2Test("HTTP2 2B- header list over the advertised limit") {};
+
+		virtual PRBool setup()
+		{
+			if (!instance)
+				return PR_FALSE;
+
+			const HttpServer& server = instance->myServer();
+			ready = server.putFile(SMALLFILE, SMALLSIZE);
+			return ready;
+		};
+
+		virtual PRBool run()
+		{
+			if (!instance || !connect())
+				return PR_FALSE;
+
+			// A 4K field added to the dynamic table and then referenced
+			// with one byte at a time, 64 times: a 4K block that expands to
+			// more than 256K of header list.
+			unsigned char block[4200];
+			PRInt32 length = Http2Client::encodeRequest(block, sizeof(block), "GET", SMALLFILE,
+			                                            getAuthority(), instance->myServer().isSSL());
+			static const char name[] = "x-big";
+			block[length++] = 0x40;
+			block[length++] = sizeof(name) - 1;
+			memcpy(block + length, name, sizeof(name) - 1);
+			length += sizeof(name) - 1;
+			block[length++] = 0x7f;     // 4000 as a 7 bit prefix integer
+			block[length++] = ((4000 - 127) % 128) | 0x80;
+			block[length++] = (4000 - 127) / 128;
+			memset(block + length, 'x', 4000);
+			length += 4000;
+			for (int i = 0; i < 64; i++)
+				block[length++] = 0xbe;
+
+			PRInt64 received;
+			PRInt32 status = -1;
+			if (client.sendFrame(HTTP2_HEADERS, HTTP2_FLAG_END_STREAM | HTTP2_FLAG_END_HEADERS, 1, block, length))
+				status = getResponse(1, received);
+			if (status == -1 || (status >= 200 && status < 400))
+			{
+				Logger::logError(LOGERROR, "server accepted the header list (%d)", status);
+				client.close();
+				return PR_TRUE;
+			};
+
+			// the connection must still work
+			PRUint32 stream = 3;
+			PRInt32 n = Http2Client::encodeRequest(block, sizeof(block), "GET", SMALLFILE,
+			                                       getAuthority(), instance->myServer().isSSL());
+			status = -1;
+			if (client.sendFrame(HTTP2_HEADERS, HTTP2_FLAG_END_STREAM | HTTP2_FLAG_END_HEADERS, stream, block, n))
+				status = getResponse(stream, received);
+			if (status != 200)
+				Logger::logError(LOGERROR, "request after the oversized one failed (%d)", status);
+			else
+				instance->setStatus(PR_SUCCESS);
+
+			client.close();
+			return PR_TRUE;
+		};
+};
+
+enableTest<Http2Test2B> http2test2b;
+
+// sends one bad frame and expects a GOAWAY with the given error
+class Http2Test3A: public Http2Test
+{
+	public:
+		Http2Test3A(const char* tname = "HTTP2 3A- DATA on stream 0",
+			PRUint8 frametype = HTTP2_DATA,
+			PRUint32 framestream = 0,
+			PRInt32 framelength = 4,
+			PRInt32 goaway = HTTP2_PROTOCOL_ERROR)
+			: Http2Test(tname), type(frametype), stream(framestream), length(framelength), error(goaway) { };
+
+		virtual PRBool run()
+		{
+			if (!instance || !connect())
+				return PR_FALSE;
+
+			unsigned char payload[16];
+			memset(payload, 0, sizeof(payload));
+			fill(payload);
+
+			PRInt32 code = -1;
+			if (client.sendFrame(type, 0, stream, payload, length))
+				code = getGoaway();
+			if (code != error)
+				Logger::logError(LOGERROR, "server sent GOAWAY with error %d instead of %d", code, error);
+			else
+				instance->setStatus(PR_SUCCESS);
+
+			client.close();
+			return PR_TRUE;
+		};
+
+	protected:
+		virtual void fill(unsigned char* payload) { };
+
+		PRUint8 type;
+		PRUint32 stream;
+		PRInt32 length;
+		PRInt32 error;
+};
+
+enableTest<Http2Test3A> http2test3a;
+
+class Http2Test3B: public Http2Test3A
+{
+	public:
+		Http2Test3B() : Http2Test3A("HTTP2 3B- HEADERS on an even stream", HTTP2_HEADERS, 2, 1) {};
+
+	protected:
+		virtual void fill(unsigned char* payload)
+		{
+			payload[0] = 0x82;
+		};
+};
+
+enableTest<Http2Test3B> http2test3b;
+
+class Http2Test3C: public Http2Test3A
+{
+	public:
+		Http2Test3C() : Http2Test3A("HTTP2 3C- SETTINGS with a partial setting", HTTP2_SETTINGS, 0, 5, HTTP2_FRAME_SIZE_ERROR) {};
+};
+
+enableTest<Http2Test3C> http2test3c;
+
+class Http2Test3D: public Http2Test3A
+{
+	public:
+		Http2Test3D() : Http2Test3A("HTTP2 3D- PING with 7 bytes", HTTP2_PING, 0, 7, HTTP2_FRAME_SIZE_ERROR) {};
+};
+
+enableTest<Http2Test3D> http2test3d;
+
+class Http2Test3E: public Http2Test3A
+{
+	public:
+		Http2Test3E() : Http2Test3A("HTTP2 3E- WINDOW_UPDATE overflowing the connection window", HTTP2_WINDOW_UPDATE, 0, 4, HTTP2_FLOW_CONTROL_ERROR) {};
+
+	protected:
+		virtual void fill(unsigned char* payload)
+		{
+			payload[0] = 0x7f;
+			payload[1] = 0xff;
+			payload[2] = 0xff;
+			payload[3] = 0xff;
+		};
+};
+
+enableTest<Http2Test3E> http2test3e;
+
+class Http2Test3F: public Http2Test
+{
+	public:
+		Http2Test3F() : Http2Test("HTTP2 3F- SETTINGS_INITIAL_WINDOW_SIZE overflowing a queued stream's window") {};
+
+		virtual PRBool setup()
+		{
+			if (!instance)
+				return PR_FALSE;
+
+			const HttpServer& server = instance->myServer();
+			ready = server.putFile(LARGEFILE, LARGESIZE);
+			return ready;
+		};
+
+		virtual PRBool run()
+		{
+			if (!instance || !connect(16384))
+				return PR_FALSE;
+
+			// Let the response use up its 16K stream window
+			PRUint32 stream = client.sendRequest("GET", LARGEFILE, getAuthority());
+			PRInt64 received = 0;
+			while (stream && received < 16384)
+			{
+				Http2Frame frame;
+				if (!client.readFrame(frame) || frame.type == HTTP2_GOAWAY)
+				{
+					stream = 0;
+					break;
+				};
+				if (frame.stream != stream || frame.type == HTTP2_HEADERS)
+					continue;
+				if (frame.type != HTTP2_DATA || (frame.flags & HTTP2_FLAG_END_STREAM))
+				{
+					stream = 0;
+					break;
+				};
+				received += frame.length;
+			};
+			if (!stream || received != 16384)
+			{
+				Logger::logError(LOGERROR, "response was not held at the stream window");
+				client.close();
+				return PR_TRUE;
+			};
+
+			// Queue a second request behind it, open that stream's window
+			// all the way and then raise the initial window by one.  Only
+			// the queued stream overflows.
+			static const unsigned char increment[] = { 0x7f, 0xff, 0xbf, 0xff };
+			static const unsigned char settings[] = { 0, HTTP2_SETTINGS_INITIAL_WINDOW_SIZE, 0, 0, 0x40, 0x01 };
+			PRUint32 queued = client.sendRequest("GET", LARGEFILE, getAuthority());
+			PRInt32 code = -1;
+			if (queued &&
+			    client.sendFrame(HTTP2_WINDOW_UPDATE, 0, queued, increment, sizeof(increment)) &&
+			    client.sendFrame(HTTP2_SETTINGS, 0, 0, settings, sizeof(settings)))
+				code = getGoaway();
+			if (code != HTTP2_FLOW_CONTROL_ERROR)
+				Logger::logError(LOGERROR, "server sent GOAWAY with error %d instead of %d", code, HTTP2_FLOW_CONTROL_ERROR);
+			else
+				instance->setStatus(PR_SUCCESS);
+
+			client.close();
+			return PR_TRUE;
+		};
+};
+
+enableTest<Http2Test3F> http2test3f;
@@ -0,0 +1,570 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <ssl.h>
+#include "http2client.h"
+
+static const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+static unsigned char* put_uint32(unsigned char* p, PRUint32 value)
+{
+    p[0] = (unsigned char) (value >> 24);
+    p[1] = (unsigned char) (value >> 16);
+    p[2] = (unsigned char) (value >> 8);
+    p[3] = (unsigned char) value;
+    return p + 4;
+};
+
+static PRUint32 get_uint32(const unsigned char* p)
+{
+    return ((PRUint32) p[0] << 24) | ((PRUint32) p[1] << 16) | ((PRUint32) p[2] << 8) | p[3];
+};
+
+static unsigned char* put_setting(unsigned char* p, PRUint16 id, PRUint32 value)
+{
+    p[0] = (unsigned char) (id >> 8);
+    p[1] = (unsigned char) id;
+    return put_uint32(p + 2, value);
+};
+
+// HPACK integer with an n bit prefix (RFC 7541 section 5.1)
+static unsigned char* put_int(unsigned char* p, PRUint8 bits, int n, PRUint32 value)
+{
+    PRUint32 max = (1 << n) - 1;
+    if (value < max)
+    {
+        *p++ = bits | (unsigned char) value;
+        return p;
+    };
+    *p++ = bits | (unsigned char) max;
+    value -= max;
+    while (value >= 128)
+    {
+        *p++ = (unsigned char) (value & 0x7f) | 0x80;
+        value >>= 7;
+    };
+    *p++ = (unsigned char) value;
+    return p;
+};
+
+static PRBool get_int(const unsigned char*& p, const unsigned char* end, int n, PRUint32& value)
+{
+    if (p >= end)
+        return PR_FALSE;
+    PRUint32 max = (1 << n) - 1;
+    value = *p++ & max;
+    if (value < max)
+        return PR_TRUE;
+    for (int shift = 0; shift < 28; shift += 7)
+    {
+        if (p >= end)
+            return PR_FALSE;
+        value += (PRUint32) (*p & 0x7f) << shift;
+        if (!(*p++ & 0x80))
+            return PR_TRUE;
+    };
+    return PR_FALSE;
+};
+
+// literal string without Huffman coding
+static unsigned char* put_string(unsigned char* p, const char* s)
+{
+    PRInt32 length = strlen(s);
+    p = put_int(p, 0x00, 7, length);
+    memcpy(p, s, length);
+    return p + length;
+};
+
+// Decodes a status code from an HPACK string.  Only the Huffman codes of
+// the digits are known (RFC 7541 appendix B), they are all we need.
+static PRInt32 get_status(const unsigned char* p, PRUint32 length, PRBool huffman)
+{
+    PRInt32 status = 0;
+    if (!huffman)
+    {
+        if (length != 3)
+            return -1;
+        for (PRUint32 i = 0; i < length; i++)
+        {
+            if (p[i] < '0' || p[i] > '9')
+                return -1;
+            status = status * 10 + p[i] - '0';
+        };
+        return status;
+    };
+
+    PRUint32 bit = 0;
+    PRUint32 bits = length * 8;
+    for (int digits = 0; digits < 3; digits++)
+    {
+        // '0' to '2' are 5 bits long, '3' to '9' are 6 bits from 011001
+        PRUint32 code = 0;
+        for (int i = 0; i < 5; i++, bit++)
+        {
+            if (bit >= bits)
+                return -1;
+            code = (code << 1) | ((p[bit / 8] >> (7 - bit % 8)) & 1);
+        };
+        if (code >= 3)
+        {
+            if (bit >= bits)
+                return -1;
+            code = (code << 1) | ((p[bit / 8] >> (7 - bit % 8)) & 1);
+            bit++;
+            if (code < 25 || code > 31)
+                return -1;
+            code -= 22;
+        };
+        status = status * 10 + code;
+    };
+    return status;
+};
+
+Http2Client :: Http2Client(PRIntervalTime to)
+{
+    timeout = to;
+    sock = NULL;
+    ssl = PR_FALSE;
+    maxStreams = 0x7fffffff;
+    nextStream = 1;
+    bytes = 0;
+    consumed = 0;
+    window = 65535;
+    pos = 0;
+    len = 0;
+    block = NULL;
+    blockLength = 0;
+    blockSize = 0;
+    blockStream = 0;
+    blockFlags = 0;
+};
+
+Http2Client :: ~Http2Client()
+{
+    close();
+    if (block)
+        free(block);
+};
+
+PRBool Http2Client :: offerALPN(PRFileDesc* sock)
+{
+    static const unsigned char protocols[] = "\002h2";
+
+    if (SSL_OptionSet(sock, SSL_ENABLE_ALPN, PR_TRUE) != SECSuccess)
+        return PR_FALSE;
+    return (SSL_SetNextProtoNego(sock, protocols, sizeof(protocols) - 1) == SECSuccess);
+};
+
+PRBool Http2Client :: start(PRFileDesc* s, PRBool isssl, PRInt32 initialWindow)
+{
+    close();
+    sock = s;
+    ssl = isssl;
+    maxStreams = 0x7fffffff;
+    nextStream = 1;
+    consumed = 0;
+    window = initialWindow;
+    pos = 0;
+    len = 0;
+    blockStream = 0;
+
+    // preface, SETTINGS and the WINDOW_UPDATE that opens the connection
+    // window to the same size as the stream windows
+    unsigned char out[sizeof(preface) - 1 + 9 + 18 + 9 + 4];
+    unsigned char* p = out;
+    memcpy(p, preface, sizeof(preface) - 1);
+    p += sizeof(preface) - 1;
+    p = put_uint32(p, (18 << 8) | HTTP2_SETTINGS);
+    *p++ = 0;
+    p = put_uint32(p, 0);
+    p = put_setting(p, HTTP2_SETTINGS_HEADER_TABLE_SIZE, 0);
+    p = put_setting(p, HTTP2_SETTINGS_ENABLE_PUSH, 0);
+    p = put_setting(p, HTTP2_SETTINGS_INITIAL_WINDOW_SIZE, window);
+    PRInt32 length = p - out;
+    if (window > 65535)
+    {
+        p = put_uint32(p, (4 << 8) | HTTP2_WINDOW_UPDATE);
+        *p++ = 0;
+        p = put_uint32(p, 0);
+        p = put_uint32(p, window - 65535);
+        length = p - out;
+    };
+
+    if (PR_Send(sock, out, length, 0, timeout) != length)
+        return PR_FALSE;
+
+    if (ssl)
+    {
+        // the handshake is done by now; make sure the server agreed to h2
+        SSLNextProtoState state;
+        unsigned char protocol[16];
+        unsigned int protocolLength = 0;
+        if (SSL_GetNextProto(sock, &state, protocol, &protocolLength, sizeof(protocol)) != SECSuccess ||
+            (state != SSL_NEXT_PROTO_SELECTED && state != SSL_NEXT_PROTO_NEGOTIATED) ||
+            protocolLength != 2 || memcmp(protocol, "h2", 2))
+            return PR_FALSE;
+    };
+
+    // the server's connection preface is its SETTINGS frame
+    Http2Frame frame;
+    if (!readFrame(frame))
+        return PR_FALSE;
+    return (frame.type == HTTP2_SETTINGS && !(frame.flags & HTTP2_FLAG_ACK));
+};
+
+void Http2Client :: close()
+{
+    if (sock)
+    {
+        PR_Close(sock);
+        sock = NULL;
+    };
+};
+
+PRBool Http2Client :: sendFrame(PRUint8 type, PRUint8 flags, PRUint32 stream,
+                                const void* payload, PRInt32 length)
+{
+    unsigned char header[9];
+    put_uint32(header, ((PRUint32) length << 8) | type);
+    header[4] = flags;
+    put_uint32(header + 5, stream);
+
+    PRIOVec iov[2];
+    iov[0].iov_base = (char*) header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (char*) payload;
+    iov[1].iov_len = length;
+    return (PR_Writev(sock, iov, length ? 2 : 1, timeout) == (PRInt32) sizeof(header) + length);
+};
+
+PRUint32 Http2Client :: sendRequest(const char* method, const char* path, const char* authority)
+{
+    unsigned char out[HTTP2_FRAME_SIZE];
+    PRInt32 length = encodeRequest(out, sizeof(out), method, path, authority, ssl);
+    if (length < 0)
+        return 0;
+
+    PRUint32 stream = nextStream;
+    if (!sendFrame(HTTP2_HEADERS, HTTP2_FLAG_END_STREAM | HTTP2_FLAG_END_HEADERS, stream, out, length))
+        return 0;
+    nextStream += 2;
+    return stream;
+};
+
+// makes sure n bytes of the current frame are in the buffer
+PRBool Http2Client :: need(PRInt32 n)
+{
+    if (pos == len)
+    {
+        pos = 0;
+        len = 0;
+    }
+    else if (pos > 0 && pos + n > (PRInt32) sizeof(buf))
+    {
+        memmove(buf, buf + pos, len - pos);
+        len -= pos;
+        pos = 0;
+    };
+
+    while (len - pos < n)
+    {
+        PRInt32 rv = PR_Recv(sock, buf + len, sizeof(buf) - len, 0, timeout);
+        if (rv <= 0)
+            return PR_FALSE;
+        len += rv;
+        bytes += rv;
+    };
+    return PR_TRUE;
+};
+
+PRBool Http2Client :: appendBlock(const unsigned char* data, PRInt32 length)
+{
+    if (blockLength + length > blockSize)
+    {
+        PRInt32 size = blockSize ? blockSize : HTTP2_FRAME_SIZE;
+        while (size < blockLength + length)
+            size *= 2;
+        unsigned char* p = (unsigned char*) realloc(block, size);
+        if (!p)
+            return PR_FALSE;
+        block = p;
+        blockSize = size;
+    };
+    memcpy(block + blockLength, data, length);
+    blockLength += length;
+    return PR_TRUE;
+};
+
+PRBool Http2Client :: readFrame(Http2Frame& frame)
+{
+    for (;;)
+    {
+        if (!need(9))
+            return PR_FALSE;
+
+        const unsigned char* header = buf + pos;
+        PRInt32 length = (header[0] << 16) | (header[1] << 8) | header[2];
+        PRUint8 type = header[3];
+        PRUint8 flags = header[4];
+        PRUint32 stream = get_uint32(header + 5) & 0x7fffffff;
+        if (length > HTTP2_FRAME_SIZE)
+            return PR_FALSE;
+        pos += 9;
+
+        // nothing may come between a HEADERS frame and its CONTINUATIONs
+        if (blockStream && (type != HTTP2_CONTINUATION || stream != blockStream))
+            return PR_FALSE;
+
+        frame.type = type;
+        frame.flags = flags;
+        frame.stream = stream;
+        frame.length = length;
+        frame.payload = NULL;
+        frame.payloadLength = 0;
+
+        if (type == HTTP2_DATA)
+        {
+            // discard the payload as it arrives
+            PRInt32 left = length;
+            while (left > 0)
+            {
+                if (pos == len && !need(1))
+                    return PR_FALSE;
+                PRInt32 n = len - pos;
+                if (n > left)
+                    n = left;
+                pos += n;
+                left -= n;
+            };
+
+            // Stream windows are never replenished, so a response can't be
+            // larger than the initial window.  The connection's is.
+            consumed += length;
+            if (consumed >= window / 2)
+            {
+                unsigned char increment[4];
+                put_uint32(increment, (PRUint32) consumed);
+                if (!sendFrame(HTTP2_WINDOW_UPDATE, 0, 0, increment, sizeof(increment)))
+                    return PR_FALSE;
+                consumed = 0;
+            };
+            return PR_TRUE;
+        };
+
+        if (!need(length))
+            return PR_FALSE;
+        const unsigned char* payload = buf + pos;
+        pos += length;
+        frame.payload = payload;
+        frame.payloadLength = length;
+
+        switch (type)
+        {
+            case HTTP2_SETTINGS:
+                if (!(flags & HTTP2_FLAG_ACK))
+                {
+                    for (PRInt32 i = 0; i + 6 <= length; i += 6)
+                    {
+                        PRUint16 id = (payload[i] << 8) | payload[i + 1];
+                        if (id == HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS)
+                            maxStreams = get_uint32(payload + i + 2);
+                    };
+                    if (!sendFrame(HTTP2_SETTINGS, HTTP2_FLAG_ACK, 0, NULL, 0))
+                        return PR_FALSE;
+                };
+                break;
+
+            case HTTP2_PING:
+                if (!(flags & HTTP2_FLAG_ACK) && length == 8)
+                {
+                    if (!sendFrame(HTTP2_PING, HTTP2_FLAG_ACK, 0, payload, length))
+                        return PR_FALSE;
+                };
+                break;
+
+            case HTTP2_HEADERS:
+            {
+                PRInt32 start = 0;
+                PRInt32 end = length;
+                if (flags & HTTP2_FLAG_PADDED)
+                {
+                    if (length < 1)
+                        return PR_FALSE;
+                    start = 1;
+                    end -= payload[0];
+                };
+                if (flags & HTTP2_FLAG_PRIORITY)
+                    start += 5;
+                if (start > end)
+                    return PR_FALSE;
+
+                if (flags & HTTP2_FLAG_END_HEADERS)
+                {
+                    frame.payload = payload + start;
+                    frame.payloadLength = end - start;
+                    return PR_TRUE;
+                };
+
+                blockLength = 0;
+                if (!appendBlock(payload + start, end - start))
+                    return PR_FALSE;
+                blockStream = stream;
+                blockFlags = flags;
+                continue;
+            }
+
+            case HTTP2_CONTINUATION:
+                if (!blockStream || !appendBlock(payload, length))
+                    return PR_FALSE;
+                if (!(flags & HTTP2_FLAG_END_HEADERS))
+                    continue;
+                frame.type = HTTP2_HEADERS;
+                frame.flags = blockFlags | HTTP2_FLAG_END_HEADERS;
+                frame.payload = block;
+                frame.payloadLength = blockLength;
+                blockStream = 0;
+                return PR_TRUE;
+        };
+
+        return PR_TRUE;
+    };
+};
+
+PRInt32 Http2Client :: getStatus(const unsigned char* block, PRInt32 length)
+{
+    const unsigned char* p = block;
+    const unsigned char* end = block + length;
+
+    while (p < end)
+    {
+        PRUint32 index;
+        if (*p & 0x80)
+        {
+            // indexed field; the static table has :status 200 to 500 at 8-14
+            static const PRInt32 statuses[] = { 200, 204, 206, 304, 400, 404, 500 };
+            if (!get_int(p, end, 7, index))
+                return -1;
+            if (index >= 8 && index <= 14)
+                return statuses[index - 8];
+            continue;
+        };
+
+        if ((*p & 0xe0) == 0x20)
+        {
+            // dynamic table size update
+            if (!get_int(p, end, 5, index))
+                return -1;
+            continue;
+        };
+
+        // literal field, with or without indexing
+        if (!get_int(p, end, (*p & 0x40) ? 6 : 4, index))
+            return -1;
+        PRBool status = (index >= 8 && index <= 14);
+        PRUint32 n;
+        if (index == 0)
+        {
+            PRBool huffman = (p < end && (*p & 0x80));
+            if (!get_int(p, end, 7, n) || n > (PRUint32) (end - p))
+                return -1;
+            status = (!huffman && n == 7 && !memcmp(p, ":status", 7));
+            p += n;
+        };
+        PRBool huffman = (p < end && (*p & 0x80));
+        if (!get_int(p, end, 7, n) || n > (PRUint32) (end - p))
+            return -1;
+        if (status)
+            return get_status(p, n, huffman);
+        p += n;
+    };
+
+    return -1;
+};
+
+PRInt32 Http2Client :: encodeRequest(unsigned char* block, PRInt32 size,
+                                     const char* method, const char* path,
+                                     const char* authority, PRBool ssl)
+{
+    static const char agent[] = "httptest";
+
+    // each string costs at most six bytes more than its length
+    PRInt32 needed = strlen(method) + strlen(path) + strlen(authority) + sizeof(agent) + 2 + 4 * 6;
+    if (needed > size)
+        return -1;
+
+    unsigned char* p = block;
+
+    if (!strcmp(method, "GET"))
+        *p++ = 0x82;
+    else if (!strcmp(method, "POST"))
+        *p++ = 0x83;
+    else
+        p = put_string(put_int(p, 0x00, 4, 2), method);
+
+    *p++ = ssl ? 0x87 : 0x86;
+
+    if (!strcmp(path, "/"))
+        *p++ = 0x84;
+    else if (!strcmp(path, "/index.html"))
+        *p++ = 0x85;
+    else
+        p = put_string(put_int(p, 0x00, 4, 4), path);
+
+    // literals without indexing, so the request leaves no state behind
+    p = put_string(put_int(p, 0x00, 4, 1), authority);
+    p = put_string(put_int(p, 0x00, 4, 58), agent);
+
+    return p - block;
+};
+
+PRFileDesc* Http2Client :: getSocket() const
+{
+    return sock;
+};
+
+PRUint32 Http2Client :: getMaxStreams() const
+{
+    return maxStreams;
+};
+
+PRUint32 Http2Client :: getNextStream() const
+{
+    return nextStream;
+};
+
+PRInt64 Http2Client :: getBytes() const
+{
+    return bytes;
+};
@@ -0,0 +1,153 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _HTTP2CLIENT_H_
+#define _HTTP2CLIENT_H_
+
+#include <nspr.h>
+#include "http.h"
+
+// frame types (RFC 7540 section 6)
+#define HTTP2_DATA          0x0
+#define HTTP2_HEADERS       0x1
+#define HTTP2_RST_STREAM    0x3
+#define HTTP2_SETTINGS      0x4
+#define HTTP2_PING          0x6
+#define HTTP2_GOAWAY        0x7
+#define HTTP2_WINDOW_UPDATE 0x8
+#define HTTP2_CONTINUATION  0x9
+
+// frame flags
+#define HTTP2_FLAG_END_STREAM  0x1
+#define HTTP2_FLAG_ACK         0x1
+#define HTTP2_FLAG_END_HEADERS 0x4
+#define HTTP2_FLAG_PADDED      0x8
+#define HTTP2_FLAG_PRIORITY    0x20
+
+// settings
+#define HTTP2_SETTINGS_HEADER_TABLE_SIZE      0x1
+#define HTTP2_SETTINGS_ENABLE_PUSH            0x2
+#define HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define HTTP2_SETTINGS_INITIAL_WINDOW_SIZE    0x4
+
+// error codes
+#define HTTP2_NO_ERROR          0x0
+#define HTTP2_PROTOCOL_ERROR    0x1
+#define HTTP2_FLOW_CONTROL_ERROR 0x3
+#define HTTP2_FRAME_SIZE_ERROR  0x6
+#define HTTP2_COMPRESSION_ERROR 0x9
+
+// largest frame payload we accept; we never raise SETTINGS_MAX_FRAME_SIZE
+#define HTTP2_FRAME_SIZE 16384
+
+// one frame read from the server
+struct Http2Frame
+{
+    PRUint8 type;
+    PRUint8 flags;
+    PRUint32 stream;
+    PRInt32 length;                 // payload length on the wire
+    const unsigned char* payload;   // NULL for DATA, whose payload is discarded
+    PRInt32 payloadLength;          // for HEADERS, the whole header block
+};
+
+// Minimal HTTP/2 client for the load test and the HTTP2 tests.  It speaks
+// prior knowledge HTTP/2 on plain connections and h2 over ALPN on SSL ones.
+// Requests are sent with the static table and literals only.  The client
+// sets the server's HPACK dynamic table to zero size, so the only response
+// header it needs to decode is :status.  SETTINGS and PING frames are
+// acknowledged and the connection window is replenished as frames are read.
+class __EXPORT Http2Client
+{
+    public:
+        Http2Client(PRIntervalTime timeout);
+        ~Http2Client();
+
+        // offer h2 with ALPN; call on an SSL socket before its handshake
+        static PRBool offerALPN(PRFileDesc* sock);
+
+        // Start HTTP/2 on a connected socket, which the client then owns.
+        // Sends the preface and our SETTINGS (with initialWindow as
+        // SETTINGS_INITIAL_WINDOW_SIZE) and waits for the server's SETTINGS.
+        PRBool start(PRFileDesc* sock, PRBool ssl, PRInt32 initialWindow = 1 << 30);
+        void close();
+
+        PRBool sendFrame(PRUint8 type, PRUint8 flags, PRUint32 stream,
+                         const void* payload, PRInt32 length);
+
+        // send a request without a body on a new stream, returns its id or
+        // 0 if the request could not be sent
+        PRUint32 sendRequest(const char* method, const char* path, const char* authority);
+
+        // Read the next frame.  HEADERS and their CONTINUATION frames are
+        // returned as a single HEADERS frame once the header block is
+        // complete.  Returns PR_FALSE if the connection failed or the
+        // server sent something malformed.
+        PRBool readFrame(Http2Frame& frame);
+
+        // :status of a header block, or -1 if it has none
+        static PRInt32 getStatus(const unsigned char* block, PRInt32 length);
+
+        // build a header block for a request, returns its length
+        static PRInt32 encodeRequest(unsigned char* block, PRInt32 size,
+                                     const char* method, const char* path,
+                                     const char* authority, PRBool ssl);
+
+        PRFileDesc* getSocket() const;
+        PRUint32 getMaxStreams() const;
+        PRUint32 getNextStream() const;
+        PRInt64 getBytes() const;
+
+    private:
+        PRBool need(PRInt32 n);
+        PRBool appendBlock(const unsigned char* data, PRInt32 length);
+
+        PRIntervalTime timeout;
+        PRFileDesc* sock;
+        PRBool ssl;
+        PRUint32 maxStreams;
+        PRUint32 nextStream;
+        PRInt64 bytes;
+        PRInt64 consumed;               // DATA received since the last connection WINDOW_UPDATE
+        PRInt32 window;                 // our initial window, also used for the connection
+        unsigned char buf[9 + HTTP2_FRAME_SIZE];
+        PRInt32 pos;
+        PRInt32 len;
+        unsigned char* block;           // header block being assembled
+        PRInt32 blockLength;
+        PRInt32 blockSize;
+        PRUint32 blockStream;
+        PRUint8 blockFlags;
+};
+
+#endif
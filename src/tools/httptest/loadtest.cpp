@@ -0,0 +1,822 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <plstr.h>
+#include "loadtest.h"
+#include "engine.h"
+#include "http2client.h"
+#include "log.h"
+
+#define LOAD_BUFFER_SIZE 16384
+
+// How long a connection waits before reconnecting after a failed connect
+#define LOAD_RECONNECT_DELAY 10
+
+static const LoadScenario scenarios[] =
+{
+    { "static", "/index.html?static", "static file through the full request pipeline (the query string bypasses the accelerator cache)" },
+    { "accel",  "/index.html",        "static file served from the accelerator cache" },
+    { "proxy",  "/proxy/index.html",  "reverse proxied static file (requires a route for /proxy)" },
+    { "cgi",    "/cgi-bin/printenv",  "CGI program" },
+    { NULL,     NULL,                 NULL }
+};
+
+// one connection of a LoadTest, and the results it collected
+class LoadConnection
+{
+    public:
+        LoadConnection(LoadTest& test, PRTime phase);
+        ~LoadConnection();
+
+        void run();
+
+        LatencyHistogram histogram;
+        PRInt64 requests;
+        PRInt64 errors;
+        PRInt64 connects;
+        PRInt64 bytes;
+        PRInt64 statuses[6];
+
+    private:
+        PRBool connect();
+        void disconnect();
+        PRInt32 fill();
+        char* findLine(PRBool blank);
+        PRBool skip(PRInt64 size);
+        PRInt32 readResponse(PRBool& close);
+        PRInt32 exchangeHttp2(PRTime sent);
+
+        LoadTest& test;
+        PRTime phase;
+        PRFileDesc* sock;
+        PRBool reused;
+        char buf[LOAD_BUFFER_SIZE + 1];
+        PRInt32 pos;
+        PRInt32 len;
+        Http2Client h2;
+        PRInt32* streamStatus; // status of each stream of the current batch
+};
+
+LoadConnection :: LoadConnection(LoadTest& t, PRTime ph) :
+    test(t), phase(ph), h2(t.getTimeout())
+{
+    requests = 0;
+    errors = 0;
+    connects = 0;
+    bytes = 0;
+    memset(statuses, 0, sizeof(statuses));
+    sock = NULL;
+    reused = PR_FALSE;
+    pos = 0;
+    len = 0;
+    streamStatus = new PRInt32[test.getPipelineDepth()];
+};
+
+LoadConnection :: ~LoadConnection()
+{
+    disconnect();
+    delete [] streamStatus;
+};
+
+PRBool LoadConnection :: connect()
+{
+    Engine engine;
+
+    const HttpServer& server = test.getServer();
+    sock = engine._doConnect(server.getAddr(), server.isSSL(), NULL, 0, NULL,
+                             PR_FALSE, test.getSecprotocols(), test.getTimeout(),
+                             "httptest-load");
+    if (!sock)
+        return PR_FALSE;
+
+    if (test.getHttp2())
+    {
+        // the client owns the socket from here on, even if start fails
+        if (server.isSSL() && !Http2Client::offerALPN(sock))
+        {
+            PR_Close(sock);
+            sock = NULL;
+            return PR_FALSE;
+        };
+        if (!h2.start(sock, server.isSSL()))
+        {
+            disconnect();
+            return PR_FALSE;
+        };
+    };
+
+    connects++;
+    reused = PR_FALSE;
+    pos = 0;
+    len = 0;
+    return PR_TRUE;
+};
+
+void LoadConnection :: disconnect()
+{
+    if (sock)
+    {
+        if (test.getHttp2())
+            h2.close();
+        else
+            PR_Close(sock);
+        sock = NULL;
+    };
+};
+
+// reads more data into the buffer, returns the number of bytes read
+PRInt32 LoadConnection :: fill()
+{
+    if (pos == len)
+    {
+        pos = 0;
+        len = 0;
+    }
+    else if (pos > 0 && len == LOAD_BUFFER_SIZE)
+    {
+        memmove(buf, buf + pos, len - pos);
+        len -= pos;
+        pos = 0;
+    };
+
+    if (len == LOAD_BUFFER_SIZE)
+        return -1; // line too long
+
+    PRInt32 rv = PR_Recv(sock, buf + len, LOAD_BUFFER_SIZE - len, 0, test.getTimeout());
+    if (rv > 0)
+    {
+        len += rv;
+        buf[len] = '\0';
+        bytes += rv;
+    };
+    return rv;
+};
+
+// Returns the line that starts at pos, NUL terminated, reading more data as
+// needed.  With blank set, returns the whole header block up to the blank
+// line that ends it instead.  The returned text is consumed.
+char* LoadConnection :: findLine(PRBool blank)
+{
+    PRInt32 scanned = 0;
+
+    for (;;)
+    {
+        for (PRInt32 i = pos + scanned; i < len; i++)
+        {
+            if (buf[i] != '\n')
+                continue;
+            if (blank && i - pos >= 1)
+            {
+                // only stop at a line that is empty
+                PRInt32 prev = i - 1;
+                if (prev >= pos && buf[prev] == '\r')
+                    prev--;
+                if (prev >= pos && buf[prev] != '\n')
+                    continue;
+            };
+            char* line = buf + pos;
+            buf[i] = '\0';
+            pos = i + 1;
+            return line;
+        };
+        // fill() may move the data, but only along with pos
+        scanned = len - pos;
+        if (fill() <= 0)
+            return NULL;
+    };
+};
+
+// discards size bytes of body
+PRBool LoadConnection :: skip(PRInt64 size)
+{
+    while (size > 0)
+    {
+        if (pos == len && fill() <= 0)
+            return PR_FALSE;
+        PRInt64 n = len - pos;
+        if (n > size)
+            n = size;
+        pos += (PRInt32) n;
+        size -= n;
+    };
+    return PR_TRUE;
+};
+
+// Reads one response and discards its body.  Returns the status code, or -1
+// if the response could not be read.  Sets close if the server will close
+// the connection after this response.
+PRInt32 LoadConnection :: readResponse(PRBool& close)
+{
+    char* headers = findLine(PR_TRUE);
+    if (!headers)
+        return -1;
+
+    if (PL_strncmp(headers, "HTTP/1.", 7))
+        return -1;
+    close = (headers[7] == '0');
+
+    char* sp = strchr(headers, ' ');
+    if (!sp)
+        return -1;
+    PRInt32 status = atoi(sp + 1);
+    if (status < 100 || status > 599)
+        return -1;
+
+    PRInt64 contentLength = -1;
+    PRBool chunked = PR_FALSE;
+    char* line = strchr(headers, '\n');
+    while (line && *++line)
+    {
+        if (!PL_strncasecmp(line, "Content-Length:", 15))
+            contentLength = strtol(line + 15, NULL, 10);
+        else if (!PL_strncasecmp(line, "Transfer-Encoding:", 18))
+            chunked = (PL_strncasestr(line + 18, "chunked", 32) != NULL);
+        else if (!PL_strncasecmp(line, "Connection:", 11))
+        {
+            char* value = line + 11;
+            while (*value == ' ' || *value == '\t')
+                value++;
+            if (!PL_strncasecmp(value, "close", 5))
+                close = PR_TRUE;
+            else if (!PL_strncasecmp(value, "keep-alive", 10))
+                close = PR_FALSE;
+        };
+        line = strchr(line, '\n');
+    };
+
+    if (status < 200 || status == 204 || status == 304)
+        return status;
+
+    if (chunked)
+    {
+        for (;;)
+        {
+            char* size = findLine(PR_FALSE);
+            if (!size)
+                return -1;
+            PRInt64 chunk = strtol(size, NULL, 16);
+            if (chunk == 0)
+                break;
+            if (!skip(chunk) || !findLine(PR_FALSE))
+                return -1;
+        };
+        // trailers, if any, end with a blank line
+        char* trailer;
+        do
+        {
+            trailer = findLine(PR_FALSE);
+            if (!trailer)
+                return -1;
+        }
+        while (*trailer && *trailer != '\r');
+    }
+    else if (contentLength >= 0)
+    {
+        if (!skip(contentLength))
+            return -1;
+    }
+    else
+    {
+        // body is delimited by the connection closing
+        while (fill() > 0)
+            pos = len;
+        close = PR_TRUE;
+    };
+
+    return status;
+};
+
+// Sends the batch of depth requests as HTTP/2 streams, no more at a time
+// than the server allows, and reads the responses.  Returns the number of
+// requests that completed; the connection is unusable if that is short.
+PRInt32 LoadConnection :: exchangeHttp2(PRTime sent)
+{
+    PRInt32 depth = test.getPipelineDepth();
+    PRUint32 first = h2.getNextStream();
+    PRInt32 started = 0;
+    PRInt32 finished = 0;
+    PRInt32 completed = 0;
+
+    while (finished < depth)
+    {
+        while (started < depth && (PRUint32) (started - finished) < h2.getMaxStreams())
+        {
+            if (!h2.sendRequest("GET", test.getUri(), test.getAuthority()))
+                return completed;
+            streamStatus[started++] = 0;
+        };
+
+        Http2Frame frame;
+        if (!h2.readFrame(frame) || frame.type == HTTP2_GOAWAY)
+            return completed;
+        if (frame.stream < first || frame.stream >= h2.getNextStream())
+            continue;
+        PRInt32 i = (frame.stream - first) / 2;
+
+        if (frame.type == HTTP2_RST_STREAM)
+        {
+            finished++;
+            continue;
+        };
+        if (frame.type == HTTP2_HEADERS)
+        {
+            // a second HEADERS frame after the final status holds trailers
+            PRInt32 status = Http2Client::getStatus(frame.payload, frame.payloadLength);
+            if (streamStatus[i] >= 200)
+                ;
+            else if (status < 100 || status > 599)
+                return completed;
+            else
+                streamStatus[i] = status;
+        }
+        else if (frame.type != HTTP2_DATA)
+        {
+            continue;
+        };
+
+        if (frame.flags & HTTP2_FLAG_END_STREAM)
+        {
+            finished++;
+            if (streamStatus[i] < 200)
+                continue;
+            histogram.record(PR_Now() - sent);
+            statuses[streamStatus[i] / 100]++;
+            requests++;
+            completed++;
+        };
+    };
+
+    return completed;
+};
+
+void LoadConnection :: run()
+{
+    PRTime interval = test.getInterval();
+    PRTime due = test.getStart() + phase;
+    PRInt32 depth = test.getPipelineDepth();
+
+    while (PR_Now() < test.getEnd())
+    {
+        PRTime sent;
+        if (interval)
+        {
+            PRTime now = PR_Now();
+            if (due > now)
+            {
+                PR_Sleep(PR_MicrosecondsToInterval((PRUint32) (due - now)));
+                if (due >= test.getEnd())
+                    break;
+            };
+            sent = due;
+            due += interval;
+        }
+        else
+        {
+            sent = PR_Now();
+        };
+
+        PRInt32 completed = 0;
+        PRBool retry = PR_TRUE;
+        if (test.getHttp2())
+        {
+            // stream ids run out after 2^30 requests
+            if (sock && h2.getNextStream() > 0x7fffffff - 2 * (PRUint32) depth)
+                disconnect();
+            if (!sock && !connect())
+            {
+                PR_Sleep(PR_MillisecondsToInterval(LOAD_RECONNECT_DELAY));
+            }
+            else
+            {
+                completed = exchangeHttp2(sent);
+                if (completed < depth || !test.getKeepAlive())
+                    disconnect();
+            };
+            errors += depth - completed;
+            continue;
+        };
+
+        while (completed < depth)
+        {
+            if (!sock && !connect())
+            {
+                PR_Sleep(PR_MillisecondsToInterval(LOAD_RECONNECT_DELAY));
+                break;
+            };
+
+            if (completed == 0 &&
+                PR_Send(sock, test.getRequest(), test.getRequestLength(), 0, test.getTimeout()) != test.getRequestLength())
+            {
+                disconnect();
+                break;
+            };
+
+            PRBool close = !test.getKeepAlive();
+            PRInt32 status = readResponse(close);
+            if (status < 0)
+            {
+                // A kept alive connection the server has since closed fails
+                // before the first response.  Resend on a new connection.
+                PRBool stale = (completed == 0 && reused && pos == 0 && len == 0);
+                disconnect();
+                if (stale && retry)
+                {
+                    retry = PR_FALSE;
+                    continue;
+                };
+                break;
+            };
+
+            histogram.record(PR_Now() - sent);
+            statuses[status / 100]++;
+            requests++;
+            completed++;
+
+            if (close)
+            {
+                disconnect();
+                break;
+            };
+        };
+        if (sock)
+            reused = PR_TRUE;
+
+        errors += depth - completed;
+    };
+
+    disconnect();
+    bytes += h2.getBytes();
+};
+
+LoadTest :: LoadTest(const HttpServer& aserver, const LoadScenario& ascenario) :
+    server(aserver), scenario(ascenario)
+{
+    uri = scenario.uri;
+    connections = 10;
+    duration = 30;
+    depth = 1;
+    rate = 0;
+    keepalive = PR_TRUE;
+    http2 = PR_FALSE;
+    timeout = Engine::globaltimeout;
+    request = NULL;
+    authority = NULL;
+    requestLength = 0;
+    start = 0;
+    end = 0;
+    interval = 0;
+    conns = NULL;
+    requests = 0;
+    errors = 0;
+    connects = 0;
+    bytes = 0;
+    memset(statuses, 0, sizeof(statuses));
+};
+
+LoadTest :: ~LoadTest()
+{
+    if (conns)
+    {
+        for (PRInt32 i = 0; i < connections; i++)
+            delete conns[i];
+        free(conns);
+    };
+    if (request)
+        free(request);
+    if (authority)
+        PR_smprintf_free(authority);
+};
+
+const LoadScenario* LoadTest :: findScenario(const char* name)
+{
+    for (int i = 0; scenarios[i].name; i++)
+    {
+        if (!PL_strcasecmp(scenarios[i].name, name))
+            return &scenarios[i];
+    };
+    return NULL;
+};
+
+void LoadTest :: listScenarios(FILE* f)
+{
+    for (int i = 0; scenarios[i].name; i++)
+        fprintf(f, "  %-8s %-20s %s\n", scenarios[i].name, scenarios[i].uri, scenarios[i].description);
+};
+
+void LoadTest :: setUri(const char* auri)
+{
+    uri = auri;
+};
+
+void LoadTest :: setConnections(PRInt32 n)
+{
+    if (n > 0)
+        connections = n;
+};
+
+void LoadTest :: setDuration(PRInt32 seconds)
+{
+    if (seconds > 0)
+        duration = seconds;
+};
+
+void LoadTest :: setPipelineDepth(PRInt32 d)
+{
+    if (d > 0)
+        depth = d;
+};
+
+void LoadTest :: setRate(PRInt32 requestsPerSecond)
+{
+    if (requestsPerSecond >= 0)
+        rate = requestsPerSecond;
+};
+
+void LoadTest :: setKeepAlive(PRBool ka)
+{
+    keepalive = ka;
+};
+
+void LoadTest :: setHttp2(PRBool h2)
+{
+    http2 = h2;
+};
+
+void LoadTest :: setTimeout(PRIntervalTime to)
+{
+    timeout = to;
+};
+
+void LoadTest :: setSecprotocols(const SecurityProtocols& sp)
+{
+    secprots = sp;
+};
+
+const HttpServer& LoadTest :: getServer() const
+{
+    return server;
+};
+
+const SecurityProtocols& LoadTest :: getSecprotocols() const
+{
+    return secprots;
+};
+
+PRIntervalTime LoadTest :: getTimeout() const
+{
+    return timeout;
+};
+
+const char* LoadTest :: getRequest() const
+{
+    return request;
+};
+
+PRInt32 LoadTest :: getRequestLength() const
+{
+    return requestLength;
+};
+
+PRInt32 LoadTest :: getPipelineDepth() const
+{
+    return depth;
+};
+
+PRBool LoadTest :: getKeepAlive() const
+{
+    return keepalive;
+};
+
+PRBool LoadTest :: getHttp2() const
+{
+    return http2;
+};
+
+const char* LoadTest :: getUri() const
+{
+    return uri;
+};
+
+const char* LoadTest :: getAuthority() const
+{
+    return authority;
+};
+
+PRTime LoadTest :: getStart() const
+{
+    return start;
+};
+
+PRTime LoadTest :: getEnd() const
+{
+    return end;
+};
+
+PRTime LoadTest :: getInterval() const
+{
+    return interval;
+};
+
+void LoadTest :: buildRequest()
+{
+    const char* host = server.getAddrString();
+    PRBool ipv6 = (strchr(host, ':') != NULL);
+    authority = PR_smprintf("%s%s%s:%d",
+                            ipv6 ? "[" : "", host, ipv6 ? "]" : "",
+                            PR_ntohs(PR_NetAddrInetPort(server.getAddr())));
+    char* one = PR_smprintf("GET %s HTTP/1.1\r\n"
+                            "Host: %s\r\n"
+                            "User-Agent: httptest\r\n"
+                            "%s"
+                            "\r\n",
+                            uri, authority,
+                            keepalive ? "" : "Connection: close\r\n");
+    PRInt32 oneLength = strlen(one);
+
+    // Without keep-alive an HTTP/1.1 server closes the connection after the
+    // first response, so there is nothing to pipeline.  HTTP/2 still runs
+    // the batch as streams before closing.
+    if (!keepalive && !http2)
+        depth = 1;
+
+    requestLength = oneLength * depth;
+    request = (char*) malloc(requestLength + 1);
+    for (PRInt32 i = 0; i < depth; i++)
+        memcpy(request + i * oneLength, one, oneLength);
+    request[requestLength] = '\0';
+
+    PR_smprintf_free(one);
+};
+
+PRInt32 LoadTest :: run(const char* jsonfile)
+{
+    buildRequest();
+
+    // In open loop mode each connection sends a batch of depth requests every
+    // interval.  The connections are staggered across the interval so the
+    // batches arrive evenly.
+    if (rate)
+        interval = (PRTime) depth * connections * PR_USEC_PER_SEC / rate;
+
+    conns = (LoadConnection**) malloc(sizeof(LoadConnection*) * connections);
+    PRThread** threads = (PRThread**) malloc(sizeof(PRThread*) * connections);
+
+    start = PR_Now();
+    end = start + (PRTime) duration * PR_USEC_PER_SEC;
+
+    PRInt32 i;
+    for (i = 0; i < connections; i++)
+    {
+        conns[i] = new LoadConnection(*this, interval * i / connections);
+        threads[i] = PR_CreateThread(PR_USER_THREAD,
+                                     connectionThread,
+                                     (void*) conns[i],
+                                     PR_PRIORITY_NORMAL,
+                                     PR_GLOBAL_THREAD,
+                                     PR_JOINABLE_THREAD,
+                                     0);
+    };
+
+    for (i = 0; i < connections; i++)
+    {
+        if (threads[i])
+            PR_JoinThread(threads[i]);
+        else
+            Logger::logError(LOGERROR, "Unable to create thread for connection %d", i);
+    };
+    free(threads);
+
+    PRTime elapsed = PR_Now() - start;
+
+    for (i = 0; i < connections; i++)
+    {
+        histogram.add(conns[i]->histogram);
+        requests += conns[i]->requests;
+        errors += conns[i]->errors;
+        connects += conns[i]->connects;
+        bytes += conns[i]->bytes;
+        for (int j = 0; j < 6; j++)
+            statuses[j] += conns[i]->statuses[j];
+    };
+
+    double seconds = (double) elapsed / PR_USEC_PER_SEC;
+
+    fprintf(stdout, "Load test %s: GET %s, %s, %d connections, %s %d, %s, %s\n",
+            scenario.name, uri, http2 ? "HTTP/2" : "HTTP/1.1", connections,
+            http2 ? "streams per batch" : "pipeline depth", depth,
+            keepalive ? "keep-alive" : "no keep-alive",
+            server.isSSL() ? "SSL" : "plain");
+    if (rate)
+        fprintf(stdout, "Arrival rate       %d requests/s (open loop)\n", rate);
+    fprintf(stdout, "Duration           %.2f s\n", seconds);
+    fprintf(stdout, "Requests           %lld (%.1f/s)\n", (long long) requests, requests / seconds);
+    fprintf(stdout, "Errors             %lld\n", (long long) errors);
+    fprintf(stdout, "Connections        %lld\n", (long long) connects);
+    fprintf(stdout, "Received           %.1f KB/s\n", bytes / seconds / 1024);
+    fprintf(stdout, "Status             1xx %lld, 2xx %lld, 3xx %lld, 4xx %lld, 5xx %lld\n",
+            (long long) statuses[1], (long long) statuses[2], (long long) statuses[3],
+            (long long) statuses[4], (long long) statuses[5]);
+    fprintf(stdout, "Latency (us)       min %lld, mean %.0f, p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, max %lld\n",
+            (long long) histogram.getMin(), histogram.getMean(),
+            (long long) histogram.getValueAtPercentile(50),
+            (long long) histogram.getValueAtPercentile(90),
+            (long long) histogram.getValueAtPercentile(99),
+            (long long) histogram.getValueAtPercentile(99.9),
+            (long long) histogram.getMax());
+
+    if (jsonfile)
+    {
+        FILE* f = strcmp(jsonfile, "-") ? fopen(jsonfile, "w") : stdout;
+        if (f)
+        {
+            writeJSON(f, elapsed);
+            if (f != stdout)
+                fclose(f);
+        }
+        else
+        {
+            Logger::logError(LOGERROR, "Unable to write %s", jsonfile);
+        };
+    };
+
+    if (errors || statuses[4] || statuses[5])
+        return 1;
+    return 0;
+};
+
+void LoadTest :: connectionThread(void* arg)
+{
+    LoadConnection* conn = (LoadConnection*) arg;
+    conn->run();
+};
+
+void LoadTest :: writeJSON(FILE* f, PRTime elapsed)
+{
+    double seconds = (double) elapsed / PR_USEC_PER_SEC;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"scenario\": \"%s\",\n", scenario.name);
+    fprintf(f, "  \"server\": \"%s\",\n", server.getAddrString());
+    fprintf(f, "  \"port\": %d,\n", PR_ntohs(PR_NetAddrInetPort(server.getAddr())));
+    fprintf(f, "  \"uri\": \"%s\",\n", uri);
+    fprintf(f, "  \"ssl\": %s,\n", server.isSSL() ? "true" : "false");
+    fprintf(f, "  \"protocol\": \"%s\",\n", http2 ? "HTTP/2" : "HTTP/1.1");
+    fprintf(f, "  \"connections\": %d,\n", connections);
+    fprintf(f, "  \"pipeline_depth\": %d,\n", depth);
+    fprintf(f, "  \"keep_alive\": %s,\n", keepalive ? "true" : "false");
+    fprintf(f, "  \"rate\": %d,\n", rate);
+    fprintf(f, "  \"duration_s\": %.3f,\n", seconds);
+    fprintf(f, "  \"requests\": %lld,\n", (long long) requests);
+    fprintf(f, "  \"errors\": %lld,\n", (long long) errors);
+    fprintf(f, "  \"connects\": %lld,\n", (long long) connects);
+    fprintf(f, "  \"bytes_received\": %lld,\n", (long long) bytes);
+    fprintf(f, "  \"requests_per_s\": %.1f,\n", requests / seconds);
+    fprintf(f, "  \"status\": { \"1xx\": %lld, \"2xx\": %lld, \"3xx\": %lld, \"4xx\": %lld, \"5xx\": %lld },\n",
+            (long long) statuses[1], (long long) statuses[2], (long long) statuses[3],
+            (long long) statuses[4], (long long) statuses[5]);
+    fprintf(f, "  \"latency_us\": {\n");
+    fprintf(f, "    \"min\": %lld,\n", (long long) histogram.getMin());
+    fprintf(f, "    \"mean\": %.1f,\n", histogram.getMean());
+    fprintf(f, "    \"p50\": %lld,\n", (long long) histogram.getValueAtPercentile(50));
+    fprintf(f, "    \"p90\": %lld,\n", (long long) histogram.getValueAtPercentile(90));
+    fprintf(f, "    \"p99\": %lld,\n", (long long) histogram.getValueAtPercentile(99));
+    fprintf(f, "    \"p99_9\": %lld,\n", (long long) histogram.getValueAtPercentile(99.9));
+    fprintf(f, "    \"p99_99\": %lld,\n", (long long) histogram.getValueAtPercentile(99.99));
+    fprintf(f, "    \"max\": %lld,\n", (long long) histogram.getMax());
+    fprintf(f, "    \"histogram\": ");
+    histogram.writeJSON(f);
+    fprintf(f, "\n  }\n");
+    fprintf(f, "}\n");
+};
@@ -0,0 +1,135 @@
+/*
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS HEADER.
+ *
+ * Copyright 2008 Sun Microsystems, Inc. All rights reserved.
+ *
+ * THE BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer. 
+ * Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution. 
+ *
+ * Neither the name of the  nor the names of its contributors may be
+ * used to endorse or promote products derived from this software without 
+ * specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER 
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LOADTEST_H_
+#define _LOADTEST_H_
+
+#include <stdio.h>
+#include <nspr.h>
+#include "http.h"
+#include "histogram.h"
+
+// a canned load test scenario
+struct LoadScenario
+{
+    const char* name;
+    const char* uri;
+    const char* description;
+};
+
+class LoadConnection;
+
+// Load generator.  Drives a number of connections against the server, each
+// with its own thread, for a fixed duration.  Requests may be pipelined and
+// connections kept alive.  With an arrival rate set, requests are sent on a
+// fixed schedule (open loop) and latency is measured from the time each
+// request was due to be sent, so a stalled server is charged for the
+// requests it held up.  Without one, each connection sends its next
+// requests as soon as the previous responses arrive (closed loop).
+//
+// With HTTP/2 on, each connection runs its requests as concurrent streams
+// instead of pipelining them, up to the server's
+// SETTINGS_MAX_CONCURRENT_STREAMS.  Comparing the connection counts and
+// latencies of the two protocols at the same load is the point of the mode.
+class __EXPORT LoadTest
+{
+    public:
+        LoadTest(const HttpServer& server, const LoadScenario& scenario);
+        ~LoadTest();
+
+        static const LoadScenario* findScenario(const char* name);
+        static void listScenarios(FILE* f);
+
+        void setUri(const char* uri);
+        void setConnections(PRInt32 n);
+        void setDuration(PRInt32 seconds);
+        void setPipelineDepth(PRInt32 depth);
+        void setRate(PRInt32 requestsPerSecond);
+        void setKeepAlive(PRBool keepalive);
+        void setHttp2(PRBool http2);
+        void setTimeout(PRIntervalTime timeout);
+        void setSecprotocols(const SecurityProtocols& sp);
+
+        // runs the test, prints a summary to stdout and, if jsonfile is not
+        // NULL, writes the results there ("-" is stdout).  Returns 0 if
+        // every request succeeded
+        PRInt32 run(const char* jsonfile);
+
+        const HttpServer& getServer() const;
+        const SecurityProtocols& getSecprotocols() const;
+        PRIntervalTime getTimeout() const;
+        const char* getRequest() const;
+        PRInt32 getRequestLength() const;
+        PRInt32 getPipelineDepth() const;
+        PRBool getKeepAlive() const;
+        PRBool getHttp2() const;
+        const char* getUri() const;
+        const char* getAuthority() const;
+        PRTime getStart() const;
+        PRTime getEnd() const;
+        PRTime getInterval() const;
+
+    protected:
+        static void connectionThread(void* arg);
+        void buildRequest();
+        void writeJSON(FILE* f, PRTime elapsed);
+
+        const HttpServer& server;
+        const LoadScenario& scenario;
+        const char* uri;
+        PRInt32 connections;
+        PRInt32 duration;
+        PRInt32 depth;
+        PRInt32 rate;
+        PRBool keepalive;
+        PRBool http2;
+        PRIntervalTime timeout;
+        SecurityProtocols secprots;
+
+        char* request; // depth copies of the request, sent with one write
+        char* authority; // host:port, the Host header or :authority
+        PRInt32 requestLength;
+        PRTime start;
+        PRTime end;
+        PRTime interval; // time between batches on one connection in open loop mode
+
+        LoadConnection** conns;
+        LatencyHistogram histogram;
+        PRInt64 requests;
+        PRInt64 errors;
+        PRInt64 connects;
+        PRInt64 bytes;
+        PRInt64 statuses[6]; // by status class, 1xx through 5xx; [0] is unused
+};
+
+#endif
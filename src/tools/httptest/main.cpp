@@ -49,6 +49,7 @@
 #include "regex_scrubber.h"
 #include "prio.h"
 #include "utils.h"
+#include "loadtest.h"
 
 #ifdef XP_UNIX
 #include <sys/resource.h>
@@ -89,6 +90,16 @@ void usage(char *argv0)
     fprintf(stdout, "-4                 Perform tests using IPv4 (default)\n");
     fprintf(stdout, "-6                 Perform tests using IPv6 localhost address ::1\n");
     fprintf(stdout, "-L <x>             Run tests in infinite loop and report stats every x seconds\n");
+    fprintf(stdout, "-B <scenario>      Run a load test instead of the test suite, using one of these scenarios:\n");
+    LoadTest::listScenarios(stdout);
+    fprintf(stdout, "-u <uri>           URI to request in the load test. Default: the scenario's URI\n");
+    fprintf(stdout, "-K <n>             number of connections in the load test. Default: 10\n");
+    fprintf(stdout, "-D <seconds>       duration of the load test. Default: 30\n");
+    fprintf(stdout, "-q <n>             pipeline n requests on each connection in the load test. Default: 1\n");
+    fprintf(stdout, "-i <rate>          send requests at a fixed rate per second in the load test (open loop)\n");
+    fprintf(stdout, "-Z                 don't use keep-alive in the load test\n");
+    fprintf(stdout, "-2                 use HTTP/2 in the load test, with -q streams at a time on each connection\n");
+    fprintf(stdout, "-J <file>          write the load test results as JSON to file, - for stdout\n");
 };
 
 void printCipherOptions(void)
@@ -174,10 +185,19 @@ int main(int argc, char **argv)
     PRUint16 af = PR_AF_INET;
     PRInt32 displayperiod=0;
     PRBool loop = PR_FALSE;
+    const LoadScenario* scenario = NULL; // load test scenario, NULL to run the test suite
+    char* loaduri = NULL;
+    PRInt32 loadconnections = 0;
+    PRInt32 loadduration = 0;
+    PRInt32 loaddepth = 0;
+    PRInt32 loadrate = 0;
+    PRBool loadkeepalive = PR_TRUE;
+    PRBool loadhttp2 = PR_FALSE;
+    char* loadjson = NULL;
 
     Logger::logInitialize(logLevel);
 
-    options = PL_CreateOptState(argc, argv, "X:C:h:H:l:c:d:n:w46r:sx:p:o:t:a:e:k:Ng:v:R:QPE:T:L:");
+    options = PL_CreateOptState(argc, argv, "X:C:h:H:l:c:d:n:w46r:sx:p:o:t:a:e:k:Ng:v:R:QPE:T:L:B:u:K:D:q:i:Z2J:");
     long repeat = 1;
     while ( PL_GetNextOpt(options) == PL_OPT_OK)
     {
@@ -332,6 +352,57 @@ int main(int argc, char **argv)
                 af = PR_AF_INET;
 		break;
 
+            case 'B':
+                if (options->value)
+                {
+                    scenario = LoadTest::findScenario(options->value);
+                    if (!scenario)
+                    {
+                        fprintf(stdout, "Unknown load test scenario %s\n", options->value);
+                        usage(argv[0]);
+                        return -1;
+                    };
+                };
+                break;
+
+            case 'u':
+                if (options->value)
+                    loaduri = strdup(options->value);
+                break;
+
+            case 'K':
+                if (options->value)
+                    loadconnections = (PRInt32) atoi(options->value);
+                break;
+
+            case 'D':
+                if (options->value)
+                    loadduration = (PRInt32) atoi(options->value);
+                break;
+
+            case 'q':
+                if (options->value)
+                    loaddepth = (PRInt32) atoi(options->value);
+                break;
+
+            case 'i':
+                if (options->value)
+                    loadrate = (PRInt32) atoi(options->value);
+                break;
+
+            case 'Z':
+                loadkeepalive = PR_FALSE;
+                break;
+
+            case '2':
+                loadhttp2 = PR_TRUE;
+                break;
+
+            case 'J':
+                if (options->value)
+                    loadjson = strdup(options->value);
+                break;
+
         };
     };
 
@@ -367,6 +438,25 @@ int main(int argc, char **argv)
 
     HttpServer server(addr, af);
     server.setSSL(secure);
+
+    if (scenario)
+    {
+        if (timeout)
+            Engine::globaltimeout = PR_TicksPerSecond()*timeout;
+
+        LoadTest loadtest(server, *scenario);
+        if (loaduri)
+            loadtest.setUri(loaduri);
+        loadtest.setConnections(loadconnections);
+        loadtest.setDuration(loadduration);
+        loadtest.setPipelineDepth(loaddepth);
+        loadtest.setRate(loadrate);
+        loadtest.setKeepAlive(loadkeepalive);
+        loadtest.setHttp2(loadhttp2);
+        loadtest.setTimeout(Engine::globaltimeout);
+        loadtest.setSecprotocols(secprots);
+        return loadtest.run(loadjson);
+    };
     
     if (PR_FALSE == NSTests)
     {